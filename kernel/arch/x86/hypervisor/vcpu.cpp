@@ -442,6 +442,9 @@ zx_status_t vmcs_init(paddr_t vmcs_address, uint16_t vpid, uintptr_t entry,
     vmcs.Write(VmcsField64::HOST_IA32_PAT, read_msr(X86_MSR_IA32_PAT));
     vmcs.Write(VmcsField64::HOST_IA32_EFER, read_msr(X86_MSR_IA32_EFER));
     vmcs.Write(VmcsFieldXX::HOST_CR0, x86_get_cr0());
+    // With CR4.PCIDE set in HOST_CR4, the low bits of HOST_CR3 are the PCID
+    // loaded on VM exit. Keep this thread's PCID, so the host goes on using
+    // the entries, and the stale tracking, of its own aspace.
     vmcs.Write(VmcsFieldXX::HOST_CR3, x86_get_cr3());
     vmcs.Write(VmcsFieldXX::HOST_CR4, x86_get_cr4());
     vmcs.Write(VmcsField16::HOST_ES_SELECTOR, 0);
@@ -41,8 +41,7 @@ private:
     IntermediatePtFlags intermediate_flags() final;
     PtFlags terminal_flags(PageTableLevel level, uint flags) final;
     PtFlags split_flags(PageTableLevel level, PtFlags flags) final;
-    void TlbInvalidatePage(PageTableLevel level, vaddr_t vaddr, bool global_page,
-                           bool was_terminal) final;
+    void TlbInvalidate(PendingTlbInvalidation* pending) final;
     uint pt_flags_to_mmu_flags(PtFlags flags, PageTableLevel level) final;
     bool needs_cache_flushes() final { return false; }
 
@@ -64,8 +63,7 @@ private:
     IntermediatePtFlags intermediate_flags() final;
     PtFlags terminal_flags(PageTableLevel level, uint flags) final;
     PtFlags split_flags(PageTableLevel level, PtFlags flags) final;
-    void TlbInvalidatePage(PageTableLevel level, vaddr_t vaddr, bool global_page,
-                           bool was_terminal) final;
+    void TlbInvalidate(PendingTlbInvalidation* pending) final;
     uint pt_flags_to_mmu_flags(PtFlags flags, PageTableLevel level) final;
     bool needs_cache_flushes() final { return false; }
 };
@@ -98,6 +96,11 @@ public:
 
     int active_cpus() { return active_cpus_.load(); }
 
+    // Returns the CPUs that must be interrupted to invalidate this aspace's
+    // TLB entries.  Any other CPU holding stale entries tagged with this
+    // aspace's PCID flushes them when it next switches to the aspace.
+    int PrepareTlbShootdown();
+
     IoBitmap& io_bitmap() { return io_bitmap_; }
 
     static void ContextSwitch(X86ArchVmAspace* from, X86ArchVmAspace* to);
@@ -131,6 +134,15 @@ private:
     // CPUs that are currently executing in this aspace.
     // Actually an mp_cpu_mask_t, but header dependencies.
     fbl::atomic_int active_cpus_{0};
+
+    // Process-context identifier tagging this aspace's TLB entries, or 0 if
+    // it has none and must flush the TLB whenever it is switched to.
+    uint16_t pcid_ = 0;
+
+    // CPUs whose TLB entries for |pcid_| are known to be current, so that
+    // switching to this aspace on them need not flush.  Cleared by every
+    // TLB shootdown.
+    fbl::atomic_int pcid_cpus_{0};
 };
 
 using ArchVmAspace = X86ArchVmAspace;
@@ -16,6 +16,8 @@
 #include <arch/x86/feature.h>
 #include <arch/x86/mmu.h>
 #include <arch/x86/mmu_mem_types.h>
+#include <fbl/auto_lock.h>
+#include <fbl/mutex.h>
 #include <kernel/mp.h>
 #include <vm/arch_vm_aspace.h>
 #include <vm/pmm.h>
@@ -50,6 +52,41 @@ volatile pt_entry_t linear_map_pdp[(64ULL * GB) / (2 * MB)] __ALIGNED(PAGE_SIZE)
 /* kernel base top level page table in physical space */
 static const paddr_t kernel_pt_phys = (vaddr_t)KERNEL_PT - KERNEL_BASE + KERNEL_LOAD_OFFSET;
 
+/* Process-context identifiers for user aspaces.  PCID 0 is used by the
+ * kernel aspace and by any aspace created once the rest have run out. */
+static constexpr uint16_t kNumPcids = X86_CR3_PCID_MASK + 1;
+static fbl::Mutex pcid_lock;
+static uint64_t pcid_bitmap[kNumPcids / 64] TA_GUARDED(pcid_lock) = {1};
+static uint16_t pcid_next TA_GUARDED(pcid_lock) = 1;
+
+static uint16_t x86_pcid_alloc() {
+    if (!x86_feature_test(X86_FEATURE_PCID)) {
+        return 0;
+    }
+
+    fbl::AutoLock lock(&pcid_lock);
+    for (uint16_t i = 0; i < kNumPcids; i++) {
+        uint16_t pcid = static_cast<uint16_t>((pcid_next + i) % kNumPcids);
+        uint64_t bit = 1ull << (pcid % 64);
+        if (!(pcid_bitmap[pcid / 64] & bit)) {
+            pcid_bitmap[pcid / 64] |= bit;
+            pcid_next = static_cast<uint16_t>((pcid + 1) % kNumPcids);
+            return pcid;
+        }
+    }
+    return 0;
+}
+
+static void x86_pcid_free(uint16_t pcid) {
+    if (pcid == 0) {
+        return;
+    }
+
+    fbl::AutoLock lock(&pcid_lock);
+    DEBUG_ASSERT(pcid_bitmap[pcid / 64] & (1ull << (pcid % 64)));
+    pcid_bitmap[pcid / 64] &= ~(1ull << (pcid % 64));
+}
+
 /* valid EPT MMU flags */
 static const uint kValidEptFlags =
     ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE | ARCH_MMU_FLAG_PERM_EXECUTE;
@@ -112,60 +149,94 @@ static void x86_tlb_global_invalidate() {
     /* See Intel 3A section 4.10.4.1 */
     ulong cr4 = x86_get_cr4();
     if (likely(cr4 & X86_CR4_PGE)) {
+        /* Toggling PGE flushes every entry of every PCID. */
         x86_set_cr4(cr4 & ~X86_CR4_PGE);
         x86_set_cr4(cr4);
+    } else if (cr4 & X86_CR4_PCIDE) {
+        /* A CR3 reload would only flush the current PCID. */
+        if (x86_feature_test(X86_FEATURE_INVPCID)) {
+            /* Type 2: all contexts, including global entries. */
+            struct {
+                uint64_t pcid;
+                uint64_t addr;
+            } desc = {0, 0};
+            __asm__ volatile("invpcid %0, %1" ::"m"(desc), "r"(2ul) : "memory");
+        } else {
+            /* Clearing PCIDE flushes every PCID. PCIDE may only be set
+             * again while CR3 holds PCID 0, and while it is clear the
+             * PCID bits of CR3 would be taken as PWT/PCD. */
+            ulong cr3 = x86_get_cr3();
+            x86_set_cr3(cr3 & ~(ulong)X86_CR3_PCID_MASK);
+            x86_set_cr4(cr4 & ~X86_CR4_PCIDE);
+            x86_set_cr4(cr4);
+            x86_set_cr3(cr3);
+        }
     } else {
         x86_set_cr3(x86_get_cr3());
     }
 }
 
-/* Task used for invalidating a TLB entry on each CPU */
-struct TlbInvalidatePage_context {
+/**
+ * @brief  invalidate all non-global TLB entries for the current address space
+ */
+static void x86_tlb_nonglobal_invalidate() {
+    /* Reloading CR3 without X86_CR3_NOFLUSH drops the non-global entries
+     * tagged with its PCID. */
+    x86_set_cr3(x86_get_cr3());
+}
+
+/* Task used for invalidating TLB entries on each CPU */
+struct TlbInvalidate_context {
     ulong target_cr3;
-    vaddr_t vaddr;
-    enum PageTableLevel level;
-    bool global_page;
+    const PendingTlbInvalidation* pending;
 };
-static void TlbInvalidatePage_task(void* raw_context) {
+static void TlbInvalidate_task(void* raw_context) {
     DEBUG_ASSERT(arch_ints_disabled());
-    TlbInvalidatePage_context* context = (TlbInvalidatePage_context*)raw_context;
+    TlbInvalidate_context* context = (TlbInvalidate_context*)raw_context;
+    const PendingTlbInvalidation* pending = context->pending;
 
-    ulong cr3 = x86_get_cr3();
-    if (context->target_cr3 != cr3 && !context->global_page) {
+    ulong cr3 = x86_get_cr3() & ~(ulong)X86_CR3_PCID_MASK;
+    if (context->target_cr3 != cr3 && !pending->contains_global) {
         /* This invalidation doesn't apply to this CPU, ignore it */
         return;
     }
 
-    switch (context->level) {
-    case PML4_L:
-        x86_tlb_global_invalidate();
-        break;
-    case PDP_L:
-    case PD_L:
-    case PT_L:
-        __asm__ volatile("invlpg %0" ::"m"(*(uint8_t*)context->vaddr));
-        break;
+    if (pending->full_shootdown) {
+        if (pending->contains_global) {
+            x86_tlb_global_invalidate();
+        } else {
+            x86_tlb_nonglobal_invalidate();
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < pending->count; ++i) {
+        const auto& item = pending->item[i];
+        switch (item.level) {
+        case PML4_L:
+            panic("PML4_L invalidations are always full shootdowns\n");
+        case PDP_L:
+        case PD_L:
+        case PT_L:
+            __asm__ volatile("invlpg %0" ::"m"(*(uint8_t*)item.vaddr));
+            break;
+        }
     }
 }
 
 /**
- * @brief Invalidate a single page at a given page table level
+ * @brief Execute a queued TLB invalidation
  *
  * @param pt The page table we're invalidating for (if nullptr, assume for current one)
- * @param vaddr The virtual address we are invalidating the TLB entry for
- * @param level The page table level that maps this vaddr
- * @param global_page True if we are invalidating a global mapping
+ * @param pending The planned invalidation
  *
- * TODO(ZX-979): Optimize this.  This is horribly inefficient.
- * We should also change this to pool invalidations from a single
- * "transaction" and then only execute a single mp_sync_exec for that
- * transaction, rather than one per page.
+ * All of the entries queued by a single page table operation are handled
+ * with one mp_sync_exec, rather than one per page.
  */
-static void x86_tlb_invalidate_page(X86PageTableBase* pt, vaddr_t vaddr,
-                                    enum PageTableLevel level, bool global_page) {
-    ulong cr3 = pt ? pt->phys() : x86_get_cr3();
-    struct TlbInvalidatePage_context task_context = {
-        .target_cr3 = cr3, .vaddr = vaddr, .level = level, .global_page = global_page,
+static void x86_tlb_invalidate(X86PageTableBase* pt, const PendingTlbInvalidation* pending) {
+    ulong cr3 = pt ? pt->phys() : x86_get_cr3() & ~(ulong)X86_CR3_PCID_MASK;
+    struct TlbInvalidate_context task_context = {
+        .target_cr3 = cr3, .pending = pending,
     };
 
     /* Target only CPUs this aspace is active on.  It may be the case that some
@@ -175,14 +246,14 @@ static void x86_tlb_invalidate_page(X86PageTableBase* pt, vaddr_t vaddr,
      * case, it will get a spurious request to flush. */
     mp_ipi_target_t target;
     cpu_mask_t target_mask = 0;
-    if (global_page || pt == nullptr) {
+    if (pending->contains_global || pt == nullptr) {
         target = MP_IPI_TARGET_ALL;
     } else {
         target = MP_IPI_TARGET_MASK;
-        target_mask = static_cast<X86ArchVmAspace*>(pt->ctx())->active_cpus();
+        target_mask = static_cast<X86ArchVmAspace*>(pt->ctx())->PrepareTlbShootdown();
     }
 
-    mp_sync_exec(target, target_mask, TlbInvalidatePage_task, &task_context);
+    mp_sync_exec(target, target_mask, TlbInvalidate_task, &task_context);
 }
 
 bool X86PageTableMmu::check_paddr(paddr_t paddr) {
@@ -282,9 +353,8 @@ X86PageTableBase::PtFlags X86PageTableMmu::split_flags(PageTableLevel level,
     return flags;
 }
 
-void X86PageTableMmu::TlbInvalidatePage(PageTableLevel level, vaddr_t vaddr, bool global_page,
-                                        bool was_terminal) {
-    x86_tlb_invalidate_page(this, vaddr, level, global_page);
+void X86PageTableMmu::TlbInvalidate(PendingTlbInvalidation* pending) {
+    x86_tlb_invalidate(this, pending);
 }
 
 uint X86PageTableMmu::pt_flags_to_mmu_flags(PtFlags flags, PageTableLevel level) {
@@ -392,8 +462,7 @@ X86PageTableBase::PtFlags X86PageTableEpt::split_flags(PageTableLevel level,
     return flags;
 }
 
-void X86PageTableEpt::TlbInvalidatePage(PageTableLevel level, vaddr_t vaddr, bool global_page,
-                                        bool was_terminal) {
+void X86PageTableEpt::TlbInvalidate(PendingTlbInvalidation* pending) {
     // TODO(ZX-981): Implement this.
 }
 
@@ -420,7 +489,9 @@ void x86_mmu_early_init() {
 
     // Unmap the lower identity mapping.
     pml4[0] = 0;
-    x86_tlb_invalidate_page(nullptr, 0, PML4_L, false);
+    PendingTlbInvalidation tlb;
+    tlb.enqueue(0, PML4_L, /* global */ true, /* terminal */ false);
+    x86_tlb_invalidate(nullptr, &tlb);
 
     /* get the address width from the CPU */
     uint8_t vaddr_width = x86_linear_address_width();
@@ -532,9 +603,12 @@ zx_status_t X86ArchVmAspace::Init(vaddr_t base, size_t size, uint mmu_flags) {
             return status;
         }
 
-        LTRACEF("user aspace: pt phys %#" PRIxPTR ", virt %p\n", pt_->phys(), pt_->virt());
+        pcid_ = x86_pcid_alloc();
+        LTRACEF("user aspace: pt phys %#" PRIxPTR ", virt %p, pcid %u\n", pt_->phys(),
+                pt_->virt(), pcid_);
     }
     fbl::atomic_init(&active_cpus_, 0);
+    fbl::atomic_init(&pcid_cpus_, 0);
 
     return ZX_OK;
 }
@@ -548,6 +622,10 @@ zx_status_t X86ArchVmAspace::Destroy() {
     } else {
         static_cast<X86PageTableMmu*>(pt_)->Destroy(base_, size_);
     }
+    // CPUs may still hold entries tagged with this PCID.  The next aspace to
+    // be handed it starts with an empty |pcid_cpus_|, so it flushes them.
+    x86_pcid_free(pcid_);
+    pcid_ = 0;
     return ZX_OK;
 }
 
@@ -587,12 +665,23 @@ void X86ArchVmAspace::ContextSwitch(X86ArchVmAspace* old_aspace, X86ArchVmAspace
         aspace->canary_.Assert();
         paddr_t phys = aspace->pt_phys();
         LTRACEF_LEVEL(3, "switching to aspace %p, pt %#" PRIXPTR "\n", aspace, phys);
-        x86_set_cr3(phys);
+
+        // Become active before checking |pcid_cpus_|: a shootdown either
+        // sees this CPU in |active_cpus_| and interrupts it, or has already
+        // cleared |pcid_cpus_| and the load below flushes.
+        aspace->active_cpus_.fetch_or(cpu_bit);
+        ulong cr3 = phys;
+        if (aspace->pcid_ != 0) {
+            cr3 |= aspace->pcid_;
+            if (aspace->pcid_cpus_.fetch_or(cpu_bit) & cpu_bit) {
+                cr3 |= X86_CR3_NOFLUSH;
+            }
+        }
+        x86_set_cr3(cr3);
 
         if (old_aspace != nullptr) {
             old_aspace->active_cpus_.fetch_and(~cpu_bit);
         }
-        aspace->active_cpus_.fetch_or(cpu_bit);
     } else {
         LTRACEF_LEVEL(3, "switching to kernel aspace, pt %#" PRIxPTR "\n", kernel_pt_phys);
         x86_set_cr3(kernel_pt_phys);
@@ -610,6 +699,15 @@ void X86ArchVmAspace::ContextSwitch(X86ArchVmAspace* old_aspace, X86ArchVmAspace
         x86_set_tss_io_bitmap(aspace->io_bitmap());
 }
 
+int X86ArchVmAspace::PrepareTlbShootdown() {
+    // The page tables have already been updated, so any CPU that is not
+    // interrupted must not trust what it has cached under our PCID.
+    if (pcid_ != 0) {
+        pcid_cpus_.store(0);
+    }
+    return active_cpus_.load();
+}
+
 zx_status_t X86ArchVmAspace::Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags) {
     if (!IsValidVaddr(vaddr))
         return ZX_ERR_INVALID_ARGS;
@@ -631,6 +729,11 @@ void x86_mmu_percpu_init(void) {
         cr4 |= X86_CR4_SMEP;
     if (x86_feature_test(X86_FEATURE_SMAP))
         cr4 |= X86_CR4_SMAP;
+    if (x86_feature_test(X86_FEATURE_PCID) && !(cr4 & X86_CR4_PCIDE)) {
+        /* PCIDE may only be set while CR3 holds PCID 0. */
+        x86_set_cr3(x86_get_cr3() & ~(ulong)X86_CR3_PCID_MASK);
+        cr4 |= X86_CR4_PCIDE;
+    }
     x86_set_cr4(cr4);
 
     // Set NXE bit in X86_MSR_IA32_EFER.
@@ -20,6 +20,38 @@ enum PageTableLevel {
     PML4_L,
 };
 
+// Structure for tracking an upcoming TLB invalidation
+struct PendingTlbInvalidation {
+    struct Item {
+        vaddr_t vaddr;
+        PageTableLevel level;
+        bool is_global;
+        bool is_terminal;
+    };
+
+    // Add address |v|, translated at |level|, to the pending invalidation.
+    void enqueue(vaddr_t v, PageTableLevel level, bool is_global, bool is_terminal);
+
+    // Clear the list of pending invalidations
+    void clear();
+
+    bool empty() const { return count == 0 && !full_shootdown; }
+
+    // Maximum number of TLB entries we will queue before switching to
+    // a full invalidation.
+    static constexpr size_t kMaxPendingItems = 32;
+
+    // Number of valid elements in |item|
+    size_t count = 0;
+    // If true, ignore |item| and perform a full invalidation of the address
+    // space.
+    bool full_shootdown = false;
+    // If true, at least one of the queued entries is a global mapping.
+    bool contains_global = false;
+    // List of addresses queued for invalidation.
+    Item item[kMaxPendingItems];
+};
+
 class X86PageTableBase {
 public:
     X86PageTableBase();
@@ -74,9 +106,9 @@ protected:
     // Return the hardware flags to use on smaller pages after a splitting a
     // large page with flags |flags|.
     virtual PtFlags split_flags(PageTableLevel level, PtFlags flags) = 0;
-    // Invalidate a single page at the given level
-    virtual void TlbInvalidatePage(PageTableLevel level, vaddr_t vaddr, bool global_page,
-                                   bool was_terminal) = 0;
+    // Invalidate the TLB entries described by |pending| on every CPU that
+    // may hold them.
+    virtual void TlbInvalidate(PendingTlbInvalidation* pending) = 0;
     // Convert PtFlags to ARCH_MMU_* flags.
     virtual uint pt_flags_to_mmu_flags(PtFlags flags, PageTableLevel level) = 0;
     // Returns true if a cache flush is necessary for pagetable changes to be
@@ -139,8 +171,16 @@ private:
                     PageTableLevel level, vaddr_t vaddr, volatile pt_entry_t* pte,
                     bool was_terminal) TA_REQ(lock_);
 
+    // Issue the TLB invalidations queued since the last flush.  This must be
+    // done before any page table pages are freed and before |lock_| is
+    // dropped at the end of an operation.
+    void FlushPendingTlb() TA_REQ(lock_);
+
     fbl::Canary<fbl::magic("X86P")> canary_;
 
     // low lock to protect the mmu code
     fbl::Mutex lock_;
+
+    // TLB invalidations accumulated by the current operation.
+    PendingTlbInvalidation pending_tlb_ TA_GUARDED(lock_);
 };
@@ -9,6 +9,7 @@
 #include <arch/x86/feature.h>
 #include <arch/x86/page_tables/constants.h>
 #include <assert.h>
+#include <fbl/algorithm.h>
 #include <fbl/auto_call.h>
 #include <fbl/auto_lock.h>
 #include <trace.h>
@@ -134,6 +135,41 @@ void X86PageTableBase::CacheLineFlusher::FlushPtEntry(const volatile pt_entry_t*
     }
 }
 
+void PendingTlbInvalidation::enqueue(vaddr_t v, PageTableLevel level, bool is_global,
+                                     bool is_terminal) {
+    if (is_global) {
+        contains_global = true;
+    }
+
+    // Dropping a PML4_L entry is rare and covers so much address space that
+    // a full shootdown is cheaper than chasing it.  Non-terminal global
+    // entries are shared by every address space, so dropping one also needs
+    // a full flush to reach the paging-structure caches of other PCIDs.
+    if (count >= fbl::count_of(item) || level == PML4_L || (is_global && !is_terminal)) {
+        full_shootdown = true;
+        return;
+    }
+    item[count].vaddr = v;
+    item[count].level = level;
+    item[count].is_global = is_global;
+    item[count].is_terminal = is_terminal;
+    count++;
+}
+
+void PendingTlbInvalidation::clear() {
+    count = 0;
+    full_shootdown = false;
+    contains_global = false;
+}
+
+void X86PageTableBase::FlushPendingTlb() {
+    if (pending_tlb_.empty()) {
+        return;
+    }
+    TlbInvalidate(&pending_tlb_);
+    pending_tlb_.clear();
+}
+
 struct X86PageTableBase::MappingCursor {
 public:
     /**
@@ -175,7 +211,7 @@ void X86PageTableBase::UpdateEntry(CacheLineFlusher* flusher,
         // non-coherent remapping hardware sees the old PTE after the
         // invalidation.
         flusher->ForceFlush();
-        TlbInvalidatePage(level, vaddr, is_kernel_address(vaddr), was_terminal);
+        pending_tlb_.enqueue(vaddr, level, is_kernel_address(vaddr), was_terminal);
     }
 }
 
@@ -195,7 +231,7 @@ void X86PageTableBase::UnmapEntry(CacheLineFlusher* flusher,
         // non-coherent remapping hardware sees the old PTE after the
         // invalidation.
         flusher->ForceFlush();
-        TlbInvalidatePage(level, vaddr, is_kernel_address(vaddr), was_terminal);
+        pending_tlb_.enqueue(vaddr, level, is_kernel_address(vaddr), was_terminal);
     }
 }
 
@@ -503,6 +539,7 @@ zx_status_t X86PageTableBase::AddMapping(volatile pt_entry_t* table, uint mmu_fl
             if (cursor.size > 0) {
                 list_node to_free = LIST_INITIAL_VALUE(to_free);
                 RemoveMapping(table, level, cursor, &result, &to_free);
+                FlushPendingTlb();
                 if (!list_is_empty(&to_free)) {
                     pages_ -= pmm_free(&to_free);
                 }
@@ -738,6 +775,7 @@ zx_status_t X86PageTableBase::UnmapPages(vaddr_t vaddr, const size_t count,
     MappingCursor result;
     list_node to_free = LIST_INITIAL_VALUE(to_free);
     RemoveMapping(virt_, top_level(), start, &result, &to_free);
+    FlushPendingTlb();
     if (!list_is_empty(&to_free)) {
         pages_ -= pmm_free(&to_free);
     }
@@ -770,6 +808,11 @@ zx_status_t X86PageTableBase::MapPages(vaddr_t vaddr, paddr_t* phys, size_t coun
 
     fbl::AutoLock a(&lock_);
     DEBUG_ASSERT(virt_);
+    // Issue any TLB invalidations queued while mapping before dropping the
+    // lock.
+    auto flush = fbl::MakeAutoCall([&]() TA_NO_THREAD_SAFETY_ANALYSIS {
+        FlushPendingTlb();
+    });
 
     PageTableLevel top = top_level();
 
@@ -785,6 +828,7 @@ zx_status_t X86PageTableBase::MapPages(vaddr_t vaddr, paddr_t* phys, size_t coun
             MappingCursor result;
             list_node to_free = LIST_INITIAL_VALUE(to_free);
             RemoveMapping(virt_, top, start, &result, &to_free);
+            FlushPendingTlb();
             if (!list_is_empty(&to_free)) {
                 pages_ -= pmm_free(&to_free);
             }
@@ -835,6 +879,11 @@ zx_status_t X86PageTableBase::MapPagesContiguous(vaddr_t vaddr, paddr_t paddr,
 
     fbl::AutoLock a(&lock_);
     DEBUG_ASSERT(virt_);
+    // Issue any TLB invalidations queued while mapping before dropping the
+    // lock.
+    auto flush = fbl::MakeAutoCall([&]() TA_NO_THREAD_SAFETY_ANALYSIS {
+        FlushPendingTlb();
+    });
 
     MappingCursor start = {
         .paddr = paddr, .vaddr = vaddr, .size = count * PAGE_SIZE,
@@ -875,6 +924,7 @@ zx_status_t X86PageTableBase::ProtectPages(vaddr_t vaddr, size_t count, uint mmu
     MappingCursor result;
     list_node to_free = LIST_INITIAL_VALUE(to_free);
     zx_status_t status = UpdateMapping(virt_, mmu_flags, top_level(), start, &result, &to_free);
+    FlushPendingTlb();
     if (!list_is_empty(&to_free)) {
         // Free any items that were added to the list, even if the update
         // failed.
@@ -1733,7 +1733,8 @@ static bool pmi_interrupt_handler(x86_iframe_t *frame, PerfmonState* state) {
 
     const uint64_t status = read_msr(IA32_PERF_GLOBAL_STATUS);
     uint64_t bits_to_clear = 0;
-    uint64_t cr3 = x86_get_cr3();
+    // Report the page table root, without the PCID tagging the aspace.
+    uint64_t cr3 = x86_get_cr3() & ~(uint64_t)X86_CR3_PCID_MASK;
 
     LTRACEF("cpu %u: status 0x%" PRIx64 "\n", cpu, status);
 
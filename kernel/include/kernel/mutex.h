@@ -29,6 +29,11 @@ typedef struct TA_CAP("mutex") mutex {
     uint32_t magic;
     uintptr_t val;
     wait_queue_t wait;
+#if WITH_LIB_LOCKSTAT
+    /* call site and start time of a profiled acquisition, for the holder */
+    struct lockstat_site* lockstat_site;
+    uint64_t lockstat_acquired;
+#endif
 } mutex_t;
 
 #define MUTEX_FLAG_QUEUED ((uintptr_t)1)
@@ -18,8 +18,10 @@
 __BEGIN_CDECLS
 
 struct percpu {
-    /* per cpu timer queue */
+    /* per cpu timer queue, and the sentinel whose left child is the root of
+     * the tree indexing it */
     struct list_node timer_queue;
+    struct timer_tree_node timer_tree;
 
     /* per cpu preemption timer */
     timer_t preempt_timer;
@@ -34,6 +36,10 @@ struct percpu {
     /* per cpu idle thread */
     thread_t idle_thread;
 
+    /* the thread_t* most recently switched to on this cpu, which other cpus
+     * may read without the thread lock as a hint (see mutex_acquire) */
+    uint64_t running_thread;
+
     /* kernel counters arena */
     uint64_t* counters;
 
@@ -9,6 +9,7 @@
 
 #include <arch/arch_ops.h>
 #include <arch/spinlock.h>
+#include <lib/lockstat.h>
 #include <zircon/compiler.h>
 #include <zircon/thread_annotations.h>
 
@@ -17,7 +18,11 @@ __BEGIN_CDECLS
 /* interrupts should already be disabled */
 static inline void spin_lock(spin_lock_t* lock) TA_ACQ(lock) {
     DEBUG_ASSERT(arch_ints_disabled());
-    arch_spin_lock(lock);
+    if (unlikely(lockstat_is_enabled())) {
+        lockstat_spin_lock(lock);
+    } else {
+        arch_spin_lock(lock);
+    }
 }
 
 /* Returns 0 on success, non-0 on failure */
@@ -27,7 +32,11 @@ static inline int spin_trylock(spin_lock_t* lock) TA_TRY_ACQ(false, lock) {
 
 /* interrupts should already be disabled */
 static inline void spin_unlock(spin_lock_t* lock) TA_REL(lock) {
-    arch_spin_unlock(lock);
+    if (unlikely(lockstat_is_enabled())) {
+        lockstat_spin_unlock(lock);
+    } else {
+        arch_spin_unlock(lock);
+    }
 }
 
 static inline void spin_lock_init(spin_lock_t* lock) {
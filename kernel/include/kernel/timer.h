@@ -28,9 +28,17 @@ enum slack_mode {
     TIMER_SLACK_EARLY,  // slack interval is (deadline - slack, dealine]
 };
 
+/* Links indexing a cpu's timer queue by scheduled_time, see timer.c */
+struct timer_tree_node {
+    struct timer_tree_node* parent;
+    struct timer_tree_node* left;
+    struct timer_tree_node* right;
+};
+
 typedef struct timer {
     int magic;
     struct list_node node;
+    struct timer_tree_node tree;
 
     zx_time_t scheduled_time;
     int64_t slack; // Stores the applied slack adjustment from
@@ -46,6 +54,7 @@ typedef struct timer {
     {                                       \
         .magic = TIMER_MAGIC,               \
         .node = LIST_INITIAL_CLEARED_VALUE, \
+        .tree = {NULL, NULL, NULL},         \
         .scheduled_time = 0,                \
         .slack = 0,                         \
         .callback = NULL,                   \
@@ -0,0 +1,78 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <arch/spinlock.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <zircon/compiler.h>
+#include <zircon/syscalls/object.h>
+#include <zircon/thread_annotations.h>
+#include <zircon/types.h>
+
+__BEGIN_CDECLS
+
+// Lock contention profiling.
+//
+// When the kernel is built with ENABLE_LOCKSTAT=true, mutex and spinlock
+// acquisitions are attributed to the code which made them while profiling is
+// running ("lockstat start" at the console, or kernel.lockstat.enable=true on
+// the command line).  Results are available from the "lockstat dump" command
+// and from ZX_INFO_LOCK_STATS.
+
+#define LOCKSTAT_KIND_MUTEX ZX_INFO_LOCK_KIND_MUTEX
+#define LOCKSTAT_KIND_SPIN ZX_INFO_LOCK_KIND_SPIN
+
+typedef struct lockstat_site lockstat_site_t;
+
+#if WITH_LIB_LOCKSTAT
+
+extern int lockstat_enabled;
+
+static inline bool lockstat_is_enabled(void) {
+    return __atomic_load_n(&lockstat_enabled, __ATOMIC_RELAXED) != 0;
+}
+
+// Records an acquisition made at |pc| which waited |wait| ticks, and returns
+// the site to pass to lockstat_record_release, or NULL if the site table is
+// full.
+lockstat_site_t* lockstat_record_acquire(uintptr_t pc, uint32_t kind, bool contended,
+                                         uint64_t wait);
+void lockstat_record_release(lockstat_site_t* site, uint64_t hold);
+
+// Profiled versions of arch_spin_lock and arch_spin_unlock.  Interrupts must
+// be disabled.
+void lockstat_spin_lock(spin_lock_t* lock) TA_ACQ(lock);
+void lockstat_spin_unlock(spin_lock_t* lock) TA_REL(lock);
+
+// Number of call sites recorded so far.
+size_t lockstat_num_sites(void);
+// Fills in |info| for the next site at or after |*cursor|, which starts at
+// zero, and moves |*cursor| past it.  Returns false once there are no more
+// sites.
+bool lockstat_read_site(size_t* cursor, zx_info_lock_stats_t* info);
+
+#else
+
+static inline bool lockstat_is_enabled(void) { return false; }
+static inline lockstat_site_t* lockstat_record_acquire(uintptr_t pc, uint32_t kind,
+                                                       bool contended, uint64_t wait) {
+    return NULL;
+}
+static inline void lockstat_record_release(lockstat_site_t* site, uint64_t hold) {}
+static inline void lockstat_spin_lock(spin_lock_t* lock) TA_ACQ(lock) { arch_spin_lock(lock); }
+static inline void lockstat_spin_unlock(spin_lock_t* lock) TA_REL(lock) {
+    arch_spin_unlock(lock);
+}
+static inline size_t lockstat_num_sites(void) { return 0; }
+static inline bool lockstat_read_site(size_t* cursor, zx_info_lock_stats_t* info) {
+    return false;
+}
+
+#endif
+
+__END_CDECLS
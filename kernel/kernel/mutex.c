@@ -20,14 +20,31 @@
 #include <debug.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/percpu.h>
 #include <kernel/sched.h>
 #include <kernel/thread.h>
+#include <lib/counters.h>
 #include <lib/ktrace.h>
+#include <lib/lockstat.h>
+#include <platform.h>
 #include <trace.h>
 #include <zircon/types.h>
 
 #define LOCAL_TRACE 0
 
+// How long mutex_acquire spins waiting for a running holder to release the
+// mutex before blocking; roughly the cost of a pair of context switches.
+#define MUTEX_SPIN_MAX_DURATION ZX_USEC(10)
+
+// counts mutex_acquire calls which found the mutex held.
+KCOUNTER(mutex_contended_count, "kernel.mutex.contended");
+// counts contended acquisitions which succeeded while spinning.
+KCOUNTER(mutex_spin_acquired_count, "kernel.mutex.spin_acquired");
+// counts spins which ran out of time while the holder kept running.
+KCOUNTER(mutex_spin_timeout_count, "kernel.mutex.spin_timeout");
+// counts contended acquisitions which blocked in the wait queue.
+KCOUNTER(mutex_blocked_count, "kernel.mutex.blocked");
+
 /**
  * @brief  Initialize a mutex_t
  */
@@ -59,15 +76,62 @@ void mutex_destroy(mutex_t* m) {
     wait_queue_destroy(&m->wait);
 }
 
-/**
- * @brief  Acquire the mutex
- */
-void mutex_acquire(mutex_t* m) TA_NO_THREAD_SAFETY_ANALYSIS {
-    DEBUG_ASSERT(m->magic == MUTEX_MAGIC);
-    DEBUG_ASSERT(!arch_in_int_handler());
+// Returns the cpu |t| is running on, starting the search at |hint|, or
+// INVALID_CPU if it is not running anywhere.  |t| is only compared, never
+// dereferenced, since it may exit as soon as it releases the mutex.
+static cpu_num_t mutex_find_running(const thread_t* t, cpu_num_t hint) {
+    if (hint != INVALID_CPU &&
+        atomic_load_u64_relaxed(&percpu[hint].running_thread) == (uintptr_t)t) {
+        return hint;
+    }
+    for (cpu_num_t i = 0; i < arch_max_num_cpus(); i++) {
+        if (atomic_load_u64_relaxed(&percpu[i].running_thread) == (uintptr_t)t) {
+            return i;
+        }
+    }
+    return INVALID_CPU;
+}
 
+// Spins trying to take |m| for as long as its holder is running on another
+// cpu, up to MUTEX_SPIN_MAX_DURATION.  Interrupts stay enabled throughout,
+// so the spinning thread can be preempted like any other.
+static bool mutex_spin(mutex_t* m, thread_t* ct) {
+    if (arch_max_num_cpus() == 1) {
+        return false;
+    }
+
+    zx_time_t deadline = current_time() + MUTEX_SPIN_MAX_DURATION;
+    cpu_num_t holder_cpu = INVALID_CPU;
+    for (;;) {
+        uintptr_t oldval = mutex_val(m);
+        if (oldval == 0) {
+            if (atomic_cmpxchg_u64(&m->val, &oldval, (uintptr_t)ct)) {
+                return true;
+            }
+            continue;
+        }
+        // once threads are queued the mutex is handed directly to one of
+        // them on release, so there is nothing to wait for here
+        if (oldval & MUTEX_FLAG_QUEUED) {
+            return false;
+        }
+        holder_cpu = mutex_find_running((thread_t*)oldval, holder_cpu);
+        if (holder_cpu == INVALID_CPU) {
+            return false;
+        }
+        if (current_time() >= deadline) {
+            kcounter_add(mutex_spin_timeout_count, 1u);
+            return false;
+        }
+        arch_spinloop_pause();
+    }
+}
+
+// Takes |m| for the current thread, returning whether it had to wait.
+static inline bool mutex_acquire_internal(mutex_t* m) TA_NO_THREAD_SAFETY_ANALYSIS {
     thread_t* ct = get_current_thread();
     uintptr_t oldval;
+    bool spun = false;
 
 retry:
     // fast path: assume its unheld, try to grab it
@@ -75,7 +139,7 @@ retry:
     if (likely(atomic_cmpxchg_u64(&m->val, &oldval, (uintptr_t)ct))) {
         // acquired it cleanly
         ct->mutexes_held++;
-        return;
+        return spun;
     }
 
 #if LK_DEBUGLEVEL > 0
@@ -84,6 +148,18 @@ retry:
               ct, ct->name, m);
 #endif
 
+    // a holder running on another cpu will likely release it sooner than
+    // we could block and be woken, so try spinning first
+    if (!spun) {
+        spun = true;
+        kcounter_add(mutex_contended_count, 1u);
+        if (mutex_spin(m, ct)) {
+            kcounter_add(mutex_spin_acquired_count, 1u);
+            ct->mutexes_held++;
+            return true;
+        }
+    }
+
     // we contended with someone else, will probably need to block
     THREAD_LOCK(state);
 
@@ -101,6 +177,8 @@ retry:
         goto retry;
     }
 
+    kcounter_add(mutex_blocked_count, 1u);
+
     // have the holder inheirit our priority
     // discard the local reschedule flag because we're just about to block anyway
     bool unused;
@@ -122,6 +200,40 @@ retry:
     ct->mutexes_held++;
 
     THREAD_UNLOCK(state);
+    return true;
+}
+
+/**
+ * @brief  Acquire the mutex
+ */
+void mutex_acquire(mutex_t* m) TA_NO_THREAD_SAFETY_ANALYSIS {
+    DEBUG_ASSERT(m->magic == MUTEX_MAGIC);
+    DEBUG_ASSERT(!arch_in_int_handler());
+
+#if WITH_LIB_LOCKSTAT
+    if (unlikely(lockstat_is_enabled())) {
+        uint64_t start = current_ticks();
+        bool contended = mutex_acquire_internal(m);
+        uint64_t now = current_ticks();
+        m->lockstat_site = lockstat_record_acquire((uintptr_t)__GET_CALLER(),
+                                                   LOCKSTAT_KIND_MUTEX, contended, now - start);
+        m->lockstat_acquired = now;
+        return;
+    }
+#endif
+
+    mutex_acquire_internal(m);
+}
+
+// Records the hold time of a profiled acquisition.  Must be called before the
+// mutex is released, since the next holder reuses the fields.
+static inline void mutex_lockstat_release(mutex_t* m) {
+#if WITH_LIB_LOCKSTAT
+    if (unlikely(m->lockstat_site != NULL)) {
+        lockstat_record_release(m->lockstat_site, current_ticks() - m->lockstat_acquired);
+        m->lockstat_site = NULL;
+    }
+#endif
 }
 
 // shared implementation of release
@@ -216,6 +328,8 @@ void mutex_release(mutex_t* m) TA_NO_THREAD_SAFETY_ANALYSIS {
     DEBUG_ASSERT(m->magic == MUTEX_MAGIC);
     DEBUG_ASSERT(!arch_in_int_handler());
 
+    mutex_lockstat_release(m);
+
     // default release will reschedule if any threads are woken up and acquire the thread lock
     mutex_release_internal(m, true, false);
 }
@@ -226,6 +340,8 @@ void mutex_release_thread_locked(mutex_t* m, bool reschedule) TA_NO_THREAD_SAFET
     DEBUG_ASSERT(arch_ints_disabled());
     DEBUG_ASSERT(spin_lock_held(&thread_lock));
 
+    mutex_lockstat_release(m);
+
     // this special version of release will pass through the reschedule flag and not acquire
     // the thread_lock
     mutex_release_internal(m, reschedule, true);
@@ -18,6 +18,12 @@ MODULE_DEPS := \
 	kernel/lib/fbl \
 	kernel/vm
 
+# Lock contention profiling adds a check to every spinlock and mutex
+# acquisition, so it is only built in on request.
+ifeq ($(call TOBOOL,$(ENABLE_LOCKSTAT)),true)
+MODULE_DEPS += kernel/lib/lockstat
+endif
+
 MODULE_SRCS := \
 	$(LOCAL_DIR)/cmdline.c \
 	$(LOCAL_DIR)/debug.c \
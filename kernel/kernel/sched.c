@@ -10,6 +10,7 @@
 #include <debug.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/atomic.h>
 #include <kernel/mp.h>
 #include <kernel/percpu.h>
 #include <kernel/thread.h>
@@ -724,6 +725,7 @@ void sched_resched_internal(void) {
         oldthread->curr_cpu = INVALID_CPU;
     newthread->last_cpu = cpu;
     newthread->curr_cpu = cpu;
+    atomic_store_u64_relaxed(&percpu[cpu].running_thread, (uintptr_t)newthread);
 
     /* if we selected the idle thread the cpu's run queue must be empty, so mark the
      * cpu as idle */
@@ -43,6 +43,137 @@ void timer_init(timer_t* timer) {
     *timer = (timer_t)TIMER_INITIAL_VALUE(*timer);
 }
 
+// The per-cpu timer queue is a list sorted by scheduled_time, which makes
+// finding the next timer to fire trivial.  To avoid walking that list on
+// every insertion it is also indexed by a treap: a binary search tree on
+// scheduled_time whose in-order traversal matches the list, kept balanced
+// in expectation by a pseudo-random heap priority derived from each node's
+// address.  The tree hangs off the left child of a per-cpu sentinel, so
+// every queued node has a parent and can be unlinked without knowing which
+// cpu's queue it is on.
+
+static inline timer_t* tree_timer(struct timer_tree_node* n) {
+    return containerof(n, timer_t, tree);
+}
+
+static inline uint32_t tree_priority(const struct timer_tree_node* n) {
+    return (uint32_t)(((uint64_t)(uintptr_t)n * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+// Rotate |n| above its parent, preserving the in-order sequence.
+static void tree_rotate_up(struct timer_tree_node* n) {
+    struct timer_tree_node* p = n->parent;
+    struct timer_tree_node* g = p->parent;
+
+    if (p->left == n) {
+        p->left = n->right;
+        if (n->right)
+            n->right->parent = p;
+        n->right = p;
+    } else {
+        p->right = n->left;
+        if (n->left)
+            n->left->parent = p;
+        n->left = p;
+    }
+    p->parent = n;
+    n->parent = g;
+    if (g->left == p) {
+        g->left = n;
+    } else {
+        g->right = n;
+    }
+}
+
+// Link |n| into the tree rooted at |sentinel| immediately after |prev| in
+// order, or first if |prev| is NULL.
+static void tree_insert_after(struct timer_tree_node* sentinel, struct timer_tree_node* prev,
+                              struct timer_tree_node* n) {
+    struct timer_tree_node* p;
+
+    n->left = NULL;
+    n->right = NULL;
+    if (prev == NULL) {
+        p = sentinel;
+        while (p->left)
+            p = p->left;
+        p->left = n;
+    } else if (prev->right == NULL) {
+        p = prev;
+        p->right = n;
+    } else {
+        p = prev->right;
+        while (p->left)
+            p = p->left;
+        p->left = n;
+    }
+    n->parent = p;
+
+    uint32_t priority = tree_priority(n);
+    while (n->parent != sentinel && tree_priority(n->parent) < priority) {
+        tree_rotate_up(n);
+    }
+}
+
+static void tree_remove(struct timer_tree_node* n) {
+    // Rotate |n| down until it has at most one child, then splice it out.
+    while (n->left && n->right) {
+        if (tree_priority(n->left) > tree_priority(n->right)) {
+            tree_rotate_up(n->left);
+        } else {
+            tree_rotate_up(n->right);
+        }
+    }
+
+    struct timer_tree_node* child = n->left ? n->left : n->right;
+    struct timer_tree_node* p = n->parent;
+    if (p->left == n) {
+        p->left = child;
+    } else {
+        p->right = child;
+    }
+    if (child)
+        child->parent = p;
+
+    n->parent = NULL;
+    n->left = NULL;
+    n->right = NULL;
+}
+
+// Returns the first timer in |cpu|'s queue scheduled at or after |deadline|.
+static timer_t* timer_queue_lower_bound(uint cpu, zx_time_t deadline) {
+    struct timer_tree_node* n = percpu[cpu].timer_tree.left;
+    timer_t* result = NULL;
+
+    while (n) {
+        timer_t* entry = tree_timer(n);
+        if (entry->scheduled_time >= deadline) {
+            result = entry;
+            n = n->left;
+        } else {
+            n = n->right;
+        }
+    }
+    return result;
+}
+
+// Add |timer| to |cpu|'s queue right after |prev|, or at the head if |prev|
+// is NULL.  The caller is responsible for keeping the queue sorted.
+static void timer_queue_insert_after(uint cpu, timer_t* prev, timer_t* timer) {
+    if (prev == NULL) {
+        list_add_head(&percpu[cpu].timer_queue, &timer->node);
+        tree_insert_after(&percpu[cpu].timer_tree, NULL, &timer->tree);
+    } else {
+        list_add_after(&prev->node, &timer->node);
+        tree_insert_after(&percpu[cpu].timer_tree, &prev->tree, &timer->tree);
+    }
+}
+
+static void timer_queue_remove(timer_t* timer) {
+    list_delete(&timer->node);
+    tree_remove(&timer->tree);
+}
+
 static void insert_timer_in_queue(uint cpu, timer_t* timer,
                                   uint64_t early_slack, uint64_t late_slack) {
 
@@ -53,108 +184,70 @@ static void insert_timer_in_queue(uint cpu, timer_t* timer,
     zx_time_t latest_deadline = timer->scheduled_time + late_slack;
 
     // For inserting the timer we consider several cases. In general we
-    // want to coalesce with the current timer unless we can prove that
-    // either that:
-    //  1- there is no slack overlap with current timer OR
-    //  2- the next timer is a better fit.
+    // want to coalesce with a neighboring timer unless we can prove that
+    // there is no slack overlap with either of them.
     //
     // In diagrams that follow
-    // - Let |e| be the current (existing) timer deadline
+    // - Let |e| be the deadline of the last timer before the new one, if any
     // - Let |t| be the deadline of the timer we are inserting
-    // - Let |n| be the next timer deadline if any
-    // - Let |x| be the end of the list (not a timer)
+    // - Let |n| be the deadline of the first timer at or after it, if any
     // - Let |(| and |)| the earliest_deadline and latest_deadline.
     //
-    timer_t* entry;
-
-    list_for_every_entry (&percpu[cpu].timer_queue, entry, timer_t, node) {
-        if (entry->scheduled_time > latest_deadline) {
-            // New timer latest is earlier than the current timer.
-            // Just add upfront as is, without slack.
-            //
-            //   ---------t---)--e-------------------------------> time
-            //
-            timer->slack = 0ull;
-            list_add_before(&entry->node, &timer->node);
-            return;
-        }
-
-        if (entry->scheduled_time >= timer->scheduled_time) {
-            //  New timer slack overlaps and is to the left (or equal). We
-            //  coalesce with current by scheduling late.
-            //
-            //  --------(----t---e-)----------------------------> time
-            //
-            timer->slack = entry->scheduled_time - timer->scheduled_time;
-            timer->scheduled_time = entry->scheduled_time;
-            list_add_after(&entry->node, &timer->node);
-            return;
-        }
-
-        if (entry->scheduled_time < earliest_deadline) {
-            // new timer earliest is later than the current timer. This case
-            // is handled in a future iteration.
-            //
-            //   ----------------e--(---t-----------------------> time
-            //
-            continue;
-        }
-
-        // New timer is to the right of current timer and there is overlap
-        // with the current timer, but could the next timer (if any) be
-        // a better fit?
+    timer_t* next = timer_queue_lower_bound(cpu, timer->scheduled_time);
+    timer_t* entry = next ?
+        list_prev_type(&percpu[cpu].timer_queue, &next->node, timer_t, node) :
+        list_peek_tail_type(&percpu[cpu].timer_queue, timer_t, node);
+
+    if (entry != NULL && entry->scheduled_time >= earliest_deadline) {
+        // New timer is to the right of the previous timer and there is
+        // overlap with it, but could the next timer (if any) be a better
+        // fit?
         //
         //  -------------(--e---t-----?-------------------> time
         //
-
-        const timer_t* next =
-            list_next_type(&percpu[cpu].timer_queue, &entry->node, timer_t, node);
-
+        bool use_next = false;
         if (next != NULL) {
-            if (next->scheduled_time <= timer->scheduled_time) {
-                // The new timer is to the right of the next timer. There is no
-                // chance the current timer is a better fit.
-                //
-                //  -------------(--e---n---t----------------------> time
-                //
-                continue;
-            }
-
-            if (next->scheduled_time < latest_deadline) {
-                // There is slack overlap with the next timer, and also with the
-                // current timer. Which coalescing is a better match?
+            if (next->scheduled_time == timer->scheduled_time) {
+                // An exact match needs no adjustment at all.
+                use_next = true;
+            } else if (next->scheduled_time < latest_deadline) {
+                // There is slack overlap with the next timer, and also with
+                // the previous timer. Which coalescing is a better match?
                 //
                 //  --------------(-e---t---n-)-----------------------> time
                 //
                 zx_duration_t delta_entry = timer->scheduled_time - entry->scheduled_time;
                 zx_duration_t delta_next = next->scheduled_time - timer->scheduled_time;
-                if (delta_next < delta_entry) {
-                    // New timer is closer to the next timer, handle it in the
-                    // next iteration.
-                    continue;
-                }
+                use_next = delta_next < delta_entry;
             }
         }
 
-        // Handles the remaining cases, note that there is overlap with
-        // the current timer.
-        //
-        //  1- this is the last timer (next == NULL) or
-        //  2- there is no overlap with the next timer, or
-        //  3- there is overlap with both current and next but
-        //     current is closer.
+        if (!use_next) {
+            // Either there is no overlap with the next timer, or the
+            // previous timer is closer. So we coalesce by scheduling early.
+            timer->slack = entry->scheduled_time - timer->scheduled_time;
+            timer->scheduled_time = entry->scheduled_time;
+            timer_queue_insert_after(cpu, entry, timer);
+            return;
+        }
+    } else if (next == NULL || next->scheduled_time > latest_deadline) {
+        // No overlap on either side. Just add in place, without slack.
         //
-        //  So we coalesce by scheduling early.
+        //   ------e---(---t---)--n-------------------------> time
         //
-        timer->slack = entry->scheduled_time - timer->scheduled_time;
-        timer->scheduled_time = entry->scheduled_time;
-        list_add_after(&entry->node, &timer->node);
+        timer->slack = 0ull;
+        timer_queue_insert_after(cpu, entry, timer);
         return;
     }
 
-    // Walked off the end of the list and there was no overlap.
-    timer->slack = 0ull;
-    list_add_tail(&percpu[cpu].timer_queue, &timer->node);
+    // New timer slack overlaps the next timer, to its left (or equal). We
+    // coalesce with it by scheduling late.
+    //
+    //  --------(----t---n-)----------------------------> time
+    //
+    timer->slack = next->scheduled_time - timer->scheduled_time;
+    timer->scheduled_time = next->scheduled_time;
+    timer_queue_insert_after(cpu, next, timer);
 }
 
 void timer_set(timer_t* timer, zx_time_t deadline,
@@ -253,7 +346,7 @@ void timer_reset_oneshot_local(timer_t* timer, zx_time_t deadline, timer_callbac
 
     /* remove it from the queue if it was present */
     if (list_in_list(&timer->node))
-        list_delete(&timer->node);
+        timer_queue_remove(timer);
 
     /* set up the structure */
     timer->scheduled_time = deadline;
@@ -312,7 +405,7 @@ bool timer_cancel(timer_t* timer) {
         timer_t* oldhead = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
 
         /* remove our timer from the queue */
-        list_delete(&timer->node);
+        timer_queue_remove(timer);
 
         /* TODO(cpu): if  after removing |timer| there is one other single timer with
            the same scheduled_time and slack non-zero then it is possible to return
@@ -377,7 +470,7 @@ void timer_tick(zx_time_t now) {
         DEBUG_ASSERT_MSG(timer && timer->magic == TIMER_MAGIC,
                          "ASSERT: timer failed magic check: timer %p, magic 0x%x\n",
                          timer, (uint)timer->magic);
-        list_delete(&timer->node);
+        timer_queue_remove(timer);
 
         /* mark the timer busy */
         timer->active_cpu = cpu;
@@ -447,7 +540,7 @@ void timer_transition_off_cpu(uint old_cpu) {
     timer_t *entry = NULL, *tmp_entry = NULL;
     /* Move all timers from old_cpu to this cpu */
     list_for_every_entry_safe (&percpu[old_cpu].timer_queue, entry, tmp_entry, timer_t, node) {
-        list_delete(&entry->node);
+        timer_queue_remove(entry);
         // We lost the original asymmetric slack information so when we combine them
         // with the other timer queue they are not coalesced again.
         // TODO(cpu): figure how important this case is.
@@ -483,6 +576,7 @@ void timer_queue_init(void) {
     timer_lock = SPIN_LOCK_INITIAL_VALUE;
     for (uint i = 0; i < SMP_MAX_CPUS; i++) {
         list_initialize(&percpu[i].timer_queue);
+        percpu[i].timer_tree = (struct timer_tree_node){NULL, NULL, NULL};
     }
 }
 
@@ -15,6 +15,7 @@ KERNEL_INCLUDES += $(SRC_DIR)/include
 MODULE_DEPS := kernel/lib/fbl
 
 MODULE_SRCS := \
+    $(SRC_DIR)/hierarchical-bitmap.cpp \
     $(SRC_DIR)/raw-bitmap.cpp \
     $(SRC_DIR)/rle-bitmap.cpp \
 
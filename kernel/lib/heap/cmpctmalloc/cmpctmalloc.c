@@ -943,26 +943,13 @@ void cmpct_trim(void) {
     unlock();
 }
 
-void* cmpct_alloc(size_t size) {
-    if (size == 0u) {
-        return NULL;
-    }
-
-    // TODO(dbort): Look into the large vs. small threshold. A "small"
-    // allocation of 0x3ff000 and a "large" allocation of 0x400000 will both
-    // allocate 0x401000 bytes from the OS; seems like there should be a sharper
-    // distinction. The problem seems to be that growby is rounded up to a
-    // bucket size, then heap_grow adds 2*header_t and rounds up to a page.
-    if (size + sizeof(header_t) > HEAP_LARGE_ALLOC_BYTES) {
-        return large_alloc(size);
-    }
-
+// Allocates a non-large memory area with at least |size| usable bytes.
+static void* alloc_locked(size_t size) TA_REQ(theheap.lock) {
     size_t rounded_up;
     int start_bucket = size_to_index_allocating(size, &rounded_up);
 
     rounded_up += sizeof(header_t);
 
-    lock();
     int bucket = find_nonempty_bucket(start_bucket);
     if (bucket == -1) {
         // Grow heap by at least 12% if we can.
@@ -973,7 +960,6 @@ void* cmpct_alloc(size_t size) {
         // we succeed or get too small.
         while (heap_grow(growby, NULL) < 0) {
             if (growby <= rounded_up) {
-                unlock();
                 return NULL;
             }
             growby = MAX(growby >> 1, rounded_up);
@@ -1005,10 +991,46 @@ void* cmpct_alloc(size_t size) {
     memset(((char*)result) + size, PADDING_FILL,
            rounded_up - size - sizeof(header_t));
 #endif
+    return result;
+}
+
+void* cmpct_alloc(size_t size) {
+    if (size == 0u) {
+        return NULL;
+    }
+
+    // TODO(dbort): Look into the large vs. small threshold. A "small"
+    // allocation of 0x3ff000 and a "large" allocation of 0x400000 will both
+    // allocate 0x401000 bytes from the OS; seems like there should be a sharper
+    // distinction. The problem seems to be that growby is rounded up to a
+    // bucket size, then heap_grow adds 2*header_t and rounds up to a page.
+    if (size + sizeof(header_t) > HEAP_LARGE_ALLOC_BYTES) {
+        return large_alloc(size);
+    }
+
+    lock();
+    void* result = alloc_locked(size);
     unlock();
     return result;
 }
 
+size_t cmpct_alloc_batch(size_t size, void** ptrs, size_t count) {
+    DEBUG_ASSERT(size > 0u);
+    DEBUG_ASSERT(size + sizeof(header_t) <= HEAP_LARGE_ALLOC_BYTES);
+
+    size_t allocated = 0;
+    lock();
+    while (allocated < count) {
+        void* result = alloc_locked(size);
+        if (result == NULL) {
+            break;
+        }
+        ptrs[allocated++] = result;
+    }
+    unlock();
+    return allocated;
+}
+
 void* cmpct_memalign(size_t size, size_t alignment) {
     if (alignment < 8) {
         return cmpct_alloc(size);
@@ -1039,14 +1061,10 @@ void* cmpct_memalign(size_t size, size_t alignment) {
     return payload;
 }
 
-void cmpct_free(void* payload) {
-    if (payload == NULL) {
-        return;
-    }
+static void free_locked(void* payload) TA_REQ(theheap.lock) {
     header_t* header = (header_t*)payload - 1;
     DEBUG_ASSERT(!is_tagged_as_free(header)); // Double free!
     size_t size = header->size;
-    lock();
     header_t* left = header->left;
     if (left != NULL && is_tagged_as_free(left)) {
         // Coalesce with left free object.
@@ -1075,9 +1093,33 @@ void cmpct_free(void* payload) {
             free_memory(header, left, size);
         }
     }
+}
+
+void cmpct_free(void* payload) {
+    if (payload == NULL) {
+        return;
+    }
+    lock();
+    free_locked(payload);
     unlock();
 }
 
+void cmpct_free_batch(void** ptrs, size_t count) {
+    lock();
+    for (size_t i = 0; i < count; i++) {
+        if (ptrs[i] != NULL) {
+            free_locked(ptrs[i]);
+        }
+    }
+    unlock();
+}
+
+size_t cmpct_usable_size(const void* payload) {
+    const header_t* header = (const header_t*)payload - 1;
+    DEBUG_ASSERT(!is_tagged_as_free(header));
+    return header->size - sizeof(header_t);
+}
+
 void* cmpct_realloc(void* payload, size_t size) {
     if (payload == NULL) {
         return cmpct_alloc(size);
@@ -19,6 +19,16 @@ void* cmpct_realloc(void*, size_t);
 void cmpct_free(void*);
 void* cmpct_memalign(size_t size, size_t alignment);
 
+// Allocates up to |count| areas of at least |size| bytes each into |ptrs|,
+// taking the heap lock only once.  |size| must not require a large
+// allocation.  Returns the number of areas allocated.
+size_t cmpct_alloc_batch(size_t size, void** ptrs, size_t count);
+// Frees the |count| areas in |ptrs|, taking the heap lock only once.
+void cmpct_free_batch(void** ptrs, size_t count);
+// Returns the number of usable bytes in an allocated area, which may be more
+// than were asked for.
+size_t cmpct_usable_size(const void* payload);
+
 void cmpct_init(void);
 void cmpct_dump(bool panic_time);
 void cmpct_get_info(size_t* size_bytes, size_t* free_bytes);
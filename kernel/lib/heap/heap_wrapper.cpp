@@ -15,10 +15,13 @@
 #include <err.h>
 #include <list.h>
 #include <arch/ops.h>
+#include <kernel/align.h>
 #include <kernel/spinlock.h>
 #include <vm/vm.h>
 #include <vm/pmm.h>
 #include <lib/cmpctmalloc.h>
+#include <fbl/algorithm.h>
+#include <inttypes.h>
 #include <lib/console.h>
 
 #define LOCAL_TRACE 0
@@ -38,23 +41,239 @@ static bool heap_trace = false;
 #define heap_trace (false)
 #endif
 
+/* Per-cpu cache of small blocks in front of cmpctmalloc.
+ *
+ * Every cmpctmalloc call takes the global heap mutex.  To keep small
+ * allocations from serializing across cpus, each cpu holds a magazine of
+ * already-allocated blocks per size class, which malloc and free use under a
+ * per-cpu spinlock.  A magazine that runs dry is refilled, and one that
+ * overflows is half drained, in batches that take the heap mutex once.
+ */
+#ifndef HEAP_CACHE
+#define HEAP_CACHE 1
+#endif
+
+namespace {
+
+/* size classes are multiples of the granule, up to the max */
+constexpr size_t kCacheGranule = 16;
+constexpr size_t kCacheMaxSize = 256;
+constexpr size_t kCacheClasses = kCacheMaxSize / kCacheGranule;
+
+/* blocks held per size class per cpu, and moved to or from the heap at once */
+constexpr size_t kMagazineSize = 16;
+constexpr size_t kBatchSize = kMagazineSize / 2;
+
+struct heap_magazine {
+    size_t count;
+    void *blocks[kMagazineSize];
+};
+
+struct heap_cache {
+    spin_lock_t lock;
+    heap_magazine magazines[kCacheClasses];
+
+    /* statistics, protected by |lock| */
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t refills;
+    uint64_t drains;
+} __CPU_ALIGN;
+
+heap_cache caches[SMP_MAX_CPUS];
+
+/* the size class a request for |size| bytes is served from */
+size_t alloc_class(size_t size)
+{
+    return (size - 1) / kCacheGranule;
+}
+
+/* the size class a block with |usable| bytes can serve, which is rounded
+ * down so that every block in a class is at least as big as the class */
+size_t free_class(size_t usable)
+{
+    return fbl::min(usable / kCacheGranule, kCacheClasses) - 1;
+}
+
+/* disables interrupts and locks the current cpu's cache */
+heap_cache *lock_local_cache(spin_lock_saved_state_t *state) TA_NO_THREAD_SAFETY_ANALYSIS
+{
+    arch_interrupt_save(state, SPIN_LOCK_FLAG_INTERRUPTS);
+    heap_cache *cache = &caches[arch_curr_cpu_num()];
+    spin_lock(&cache->lock);
+    return cache;
+}
+
+void unlock_cache(heap_cache *cache, spin_lock_saved_state_t state) TA_NO_THREAD_SAFETY_ANALYSIS
+{
+    spin_unlock(&cache->lock);
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+}
+
+void *cache_alloc(size_t size)
+{
+    size_t cls = alloc_class(size);
+
+    spin_lock_saved_state_t state;
+    heap_cache *cache = lock_local_cache(&state);
+    heap_magazine *mag = &cache->magazines[cls];
+    if (likely(mag->count > 0)) {
+        void *ptr = mag->blocks[--mag->count];
+        cache->hits++;
+        unlock_cache(cache, state);
+        return ptr;
+    }
+    cache->misses++;
+    unlock_cache(cache, state);
+
+    /* keep the first block for the caller and stash the rest in whichever
+     * cpu we are running on by now */
+    void *blocks[kBatchSize];
+    size_t count = cmpct_alloc_batch((cls + 1) * kCacheGranule, blocks, kBatchSize);
+    if (count == 0) {
+        return NULL;
+    }
+
+    size_t i = 1;
+    cache = lock_local_cache(&state);
+    cache->refills++;
+    mag = &cache->magazines[cls];
+    while (i < count && mag->count < kMagazineSize) {
+        mag->blocks[mag->count++] = blocks[i++];
+    }
+    unlock_cache(cache, state);
+
+    if (i < count) {
+        cmpct_free_batch(blocks + i, count - i);
+    }
+    return blocks[0];
+}
+
+void cache_free(void *ptr)
+{
+    size_t usable = cmpct_usable_size(ptr);
+    if (usable < kCacheGranule || usable >= kCacheMaxSize + kCacheGranule) {
+        cmpct_free(ptr);
+        return;
+    }
+    size_t cls = free_class(usable);
+
+    spin_lock_saved_state_t state;
+    heap_cache *cache = lock_local_cache(&state);
+    heap_magazine *mag = &cache->magazines[cls];
+    if (likely(mag->count < kMagazineSize)) {
+        mag->blocks[mag->count++] = ptr;
+        unlock_cache(cache, state);
+        return;
+    }
+
+    /* the magazine is full: hand its oldest half back to the heap */
+    void *blocks[kBatchSize];
+    memcpy(blocks, mag->blocks, sizeof(blocks));
+    memmove(mag->blocks, mag->blocks + kBatchSize,
+            (kMagazineSize - kBatchSize) * sizeof(void *));
+    mag->count -= kBatchSize;
+    mag->blocks[mag->count++] = ptr;
+    cache->drains++;
+    unlock_cache(cache, state);
+
+    cmpct_free_batch(blocks, kBatchSize);
+}
+
+/* return every cached block to the heap */
+void cache_drain_all(void)
+{
+    for (uint cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        heap_cache *cache = &caches[cpu];
+        for (size_t cls = 0; cls < kCacheClasses; cls++) {
+            void *blocks[kMagazineSize];
+
+            spin_lock_saved_state_t state;
+            spin_lock_irqsave(&cache->lock, state);
+            heap_magazine *mag = &cache->magazines[cls];
+            size_t count = mag->count;
+            memcpy(blocks, mag->blocks, count * sizeof(void *));
+            mag->count = 0;
+            spin_unlock_irqrestore(&cache->lock, state);
+
+            if (count > 0) {
+                cmpct_free_batch(blocks, count);
+            }
+        }
+    }
+}
+
+/* bytes held in cpu caches, which the heap counts as allocated */
+size_t cache_bytes(void)
+{
+    size_t bytes = 0;
+    for (uint cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        heap_cache *cache = &caches[cpu];
+
+        spin_lock_saved_state_t state;
+        spin_lock_irqsave(&cache->lock, state);
+        for (size_t cls = 0; cls < kCacheClasses; cls++) {
+            heap_magazine *mag = &cache->magazines[cls];
+            for (size_t i = 0; i < mag->count; i++) {
+                bytes += cmpct_usable_size(mag->blocks[i]);
+            }
+        }
+        spin_unlock_irqrestore(&cache->lock, state);
+    }
+    return bytes;
+}
+
+void cache_dump(void)
+{
+    printf("	per-cpu cache:\n");
+    for (uint cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        heap_cache *cache = &caches[cpu];
+        if (cache->hits + cache->misses == 0) {
+            continue;
+        }
+        size_t cached = 0;
+        for (size_t cls = 0; cls < kCacheClasses; cls++) {
+            cached += cache->magazines[cls].count;
+        }
+        printf("		cpu %u: hits %" PRIu64 " misses %" PRIu64 " refills %" PRIu64
+               " drains %" PRIu64 " cached blocks %zu\n",
+               cpu, cache->hits, cache->misses, cache->refills, cache->drains, cached);
+    }
+}
+
+} // namespace
+
 void heap_init(void)
 {
+    for (uint cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        spin_lock_init(&caches[cpu].lock);
+    }
     cmpct_init();
 }
 
 void heap_trim(void)
 {
+    if (HEAP_CACHE) {
+        cache_drain_all();
+    }
     cmpct_trim();
 }
 
+static void *heap_alloc(size_t size)
+{
+    if (HEAP_CACHE && size != 0 && size <= kCacheMaxSize) {
+        return cache_alloc(size);
+    }
+    return cmpct_alloc(size);
+}
+
 void *malloc(size_t size)
 {
     DEBUG_ASSERT(!arch_in_int_handler());
 
     LTRACEF("size %zu\n", size);
 
-    void *ptr = cmpct_alloc(size);
+    void *ptr = heap_alloc(size);
     if (unlikely(heap_trace))
         printf("caller %p malloc %zu -> %p\n", __GET_CALLER(), size, ptr);
 
@@ -90,7 +309,7 @@ void *calloc(size_t count, size_t size)
 
     size_t realsize = count * size;
 
-    void *ptr = cmpct_alloc(realsize);
+    void *ptr = heap_alloc(realsize);
     if (likely(ptr))
         memset(ptr, 0, realsize);
     if (unlikely(heap_trace))
@@ -123,16 +342,26 @@ void free(void *ptr)
     if (unlikely(heap_trace))
         printf("caller %p free %p\n", __GET_CALLER(), ptr);
 
-    cmpct_free(ptr);
+    if (HEAP_CACHE && ptr != NULL) {
+        cache_free(ptr);
+    } else {
+        cmpct_free(ptr);
+    }
 }
 
 static void heap_dump(bool panic_time)
 {
     cmpct_dump(panic_time);
+    if (HEAP_CACHE) {
+        cache_dump();
+    }
 }
 
 void heap_get_info(size_t *size_bytes, size_t *free_bytes) {
     cmpct_get_info(size_bytes, free_bytes);
+    if (HEAP_CACHE) {
+        *free_bytes += cache_bytes();
+    }
 }
 
 static void heap_test(void)
@@ -6,12 +6,17 @@
 
 #include <debug.h>
 #include <err.h>
+#include <limits.h>
 #include <platform.h>
 #include <string.h>
 
 #include <arch/ops.h>
 #include <arch/user_copy.h>
+#include <fbl/algorithm.h>
+#include <kernel/atomic.h>
+#include <kernel/auto_lock.h>
 #include <kernel/cmdline.h>
+#include <kernel/spinlock.h>
 #include <vm/vm_aspace.h>
 #include <lib/ktrace.h>
 #include <lk/init.h>
@@ -21,6 +26,9 @@
 #define ktrace_timestamp() current_ticks();
 #define ktrace_ticks_per_ms() (ticks_per_second() / 1000)
 
+// size of the buffer shared by name records
+#define KTRACE_NAMES_BUFSIZE (256 * 1024)
+
 static void ktrace_name_etc(uint32_t tag, uint32_t id, uint32_t arg, const char* name, bool always);
 
 // Generated struct that has the syscall index and name.
@@ -76,59 +84,378 @@ static void ktrace_report_probes(void) {
     }
 }
 
-typedef struct ktrace_state {
-    // where the next record will be written
-    int offset;
+// A ring of trace records.  Each cpu writes to its own buffer with interrupts
+// disabled, so that writers never contend with each other; name records are
+// rare and go to a shared buffer under |names_lock|.
+//
+// |head| and |tail| are free-running byte counts: the records live in
+// [tail, head), at (position & mask) in |data|, and may wrap around the end.
+typedef struct ktrace_buffer {
+    uint8_t* data;
+    uint32_t mask;
+
+    // where the next record will be written, only advanced by the writer
+    uint64_t head;
+
+    // oldest record still held, advanced by the writer when a circular
+    // buffer wraps and by the reader when streaming
+    uint64_t tail;
+
+    // records discarded because the buffer was full
+    uint64_t dropped;
+
+    // range held when tracing was stopped, valid while ks->marker is set
+    uint64_t marker_tail;
+    uint64_t marker_head;
+
+    // rewind generation the buffer was last reset for
+    int gen;
 
+    // set while a circular buffer's writer is discarding old records
+    int discarding;
+} __ALIGNED(MAX_CACHE_LINE) ktrace_buffer_t;
+
+typedef struct ktrace_state {
     // mask of groups we allow, 0 == tracing disabled
     int grpmask;
 
-    // total size of the trace buffer
-    uint32_t bufsize;
+    // KTRACE_MODE_* value
+    uint32_t mode;
 
-    // offset where tracing was stopped, 0 if tracing active
+    // bumped by every rewind; cpu buffers reset themselves lazily
+    int gen;
+
+    // nonzero if tracing was stopped and the buffers hold a finished trace
     uint32_t marker;
 
-    // raw trace buffer
-    uint8_t* buffer;
+    // set while a linear read copies out live circular buffers
+    int linear_reading;
+
+    // true if the metadata records have not been streamed since the last rewind
+    bool header_pending;
+
+    // next stream the streaming reader starts from, for fairness
+    uint32_t next_stream;
+
+    uint32_t num_cpus;
+
+    // the VERSION and TICKS_PER_MS records which begin every trace
+    ktrace_rec_32b_t header[2];
+
+    spin_lock_t names_lock;
+    ktrace_buffer_t names;
+    ktrace_buffer_t cpus[SMP_MAX_CPUS];
 } ktrace_state_t;
 
 static ktrace_state_t KTRACE_STATE;
 
-int ktrace_read_user(void* ptr, uint32_t off, uint32_t len) {
+// serializes readers; the streaming reader consumes records
+static fbl::Mutex read_lock;
+
+static uint32_t ktrace_buffer_tag(const ktrace_buffer_t* kb, uint64_t pos) {
+    return *reinterpret_cast<const uint32_t*>(kb->data + (pos & kb->mask));
+}
+
+static void ktrace_buffer_reset(ktrace_buffer_t* kb, int gen) {
+    atomic_store_u64(&kb->tail, 0);
+    atomic_store_u64(&kb->head, 0);
+    atomic_swap_u64(&kb->dropped, 0);
+    atomic_store(&kb->gen, gen);
+}
+
+// Appends a complete record to |kb|.  The caller must be the only writer of
+// |kb|: the owning cpu with interrupts disabled, or a holder of |names_lock|.
+static bool ktrace_buffer_append(ktrace_state_t* ks, ktrace_buffer_t* kb,
+                                 const void* rec, uint32_t len) {
+    if (kb->data == nullptr) {
+        return false;
+    }
+
+    uint64_t head = kb->head;
+    uint64_t tail = atomic_load_u64(&kb->tail);
+    uint64_t size = static_cast<uint64_t>(kb->mask) + 1;
+    bool discard = false;
+    if (head + len - tail > size) {
+        if (kb == &ks->names || ks->mode == KTRACE_MODE_STREAMING) {
+            // names must survive, and the reader will catch up with the
+            // stream; either way, drop this record and let the reader know
+            atomic_add_u64_relaxed(&kb->dropped, 1);
+            return false;
+        }
+        if (ks->mode != KTRACE_MODE_CIRCULAR) {
+            // if we arrive at the end, stop
+            atomic_store(&ks->grpmask, 0);
+            return false;
+        }
+        // flight recorder: make room by discarding the oldest records,
+        // unless a reader is copying them out (see ktrace_read_linear)
+        discard = true;
+        atomic_store(&kb->discarding, 1);
+        if (atomic_load(&ks->linear_reading)) {
+            atomic_store(&kb->discarding, 0);
+            atomic_add_u64_relaxed(&kb->dropped, 1);
+            return false;
+        }
+        do {
+            tail += KTRACE_LEN(ktrace_buffer_tag(kb, tail));
+        } while (head + len - tail > size);
+        atomic_store_u64(&kb->tail, tail);
+    }
+
+    uint32_t off = static_cast<uint32_t>(head & kb->mask);
+    uint32_t first = fbl::min(len, static_cast<uint32_t>(size - off));
+    memcpy(kb->data + off, rec, first);
+    memcpy(kb->data, static_cast<const uint8_t*>(rec) + first, len - first);
+
+    // publish the record to the reader
+    atomic_store_u64(&kb->head, head + len);
+    if (discard) {
+        atomic_store(&kb->discarding, 0);
+    }
+    return true;
+}
+
+// Writes |rec| to the current cpu's buffer, stamping it with the time.  The
+// timestamp is taken with interrupts disabled so that each per-cpu stream is
+// in timestamp order.
+static bool ktrace_append(ktrace_header_t* rec, uint32_t len) {
     ktrace_state_t* ks = &KTRACE_STATE;
 
-    // Buffer size is limited by the marker if set,
-    // otherwise limited by offset (last written point).
-    // Offset can end up pointing past the end, so clip
-    // it to the actual buffer size to be safe.
-    uint32_t max;
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+    ktrace_buffer_t* kb = &ks->cpus[arch_curr_cpu_num()];
+    int gen = atomic_load(&ks->gen);
+    if (kb->gen != gen) {
+        ktrace_buffer_reset(kb, gen);
+    }
+    rec->ts = ktrace_timestamp();
+    bool ok = ktrace_buffer_append(ks, kb, rec, len);
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+    return ok;
+}
+
+// Returns the range of records to report for |kb| from a read.
+static void ktrace_buffer_range(ktrace_state_t* ks, ktrace_buffer_t* kb,
+                                uint64_t* tail, uint64_t* head) {
     if (ks->marker) {
-        max = ks->marker;
+        *tail = kb->marker_tail;
+        *head = kb->marker_head;
+    } else if (atomic_load(&kb->gen) != atomic_load(&ks->gen)) {
+        *tail = *head = 0;
+    } else {
+        *head = atomic_load_u64(&kb->head);
+        *tail = atomic_load_u64(&kb->tail);
+    }
+}
+
+// Copies |len| bytes of |kb| starting at position |pos| to user memory.
+static zx_status_t ktrace_buffer_copy_to_user(const ktrace_buffer_t* kb, uint8_t* ptr,
+                                              uint64_t pos, uint32_t len) {
+    uint64_t size = static_cast<uint64_t>(kb->mask) + 1;
+    uint32_t off = static_cast<uint32_t>(pos & kb->mask);
+    uint32_t first = fbl::min(len, static_cast<uint32_t>(size - off));
+    zx_status_t status = arch_copy_to_user(ptr, kb->data + off, first);
+    if (status == ZX_OK && first < len) {
+        status = arch_copy_to_user(ptr + first, kb->data, len - first);
+    }
+    return status;
+}
+
+static ktrace_buffer_t* ktrace_stream(ktrace_state_t* ks, uint32_t index) {
+    return index == 0 ? &ks->names : &ks->cpus[index - 1];
+}
+
+static uint32_t ktrace_stream_id(ktrace_state_t* ks, uint32_t index) {
+    return index == 0 ? KTRACE_STREAM_NAMES : index - 1;
+}
+
+static void ktrace_stream_record(ktrace_rec_32b_t* rec, uint32_t stream, uint32_t bytes,
+                                 uint64_t dropped) {
+    memset(rec, 0, sizeof(*rec));
+    rec->tag = TAG_STREAM;
+    rec->a = stream;
+    rec->b = bytes;
+    rec->c = static_cast<uint32_t>(fbl::min(dropped, static_cast<uint64_t>(UINT32_MAX)));
+}
+
+// Copies the part of |src| which lies within [off, off + len) of the trace,
+// given that |src| sits at |*pos|, and advances |*pos| past it.
+static zx_status_t ktrace_read_piece(uint8_t* ptr, uint32_t off, uint32_t len, uint64_t* pos,
+                                     uint32_t size, const ktrace_buffer_t* kb, uint64_t kb_pos,
+                                     const void* src, uint32_t* actual) {
+    uint64_t start = *pos;
+    *pos += size;
+    uint64_t end = static_cast<uint64_t>(off) + len;
+    if (start >= end || *pos <= off) {
+        return ZX_OK;
+    }
+    uint32_t skip = static_cast<uint32_t>(off > start ? off - start : 0);
+    uint32_t count = static_cast<uint32_t>(fbl::min(*pos, end) - start) - skip;
+    uint8_t* dst = ptr + (start + skip - off);
+    zx_status_t status;
+    if (kb != nullptr) {
+        status = ktrace_buffer_copy_to_user(kb, dst, kb_pos + skip, count);
     } else {
-        max = ks->offset;
-        if (max > ks->bufsize) {
-            max = ks->bufsize;
+        status = arch_copy_to_user(dst, static_cast<const uint8_t*>(src) + skip, count);
+    }
+    *actual += count;
+    return status;
+}
+
+// Reads the trace as one stream: the metadata records, then for each of the
+// name and per-cpu buffers a TAG_STREAM record followed by its records,
+// oldest first.  Each buffer's records are in timestamp order, but the
+// buffers are not merged; readers sort them out.
+//
+// While tracing is live, a circular buffer's writer could overwrite the
+// oldest records as they are being copied out.  For the length of the read,
+// writers of full circular buffers drop new records instead.  Each writer
+// raises |discarding| before it checks |linear_reading|, and the reader
+// raises |linear_reading| before it waits for |discarding| to clear, so
+// either the writer drops its record or the reader sees the records it
+// discarded gone.
+static int ktrace_read_linear(ktrace_state_t* ks, uint8_t* ptr, uint32_t off, uint32_t len) {
+    uint64_t pos = 0;
+    uint32_t actual = 0;
+    zx_status_t status = ZX_OK;
+    bool guard = ptr != nullptr && ks->mode == KTRACE_MODE_CIRCULAR && !ks->marker;
+    if (guard) {
+        atomic_store(&ks->linear_reading, 1);
+    }
+    if (ptr != nullptr) {
+        status = ktrace_read_piece(ptr, off, len, &pos, sizeof(ks->header), nullptr, 0,
+                                   ks->header, &actual);
+    } else {
+        pos += sizeof(ks->header);
+    }
+
+    for (uint32_t i = 0; i <= ks->num_cpus && status == ZX_OK; i++) {
+        ktrace_buffer_t* kb = ktrace_stream(ks, i);
+        if (guard) {
+            while (atomic_load(&kb->discarding)) {
+                arch_spinloop_pause();
+            }
+        }
+        uint64_t tail, head;
+        ktrace_buffer_range(ks, kb, &tail, &head);
+        uint32_t bytes = static_cast<uint32_t>(head - tail);
+        if (bytes == 0) {
+            continue;
+        }
+        if (ptr == nullptr) {
+            pos += KTRACE_RECSIZE + bytes;
+            continue;
+        }
+        ktrace_rec_32b_t rec;
+        ktrace_stream_record(&rec, ktrace_stream_id(ks, i), bytes, atomic_load_u64(&kb->dropped));
+        status = ktrace_read_piece(ptr, off, len, &pos, KTRACE_RECSIZE, nullptr, 0, &rec, &actual);
+        if (status == ZX_OK) {
+            status = ktrace_read_piece(ptr, off, len, &pos, bytes, kb, tail, nullptr, &actual);
         }
     }
+    if (guard) {
+        atomic_store(&ks->linear_reading, 0);
+    }
 
+    if (status != ZX_OK) {
+        return ZX_ERR_INVALID_ARGS;
+    }
     // null read is a query for trace buffer size
     if (ptr == nullptr) {
-        return max;
+        return static_cast<int>(fbl::min(pos, static_cast<uint64_t>(INT_MAX)));
     }
+    return actual;
+}
 
-    // constrain read to available buffer
-    if (off >= max) {
-        return 0;
+// Consumes as many whole records as fit in |len| bytes, the writers carrying
+// on meanwhile.  The offset is ignored: each read returns the records which
+// follow those returned by the previous one.
+static int ktrace_read_streaming(ktrace_state_t* ks, uint8_t* ptr, uint32_t len) {
+    uint32_t actual = 0;
+    if (ptr == nullptr) {
+        uint64_t avail = ks->header_pending ? sizeof(ks->header) : 0;
+        for (uint32_t i = 0; i <= ks->num_cpus; i++) {
+            ktrace_buffer_t* kb = ktrace_stream(ks, i);
+            uint64_t tail, head;
+            ktrace_buffer_range(ks, kb, &tail, &head);
+            if (head != tail) {
+                avail += KTRACE_RECSIZE + (head - tail);
+            }
+        }
+        return static_cast<int>(fbl::min(avail, static_cast<uint64_t>(INT_MAX)));
     }
-    if (len > (max - off)) {
-        len = max - off;
+
+    if (ks->header_pending) {
+        if (len < sizeof(ks->header)) {
+            return 0;
+        }
+        if (arch_copy_to_user(ptr, ks->header, sizeof(ks->header)) != ZX_OK) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        ks->header_pending = false;
+        actual += sizeof(ks->header);
     }
 
-    if (arch_copy_to_user(ptr, ks->buffer + off, len) != ZX_OK) {
-        return ZX_ERR_INVALID_ARGS;
+    uint32_t count = ks->num_cpus + 1;
+    for (uint32_t n = 0; n < count; n++) {
+        uint32_t i = (ks->next_stream + n) % count;
+        ktrace_buffer_t* kb = ktrace_stream(ks, i);
+        uint64_t tail, head;
+        ktrace_buffer_range(ks, kb, &tail, &head);
+        if (head == tail || len - actual < KTRACE_RECSIZE) {
+            continue;
+        }
+
+        // only hand out whole records
+        uint32_t room = len - actual - KTRACE_RECSIZE;
+        uint64_t end = tail;
+        while (end < head) {
+            uint32_t rec_len = KTRACE_LEN(ktrace_buffer_tag(kb, end));
+            if (end + rec_len - tail > room) {
+                break;
+            }
+            end += rec_len;
+        }
+        if (end == tail) {
+            continue;
+        }
+
+        uint32_t bytes = static_cast<uint32_t>(end - tail);
+        ktrace_rec_32b_t rec;
+        ktrace_stream_record(&rec, ktrace_stream_id(ks, i), bytes,
+                             atomic_swap_u64(&kb->dropped, 0));
+        if (arch_copy_to_user(ptr + actual, &rec, sizeof(rec)) != ZX_OK ||
+            ktrace_buffer_copy_to_user(kb, ptr + actual + KTRACE_RECSIZE, tail, bytes) != ZX_OK) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        // if the writer rewound the buffer meanwhile, leave it be
+        atomic_cmpxchg_u64(&kb->tail, &tail, end);
+        actual += KTRACE_RECSIZE + bytes;
+    }
+    ks->next_stream = (ks->next_stream + 1) % count;
+    return actual;
+}
+
+int ktrace_read_user(void* ptr, uint32_t off, uint32_t len) {
+    ktrace_state_t* ks = &KTRACE_STATE;
+    fbl::AutoLock lock(&read_lock);
+
+    if (ks->mode == KTRACE_MODE_STREAMING) {
+        return ktrace_read_streaming(ks, static_cast<uint8_t*>(ptr), len);
+    }
+    return ktrace_read_linear(ks, static_cast<uint8_t*>(ptr), off, len);
+}
+
+static void ktrace_rewind(ktrace_state_t* ks) {
+    // cpu buffers are reset by their owners on their next write
+    atomic_add(&ks->gen, 1);
+    {
+        AutoSpinLock lock(&ks->names_lock);
+        ktrace_buffer_reset(&ks->names, atomic_load(&ks->gen));
     }
-    return len;
+    ks->header_pending = true;
+    ktrace_report_syscalls(kt_syscall_info);
+    ktrace_report_probes();
 }
 
 zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr) {
@@ -143,19 +470,23 @@ zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr) {
         break;
     case KTRACE_ACTION_STOP: {
         atomic_store(&ks->grpmask, 0);
-        uint32_t n = ks->offset;
-        if (n > ks->bufsize) {
-            ks->marker = ks->bufsize;
-        } else {
-            ks->marker = n;
+        if (ks->mode == KTRACE_MODE_STREAMING) {
+            // the reader drains whatever is left
+            break;
+        }
+        // hold on to what was traced until tracing starts again,
+        // even if the buffers are rewound meanwhile
+        fbl::AutoLock lock(&read_lock);
+        ks->marker = 0;
+        for (uint32_t i = 0; i <= ks->num_cpus; i++) {
+            ktrace_buffer_t* kb = ktrace_stream(ks, i);
+            ktrace_buffer_range(ks, kb, &kb->marker_tail, &kb->marker_head);
         }
+        ks->marker = 1;
         break;
     }
     case KTRACE_ACTION_REWIND:
-        // roll back to just after the metadata
-        atomic_store(&ks->offset, KTRACE_RECSIZE * 2);
-        ktrace_report_syscalls(kt_syscall_info);
-        ktrace_report_probes();
+        ktrace_rewind(ks);
         break;
     case KTRACE_ACTION_NEW_PROBE: {
         fbl::AutoLock lock(&probe_list_lock);
@@ -172,6 +503,19 @@ zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr) {
         ktrace_add_probe(probe);
         return probe->num;
     }
+    case KTRACE_ACTION_SET_MODE: {
+        if (options > KTRACE_MODE_STREAMING) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        if (atomic_load(&ks->grpmask)) {
+            return ZX_ERR_BAD_STATE;
+        }
+        fbl::AutoLock lock(&read_lock);
+        ks->mode = options;
+        ks->marker = 0;
+        ktrace_rewind(ks);
+        break;
+    }
     default:
         return ZX_ERR_INVALID_ARGS;
     }
@@ -180,6 +524,29 @@ zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr) {
 
 int trace_not_ready = 0;
 
+static uint32_t ktrace_mode_from_cmdline(void) {
+    const char* mode = cmdline_get("ktrace.mode");
+    if (mode == nullptr || !strcmp(mode, "oneshot")) {
+        return KTRACE_MODE_ONESHOT;
+    }
+    if (!strcmp(mode, "circular")) {
+        return KTRACE_MODE_CIRCULAR;
+    }
+    if (!strcmp(mode, "streaming")) {
+        return KTRACE_MODE_STREAMING;
+    }
+    dprintf(INFO, "ktrace: unknown mode '%s'\n", mode);
+    return KTRACE_MODE_ONESHOT;
+}
+
+static size_t round_up_pow2(size_t n) {
+    size_t p = 1;
+    while (p < n) {
+        p *= 2;
+    }
+    return p;
+}
+
 void ktrace_init(unsigned level) {
     ktrace_state_t* ks = &KTRACE_STATE;
 
@@ -193,19 +560,34 @@ void ktrace_init(unsigned level) {
 
     mb *= (1024*1024);
 
+    // Split the buffer between the cpus.  Each share is rounded up to a
+    // power of two so that positions wrap with a mask.
+    ks->num_cpus = arch_max_num_cpus();
+    size_t names_size = KTRACE_NAMES_BUFSIZE;
+    size_t cpu_size = round_up_pow2(fbl::max<size_t>(mb / ks->num_cpus, PAGE_SIZE));
+    size_t total = names_size + cpu_size * ks->num_cpus;
+
     zx_status_t status;
+    uint8_t* buffer;
     VmAspace* aspace = VmAspace::kernel_aspace();
-    if ((status = aspace->Alloc("ktrace", mb, (void**)&ks->buffer, 0, VmAspace::VMM_FLAG_COMMIT,
+    if ((status = aspace->Alloc("ktrace", total, (void**)&buffer, 0, VmAspace::VMM_FLAG_COMMIT,
                                 ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE)) < 0) {
         dprintf(INFO, "ktrace: cannot alloc buffer %d\n", status);
         return;
     }
 
-    // The last packet written can overhang the end of the buffer,
-    // so we reduce the reported size by the max size of a record
-    ks->bufsize = mb - 256;
+    dprintf(INFO, "ktrace: buffer at %p (%zu bytes, %zu per cpu, %u requested)\n",
+            buffer, total, cpu_size, mb);
 
-    dprintf(INFO, "ktrace: buffer at %p (%u bytes)\n", ks->buffer, mb);
+    spin_lock_init(&ks->names_lock);
+    ks->names.data = buffer;
+    ks->names.mask = static_cast<uint32_t>(names_size - 1);
+    for (uint32_t i = 0; i < ks->num_cpus; i++) {
+        ks->cpus[i].data = buffer + names_size + cpu_size * i;
+        ks->cpus[i].mask = static_cast<uint32_t>(cpu_size - 1);
+    }
+    ks->mode = ktrace_mode_from_cmdline();
+    ks->header_pending = true;
 
     // register all static probes
     {
@@ -217,9 +599,9 @@ void ktrace_init(unsigned level) {
         }
     }
 
-    // write metadata to the first two event slots
+    // metadata which begins every trace
     uint64_t n = ktrace_ticks_per_ms();
-    ktrace_rec_32b_t* rec = (ktrace_rec_32b_t*) ks->buffer;
+    ktrace_rec_32b_t* rec = ks->header;
     rec[0].tag = TAG_VERSION;
     rec[0].a = KTRACE_VERSION;
     rec[1].tag = TAG_TICKS_PER_MS;
@@ -227,9 +609,7 @@ void ktrace_init(unsigned level) {
     rec[1].b = (uint32_t)(n >> 32);
 
     // enable tracing
-    atomic_store(&ks->offset, KTRACE_RECSIZE * 2);
     ktrace_report_syscalls(kt_syscall_info);
-    ktrace_report_probes();
     atomic_store(&ks->grpmask, KTRACE_GRP_TO_MASK(grpmask));
 
     // report names of existing threads
@@ -245,38 +625,30 @@ void ktrace_init(unsigned level) {
 void ktrace_tiny(uint32_t tag, uint32_t arg) {
     ktrace_state_t* ks = &KTRACE_STATE;
     if (tag & atomic_load(&ks->grpmask)) {
-        tag = (tag & 0xFFFFFFF0) | 2;
-        int off;
-        if ((off = atomic_add(&ks->offset, KTRACE_HDRSIZE)) >= (int)ks->bufsize) {
-            // if we arrive at the end, stop
-            atomic_store(&ks->grpmask, 0);
-        } else {
-            ktrace_header_t* hdr = (ktrace_header_t*) (ks->buffer + off);
-            hdr->ts = ktrace_timestamp();
-            hdr->tag = tag;
-            hdr->tid = arg;
-        }
+        ktrace_header_t hdr;
+        hdr.tag = (tag & 0xFFFFFFF0) | 2;
+        hdr.tid = arg;
+        ktrace_append(&hdr, KTRACE_HDRSIZE);
     }
 }
 
-void* ktrace_open(uint32_t tag) {
+bool ktrace_write(uint32_t tag, const void* payload) {
     ktrace_state_t* ks = &KTRACE_STATE;
     if (!(tag & atomic_load(&ks->grpmask))) {
-        return nullptr;
+        return false;
     }
 
-    int off;
-    if ((off = atomic_add(&ks->offset, KTRACE_LEN(tag))) >= (int)ks->bufsize) {
-        // if we arrive at the end, stop
-        atomic_store(&ks->grpmask, 0);
-        return nullptr;
+    ktrace_rec_32b_t rec;
+    uint32_t len = KTRACE_LEN(tag);
+    if (len < KTRACE_HDRSIZE || len > sizeof(rec)) {
+        return false;
     }
-
-    ktrace_header_t* hdr = (ktrace_header_t*) (ks->buffer + off);
-    hdr->ts = ktrace_timestamp();
-    hdr->tag = tag;
-    hdr->tid = (uint32_t)get_current_thread()->user_tid;
-    return hdr + 1;
+    rec.tag = tag;
+    rec.tid = (uint32_t)get_current_thread()->user_tid;
+    if (len > KTRACE_HDRSIZE) {
+        memcpy(&rec.a, payload, len - KTRACE_HDRSIZE);
+    }
+    return ktrace_append(reinterpret_cast<ktrace_header_t*>(&rec), len);
 }
 
 static void ktrace_name_etc(uint32_t tag, uint32_t id, uint32_t arg, const char* name, bool always) {
@@ -287,18 +659,18 @@ static void ktrace_name_etc(uint32_t tag, uint32_t id, uint32_t arg, const char*
         // set size to: sizeof(hdr) + len + 1, round up to multiple of 8
         tag = (tag & 0xFFFFFFF0) | ((KTRACE_NAMESIZE + len + 1 + 7) >> 3);
 
-        int off;
-        if ((off = atomic_add(&ks->offset, KTRACE_LEN(tag))) >= (int)ks->bufsize) {
-            // if we arrive at the end, stop
-            atomic_store(&ks->grpmask, 0);
-        } else {
-            ktrace_rec_name_t* rec = (ktrace_rec_name_t*) (ks->buffer + off);
-            rec->tag = tag;
-            rec->id = id;
-            rec->arg = arg;
-            memcpy(rec->name, name, len);
-            rec->name[len] = 0;
-        }
+        union {
+            ktrace_rec_name_t rec;
+            uint8_t bytes[KTRACE_NAMESIZE + ZX_MAX_NAME_LEN + 7];
+        } u = {};
+        u.rec.tag = tag;
+        u.rec.id = id;
+        u.rec.arg = arg;
+        memcpy(u.rec.name, name, len);
+        u.rec.name[len] = 0;
+
+        AutoSpinLock lock(&ks->names_lock);
+        ktrace_buffer_append(ks, &ks->names, &u.rec, KTRACE_LEN(tag));
     }
 }
 
@@ -0,0 +1,297 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <lib/lockstat.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <arch/ops.h>
+#include <kernel/align.h>
+#include <kernel/atomic.h>
+#include <kernel/cmdline.h>
+#include <platform.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
+
+#include <lk/init.h>
+
+#include <lib/console.h>
+
+// Sites are keyed by the address of the code which acquired the lock.  The
+// table is never shrunk, so site pointers stay valid for as long as the lock
+// they were handed out for is held, including across "lockstat reset".
+static constexpr size_t kNumSites = 1024;
+
+// Nesting depth of spinlocks tracked per cpu.  Deeper acquisitions are
+// counted but their hold time is not.
+static constexpr size_t kMaxHeldSpinLocks = 16;
+
+struct lockstat_site {
+    uint64_t pc;
+    uint32_t kind;
+    uint64_t acquisitions;
+    uint64_t contended;
+    uint64_t wait;
+    uint64_t max_wait;
+    uint64_t hold;
+    uint64_t max_hold;
+};
+
+struct held_spin_lock {
+    spin_lock_t* lock;
+    lockstat_site_t* site;
+    uint64_t acquired;
+};
+
+// Spinlocks are held with interrupts disabled and are released on the cpu
+// which acquired them, even the thread_lock, which is handed from one thread
+// to the next across a context switch.  So the state of held spinlocks can
+// live per cpu without any further synchronization.
+struct held_spin_locks {
+    size_t count;
+    held_spin_lock locks[kMaxHeldSpinLocks];
+} __CPU_ALIGN;
+
+int lockstat_enabled;
+
+static lockstat_site_t sites[kNumSites];
+static held_spin_locks held[SMP_MAX_CPUS];
+static uint64_t sites_dropped;
+
+// None of the code below may take a lock of any kind, since it runs on
+// behalf of spin_lock and mutex_acquire.
+
+static inline void update_max(uint64_t* max, uint64_t val) {
+    uint64_t old = atomic_load_u64_relaxed(max);
+    while (val > old) {
+        if (__atomic_compare_exchange_n(max, &old, val, false,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+}
+
+static lockstat_site_t* find_site(uint64_t pc, uint32_t kind) {
+    size_t i = static_cast<size_t>((pc * 0x9e3779b97f4a7c15ull) >> 54) % kNumSites;
+    for (size_t probe = 0; probe < kNumSites; probe++) {
+        lockstat_site_t* site = &sites[(i + probe) % kNumSites];
+        uint64_t cur = atomic_load_u64_relaxed(&site->pc);
+        if (cur == 0) {
+            // a claimed slot always has a nonzero pc, so losing the race
+            // just means rechecking which pc it was claimed for
+            if (__atomic_compare_exchange_n(&site->pc, &cur, pc, false,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                site->kind = kind;
+                return site;
+            }
+        }
+        if (cur == pc) {
+            return site;
+        }
+    }
+    __atomic_fetch_add(&sites_dropped, 1, __ATOMIC_RELAXED);
+    return nullptr;
+}
+
+lockstat_site_t* lockstat_record_acquire(uintptr_t pc, uint32_t kind, bool contended,
+                                         uint64_t wait) {
+    lockstat_site_t* site = find_site(pc, kind);
+    if (site == nullptr) {
+        return nullptr;
+    }
+    __atomic_fetch_add(&site->acquisitions, 1, __ATOMIC_RELAXED);
+    if (contended) {
+        __atomic_fetch_add(&site->contended, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&site->wait, wait, __ATOMIC_RELAXED);
+        update_max(&site->max_wait, wait);
+    }
+    return site;
+}
+
+void lockstat_record_release(lockstat_site_t* site, uint64_t hold) {
+    __atomic_fetch_add(&site->hold, hold, __ATOMIC_RELAXED);
+    update_max(&site->max_hold, hold);
+}
+
+void lockstat_spin_lock(spin_lock_t* lock) TA_NO_THREAD_SAFETY_ANALYSIS {
+    uintptr_t pc = reinterpret_cast<uintptr_t>(__GET_CALLER());
+    uint64_t start = current_ticks();
+    bool contended = false;
+    if (arch_spin_trylock(lock) != 0) {
+        contended = true;
+        arch_spin_lock(lock);
+    }
+    uint64_t now = current_ticks();
+    lockstat_site_t* site =
+        lockstat_record_acquire(pc, LOCKSTAT_KIND_SPIN, contended, now - start);
+
+    cpu_num_t cpu = arch_curr_cpu_num();
+    held_spin_locks* h = &held[cpu];
+    // drop entries left behind by locks released while profiling was off
+    size_t n = 0;
+    for (size_t i = 0; i < h->count; i++) {
+        if (arch_spin_lock_holder_cpu(h->locks[i].lock) == cpu) {
+            h->locks[n++] = h->locks[i];
+        }
+    }
+    h->count = n;
+    if (site != nullptr && n < kMaxHeldSpinLocks) {
+        h->locks[n] = {lock, site, now};
+        h->count = n + 1;
+    }
+}
+
+void lockstat_spin_unlock(spin_lock_t* lock) TA_NO_THREAD_SAFETY_ANALYSIS {
+    held_spin_locks* h = &held[arch_curr_cpu_num()];
+    // locks are usually released in the reverse order they were taken
+    for (size_t i = h->count; i > 0; i--) {
+        if (h->locks[i - 1].lock == lock) {
+            held_spin_lock entry = h->locks[i - 1];
+            memmove(&h->locks[i - 1], &h->locks[i], (h->count - i) * sizeof(held_spin_lock));
+            h->count--;
+            arch_spin_unlock(lock);
+            lockstat_record_release(entry.site, current_ticks() - entry.acquired);
+            return;
+        }
+    }
+    arch_spin_unlock(lock);
+}
+
+size_t lockstat_num_sites() {
+    size_t count = 0;
+    for (auto& site : sites) {
+        if (atomic_load_u64_relaxed(&site.pc) != 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static zx_duration_t ticks_to_duration(uint64_t ticks) {
+    uint64_t tps = ticks_per_second();
+    return (ticks / tps) * ZX_SEC(1) + (ticks % tps) * ZX_SEC(1) / tps;
+}
+
+bool lockstat_read_site(size_t* cursor, zx_info_lock_stats_t* info) {
+    for (; *cursor < kNumSites; (*cursor)++) {
+        const lockstat_site_t& site = sites[*cursor];
+        uint64_t pc = atomic_load_u64_relaxed(&site.pc);
+        if (pc == 0) {
+            continue;
+        }
+        (*cursor)++;
+        *info = {};
+        info->pc = pc;
+        info->kind = site.kind;
+        info->acquisitions = atomic_load_u64_relaxed(&site.acquisitions);
+        info->contended = atomic_load_u64_relaxed(&site.contended);
+        info->wait_time = ticks_to_duration(atomic_load_u64_relaxed(&site.wait));
+        info->max_wait_time = ticks_to_duration(atomic_load_u64_relaxed(&site.max_wait));
+        info->hold_time = ticks_to_duration(atomic_load_u64_relaxed(&site.hold));
+        info->max_hold_time = ticks_to_duration(atomic_load_u64_relaxed(&site.max_hold));
+        return true;
+    }
+    return false;
+}
+
+static void lockstat_reset() {
+    // keep the pcs so outstanding site pointers still refer to the same site
+    for (auto& site : sites) {
+        atomic_store_u64_relaxed(&site.acquisitions, 0);
+        atomic_store_u64_relaxed(&site.contended, 0);
+        atomic_store_u64_relaxed(&site.wait, 0);
+        atomic_store_u64_relaxed(&site.max_wait, 0);
+        atomic_store_u64_relaxed(&site.hold, 0);
+        atomic_store_u64_relaxed(&site.max_hold, 0);
+    }
+    atomic_store_u64_relaxed(&sites_dropped, 0);
+}
+
+static int compare_wait_time(const void* a, const void* b) {
+    auto x = static_cast<const zx_info_lock_stats_t*>(a);
+    auto y = static_cast<const zx_info_lock_stats_t*>(b);
+    if (x->wait_time != y->wait_time) {
+        return x->wait_time > y->wait_time ? -1 : 1;
+    }
+    return x->acquisitions > y->acquisitions ? -1 : (x->acquisitions < y->acquisitions);
+}
+
+static int lockstat_dump(size_t max) {
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<zx_info_lock_stats_t[]> stats(new (&ac) zx_info_lock_stats_t[kNumSites]);
+    if (!ac.check()) {
+        printf("no memory for lock stats\n");
+        return 1;
+    }
+    size_t count = 0;
+    size_t cursor = 0;
+    while (count < kNumSites && lockstat_read_site(&cursor, &stats[count])) {
+        count++;
+    }
+    qsort(stats.get(), count, sizeof(stats[0]), compare_wait_time);
+
+    printf("%-18s %-5s %10s %10s %12s %10s %12s %10s\n", "pc", "kind", "acquired",
+           "contended", "wait(us)", "max(us)", "hold(us)", "max(us)");
+    for (size_t i = 0; i < fbl::min(count, max); i++) {
+        const zx_info_lock_stats_t& s = stats[i];
+        printf("%#-18" PRIx64 " %-5s %10" PRIu64 " %10" PRIu64 " %12" PRIu64 " %10" PRIu64
+               " %12" PRIu64 " %10" PRIu64 "\n",
+               s.pc, s.kind == LOCKSTAT_KIND_SPIN ? "spin" : "mutex", s.acquisitions,
+               s.contended, s.wait_time / ZX_USEC(1), s.max_wait_time / ZX_USEC(1),
+               s.hold_time / ZX_USEC(1), s.max_hold_time / ZX_USEC(1));
+    }
+    uint64_t dropped = atomic_load_u64_relaxed(&sites_dropped);
+    if (dropped != 0) {
+        printf("%" PRIu64 " acquisitions not recorded, site table full\n", dropped);
+    }
+    return 0;
+}
+
+static int cmd_lockstat(int argc, const cmd_args* argv, uint32_t flags) {
+    if (argc > 1) {
+        if (strcmp(argv[1].str, "start") == 0) {
+            atomic_store(&lockstat_enabled, 1);
+            return 0;
+        }
+        if (strcmp(argv[1].str, "stop") == 0) {
+            atomic_store(&lockstat_enabled, 0);
+            return 0;
+        }
+        if (strcmp(argv[1].str, "reset") == 0) {
+            lockstat_reset();
+            return 0;
+        }
+        if (strcmp(argv[1].str, "dump") == 0) {
+            return lockstat_dump(argc > 2 ? argv[2].u : 20);
+        }
+    }
+
+    printf(
+        "profile kernel lock contention:\n"
+        "  lockstat start\n"
+        "  lockstat stop\n"
+        "  lockstat reset\n"
+        "  lockstat dump [<count>]\n"
+    );
+    return 0;
+}
+
+static void lockstat_init(uint level) {
+    if (cmdline_get_bool("kernel.lockstat.enable", false)) {
+        atomic_store(&lockstat_enabled, 1);
+    }
+}
+
+LK_INIT_HOOK(lockstat, lockstat_init, LK_INIT_LEVEL_PLATFORM_EARLY);
+
+STATIC_COMMAND_START
+STATIC_COMMAND("lockstat", "kernel lock contention profiler", &cmd_lockstat)
+STATIC_COMMAND_END(lockstat);
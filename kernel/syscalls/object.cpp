@@ -12,6 +12,7 @@
 #include <kernel/stats.h>
 #include <vm/pmm.h>
 #include <lib/heap.h>
+#include <lib/lockstat.h>
 #include <platform.h>
 #include <zircon/types.h>
 
@@ -513,6 +514,44 @@ zx_status_t sys_object_get_info(zx_handle_t handle, uint32_t topic,
             return single_record_result(
                 _buffer, buffer_size, _actual, _avail, &stats, sizeof(stats));
         }
+        case ZX_INFO_LOCK_STATS: {
+#if !WITH_LIB_LOCKSTAT
+            return ZX_ERR_NOT_SUPPORTED;
+#else
+            auto status = validate_resource(handle, ZX_RSRC_KIND_ROOT);
+            if (status != ZX_OK)
+                return status;
+
+            // sites are only ever added, so more may be read below than were
+            // counted here
+            size_t num_sites = lockstat_num_sites();
+            size_t num_space_for = buffer_size / sizeof(zx_info_lock_stats_t);
+
+            user_out_ptr<zx_info_lock_stats_t> lock_buf =
+                _buffer.reinterpret<zx_info_lock_stats_t>();
+
+            size_t num_copied = 0;
+            size_t cursor = 0;
+            zx_info_lock_stats_t stats;
+            while (num_copied < num_space_for && lockstat_read_site(&cursor, &stats)) {
+                if (lock_buf.copy_array_to_user(&stats, 1, num_copied) != ZX_OK)
+                    return ZX_ERR_INVALID_ARGS;
+                num_copied++;
+            }
+
+            if (_actual) {
+                zx_status_t status = _actual.copy_to_user(num_copied);
+                if (status != ZX_OK)
+                    return status;
+            }
+            if (_avail) {
+                zx_status_t status = _avail.copy_to_user(MAX(num_sites, num_copied));
+                if (status != ZX_OK)
+                    return status;
+            }
+            return ZX_OK;
+#endif
+        }
         case ZX_INFO_RESOURCE: {
             // grab a reference to the dispatcher
             fbl::RefPtr<ResourceDispatcher> resource;
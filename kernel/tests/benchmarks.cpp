@@ -9,11 +9,13 @@
 
 #include <arch/ops.h>
 #include <err.h>
+#include <fbl/algorithm.h>
 #include <inttypes.h>
 #include <kernel/mp.h>
 #include <kernel/mutex.h>
 #include <kernel/spinlock.h>
 #include <kernel/thread.h>
+#include <kernel/timer.h>
 #include <platform.h>
 #include <rand.h>
 #include <stdio.h>
@@ -235,6 +237,97 @@ __NO_INLINE static void bench_mutex() {
     printf("%" PRIu64 " cycles to acquire/release uncontended mutex %u times (%" PRIu64 " cycles per)\n", c, count, c / count);
 }
 
+static int bench_mutex_contended_thread(void* arg) {
+    mutex_t* m = static_cast<mutex_t*>(arg);
+    static const uint count = 256 * 1024;
+    for (uint i = 0; i < count; i++) {
+        mutex_acquire(m);
+        // a short critical section, so that the holder is usually running
+        for (volatile int j = 0; j < 32; j++) {
+        }
+        mutex_release(m);
+    }
+    return 0;
+}
+
+__NO_INLINE static void bench_mutex_contended() {
+    mutex_t m;
+    mutex_init(&m);
+
+    static const uint kMaxThreads = 4;
+    uint num_threads = fbl::min(arch_max_num_cpus(), kMaxThreads);
+    if (num_threads < 2) {
+        return;
+    }
+    thread_t* threads[kMaxThreads];
+
+    uint64_t c = arch_cycle_count();
+    for (uint i = 0; i < num_threads; i++) {
+        threads[i] = thread_create("mutex bench", &bench_mutex_contended_thread, &m,
+                                   DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+        thread_resume(threads[i]);
+    }
+    for (uint i = 0; i < num_threads; i++) {
+        thread_join(threads[i], nullptr, ZX_TIME_INFINITE);
+    }
+    c = arch_cycle_count() - c;
+
+    printf("%" PRIu64 " cycles for %u threads to contend on a mutex "
+           "(see 'k counters view kernel.mutex')\n", c, num_threads);
+    mutex_destroy(&m);
+}
+
+static void bench_timer_cb(timer_t* timer, zx_time_t now, void* arg) {
+}
+
+__NO_INLINE static void bench_timers() {
+    static const size_t kIterations = 10000;
+    static const size_t kMaxPending = 100000;
+
+    // Far enough out that none of these fire while we measure.
+    const zx_time_t base = current_time() + ZX_SEC(3600);
+
+    timer_t* timers = (timer_t*)malloc(sizeof(timer_t) * kMaxPending);
+    zx_time_t* deadlines = (zx_time_t*)malloc(sizeof(zx_time_t) * kIterations);
+    if (timers == nullptr || deadlines == nullptr) {
+        printf("failed to allocate timers\n");
+        free(timers);
+        free(deadlines);
+        return;
+    }
+    for (size_t i = 0; i < kIterations; i++) {
+        deadlines[i] = base + ZX_USEC(rand() % 1000000);
+    }
+
+    for (size_t pending = 100; pending <= kMaxPending; pending *= 10) {
+        for (size_t i = 0; i < pending; i++) {
+            timer_init(&timers[i]);
+            timer_set(&timers[i], base + ZX_USEC(rand() % 1000000), TIMER_SLACK_CENTER,
+                      ZX_USEC(rand() % 100), bench_timer_cb, nullptr);
+        }
+
+        timer_t probe;
+        timer_init(&probe);
+        uint64_t c = arch_cycle_count();
+        for (size_t i = 0; i < kIterations; i++) {
+            timer_set(&probe, deadlines[i], TIMER_SLACK_CENTER, ZX_USEC(50),
+                      bench_timer_cb, nullptr);
+            timer_cancel(&probe);
+        }
+        c = arch_cycle_count() - c;
+
+        printf("%" PRIu64 " cycles to set/cancel a timer %zu times with %zu pending (%" PRIu64 " cycles per)\n",
+               c, kIterations, pending, c / kIterations);
+
+        for (size_t i = 0; i < pending; i++) {
+            timer_cancel(&timers[i]);
+        }
+    }
+
+    free(timers);
+    free(deadlines);
+}
+
 void benchmarks() {
     bench_set_overhead();
     bench_memcpy();
@@ -251,4 +344,6 @@ void benchmarks() {
 
     bench_spinlock();
     bench_mutex();
+    bench_mutex_contended();
+    bench_timers();
 }
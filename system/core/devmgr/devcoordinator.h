@@ -137,6 +137,8 @@ struct dc_device {
 // return to this state once made visible.
 #define DEV_CTX_INVISIBLE     0x80
 
+#define DRIVER_BIND_KEYS_MAX 4
+
 struct dc_driver {
     const char* name;
     const zx_bind_inst_t* binding;
@@ -144,6 +146,16 @@ struct dc_driver {
     uint32_t flags;
     struct list_node node;
     const char* libname;
+
+    // properties a device must have to match the bind program,
+    // filled in by dc_analyze_binding()
+    uint32_t bind_key_count;
+    zx_device_prop_t bind_keys[DRIVER_BIND_KEYS_MAX];
+
+    // position in the list of all drivers, and link in the
+    // bind index, which keeps the same order
+    int64_t seq;
+    struct list_node inode;
 };
 
 #define DRIVER_NAME_LEN_MAX 64
@@ -164,6 +176,47 @@ bool dc_is_bindable(driver_t* drv, uint32_t protocol_id,
                     zx_device_prop_t* props, size_t prop_count,
                     bool autobind);
 
+void dc_analyze_binding(driver_t* drv);
+
+// Returns whether |drv| only binds to devices whose property |id|
+// is |*value|.
+bool dc_binding_requires(const driver_t* drv, uint32_t id, uint32_t* value);
+
+// The protocol a device presents to bind programs.
+uint32_t dc_device_protocol(uint32_t protocol_id, const zx_device_prop_t* props,
+                            size_t prop_count);
+
+// Drivers indexed by the protocol their bind program requires, so that a
+// device only has to consider drivers for its protocol and those which
+// could bind to any protocol.  Each bucket is kept in the order drivers
+// were added, by seq.  A zeroed index is empty.
+#define DRIVER_INDEX_BUCKETS 64
+
+typedef struct {
+    list_node_t buckets[DRIVER_INDEX_BUCKETS];
+    list_node_t any;
+    int64_t seq_first;
+    int64_t seq_last;
+} driver_index_t;
+
+// Adds |drv| ahead of every driver in |index| if |first|, else after them.
+void dc_driver_index_add(driver_index_t* index, driver_t* drv, bool first);
+
+// Walks the drivers which might bind to a device presenting |protocol_id|,
+// in the order they were added, by merging its bucket with the drivers that
+// accept any protocol.  Drivers sharing the bucket for some other protocol
+// are rejected cheaply by dc_is_bindable().
+typedef struct {
+    list_node_t* bucket;
+    list_node_t* any;
+    driver_t* next_bucket;
+    driver_t* next_any;
+} driver_candidates_t;
+
+void dc_driver_candidates_begin(driver_candidates_t* it, driver_index_t* index,
+                                uint32_t protocol_id);
+driver_t* dc_driver_candidates_next(driver_candidates_t* it);
+
 #define DC_MAX_DATA 4096
 
 // The first two fields of devcoordinator messages align
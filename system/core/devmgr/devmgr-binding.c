@@ -138,6 +138,111 @@ next_instruction:
     return false;
 }
 
+// Records the properties a device must have for |drv|'s bind program to
+// match, so most drivers can be rejected without running the program.
+// Only the leading run of ABORT instructions is considered, since every
+// device must get past those before anything else happens.  A program
+// ending in a single MATCH_IF(EQ, ...) after them requires that too.
+void dc_analyze_binding(driver_t* drv) {
+    const zx_bind_inst_t* ip = drv->binding;
+    const zx_bind_inst_t* end = ip + (drv->binding_size / sizeof(zx_bind_inst_t));
+
+    drv->bind_key_count = 0;
+    for (; ip < end; ip++) {
+        uint32_t inst = ip->op;
+        uint32_t cc = BINDINST_CC(inst);
+        if (BINDINST_OP(inst) != OP_ABORT || cc == COND_AL || cc > COND_BITS) {
+            break;
+        }
+        if (cc == COND_NE && BINDINST_PB(inst) != BIND_FLAGS &&
+            drv->bind_key_count < DRIVER_BIND_KEYS_MAX) {
+            zx_device_prop_t* key = &drv->bind_keys[drv->bind_key_count++];
+            key->id = BINDINST_PB(inst);
+            key->value = ip->arg;
+        }
+    }
+    if (ip + 1 == end && BINDINST_OP(ip->op) == OP_MATCH &&
+        BINDINST_CC(ip->op) == COND_EQ && BINDINST_PB(ip->op) != BIND_FLAGS &&
+        drv->bind_key_count < DRIVER_BIND_KEYS_MAX) {
+        zx_device_prop_t* key = &drv->bind_keys[drv->bind_key_count++];
+        key->id = BINDINST_PB(ip->op);
+        key->value = ip->arg;
+    }
+}
+
+bool dc_binding_requires(const driver_t* drv, uint32_t id, uint32_t* value) {
+    for (uint32_t i = 0; i < drv->bind_key_count; i++) {
+        if (drv->bind_keys[i].id == id) {
+            *value = drv->bind_keys[i].value;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t dc_device_protocol(uint32_t protocol_id, const zx_device_prop_t* props,
+                            size_t prop_count) {
+    bpctx_t ctx;
+    ctx.props = props;
+    ctx.end = props + prop_count;
+    ctx.protocol_id = protocol_id;
+    return dev_get_prop(&ctx, BIND_PROTOCOL);
+}
+
+static list_node_t* driver_index_bucket(driver_index_t* index, uint32_t protocol_id) {
+    return &index->buckets[(protocol_id * 2654435761u) % DRIVER_INDEX_BUCKETS];
+}
+
+void dc_driver_index_add(driver_index_t* index, driver_t* drv, bool first) {
+    if (index->any.next == NULL) {
+        for (size_t n = 0; n < DRIVER_INDEX_BUCKETS; n++) {
+            list_initialize(&index->buckets[n]);
+        }
+        list_initialize(&index->any);
+    }
+
+    uint32_t protocol_id;
+    list_node_t* bucket = &index->any;
+    if (dc_binding_requires(drv, BIND_PROTOCOL, &protocol_id)) {
+        bucket = driver_index_bucket(index, protocol_id);
+    }
+    if (first) {
+        drv->seq = --index->seq_first;
+        list_add_head(bucket, &drv->inode);
+    } else {
+        drv->seq = ++index->seq_last;
+        list_add_tail(bucket, &drv->inode);
+    }
+}
+
+void dc_driver_candidates_begin(driver_candidates_t* it, driver_index_t* index,
+                                uint32_t protocol_id) {
+    it->bucket = driver_index_bucket(index, protocol_id);
+    it->any = &index->any;
+    if (index->any.next == NULL) {
+        it->next_bucket = NULL;
+        it->next_any = NULL;
+        return;
+    }
+    it->next_bucket = list_peek_head_type(it->bucket, driver_t, inode);
+    it->next_any = list_peek_head_type(it->any, driver_t, inode);
+}
+
+driver_t* dc_driver_candidates_next(driver_candidates_t* it) {
+    driver_t* drv;
+    if (it->next_any == NULL ||
+        (it->next_bucket != NULL && it->next_bucket->seq < it->next_any->seq)) {
+        drv = it->next_bucket;
+        if (drv != NULL) {
+            it->next_bucket = list_next_type(it->bucket, &drv->inode, driver_t, inode);
+        }
+    } else {
+        drv = it->next_any;
+        it->next_any = list_next_type(it->any, &drv->inode, driver_t, inode);
+    }
+    return drv;
+}
+
 bool dc_is_bindable(driver_t* drv, uint32_t protocol_id,
                     zx_device_prop_t* props, size_t prop_count,
                     bool autobind) {
@@ -148,9 +253,14 @@ bool dc_is_bindable(driver_t* drv, uint32_t protocol_id,
     ctx.props = props;
     ctx.end = props + prop_count;
     ctx.protocol_id = protocol_id;
+    ctx.autobind = autobind ? 1 : 0;
+    for (uint32_t i = 0; i < drv->bind_key_count; i++) {
+        if (dev_get_prop(&ctx, drv->bind_keys[i].id) != drv->bind_keys[i].value) {
+            return false;
+        }
+    }
     ctx.binding = drv->binding;
     ctx.binding_size = drv->binding_size;
     ctx.name = drv->name;
-    ctx.autobind = autobind ? 1 : 0;
     return is_bindable(&ctx);
 }
@@ -213,6 +213,19 @@ static list_node_t list_drivers_new = LIST_INITIAL_VALUE(list_drivers_new);
 // Drivers to try last
 static list_node_t list_drivers_fallback = LIST_INITIAL_VALUE(list_drivers_fallback);
 
+// All Drivers again, indexed by the protocol their bind program requires
+static driver_index_t driver_index;
+
+// Adds a driver to All Drivers, at the front or the back.
+static void dc_add_driver(driver_t* drv, bool first) {
+    if (first) {
+        list_add_head(&list_drivers, &drv->node);
+    } else {
+        list_add_tail(&list_drivers, &drv->node);
+    }
+    dc_driver_index_add(&driver_index, drv, first);
+}
+
 // All Devices (excluding static immortal devices)
 static list_node_t list_devices = LIST_INITIAL_VALUE(list_devices);
 
@@ -943,8 +956,24 @@ static zx_status_t dc_bind_device(device_t* dev, const char* drvlibname) {
 
     //TODO: disallow if we're in the middle of enumeration, etc
     driver_t* drv;
+    if (autobind) {
+        driver_candidates_t it;
+        dc_driver_candidates_begin(&it, &driver_index,
+                                   dc_device_protocol(dev->protocol_id,
+                                                      dev->props, dev->prop_count));
+        while ((drv = dc_driver_candidates_next(&it)) != NULL) {
+            if (dc_is_bindable(drv, dev->protocol_id,
+                               dev->props, dev->prop_count, autobind)) {
+                log(SPEW, "devcoord: drv='%s' bindable to dev='%s'\n",
+                    drv->name, dev->name);
+                dc_attempt_bind(drv, dev);
+                break;
+            }
+        }
+        return ZX_OK;
+    }
     list_for_every_entry(&list_drivers, drv, driver_t, node) {
-        if (autobind || !strcmp(drv->libname, drvlibname)) {
+        if (!strcmp(drv->libname, drvlibname)) {
             if (dc_is_bindable(drv, dev->protocol_id,
                                dev->props, dev->prop_count, autobind)) {
                 log(SPEW, "devcoord: drv='%s' bindable to dev='%s'\n",
@@ -1453,9 +1482,12 @@ static zx_status_t dc_attempt_bind(driver_t* drv, device_t* dev) {
 }
 
 static void dc_handle_new_device(device_t* dev) {
+    driver_candidates_t it;
+    dc_driver_candidates_begin(&it, &driver_index,
+                               dc_device_protocol(dev->protocol_id,
+                                                  dev->props, dev->prop_count));
     driver_t* drv;
-
-    list_for_every_entry(&list_drivers, drv, driver_t, node) {
+    while ((drv = dc_driver_candidates_next(&it)) != NULL) {
         if (dc_is_bindable(drv, dev->protocol_id,
                            dev->props, dev->prop_count, true)) {
             log(SPEW, "devcoord: drv='%s' bindable to dev='%s'\n",
@@ -1710,9 +1742,9 @@ void dc_driver_added(driver_t* drv, const char* version) {
     } else if (version[0] == '!') {
         // debugging / development hack
         // prioritize drivers with version "!..." over others
-        list_add_head(&list_drivers, &drv->node);
+        dc_add_driver(drv, true);
     } else {
-        list_add_tail(&list_drivers, &drv->node);
+        dc_add_driver(drv, false);
     }
 }
 
@@ -1770,7 +1802,7 @@ void dc_bind_driver(driver_t* drv) {
 void dc_handle_new_driver(void) {
     driver_t* drv;
     while ((drv = list_remove_head_type(&list_drivers_new, driver_t, node)) != NULL) {
-        list_add_tail(&list_drivers, &drv->node);
+        dc_add_driver(drv, false);
         dc_bind_driver(drv);
     }
 }
@@ -1852,7 +1884,7 @@ void coordinator(void) {
     } else {
         driver_t* drv;
         while ((drv = list_remove_tail_type(&list_drivers_fallback, driver_t, node)) != NULL) {
-            list_add_tail(&list_drivers, &drv->node);
+            dc_add_driver(drv, false);
         }
     }
 
@@ -4,9 +4,11 @@
 
 #include <dirent.h>
 #include <fcntl.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
 #include <unistd.h>
 
 #include "devmgr.h"
@@ -15,6 +17,27 @@
 #include <driver-info/driver-info.h>
 
 #include <zircon/driver/binding.h>
+#include <zircon/listnode.h>
+#include <zircon/syscalls.h>
+
+// Upper bound on threads reading driver notes at once.
+#define DRIVER_READ_THREADS_MAX 4
+
+// A driver found in a file, waiting to be handed to the coordinator.
+typedef struct {
+    list_node_t node;
+    driver_t* drv;
+    char version[sizeof(((zircon_driver_note_payload_t*)0)->version)];
+} found_t;
+
+typedef struct {
+    char libname[256 + 32];
+    // false if |libname| could not be opened
+    bool opened;
+    zx_status_t status;
+    list_node_t found;
+    bool asan;
+} driver_file_t;
 
 static bool is_driver_disabled(const char* name) {
     // driver.<driver_name>.disable
@@ -23,6 +46,8 @@ static bool is_driver_disabled(const char* name) {
     return getenv_bool(opt, false);
 }
 
+// Called by di_read_driver_info(), possibly on several threads at once,
+// so it only records what it finds in |cookie|, a driver_file_t.
 static void found_driver(zircon_driver_note_payload_t* note,
                          const zx_bind_inst_t* bi, void* cookie) {
     // ensure strings are terminated
@@ -34,14 +59,20 @@ static void found_driver(zircon_driver_note_payload_t* note,
         return;
     }
 
-    const char* libname = cookie;
+    driver_file_t* file = cookie;
+    const char* libname = file->libname;
     size_t pathlen = strlen(libname) + 1;
     size_t namelen = strlen(note->name) + 1;
     size_t bindlen = note->bindcount * sizeof(zx_bind_inst_t);
     size_t len = sizeof(driver_t) + bindlen + pathlen + namelen;
 
+    found_t* found;
+    if ((found = malloc(sizeof(found_t))) == NULL) {
+        return;
+    }
     driver_t* drv;
     if ((drv = malloc(len)) == NULL) {
+        free(found);
         return;
     }
 
@@ -54,9 +85,10 @@ static void found_driver(zircon_driver_note_payload_t* note,
     memcpy((void*) drv->binding, bi, bindlen);
     memcpy((void*) drv->libname, libname, pathlen);
     memcpy((void*) drv->name, note->name, namelen);
+    dc_analyze_binding(drv);
 
 #if VERBOSE_DRIVER_LOAD
-    printf("found driver: %s\n", (char*) cookie);
+    printf("found driver: %s\n", libname);
     printf("        name: %s\n", note->name);
     printf("      vendor: %s\n", note->vendor);
     printf("     version: %s\n", note->version);
@@ -68,17 +100,82 @@ static void found_driver(zircon_driver_note_payload_t* note,
 #endif
 
     if (note->flags & ZIRCON_DRIVER_NOTE_FLAG_ASAN) {
+        file->asan = true;
+    }
+
+    found->drv = drv;
+    memcpy(found->version, note->version, sizeof(found->version));
+    list_add_tail(&file->found, &found->node);
+}
+
+static void read_driver_file(driver_file_t* file) {
+    list_initialize(&file->found);
+    file->asan = false;
+    file->opened = false;
+    int fd;
+    if ((fd = open(file->libname, O_RDONLY)) < 0) {
+        file->status = ZX_ERR_IO;
+        return;
+    }
+    file->opened = true;
+    file->status = di_read_driver_info(fd, file, found_driver);
+    close(fd);
+}
+
+// Hands the drivers found in |file| to the coordinator, in the order they
+// were found.  If reading |file| failed, whatever was found before the
+// failure is thrown away.
+static void add_drivers(driver_file_t* file) {
+    found_t* found;
+    if (file->status != ZX_OK) {
+        if (!file->opened) {
+            printf("devcoord: cannot open '%s'\n", file->libname);
+        } else if (file->status == ZX_ERR_NOT_FOUND) {
+            printf("devcoord: no driver info in '%s'\n", file->libname);
+        } else {
+            printf("devcoord: error reading info from '%s'\n", file->libname);
+        }
+        while ((found = list_remove_head_type(&file->found, found_t, node)) != NULL) {
+            free(found->drv);
+            free(found);
+        }
+        return;
+    }
+    if (file->asan) {
         dc_asan_drivers = true;
     }
+    while ((found = list_remove_head_type(&file->found, found_t, node)) != NULL) {
+        dc_driver_added(found->drv, found->version);
+        free(found);
+    }
+}
 
-    dc_driver_added(drv, note->version);
+typedef struct {
+    driver_file_t* files;
+    size_t count;
+    atomic_size_t next;
+} driver_dir_t;
+
+static int read_driver_files(void* arg) {
+    driver_dir_t* dir = arg;
+    size_t n;
+    while ((n = atomic_fetch_add(&dir->next, 1)) < dir->count) {
+        read_driver_file(&dir->files[n]);
+    }
+    return 0;
 }
 
+// Reading driver notes means opening and paging in every driver, so it is
+// spread over a few threads.  The drivers are still added in directory
+// order once all of them have been read, since order decides priority.
 void find_loadable_drivers(const char* path) {
     DIR* dir = opendir(path);
     if (dir == NULL) {
         return;
     }
+    driver_file_t* files = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
     struct dirent* de;
     while ((de = readdir(dir)) != NULL) {
         if (de->d_name[0] == '.') {
@@ -87,45 +184,64 @@ void find_loadable_drivers(const char* path) {
         if (de->d_type != DT_REG) {
             continue;
         }
-        char libname[256 + 32];
-        int r = snprintf(libname, sizeof(libname), "%s/%s", path, de->d_name);
-        if ((r < 0) || (r >= (int)sizeof(libname))) {
-            continue;
+        if (count == capacity) {
+            size_t new_capacity = capacity ? capacity * 2 : 32;
+            driver_file_t* new_files = realloc(files, new_capacity * sizeof(driver_file_t));
+            if (new_files == NULL) {
+                break;
+            }
+            files = new_files;
+            capacity = new_capacity;
         }
-
-        int fd;
-        if ((fd = openat(dirfd(dir), de->d_name, O_RDONLY)) < 0) {
+        int r = snprintf(files[count].libname, sizeof(files[count].libname),
+                         "%s/%s", path, de->d_name);
+        if ((r < 0) || (r >= (int)sizeof(files[count].libname))) {
             continue;
         }
-        zx_status_t status = di_read_driver_info(fd, libname, found_driver);
-        close(fd);
-
-        if (status) {
-            if (status == ZX_ERR_NOT_FOUND) {
-                printf("devcoord: no driver info in '%s'\n", libname);
-            } else {
-                printf("devcoord: error reading info from '%s'\n", libname);
-            }
-        }
+        count++;
     }
     closedir(dir);
+
+    driver_dir_t work = {
+        .files = files,
+        .count = count,
+    };
+    atomic_init(&work.next, 0);
+
+    size_t num_threads = zx_system_get_num_cpus();
+    if (num_threads > DRIVER_READ_THREADS_MAX) {
+        num_threads = DRIVER_READ_THREADS_MAX;
+    }
+    if (num_threads > count) {
+        num_threads = count;
+    }
+    // this thread reads too, so start one fewer
+    thrd_t threads[DRIVER_READ_THREADS_MAX];
+    size_t started = 0;
+    for (size_t n = 1; n < num_threads; n++) {
+        if (thrd_create(&threads[started], read_driver_files, &work) == thrd_success) {
+            started++;
+        }
+    }
+    read_driver_files(&work);
+    for (size_t n = 0; n < started; n++) {
+        thrd_join(threads[n], NULL);
+    }
+
+    for (size_t n = 0; n < count; n++) {
+        add_drivers(&files[n]);
+    }
+    free(files);
 }
 
 void load_driver(const char* path) {
     //TODO: check for duplicate driver add
-    int fd;
-    if ((fd = open(path, O_RDONLY)) < 0) {
+    driver_file_t file;
+    int r = snprintf(file.libname, sizeof(file.libname), "%s", path);
+    if ((r < 0) || (r >= (int)sizeof(file.libname))) {
         printf("devcoord: cannot open '%s'\n", path);
         return;
     }
-    zx_status_t status = di_read_driver_info(fd, (void*)path, found_driver);
-    close(fd);
-
-    if (status) {
-        if (status == ZX_ERR_NOT_FOUND) {
-            printf("devcoord: no driver info in '%s'\n", path);
-        } else {
-            printf("devcoord: error reading info from '%s'\n", path);
-        }
-    }
+    read_driver_file(&file);
+    add_drivers(&file);
 }
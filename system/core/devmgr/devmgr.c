@@ -11,6 +11,7 @@
 #include <threads.h>
 #include <unistd.h>
 
+#include <bootdata/decompress.h>
 #include <launchpad/launchpad.h>
 #include <launchpad/loader-service.h>
 #include <zircon/boot/bootdata.h>
@@ -451,7 +452,57 @@ int main(int argc, char** argv) {
     return 0;
 }
 
-static void devmgr_import_bootdata(zx_handle_t vmo) {
+// userboot only decompresses the parts of the primary bootfs that it
+// loads files from.  The rest is decompressed on a background thread,
+// skipping the blocks userboot's map says are done, so that launching
+// fshost need not wait for it.  Files devmgr opens itself are
+// decompressed on demand, and fshost waits for BOOTFS_FILLED_SIGNAL
+// before serving the bootfs.
+static bootdata_lazy_t bootfs_lazy;
+static bool bootfs_lazy_active;
+
+static int bootfs_fill_thread(void* arg) {
+    zx_handle_t bootfs_vmo = (zx_handle_t)(uintptr_t)arg;
+    const char* errmsg;
+    zx_status_t status = bootdata_lazy_fill_all(&bootfs_lazy, 0, &errmsg);
+    if (status != ZX_OK) {
+        // Whatever userboot left undecompressed is missing from bootfs.
+        printf("devmgr: failed to decompress bootfs: %s\n", errmsg);
+        exit(1);
+    }
+    // bootfs_lazy stays open: devmgr_bootfs_open keeps checking it, which
+    // costs nothing now that every block is filled.
+    zx_object_signal(bootfs_vmo, 0, BOOTFS_FILLED_SIGNAL);
+    return 0;
+}
+
+static void devmgr_fill_bootfs(zx_handle_t vmo, size_t off, size_t len,
+                               zx_handle_t bootfs_vmo, zx_handle_t bootfs_map) {
+    const char* errmsg;
+    zx_status_t status = bootdata_lazy_open(zx_vmar_root_self(), vmo, off, len,
+                                            &bootfs_vmo, &bootfs_map, &bootfs_lazy,
+                                            &errmsg);
+    if (status == ZX_ERR_NOT_SUPPORTED) {
+        // userboot decompressed all of it
+        return;
+    }
+    if (status != ZX_OK) {
+        printf("devmgr: failed to decompress bootfs: %s\n", errmsg);
+        exit(1);
+    }
+    bootfs_lazy_active = true;
+
+    thrd_t t;
+    if (thrd_create_with_name(&t, bootfs_fill_thread, (void*)(uintptr_t)bootfs_vmo,
+                              "bootfs-fill") == thrd_success) {
+        thrd_detach(t);
+    } else {
+        bootfs_fill_thread((void*)(uintptr_t)bootfs_vmo);
+    }
+}
+
+static void devmgr_import_bootdata(zx_handle_t vmo, zx_handle_t bootfs_vmo,
+                                   zx_handle_t bootfs_map) {
     bootdata_t bootdata;
     size_t actual;
     zx_status_t status = zx_vmo_read(vmo, &bootdata, 0, sizeof(bootdata), &actual);
@@ -485,6 +536,10 @@ static void devmgr_import_bootdata(zx_handle_t vmo) {
         case BOOTDATA_PLATFORM_ID:
             devmgr_set_platform_id(vmo, off + sizeof(bootdata_t), itemlen);
             break;
+        case BOOTDATA_BOOTFS_DISCARD:
+            devmgr_fill_bootfs(vmo, off, bootdata.length + sizeof(bootdata_t),
+                               bootfs_vmo, bootfs_map);
+            break;
         default:
             break;
         }
@@ -497,13 +552,48 @@ static zx_handle_t fs_root;
 
 static bootfs_t bootfs;
 
+typedef struct {
+    const char* name;
+    zx_status_t status;
+} bootfs_fill_t;
+
+static zx_status_t bootfs_fill_entry(void* cookie, const bootfs_entry_t* entry) {
+    bootfs_fill_t* fill = cookie;
+    if (strcmp(entry->name, fill->name)) {
+        return ZX_OK;
+    }
+    const char* errmsg;
+    fill->status = bootdata_lazy_fill(&bootfs_lazy, entry->data_off, entry->data_len,
+                                      &errmsg);
+    if (fill->status != ZX_OK) {
+        printf("devmgr: failed to decompress bootfs file '%s': %s\n",
+               fill->name, errmsg);
+    }
+    return ZX_ERR_STOP;
+}
+
+// Opens |name| in the primary bootfs, first decompressing it if the
+// background fill has not got to it yet.
+static zx_status_t devmgr_bootfs_open(const char* name, zx_handle_t* vmo) {
+    if (bootfs_lazy_active) {
+        bootfs_fill_t fill = {
+            .name = name,
+            .status = ZX_OK,
+        };
+        bootfs_parse(&bootfs, bootfs_fill_entry, &fill);
+        if (fill.status != ZX_OK) {
+            return fill.status;
+        }
+    }
+    return bootfs_open(&bootfs, name, vmo);
+}
+
 static zx_status_t load_object(void* ctx, const char* name, zx_handle_t* vmo) {
     char tmp[256];
     if (snprintf(tmp, sizeof(tmp), "lib/%s", name) >= (int)sizeof(tmp)) {
         return ZX_ERR_BAD_PATH;
     }
-    bootfs_t* bootfs = ctx;
-    return bootfs_open(bootfs, tmp, vmo);
+    return devmgr_bootfs_open(tmp, vmo);
 }
 
 static zx_status_t load_abspath(void *ctx, const char* name, zx_handle_t* vmo) {
@@ -532,6 +622,8 @@ void fshost_start(void) {
         printf("devmgr: cannot find and open bootfs\n");
         exit(1);
     }
+    // Which blocks of it userboot has decompressed, if it was lazy.
+    zx_handle_t bootfs_map = zx_get_startup_handle(PA_HND(PA_VMO_BOOTFS, 1));
 
     // create a local loader service backed directly by the primary bootfs
     // to allow us to load the fshost (since we don't have filesystems before
@@ -581,12 +673,16 @@ void fshost_start(void) {
     for (size_t m = 0; n < MAXHND; m++) {
         uint32_t type = PA_HND(PA_VMO_BOOTDATA, m);
         if ((handles[n] = zx_get_startup_handle(type)) != ZX_HANDLE_INVALID) {
-            devmgr_import_bootdata(handles[n]);
+            devmgr_import_bootdata(handles[n], bootfs.vmo, bootfs_map);
             types[n++] = type;
         } else {
             break;
         }
     }
+    zx_handle_close(bootfs_map);
+    if (!bootfs_lazy_active) {
+        zx_object_signal(bootfs.vmo, 0, BOOTFS_FILLED_SIGNAL);
+    }
 
     // pass VDSO VMOS to fsboot
     vmo = ZX_HANDLE_INVALID;
@@ -642,7 +738,7 @@ zx_handle_t devmgr_load_file(const char* path) {
         return ZX_HANDLE_INVALID;
     }
     zx_handle_t vmo = ZX_HANDLE_INVALID;
-    bootfs_open(&bootfs, path + 6, &vmo);
+    devmgr_bootfs_open(path + 6, &vmo);
     return vmo;
 }
 
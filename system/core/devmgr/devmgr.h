@@ -30,6 +30,11 @@ void devmgr_launch_devhost(zx_handle_t job,
                            const char* name, int argc, char** argv,
                            zx_handle_t hdevice, zx_handle_t hrpc);
 ssize_t devmgr_add_systemfs_vmo(zx_handle_t vmo);
+
+// Signalled on the primary bootfs VMO once devmgr has finished
+// decompressing it.
+#define BOOTFS_FILLED_SIGNAL ZX_USER_SIGNAL_0
+
 bool secondary_bootfs_ready(void);
 void fshost_start(void);
 zx_status_t copy_vmo(zx_handle_t src, zx_off_t offset, size_t length, zx_handle_t* out_dest);
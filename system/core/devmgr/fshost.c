@@ -155,6 +155,8 @@ static void setup_bootfs(void) {
     unsigned idx = 0;
 
     if ((vmo = zx_get_startup_handle(HND_BOOTFS(0)))) {
+        // devmgr may still be decompressing parts of it.
+        zx_object_wait_one(vmo, BOOTFS_FILLED_SIGNAL, ZX_TIME_INFINITE, NULL);
         setup_bootfs_vmo(idx++, BOOTDATA_BOOTFS_BOOT, vmo);
     } else {
         printf("devmgr: missing primary bootfs?!\n");
@@ -194,15 +196,15 @@ static void setup_bootfs(void) {
                 printf("devmgr: unexpected bootdata container header\n");
                 goto done;
             case BOOTDATA_BOOTFS_DISCARD:
-                // this was already unpacked for us by userboot
+                // this was already unpacked for us by userboot and devmgr
                 break;
             case BOOTDATA_BOOTFS_BOOT:
             case BOOTDATA_BOOTFS_SYSTEM: {
                 const char* errmsg;
                 zx_handle_t bootfs_vmo;
-                status = decompress_bootdata(zx_vmar_root_self(), vmo,
-                                             off, bootdata.length + sizeof(bootdata_t),
-                                             &bootfs_vmo, &errmsg);
+                status = decompress_bootdata_parallel(zx_vmar_root_self(), vmo,
+                                                      off, bootdata.length + sizeof(bootdata_t),
+                                                      0, &bootfs_vmo, &errmsg);
                 if (status < 0) {
                     printf("devmgr: failed to decompress bootdata: %s\n", errmsg);
                 } else {
@@ -213,9 +215,9 @@ static void setup_bootfs(void) {
             case BOOTDATA_RAMDISK: {
                 const char* errmsg;
                 zx_handle_t ramdisk_vmo;
-                status = decompress_bootdata(
+                status = decompress_bootdata_parallel(
                     zx_vmar_root_self(), vmo,
-                    off, bootdata.length + sizeof(bootdata_t),
+                    off, bootdata.length + sizeof(bootdata_t), 0,
                     &ramdisk_vmo, &errmsg);
                 if (status != ZX_OK) {
                     printf("fshost: failed to decompress bootdata: %s\n",
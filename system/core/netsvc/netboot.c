@@ -134,8 +134,8 @@ void netboot_advertise(const char* nodename) {
     msg->cmd = NB_ADVERTISE;
     msg->arg = NB_VERSION_CURRENT;
 
-    snprintf((char*)msg->data, MAX_ADVERTISE_DATA_LEN, "version=%s;nodename=%s",
-             BOOTLOADER_VERSION, nodename);
+    snprintf((char*)msg->data, MAX_ADVERTISE_DATA_LEN, "version=%s;nodename=%s;tftp_sessions=%d",
+             BOOTLOADER_VERSION, nodename, TFTP_MAX_SESSIONS);
     const size_t data_len = strlen((char*)msg->data) + 1;
     udp6_send(buffer, sizeof(nbmsg) + data_len, &ip6_ll_all_nodes,
               NB_ADVERT_PORT, NB_SERVER_PORT, false);
@@ -56,6 +56,10 @@ void netboot_recv(void* data, size_t len, bool is_mcast,
 void netboot_run_cmd(const char* cmd);
 
 // TFTP interface
+// The number of transfers which may be in progress at once. Advertised to the
+// host as "tftp_sessions".
+#define TFTP_MAX_SESSIONS 4
+
 extern zx_time_t tftp_next_timeout;
 extern atomic_bool paving_in_progress;
 
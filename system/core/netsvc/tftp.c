@@ -11,6 +11,7 @@
 #include <unistd.h>
 
 #include <inet6/inet6.h>
+#include <inet6/netifc.h>
 #include <launchpad/launchpad.h>
 #include <sync/completion.h>
 #include <tftp/tftp.h>
@@ -34,6 +35,7 @@
 typedef enum netfile_type {
     netboot, // A bootfs file
     paver,   // A disk image which should be paved to disk
+    netcp,   // A file read or written through netfile
 } netfile_type_t;
 
 typedef struct {
@@ -62,22 +64,40 @@ typedef struct {
     ip6_addr_t dest_addr;
     uint16_t dest_port;
     uint32_t timeout_ms;
+    zx_time_t next_timeout;
 } transport_info_t;
 
-static char tftp_session_scratch[SCRATCHSZ];
-char tftp_out_scratch[SCRATCHSZ];
+// One per client, so that a host can send the kernel, ramdisk and disk images
+// at the same time. A connection is identified by the client's address and port.
+typedef struct {
+    tftp_session* session;  // NULL when the connection is not in use
+    char session_scratch[SCRATCHSZ];
+    char out_scratch[SCRATCHSZ];
+    size_t last_msg_size;
+    file_info_t file_info;
+    transport_info_t transport_info;
+} tftp_connection_t;
 
-static size_t last_msg_size = 0;
-static tftp_session* session = NULL;
-static file_info_t file_info;
-static transport_info_t transport_info;
+static tftp_connection_t connections[TFTP_MAX_SESSIONS];
 
 atomic_bool paving_in_progress = false;
 zx_time_t tftp_next_timeout = ZX_TIME_INFINITE;
 
+// There is only one netfile, so netcp transfers can't overlap each other.
+static bool netfile_in_use(void* cookie) {
+    for (size_t i = 0; i < TFTP_MAX_SESSIONS; i++) {
+        tftp_connection_t* conn = &connections[i];
+        if (conn->session != NULL && &conn->file_info != cookie &&
+            conn->file_info.type == netcp) {
+            return true;
+        }
+    }
+    return false;
+}
+
 static ssize_t file_open_read(const char* filename, void* cookie) {
     // Make sure all in-progress paving options have completed
-    if (atomic_load(&paving_in_progress) == true) {
+    if (atomic_load(&paving_in_progress) == true || netfile_in_use(cookie)) {
         return TFTP_ERR_SHOULD_WAIT;
     }
     file_info_t* file_info = cookie;
@@ -87,6 +107,7 @@ static ssize_t file_open_read(const char* filename, void* cookie) {
     file_info->netboot_file = NULL;
     size_t file_size;
     if (netfile_open(filename, O_RDONLY, &file_size) == 0) {
+        file_info->type = netcp;
         return (ssize_t)file_size;
     }
     return TFTP_ERR_NOT_FOUND;
@@ -287,8 +308,11 @@ err_close_fds:
 
 static tftp_status file_open_write(const char* filename, size_t size,
                                    void* cookie) {
-    // Make sure all in-progress paving options have completed
-    if (atomic_load(&paving_in_progress) == true) {
+    bool is_netboot = netbootloader &&
+                      !strncmp(filename, NB_FILENAME_PREFIX, NB_FILENAME_PREFIX_LEN);
+    // Make sure all in-progress paving options have completed. The netboot buffers are
+    // separate from the paver's, so those may be written while an image is being paved.
+    if (!is_netboot && atomic_load(&paving_in_progress) == true) {
         return TFTP_ERR_SHOULD_WAIT;
     }
     file_info_t* file_info = cookie;
@@ -296,7 +320,7 @@ static tftp_status file_open_write(const char* filename, size_t size,
     strncpy(file_info->filename, filename, PATH_MAX);
     file_info->filename[PATH_MAX] = '\0';
 
-    if (netbootloader && !strncmp(filename, NB_FILENAME_PREFIX, NB_FILENAME_PREFIX_LEN)) {
+    if (is_netboot) {
         // netboot
         file_info->type = netboot;
         file_info->netboot_file = netboot_get_buffer(filename, size);
@@ -312,7 +336,11 @@ static tftp_status file_open_write(const char* filename, size_t size,
         return status;
     } else {
         // netcp
+        if (netfile_in_use(cookie)) {
+            return TFTP_ERR_SHOULD_WAIT;
+        }
         if (netfile_open(filename, O_WRONLY, NULL) == 0) {
+            file_info->type = netcp;
             return TFTP_NO_ERROR;
         }
     }
@@ -374,7 +402,7 @@ static tftp_status file_write(const void* data, size_t* length, off_t offset, vo
 
 static void file_close(void* cookie) {
     file_info_t* file_info = cookie;
-    if (file_info->type == netboot && file_info->netboot_file == NULL) {
+    if (file_info->type == netcp) {
         netfile_close();
     } else if (file_info->type == paver) {
         unsigned int refcount = atomic_fetch_sub(&file_info->paver.buf_refcount, 1);
@@ -384,6 +412,18 @@ static void file_close(void* cookie) {
     }
 }
 
+// Called whenever the deadline of a connection changes.
+static void update_tftp_timeout(void) {
+    tftp_next_timeout = ZX_TIME_INFINITE;
+    for (size_t i = 0; i < TFTP_MAX_SESSIONS; i++) {
+        tftp_connection_t* conn = &connections[i];
+        if (conn->session != NULL && conn->transport_info.next_timeout < tftp_next_timeout) {
+            tftp_next_timeout = conn->transport_info.next_timeout;
+        }
+    }
+    update_timeouts();
+}
+
 static tftp_status transport_send(void* data, size_t len, void* transport_cookie) {
     transport_info_t* transport_info = transport_cookie;
     zx_status_t status = udp6_send(data, len, &transport_info->dest_addr,
@@ -395,8 +435,8 @@ static tftp_status transport_send(void* data, size_t len, void* transport_cookie
     // The timeout is relative to sending instead of receiving a packet, since there are some
     // received packets we want to ignore (duplicate ACKs).
     if (transport_info->timeout_ms != 0) {
-        tftp_next_timeout = zx_deadline_after(ZX_MSEC(transport_info->timeout_ms));
-        update_timeouts();
+        transport_info->next_timeout = zx_deadline_after(ZX_MSEC(transport_info->timeout_ms));
+        update_tftp_timeout();
     }
     return TFTP_NO_ERROR;
 }
@@ -407,51 +447,105 @@ static int transport_timeout_set(uint32_t timeout_ms, void* transport_cookie) {
     return 0;
 }
 
-static void initialize_connection(const ip6_addr_t* saddr, uint16_t sport) {
-    int ret = tftp_init(&session, tftp_session_scratch,
-                        sizeof(tftp_session_scratch));
+// The largest block which fits in a single frame on our interface.
+static uint16_t tftp_block_size(void) {
+    uint8_t mac[6];
+    uint16_t mtu;
+    netifc_get_info(mac, &mtu);
+    size_t max_mtu = ETH_MTU - ETH_HDR_LEN;
+    if (mtu == 0 || mtu > max_mtu) {
+        mtu = max_mtu;
+    }
+    // Less the TFTP opcode and block number
+    return mtu - IP6_HDR_LEN - UDP_HDR_LEN - 4;
+}
+
+static tftp_connection_t* find_connection(const ip6_addr_t* saddr, uint16_t sport) {
+    for (size_t i = 0; i < TFTP_MAX_SESSIONS; i++) {
+        tftp_connection_t* conn = &connections[i];
+        if (conn->session != NULL && conn->transport_info.dest_port == sport &&
+            !memcmp(&conn->transport_info.dest_addr, saddr, sizeof(ip6_addr_t))) {
+            return conn;
+        }
+    }
+    return NULL;
+}
+
+static tftp_connection_t* initialize_connection(const ip6_addr_t* saddr, uint16_t sport) {
+    tftp_connection_t* conn = NULL;
+    for (size_t i = 0; i < TFTP_MAX_SESSIONS; i++) {
+        // The paver's copy thread holds on to the file_info of the connection which
+        // started it until it is done.
+        if (connections[i].session == NULL &&
+            !(connections[i].file_info.type == paver && atomic_load(&paving_in_progress))) {
+            conn = &connections[i];
+            break;
+        }
+    }
+    if (conn == NULL) {
+        return NULL;
+    }
+
+    int ret = tftp_init(&conn->session, conn->session_scratch,
+                        sizeof(conn->session_scratch));
     if (ret != TFTP_NO_ERROR) {
         printf("netsvc: failed to initiate tftp session\n");
-        session = NULL;
-        return;
+        conn->session = NULL;
+        return NULL;
     }
 
     // Initialize file interface
+    conn->file_info.type = netboot;
+    conn->file_info.netboot_file = NULL;
     tftp_file_interface file_ifc = {file_open_read, file_open_write,
                                     file_read, file_write, file_close};
-    tftp_session_set_file_interface(session, &file_ifc);
+    tftp_session_set_file_interface(conn->session, &file_ifc);
 
     // Initialize transport interface
-    memcpy(&transport_info.dest_addr, saddr, sizeof(ip6_addr_t));
-    transport_info.dest_port = sport;
-    transport_info.timeout_ms = TFTP_TIMEOUT_SECS * 1000;
+    memcpy(&conn->transport_info.dest_addr, saddr, sizeof(ip6_addr_t));
+    conn->transport_info.dest_port = sport;
+    conn->transport_info.timeout_ms = TFTP_TIMEOUT_SECS * 1000;
+    conn->transport_info.next_timeout = ZX_TIME_INFINITE;
     tftp_transport_interface transport_ifc = {transport_send, NULL, transport_timeout_set};
-    tftp_session_set_transport_interface(session, &transport_ifc);
+    tftp_session_set_transport_interface(conn->session, &transport_ifc);
+
+    // Use the largest blocks the link allows unless the client insists otherwise, and let
+    // the window follow the loss we see.
+    uint16_t block_size = tftp_block_size();
+    tftp_set_options(conn->session, &block_size, NULL, NULL);
+    tftp_session_set_adaptive_window(conn->session, true);
+    return conn;
 }
 
-static void end_connection(void) {
-    session = NULL;
-    tftp_next_timeout = ZX_TIME_INFINITE;
+static void end_connection(tftp_connection_t* conn) {
+    conn->session = NULL;
+    update_tftp_timeout();
 }
 
-void tftp_timeout_expired(void) {
-    tftp_status result = tftp_timeout(session, tftp_out_scratch, &last_msg_size,
-                                      sizeof(tftp_out_scratch), &transport_info.timeout_ms,
-                                      &file_info);
+static void connection_timeout_expired(tftp_connection_t* conn) {
+    tftp_status result = tftp_timeout(conn->session, conn->out_scratch, &conn->last_msg_size,
+                                      sizeof(conn->out_scratch),
+                                      &conn->transport_info.timeout_ms, &conn->file_info);
     if (result == TFTP_ERR_TIMED_OUT) {
         printf("netsvc: excessive timeouts, dropping tftp connection\n");
-        file_close(&file_info);
-        end_connection();
-        netfile_abort_write();
+        bool is_netcp = conn->file_info.type == netcp;
+        file_close(&conn->file_info);
+        end_connection(conn);
+        if (is_netcp) {
+            netfile_abort_write();
+        }
     } else if (result < 0) {
         printf("netsvc: failed to generate timeout response, dropping tftp connection\n");
-        file_close(&file_info);
-        end_connection();
-        netfile_abort_write();
+        bool is_netcp = conn->file_info.type == netcp;
+        file_close(&conn->file_info);
+        end_connection(conn);
+        if (is_netcp) {
+            netfile_abort_write();
+        }
     } else {
-        if (last_msg_size > 0) {
-            tftp_status send_result = transport_send(tftp_out_scratch, last_msg_size,
-                                                     &transport_info);
+        if (conn->last_msg_size > 0) {
+            tftp_status send_result = transport_send(conn->out_scratch, conn->last_msg_size,
+                                                     &conn->transport_info);
             if (send_result != TFTP_NO_ERROR) {
                 printf("netsvc: failed to send tftp timeout response (err = %d)\n", send_result);
             }
@@ -459,61 +553,94 @@ void tftp_timeout_expired(void) {
     }
 }
 
+void tftp_timeout_expired(void) {
+    zx_time_t now = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    for (size_t i = 0; i < TFTP_MAX_SESSIONS; i++) {
+        tftp_connection_t* conn = &connections[i];
+        if (conn->session != NULL && now > conn->transport_info.next_timeout) {
+            connection_timeout_expired(conn);
+        }
+    }
+}
+
 void tftp_recv(void* data, size_t len,
                const ip6_addr_t* daddr, uint16_t dport,
                const ip6_addr_t* saddr, uint16_t sport) {
+    tftp_connection_t* conn = find_connection(saddr, sport);
     if (dport == NB_TFTP_INCOMING_PORT) {
-        if (session != NULL) {
-            printf("netsvc: only one simultaneous tftp session allowed\n");
-            // ignore attempts to connect when a session is in progress
+        if (conn != NULL) {
+            // ignore a repeated request for a session already in progress
             return;
         }
-        initialize_connection(saddr, sport);
-    } else if (!session) {
+        conn = initialize_connection(saddr, sport);
+        if (conn == NULL) {
+            printf("netsvc: only %d simultaneous tftp sessions allowed\n", TFTP_MAX_SESSIONS);
+            // ignore attempts to connect when all sessions are in use
+            return;
+        }
+    } else if (conn == NULL) {
         // Ignore anything sent to the outgoing port unless we've already
         // established a connection.
         return;
     }
 
-    last_msg_size = sizeof(tftp_out_scratch);
+    conn->last_msg_size = sizeof(conn->out_scratch);
 
     char err_msg[128];
     tftp_handler_opts handler_opts = {.inbuf = data,
                                       .inbuf_sz = len,
-                                      .outbuf = tftp_out_scratch,
-                                      .outbuf_sz = &last_msg_size,
+                                      .outbuf = conn->out_scratch,
+                                      .outbuf_sz = &conn->last_msg_size,
                                       .err_msg = err_msg,
                                       .err_msg_sz = sizeof(err_msg)};
-    tftp_status status = tftp_handle_msg(session, &transport_info, &file_info,
-                                         &handler_opts);
+    tftp_status status = tftp_handle_msg(conn->session, &conn->transport_info,
+                                         &conn->file_info, &handler_opts);
     switch (status) {
     case TFTP_NO_ERROR:
         return;
     case TFTP_TRANSFER_COMPLETED:
         printf("netsvc: tftp %s of file %s completed\n",
-               file_info.is_write ? "write" : "read",
-               file_info.filename);
+               conn->file_info.is_write ? "write" : "read",
+               conn->file_info.filename);
         break;
     case TFTP_ERR_SHOULD_WAIT:
         break;
     default:
         printf("netsvc: %s\n", err_msg);
-        netfile_abort_write();
-        file_close(&file_info);
+        if (conn->file_info.type == netcp) {
+            netfile_abort_write();
+        }
+        file_close(&conn->file_info);
         break;
     }
-    end_connection();
+    end_connection(conn);
 }
 
 bool tftp_has_pending(void) {
-    return session && tftp_session_has_pending(session);
+    for (size_t i = 0; i < TFTP_MAX_SESSIONS; i++) {
+        tftp_connection_t* conn = &connections[i];
+        if (conn->session != NULL && tftp_session_has_pending(conn->session)) {
+            return true;
+        }
+    }
+    return false;
 }
 
 void tftp_send_next(void) {
-    last_msg_size = sizeof(tftp_out_scratch);
-    tftp_prepare_data(session, tftp_out_scratch, &last_msg_size, &transport_info.timeout_ms,
-                      &file_info);
-    if (last_msg_size) {
-        transport_send(tftp_out_scratch, last_msg_size, &transport_info);
+    // Take turns, so that one connection's window doesn't hold up the others.
+    static size_t next_conn = 0;
+    for (size_t i = 0; i < TFTP_MAX_SESSIONS; i++) {
+        tftp_connection_t* conn = &connections[(next_conn + i) % TFTP_MAX_SESSIONS];
+        if (conn->session == NULL || !tftp_session_has_pending(conn->session)) {
+            continue;
+        }
+        next_conn = (next_conn + i + 1) % TFTP_MAX_SESSIONS;
+        conn->last_msg_size = sizeof(conn->out_scratch);
+        tftp_prepare_data(conn->session, conn->out_scratch, &conn->last_msg_size,
+                          &conn->transport_info.timeout_ms, &conn->file_info);
+        if (conn->last_msg_size) {
+            transport_send(conn->out_scratch, conn->last_msg_size, &conn->transport_info);
+        }
+        return;
     }
 }
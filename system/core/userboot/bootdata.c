@@ -15,7 +15,8 @@
 #pragma GCC visibility pop
 
 zx_handle_t bootdata_get_bootfs(zx_handle_t log, zx_handle_t vmar_self,
-                                zx_handle_t bootdata_vmo) {
+                                zx_handle_t bootdata_vmo,
+                                bootdata_lazy_t* lazy, zx_handle_t* map) {
     size_t off = 0;
     for (;;) {
         bootdata_t bootdata;
@@ -42,10 +43,18 @@ zx_handle_t bootdata_get_bootfs(zx_handle_t log, zx_handle_t vmar_self,
 
         case BOOTDATA_BOOTFS_BOOT:;
             const char* errmsg;
-            zx_handle_t bootfs_vmo;
-            status = decompress_bootdata(vmar_self, bootdata_vmo, off,
-                                         bootdata.length + sizeof(bootdata),
-                                         &bootfs_vmo, &errmsg);
+            // Only the blocks holding the files we load are decompressed
+            // here.  devmgr decompresses the rest.
+            zx_handle_t bootfs_vmo = ZX_HANDLE_INVALID;
+            *map = ZX_HANDLE_INVALID;
+            status = bootdata_lazy_open(vmar_self, bootdata_vmo, off,
+                                        bootdata.length + sizeof(bootdata),
+                                        &bootfs_vmo, map, lazy, &errmsg);
+            if (status == ZX_ERR_NOT_SUPPORTED) {
+                status = decompress_bootdata(vmar_self, bootdata_vmo, off,
+                                             bootdata.length + sizeof(bootdata),
+                                             &bootfs_vmo, &errmsg);
+            }
             check(log, status, "%s", errmsg);
 
             // Signal that we've already processed this one.
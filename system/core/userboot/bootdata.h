@@ -6,9 +6,15 @@
 
 #pragma GCC visibility push(hidden)
 
+#include <bootdata/decompress.h>
 #include <zircon/types.h>
 
+// Returns the VMO of the first bootfs.  If it is compressed with a block
+// index, *lazy is set up to decompress its contents as they are needed,
+// and *map is the VMO recording which blocks have been decompressed.
+// Otherwise *map is ZX_HANDLE_INVALID.
 zx_handle_t bootdata_get_bootfs(zx_handle_t log, zx_handle_t vmar_self,
-                                zx_handle_t bootdata_vmo);
+                                zx_handle_t bootdata_vmo,
+                                bootdata_lazy_t* lazy, zx_handle_t* map);
 
 #pragma GCC visibility pop
@@ -13,7 +13,14 @@
 
 #pragma GCC visibility pop
 
-void bootfs_mount(zx_handle_t vmar, zx_handle_t log, zx_handle_t vmo, struct bootfs *fs) {
+static void bootfs_fill(zx_handle_t log, struct bootfs *fs, size_t off, size_t len) {
+    const char* errmsg;
+    zx_status_t status = bootdata_lazy_fill(fs->lazy, off, len, &errmsg);
+    check(log, status, "%s", errmsg);
+}
+
+void bootfs_mount(zx_handle_t vmar, zx_handle_t log, zx_handle_t vmo,
+                  bootdata_lazy_t* lazy, struct bootfs *fs) {
     uint64_t size;
     zx_status_t status = zx_vmo_get_size(vmo, &size);
     check(log, status, "zx_vmo_get_size failed on bootfs vmo\n");
@@ -28,6 +35,14 @@ void bootfs_mount(zx_handle_t vmar, zx_handle_t log, zx_handle_t vmo, struct boo
         ZX_RIGHTS_BASIC | ZX_RIGHT_GET_PROPERTY,
         &fs->vmo);
     check(log, status, "zx_handle_duplicate failed on bootfs VMO handle\n");
+
+    // Decompress the directory.
+    fs->lazy = lazy;
+    if (fs->len >= sizeof(bootfs_header_t)) {
+        bootfs_fill(log, fs, 0, sizeof(bootfs_header_t));
+        const bootfs_header_t* hdr = fs->contents;
+        bootfs_fill(log, fs, sizeof(bootfs_header_t), hdr->dirsize);
+    }
 }
 
 void bootfs_unmount(zx_handle_t vmar, zx_handle_t log, struct bootfs *fs) {
@@ -35,6 +50,7 @@ void bootfs_unmount(zx_handle_t vmar, zx_handle_t log, struct bootfs *fs) {
     check(log, status, "zx_vmar_unmap failed\n");
     status = zx_handle_close(fs->vmo);
     check(log, status, "zx_handle_close failed\n");
+    bootdata_lazy_close(fs->lazy);
 }
 
 static const bootfs_entry_t* bootfs_search(zx_handle_t log,
@@ -87,6 +103,8 @@ zx_handle_t bootfs_open(zx_handle_t log, const char* purpose,
     if (fs->len - e->data_off < e->data_len)
         fail(log, "bogus size in bootfs header!");
 
+    bootfs_fill(log, fs, e->data_off, e->data_len);
+
     // Clone a private copy of the file's subset of the bootfs VMO.
     // TODO(mcgrathr): Create a plain read-only clone when the feature
     // is implemented in the VM.
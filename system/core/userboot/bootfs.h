@@ -6,6 +6,7 @@
 
 #pragma GCC visibility push(hidden)
 
+#include <bootdata/decompress.h>
 #include <zircon/types.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -14,9 +15,13 @@ struct bootfs {
     zx_handle_t vmo;
     const void* contents;
     size_t len;
+    bootdata_lazy_t* lazy;
 };
 
-void bootfs_mount(zx_handle_t vmar, zx_handle_t log, zx_handle_t vmo, struct bootfs *fs);
+// The parts of the bootfs in use are decompressed through lazy, which is
+// closed by bootfs_unmount.
+void bootfs_mount(zx_handle_t vmar, zx_handle_t log, zx_handle_t vmo,
+                  bootdata_lazy_t* lazy, struct bootfs *fs);
 void bootfs_unmount(zx_handle_t vmar, zx_handle_t log, struct bootfs *fs);
 
 zx_handle_t bootfs_open(zx_handle_t log, const char* purpose,
@@ -80,6 +80,8 @@ static zx_handle_t reserve_low_address_space(zx_handle_t log,
 
 enum {
     EXTRA_HANDLE_BOOTFS,
+    // Last, since it is left out when there is no map.
+    EXTRA_HANDLE_BOOTFS_MAP,
     EXTRA_HANDLE_COUNT
 };
 
@@ -201,19 +203,33 @@ static noreturn void bootstrap(zx_handle_t log, zx_handle_t bootstrap_pipe) {
     if (status < 0)
         fail(log, "zx_handle_duplicate failed: %d", status);
 
-    // Locate the first bootfs bootdata section and decompress it.
-    // We need it to load devmgr and libc from.
+    // Locate the first bootfs bootdata section and prepare to decompress
+    // it.  We need it to load devmgr and libc from.
     // Later bootfs sections will be processed by devmgr.
-    zx_handle_t bootfs_vmo = bootdata_get_bootfs(log, vmar_self, bootdata_vmo);
+    bootdata_lazy_t lazy;
+    zx_handle_t bootfs_map;
+    zx_handle_t bootfs_vmo = bootdata_get_bootfs(log, vmar_self, bootdata_vmo,
+                                                 &lazy, &bootfs_map);
 
-    // Pass the decompressed bootfs VMO on.
+    // Pass the bootfs VMO on.  devmgr decompresses whatever we don't,
+    // skipping the blocks the map says we already have.
     handles[nhandles + EXTRA_HANDLE_BOOTFS] = bootfs_vmo;
     handle_info[nhandles + EXTRA_HANDLE_BOOTFS] =
         PA_HND(PA_VMO_BOOTFS, 0);
+    uint32_t nextra = EXTRA_HANDLE_COUNT;
+    if (bootfs_map != ZX_HANDLE_INVALID) {
+        handles[nhandles + EXTRA_HANDLE_BOOTFS_MAP] = bootfs_map;
+        handle_info[nhandles + EXTRA_HANDLE_BOOTFS_MAP] =
+            PA_HND(PA_VMO_BOOTFS, 1);
+    } else {
+        // The info slot stays in the message, but nothing refers to it.
+        handle_info[nhandles + EXTRA_HANDLE_BOOTFS_MAP] = 0;
+        nextra--;
+    }
 
     // Map in the bootfs so we can look for files in it.
     struct bootfs bootfs;
-    bootfs_mount(vmar_self, log, bootfs_vmo, &bootfs);
+    bootfs_mount(vmar_self, log, bootfs_vmo, &lazy, &bootfs);
 
     // Make the channel for the bootstrap message.
     zx_handle_t to_child;
@@ -295,7 +311,7 @@ static noreturn void bootstrap(zx_handle_t log, zx_handle_t bootstrap_pipe) {
     // send the job handle, which in the future means that we can't create more
     // processes from here on.
     status = zx_channel_write(to_child, 0, buffer, nbytes,
-                              handles, nhandles + EXTRA_HANDLE_COUNT);
+                              handles, nhandles + nextra);
     check(log, status, "zx_channel_write to child failed");
     status = zx_handle_close(to_child);
     check(log, status, "zx_handle_close failed on channel handle");
@@ -23,7 +23,9 @@ GaussPdmInputStream::~GaussPdmInputStream() {}
 zx_status_t GaussPdmInputStream::Create(zx_device_t* parent) {
     zxlogf(DEBUG1, "%s\n", __func__);
 
-    auto domain = dispatcher::ExecutionDomain::Create();
+    auto domain = dispatcher::ExecutionDomain::Create(
+            dispatcher::ExecutionDomain::DEFAULT_PRIORITY,
+            dispatcher::ExecutionDomain::DispatchHint::LowLatency);
     if (domain == nullptr) {
         return ZX_ERR_NO_MEMORY;
     }
@@ -21,7 +21,9 @@ TdmOutputStream::~TdmOutputStream() {}
 
 // static
 zx_status_t TdmOutputStream::Create(zx_device_t* parent) {
-    auto domain = dispatcher::ExecutionDomain::Create();
+    auto domain = dispatcher::ExecutionDomain::Create(
+            dispatcher::ExecutionDomain::DEFAULT_PRIORITY,
+            dispatcher::ExecutionDomain::DispatchHint::LowLatency);
     if (domain == nullptr) {
         return ZX_ERR_NO_MEMORY;
     }
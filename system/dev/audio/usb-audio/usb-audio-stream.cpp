@@ -48,7 +48,9 @@ zx_status_t UsbAudioStream::Create(bool is_input,
                                    usb_interface_descriptor_t* usb_interface,
                                    usb_endpoint_descriptor_t* usb_endpoint,
                                    usb_audio_ac_format_type_i_desc* format_desc) {
-    auto domain = dispatcher::ExecutionDomain::Create();
+    auto domain = dispatcher::ExecutionDomain::Create(
+            dispatcher::ExecutionDomain::DEFAULT_PRIORITY,
+            dispatcher::ExecutionDomain::DispatchHint::LowLatency);
     if (domain == nullptr) { return ZX_ERR_NO_MEMORY; }
 
     auto stream = fbl::AdoptRef(
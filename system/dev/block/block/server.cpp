@@ -59,31 +59,122 @@ void BlockComplete(void* cookie, zx_status_t status) {
     blktxn->Complete(msg, status);
 }
 
-void BlockCompleteCb(block_op_t* bop, zx_status_t status) {
-    BlockComplete(bop->cookie, status);
-    free(bop);
-}
+// Server bookkeeping for a block_op_t, allocated just past the block_op_size_
+// bytes which belong to the device.
+struct BlockOpExtra {
+    BlockServer* server;
+    block_msg_t* msgs;
+};
 
 }  // namespace
 
-void BlockServer::Queue(uint32_t flags, zx_handle_t vmo, uint64_t length,
-                        uint64_t vmo_offset, uint64_t dev_offset, block_msg_t* msg) {
-    block_op_t* bop = (block_op_t*) malloc(block_op_size_);
+void BlockServer::BlockOpComplete(block_op_t* bop, zx_status_t status) {
+    BlockOpExtra* extra = static_cast<BlockOpExtra*>(bop->cookie);
+    BlockServer* server = extra->server;
+    block_msg_t* msg = extra->msgs;
+    while (msg != nullptr) {
+        // Completing the last message of a txn allows the client to reuse
+        // it, so find the next message first.
+        block_msg_t* next = msg->next;
+        BlockComplete(msg, status);
+        msg = next;
+    }
+    free(bop);
+    server->OpFinished();
+}
+
+void BlockServer::Queue(uint32_t command, zx_handle_t vmo, uint64_t length,
+                        uint64_t vmo_offset, uint64_t dev_offset, block_msg_t* msgs) {
+    size_t extra_offset = fbl::round_up(block_op_size_, alignof(BlockOpExtra));
+    block_op_t* bop = (block_op_t*) malloc(extra_offset + sizeof(BlockOpExtra));
     if (bop == nullptr) {
-        BlockComplete(msg, ZX_ERR_NO_MEMORY);
+        while (msgs != nullptr) {
+            block_msg_t* next = msgs->next;
+            BlockComplete(msgs, ZX_ERR_NO_MEMORY);
+            msgs = next;
+        }
         return;
     }
-    bop->command = (msg->opcode == BLOCKIO_READ) ? BLOCK_OP_READ : BLOCK_OP_WRITE;
+    BlockOpExtra* extra = reinterpret_cast<BlockOpExtra*>(
+            reinterpret_cast<uintptr_t>(bop) + extra_offset);
+    extra->server = this;
+    extra->msgs = msgs;
+
+    bop->command = command;
     bop->rw.length = (uint32_t) length;
     bop->rw.vmo = vmo;
     bop->rw.offset_dev = dev_offset;
     bop->rw.offset_vmo = vmo_offset;
     bop->rw.pages = NULL;
-    bop->completion_cb = BlockCompleteCb;
-    bop->cookie = msg;
+    bop->completion_cb = BlockOpComplete;
+    bop->cookie = extra;
+
+    {
+        fbl::AutoLock lock(&in_flight_lock_);
+        if (in_flight_++ == 0) {
+            completion_reset(&idle_);
+        }
+    }
     bp_.ops->queue(bp_.ctx, bop);
 }
 
+void BlockServer::OpFinished() {
+    fbl::AutoLock lock(&in_flight_lock_);
+    ZX_DEBUG_ASSERT(in_flight_ > 0);
+    if (--in_flight_ == 0) {
+        completion_signal(&idle_);
+    }
+}
+
+void BlockServer::WaitIdle() {
+    completion_wait(&idle_, ZX_TIME_INFINITE);
+    // The op which signalled |idle_| may still hold the lock; once it has
+    // let go, it no longer touches the server.
+    fbl::AutoLock lock(&in_flight_lock_);
+}
+
+void BlockServer::MergeLocked(const block_fifo_request_t& request, const IoBuffer* iobuf,
+                              block_msg_t* msg) {
+    uint32_t command = (msg->opcode == BLOCKIO_READ) ? BLOCK_OP_READ : BLOCK_OP_WRITE;
+    const uint64_t max_xfer = info_.max_transfer_size / info_.block_size;
+    const uint64_t max_length = (max_xfer != 0) ? max_xfer :
+                                fbl::numeric_limits<uint32_t>::max();
+    PendingOp* p = &pending_;
+    // Only merge while the result stays on the device, so that a request
+    // which is out of range fails alone rather than taking its valid
+    // neighbours down with it.
+    if (p->head != nullptr && p->command == command && p->iobuf == iobuf &&
+        p->vmo_offset + p->length == request.vmo_offset &&
+        p->dev_offset + p->length == request.dev_offset &&
+        request.length <= max_length - p->length &&
+        request.dev_offset + request.length <= info_.block_count) {
+        p->length += request.length;
+        p->tail->next = msg;
+        p->tail = msg;
+        return;
+    }
+
+    FlushPendingLocked();
+    p->command = command;
+    p->iobuf = iobuf;
+    p->length = request.length;
+    p->vmo_offset = request.vmo_offset;
+    p->dev_offset = request.dev_offset;
+    p->head = msg;
+    p->tail = msg;
+}
+
+void BlockServer::FlushPendingLocked() {
+    PendingOp* p = &pending_;
+    if (p->head == nullptr) {
+        return;
+    }
+    Queue(p->command, p->iobuf->vmo(), p->length, p->vmo_offset, p->dev_offset, p->head);
+    p->head = nullptr;
+    p->tail = nullptr;
+    p->iobuf = nullptr;
+}
+
 BlockTransaction::BlockTransaction(zx_handle_t fifo, txnid_t txnid) :
     fifo_(fifo), flags_(0), ctr_(0) {
     memset(&response_, 0, sizeof(response_));
@@ -113,6 +204,7 @@ zx_status_t BlockTransaction::Enqueue(bool do_respond, block_msg_t** msg_out) {
     ZX_DEBUG_ASSERT(ctr_ < MAX_TXN_MESSAGES); // Avoid overflowing msgs
     msgs_[ctr_].flags = 0;
     msgs_[ctr_].sub_txns = 1;
+    msgs_[ctr_].next = nullptr;
     *msg_out = &msgs_[ctr_++];
     if (do_respond) {
         SetResponseReadyLocked();
@@ -201,8 +293,16 @@ zx_status_t BlockServer::Read(block_fifo_request_t* requests, uint32_t* count) {
     // Keep trying to read messages from the fifo until we have a reason to
     // terminate
     while (true) {
-        zx_status_t status = fifo_.read(requests, sizeof(block_fifo_request_t), count);
+        zx_status_t status = fifo_.read(requests,
+                                        sizeof(block_fifo_request_t) * BLOCK_FIFO_MAX_DEPTH,
+                                        count);
         if (status == ZX_ERR_SHOULD_WAIT) {
+            // Nothing further can be merged with the pending run until the
+            // client sends more, so don't hold it back while waiting.
+            {
+                fbl::AutoLock server_lock(&server_lock_);
+                FlushPendingLocked();
+            }
             zx_signals_t waitfor = ZX_FIFO_READABLE | ZX_FIFO_PEER_CLOSED | kSignalFifoTerminate;
             zx_signals_t observed;
             if ((status = fifo_.wait_one(waitfor, zx::time::infinite(), &observed)) != ZX_OK) {
@@ -308,7 +408,14 @@ zx_status_t BlockServer::Serve() {
     block_fifo_request_t requests[BLOCK_FIFO_MAX_DEPTH];
     uint32_t count;
     while (true) {
-        if ((status = Read(requests, &count) != ZX_OK)) {
+        if ((status = Read(requests, &count)) != ZX_OK) {
+            {
+                fbl::AutoLock server_lock(&server_lock_);
+                FlushPendingLocked();
+            }
+            // The server is freed once Serve returns, so wait for the device
+            // to finish with everything which will call back into it.
+            WaitIdle();
             return status;
         }
 
@@ -317,104 +424,137 @@ zx_status_t BlockServer::Serve() {
             txnid_t txnid = requests[i].txnid;
             vmoid_t vmoid = requests[i].vmoid;
 
-            fbl::AutoLock server_lock(&server_lock_);
-            if (txnid >= MAX_TXN_COUNT || txns_[txnid] == nullptr) {
-                // Operation which is not accessing a valid txn
-                if (wants_reply) {
-                    OutOfBandRespond(fifo_, ZX_ERR_IO, txnid);
+            // Set by BLOCKIO_SYNC, which waits for the device once the lock
+            // has been dropped.
+            block_msg_t* sync_msg = nullptr;
+            {
+                fbl::AutoLock server_lock(&server_lock_);
+                if (txnid >= MAX_TXN_COUNT || txns_[txnid] == nullptr) {
+                    // Operation which is not accessing a valid txn
+                    if (wants_reply) {
+                        OutOfBandRespond(fifo_, ZX_ERR_IO, txnid);
+                    }
+                    continue;
                 }
-                continue;
-            }
-
-            auto iobuf = tree_.find(vmoid);
-            if (!iobuf.IsValid()) {
-                // Operation which is not accessing a valid vmo
-                txns_[txnid]->SetResponse(ZX_ERR_IO, wants_reply);
-                continue;
-            }
 
-            switch (requests[i].opcode & BLOCKIO_OP_MASK) {
-            case BLOCKIO_READ:
-            case BLOCKIO_WRITE: {
-                if ((requests[i].length < 1) ||
-                    (requests[i].length > fbl::numeric_limits<uint32_t>::max())) {
-                    // Operation which is too small or too large
-                    txns_[txnid]->SetResponse(ZX_ERR_INVALID_ARGS, wants_reply);
+                auto iobuf = tree_.find(vmoid);
+                if (!iobuf.IsValid()) {
+                    // Operation which is not accessing a valid vmo
+                    txns_[txnid]->SetResponse(ZX_ERR_IO, wants_reply);
                     continue;
                 }
 
-                block_msg_t* msg;
-                status = txns_[txnid]->Enqueue(wants_reply, &msg);
-                if (status != ZX_OK) {
+                switch (requests[i].opcode & BLOCKIO_OP_MASK) {
+                case BLOCKIO_READ:
+                case BLOCKIO_WRITE: {
+                    if ((requests[i].length < 1) ||
+                        (requests[i].length > fbl::numeric_limits<uint32_t>::max())) {
+                        // Operation which is too small or too large
+                        txns_[txnid]->SetResponse(ZX_ERR_INVALID_ARGS, wants_reply);
+                        continue;
+                    }
+
+                    block_msg_t* msg;
+                    status = txns_[txnid]->Enqueue(wants_reply, &msg);
+                    if (status != ZX_OK) {
+                        break;
+                    }
+                    ZX_DEBUG_ASSERT(msg->txn == nullptr);
+                    msg->txn = txns_[txnid];
+                    ZX_DEBUG_ASSERT(msg->iobuf == nullptr);
+                    msg->iobuf = iobuf.CopyPointer();
+
+                    // Hack to ensure that the vmo is valid.
+                    // In the future, this code will be responsible for pinning VMO pages,
+                    // and the completion will be responsible for un-pinning those same pages.
+                    size_t bsz = info_.block_size;
+                    status = iobuf->ValidateVmoHack(bsz * requests[i].length,
+                                                    bsz * requests[i].vmo_offset);
+                    if (status != ZX_OK) {
+                        BlockComplete(msg, status);
+                        break;
+                    }
+
+                    msg->opcode = requests[i].opcode & BLOCKIO_OP_MASK;
+
+                    const uint64_t max_xfer = info_.max_transfer_size / bsz;
+                    if (max_xfer != 0 && max_xfer < requests[i].length) {
+                        // Too large to merge with anything; keep it in order
+                        // behind whatever is pending.
+                        FlushPendingLocked();
+                        uint32_t command = (msg->opcode == BLOCKIO_READ) ? BLOCK_OP_READ :
+                                                                           BLOCK_OP_WRITE;
+                        uint64_t len_remaining = requests[i].length;
+                        uint64_t vmo_offset = requests[i].vmo_offset;
+                        uint64_t dev_offset = requests[i].dev_offset;
+
+                        size_t sub_txns = fbl::round_up(len_remaining, max_xfer) / max_xfer;
+                        msg->sub_txns = static_cast<uint32_t>(sub_txns);
+                        for (size_t i = 0; i < sub_txns; i++) {
+                            uint64_t length = fbl::min(len_remaining, max_xfer);
+                            len_remaining -= length;
+
+                            Queue(command, iobuf->vmo(), length,
+                                  vmo_offset, dev_offset, msg);
+                            vmo_offset += length;
+                            dev_offset += length;
+                        }
+                        ZX_DEBUG_ASSERT(len_remaining == 0);
+                    } else {
+                        MergeLocked(requests[i], &*iobuf, msg);
+                    }
+
                     break;
                 }
-                ZX_DEBUG_ASSERT(msg->txn == nullptr);
-                msg->txn = txns_[txnid];
-                ZX_DEBUG_ASSERT(msg->iobuf == nullptr);
-                msg->iobuf = iobuf.CopyPointer();
-
-                // Hack to ensure that the vmo is valid.
-                // In the future, this code will be responsible for pinning VMO pages,
-                // and the completion will be responsible for un-pinning those same pages.
-                size_t bsz = info_.block_size;
-                status = iobuf->ValidateVmoHack(bsz * requests[i].length,
-                                                bsz * requests[i].vmo_offset);
-                if (status != ZX_OK) {
-                    BlockComplete(msg, status);
+                case BLOCKIO_SYNC: {
+                    // TODO(smklein): It might be more useful to have this on a per-vmo basis
+                    block_msg_t* msg;
+                    status = txns_[txnid]->Enqueue(wants_reply, &msg);
+                    if (status != ZX_OK) {
+                        break;
+                    }
+                    ZX_DEBUG_ASSERT(msg->txn == nullptr);
+                    msg->txn = txns_[txnid];
+                    ZX_DEBUG_ASSERT(msg->iobuf == nullptr);
+                    msg->iobuf = iobuf.CopyPointer();
+                    msg->opcode = BLOCKIO_SYNC;
+
+                    FlushPendingLocked();
+                    sync_msg = msg;
                     break;
                 }
-
-                msg->opcode = requests[i].opcode & BLOCKIO_OP_MASK;
-
-                const uint64_t max_xfer = info_.max_transfer_size / bsz;
-                if (max_xfer != 0 && max_xfer < requests[i].length) {
-                    uint64_t len_remaining = requests[i].length;
-                    uint64_t vmo_offset = requests[i].vmo_offset;
-                    uint64_t dev_offset = requests[i].dev_offset;
-
-                    size_t sub_txns = fbl::round_up(len_remaining, max_xfer) / max_xfer;
-                    msg->sub_txns = static_cast<uint32_t>(sub_txns);
-                    for (size_t i = 0; i < sub_txns; i++) {
-                        uint64_t length = fbl::min(len_remaining, max_xfer);
-                        len_remaining -= length;
-
-                        uint32_t flags = msg->flags;
-                        Queue(flags, iobuf->vmo(), length,
-                              vmo_offset, dev_offset, msg);
-                        vmo_offset += length;
-                        dev_offset += length;
-                    }
-                    ZX_DEBUG_ASSERT(len_remaining == 0);
-                } else {
-                    Queue(msg->flags, iobuf->vmo(), requests[i].length,
-                          requests[i].vmo_offset, requests[i].dev_offset, msg);
+                case BLOCKIO_CLOSE_VMO: {
+                    // TODO(smklein): Ensure that "iobuf" is not being used by
+                    // any in-flight txns.
+                    FlushPendingLocked();
+                    tree_.erase(*iobuf);
+                    txns_[txnid]->SetResponse(ZX_OK, wants_reply);
+                    break;
+                }
+                default: {
+                    fprintf(stderr, "Unrecognized Block Server operation: %x\n",
+                            requests[i].opcode);
+                }
                 }
-
-                break;
-            }
-            case BLOCKIO_SYNC: {
-                // TODO(smklein): It might be more useful to have this on a per-vmo basis
-                fprintf(stderr, "Warning: BLOCKIO_SYNC is currently unimplemented\n");
-                break;
-            }
-            case BLOCKIO_CLOSE_VMO: {
-                // TODO(smklein): Ensure that "iobuf" is not being used by
-                // any in-flight txns.
-                tree_.erase(*iobuf);
-                txns_[txnid]->SetResponse(ZX_OK, wants_reply);
-                break;
-            }
-            default: {
-                fprintf(stderr, "Unrecognized Block Server operation: %x\n",
-                        requests[i].opcode);
             }
+
+            if (sync_msg != nullptr) {
+                // The sync is a full barrier: everything received before it
+                // completes before the flush is issued, and nothing received
+                // after it is issued until the flush completes, regardless of
+                // how the device orders its own queue.
+                WaitIdle();
+                Queue(BLOCK_OP_FLUSH, ZX_HANDLE_INVALID, 0, 0, 0, sync_msg);
+                WaitIdle();
             }
         }
     }
 }
 
 BlockServer::BlockServer(zx_device_t* dev, block_protocol_t* bp) :
-    dev_(dev), bp_(*bp), block_op_size_(0), last_id_(VMOID_INVALID + 1) {
+    dev_(dev), bp_(*bp), block_op_size_(0), last_id_(VMOID_INVALID + 1), in_flight_(0) {
+    memset(&pending_, 0, sizeof(pending_));
+    completion_signal(&idle_);
     size_t actual;
     device_ioctl(dev_, IOCTL_BLOCK_GET_INFO, nullptr, 0, &info_, sizeof(info_), &actual);
 }
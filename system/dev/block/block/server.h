@@ -10,6 +10,7 @@
 
 #include <zircon/device/block.h>
 #include <ddk/protocol/block.h>
+#include <sync/completion.h>
 #include <zircon/thread_annotations.h>
 #include <zircon/types.h>
 
@@ -52,12 +53,15 @@ constexpr uint32_t kTxnFlagRespond = 0x00000001; // Should a reponse be sent whe
 
 class BlockTransaction;
 
-typedef struct {
+typedef struct block_msg {
     fbl::RefPtr<BlockTransaction> txn;
     fbl::RefPtr<IoBuffer> iobuf;
     uint32_t opcode;
     uint32_t flags;
     uint32_t sub_txns;
+    // The next message served by the same block_op_t, if this one was merged
+    // with requests adjacent to it.
+    struct block_msg* next;
 } block_msg_t;
 
 class BlockTransaction : public fbl::RefCounted<BlockTransaction> {
@@ -117,12 +121,41 @@ private:
     DISALLOW_COPY_ASSIGN_AND_MOVE(BlockServer);
     BlockServer(zx_device_t* dev, block_protocol_t* bp);
 
+    // A run of read or write requests which are adjacent both on the device
+    // and within a single VMO, and will be sent to the device as one
+    // block_op_t. The units of length, vmo_offset, and dev_offset are
+    // 'blocks'. The run is empty when |head| is null.
+    struct PendingOp {
+        uint32_t command;
+        const IoBuffer* iobuf;
+        uint64_t length;
+        uint64_t vmo_offset;
+        uint64_t dev_offset;
+        block_msg_t* head;
+        block_msg_t* tail;
+    };
+
+    static void BlockOpComplete(block_op_t* bop, zx_status_t status);
+
     zx_status_t Read(block_fifo_request_t* requests, uint32_t* count);
     zx_status_t FindVmoIDLocked(vmoid_t* out) TA_REQ(server_lock_);
 
+    // Appends |msg| to the pending run if it continues it; otherwise issues
+    // the pending run and starts a new one with |msg|.
+    void MergeLocked(const block_fifo_request_t& request, const IoBuffer* iobuf,
+                     block_msg_t* msg) TA_REQ(server_lock_);
+    // Issues the pending run of requests, if there is one.
+    void FlushPendingLocked() TA_REQ(server_lock_);
+
+    // Sends one operation to the device, completing every message chained
+    // from |msgs| when it finishes.
     // The units of length, vmo_offset, and dev_offset are 'blocks'.
-    void Queue(uint32_t flags, zx_handle_t vmo, uint64_t length,
-               uint64_t vmo_offset, uint64_t dev_offset, block_msg_t* msg);
+    void Queue(uint32_t command, zx_handle_t vmo, uint64_t length,
+               uint64_t vmo_offset, uint64_t dev_offset, block_msg_t* msgs);
+
+    // Blocks until every operation sent to the device has completed.
+    void WaitIdle();
+    void OpFinished();
 
     zx::fifo fifo_;
     zx_device_t* dev_;
@@ -134,6 +167,13 @@ private:
     fbl::WAVLTree<vmoid_t, fbl::RefPtr<IoBuffer>> tree_ TA_GUARDED(server_lock_);
     fbl::RefPtr<BlockTransaction> txns_[MAX_TXN_COUNT] TA_GUARDED(server_lock_);
     vmoid_t last_id_ TA_GUARDED(server_lock_);
+    PendingOp pending_ TA_GUARDED(server_lock_);
+
+    // Counts operations sent to the device which have not yet completed;
+    // |idle_| is signalled whenever this drops to zero.
+    fbl::Mutex in_flight_lock_;
+    uint32_t in_flight_ TA_GUARDED(in_flight_lock_);
+    completion_t idle_;
 };
 
 #else
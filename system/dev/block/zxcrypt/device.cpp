@@ -20,6 +20,7 @@
 #include <zircon/device/block.h>
 #include <zircon/errors.h>
 #include <zircon/status.h>
+#include <zircon/syscalls.h>
 #include <zircon/thread_annotations.h>
 #include <zircon/types.h>
 #include <zx/port.h>
@@ -42,6 +43,10 @@ namespace {
 const uint64_t kVmoSize = 1UL << 24;
 static_assert(kVmoSize % PAGE_SIZE == 0, "kVmoSize must be PAGE_SIZE aligned");
 
+// Requests are only split across workers into pieces of at least this many bytes.  Below this, the
+// cost of waking another worker outweighs the time saved by transforming the pieces in parallel.
+const uint32_t kMinWorkLen = 32 * 1024;
+
 // Kick off |Init| thread when binding.
 int InitThread(void* arg) {
     return static_cast<Device*>(arg)->Init();
@@ -52,8 +57,8 @@ int InitThread(void* arg) {
 // Public methods
 
 Device::Device(zx_device_t* parent)
-    : DeviceType(parent), info_(nullptr), active_(false), tasks_(0), mapped_(0), base_(nullptr),
-      last_(0), head_(nullptr), tail_(nullptr) {}
+    : DeviceType(parent), info_(nullptr), num_workers_(0), active_(false), tasks_(0), mapped_(0),
+      base_(nullptr), last_(0), head_(nullptr), tail_(nullptr) {}
 
 Device::~Device() {}
 
@@ -147,13 +152,20 @@ zx_status_t Device::Init() {
         xprintf("bitmap allocation failed: %s\n", zx_status_get_string(rc));
         return rc;
     }
-    // TODO(aarongreen): Investigate performance implications of adding more workers.
     if ((rc = zx::port::create(0, &port_)) != ZX_OK) {
         xprintf("zx::port::create failed: %s\n", zx_status_get_string(rc));
         return rc;
     }
-    for (size_t i = 0; i < kNumWorkers; ++i) {
-        if ((rc = workers_[i].Start(this, *volume, port_)) != ZX_OK) {
+    // Start a worker per CPU.
+    size_t num_workers = fbl::clamp(static_cast<size_t>(zx_system_get_num_cpus()),
+                                    static_cast<size_t>(1), static_cast<size_t>(kMaxWorkers));
+    workers_.reset(new (&ac) Worker[num_workers]);
+    if (!ac.check()) {
+        xprintf("allocation failed: %zu bytes\n", sizeof(Worker) * num_workers);
+        return ZX_ERR_NO_MEMORY;
+    }
+    for (; num_workers_ < num_workers; ++num_workers_) {
+        if ((rc = workers_[num_workers_].Start(this, *volume, port_)) != ZX_OK) {
             return rc;
         }
     }
@@ -269,7 +281,7 @@ void Device::DdkUnbind() {
     packet.key = 0;
     packet.type = ZX_PKT_TYPE_USER;
     packet.status = ZX_ERR_STOP;
-    for (size_t i = 0; i < kNumWorkers; ++i) {
+    for (size_t i = 0; i < num_workers_; ++i) {
         port_.queue(&packet, 1);
     }
     port_.reset();
@@ -284,8 +296,7 @@ void Device::DdkRelease() {
     if (rc != ZX_OK) {
         xprintf("WARNING: init thread returned %s\n", zx_status_get_string(rc));
     }
-    for (size_t i = 0; i < kNumWorkers; ++i) {
-
+    for (size_t i = 0; i < num_workers_; ++i) {
         workers_[i].Stop();
     }
     if (mapped_ != 0 && (rc = zx::vmar::root_self().unmap(mapped_, info_->mapped_len)) != ZX_OK) {
@@ -376,14 +387,7 @@ void Device::BlockComplete(block_op_t* block, zx_status_t rc) {
         return;
     }
 
-    zx_port_packet_t packet;
-    packet.key = 0;
-    packet.type = ZX_PKT_TYPE_USER;
-    packet.status = ZX_ERR_NEXT;
-    memcpy(packet.user.c8, &block, sizeof(block));
-    if ((rc = device->port_.queue(&packet, 1)) != ZX_OK) {
-        device->BlockRelease(block, rc);
-    }
+    device->QueueWork(block);
 }
 
 void Device::BlockRelease(block_op_t* block, zx_status_t rc) {
@@ -411,6 +415,27 @@ void Device::BlockRelease(block_op_t* block, zx_status_t rc) {
     }
 }
 
+void Device::FinishWork(block_op_t* block, zx_status_t rc) {
+    extra_op_t* extra = BlockToExtra(block);
+
+    // Keep the first error.
+    if (rc != ZX_OK) {
+        zx_status_t expected = ZX_OK;
+        __atomic_compare_exchange_n(&extra->status, &expected, rc, false, __ATOMIC_RELAXED,
+                                    __ATOMIC_RELAXED);
+    }
+    if (__atomic_sub_fetch(&extra->pending, 1, __ATOMIC_ACQ_REL) != 0) {
+        return;
+    }
+
+    rc = __atomic_load_n(&extra->status, __ATOMIC_RELAXED);
+    if (rc == ZX_OK && block->command == BLOCK_OP_WRITE) {
+        BlockForward(block);
+    } else {
+        BlockRelease(block, rc);
+    }
+}
+
 extra_op_t* Device::BlockToExtra(block_op_t* block) const {
     ZX_DEBUG_ASSERT(block);
     uint8_t* ptr = reinterpret_cast<uint8_t*>(block);
@@ -485,8 +510,6 @@ void Device::ReleaseBlocks(uint64_t off, uint64_t len) {
 }
 
 void Device::ProcessBlock(block_op_t* block, uint64_t off) {
-    zx_status_t rc;
-
     extra_op_t* extra = BlockToExtra(block);
     extra->buf = base_ + (off * info_->blk.block_size);
     extra->len = block->rw.length * info_->blk.block_size;
@@ -503,16 +526,45 @@ void Device::ProcessBlock(block_op_t* block, uint64_t off) {
     block->completion_cb = BlockComplete;
     block->cookie = this;
 
-    // Set remaining fields and pass along
+    // Reads are decrypted once the parent device completes them; writes are encrypted first.
+    if (block->command == BLOCK_OP_READ) {
+        BlockForward(block);
+    } else {
+        QueueWork(block);
+    }
+}
+
+void Device::QueueWork(block_op_t* block) {
+    zx_status_t rc;
+    extra_op_t* extra = BlockToExtra(block);
+
+    // Divide the request into up to one piece per worker, as long as the pieces aren't too small.
+    uint32_t block_size = info_->blk.block_size;
+    uint32_t blocks = extra->len / block_size;
+    uint32_t pieces = fbl::max(extra->len / kMinWorkLen, 1U);
+    pieces = fbl::min(pieces, static_cast<uint32_t>(num_workers_));
+    uint32_t piece_len = fbl::round_up(blocks, pieces) / pieces * block_size;
+    pieces = fbl::round_up(extra->len, piece_len) / piece_len;
+
+    extra->pending = pieces;
+    extra->status = ZX_OK;
+
     zx_port_packet_t packet;
     packet.key = 0;
     packet.type = ZX_PKT_TYPE_USER;
     packet.status = ZX_ERR_NEXT;
     memcpy(packet.user.c8, &block, sizeof(block));
-    if (block->command == BLOCK_OP_READ) {
-        BlockForward(block);
-    } else if ((rc = port_.queue(&packet, 1)) != ZX_OK) {
-        BlockRelease(block, rc);
+    for (uint32_t i = 0; i < pieces; ++i) {
+        uint64_t off = static_cast<uint64_t>(i) * piece_len;
+        packet.user.u64[1] = off;
+        packet.user.u64[2] = fbl::min(static_cast<uint64_t>(piece_len), extra->len - off);
+        if ((rc = port_.queue(&packet, 1)) != ZX_OK) {
+            // Account for the pieces that will never be done.
+            for (; i < pieces; ++i) {
+                FinishWork(block, rc);
+            }
+            return;
+        }
     }
 }
 
@@ -17,6 +17,7 @@
 #include <ddktl/protocol/block.h>
 #include <fbl/macros.h>
 #include <fbl/mutex.h>
+#include <fbl/unique_ptr.h>
 #include <zircon/compiler.h>
 #include <zircon/device/block.h>
 #include <zircon/types.h>
@@ -75,6 +76,11 @@ public:
     // to the caller of |DdkIotxnQueue|.
     void BlockRelease(block_op_t* block, zx_status_t rc) __TA_EXCLUDES(mtx_);
 
+    // Called by a worker when it finishes a piece of the cryptographic work queued by |QueueWork|.
+    // The last piece to finish forwards |block| to the parent device if it is a write, or completes
+    // it if it is a read or if any piece failed.
+    void FinishWork(block_op_t* block, zx_status_t rc) __TA_EXCLUDES(mtx_);
+
     // Translates |block_op_t|s to |extra_op_t|s and vice versa.
     extra_op_t* BlockToExtra(block_op_t* block) const;
     block_op_t* ExtraToBlock(extra_op_t* extra) const;
@@ -82,9 +88,8 @@ public:
 private:
     DISALLOW_COPY_ASSIGN_AND_MOVE(Device);
 
-    // TODO(aarongreen): Investigate performance impact of changing this.
-    // Number of encrypting/decrypting workers
-    static const size_t kNumWorkers = 2;
+    // Upper bound on the number of encrypting/decrypting workers.  The device starts one per CPU.
+    static const size_t kMaxWorkers = 32;
 
     // Increments the amount of work this device has outstanding.  This should be called at the
     // start of any method that shouldn't be invoked after the device has been unbound.  It notably
@@ -110,6 +115,11 @@ private:
     // and send it to a worker.
     void ProcessBlock(block_op_t* block, uint64_t offset) __TA_EXCLUDES(mtx_);
 
+    // Splits the cryptographic work for |block| into block-aligned pieces and sends them to the
+    // workers.  Large requests are spread across all the workers so that a single request can use
+    // more than one CPU.
+    void QueueWork(block_op_t* block) __TA_EXCLUDES(mtx_);
+
     // Defer this |block| request until later, due to insufficient memory for cryptographic
     // transformations.
     void EnqueueBlock(block_op_t* block) __TA_EXCLUDES(mtx_);
@@ -153,8 +163,10 @@ private:
 
     // The |Init| thread, used to configure and add the device.
     thrd_t init_;
-    // Threads that performs encryption/decryption.
-    Worker workers_[kNumWorkers];
+    // Threads that performs encryption/decryption.  Allocated and started in |Init|; like |info_|,
+    // these are not modified afterwards until |DdkRelease|.
+    fbl::unique_ptr<Worker[]> workers_;
+    size_t num_workers_;
     // Port used to send write/read operations to be encrypted/decrypted.
     zx::port port_;
     // Primary lock for accessing the fields below
@@ -25,6 +25,9 @@ struct extra_op_t {
     uint64_t off;    // VMO offset in BYTES
     zx_handle_t vmo; // VMO of the requester
 
+    uint32_t pending;   // Pieces of cryptographic work still outstanding; see |Device::QueueWork|
+    zx_status_t status; // First error reported by a piece of work
+
     void (*completion_cb)(block_op_t* block, zx_status_t status);
     void* cookie;
 };
@@ -64,31 +64,31 @@ zx_status_t Worker::Loop() {
     ZX_DEBUG_ASSERT(device_);
     zx_port_packet_t packet;
     while (port_.wait(zx::time::infinite(), &packet, 1) == ZX_OK && packet.status == ZX_ERR_NEXT) {
+        // See |Device::QueueWork|: each packet is a piece of a request, given by a byte offset and
+        // length relative to the start of the request.
         block_op_t* block = reinterpret_cast<block_op_t*>(packet.user.u64[0]);
+        uint64_t off = packet.user.u64[1];
+        size_t len = static_cast<size_t>(packet.user.u64[2]);
         extra_op_t* ex = device_->BlockToExtra(block);
+        uint8_t* buf = ex->buf + off;
         size_t actual;
         switch (block->command) {
         case BLOCK_OP_WRITE:
-            if ((rc = zx_vmo_read(ex->vmo, ex->buf, ex->off, ex->len, &actual)) != ZX_OK ||
-                (rc = encrypt_.Encrypt(ex->buf, ex->num, ex->len, ex->buf) != ZX_OK)) {
-                device_->BlockRelease(block, rc);
-                break;
+            if ((rc = zx_vmo_read(ex->vmo, buf, ex->off + off, len, &actual)) == ZX_OK) {
+                rc = encrypt_.Encrypt(buf, ex->num + off, len, buf);
             }
-            device_->BlockForward(block);
             break;
 
         case BLOCK_OP_READ:
-            if ((rc = decrypt_.Decrypt(ex->buf, ex->num, ex->len, ex->buf)) != ZX_OK ||
-                (rc = zx_vmo_write(ex->vmo, ex->buf, ex->off, ex->len, &actual)) != ZX_OK) {
-                device_->BlockRelease(block, rc);
-                break;
+            if ((rc = decrypt_.Decrypt(buf, ex->num + off, len, buf)) == ZX_OK) {
+                rc = zx_vmo_write(ex->vmo, buf, ex->off + off, len, &actual);
             }
-            device_->BlockRelease(block, ZX_OK);
             break;
 
         default:
-            device_->BlockRelease(block, ZX_ERR_NOT_SUPPORTED);
+            rc = ZX_ERR_NOT_SUPPORTED;
         }
+        device_->FinishWork(block, rc);
     }
     return ZX_OK;
 }
@@ -33,9 +33,9 @@ public:
     // |volume|.
     zx_status_t Start(Device* device, const Volume& volume, const zx::port& port);
 
-    // Thread body. Encrypts write requests and and forwards them to the parent device using
-    // Device::BlockForward.  Decrypts read responses and completes them back to the requester using
-    // Device::BlockRelease.  This method should not be called directly; use |Start| instead.
+    // Thread body. Encrypts pieces of write requests and decrypts pieces of read responses, and
+    // reports each piece to Device::FinishWork, which forwards or completes the request once all
+    // of its pieces are done.  This method should not be called directly; use |Start| instead.
     zx_status_t Loop();
 
     // Asks the worker to stop.  This call blocks until the worker has finished processing the
@@ -9,6 +9,7 @@
 #include <fbl/auto_lock.h>
 #include <inttypes.h>
 #include <pretty/hexdump.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -20,10 +21,6 @@
 
 #define LOCAL_TRACE 0
 
-// 1MB max transfer (unless further restricted by ring size
-#define MAX_SCATTER 257
-#define MAX_MAX_XFER ((MAX_SCATTER - 1) * PAGE_SIZE)
-
 #define PAGE_MASK (PAGE_SIZE - 1)
 
 namespace virtio {
@@ -48,7 +45,12 @@ void BlockDevice::GetInfo(block_info_t* info) {
     memset(info, 0, sizeof(*info));
     info->block_size = GetBlockSize();
     info->block_count = GetSize() / GetBlockSize();
-    info->max_transfer_size = (uint32_t)(PAGE_SIZE * (ring_size - 2));
+    // with indirect descriptors a transfer takes a single ring slot
+    if (indirect_ != nullptr) {
+        info->max_transfer_size = MAX_MAX_XFER;
+    } else {
+        info->max_transfer_size = (uint32_t)(PAGE_SIZE * (ring_size - 2));
+    }
 
     // limit max transfer to our worst case scatter list size
     if (info->max_transfer_size > MAX_MAX_XFER) {
@@ -125,8 +127,9 @@ zx_status_t BlockDevice::Init() {
     // reset the device
     DeviceReset();
 
-    // read our configuration
-    CopyDeviceConfig(&config_, sizeof(config_));
+    // read our configuration; the fields after blk_size are only present
+    // with their features, and are read once those are negotiated below.
+    CopyDeviceConfig(&config_, offsetof(virtio_blk_config_t, topology));
     // TODO(cja): The blk_size provided in the device configuration is only
     // populated if a specific feature bit has been negotiated during
     // initialization, otherwise it is 0, at least in Virtio 0.9.5. Use 512
@@ -143,13 +146,29 @@ zx_status_t BlockDevice::Init() {
     // ack and set the driver status bit
     DriverStatusAck();
 
-    // XXX check features bits and ack/nak them
-
-    // allocate the main vring
-    auto err = vring_.Init(0, ring_size);
-    if (err < 0) {
-        zxlogf(ERROR, "failed to allocate vring\n");
-        return err;
+    // negotiate features
+    NegotiateRingFeatures();
+    if (DeviceFeatureSupported(__builtin_ctz(VIRTIO_BLK_F_MQ))) {
+        DriverFeatureAck(__builtin_ctz(VIRTIO_BLK_F_MQ));
+        uint16_t num_queues;
+        backend_->DeviceConfigRead(offsetof(virtio_blk_config_t, num_queues), &num_queues);
+        num_queues_ = (num_queues == 0) ? 1 : fbl::min(num_queues, static_cast<uint16_t>(max_queues));
+    }
+    zx_status_t status = DeviceStatusFeaturesOk();
+    if (status != ZX_OK) {
+        zxlogf(ERROR, "%s: feature negotiation failed: %d\n", tag(), status);
+        return status;
+    }
+    LTRACEF("queues %u event_idx %d indirect_desc %d\n",
+            num_queues_, RingEventIdx(), RingIndirectDesc());
+
+    // allocate the request vrings
+    for (uint16_t q = 0; q < num_queues_; q++) {
+        auto err = vrings_[q].Init(q, ring_size);
+        if (err < 0) {
+            zxlogf(ERROR, "failed to allocate vring %u\n", q);
+            return err;
+        }
     }
 
     // allocate a queue of block requests
@@ -169,6 +188,16 @@ zx_status_t BlockDevice::Init() {
 
     LTRACEF("allocated blk responses at %p, physical address %#" PRIxPTR "\n", blk_res_, blk_res_pa_);
 
+    // allocate a descriptor table per request
+    if (RingIndirectDesc()) {
+        size = sizeof(struct vring_desc) * indirect_count * blk_req_count;
+        r = map_contiguous_memory(size, (uintptr_t*)&indirect_, &indirect_pa_);
+        if (r < 0) {
+            zxlogf(ERROR, "cannot alloc indirect descriptor tables %d\n", r);
+            return r;
+        }
+    }
+
     // start the interrupt thread
     StartIrqThread();
 
@@ -191,7 +220,7 @@ zx_status_t BlockDevice::Init() {
     args.proto_id = ZX_PROTOCOL_BLOCK_CORE;
     args.proto_ops = &block_ops_;
 
-    auto status = device_add(bus_device_, &args, &device_);
+    status = device_add(bus_device_, &args, &device_);
     if (status < 0) {
         device_ = nullptr;
         return status;
@@ -203,28 +232,13 @@ zx_status_t BlockDevice::Init() {
 void BlockDevice::IrqRingUpdate() {
     LTRACE_ENTRY;
 
+    Ring* vring = nullptr;
+
     // parse our descriptor chain, add back to the free queue
-    auto free_chain = [this](vring_used_elem* used_elem) {
+    auto free_chain = [this, &vring](vring_used_elem* used_elem) {
         uint32_t i = (uint16_t)used_elem->id;
-        struct vring_desc* desc = vring_.DescFromIndex((uint16_t)i);
+        struct vring_desc* desc = vring->DescFromIndex((uint16_t)i);
         auto head_desc = desc; // save the first element
-        for (;;) {
-            int next;
-            LTRACE_DO(virtio_dump_desc(desc));
-            if (desc->flags & VRING_DESC_F_NEXT) {
-                next = desc->next;
-            } else {
-                /* end of chain */
-                next = -1;
-            }
-
-            vring_.FreeDesc((uint16_t)i);
-
-            if (next < 0)
-                break;
-            i = next;
-            desc = vring_.DescFromIndex((uint16_t)i);
-        }
 
         bool need_signal = false;
         bool need_complete = false;
@@ -232,6 +246,25 @@ void BlockDevice::IrqRingUpdate() {
         {
             fbl::AutoLock lock(&txn_lock_);
 
+            // descriptors are allocated under txn_lock_ as well
+            for (;;) {
+                int next;
+                LTRACE_DO(virtio_dump_desc(desc));
+                if (desc->flags & VRING_DESC_F_NEXT) {
+                    next = desc->next;
+                } else {
+                    /* end of chain */
+                    next = -1;
+                }
+
+                vring->FreeDesc((uint16_t)i);
+
+                if (next < 0)
+                    break;
+                i = next;
+                desc = vring->DescFromIndex((uint16_t)i);
+            }
+
             // search our pending txn list to see if this completes it
 
             list_for_every_entry (&txn_list_, txn, block_txn_t, node) {
@@ -261,8 +294,11 @@ void BlockDevice::IrqRingUpdate() {
         }
     };
 
-    // tell the ring to find free chains and hand it back to our lambda
-    vring_.IrqRingUpdate(free_chain);
+    // tell the rings to find free chains and hand them back to our lambda
+    for (uint16_t q = 0; q < num_queues_; q++) {
+        vring = &vrings_[q];
+        vring->IrqRingUpdate(free_chain);
+    }
 }
 
 void BlockDevice::IrqConfigChange() {
@@ -270,7 +306,7 @@ void BlockDevice::IrqConfigChange() {
 }
 
 zx_status_t BlockDevice::QueueTxn(block_txn_t* txn, bool write, size_t bytes,
-                           uint64_t* pages, size_t pagecount, uint16_t* idx) {
+                           uint64_t* pages, size_t pagecount, Ring** ring, uint16_t* idx) {
 
     size_t index;
     {
@@ -302,14 +338,30 @@ zx_status_t BlockDevice::QueueTxn(block_txn_t* txn, bool write, size_t bytes,
     LTRACEF("page count %lu\n", pagecount);
     assert(pagecount > 0);
 
-    /* put together a transfer */
+    /* put together a transfer, using the request's own descriptor table if we can */
+    size_t count = 2u + pagecount;
+    struct vring_desc* table = (indirect_ != nullptr) ? &indirect_[index * indirect_count] : nullptr;
+    uint16_t ring_count = (table != nullptr) ? 1 : (uint16_t)count;
+
+    /* try each queue in turn, starting after the one we used last */
+    Ring* vring = nullptr;
     uint16_t i;
-    auto desc = vring_.AllocDescChain((uint16_t)(2u + pagecount), &i);
-    if (!desc) {
-        LTRACEF("failed to allocate descriptor chain of length %zu\n", 2u + pagecount);
+    struct vring_desc* desc = nullptr;
+    {
         fbl::AutoLock lock(&txn_lock_);
-        free_blk_req(index);
-        return ZX_ERR_NO_RESOURCES;
+        for (uint16_t n = 0; n < num_queues_ && desc == nullptr; n++) {
+            uint16_t q = (uint16_t)((next_queue_ + n) % num_queues_);
+            vring = &vrings_[q];
+            desc = vring->AllocDescChain(ring_count, &i);
+            if (desc != nullptr) {
+                next_queue_ = (uint16_t)((q + 1) % num_queues_);
+            }
+        }
+        if (!desc) {
+            LTRACEF("failed to allocate descriptor chain of length %u\n", ring_count);
+            free_blk_req(index);
+            return ZX_ERR_NO_RESOURCES;
+        }
     }
 
     LTRACEF("after alloc chain desc %p, i %u\n", desc, i);
@@ -317,6 +369,22 @@ zx_status_t BlockDevice::QueueTxn(block_txn_t* txn, bool write, size_t bytes,
     /* point the txn at this head descriptor */
     txn->desc = desc;
 
+    if (table != nullptr) {
+        desc->addr = indirect_pa_ + index * indirect_count * sizeof(struct vring_desc);
+        desc->len = (uint32_t)(count * sizeof(struct vring_desc));
+        desc->flags = VRING_DESC_F_INDIRECT;
+        LTRACE_DO(virtio_dump_desc(desc));
+
+        /* the rest of the transfer goes in the table, chained in order */
+        for (size_t n = 0; n < count; n++) {
+            table[n].next = (uint16_t)(n + 1);
+        }
+        desc = &table[0];
+    }
+    auto next_desc = [vring, table](const struct vring_desc* d) {
+        return (table != nullptr) ? &table[d->next] : vring->DescFromIndex(d->next);
+    };
+
     /* set up the descriptor pointing to the head */
     desc->addr = blk_req_pa_ + index * sizeof(virtio_blk_req_t);
     desc->len = sizeof(virtio_blk_req_t);
@@ -324,7 +392,7 @@ zx_status_t BlockDevice::QueueTxn(block_txn_t* txn, bool write, size_t bytes,
     LTRACE_DO(virtio_dump_desc(desc));
 
     for (size_t n = 0; n < pagecount; n++) {
-        desc = vring_.DescFromIndex(desc->next);
+        desc = next_desc(desc);
         desc->addr = pages[n];
         desc->len = (uint32_t) ((bytes > PAGE_SIZE) ? PAGE_SIZE : bytes);
         if (n == 0) {
@@ -352,12 +420,13 @@ zx_status_t BlockDevice::QueueTxn(block_txn_t* txn, bool write, size_t bytes,
     assert(bytes == 0);
 
     /* set up the descriptor pointing to the response */
-    desc = vring_.DescFromIndex(desc->next);
+    desc = next_desc(desc);
     desc->addr = blk_res_pa_ + index;
     desc->len = 1;
     desc->flags = VRING_DESC_F_WRITE;
     LTRACE_DO(virtio_dump_desc(desc));
 
+    *ring = vring;
     *idx = i;
     return ZX_OK;
 }
@@ -403,10 +472,11 @@ void BlockDevice::QueueReadWriteTxn(block_txn_t* txn, bool write) {
     bool cannot_fail = false;
 
     for (;;) {
+        Ring* vring;
         uint16_t idx;
 
         // attempt to setup hw txn
-        zx_status_t status = QueueTxn(txn, write, bytes, pages, pagecount, &idx);
+        zx_status_t status = QueueTxn(txn, write, bytes, pages, pagecount, &vring, &idx);
         if (status == ZX_OK) {
             fbl::AutoLock lock(&txn_lock_);
 
@@ -414,10 +484,10 @@ void BlockDevice::QueueReadWriteTxn(block_txn_t* txn, bool write) {
             list_add_tail(&txn_list_, &txn->node);
 
             /* submit the transfer */
-            vring_.SubmitChain(idx);
+            vring->SubmitChain(idx);
 
             /* kick it off */
-            vring_.Kick();
+            vring->Kick();
 
             return;
         } else {
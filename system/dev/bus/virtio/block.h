@@ -16,6 +16,10 @@
 
 #include <sync/completion.h>
 
+// 1MB max transfer (unless further restricted by ring size
+#define MAX_SCATTER 257
+#define MAX_MAX_XFER ((MAX_SCATTER - 1) * PAGE_SIZE)
+
 namespace virtio {
 
 struct block_txn_t {
@@ -54,11 +58,15 @@ private:
     void GetInfo(block_info_t* info);
 
     zx_status_t QueueTxn(block_txn_t* txn, bool write, size_t bytes,
-                         uint64_t* pages, size_t pagecount, uint16_t* idx);
+                         uint64_t* pages, size_t pagecount, Ring** ring, uint16_t* idx);
     void QueueReadWriteTxn(block_txn_t* txn, bool write);
 
-    // the main virtio ring
-    Ring vring_ = {this};
+    // the request virtqueues; more than one is only used with VIRTIO_BLK_F_MQ
+    static const uint16_t max_queues = 4;
+    Ring vrings_[max_queues] = {{this}, {this}, {this}, {this}};
+    uint16_t num_queues_ = 1;
+    // the queue to try first for the next request
+    uint16_t next_queue_ = 0;
 
     static const uint16_t ring_size = 128; // 128 matches legacy pci
 
@@ -66,7 +74,7 @@ private:
     virtio_blk_config_t config_ = {};
 
     // a queue of block request/responses
-    static const size_t blk_req_count = 32;
+    static const size_t blk_req_count = 64;
 
     zx_paddr_t blk_req_pa_ = 0;
     virtio_blk_req_t* blk_req_ = nullptr;
@@ -74,19 +82,28 @@ private:
     zx_paddr_t blk_res_pa_ = 0;
     uint8_t* blk_res_ = nullptr;
 
-    uint32_t blk_req_bitmap_ = 0;
+    // with VIRTIO_RING_F_INDIRECT_DESC, each request gets a descriptor table
+    // for its header, data pages and status, so it takes a single ring slot
+    static const size_t indirect_count = 2 + MAX_SCATTER;
+    zx_paddr_t indirect_pa_ = 0;
+    struct vring_desc* indirect_ = nullptr;
+
+    uint64_t blk_req_bitmap_ = 0;
     static_assert(blk_req_count <= sizeof(blk_req_bitmap_) * CHAR_BIT, "");
 
+    // returns blk_req_count if all requests are in use
     size_t alloc_blk_req() {
-        size_t i = 0;
-        if (blk_req_bitmap_ != 0)
-            i = sizeof(blk_req_bitmap_) * CHAR_BIT - __builtin_clz(blk_req_bitmap_);
-        blk_req_bitmap_ |= (1 << i);
+        if (~blk_req_bitmap_ == 0)
+            return blk_req_count;
+        size_t i = __builtin_ctzll(~blk_req_bitmap_);
+        if (i >= blk_req_count)
+            return blk_req_count;
+        blk_req_bitmap_ |= (1ull << i);
         return i;
     }
 
     void free_blk_req(size_t i) {
-        blk_req_bitmap_ &= ~(1 << i);
+        blk_req_bitmap_ &= ~(1ull << i);
     }
 
     // pending iotxns and waiter state
@@ -85,6 +85,18 @@ void Device::StartIrqThread() {
     thrd_detach(irq_thread_);
 }
 
+void Device::NegotiateRingFeatures() {
+    if (DeviceFeatureSupported(VIRTIO_F_RING_EVENT_IDX)) {
+        DriverFeatureAck(VIRTIO_F_RING_EVENT_IDX);
+        ring_event_idx_ = true;
+    }
+    if (DeviceFeatureSupported(VIRTIO_F_RING_INDIRECT_DESC)) {
+        DriverFeatureAck(VIRTIO_F_RING_INDIRECT_DESC);
+        ring_indirect_desc_ = true;
+    }
+    LTRACEF("event_idx %d indirect_desc %d\n", ring_event_idx_, ring_indirect_desc_);
+}
+
 zx_status_t Device::CopyDeviceConfig(void* _buf, size_t len) const {
     assert(_buf);
 
@@ -51,6 +51,10 @@ public:
     // in how Legacy vs Modern systems are laid out.
     void RingKick(uint16_t ring_index) { backend_->RingKick(ring_index); }
 
+    // Ring features negotiated with the device; see NegotiateRingFeatures().
+    bool RingEventIdx() const { return ring_event_idx_; }
+    bool RingIndirectDesc() const { return ring_indirect_desc_; }
+
     // It is expected that each derived device will implement tag().
     zx_device_t* device() { return device_; }
     virtual const char* tag() const = 0; // Implemented by derived devices
@@ -59,7 +63,11 @@ protected:
     // Methods for checking / acknowledging features
     bool DeviceFeatureSupported(uint32_t feature) { return backend_->ReadFeature(feature); }
     void DriverFeatureAck(uint32_t feature) { backend_->SetFeature(feature); }
-    bool DeviceStatusFeaturesOk() { return backend_->ConfirmFeatures(); }
+    zx_status_t DeviceStatusFeaturesOk() { return backend_->ConfirmFeatures(); }
+    // Acks the ring layout features that Ring implements if the device
+    // offers them. Devices that call this must be ready to handle indirect
+    // descriptors being available.
+    void NegotiateRingFeatures();
 
     // Devie lifecycle methods
     void DeviceReset() { backend_->DeviceReset(); }
@@ -87,6 +95,10 @@ protected:
     zx_device_t* bus_device_ = nullptr;
     zx_device_t* device_ = nullptr;
 
+    // negotiated ring features
+    bool ring_event_idx_ = false;
+    bool ring_indirect_desc_ = false;
+
     // DDK device
     // TODO: It might make sense for the base device class to be the one
     // to handle device_add() calls rather than delegating it to the derived
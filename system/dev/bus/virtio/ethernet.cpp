@@ -23,6 +23,7 @@
 #include <virtio/virtio.h>
 #include <zircon/assert.h>
 #include <zircon/status.h>
+#include <zircon/syscalls.h>
 #include <zircon/types.h>
 
 #include "ring.h"
@@ -48,10 +49,67 @@ const size_t kL1EthHdrLen = 26;
 // The goal here is to allocate single-page I/O buffers.
 const size_t kFrameSize = sizeof(virtio_net_hdr_t) + kL1EthHdrLen + kVirtioMtu;
 const size_t kFramesInBuf = PAGE_SIZE / kFrameSize;
-const size_t kNumIoBufs = fbl::round_up(kBacklog * 2, kFramesInBuf) / kFramesInBuf;
 
-const uint16_t kRxId = 0u;
-const uint16_t kTxId = 1u;
+// Each queue gets kBacklog frames in the I/O buffers.  The receive and
+// transmit queues of pair |q| are virtqueues 2q and 2q+1, and their frames are
+// laid out the same way.  Control commands use the frames after the last pair.
+uint16_t RxId(uint16_t pair) {
+    return static_cast<uint16_t>(pair * 2);
+}
+uint16_t TxId(uint16_t pair) {
+    return static_cast<uint16_t>(pair * 2 + 1);
+}
+uint16_t CtrlId(uint16_t pairs) {
+    return static_cast<uint16_t>(pairs * 2);
+}
+
+size_t NumIoBufs(size_t queues) {
+    return fbl::round_up(kBacklog * queues, kFramesInBuf) / kFramesInBuf;
+}
+
+// Picks the transmit queue pair for an Ethernet frame by hashing its flow:
+// the addresses, the protocol and, for unfragmented TCP and UDP, the ports.
+// Every frame of a flow goes out on the same queue, so stays in order.
+uint16_t TxPairFor(const uint8_t* frame, size_t length, uint16_t pairs) {
+    const size_t kEthHdrLen = 14;
+    if (pairs == 1 || length < kEthHdrLen) {
+        return 0;
+    }
+    uint32_t hash = 2166136261u; // FNV-1a
+    auto mix = [&hash](const uint8_t* p, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            hash = (hash ^ p[i]) * 16777619u;
+        }
+    };
+    mix(frame, kEthHdrLen);
+
+    const uint8_t* ip = frame + kEthHdrLen;
+    size_t ip_len = length - kEthHdrLen;
+    uint16_t ethertype = static_cast<uint16_t>(frame[12] << 8 | frame[13]);
+    if (ethertype == 0x0800 && ip_len >= 20) {
+        size_t ihl = (ip[0] & 0xf) * 4;
+        uint8_t proto = ip[9];
+        bool fragment = (ip[6] & 0x3f) != 0 || ip[7] != 0; // MF or offset
+        mix(ip + 9, 1);
+        mix(ip + 12, 8);
+        if ((proto == 6 || proto == 17) && !fragment && ihl >= 20 && ip_len >= ihl + 4) {
+            mix(ip + ihl, 4);
+        }
+    } else if (ethertype == 0x86dd && ip_len >= 40) {
+        uint8_t next = ip[6];
+        mix(ip + 6, 1);
+        mix(ip + 8, 32);
+        if ((next == 6 || next == 17) && ip_len >= 44) {
+            mix(ip + 40, 4);
+        }
+    }
+    return static_cast<uint16_t>(hash % pairs);
+}
+
+// The control virtqueue only ever has a single command in flight.
+const uint16_t kCtrlDescs = 4;
+// How long to wait for the device to answer a control command.
+const zx_duration_t kCtrlTimeout = ZX_MSEC(100);
 
 // Strictly for convenience...
 typedef struct vring_desc desc_t;
@@ -118,17 +176,17 @@ ethmac_protocol_ops_t kProtoOps = {
 };
 
 // I/O buffer helpers
-zx_status_t InitBuffers(fbl::unique_ptr<io_buffer_t[]>* out) {
+zx_status_t InitBuffers(fbl::unique_ptr<io_buffer_t[]>* out, size_t num_bufs) {
     zx_status_t rc;
     fbl::AllocChecker ac;
-    fbl::unique_ptr<io_buffer_t[]> bufs(new (&ac) io_buffer_t[kNumIoBufs]);
+    fbl::unique_ptr<io_buffer_t[]> bufs(new (&ac) io_buffer_t[num_bufs]);
     if (!ac.check()) {
         zxlogf(ERROR, "out of memory!\n");
         return ZX_ERR_NO_MEMORY;
     }
-    memset(bufs.get(), 0, sizeof(io_buffer_t) * kNumIoBufs);
+    memset(bufs.get(), 0, sizeof(io_buffer_t) * num_bufs);
     size_t buf_size = kFrameSize * kFramesInBuf;
-    for (uint16_t id = 0; id < kNumIoBufs; ++id) {
+    for (size_t id = 0; id < num_bufs; ++id) {
         if ((rc = io_buffer_init(&bufs[id], buf_size, IO_BUFFER_RW | IO_BUFFER_CONTIG)) != ZX_OK) {
             zxlogf(ERROR, "failed to allocate I/O buffers: %s\n", zx_status_get_string(rc));
             return rc;
@@ -138,11 +196,11 @@ zx_status_t InitBuffers(fbl::unique_ptr<io_buffer_t[]>* out) {
     return ZX_OK;
 }
 
-void ReleaseBuffers(fbl::unique_ptr<io_buffer_t[]> bufs) {
+void ReleaseBuffers(fbl::unique_ptr<io_buffer_t[]> bufs, size_t num_bufs) {
     if (!bufs) {
         return;
     }
-    for (size_t i = 0; i < kNumIoBufs; ++i) {
+    for (size_t i = 0; i < num_bufs; ++i) {
         if (io_buffer_is_valid(&bufs[i])) {
             io_buffer_release(&bufs[i]);
         }
@@ -179,8 +237,10 @@ uint8_t* GetFrameData(io_buffer_t* bufs, uint16_t ring_id, uint16_t desc_id) {
 } // namespace
 
 EthernetDevice::EthernetDevice(zx_device_t* bus_device, fbl::unique_ptr<Backend> backend)
-    : Device(bus_device, fbl::move(backend)), rx_(this), tx_(this), bufs_(nullptr), unkicked_(0),
+    : Device(bus_device, fbl::move(backend)), pairs_(1), rx_{{this}, {this}, {this}, {this}},
+      tx_{{this}, {this}, {this}, {this}}, ctrl_(this), bufs_(nullptr), num_bufs_(0),
       ifc_(nullptr), cookie_(nullptr) {
+    static_assert(kMaxPairs == 4, "update the queue initializers");
 }
 
 EthernetDevice::~EthernetDevice() {
@@ -190,10 +250,14 @@ EthernetDevice::~EthernetDevice() {
 zx_status_t EthernetDevice::Init() {
     LTRACE_ENTRY;
     zx_status_t rc;
-    if (mtx_init(&state_lock_, mtx_plain) != thrd_success ||
-        mtx_init(&tx_lock_, mtx_plain) != thrd_success) {
+    if (mtx_init(&state_lock_, mtx_plain) != thrd_success) {
         return ZX_ERR_NO_RESOURCES;
     }
+    for (uint16_t q = 0; q < kMaxPairs; ++q) {
+        if (mtx_init(&tx_[q].lock, mtx_plain) != thrd_success) {
+            return ZX_ERR_NO_RESOURCES;
+        }
+    }
     fbl::AutoLock lock(&state_lock_);
 
     // Reset the device and read our configuration
@@ -207,16 +271,33 @@ zx_status_t EthernetDevice::Init() {
     // Ack and set the driver status bit
     DriverStatusAck();
 
-    // TODO(aarongreen): Check features bits and ack/nak them
-
     // Plan to clean up unless everything goes right.
     auto cleanup = fbl::MakeAutoCall([this]() { Release(); });
 
+    NegotiateFeatures();
+    if ((rc = DeviceStatusFeaturesOk()) != ZX_OK) {
+        zxlogf(ERROR, "feature negotiation failed: %s\n", zx_status_get_string(rc));
+        return rc;
+    }
+    bool use_ctrl = pairs_ > 1;
+
     // Allocate I/O buffers and virtqueues.
     uint16_t num_descs = static_cast<uint16_t>(kBacklog & 0xffff);
-    if ((rc = InitBuffers(&bufs_)) != ZX_OK || (rc = rx_.Init(kRxId, num_descs)) != ZX_OK ||
-        (rc = tx_.Init(kTxId, num_descs)) != ZX_OK) {
-        zxlogf(ERROR, "failed to allocate virtqueue: %s\n", zx_status_get_string(rc));
+    num_bufs_ = NumIoBufs(pairs_ * 2 + (use_ctrl ? 1 : 0));
+    if ((rc = InitBuffers(&bufs_, num_bufs_)) != ZX_OK) {
+        return rc;
+    }
+    for (uint16_t q = 0; q < pairs_; ++q) {
+        if ((rc = rx_[q].Init(RxId(q), num_descs)) != ZX_OK ||
+            (rc = tx_[q].ring.Init(TxId(q), num_descs)) != ZX_OK) {
+            zxlogf(ERROR, "failed to allocate virtqueue: %s\n", zx_status_get_string(rc));
+            return rc;
+        }
+    }
+    // The control virtqueue comes after every queue pair the device has, not
+    // just the ones we use.
+    if (use_ctrl && (rc = ctrl_.Init(CtrlId(config_.max_virtqueue_pairs), kCtrlDescs)) != ZX_OK) {
+        zxlogf(ERROR, "failed to allocate control virtqueue: %s\n", zx_status_get_string(rc));
         return rc;
     }
 
@@ -224,28 +305,42 @@ zx_status_t EthernetDevice::Init() {
     desc_t* desc = nullptr;
     uint16_t id;
 
-    // For rx buffers, we queue a bunch of "reads" from the network that
-    // complete when packets arrive.
-    for (uint16_t i = 0; i < num_descs; ++i) {
-        desc = rx_.AllocDescChain(1, &id);
-        desc->addr = GetFramePhys(bufs_.get(), kRxId, id);
-        desc->len = kFrameSize;
-        desc->flags |= VRING_DESC_F_WRITE;
-        LTRACE_DO(virtio_dump_desc(desc));
-        rx_.SubmitChain(id);
-    }
+    for (uint16_t q = 0; q < pairs_; ++q) {
+        // For rx buffers, we queue a bunch of "reads" from the network that
+        // complete when packets arrive.
+        for (uint16_t i = 0; i < num_descs; ++i) {
+            desc = rx_[q].AllocDescChain(1, &id);
+            desc->addr = GetFramePhys(bufs_.get(), RxId(q), id);
+            desc->len = kFrameSize;
+            desc->flags |= VRING_DESC_F_WRITE;
+            LTRACE_DO(virtio_dump_desc(desc));
+            rx_[q].SubmitChain(id);
+        }
 
-    // For tx buffers, we hold onto them until we need to send a packet.
-    for (uint16_t id = 0; id < num_descs; ++id) {
-        desc = tx_.DescFromIndex(id);
-        desc->addr = GetFramePhys(bufs_.get(), kTxId, id);
-        desc->len = 0;
-        desc->flags &= static_cast<uint16_t>(~VRING_DESC_F_WRITE);
-        LTRACE_DO(virtio_dump_desc(desc));
+        // For tx buffers, we hold onto them until we need to send a packet.
+        for (uint16_t id = 0; id < num_descs; ++id) {
+            desc = tx_[q].ring.DescFromIndex(id);
+            desc->addr = GetFramePhys(bufs_.get(), TxId(q), id);
+            desc->len = 0;
+            desc->flags &= static_cast<uint16_t>(~VRING_DESC_F_WRITE);
+            LTRACE_DO(virtio_dump_desc(desc));
+        }
     }
 
-    // Start the interrupt thread and set the driver OK status
+    // Start the interrupt thread, give the rx buffers to the host and set the
+    // driver OK status
     StartIrqThread();
+    for (uint16_t q = 0; q < pairs_; ++q) {
+        rx_[q].Kick();
+    }
+    DriverStatusOk();
+
+    // Enable the extra queue pairs.  If the device won't, carry on with the
+    // first pair; the other queues are simply never used.
+    if (use_ctrl && (rc = SetQueuePairs(pairs_)) != ZX_OK) {
+        zxlogf(ERROR, "failed to enable %u queue pairs: %s\n", pairs_, zx_status_get_string(rc));
+        pairs_ = 1;
+    }
 
     // Initialize the zx_device and publish us
     device_add_args_t args;
@@ -260,15 +355,93 @@ zx_status_t EthernetDevice::Init() {
         zxlogf(ERROR, "failed to add device: %s\n", zx_status_get_string(rc));
         return rc;
     }
-    // Give the rx buffers to the host
-    rx_.Kick();
 
     // Woohoo! Driver should be ready.
     cleanup.cancel();
-    DriverStatusOk();
     return ZX_OK;
 }
 
+void EthernetDevice::NegotiateFeatures() {
+    NegotiateRingFeatures();
+
+    // Multiqueue needs the control virtqueue to turn the extra queues on.
+    pairs_ = 1;
+    uint32_t mq = __builtin_ctz(VIRTIO_NET_F_MQ);
+    uint32_t ctrl_vq = __builtin_ctz(VIRTIO_NET_F_CTRL_VQ);
+    if (DeviceFeatureSupported(mq) && DeviceFeatureSupported(ctrl_vq) &&
+        config_.max_virtqueue_pairs >= VIRTIO_NET_CTRL_MQ_VQ_PAIRS_MIN &&
+        config_.max_virtqueue_pairs <= VIRTIO_NET_CTRL_MQ_VQ_PAIRS_MAX) {
+        DriverFeatureAck(mq);
+        DriverFeatureAck(ctrl_vq);
+        pairs_ = fbl::min(config_.max_virtqueue_pairs, static_cast<uint16_t>(kMaxPairs));
+    }
+    LTRACEF("using %u queue pairs\n", pairs_);
+}
+
+zx_status_t EthernetDevice::SetQueuePairs(uint16_t pairs) {
+    // The command is a header and the pair count, followed by the ack byte
+    // for the device to fill in.
+    struct ctrl_cmd {
+        virtio_net_ctrl_hdr_t hdr;
+        virtio_net_ctrl_mq_t mq;
+        uint8_t ack;
+    } __PACKED;
+    auto cmd = static_cast<volatile ctrl_cmd*>(GetFrameVirt(bufs_.get(), CtrlId(pairs_), 0));
+    zx_paddr_t pa = GetFramePhys(bufs_.get(), CtrlId(pairs_), 0);
+    cmd->hdr.class_ = VIRTIO_NET_CTRL_MQ;
+    cmd->hdr.cmd = VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET;
+    cmd->mq.virtqueue_pairs = pairs;
+    cmd->ack = VIRTIO_NET_ERR;
+
+    uint16_t id;
+    desc_t* desc = ctrl_.AllocDescChain(3, &id);
+    if (!desc) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+    desc->addr = pa + offsetof(ctrl_cmd, hdr);
+    desc->len = sizeof(virtio_net_ctrl_hdr_t);
+    desc->flags = VRING_DESC_F_NEXT;
+    desc = ctrl_.DescFromIndex(desc->next);
+    desc->addr = pa + offsetof(ctrl_cmd, mq);
+    desc->len = sizeof(virtio_net_ctrl_mq_t);
+    desc->flags = VRING_DESC_F_NEXT;
+    desc = ctrl_.DescFromIndex(desc->next);
+    desc->addr = pa + offsetof(ctrl_cmd, ack);
+    desc->len = sizeof(uint8_t);
+    desc->flags = VRING_DESC_F_WRITE;
+    ctrl_.SubmitChain(id);
+    ctrl_.Kick();
+
+    // Control commands are rare enough to just poll for the answer.
+    bool done = false;
+    auto complete = [this, &done](vring_used_elem* used_elem) {
+        uint16_t id = static_cast<uint16_t>(used_elem->id & 0xffff);
+        for (;;) {
+            desc_t* desc = ctrl_.DescFromIndex(id);
+            uint16_t next = desc->next;
+            bool more = (desc->flags & VRING_DESC_F_NEXT) != 0;
+            ctrl_.FreeDesc(id);
+            if (!more) {
+                break;
+            }
+            id = next;
+        }
+        done = true;
+    };
+    zx_time_t deadline = zx_deadline_after(kCtrlTimeout);
+    for (;;) {
+        ctrl_.IrqRingUpdate(complete);
+        if (done) {
+            break;
+        }
+        if (zx_clock_get(ZX_CLOCK_MONOTONIC) > deadline) {
+            return ZX_ERR_TIMED_OUT;
+        }
+        zx_nanosleep(zx_deadline_after(ZX_USEC(100)));
+    }
+    return cmd->ack == VIRTIO_NET_OK ? ZX_OK : ZX_ERR_IO;
+}
+
 void EthernetDevice::Release() {
     LTRACE_ENTRY;
     fbl::AutoLock lock(&state_lock_);
@@ -277,7 +450,7 @@ void EthernetDevice::Release() {
 
 void EthernetDevice::ReleaseLocked() {
     ifc_ = nullptr;
-    ReleaseBuffers(fbl::move(bufs_));
+    ReleaseBuffers(fbl::move(bufs_), num_bufs_);
     Device::Release();
 }
 
@@ -289,43 +462,48 @@ void EthernetDevice::IrqRingUpdate() {
         if (!ifc_) {
             return;
         }
-        // Ring::IrqRingUpdate will call this lambda on each rx buffer filled by
-        // the underlying device since the last IRQ.
-        // Thread safety analysis is explicitly disabled as clang isn't able to determine that the
-        // state_lock_ is  held when the lambda invoked.
-        rx_.IrqRingUpdate([this](vring_used_elem* used_elem) TA_NO_THREAD_SAFETY_ANALYSIS {
-            uint16_t id = static_cast<uint16_t>(used_elem->id & 0xffff);
-            desc_t* desc = rx_.DescFromIndex(id);
-
-            // Transitional driver does not merge rx buffers.
-            assert(used_elem->len < desc->len);
-            uint8_t* data = GetFrameData(bufs_.get(), kRxId, id);
-            size_t len = used_elem->len - sizeof(virtio_net_hdr_t);
-            LTRACEF("Receiving %zu bytes:\n", len);
-            LTRACE_DO(hexdump8_ex(data, len, 0));
-
-            // Pass the data up the stack to the generic Ethernet driver
-            ifc_->recv(cookie_, data, len, 0);
-            assert((desc->flags & VRING_DESC_F_NEXT) == 0);
-            LTRACE_DO(virtio_dump_desc(desc));
-            rx_.FreeDesc(id);
-        });
+        for (uint16_t q = 0; q < pairs_; ++q) {
+            Ring* rx = &rx_[q];
+            // Ring::IrqRingUpdate will call this lambda on each rx buffer filled by
+            // the underlying device since the last IRQ.
+            // Thread safety analysis is explicitly disabled as clang isn't able to determine that the
+            // state_lock_ is  held when the lambda invoked.
+            rx->IrqRingUpdate([this, rx, q](vring_used_elem* used_elem) TA_NO_THREAD_SAFETY_ANALYSIS {
+                uint16_t id = static_cast<uint16_t>(used_elem->id & 0xffff);
+                desc_t* desc = rx->DescFromIndex(id);
+
+                // Transitional driver does not merge rx buffers.
+                assert(used_elem->len < desc->len);
+                uint8_t* data = GetFrameData(bufs_.get(), RxId(q), id);
+                size_t len = used_elem->len - sizeof(virtio_net_hdr_t);
+                LTRACEF("Receiving %zu bytes on queue %u:\n", len, q);
+                LTRACE_DO(hexdump8_ex(data, len, 0));
+
+                // Pass the data up the stack to the generic Ethernet driver
+                ifc_->recv(cookie_, data, len, 0);
+                assert((desc->flags & VRING_DESC_F_NEXT) == 0);
+                LTRACE_DO(virtio_dump_desc(desc));
+                rx->FreeDesc(id);
+            });
+        }
     }
 
     // Now recycle the rx buffers.  As in Init(), this means queuing a bunch of
     // "reads" from the network that will complete when packets arrive.
-    desc_t* desc = nullptr;
-    uint16_t id;
-    bool need_kick = false;
-    while ((desc = rx_.AllocDescChain(1, &id))) {
-        desc->len = kFrameSize;
-        rx_.SubmitChain(id);
-        need_kick = true;
-    }
+    for (uint16_t q = 0; q < pairs_; ++q) {
+        desc_t* desc = nullptr;
+        uint16_t id;
+        bool need_kick = false;
+        while ((desc = rx_[q].AllocDescChain(1, &id))) {
+            desc->len = kFrameSize;
+            rx_[q].SubmitChain(id);
+            need_kick = true;
+        }
 
-    // If we have re-queued any rx buffers, poke the virtqueue to pick them up.
-    if (need_kick) {
-        rx_.Kick();
+        // If we have re-queued any rx buffers, poke the virtqueue to pick them up.
+        if (need_kick) {
+            rx_[q].Kick();
+        }
     }
 }
 
@@ -386,24 +564,28 @@ zx_status_t EthernetDevice::QueueTx(uint32_t options, ethmac_netbuf_t* netbuf) {
         return ZX_ERR_INVALID_ARGS;
     }
 
-    fbl::AutoLock lock(&tx_lock_);
+    uint16_t pair = TxPairFor(static_cast<const uint8_t*>(data), length, pairs_);
+    TxQueue* txq = &tx_[pair];
+    fbl::AutoLock lock(&txq->lock);
+    Ring* tx = &txq->ring;
+    uint16_t tx_id = TxId(pair);
 
     // Flush outstanding descriptors.  Ring::IrqRingUpdate will call this lambda
     // on each sent tx_buffer, allowing us to reclaim them.
-    auto flush = [this](vring_used_elem* used_elem) {
+    auto flush = [tx](vring_used_elem* used_elem) {
         uint16_t id = static_cast<uint16_t>(used_elem->id & 0xffff);
-        desc_t* desc = tx_.DescFromIndex(id);
+        desc_t* desc = tx->DescFromIndex(id);
         assert((desc->flags & VRING_DESC_F_NEXT) == 0);
         LTRACE_DO(virtio_dump_desc(desc));
-        tx_.FreeDesc(id);
+        tx->FreeDesc(id);
     };
 
     // Grab a free descriptor
     uint16_t id;
-    desc_t* desc = tx_.AllocDescChain(1, &id);
+    desc_t* desc = tx->AllocDescChain(1, &id);
     if (!desc) {
-        tx_.IrqRingUpdate(flush);
-        desc = tx_.AllocDescChain(1, &id);
+        tx->IrqRingUpdate(flush);
+        desc = tx->AllocDescChain(1, &id);
     }
     if (!desc) {
         LTRACEF("dropping packet; out of descriptors\n");
@@ -411,9 +593,9 @@ zx_status_t EthernetDevice::QueueTx(uint32_t options, ethmac_netbuf_t* netbuf) {
     }
 
     // Add the data to be sent
-    void* tx_hdr = GetFrameHdr(bufs_.get(), kTxId, id);
+    void* tx_hdr = GetFrameHdr(bufs_.get(), tx_id, id);
     memset(tx_hdr, 0, sizeof(virtio_net_hdr_t));
-    void* tx_buf = GetFrameData(bufs_.get(), kTxId, id);
+    void* tx_buf = GetFrameData(bufs_.get(), tx_id, id);
     memcpy(tx_buf, data, length);
     desc->len = static_cast<uint32_t>(sizeof(virtio_net_hdr_t) + length);
 
@@ -421,11 +603,11 @@ zx_status_t EthernetDevice::QueueTx(uint32_t options, ethmac_netbuf_t* netbuf) {
     LTRACE_DO(virtio_dump_desc(desc));
     LTRACEF("Sending %zu bytes:\n", length);
     LTRACE_DO(hexdump8_ex(tx_buf, length, 0));
-    tx_.SubmitChain(id);
-    ++unkicked_;
-    if ((options & ETHMAC_TX_OPT_MORE) == 0 || unkicked_ > kBacklog / 2) {
-        tx_.Kick();
-        unkicked_ = 0;
+    tx->SubmitChain(id);
+    ++txq->unkicked;
+    if ((options & ETHMAC_TX_OPT_MORE) == 0 || txq->unkicked > kBacklog / 2) {
+        tx->Kick();
+        txq->unkicked = 0;
     }
     return ZX_OK;
 }
@@ -49,18 +49,34 @@ private:
     // DDK device hooks; see ddk/device.h
     void ReleaseLocked() TA_REQ(state_lock_);
 
-    // Mutexes to control concurrent access
+    // Negotiates multiqueue support, leaving the number of queue pairs to use
+    // in |pairs_|.
+    void NegotiateFeatures() TA_REQ(state_lock_);
+    // Tells the device how many queue pairs to use over the control virtqueue.
+    zx_status_t SetQueuePairs(uint16_t pairs) TA_REQ(state_lock_);
+
+    // Mutex to control concurrent access
     mtx_t state_lock_;
-    mtx_t tx_lock_;
 
     // Virtqueues; see section 5.1.2 of the spec
-    // This driver doesn't currently support multi-queueing, automatic
-    // steering, or the control virtqueue, so only a single queue is needed in
-    // each direction.
-    Ring rx_;
-    Ring tx_;
+    // With VIRTIO_NET_F_MQ, the device has a receive and transmit queue per
+    // queue pair, and the control virtqueue is used to enable them. The
+    // device does the steering; we hand received packets up from every
+    // receive queue and send each flow on the transmit queue it hashes to.
+    static const uint16_t kMaxPairs = 4;
+    struct TxQueue {
+        TxQueue(Device* device) : ring(device) {}
+        Ring ring;
+        mtx_t lock;
+        // Number of packets submitted since the last kick; guarded by |lock|.
+        size_t unkicked = 0;
+    };
+    uint16_t pairs_;
+    Ring rx_[kMaxPairs];
+    TxQueue tx_[kMaxPairs];
+    Ring ctrl_;
     fbl::unique_ptr<io_buffer_t[]> bufs_;
-    size_t unkicked_ TA_GUARDED(tx_lock_);
+    size_t num_bufs_;
 
     // Saved net device configuration out of the pci config BAR
     virtio_net_config_t config_ TA_GUARDED(state_lock_);
@@ -42,6 +42,8 @@ zx_status_t Ring::Init(uint16_t index, uint16_t count) {
     // XXX check that count is a power of 2
 
     index_ = index;
+    event_idx_ = device_->RingEventIdx();
+    kicked_idx_ = 0;
 
     // make sure the count is available in this ring
     uint16_t max_ring_size = device_->GetRingSize(index);
@@ -129,14 +131,34 @@ void Ring::SubmitChain(uint16_t desc_index) {
     struct vring_avail* avail = ring_.avail;
 
     avail->ring[avail->idx & ring_.num_mask] = desc_index;
-    //mb();
-    avail->idx++;
+    // the device must see the new entry before the index that publishes it
+    __atomic_store_n(&avail->idx, static_cast<uint16_t>(avail->idx + 1), __ATOMIC_RELEASE);
 }
 
 void Ring::Kick() {
     LTRACE_ENTRY;
 
-    device_->RingKick(index_);
+    // Publish the avail index before reading what the device wants to be
+    // notified about, or we could miss a notification it is waiting for.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    uint16_t new_idx = ring_.avail->idx;
+    uint16_t old_idx = kicked_idx_;
+    kicked_idx_ = new_idx;
+
+    bool notify;
+    if (event_idx_) {
+        // Only notify if the device's avail event index is among the entries
+        // made available since the last kick.
+        notify = vring_need_event(vring_avail_event(&ring_), new_idx, old_idx);
+    } else {
+        notify = !(ring_.used->flags & VRING_USED_F_NO_NOTIFY);
+    }
+
+    LTRACEF("index %u avail %u -> %u notify %d\n", index_, old_idx, new_idx, notify);
+    if (notify) {
+        device_->RingKick(index_);
+    }
 }
 
 } // namespace virtio
@@ -34,6 +34,11 @@ public:
 private:
     Device* device_ = nullptr;
 
+    // whether VIRTIO_RING_F_EVENT_IDX was negotiated when the ring was set up
+    bool event_idx_ = false;
+    // avail index as of the last call to Kick()
+    uint16_t kicked_idx_ = 0;
+
     zx_paddr_t ring_pa_ = 0;
     uintptr_t ring_va_ = 0;
     size_t ring_va_len_ = 0;
@@ -50,18 +55,31 @@ inline void Ring::IrqRingUpdate(T free_chain) {
     //         ring_.used->flags, ring_.used->idx, ring_.last_used);
 
     // find a new free chain of descriptors
-    uint16_t cur_idx = ring_.used->idx;
     uint16_t i = ring_.last_used;
-    for (; i != cur_idx; ++i) {
-        // TRACEF("looking at idx %u\n", i);
-
-        struct vring_used_elem* used_elem = &ring_.used->ring[i & ring_.num_mask];
-        // TRACEF("used chain id %u, len %u\n", used_elem->id, used_elem->len);
-
-        // free the chain
-        free_chain(used_elem);
+    for (;;) {
+        uint16_t cur_idx = __atomic_load_n(&ring_.used->idx, __ATOMIC_ACQUIRE);
+        for (; i != cur_idx; ++i) {
+            // TRACEF("looking at idx %u\n", i);
+
+            struct vring_used_elem* used_elem = &ring_.used->ring[i & ring_.num_mask];
+            // TRACEF("used chain id %u, len %u\n", used_elem->id, used_elem->len);
+
+            // free the chain
+            free_chain(used_elem);
+        }
+        ring_.last_used = i;
+
+        if (!event_idx_) {
+            break;
+        }
+        // Ask to be interrupted once the next chain is used, then pick up any
+        // that were used before the device could see the request.
+        vring_used_event(&ring_) = i;
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&ring_.used->idx, __ATOMIC_RELAXED) == i) {
+            break;
+        }
     }
-    ring_.last_used = i;
 }
 
 void virtio_dump_desc(const struct vring_desc* desc);
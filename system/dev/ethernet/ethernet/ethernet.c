@@ -56,14 +56,11 @@ typedef struct ethdev0 {
 } ethdev0_t;
 
 typedef struct tx_info {
-    struct ethdev* edev;
+    struct eth_queue* queue;
     void* fifo_cookie;
     ethmac_netbuf_t netbuf;
 } tx_info_t;
 
-// transmit thread has been created
-#define ETHDEV_TX_THREAD (1u)
-
 // connected to the ethmac and handling traffic
 #define ETHDEV_RUNNING (2u)
 
@@ -94,14 +91,9 @@ typedef struct tx_info {
 //   zircon/system/utest/ethernet/ethernet.cpp
 #define MULTICAST_LIST_LIMIT (32)
 
-// ethernet instance device
-typedef struct ethdev {
-    list_node_t node;
-
-    ethdev0_t* edev0;
-
-    uint32_t state;
-    char name[DEVICE_NAME_LEN];
+// a tx/rx fifo pair of an ethernet instance
+typedef struct eth_queue {
+    struct ethdev* edev;
 
     // fifos are named from the perspective
     // of the packet from from the client
@@ -110,14 +102,13 @@ typedef struct ethdev {
     uint32_t tx_depth;
     zx_handle_t rx_fifo;
     uint32_t rx_depth;
+
+    // rx buffers read from the client but not filled yet, and
+    // filled ones not yet returned (both protected by edev0->lock)
     eth_fifo_entry_t rx_entries[FIFO_BATCH_SZ];
     size_t rx_entry_count;
-
-    // io buffer
-    zx_handle_t io_vmo;
-    void* io_buf;
-    size_t io_size;
-    zx_paddr_t* paddr_map;
+    eth_fifo_entry_t rx_done[FIFO_BATCH_SZ];
+    size_t rx_done_count;
 
     tx_info_t all_tx_bufs[FIFO_DEPTH];
     mtx_t lock;  // Protects free_tx_bufs
@@ -125,6 +116,28 @@ typedef struct ethdev {
 
     // fifo thread
     thrd_t tx_thr;
+    bool tx_thread_started;
+} eth_queue_t;
+
+// ethernet instance device
+typedef struct ethdev {
+    list_node_t node;
+
+    ethdev0_t* edev0;
+
+    uint32_t state;
+    char name[DEVICE_NAME_LEN];
+
+    // queues[0] holds the fifos from IOCTL_ETHERNET_GET_FIFOS, and
+    // the rest were added with IOCTL_ETHERNET_ADD_QUEUE
+    eth_queue_t* queues[ETH_MAX_QUEUES];
+    uint32_t queue_count;
+
+    // io buffer
+    zx_handle_t io_vmo;
+    void* io_buf;
+    size_t io_size;
+    zx_paddr_t* paddr_map;
 
     zx_device_t* zxdev;
 
@@ -278,12 +291,103 @@ static ssize_t eth_config_multicast_locked(ethdev_t* edev, eth_multicast_config_
     }
 }
 
-static void eth_handle_rx(ethdev_t* edev, const void* data, size_t len, uint32_t extra) {
+// Computes a hash of the flow a frame belongs to from its IP addresses and, when present, its
+// TCP or UDP ports, so that all frames of a flow are delivered through the same queue. Frames
+// which are neither IPv4 nor IPv6 all hash to 0.
+static uint32_t eth_flow_hash(const uint8_t* data, size_t len) {
+    const size_t kEthHdrLen = 14;
+    if (len < kEthHdrLen) {
+        return 0;
+    }
+    uint16_t ethertype = (uint16_t)((data[12] << 8) | data[13]);
+    const uint8_t* ip = data + kEthHdrLen;
+    size_t ip_len = len - kEthHdrLen;
+
+    const uint8_t* addrs;
+    size_t addrs_len;
+    const uint8_t* ports = NULL;
+    uint8_t proto;
+    if (ethertype == 0x0800) {
+        if (ip_len < 20) {
+            return 0;
+        }
+        size_t ihl = (ip[0] & 0xf) * 4;
+        proto = ip[9];
+        addrs = ip + 12;
+        addrs_len = 8;
+        // Only the first fragment has the ports, so leave them out for every fragment.
+        bool fragment = ((ip[6] & 0x3f) | ip[7]) != 0;
+        if (!fragment && ihl >= 20 && ip_len >= ihl + 4) {
+            ports = ip + ihl;
+        }
+    } else if (ethertype == 0x86dd) {
+        if (ip_len < 40) {
+            return 0;
+        }
+        proto = ip[6];
+        addrs = ip + 8;
+        addrs_len = 32;
+        if (ip_len >= 44) {
+            ports = ip + 40;
+        }
+    } else {
+        return 0;
+    }
+
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < addrs_len; i++) {
+        hash = (hash ^ addrs[i]) * 16777619u;
+    }
+    if (ports != NULL && (proto == 6 || proto == 17)) {
+        for (size_t i = 0; i < 4; i++) {
+            hash = (hash ^ ports[i]) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+// Returns the rx buffers filled so far to the client.
+static void eth_rx_flush_queue(ethdev_t* edev, eth_queue_t* queue) {
+    if (queue->rx_done_count == 0) {
+        return;
+    }
+
+    zx_status_t status;
+    uint32_t count;
+    if ((status = zx_fifo_write(queue->rx_fifo, queue->rx_done,
+                                queue->rx_done_count * sizeof(eth_fifo_entry_t), &count)) < 0) {
+        if (status == ZX_ERR_SHOULD_WAIT) {
+            if ((edev->fail_rx_write++ % FAIL_REPORT_RATE) == 0) {
+                zxlogf(ERROR, "eth [%s]: no rx_fifo space available (%u times)\n",
+                       edev->name, edev->fail_rx_write);
+            }
+        } else {
+            // Fatal, should force teardown
+            zxlogf(ERROR, "eth [%s]: rx_fifo write failed %d\n", edev->name, status);
+        }
+    } else if (count != queue->rx_done_count) {
+        zxlogf(ERROR, "eth [%s]: rx_fifo: only wrote %u of %zu!\n",
+               edev->name, count, queue->rx_done_count);
+    }
+    queue->rx_done_count = 0;
+}
+
+static void eth_rx_flush(ethdev_t* edev) {
+    for (uint32_t i = 0; i < edev->queue_count; i++) {
+        eth_rx_flush_queue(edev, edev->queues[i]);
+    }
+}
+
+static void eth_handle_rx(ethdev_t* edev, uint32_t hash, const void* data, size_t len,
+                          uint32_t extra) {
+    eth_queue_t* queue = edev->queues[hash % edev->queue_count];
     zx_status_t status;
     uint32_t count;
 
-    if (edev->rx_entry_count == 0) {
-        status = zx_fifo_read(edev->rx_fifo, edev->rx_entries, sizeof(edev->rx_entries), &count);
+    if (queue->rx_entry_count == 0) {
+        status = zx_fifo_read(queue->rx_fifo, queue->rx_entries, sizeof(queue->rx_entries),
+                              &count);
         if (status != ZX_OK) {
             if (status == ZX_ERR_SHOULD_WAIT) {
                 if ((edev->fail_rx_read++ % FAIL_REPORT_RATE) == 0) {
@@ -296,10 +400,11 @@ static void eth_handle_rx(ethdev_t* edev, const void* data, size_t len, uint32_t
             }
             return;
         }
-        edev->rx_entry_count = count;
+        queue->rx_entry_count = count;
     }
 
-    eth_fifo_entry_t* e = &edev->rx_entries[--edev->rx_entry_count];
+    eth_fifo_entry_t* e = &queue->rx_done[queue->rx_done_count++];
+    *e = queue->rx_entries[--queue->rx_entry_count];
     if ((e->offset >= edev->io_size) || ((e->length > (edev->io_size - e->offset)))) {
         // invalid offset/length. report error. drop packet
         e->length = 0;
@@ -314,17 +419,8 @@ static void eth_handle_rx(ethdev_t* edev, const void* data, size_t len, uint32_t
         e->flags = ETH_FIFO_RX_OK | extra;
     }
 
-    if ((status = zx_fifo_write(edev->rx_fifo, e, sizeof(*e), &count)) < 0) {
-        if (status == ZX_ERR_SHOULD_WAIT) {
-            if ((edev->fail_rx_write++ % FAIL_REPORT_RATE) == 0) {
-                zxlogf(ERROR, "eth [%s]: no rx_fifo space available (%u times)\n",
-                       edev->name, edev->fail_rx_write);
-            }
-        } else {
-            // Fatal, should force teardown
-            zxlogf(ERROR, "eth [%s]: rx_fifo write failed %d\n", edev->name, status);
-        }
-        return;
+    if (queue->rx_done_count == FIFO_BATCH_SZ) {
+        eth_rx_flush_queue(edev, queue);
     }
 }
 
@@ -337,16 +433,17 @@ static void eth0_status(void* cookie, uint32_t status) {
 
     ethdev_t* edev;
     list_for_every_entry(&edev0->list_active, edev, ethdev_t, node) {
-        zx_object_signal_peer(edev->rx_fifo, 0, ETH_SIGNAL_STATUS);
+        zx_object_signal_peer(edev->queues[0]->rx_fifo, 0, ETH_SIGNAL_STATUS);
     }
     mtx_unlock(&edev0->lock);
 }
 
-static int tx_fifo_write(ethdev_t* edev, eth_fifo_entry_t* entries, uint32_t count) {
+static int tx_fifo_write(eth_queue_t* queue, eth_fifo_entry_t* entries, uint32_t count) {
+    ethdev_t* edev = queue->edev;
     zx_status_t status;
     uint32_t actual;
     // Writing should never fail, or fail to write all entries
-    status = zx_fifo_write(edev->tx_fifo, entries, sizeof(eth_fifo_entry_t) * count, &actual);
+    status = zx_fifo_write(queue->tx_fifo, entries, sizeof(eth_fifo_entry_t) * count, &actual);
     if (status < 0) {
         zxlogf(ERROR, "eth [%s]: tx_fifo write failed %d\n", edev->name, status);
         return -1;
@@ -362,18 +459,25 @@ static int tx_fifo_write(ethdev_t* edev, eth_fifo_entry_t* entries, uint32_t cou
 // can deadlock with the ethermac device
 static void eth0_recv(void* cookie, void* data, size_t len, uint32_t flags) {
     ethdev0_t* edev0 = cookie;
+    uint32_t hash = eth_flow_hash(data, len);
+    uint32_t extra = (flags & ETHMAC_RECV_CSUM_OK) ? ETH_FIFO_RX_CSUM_OK : 0;
 
     ethdev_t* edev;
     mtx_lock(&edev0->lock);
     list_for_every_entry(&edev0->list_active, edev, ethdev_t, node) {
-        eth_handle_rx(edev, data, len, 0);
+        eth_handle_rx(edev, hash, data, len, extra);
+        // Completions are returned once per batch of packets from the ethmac.
+        if (!(flags & ETHMAC_RECV_MORE)) {
+            eth_rx_flush(edev);
+        }
     }
     mtx_unlock(&edev0->lock);
 }
 
 static void eth0_complete_tx(void* cookie, ethmac_netbuf_t* netbuf, zx_status_t status) {
     tx_info_t* tx_info = containerof(netbuf, tx_info_t, netbuf);
-    ethdev_t* edev = tx_info->edev;
+    eth_queue_t* queue = tx_info->queue;
+    ethdev_t* edev = queue->edev;
     eth_fifo_entry_t entry = {.offset = netbuf->data - edev->io_buf,
                               .length = netbuf->len,
                               .flags = status == ZX_OK ? ETH_FIFO_TX_OK : 0,
@@ -381,12 +485,12 @@ static void eth0_complete_tx(void* cookie, ethmac_netbuf_t* netbuf, zx_status_t
 
     // Now that we've copied all pertinent data from the netbuf, return it to the free list so
     // it is avaialble immediately for the next request.
-    mtx_lock(&edev->lock);
-    list_add_head(&edev->free_tx_bufs, &tx_info->netbuf.node);
-    mtx_unlock(&edev->lock);
+    mtx_lock(&queue->lock);
+    list_add_head(&queue->free_tx_bufs, &tx_info->netbuf.node);
+    mtx_unlock(&queue->lock);
 
     // Send the eth_fifo_entry back to the client
-    tx_fifo_write(edev, &entry, 1);
+    tx_fifo_write(queue, &entry, 1);
 }
 
 static ethmac_ifc_t ethmac_ifc = {
@@ -396,11 +500,13 @@ static ethmac_ifc_t ethmac_ifc = {
 };
 
 static void eth_tx_echo(ethdev0_t* edev0, const void* data, size_t len) {
+    uint32_t hash = eth_flow_hash(data, len);
     ethdev_t* edev;
     mtx_lock(&edev0->lock);
     list_for_every_entry(&edev0->list_active, edev, ethdev_t, node) {
         if (edev->state & ETHDEV_TX_LISTEN) {
-            eth_handle_rx(edev, data, len, ETH_FIFO_RX_TX);
+            eth_handle_rx(edev, hash, data, len, ETH_FIFO_RX_TX);
+            eth_rx_flush(edev);
         }
     }
     mtx_unlock(&edev0->lock);
@@ -436,24 +542,54 @@ static zx_status_t eth_tx_listen_locked(ethdev_t* edev, bool yes) {
     return ZX_OK;
 }
 
-static int eth_send(ethdev_t* edev, eth_fifo_entry_t* entries, uint32_t count) {
+// Translates the offloads requested in a tx fifo entry into netbuf flags. Fails if the
+// device cannot do them.
+static zx_status_t eth_tx_offloads(ethdev0_t* edev0, uint16_t fifo_flags, uint32_t* out) {
+    uint32_t flags = 0;
+    if (fifo_flags & ETH_FIFO_TX_CSUM) {
+        if (!(edev0->info.features & ETHMAC_FEATURE_TX_CSUM)) {
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        flags |= ETHMAC_NETBUF_TX_CSUM;
+    }
+    if (fifo_flags & ETH_FIFO_TX_TSO) {
+        if (!(edev0->info.features & ETHMAC_FEATURE_TSO)) {
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        flags |= ETHMAC_NETBUF_TX_TSO;
+    }
+    *out = flags;
+    return ZX_OK;
+}
+
+static int eth_send(eth_queue_t* queue, eth_fifo_entry_t* entries, uint32_t count) {
+    ethdev_t* edev = queue->edev;
     ethdev0_t* edev0 = edev->edev0;
-    for (eth_fifo_entry_t* e = entries; count > 0; e++) {
-        if ((e->offset > edev->io_size) || ((e->length > (edev->io_size - e->offset)))) {
+    // Entries which are done with before we return are moved to the front of
+    // |entries| and sent back to the client with a single fifo write.
+    uint32_t done = 0;
+    int ret = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        eth_fifo_entry_t* e = &entries[i];
+        uint32_t netbuf_flags;
+        if ((e->offset > edev->io_size) || ((e->length > (edev->io_size - e->offset))) ||
+            eth_tx_offloads(edev0, e->flags, &netbuf_flags) != ZX_OK) {
             e->flags = ETH_FIFO_INVALID;
-            tx_fifo_write(edev, e, 1);
+            entries[done++] = *e;
         } else {
             zx_status_t status;
-            mtx_lock(&edev->lock);
-            tx_info_t* tx_info = list_remove_head_type(&edev->free_tx_bufs, tx_info_t, netbuf.node);
-            mtx_unlock(&edev->lock);
+            mtx_lock(&queue->lock);
+            tx_info_t* tx_info = list_remove_head_type(&queue->free_tx_bufs, tx_info_t,
+                                                       netbuf.node);
+            mtx_unlock(&queue->lock);
             if (tx_info == NULL) {
                  zxlogf(ERROR, "eth [%s]: invalid tx_info pool\n", edev->name);
-                 return -1;
+                 ret = -1;
+                 break;
             }
-            uint32_t opts = count > 1 ? ETHMAC_TX_OPT_MORE : 0u;
+            uint32_t opts = i + 1 < count ? ETHMAC_TX_OPT_MORE : 0u;
             if (opts) {
-                zxlogf(SPEW, "setting OPT_MORE (%u packets to go)\n", count);
+                zxlogf(SPEW, "setting OPT_MORE (%u packets to go)\n", count - i);
             }
             tx_info->netbuf.data = edev->io_buf + e->offset;
             if (edev0->info.features & ETHMAC_FEATURE_DMA) {
@@ -461,6 +597,7 @@ static int eth_send(ethdev_t* edev, eth_fifo_entry_t* entries, uint32_t count) {
                                        (e->offset & PAGE_MASK);
             }
             tx_info->netbuf.len = e->length;
+            tx_info->netbuf.flags = netbuf_flags;
             tx_info->fifo_cookie = e->cookie;
             status = edev0->mac.ops->queue_tx(edev0->mac.ctx, opts, &tx_info->netbuf);
             if (edev->state & ETHDEV_TX_LOOPBACK) {
@@ -468,30 +605,32 @@ static int eth_send(ethdev_t* edev, eth_fifo_entry_t* entries, uint32_t count) {
             }
             if (status != ZX_ERR_SHOULD_WAIT) {
                 // transaction completed, add buffer to free list and return fifo entry
-                // TODO: batch these so we can do a single fifo write
                 e->flags = status == ZX_OK ? ETH_FIFO_TX_OK : 0;
-                mtx_lock(&edev->lock);
-                list_add_head(&edev->free_tx_bufs, &tx_info->netbuf.node);
-                mtx_unlock(&edev->lock);
-                tx_fifo_write(edev, e, 1);
+                mtx_lock(&queue->lock);
+                list_add_head(&queue->free_tx_bufs, &tx_info->netbuf.node);
+                mtx_unlock(&queue->lock);
+                entries[done++] = *e;
             }
         }
-        count--;
     }
-    return 0;
+    if (done > 0) {
+        tx_fifo_write(queue, entries, done);
+    }
+    return ret;
 }
 
 static int eth_tx_thread(void* arg) {
-    ethdev_t* edev = (ethdev_t*)arg;
+    eth_queue_t* queue = (eth_queue_t*)arg;
+    ethdev_t* edev = queue->edev;
     eth_fifo_entry_t entries[FIFO_DEPTH / 2];
     zx_status_t status;
     uint32_t count;
 
     for (;;) {
-        if ((status = zx_fifo_read(edev->tx_fifo, entries, sizeof(entries), &count)) < 0) {
+        if ((status = zx_fifo_read(queue->tx_fifo, entries, sizeof(entries), &count)) < 0) {
             if (status == ZX_ERR_SHOULD_WAIT) {
                 zx_signals_t observed;
-                if ((status = zx_object_wait_one(edev->tx_fifo,
+                if ((status = zx_object_wait_one(queue->tx_fifo,
                                                  ZX_FIFO_READABLE |
                                                  ZX_FIFO_PEER_CLOSED |
                                                  kSignalFifoTerminate,
@@ -508,7 +647,7 @@ static int eth_tx_thread(void* arg) {
                 break;
             }
         }
-        if (eth_send(edev, entries, count)) {
+        if (eth_send(queue, entries, count)) {
             break;
         }
     }
@@ -517,34 +656,84 @@ static int eth_tx_thread(void* arg) {
     return 0;
 }
 
+// Creates a tx/rx fifo pair for the client and the queue that services it.
+static zx_status_t eth_add_queue_locked(ethdev_t* edev, eth_fifos_t* fifos) {
+    if (edev->queue_count == ETH_MAX_QUEUES) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+
+    eth_queue_t* queue;
+    if ((queue = calloc(1, sizeof(eth_queue_t))) == NULL) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    queue->edev = edev;
+    list_initialize(&queue->free_tx_bufs);
+    for (size_t ndx = 0; ndx < FIFO_DEPTH; ndx++) {
+        queue->all_tx_bufs[ndx].queue = queue;
+        list_add_tail(&queue->free_tx_bufs, &queue->all_tx_bufs[ndx].netbuf.node);
+    }
+    mtx_init(&queue->lock, mtx_plain);
+
+    zx_status_t status;
+    if ((status = zx_fifo_create(FIFO_DEPTH, FIFO_ESIZE, 0, &fifos->tx_fifo, &queue->tx_fifo)) < 0) {
+        zxlogf(ERROR, "eth_create  [%s]: failed to create tx fifo: %d\n", edev->name, status);
+        free(queue);
+        return status;
+    }
+    if ((status = zx_fifo_create(FIFO_DEPTH, FIFO_ESIZE, 0, &fifos->rx_fifo, &queue->rx_fifo)) < 0) {
+        zxlogf(ERROR, "eth_create  [%s]: failed to create rx fifo: %d\n", edev->name, status);
+        zx_handle_close(fifos->tx_fifo);
+        zx_handle_close(queue->tx_fifo);
+        free(queue);
+        return status;
+    }
+
+    queue->tx_depth = FIFO_DEPTH;
+    queue->rx_depth = FIFO_DEPTH;
+    fifos->tx_depth = FIFO_DEPTH;
+    fifos->rx_depth = FIFO_DEPTH;
+
+    edev->queues[edev->queue_count++] = queue;
+    return ZX_OK;
+}
+
 static zx_status_t eth_get_fifos_locked(ethdev_t* edev, void* out_buf, size_t out_len,
                                         size_t* out_actual) {
     if (out_len < sizeof(eth_fifos_t)) {
         return ZX_ERR_INVALID_ARGS;
     }
-    if (edev->tx_fifo != ZX_HANDLE_INVALID) {
+    if (edev->queue_count != 0) {
         return ZX_ERR_ALREADY_BOUND;
     }
 
     eth_fifos_t* fifos = out_buf;
 
     zx_status_t status;
-    if ((status = zx_fifo_create(FIFO_DEPTH, FIFO_ESIZE, 0, &fifos->tx_fifo, &edev->tx_fifo)) < 0) {
-        zxlogf(ERROR, "eth_create  [%s]: failed to create tx fifo: %d\n", edev->name, status);
+    if ((status = eth_add_queue_locked(edev, fifos)) < 0) {
         return status;
     }
-    if ((status = zx_fifo_create(FIFO_DEPTH, FIFO_ESIZE, 0, &fifos->rx_fifo, &edev->rx_fifo)) < 0) {
-        zxlogf(ERROR, "eth_create  [%s]: failed to create rx fifo: %d\n", edev->name, status);
-        zx_handle_close(fifos->tx_fifo);
-        zx_handle_close(edev->tx_fifo);
-        edev->tx_fifo = ZX_HANDLE_INVALID;
-        return status;
+
+    *out_actual = sizeof(*fifos);
+    return ZX_OK;
+}
+
+static zx_status_t eth_get_queue_fifos_locked(ethdev_t* edev, void* out_buf, size_t out_len,
+                                              size_t* out_actual) {
+    if (out_len < sizeof(eth_fifos_t)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    // The rx hash spreads flows over a fixed set of queues, so only allow
+    // adding to it after the first fifos exist and before traffic flows.
+    if ((edev->queue_count == 0) || (edev->state & ETHDEV_RUNNING)) {
+        return ZX_ERR_BAD_STATE;
     }
 
-    edev->tx_depth = FIFO_DEPTH;
-    edev->rx_depth = FIFO_DEPTH;
-    fifos->tx_depth = FIFO_DEPTH;
-    fifos->rx_depth = FIFO_DEPTH;
+    eth_fifos_t* fifos = out_buf;
+
+    zx_status_t status;
+    if ((status = eth_add_queue_locked(edev, fifos)) < 0) {
+        return status;
+    }
 
     *out_actual = sizeof(*fifos);
     return ZX_OK;
@@ -612,9 +801,7 @@ static zx_status_t eth_start_locked(ethdev_t* edev) TA_NO_THREAD_SAFETY_ANALYSIS
     ethdev0_t* edev0 = edev->edev0;
 
     // Cannot start unless tx/rx rings are configured
-    if ((edev->io_vmo == ZX_HANDLE_INVALID) ||
-        (edev->tx_fifo == ZX_HANDLE_INVALID) ||
-        (edev->rx_fifo == ZX_HANDLE_INVALID)) {
+    if ((edev->io_vmo == ZX_HANDLE_INVALID) || (edev->queue_count == 0)) {
         return ZX_ERR_BAD_STATE;
     }
 
@@ -622,14 +809,18 @@ static zx_status_t eth_start_locked(ethdev_t* edev) TA_NO_THREAD_SAFETY_ANALYSIS
         return ZX_OK;
     }
 
-    if (!(edev->state & ETHDEV_TX_THREAD)) {
-        int r = thrd_create_with_name(&edev->tx_thr, eth_tx_thread,
-                                      edev, "eth-tx-thread");
+    for (uint32_t i = 0; i < edev->queue_count; i++) {
+        eth_queue_t* queue = edev->queues[i];
+        if (queue->tx_thread_started) {
+            continue;
+        }
+        int r = thrd_create_with_name(&queue->tx_thr, eth_tx_thread,
+                                      queue, "eth-tx-thread");
         if (r != thrd_success) {
             zxlogf(ERROR, "eth [%s]: failed to start tx thread: %d\n", edev->name, r);
             return ZX_ERR_INTERNAL;
         }
-        edev->state |= ETHDEV_TX_THREAD;
+        queue->tx_thread_started = true;
     }
 
     zx_status_t status;
@@ -665,6 +856,8 @@ static zx_status_t eth_stop_locked(ethdev_t* edev) TA_NO_THREAD_SAFETY_ANALYSIS
 
     if (edev->state & ETHDEV_RUNNING) {
         edev->state &= (~ETHDEV_RUNNING);
+        // Hand back anything held for a batch that will not be finished now.
+        eth_rx_flush(edev);
         list_delete(&edev->node);
         list_add_tail(&edev0->list_idle, &edev->node);
         // The next three lines clean up promisc, multicast-promisc, and multicast-filter, in case
@@ -703,10 +896,10 @@ static zx_status_t eth_get_status_locked(ethdev_t* edev, void* out_buf, size_t o
     if (out_len < sizeof(uint32_t)) {
         return ZX_ERR_INVALID_ARGS;
     }
-    if (edev->rx_fifo == ZX_HANDLE_INVALID) {
+    if (edev->queue_count == 0 || edev->queues[0]->rx_fifo == ZX_HANDLE_INVALID) {
         return ZX_ERR_BAD_STATE;
     }
-    if (zx_object_signal_peer(edev->rx_fifo, ETH_SIGNAL_STATUS, 0) != ZX_OK) {
+    if (zx_object_signal_peer(edev->queues[0]->rx_fifo, ETH_SIGNAL_STATUS, 0) != ZX_OK) {
         return ZX_ERR_INTERNAL;
     }
 
@@ -749,6 +942,15 @@ static zx_status_t eth_ioctl(void* ctx, uint32_t op,
             if (edev->edev0->info.features & ETHMAC_FEATURE_SYNTH) {
                 info->features |= ETH_FEATURE_SYNTH;
             }
+            if (edev->edev0->info.features & ETHMAC_FEATURE_RX_CSUM) {
+                info->features |= ETH_FEATURE_RX_CSUM;
+            }
+            if (edev->edev0->info.features & ETHMAC_FEATURE_TX_CSUM) {
+                info->features |= ETH_FEATURE_TX_CSUM;
+            }
+            if (edev->edev0->info.features & ETHMAC_FEATURE_TSO) {
+                info->features |= ETH_FEATURE_TSO;
+            }
             info->mtu = edev->edev0->info.mtu;
             *out_actual = sizeof(*info);
             status = ZX_OK;
@@ -758,6 +960,9 @@ static zx_status_t eth_ioctl(void* ctx, uint32_t op,
     case IOCTL_ETHERNET_GET_FIFOS:
         status = eth_get_fifos_locked(edev, out_buf, out_len, out_actual);
         break;
+    case IOCTL_ETHERNET_ADD_QUEUE:
+        status = eth_get_queue_fifos_locked(edev, out_buf, out_len, out_actual);
+        break;
     case IOCTL_ETHERNET_SET_IOBUF:
         status = eth_set_iobuf_locked(edev, in_buf, in_len);
         break;
@@ -812,37 +1017,43 @@ static void eth_kill_locked(ethdev_t* edev) {
         return;
     }
 
-    zxlogf(TRACE, "eth [%s]: kill: tearing down%s\n",
-            edev->name, (edev->state & ETHDEV_TX_THREAD) ? " tx thread" : "");
+    zxlogf(TRACE, "eth [%s]: kill: tearing down %u queues\n", edev->name, edev->queue_count);
     eth_set_promisc_locked(edev, false);
 
     // make sure any future ioctls or other ops will fail
     edev->state |= ETHDEV_DEAD;
 
     // try to convince clients to close us
-    if (edev->rx_fifo) {
-        zx_handle_close(edev->rx_fifo);
-        edev->rx_fifo = ZX_HANDLE_INVALID;
-    }
-    if (edev->tx_fifo) {
-        // Ask the TX thread to exit.
-        zx_object_signal(edev->tx_fifo, 0, kSignalFifoTerminate);
+    for (uint32_t i = 0; i < edev->queue_count; i++) {
+        eth_queue_t* queue = edev->queues[i];
+        if (queue->rx_fifo) {
+            zx_handle_close(queue->rx_fifo);
+            queue->rx_fifo = ZX_HANDLE_INVALID;
+        }
+        queue->rx_done_count = 0;
+        if (queue->tx_fifo) {
+            // Ask the TX thread to exit.
+            zx_object_signal(queue->tx_fifo, 0, kSignalFifoTerminate);
+        }
     }
     if (edev->io_vmo) {
         zx_handle_close(edev->io_vmo);
         edev->io_vmo = ZX_HANDLE_INVALID;
     }
 
-    if (edev->state & ETHDEV_TX_THREAD) {
-        edev->state &= (~ETHDEV_TX_THREAD);
-        int ret;
-        thrd_join(edev->tx_thr, &ret);
-        zxlogf(TRACE, "eth [%s]: kill: tx thread exited\n", edev->name);
-    }
+    for (uint32_t i = 0; i < edev->queue_count; i++) {
+        eth_queue_t* queue = edev->queues[i];
+        if (queue->tx_thread_started) {
+            queue->tx_thread_started = false;
+            int ret;
+            thrd_join(queue->tx_thr, &ret);
+            zxlogf(TRACE, "eth [%s]: kill: tx thread %u exited\n", edev->name, i);
+        }
 
-    if (edev->tx_fifo) {
-        zx_handle_close(edev->tx_fifo);
-        edev->tx_fifo = ZX_HANDLE_INVALID;
+        if (queue->tx_fifo) {
+            zx_handle_close(queue->tx_fifo);
+            queue->tx_fifo = ZX_HANDLE_INVALID;
+        }
     }
 
     if (edev->io_buf) {
@@ -858,6 +1069,9 @@ static void eth_release(void* ctx) {
     ethdev_t* edev = ctx;
     if (edev) {
         free(edev->paddr_map);
+        for (uint32_t i = 0; i < edev->queue_count; i++) {
+            free(edev->queues[i]);
+        }
     }
     free(edev);
 }
@@ -890,13 +1104,6 @@ static zx_status_t eth0_open(void* ctx, zx_device_t** out, uint32_t flags) {
     }
     edev->edev0 = edev0;
 
-    list_initialize(&edev->free_tx_bufs);
-    for (size_t ndx = 0; ndx < FIFO_DEPTH; ndx++) {
-        edev->all_tx_bufs[ndx].edev = edev;
-        list_add_tail(&edev->free_tx_bufs, &edev->all_tx_bufs[ndx].netbuf.node);
-    }
-    mtx_init(&edev->lock, mtx_plain);
-
     device_add_args_t args = {
         .version = DEVICE_ADD_ARGS_VERSION,
         .name = "ethernet",
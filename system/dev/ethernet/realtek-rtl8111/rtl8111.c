@@ -184,8 +184,12 @@ static int irq_thread(void* arg) {
             while (!((rxd = edev->rxd_ring + edev->rxd_idx)->status1 & RX_DESC_OWN)) {
                 if (edev->ifc) {
                     size_t len = rxd->status1 & RX_DESC_LEN_MASK;
+                    // Let the ethernet layer batch completions while the next
+                    // descriptor already holds a packet.
+                    eth_desc_t* next = edev->rxd_ring + (edev->rxd_idx + 1) % ETH_BUF_COUNT;
+                    uint32_t flags = (next->status1 & RX_DESC_OWN) ? 0 : ETHMAC_RECV_MORE;
                     edev->ifc->recv(
-                        edev->cookie, edev->rxb + (edev->rxd_idx * ETH_BUF_SIZE), len, 0);
+                        edev->cookie, edev->rxb + (edev->rxd_idx * ETH_BUF_SIZE), len, flags);
                 } else {
                     zxlogf(ERROR, "rtl8111: No ethmac callback, dropping packet\n");
                 }
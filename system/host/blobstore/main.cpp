@@ -31,18 +31,19 @@ namespace {
 
 typedef struct {
     bool readonly = false;
+    bool compress = false;
     uint64_t data_blocks = blobstore::kStartBlockMinimum; // Account for reserved blocks
     fbl::Vector<fbl::String> blob_list;
 } blob_options_t;
 
-int do_blobstore_add_blob(blobstore::Blobstore* bs, const char* blob_name) {
+int do_blobstore_add_blob(blobstore::Blobstore* bs, const char* blob_name, bool compress) {
     fbl::unique_fd data_fd(open(blob_name, O_RDONLY, 0644));
     if (!data_fd) {
         fprintf(stderr, "error: cannot open '%s'\n", blob_name);
         return -1;
     }
     int r;
-    if ((r = blobstore::blobstore_add_blob(bs, data_fd.get())) != 0) {
+    if ((r = blobstore::blobstore_add_blob(bs, data_fd.get(), compress)) != 0) {
         if (r != ZX_ERR_ALREADY_EXISTS) {
             fprintf(stderr, "blobstore: Failed to add blob '%s': %d\n", blob_name, r);
             return -1;
@@ -81,7 +82,8 @@ int do_blobstore_add_blobs(fbl::unique_fd fd, const blob_options_t& options) {
                 if (i >= options.blob_list.size()) {
                     return;
                 }
-                if (do_blobstore_add_blob(bs.get(), options.blob_list[i].c_str()) < 0) {
+                if (do_blobstore_add_blob(bs.get(), options.blob_list[i].c_str(),
+                                          options.compress) < 0) {
                     mtx.lock();
                     res = -1;
                     mtx.unlock();
@@ -227,7 +229,10 @@ struct {
 
 int usage() {
     fprintf(stderr,
-            "usage: blobstore <file-or-device>[@<size>] <command> [ <arg>* ]\n"
+            "usage: blobstore [ <option>* ] <file-or-device>[@<size>] <command> [ <arg>* ]\n"
+            "\n"
+            "options:\n"
+            "\t--compress  store added blobs LZ4-compressed when it saves space\n"
             "\n");
     for (unsigned n = 0; n < (sizeof(CMDS) / sizeof(CMDS[0])); n++) {
         fprintf(stderr, "%9s %-10s %s\n", n ? "" : "commands:",
@@ -254,6 +259,8 @@ int process_args(int argc, char** argv, CommandFunction* func, blob_options_t* o
     while (argc > 1) {
         if (!strcmp(argv[0], "--readonly")) {
             options->readonly = true;
+        } else if (!strcmp(argv[0], "--compress")) {
+            options->compress = true;
         } else {
             break;
         }
@@ -13,11 +13,13 @@ MODULE_TYPE := hostapp
 MODULE_SRCS := \
     $(LOCAL_DIR)/main.cpp \
     system/ulib/bitmap/raw-bitmap.cpp \
+    system/ulib/fs/dentry-cache.cpp \
     system/ulib/fs/vfs.cpp \
     system/ulib/fs/vnode.cpp \
 
 MODULE_HOST_LIBS := \
     third_party/ulib/uboringssl.hostlib \
+    third_party/ulib/lz4.hostlib \
     system/ulib/blobstore.hostlib \
     system/ulib/digest.hostlib \
     system/ulib/fbl.hostlib \
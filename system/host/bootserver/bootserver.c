@@ -19,6 +19,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <pthread.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/time.h>
@@ -38,6 +39,9 @@
 #define ANSI_LINESTART "\33[2K\r"
 
 #define MAX_FVM_IMAGES 4
+// cmdline, ramdisk, kernel and each image
+#define MAX_XFER_JOBS (3 + MAX_FVM_IMAGES + 2)
+#define MAX_TFTP_SESSIONS 4
 
 #define ANSI(name) (use_color == false || is_redirected) ? "" : ANSI_##name
 
@@ -54,18 +58,22 @@ bool use_filename_prefix = true;
 
 static bool use_tftp = true;
 static bool use_color = true;
-static size_t total_file_size;
-static bool file_info_printed;
-static int progress_reported;
-static int packets_sent;
-static struct timeval start_time, end_time;
+// Status of the transfer running on this thread; see xfer_all().
+static __thread size_t total_file_size;
+static __thread bool file_info_printed;
+static __thread int progress_reported;
+static __thread int packets_sent;
+static __thread struct timeval start_time, end_time;
 static bool is_redirected;
+// Several transfers are in progress, so progress is only reported when each completes.
+static bool is_parallel;
 static const char spinner[] = {'|', '/', '-', '\\'};
 
 char* date_string() {
-    static char date_buf[80];
+    static __thread char date_buf[80];
     time_t t = time(NULL);
-    struct tm tm = *localtime(&t);
+    struct tm tm;
+    localtime_r(&t, &tm);
 
     snprintf(date_buf, sizeof(date_buf), "%4d-%02d-%02d %02d:%02d:%02d",
              tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
@@ -119,7 +127,18 @@ void update_status(size_t bytes_so_far) {
         return;
     }
 
-    if (is_redirected) {
+    if (is_parallel) {
+        if (is_last_piece && progress_reported < 100) {
+            struct timeval now;
+            gettimeofday(&now, NULL);
+            int64_t elapsed_usec = (int64_t)(now.tv_sec - start_time.tv_sec) * 1000000 +
+                                   (int64_t)(now.tv_usec - start_time.tv_usec);
+            log("Transfer ends     [%5.1f MB/s] %zu bytes in %" PRId64 ".%06" PRId64 " sec",
+                (float)total_file_size * 1000000 / (1024.0 * 1024.0 * (float)elapsed_usec),
+                total_file_size, elapsed_usec / 1000000, elapsed_usec % 1000000);
+            progress_reported = 100;
+        }
+    } else if (is_redirected) {
         int percent_sent = (bytes_so_far * 100 / (total_file_size));
         if (percent_sent - progress_reported >= 5) {
             fprintf(stderr, "\t%d%%...", percent_sent);
@@ -156,13 +175,17 @@ void update_status(size_t bytes_so_far) {
 
 static int xfer(struct sockaddr_in6* addr, const char* local_name, const char* remote_name) {
     int result;
-    is_redirected = !isatty(fileno(stdout));
     gettimeofday(&start_time, NULL);
     file_info_printed = false;
     if (use_tftp) {
         bool first = true;
         while ((result = tftp_xfer(addr, local_name, remote_name)) == -EAGAIN) {
-            if (first) {
+            if (is_parallel) {
+                if (first) {
+                    log("Target busy, waiting to send %s", local_name);
+                    first = false;
+                }
+            } else if (first) {
                 fprintf(stderr, "Target busy, waiting.");
                 first = false;
             } else {
@@ -179,10 +202,117 @@ static int xfer(struct sockaddr_in6* addr, const char* local_name, const char* r
         end_time.tv_sec -= 1;
         end_time.tv_usec += 1000000;
     }
-    fprintf(stderr, "\n");
+    if (!is_parallel) {
+        fprintf(stderr, "\n");
+    }
     return result;
 }
 
+// A file to send, followed by any which have to wait for it.
+typedef struct xfer_job {
+    const char* local_name;
+    const char* remote_name;
+    struct xfer_job* next;
+} xfer_job_t;
+
+// Everything to send to a target. The target can receive the netboot files
+// while it paves, but it only paves one image at a time, so the images are all
+// chained behind the first one.
+typedef struct {
+    xfer_job_t storage[MAX_XFER_JOBS];
+    size_t num_storage;
+    xfer_job_t* jobs[MAX_XFER_JOBS];
+    size_t num_jobs;
+    xfer_job_t* images;
+    xfer_job_t** images_tail;
+} xfer_plan_t;
+
+static void add_xfer_job(xfer_plan_t* plan, const char* local_name, const char* remote_name,
+                         bool is_image) {
+    xfer_job_t* job = &plan->storage[plan->num_storage++];
+    job->local_name = local_name;
+    job->remote_name = remote_name;
+    job->next = NULL;
+    if (!is_image || plan->images == NULL) {
+        plan->jobs[plan->num_jobs++] = job;
+    }
+    if (is_image) {
+        *plan->images_tail = job;
+        plan->images_tail = &job->next;
+    }
+}
+
+typedef struct {
+    struct sockaddr_in6* addr;
+    xfer_job_t** jobs;
+    size_t num_jobs;
+    size_t next_job;
+    bool failed;
+    pthread_mutex_t lock;
+} xfer_queue_t;
+
+static void* xfer_worker(void* arg) {
+    xfer_queue_t* queue = arg;
+    for (;;) {
+        pthread_mutex_lock(&queue->lock);
+        xfer_job_t* job = NULL;
+        if (!queue->failed && queue->next_job < queue->num_jobs) {
+            job = queue->jobs[queue->next_job++];
+        }
+        pthread_mutex_unlock(&queue->lock);
+        if (job == NULL) {
+            return NULL;
+        }
+        for (; job != NULL; job = job->next) {
+            if (xfer(queue->addr, job->local_name, job->remote_name) != 0) {
+                pthread_mutex_lock(&queue->lock);
+                queue->failed = true;
+                pthread_mutex_unlock(&queue->lock);
+                return NULL;
+            }
+        }
+    }
+}
+
+// Sends the jobs on up to |max_sessions| connections at once, or one after the
+// other if the target can only take one at a time. Stops starting new jobs
+// after the first failure.
+static int xfer_all(struct sockaddr_in6* addr, xfer_job_t** jobs, size_t num_jobs,
+                    int max_sessions) {
+    xfer_queue_t queue = {
+        .addr = addr,
+        .jobs = jobs,
+        .num_jobs = num_jobs,
+        .next_job = 0,
+        .failed = false,
+    };
+    pthread_mutex_init(&queue.lock, NULL);
+    is_redirected = !isatty(fileno(stdout));
+
+    pthread_t threads[MAX_TFTP_SESSIONS];
+    size_t num_threads = 0;
+    if (max_sessions > 1 && num_jobs > 1) {
+        is_parallel = true;
+        while (num_threads < num_jobs && num_threads < (size_t)max_sessions &&
+               num_threads < MAX_TFTP_SESSIONS) {
+            if (pthread_create(&threads[num_threads], NULL, xfer_worker, &queue) != 0) {
+                break;
+            }
+            num_threads++;
+        }
+    }
+    if (num_threads == 0) {
+        is_parallel = false;
+        xfer_worker(&queue);
+    }
+    for (size_t i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    is_parallel = false;
+    pthread_mutex_destroy(&queue.lock);
+    return queue.failed ? -1 : 0;
+}
+
 void usage(void) {
     fprintf(stderr,
             "usage:   %s [ <option> ]* [<kernel>] [ <ramdisk> ] [ -- [ <kerneloption> ]* ]\n"
@@ -492,6 +622,7 @@ int main(int argc, char** argv) {
         char* save = NULL;
         char* adv_nodename = NULL;
         char* adv_version = "unknown";
+        int adv_sessions = 1;
         for (char* var = strtok_r((char*)msg->data, ";", &save);
              var;
              var = strtok_r(NULL, ";", &save)) {
@@ -499,6 +630,8 @@ int main(int argc, char** argv) {
                 adv_nodename = var + 9;
             } else if (!strncmp(var, "version=", 8)) {
                 adv_version = var + 8;
+            } else if (!strncmp(var, "tftp_sessions=", 14)) {
+                adv_sessions = atoi(var + 14);
             }
         }
 
@@ -523,41 +656,38 @@ int main(int argc, char** argv) {
             use_filename_prefix = true;
         }
 
+        xfer_plan_t plan = {.images_tail = &plan.images};
         if (cmdline[0]) {
-            status = xfer(&ra, "(cmdline)", cmdline);
-        } else {
-            status = 0;
+            add_xfer_job(&plan, "(cmdline)", cmdline, false);
         }
-        if (status == 0) {
-            struct stat s;
-            if (ramdisk_fn) {
-                status = xfer(&ra, ramdisk_fn,
-                              use_filename_prefix ? NB_RAMDISK_FILENAME : "ramdisk.bin");
-            } else if (auto_ramdisk_fn && (stat(auto_ramdisk_fn, &s) == 0)) {
-                status = xfer(&ra, auto_ramdisk_fn,
-                              use_filename_prefix ? NB_RAMDISK_FILENAME : "ramdisk.bin");
-            }
+        struct stat st;
+        if (ramdisk_fn) {
+            add_xfer_job(&plan, ramdisk_fn,
+                         use_filename_prefix ? NB_RAMDISK_FILENAME : "ramdisk.bin", false);
+        } else if (auto_ramdisk_fn && (stat(auto_ramdisk_fn, &st) == 0)) {
+            add_xfer_job(&plan, auto_ramdisk_fn,
+                         use_filename_prefix ? NB_RAMDISK_FILENAME : "ramdisk.bin", false);
         }
-        for(size_t i = 0; i < num_fvms; i++) {
-          if (status == 0 && fvm_images[i]) {
-              status = xfer(&ra, fvm_images[i], use_filename_prefix ? NB_FVM_FILENAME
-                            : NB_FVM_HOST_FILENAME);
-          }
+        for (size_t i = 0; i < num_fvms; i++) {
+            if (fvm_images[i]) {
+                add_xfer_job(&plan, fvm_images[i], use_filename_prefix ? NB_FVM_FILENAME
+                             : NB_FVM_HOST_FILENAME, true);
+            }
         }
-        if (status == 0 && efi_image) {
-            status = xfer(&ra, efi_image, use_filename_prefix ? NB_EFI_FILENAME
-                          : NB_EFI_HOST_FILENAME);
+        if (efi_image) {
+            add_xfer_job(&plan, efi_image, use_filename_prefix ? NB_EFI_FILENAME
+                         : NB_EFI_HOST_FILENAME, true);
         }
-        if (status == 0 && kernc_image) {
-            status = xfer(&ra, kernc_image, use_filename_prefix ? NB_KERNC_FILENAME
-                          : NB_KERNC_HOST_FILENAME);
+        if (kernc_image) {
+            add_xfer_job(&plan, kernc_image, use_filename_prefix ? NB_KERNC_FILENAME
+                         : NB_KERNC_HOST_FILENAME, true);
         }
+        add_xfer_job(&plan, kernel_fn, use_filename_prefix ? NB_KERNEL_FILENAME : "kernel.bin",
+                     false);
 
+        status = xfer_all(&ra, plan.jobs, plan.num_jobs, use_tftp ? adv_sessions : 1);
         if (status == 0) {
-            status = xfer(&ra, kernel_fn, use_filename_prefix ? NB_KERNEL_FILENAME : "kernel.bin");
-            if (status == 0) {
-                send_boot_command(&ra);
-            }
+            send_boot_command(&ra);
         }
         if (once) {
             return status == 0 ? 0 : -1;
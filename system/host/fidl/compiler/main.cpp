@@ -24,9 +24,11 @@ namespace {
 
 [[noreturn]] void Usage() {
     std::cout << "fidl usage:\n";
-    std::cout << "    fidl c-structs HEADER_PATH [FIDL_FILE...]\n";
+    std::cout << "    fidl c-structs [--specialize-coding] HEADER_PATH [FIDL_FILE...]\n";
     std::cout << "        Parses the FIDL_FILEs and generates C structures\n";
-    std::cout << "        into HEADER_PATH.\n";
+    std::cout << "        into HEADER_PATH. With --specialize-coding, each message\n";
+    std::cout << "        also gets inline encode and decode functions specialized\n";
+    std::cout << "        to its layout.\n";
     std::cout << "\n";
     std::cout << "    fidl json JSON_PATH [FIDL_FILE...]\n";
     std::cout << "        Parses the FIDL_FILEs and generates JSON intermediate data\n";
@@ -74,6 +76,13 @@ public:
 
     bool Remaining() const override { return count_ > 0; }
 
+    bool HeadIs(fidl::StringView argument) {
+        if (count_ < 1) {
+            return false;
+        }
+        return argument == fidl::StringView(arguments_[0]);
+    }
+
     bool HeadIsResponseFile() {
         if (count_ != 1) {
             return false;
@@ -165,9 +174,9 @@ bool Parse(Arguments* args, fidl::SourceManager* source_manager,
     return true;
 }
 
-bool GenerateC(fidl::Library* library, std::fstream header_output) {
+bool GenerateC(fidl::Library* library, bool specialize_coding, std::fstream header_output) {
     std::ostringstream header_file;
-    fidl::CGenerator c_generator(library);
+    fidl::CGenerator c_generator(library, specialize_coding);
 
     c_generator.ProduceCStructs(&header_file);
 
@@ -200,9 +209,14 @@ int main(int argc, char* argv[]) {
 
     std::string behavior_argument = argv_args->Claim();
     Behavior behavior;
+    bool specialize_coding = false;
     std::fstream output_file;
     if (behavior_argument == "c-structs") {
         behavior = Behavior::CStructs;
+        if (argv_args->HeadIs("--specialize-coding")) {
+            argv_args->Claim();
+            specialize_coding = true;
+        }
         // Parse a file name to write output to.
         if (argc < 2) {
             return 1;
@@ -241,7 +255,7 @@ int main(int argc, char* argv[]) {
 
     switch (behavior) {
     case Behavior::CStructs: {
-        if (!GenerateC(&library, std::move(output_file))) {
+        if (!GenerateC(&library, specialize_coding, std::move(output_file))) {
             return 1;
         }
         break;
@@ -27,7 +27,11 @@ namespace fidl {
 
 class CGenerator {
 public:
-    explicit CGenerator(Library* library) : library_(library) {}
+    // When |specialize_coding| is set, each message also gets inline
+    // encode and decode functions specialized to its layout. See
+    // ProduceMessageCoding.
+    explicit CGenerator(Library* library, bool specialize_coding = false)
+        : library_(library), specialize_coding_(specialize_coding) {}
 
     ~CGenerator() = default;
 
@@ -79,6 +83,15 @@ public:
         const flat::Union& union_info;
     };
 
+    // A handle stored inline in a message. |path| is the C expression
+    // naming it relative to the message, with the array indices i0,
+    // i1, ... bound by loops over |array_counts|.
+    struct HandleField {
+        std::string path;
+        std::vector<uint32_t> array_counts;
+        bool nullable;
+    };
+
     void GeneratePrologues();
     void GenerateEpilogues();
 
@@ -89,6 +102,10 @@ public:
     void GenerateStructDeclaration(StringView name, const std::vector<Member>& members);
     void GenerateTaggedUnionDeclaration(StringView name, const std::vector<Member>& members);
 
+    void GenerateFixedCoding(StringView c_name);
+    void GenerateInlineHandleCoding(StringView c_name, const std::vector<HandleField>& handles);
+    void GenerateTableCoding(StringView c_name, StringView coded_name);
+
     void MaybeProduceCodingField(std::string field_name, uint32_t offset, const ast::Type* type,
                                  std::vector<coded::Field>* fields);
 
@@ -98,6 +115,12 @@ public:
     std::vector<NamedStruct> NameStructs(const std::vector<flat::Struct>& struct_infos);
     std::vector<NamedUnion> NameUnions(const std::vector<flat::Union>& union_infos);
 
+    const flat::Struct* LookupStruct(const ast::IdentifierType* identifier_type);
+    const flat::Enum* LookupEnum(const ast::IdentifierType* identifier_type);
+    bool CollectInlineHandles(const ast::Type* type, std::string path,
+                              std::vector<uint32_t> array_counts, uint32_t depth,
+                              std::vector<HandleField>* handles);
+
     void ProduceConstForwardDeclaration(const NamedConst& named_const);
     void ProduceEnumForwardDeclaration(const NamedEnum& named_enum);
     void ProduceMessageForwardDeclaration(const NamedMessage& named_message);
@@ -111,7 +134,10 @@ public:
     void ProduceStructDeclaration(const NamedStruct& named_struct);
     void ProduceUnionDeclaration(const NamedUnion& named_union);
 
+    void ProduceMessageCoding(const NamedMessage& named_message);
+
     Library* library_;
+    bool specialize_coding_;
     std::ostringstream header_file_;
 };
 
@@ -174,6 +174,12 @@ void EmitBlank(std::ostream* file) {
     *file << "\n";
 }
 
+void EmitIndent(std::ostream* file, size_t depth) {
+    for (size_t i = 0; i < depth; ++i) {
+        *file << kIndent;
+    }
+}
+
 // Various computational helper routines.
 
 CGenerator::IntegerConstantType EnumType(ast::PrimitiveType::Subtype type) {
@@ -326,6 +332,18 @@ CGenerator::Member CreateMember(Library* library, const ast::Type* type, StringV
     return CGenerator::Member{type_name, name, std::move(array_counts)};
 }
 
+std::string ArrayIndexName(size_t depth) {
+    return "i" + std::to_string(depth);
+}
+
+std::string EncoderName(StringView c_name) {
+    return std::string(c_name) + "_encode";
+}
+
+std::string DecoderName(StringView c_name) {
+    return std::string(c_name) + "_decode";
+}
+
 std::vector<CGenerator::Member>
 GenerateMembers(Library* library, const std::vector<flat::Union::Member>& union_members) {
     std::vector<CGenerator::Member> members;
@@ -344,6 +362,9 @@ void CGenerator::GeneratePrologues() {
     EmitHeaderGuard(&header_file_);
     EmitBlank(&header_file_);
     EmitIncludeHeader(&header_file_, "<stdbool.h>");
+    if (specialize_coding_) {
+        EmitIncludeHeader(&header_file_, "<stddef.h>");
+    }
     EmitIncludeHeader(&header_file_, "<stdint.h>");
     EmitIncludeHeader(&header_file_, "<fidl/coding.h>");
     EmitIncludeHeader(&header_file_, "<zircon/fidl.h>");
@@ -401,6 +422,186 @@ void CGenerator::GenerateTaggedUnionDeclaration(StringView name,
     header_file_ << "};\n";
 }
 
+// The specialized coders take the same arguments as fidl_encode and
+// fidl_decode, minus the coding table, and fail in the same cases.
+
+void CGenerator::GenerateFixedCoding(StringView c_name) {
+    header_file_ << "static inline zx_status_t " << EncoderName(c_name)
+                 << "(void* bytes, uint32_t num_bytes, zx_handle_t* handles, uint32_t max_handles, "
+                    "uint32_t* actual_handles_out, const char** error_msg_out) {\n";
+    header_file_ << kIndent << "if (bytes == NULL || num_bytes != sizeof(" << c_name << ")) {\n";
+    header_file_ << kIndent << kIndent << "if (error_msg_out != NULL) {\n";
+    header_file_ << kIndent << kIndent << kIndent
+                 << "*error_msg_out = \"message does not match the size of " << c_name << "\";\n";
+    header_file_ << kIndent << kIndent << "}\n";
+    header_file_ << kIndent << kIndent << "return ZX_ERR_INVALID_ARGS;\n";
+    header_file_ << kIndent << "}\n";
+    header_file_ << kIndent << "*actual_handles_out = 0u;\n";
+    header_file_ << kIndent << "return ZX_OK;\n";
+    header_file_ << "}\n";
+    EmitBlank(&header_file_);
+
+    header_file_ << "static inline zx_status_t " << DecoderName(c_name)
+                 << "(void* bytes, uint32_t num_bytes, const zx_handle_t* handles, "
+                    "uint32_t num_handles, const char** error_msg_out) {\n";
+    header_file_ << kIndent << "if (bytes == NULL || num_bytes != sizeof(" << c_name
+                 << ") || num_handles != 0u) {\n";
+    header_file_ << kIndent << kIndent << "if (error_msg_out != NULL) {\n";
+    header_file_ << kIndent << kIndent << kIndent
+                 << "*error_msg_out = \"message does not match the layout of " << c_name
+                 << "\";\n";
+    header_file_ << kIndent << kIndent << "}\n";
+    header_file_ << kIndent << kIndent << "return ZX_ERR_INVALID_ARGS;\n";
+    header_file_ << kIndent << "}\n";
+    header_file_ << kIndent << "return ZX_OK;\n";
+    header_file_ << "}\n";
+}
+
+void CGenerator::GenerateInlineHandleCoding(StringView c_name,
+                                            const std::vector<HandleField>& handles) {
+    auto generate_prologue = [this, c_name](StringView handle_count) {
+        header_file_ << kIndent << c_name << "* msg = (" << c_name << "*)bytes;\n";
+        header_file_ << kIndent << "uint32_t handle_idx = 0u;\n";
+        header_file_ << kIndent << "const char* error_msg;\n";
+        header_file_ << kIndent << "if (msg == NULL || num_bytes != sizeof(*msg)) {\n";
+        header_file_ << kIndent << kIndent
+                     << "error_msg = \"message does not match the size of " << c_name << "\";\n";
+        header_file_ << kIndent << kIndent << "goto fail;\n";
+        header_file_ << kIndent << "}\n";
+        header_file_ << kIndent << "if (handles == NULL && " << handle_count << " != 0u) {\n";
+        header_file_ << kIndent << kIndent
+                     << "error_msg = \"Cannot provide non-zero handle count and null handle "
+                        "pointer\";\n";
+        header_file_ << kIndent << kIndent << "goto fail;\n";
+        header_file_ << kIndent << "}\n";
+    };
+    auto generate_fail = [this](size_t depth, StringView error_msg) {
+        EmitIndent(&header_file_, depth);
+        header_file_ << "error_msg = \"" << error_msg << "\";\n";
+        EmitIndent(&header_file_, depth);
+        header_file_ << "goto fail;\n";
+    };
+    auto generate_epilogue = [this]() {
+        header_file_ << "fail:\n";
+        header_file_ << kIndent << "if (error_msg_out != NULL) {\n";
+        header_file_ << kIndent << kIndent << "*error_msg_out = error_msg;\n";
+        header_file_ << kIndent << "}\n";
+        header_file_ << kIndent << "return ZX_ERR_INVALID_ARGS;\n";
+        header_file_ << "}\n";
+    };
+    // Opens one loop per array dimension around the handle, and
+    // returns the indentation depth of the loop body.
+    auto generate_loops = [this](const HandleField& handle) {
+        size_t depth = 1;
+        for (size_t i = 0; i < handle.array_counts.size(); ++i) {
+            std::string index = ArrayIndexName(i);
+            EmitIndent(&header_file_, depth++);
+            header_file_ << "for (uint32_t " << index << " = 0u; " << index << " < "
+                         << handle.array_counts[i] << "u; ++" << index << ") {\n";
+        }
+        return depth;
+    };
+    auto close_loops = [this](size_t depth) {
+        while (depth-- > 1) {
+            EmitIndent(&header_file_, depth);
+            header_file_ << "}\n";
+        }
+    };
+
+    header_file_ << "static inline zx_status_t " << EncoderName(c_name)
+                 << "(void* bytes, uint32_t num_bytes, zx_handle_t* handles, uint32_t max_handles, "
+                    "uint32_t* actual_handles_out, const char** error_msg_out) {\n";
+    generate_prologue("max_handles");
+    for (const auto& handle : handles) {
+        std::string field = "msg->" + handle.path;
+        size_t depth = generate_loops(handle);
+        // Absent nullable handles are already encoded, since
+        // ZX_HANDLE_INVALID and FIDL_HANDLE_ABSENT are both zero.
+        if (handle.nullable) {
+            EmitIndent(&header_file_, depth++);
+            header_file_ << "if (" << field << " != ZX_HANDLE_INVALID) {\n";
+        }
+        EmitIndent(&header_file_, depth);
+        header_file_ << "if (handle_idx == max_handles) {\n";
+        generate_fail(depth + 1, "message encoded too many handles");
+        EmitIndent(&header_file_, depth);
+        header_file_ << "}\n";
+        EmitIndent(&header_file_, depth);
+        header_file_ << "handles[handle_idx++] = " << field << ";\n";
+        EmitIndent(&header_file_, depth);
+        header_file_ << field << " = FIDL_HANDLE_PRESENT;\n";
+        close_loops(depth);
+    }
+    header_file_ << kIndent << "*actual_handles_out = handle_idx;\n";
+    header_file_ << kIndent << "return ZX_OK;\n";
+    generate_epilogue();
+    EmitBlank(&header_file_);
+
+    header_file_ << "static inline zx_status_t " << DecoderName(c_name)
+                 << "(void* bytes, uint32_t num_bytes, const zx_handle_t* handles, "
+                    "uint32_t num_handles, const char** error_msg_out) {\n";
+    generate_prologue("num_handles");
+    for (const auto& handle : handles) {
+        std::string field = "msg->" + handle.path;
+        size_t depth = generate_loops(handle);
+        if (handle.nullable) {
+            // Absent nullable handles decode to ZX_HANDLE_INVALID
+            // as they are.
+            EmitIndent(&header_file_, depth);
+            header_file_ << "if (" << field << " == FIDL_HANDLE_PRESENT) {\n";
+            EmitIndent(&header_file_, depth + 1);
+            header_file_ << "if (handle_idx == num_handles) {\n";
+            generate_fail(depth + 2, "message decoded too many handles");
+            EmitIndent(&header_file_, depth + 1);
+            header_file_ << "}\n";
+            EmitIndent(&header_file_, depth + 1);
+            header_file_ << field << " = handles[handle_idx++];\n";
+            EmitIndent(&header_file_, depth);
+            header_file_ << "} else if (" << field << " != FIDL_HANDLE_ABSENT) {\n";
+            generate_fail(depth + 1, "message tried to decode a non-present handle");
+            EmitIndent(&header_file_, depth);
+            header_file_ << "}\n";
+        } else {
+            EmitIndent(&header_file_, depth);
+            header_file_ << "if (" << field << " != FIDL_HANDLE_PRESENT) {\n";
+            generate_fail(depth + 1, "message tried to decode a non-present handle");
+            EmitIndent(&header_file_, depth);
+            header_file_ << "}\n";
+            EmitIndent(&header_file_, depth);
+            header_file_ << "if (handle_idx == num_handles) {\n";
+            generate_fail(depth + 1, "message decoded too many handles");
+            EmitIndent(&header_file_, depth);
+            header_file_ << "}\n";
+            EmitIndent(&header_file_, depth);
+            header_file_ << field << " = handles[handle_idx++];\n";
+        }
+        close_loops(depth);
+    }
+    header_file_ << kIndent << "if (handle_idx != num_handles) {\n";
+    generate_fail(2, "message did not contain the specified number of handles");
+    header_file_ << kIndent << "}\n";
+    header_file_ << kIndent << "return ZX_OK;\n";
+    generate_epilogue();
+}
+
+void CGenerator::GenerateTableCoding(StringView c_name, StringView coded_name) {
+    header_file_ << "static inline zx_status_t " << EncoderName(c_name)
+                 << "(void* bytes, uint32_t num_bytes, zx_handle_t* handles, uint32_t max_handles, "
+                    "uint32_t* actual_handles_out, const char** error_msg_out) {\n";
+    header_file_ << kIndent << "return fidl_encode(&" << coded_name
+                 << ", bytes, num_bytes, handles, max_handles, actual_handles_out, "
+                    "error_msg_out);\n";
+    header_file_ << "}\n";
+    EmitBlank(&header_file_);
+
+    header_file_ << "static inline zx_status_t " << DecoderName(c_name)
+                 << "(void* bytes, uint32_t num_bytes, const zx_handle_t* handles, "
+                    "uint32_t num_handles, const char** error_msg_out) {\n";
+    header_file_ << kIndent << "return fidl_decode(&" << coded_name
+                 << ", bytes, num_bytes, handles, num_handles, error_msg_out);\n";
+    header_file_ << "}\n";
+}
+
 // TODO(TO-702) These should maybe check for global name
 // collisions? Otherwise, is there some other way they should fail?
 std::vector<CGenerator::NamedConst> CGenerator::NameConsts(const std::vector<flat::Const>& const_infos) {
@@ -465,6 +666,101 @@ std::vector<CGenerator::NamedUnion> CGenerator::NameUnions(const std::vector<fla
     return named_unions;
 }
 
+namespace {
+
+// Identifier types only name declarations in this library.
+template <typename Declaration>
+const Declaration* LookupDeclaration(const std::vector<Declaration>& declarations,
+                                     const ast::IdentifierType* identifier_type) {
+    const auto& components = identifier_type->identifier->components;
+    if (components.size() != 1) {
+        return nullptr;
+    }
+    std::string name = components[0]->location.data();
+    for (const auto& declaration : declarations) {
+        if (LongName(declaration.name) == name) {
+            return &declaration;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace
+
+const flat::Struct* CGenerator::LookupStruct(const ast::IdentifierType* identifier_type) {
+    return LookupDeclaration(library_->struct_declarations_, identifier_type);
+}
+
+const flat::Enum* CGenerator::LookupEnum(const ast::IdentifierType* identifier_type) {
+    return LookupDeclaration(library_->enum_declarations_, identifier_type);
+}
+
+// Appends the handles stored in |type|, found at |path| within the
+// message, to |handles|. Returns false if |type| has anything only
+// the coding tables can deal with: out-of-line data, unions, or
+// names this generator cannot resolve.
+bool CGenerator::CollectInlineHandles(const ast::Type* type, std::string path,
+                                      std::vector<uint32_t> array_counts, uint32_t depth,
+                                      std::vector<HandleField>* handles) {
+    // Mirror the table-driven coders' limit.
+    if (depth > 32u) {
+        return false;
+    }
+    switch (type->kind) {
+    case ast::Type::Kind::Primitive:
+        return true;
+
+    case ast::Type::Kind::Handle: {
+        auto handle_type = static_cast<const ast::HandleType*>(type);
+        bool nullable = handle_type->nullability == ast::Nullability::Nullable;
+        handles->push_back({std::move(path), std::move(array_counts), nullable});
+        return true;
+    }
+    case ast::Type::Kind::Request: {
+        auto request_type = static_cast<const ast::RequestType*>(type);
+        bool nullable = request_type->nullability == ast::Nullability::Nullable;
+        handles->push_back({std::move(path), std::move(array_counts), nullable});
+        return true;
+    }
+
+    case ast::Type::Kind::Array: {
+        auto array_type = static_cast<const ast::ArrayType*>(type);
+        std::vector<uint32_t> counts = ArrayCounts(library_, type);
+        path += "[" + ArrayIndexName(array_counts.size()) + "]";
+        array_counts.push_back(counts[0]);
+        return CollectInlineHandles(array_type->element_type.get(), std::move(path),
+                                    std::move(array_counts), depth + 1, handles);
+    }
+
+    case ast::Type::Kind::Vector:
+    case ast::Type::Kind::String:
+        return false;
+
+    case ast::Type::Kind::Identifier: {
+        auto identifier_type = static_cast<const ast::IdentifierType*>(type);
+        if (identifier_type->nullability == ast::Nullability::Nullable) {
+            return false;
+        }
+        if (LookupEnum(identifier_type) != nullptr) {
+            return true;
+        }
+        const flat::Struct* struct_info = LookupStruct(identifier_type);
+        if (struct_info == nullptr) {
+            return false;
+        }
+        for (const auto& member : struct_info->members) {
+            if (!CollectInlineHandles(member.type.get(), path + "." + ShortName(member.name),
+                                      array_counts, depth + 1, handles)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    }
+    // Unknown kinds are left to the coding tables.
+    return false;
+}
+
 void CGenerator::ProduceConstForwardDeclaration(const NamedConst& named_const) {
     // TODO(TO-702)
 }
@@ -552,6 +848,33 @@ void CGenerator::ProduceUnionDeclaration(const NamedUnion& named_union) {
     EmitBlank(&header_file_);
 }
 
+// Messages with no out-of-line data are coded in place without
+// looking at their coding tables: a message which also has no handles
+// only needs its size checked, and the rest walk their handles in
+// straight-line code. Everything else calls through to the table-driven
+// fidl_encode and fidl_decode.
+void CGenerator::ProduceMessageCoding(const NamedMessage& named_message) {
+    std::vector<HandleField> handles;
+    bool inline_only = true;
+    for (const auto& parameter : named_message.parameters) {
+        if (!CollectInlineHandles(parameter.type.get(), ShortName(parameter.name), {}, 1u,
+                                  &handles)) {
+            inline_only = false;
+            break;
+        }
+    }
+
+    if (!inline_only) {
+        GenerateTableCoding(named_message.c_name, named_message.coded_name);
+    } else if (handles.empty()) {
+        GenerateFixedCoding(named_message.c_name);
+    } else {
+        GenerateInlineHandleCoding(named_message.c_name, handles);
+    }
+
+    EmitBlank(&header_file_);
+}
+
 void CGenerator::ProduceCStructs(std::ostringstream* header_file_out) {
 
     GeneratePrologues();
@@ -590,16 +913,24 @@ void CGenerator::ProduceCStructs(std::ostringstream* header_file_out) {
         ProduceConstDeclaration(named_const);
     }
     // Enums can be entirely forward declared, as they have no
-    // dependencies other than standard headers.
-    for (const auto& message : named_messages) {
-        ProduceMessageDeclaration(message);
-    }
+    // dependencies other than standard headers. Messages may embed
+    // structs and unions, so they are declared last.
     for (const auto& named_struct : named_structs) {
         ProduceStructDeclaration(named_struct);
     }
     for (const auto& named_union : named_unions) {
         ProduceUnionDeclaration(named_union);
     }
+    for (const auto& message : named_messages) {
+        ProduceMessageDeclaration(message);
+    }
+
+    if (specialize_coding_) {
+        header_file_ << "\n// Coding functions\n\n";
+        for (const auto& named_message : named_messages) {
+            ProduceMessageCoding(named_message);
+        }
+    }
 
     GenerateEpilogues();
 
@@ -3,6 +3,12 @@
 // found in the LICENSE file.
 
 #include <inttypes.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <fbl/algorithm.h>
+#include <lz4/lz4.h>
+#include <lz4/lz4hc.h>
 
 #include "fvm/container.h"
 
@@ -14,6 +20,71 @@ static LZ4F_preferences_t lz4_prefs = {
     .compressionLevel = 0,
 };
 
+namespace {
+
+// Frames are written in blockIndependent mode, so each block of input compresses on its own
+// exactly as LZ4F_compressUpdate would compress it. Data is gathered into batches of whole blocks
+// which are compressed by several threads and then appended in order, producing the same frame
+// as a single LZ4F context would.
+constexpr size_t kLz4BlockSize = 64 * 1024;
+constexpr size_t kLz4BlocksPerThread = 16;
+// Size of a compressed block, including its header, when it does not compress.
+constexpr size_t kLz4MaxBlockSize = kLz4BlockSize + 4;
+// lz4frame.c switches to LZ4HC at this level.
+constexpr int kLz4MinHcLevel = 3;
+
+// Compresses one block of |len| bytes as LZ4F_compressBlock does: a little-endian size followed
+// by the compressed data, or by the data itself, flagged in the size, if it does not shrink.
+size_t CompressBlock(void* state, const uint8_t* src, size_t len, uint8_t* dst) {
+    int level = lz4_prefs.compressionLevel;
+    int r;
+    if (level < kLz4MinHcLevel) {
+        r = LZ4_compress_limitedOutput_withState(state, reinterpret_cast<const char*>(src),
+                                                 reinterpret_cast<char*>(dst + 4),
+                                                 static_cast<int>(len),
+                                                 static_cast<int>(len - 1));
+    } else {
+        r = LZ4_compress_HC_extStateHC(state, reinterpret_cast<const char*>(src),
+                                       reinterpret_cast<char*>(dst + 4), static_cast<int>(len),
+                                       static_cast<int>(len - 1), level);
+    }
+    uint32_t size = static_cast<uint32_t>(r);
+    if (r <= 0) {
+        memcpy(dst + 4, src, len);
+        size = static_cast<uint32_t>(len) | 0x80000000u;
+        r = static_cast<int>(len);
+    }
+    dst[0] = static_cast<uint8_t>(size);
+    dst[1] = static_cast<uint8_t>(size >> 8);
+    dst[2] = static_cast<uint8_t>(size >> 16);
+    dst[3] = static_cast<uint8_t>(size >> 24);
+    return r + 4;
+}
+
+// A contiguous range of the blocks in |in| to be compressed by one thread.
+struct CompressTask {
+    const uint8_t* in;
+    size_t in_size;
+    size_t first;
+    size_t last;
+    void* state;
+    uint8_t* blocks;
+    size_t* block_sizes;
+};
+
+void* CompressThread(void* arg) {
+    CompressTask* task = static_cast<CompressTask*>(arg);
+    for (size_t i = task->first; i < task->last; i++) {
+        size_t off = i * kLz4BlockSize;
+        size_t len = fbl::min(task->in_size - off, kLz4BlockSize);
+        task->block_sizes[i] = CompressBlock(task->state, task->in + off, len,
+                                             task->blocks + i * kLz4MaxBlockSize);
+    }
+    return nullptr;
+}
+
+} // namespace
+
 zx_status_t SparseContainer::Create(const char* path, size_t slice_size, compress_type_t compress,
                                     fbl::unique_ptr<SparseContainer>* out) {
     fbl::AllocChecker ac;
@@ -34,6 +105,8 @@ zx_status_t SparseContainer::Create(const char* path, size_t slice_size, compres
 
 SparseContainer::SparseContainer(const char* path, uint64_t slice_size, compress_type_t compress)
     : Container(slice_size), valid_(false), compress_(compress), disk_size_(0), extent_size_(0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    compress_threads_ = cpus > 0 ? static_cast<unsigned>(cpus) : 1;
     fd_.reset(open(path, O_CREAT | O_RDWR, 0666));
 
     if (!fd_) {
@@ -258,6 +331,10 @@ zx_status_t SparseContainer::Commit() {
     return ZX_OK;
 }
 
+void SparseContainer::SetCompressionThreads(unsigned threads) {
+    compress_threads_ = fbl::max(threads, 1u);
+}
+
 size_t SparseContainer::SliceSize() const {
     return image_.slice_size;
 }
@@ -370,18 +447,106 @@ zx_status_t SparseContainer::SetupCompression(compression_t* comp, size_t max_le
     }
 
     comp->offset += r;
+
+    // The context has written the frame header. It will also write the end mark, but the blocks
+    // in between are compressed by FlushCompression.
+    size_t blocks = compress_threads_ * kLz4BlocksPerThread;
+    size_t state_size = lz4_prefs.compressionLevel < kLz4MinHcLevel ? LZ4_sizeofState()
+                                                                     : LZ4_sizeofStateHC();
+    fbl::AllocChecker ac;
+    comp->in_max = blocks * kLz4BlockSize;
+    comp->in_size = 0;
+    comp->in.reset(new (&ac) uint8_t[comp->in_max]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    comp->blocks.reset(new (&ac) uint8_t[blocks * kLz4MaxBlockSize]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    comp->block_sizes.reset(new (&ac) size_t[blocks]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    comp->states.reset();
+    for (unsigned i = 0; i < compress_threads_; i++) {
+        fbl::unique_ptr<uint8_t[]> state(new (&ac) uint8_t[state_size]);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        comp->states.push_back(fbl::move(state));
+    }
+    return ZX_OK;
+}
+
+zx_status_t SparseContainer::FlushCompression(compression_t* comp) {
+    size_t blocks = fbl::round_up(comp->in_size, kLz4BlockSize) / kLz4BlockSize;
+    size_t num_threads = fbl::min(static_cast<size_t>(compress_threads_), blocks);
+    if (num_threads == 0) {
+        return ZX_OK;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<CompressTask[]> tasks(new (&ac) CompressTask[num_threads]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    fbl::unique_ptr<pthread_t[]> threads(new (&ac) pthread_t[num_threads]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    for (size_t i = 0; i < num_threads; i++) {
+        tasks[i].in = comp->in.get();
+        tasks[i].in_size = comp->in_size;
+        tasks[i].first = (blocks * i) / num_threads;
+        tasks[i].last = (blocks * (i + 1)) / num_threads;
+        tasks[i].state = comp->states[i].get();
+        tasks[i].blocks = comp->blocks.get();
+        tasks[i].block_sizes = comp->block_sizes.get();
+    }
+    // The calling thread takes the first task. If a thread can't be started, its task is run
+    // here instead.
+    size_t started = 0;
+    for (size_t i = 1; i < num_threads; i++) {
+        if (pthread_create(&threads[started], nullptr, CompressThread, &tasks[i]) == 0) {
+            started++;
+        } else {
+            CompressThread(&tasks[i]);
+        }
+    }
+    CompressThread(&tasks[0]);
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], nullptr);
+    }
+
+    for (size_t i = 0; i < blocks; i++) {
+        size_t len = comp->block_sizes[i];
+        if (comp->offset + len > comp->size()) {
+            fprintf(stderr, "Compressed data exceeds buffer\n");
+            return ZX_ERR_BUFFER_TOO_SMALL;
+        }
+        memcpy(comp->buf(), comp->blocks.get() + i * kLz4MaxBlockSize, len);
+        comp->offset += len;
+    }
+    comp->in_size = 0;
     return ZX_OK;
 }
 
 zx_status_t SparseContainer::WriteData(const void* data, size_t length, compression_t* comp) {
     if (compress_) {
-        size_t r = LZ4F_compressUpdate(comp->cctx, comp->buf(), comp->size(), data, length, NULL);
-        if (LZ4F_isError(r)) {
-            fprintf(stderr, "Could not compress data: %s\n", LZ4F_getErrorName(r));
-            return ZX_ERR_INTERNAL;
+        const uint8_t* src = static_cast<const uint8_t*>(data);
+        while (length > 0) {
+            size_t len = fbl::min(length, comp->in_max - comp->in_size);
+            memcpy(comp->in.get() + comp->in_size, src, len);
+            comp->in_size += len;
+            src += len;
+            length -= len;
+
+            zx_status_t status;
+            if (comp->in_size == comp->in_max && (status = FlushCompression(comp)) != ZX_OK) {
+                return status;
+            }
         }
-
-        comp->offset += r;
     } else if (write(fd_.get(), data, length) != length) {
         return ZX_ERR_IO;
     }
@@ -394,6 +559,11 @@ zx_status_t SparseContainer::FinishCompression(compression_t* comp) {
         return ZX_OK;
     }
 
+    zx_status_t status;
+    if ((status = FlushCompression(comp)) != ZX_OK) {
+        return status;
+    }
+
     size_t r = LZ4F_compressEnd(comp->cctx, comp->buf(), comp->size(), NULL);
     if (LZ4F_isError(r)) {
         fprintf(stderr, "Could not finish compression: %s\n", LZ4F_getErrorName(r));
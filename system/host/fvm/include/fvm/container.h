@@ -131,9 +131,14 @@ public:
     size_t SliceSize() const final;
     zx_status_t AddPartition(const char* path, const char* type_name) final;
 
+    // Sets the number of threads used to compress data on Commit. Defaults to one per cpu.
+    // The compressed output does not depend on the number of threads.
+    void SetCompressionThreads(unsigned threads);
+
 private:
     bool valid_;
     compress_type_t compress_;
+    unsigned compress_threads_;
     size_t disk_size_;
     size_t extent_size_;
     fvm::sparse_image_t image_;
@@ -149,6 +154,16 @@ private:
         size_t offset = 0;
         fbl::unique_ptr<uint8_t[]> data;
 
+        // Data waiting to be compressed, up to |in_max| bytes of whole LZ4 blocks
+        fbl::unique_ptr<uint8_t[]> in;
+        size_t in_size = 0;
+        size_t in_max = 0;
+        // Compressed blocks of the current batch, one slot per block, and their sizes
+        fbl::unique_ptr<uint8_t[]> blocks;
+        fbl::unique_ptr<size_t[]> block_sizes;
+        // LZ4 compression state for each thread
+        fbl::Vector<fbl::unique_ptr<uint8_t[]>> states;
+
         size_t size() {
             return data_size;
         }
@@ -166,6 +181,8 @@ private:
     } compression_t;
 
     zx_status_t SetupCompression(compression_t* comp, size_t max_len);
+    // Compresses all data waiting in |comp->in|, in parallel, appending it to |comp->data|
+    zx_status_t FlushCompression(compression_t* comp);
     zx_status_t WriteData(const void* data, size_t length, compression_t* comp);
     zx_status_t FinishCompression(compression_t* comp);
 };
@@ -20,6 +20,8 @@ int usage(void) {
     fprintf(stderr, " --offset [bytes] - offset at which container begins (fvm only)\n");
     fprintf(stderr, " --length [bytes] - length of container within file (fvm only)\n");
     fprintf(stderr, " --compress - specify that file should be compressed (sparse only)\n");
+    fprintf(stderr, " --threads [count] - number of compression threads, default one per cpu"
+                    " (sparse only)\n");
     fprintf(stderr, "Input options:\n");
     fprintf(stderr, " --blobstore [path] - Add path as blobstore type (must be blobstore)\n");
     fprintf(stderr, " --data [path] - Add path as data type (must be minfs)\n");
@@ -56,13 +58,17 @@ int main(int argc, char** argv) {
     size_t length = 0;
     size_t offset = 0;
     bool should_unlink = true;
+    bool container_range = false;
     compress_type_t compress = NONE;
+    unsigned threads = 0;
 
     while (i < argc) {
         if (!strcmp(argv[i], "--offset") && i + 1 < argc) {
             should_unlink = false;
+            container_range = true;
             offset = atoll(argv[++i]);
         } else if (!strcmp(argv[i], "--length") && i + 1 < argc) {
+            container_range = true;
             length = atoll(argv[++i]);
         } else if (!strcmp(argv[i], "--compress")) {
             if (!strcmp(argv[++i], "lz4")) {
@@ -71,6 +77,12 @@ int main(int argc, char** argv) {
                 fprintf(stderr, "Invalid compression type\n");
                 return -1;
             }
+        } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+            if (threads == 0) {
+                fprintf(stderr, "Invalid thread count\n");
+                return -1;
+            }
         } else {
             break;
         }
@@ -138,7 +150,7 @@ int main(int argc, char** argv) {
             return -1;
         }
     } else if (!strcmp(command, "sparse")) {
-        if (i == 7) {
+        if (container_range) {
             fprintf(stderr, "Invalid sparse flags\n");
             return -1;
         }
@@ -148,6 +160,10 @@ int main(int argc, char** argv) {
             return -1;
         }
 
+        if (threads) {
+            sparseContainer->SetCompressionThreads(threads);
+        }
+
         if (add_partitions(sparseContainer.get(), argc - i, argv + i) < 0) {
             return -1;
         }
@@ -35,12 +35,14 @@ MODULE_COMPILEFLAGS := \
 
 MODULE_HOST_LIBS := \
     third_party/ulib/uboringssl.hostlib \
-    third_party/ulib/lz4.hostlib \
     system/uapp/blobstore.hostlib \
     system/ulib/fvm.hostlib \
     system/ulib/fbl.hostlib \
     system/ulib/digest.hostlib \
     system/ulib/minfs.hostlib \
+    third_party/ulib/lz4.hostlib \
+
+MODULE_HOST_SYSLIBS := -lpthread
 
 MODULE_DEFINES += DISABLE_THREAD_ANNOTATIONS
 
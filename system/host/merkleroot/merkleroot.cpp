@@ -32,6 +32,8 @@ int main(int argc, char** argv) {
     fbl::unique_ptr<uint8_t[]> tree(nullptr);
     char strbuf[Digest::kLength * 2 + 1];
     Digest digest;
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t num_threads = num_cpus > 0 ? static_cast<size_t>(num_cpus) : 1;
     for (size_t i = 1; i < argc; ++i) {
         const char* arg = argv[i];
         if (stat(arg, &info) < 0) {
@@ -69,7 +71,8 @@ int main(int argc, char** argv) {
             return 1;
         }
         zx_status_t rc =
-            MerkleTree::Create(data, info.st_size, tree.get(), len, &digest);
+            MerkleTree::CreateParallel(data, info.st_size, tree.get(), len, &digest,
+                                       num_threads);
         if (info.st_size != 0 && munmap(data, info.st_size) != 0) {
             perror("munmap");
             fprintf(stderr, "[-] Failed to munmap '%s.\n", arg);
@@ -16,6 +16,7 @@ MODULE_SRCS := \
 MODULE_HOST_SRCS := \
     $(LOCAL_DIR)/main.cpp \
     system/ulib/bitmap/raw-bitmap.cpp \
+    system/ulib/fs/dentry-cache.cpp \
     system/ulib/fs/vfs.cpp \
     system/ulib/fs/vnode.cpp \
 
@@ -9,6 +9,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -18,7 +19,9 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 
+#include <lz4.h>
 #include <lz4frame.h>
+#include <lz4hc.h>
 #include <lib/cksum.h>
 
 #include <zircon/boot/bootdata.h>
@@ -508,21 +511,219 @@ static bool check_and_log_lz4_error(LZ4F_errorCode_t code, const char* msg) {
     return false;
 }
 
+// The frame is compressed in blockIndependent mode, so every 64kB block of
+// input compresses on its own exactly as LZ4F_compressUpdate() would compress
+// it.  Input is gathered into batches of whole blocks, the blocks of a batch
+// are compressed by up to compress_threads threads, and the results are
+// written out in order, so the frame is identical whatever the thread count.
+#define LZ4_BLOCK_SIZE BOOTDATA_LZ4_BLOCK_SIZE
+#define LZ4_BLOCKS_PER_THREAD 16
+#define LZ4_MAX_THREADS 64
+// lz4frame.c switches to LZ4HC at this level.
+#define LZ4_MIN_HC_LEVEL 3
+
+// Number of compression threads, or 0 for one per cpu.
+static int compress_threads = 0;
+
+typedef struct {
+    int nthreads;
+    // Input not yet compressed, up to batch_size bytes.
+    uint8_t* in;
+    size_t in_len;
+    size_t batch_size;
+    // Compressed blocks of the current batch, one slot per block.
+    uint8_t* out;
+    size_t* out_len;
+    size_t slot_size;
+    // Compression state for each thread.
+    void* state[LZ4_MAX_THREADS];
+    // Total uncompressed bytes, checked against the frame's content size.
+    uint64_t total;
+    // Bytes of the frame written so far, and the offset of every block
+    // written, for the block index.
+    uint64_t pos;
+    uint32_t* index;
+    size_t index_len;
+    size_t index_max;
+} lz4_stream_t;
+
+// A contiguous range of blocks of a batch to be compressed by one thread.
+typedef struct {
+    lz4_stream_t* s;
+    void* state;
+    size_t first;
+    size_t last;
+} compress_task_t;
+
+static void put_le32(uint8_t* p, uint32_t val) {
+    p[0] = val;
+    p[1] = val >> 8;
+    p[2] = val >> 16;
+    p[3] = val >> 24;
+}
+
+// Compresses one block as LZ4F_compressBlock() does: a little-endian size
+// followed by the compressed data, or by the data itself, flagged in the size,
+// when it does not compress.
+static size_t compress_block(void* state, const uint8_t* src, size_t len, uint8_t* dst) {
+    int level = lz4_prefs.compressionLevel;
+    int r;
+    if (level < LZ4_MIN_HC_LEVEL) {
+        r = LZ4_compress_limitedOutput_withState(state, (const char*)src, (char*)dst + 4,
+                                                 len, len - 1);
+    } else {
+        r = LZ4_compress_HC_extStateHC(state, (const char*)src, (char*)dst + 4,
+                                       len, len - 1, level);
+    }
+    uint32_t size = r;
+    if (r <= 0) {
+        memcpy(dst + 4, src, len);
+        size = len | 0x80000000u;
+        r = len;
+    }
+    put_le32(dst, size);
+    return r + 4;
+}
+
+static void* compress_thread(void* arg) {
+    compress_task_t* task = arg;
+    lz4_stream_t* s = task->s;
+    for (size_t i = task->first; i < task->last; i++) {
+        size_t off = i * LZ4_BLOCK_SIZE;
+        size_t len = s->in_len - off;
+        if (len > LZ4_BLOCK_SIZE) {
+            len = LZ4_BLOCK_SIZE;
+        }
+        s->out_len[i] = compress_block(task->state, s->in + off, len,
+                                       s->out + i * s->slot_size);
+    }
+    return NULL;
+}
+
+// Compresses and writes out everything gathered so far.
+static ssize_t compress_flush(int fd, lz4_stream_t* s, uint32_t* crc) {
+    size_t nblocks = (s->in_len + LZ4_BLOCK_SIZE - 1) / LZ4_BLOCK_SIZE;
+    if (s->index_len + nblocks > s->index_max) {
+        size_t max = s->index_max ? s->index_max * 2 : 1024;
+        while (max < s->index_len + nblocks) {
+            max *= 2;
+        }
+        uint32_t* index = realloc(s->index, max * sizeof(uint32_t));
+        if (index == NULL) {
+            fprintf(stderr, "error: out of memory\n");
+            return -1;
+        }
+        s->index = index;
+        s->index_max = max;
+    }
+    size_t nthreads = s->nthreads;
+    if (nthreads > nblocks) {
+        nthreads = nblocks;
+    }
+    compress_task_t tasks[LZ4_MAX_THREADS];
+    pthread_t threads[LZ4_MAX_THREADS];
+    size_t started = 0;
+    for (size_t i = 0; i < nthreads; i++) {
+        tasks[i].s = s;
+        tasks[i].state = s->state[i];
+        tasks[i].first = (nblocks * i) / nthreads;
+        tasks[i].last = (nblocks * (i + 1)) / nthreads;
+    }
+    // The calling thread takes the first task.  If a thread can't be
+    // started, its task is run here instead.
+    for (size_t i = 1; i < nthreads; i++) {
+        if (pthread_create(&threads[started], NULL, compress_thread, &tasks[i]) == 0) {
+            started++;
+        } else {
+            compress_thread(&tasks[i]);
+        }
+    }
+    if (nthreads > 0) {
+        compress_thread(&tasks[0]);
+    }
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (size_t i = 0; i < nblocks; i++) {
+        uint8_t* out = s->out + i * s->slot_size;
+        if (s->pos > UINT32_MAX) {
+            fprintf(stderr, "error: compressed item too large\n");
+            return -1;
+        }
+        s->index[s->index_len++] = s->pos;
+        s->pos += s->out_len[i];
+        if (crc) {
+            *crc = crc32(*crc, out, s->out_len[i]);
+        }
+        if (writex(fd, out, s->out_len[i]) < 0) {
+            return -1;
+        }
+    }
+    s->total += s->in_len;
+    s->in_len = 0;
+    return 0;
+}
+
+static void compress_free(lz4_stream_t* s) {
+    for (int i = 0; i < s->nthreads; i++) {
+        free(s->state[i]);
+    }
+    free(s->in);
+    free(s->out);
+    free(s->out_len);
+    free(s->index);
+    free(s);
+}
+
 ssize_t compress_setup(int fd, void** cookie, uint32_t* crc) {
     LZ4F_compressionContext_t cctx;
     LZ4F_errorCode_t errc = LZ4F_createCompressionContext(&cctx, LZ4F_VERSION);
     if (check_and_log_lz4_error(errc, "could not initialize compression context")) {
         return -1;
     }
+    // The context is only used to write the frame header.
     uint8_t buf[128];
     size_t r = LZ4F_compressBegin(cctx, buf, sizeof(buf), &lz4_prefs);
+    LZ4F_freeCompressionContext(cctx);
     if (check_and_log_lz4_error(r, "could not begin compression")) {
-        return r;
+        return -1;
     }
 
-    // Note: LZ4F_compressionContext_t is a typedef to a pointer, so this is
-    // "safe".
-    *cookie = (void*)cctx;
+    lz4_stream_t* s = calloc(1, sizeof(*s));
+    if (s == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        return -1;
+    }
+    long nthreads = compress_threads;
+    if (nthreads <= 0) {
+        nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (nthreads < 1) {
+        nthreads = 1;
+    } else if (nthreads > LZ4_MAX_THREADS) {
+        nthreads = LZ4_MAX_THREADS;
+    }
+    s->nthreads = nthreads;
+    size_t nblocks = nthreads * LZ4_BLOCKS_PER_THREAD;
+    s->batch_size = nblocks * LZ4_BLOCK_SIZE;
+    s->slot_size = LZ4_BLOCK_SIZE + 4;
+    s->in = malloc(s->batch_size);
+    s->out = malloc(nblocks * s->slot_size);
+    s->out_len = calloc(nblocks, sizeof(size_t));
+    size_t state_size = (lz4_prefs.compressionLevel < LZ4_MIN_HC_LEVEL) ?
+                        LZ4_sizeofState() : LZ4_sizeofStateHC();
+    bool ok = s->in && s->out && s->out_len;
+    for (int i = 0; i < s->nthreads; i++) {
+        ok = ((s->state[i] = malloc(state_size)) != NULL) && ok;
+    }
+    if (!ok) {
+        fprintf(stderr, "error: out of memory\n");
+        compress_free(s);
+        return -1;
+    }
+    *cookie = s;
+    s->pos = r;
 
     if (crc && (r > 0)) {
         *crc = crc32(*crc, buf, r);
@@ -531,17 +732,22 @@ ssize_t compress_setup(int fd, void** cookie, uint32_t* crc) {
 }
 
 ssize_t compress_data(int fd, const void* src, size_t len, void* cookie, uint32_t* crc) {
-    // max will be, worst case, a bit larger than MAXBUFFER
-    size_t max = LZ4F_compressBound(len, &lz4_prefs);
-    uint8_t buf[max];
-    size_t r = LZ4F_compressUpdate((LZ4F_compressionContext_t)cookie, buf, max, src, len, NULL);
-    if (check_and_log_lz4_error(r, "could not compress data")) {
-        return -1;
-    }
-    if (crc) {
-        *crc = crc32(*crc, buf, r);
+    lz4_stream_t* s = cookie;
+    size_t total = len;
+    while (len > 0) {
+        size_t xfer = s->batch_size - s->in_len;
+        if (xfer > len) {
+            xfer = len;
+        }
+        memcpy(s->in + s->in_len, src, xfer);
+        s->in_len += xfer;
+        src = (const uint8_t*)src + xfer;
+        len -= xfer;
+        if ((s->in_len == s->batch_size) && (compress_flush(fd, s, crc) < 0)) {
+            return -1;
+        }
     }
-    return writex(fd, buf, r);
+    return total;
 }
 
 ssize_t compress_file(int fd, const char* fn, size_t len, void* cookie, uint32_t* crc) {
@@ -550,48 +756,80 @@ ssize_t compress_file(int fd, const char* fn, size_t len, void* cookie, uint32_t
         return 0;
     }
 
-    char buf[MAXBUFFER];
+    lz4_stream_t* s = cookie;
     int r, fdi;
     if ((fdi = open(fn, O_RDONLY)) < 0) {
         fprintf(stderr, "error: cannot open '%s'\n", fn);
         return -1;
     }
 
+    // Read straight into the batch rather than through a bounce buffer.
     r = 0;
     size_t total = len;
     while (len > 0) {
-        size_t xfer = (len > sizeof(buf)) ? sizeof(buf) : len;
-        if ((r = readx(fdi, buf, xfer)) < 0) {
-            break;
+        size_t xfer = s->batch_size - s->in_len;
+        if (xfer > len) {
+            xfer = len;
         }
-        if ((r = compress_data(fd, buf, xfer, cookie, crc)) < 0) {
+        if ((r = readx(fdi, s->in + s->in_len, xfer)) < 0) {
             break;
         }
+        s->in_len += xfer;
         len -= xfer;
+        if ((s->in_len == s->batch_size) && ((r = compress_flush(fd, s, crc)) < 0)) {
+            break;
+        }
     }
     close(fdi);
     return (r < 0) ? -1 : total;
 }
 
+// Writes the block index after the frame, as a skippable frame so that
+// LZ4 readers which don't know of it pass over it.
+static ssize_t compress_write_index(int fd, lz4_stream_t* s, uint32_t* crc) {
+    size_t len = 8 + s->index_len * 4 + sizeof(bootdata_lz4_index_t);
+    uint8_t* buf = malloc(len);
+    if (buf == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        return -1;
+    }
+    put_le32(buf, BOOTDATA_LZ4_INDEX_FRAME);
+    put_le32(buf + 4, len - 8);
+    for (size_t i = 0; i < s->index_len; i++) {
+        put_le32(buf + 8 + i * 4, s->index[i]);
+    }
+    put_le32(buf + len - 8, s->index_len);
+    put_le32(buf + len - 4, BOOTDATA_LZ4_INDEX_MAGIC);
+    if (crc) {
+        *crc = crc32(*crc, buf, len);
+    }
+    ssize_t r = writex(fd, buf, len);
+    free(buf);
+    return r;
+}
+
 ssize_t compress_finish(int fd, void* cookie, uint32_t* crc) {
-    // Max write is one block (64kB uncompressed) plus 8 bytes of footer.
-    size_t max = LZ4F_compressBound(65536, &lz4_prefs) + 8;
-    uint8_t buf[max];
-    size_t r = LZ4F_compressEnd((LZ4F_compressionContext_t)cookie, buf, max, NULL);
-    if (check_and_log_lz4_error(r, "could not finish compression")) {
-        r = -1;
-    } else {
+    lz4_stream_t* s = cookie;
+    ssize_t r = compress_flush(fd, s, crc);
+    if (r == 0) {
+        // lz4_prefs has no content checksum, so the frame ends with just the
+        // end mark.
+        static const uint8_t end_mark[4];
         if (crc) {
-            *crc = crc32(*crc, buf, r);
+            *crc = crc32(*crc, end_mark, sizeof(end_mark));
         }
-        r = writex(fd, buf, r);
+        r = writex(fd, end_mark, sizeof(end_mark));
     }
-
-    LZ4F_errorCode_t errc = LZ4F_freeCompressionContext((LZ4F_compressionContext_t)cookie);
-    if (check_and_log_lz4_error(errc, "could not free compression context")) {
+    if (r >= 0) {
+        r = compress_write_index(fd, s, crc);
+    }
+    if ((r >= 0) && lz4_prefs.frameInfo.contentSize &&
+        (lz4_prefs.frameInfo.contentSize != s->total)) {
+        fprintf(stderr, "could not finish compression: wrote %" PRIu64
+                " bytes of %llu\n", s->total, lz4_prefs.frameInfo.contentSize);
         r = -1;
     }
-
+    compress_free(s);
     return r;
 }
 
@@ -1096,6 +1334,8 @@ void usage(void) {
     "                               (multiple groups may be comma separated)\n"
     "                               (the value 'all' resets to include all groups)\n"
     "         --uncompressed        don't compress bootfs image (debug only)\n"
+    "         --threads <count>     compress with <count> threads\n"
+    "                               (default: one per cpu)\n"
     "         --target=system       bootfs to be unpacked at /system\n"
     "         --target=boot         bootfs to be unpacked at /boot\n"
     "         --vid <vid>           specify VID for platform ID record\n"
@@ -1201,6 +1441,18 @@ int main(int argc, char **argv) {
             compressed = true;
         } else if (!strcmp(cmd,"--uncompressed")) {
             compressed = false;
+        } else if (!strcmp(cmd,"--threads")) {
+            if (argc < 2) {
+                fprintf(stderr, "error: no value given for --threads\n");
+                return -1;
+            }
+            compress_threads = atoi(argv[1]);
+            if (compress_threads < 1) {
+                fprintf(stderr, "error: invalid thread count '%s'\n", argv[1]);
+                return -1;
+            }
+            argc--;
+            argv++;
         } else if (!strcmp(cmd,"--target=system")) {
             system = true;
         } else if (!strcmp(cmd,"--target=boot")) {
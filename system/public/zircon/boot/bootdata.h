@@ -59,6 +59,18 @@
 // Flag indicating that the bootfs is compressed.
 #define BOOTDATA_BOOTFS_FLAG_COMPRESSED  (1 << 0)
 
+// The LZ4 frame of a compressed item may be followed by an LZ4
+// skippable frame indexing its blocks, so that any block can be
+// decompressed without walking the frame.  Every block but the last
+// decompresses to BOOTDATA_LZ4_BLOCK_SIZE bytes.  The skippable frame
+// holds the offset of each block's size word (uint32_t, little-endian),
+// in order, followed by a bootdata_lz4_index_t which ends the item.
+// The offsets are measured from the start of the payload, that is from
+// the LZ4 frame magic just after the bootdata_t header, not from the
+// start of the item.
+#define BOOTDATA_LZ4_INDEX_FRAME  (0x184D2A5B) // LZ4 skippable frame magic
+#define BOOTDATA_LZ4_INDEX_MAGIC  (0x5844494c) // LIDX
+#define BOOTDATA_LZ4_BLOCK_SIZE   (65536)
 
 // These items are for passing from bootloader to kernel
 
@@ -162,6 +174,14 @@ typedef struct {
     uint64_t reserved;
 } bootdata_kernel_t;
 
+// Ends a BOOTDATA_LZ4_INDEX_FRAME.
+typedef struct {
+    // Number of block offsets preceding this.
+    uint32_t count;
+    // BOOTDATA_LZ4_INDEX_MAGIC
+    uint32_t magic;
+} bootdata_lz4_index_t;
+
 typedef struct {
     bootdata_t hdr_file;
     bootdata_t hdr_kernel;
@@ -33,6 +33,12 @@ typedef struct eth_info_t {
 #define ETH_FEATURE_WLAN  1
 // Device is a synthetic network device
 #define ETH_FEATURE_SYNTH 2
+// Device verifies the checksums of received packets (see ETH_FIFO_RX_CSUM_OK)
+#define ETH_FEATURE_RX_CSUM 4
+// Device can fill in the checksums of transmitted packets (see ETH_FIFO_TX_CSUM)
+#define ETH_FEATURE_TX_CSUM 8
+// Device can segment large TCP packets (see ETH_FIFO_TX_TSO)
+#define ETH_FEATURE_TSO 16
 
 // Get the fifos to submit tx and rx operations
 //   in: none
@@ -49,6 +55,20 @@ typedef struct eth_fifos_t {
     uint32_t rx_depth;
 } eth_fifos_t;
 
+// Add another pair of tx and rx fifos
+//   in: none
+//  out: eth_fifos_t*
+//
+// Received packets are spread across the rx fifos of a client by a hash of
+// their IP addresses and TCP or UDP ports, so that every packet of a flow
+// arrives on the same fifo.  Each tx fifo is serviced by its own thread.
+// The fifos returned by IOCTL_ETHERNET_GET_FIFOS are the first pair; up to
+// ETH_MAX_QUEUES pairs may exist, and they can only be added while stopped.
+#define IOCTL_ETHERNET_ADD_QUEUE \
+    IOCTL(IOCTL_KIND_GET_TWO_HANDLES, IOCTL_FAMILY_ETH, 11)
+
+#define ETH_MAX_QUEUES 8
+
 // Set the io buffer that tx and rx operations act on
 //   in: zx_handle_t (vmo)
 //  out: none
@@ -130,13 +150,15 @@ typedef struct eth_multicast_config_t {
 // are returned along with the fifo handles in the eth_fifos_t.
 
 // flags values for request messages
-// - none -
+#define ETH_FIFO_TX_CSUM (0x10u) // have the device fill in checksums (needs ETH_FEATURE_TX_CSUM)
+#define ETH_FIFO_TX_TSO  (0x20u) // have the device segment the packet (needs ETH_FEATURE_TSO)
 
 // flags values for response messages
 #define ETH_FIFO_RX_OK   (1u)   // packet received okay
 #define ETH_FIFO_TX_OK   (1u)   // packet transmitted okay
 #define ETH_FIFO_INVALID (2u)   // offset+length not within io_vmo bounds
 #define ETH_FIFO_RX_TX   (4u)   // received our own tx packet (when TX_LISTEN)
+#define ETH_FIFO_RX_CSUM_OK (0x40u) // device verified the packet's checksums
 
 typedef struct eth_fifo_entry {
     // offset from start of io_vmo to packet data
@@ -154,6 +176,9 @@ IOCTL_WRAPPER_OUT(ioctl_ethernet_get_info, IOCTL_ETHERNET_GET_INFO, eth_info_t);
 // ssize_t ioctl_ethernet_get_fifos(int fd, eth_fifos_t* out);
 IOCTL_WRAPPER_OUT(ioctl_ethernet_get_fifos, IOCTL_ETHERNET_GET_FIFOS, eth_fifos_t);
 
+// ssize_t ioctl_ethernet_add_queue(int fd, eth_fifos_t* out);
+IOCTL_WRAPPER_OUT(ioctl_ethernet_add_queue, IOCTL_ETHERNET_ADD_QUEUE, eth_fifos_t);
+
 // ssize_t ioctl_ethernet_set_iobuf(int fd, zx_handle_t_t* entries);
 IOCTL_WRAPPER_IN(ioctl_ethernet_set_iobuf, IOCTL_ETHERNET_SET_IOBUF, zx_handle_t);
 
@@ -34,7 +34,10 @@ __BEGIN_CDECLS
 #define KTRACE_NAMESIZE           (12)
 #define KTRACE_NAMEOFF            (8)
 
-#define KTRACE_VERSION            (0x00020000)
+// Reported by TAG_VERSION.  Since 0x00030000, zx_ktrace_read() returns
+// TAG_STREAM framed buffers which are not in global timestamp order (see
+// the buffering modes below).
+#define KTRACE_VERSION            (0x00030000)
 
 // Filter Groups
 #define KTRACE_GRP_ALL            0xFFF
@@ -88,5 +91,24 @@ enum {
 #define KTRACE_ACTION_STOP      2 // options ignored
 #define KTRACE_ACTION_REWIND    3 // options ignored
 #define KTRACE_ACTION_NEW_PROBE 4 // options ignored, ptr = name
+#define KTRACE_ACTION_SET_MODE  5 // options = KTRACE_MODE_*, tracing must be stopped
+
+// Buffering modes.  Each cpu traces into its own buffer, and name records go
+// to a buffer of their own.  zx_ktrace_read() returns each buffer as a
+// TAG_STREAM record followed by that many bytes of records in timestamp
+// order; the streams are not merged with each other.
+//
+// ONESHOT:   tracing stops when any buffer fills up.
+// CIRCULAR:  full buffers discard their oldest records (flight recorder);
+//            during a zx_ktrace_read(), they drop new records instead.
+// STREAMING: each zx_ktrace_read() consumes the records it returns, and
+//            ignores its offset; full buffers drop new records and count
+//            them in the next TAG_STREAM record.
+#define KTRACE_MODE_ONESHOT     0
+#define KTRACE_MODE_CIRCULAR    1
+#define KTRACE_MODE_STREAMING   2
+
+// TAG_STREAM id of the buffer holding name records.
+#define KTRACE_STREAM_NAMES     0xFFFFFFFFu
 
 __END_CDECLS
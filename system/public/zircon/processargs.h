@@ -118,7 +118,9 @@ struct zx_proc_args {
 // Used by kernel and userboot during startup
 #define PA_VMO_BOOTDATA          0x1A
 
-// Used by kernel and userboot during startup
+// Used by kernel and userboot during startup.  Argument 0 is the
+// primary bootfs.  If userboot decompresses it lazily, argument 1 is
+// the bootdata_lazy_t map of which of its blocks are decompressed.
 #define PA_VMO_BOOTFS            0x1B
 
 // Used by the kernel to export debug information as a file in bootfs.  When
@@ -31,6 +31,7 @@ typedef enum {
     ZX_INFO_KMEM_STATS                 = 17, // zx_info_kmem_stats_t[1]
     ZX_INFO_RESOURCE                   = 18, // zx_info_resource_t[1]
     ZX_INFO_HANDLE_COUNT               = 19, // zx_info_handle_count_t[1]
+    ZX_INFO_LOCK_STATS                 = 20, // zx_info_lock_stats_t[n]
     ZX_INFO_LAST
 } zx_object_info_topic_t;
 
@@ -354,6 +355,29 @@ typedef struct zx_info_resource {
     uint64_t high;
 } zx_info_resource_t;
 
+// Values for zx_info_lock_stats_t.kind.
+#define ZX_INFO_LOCK_KIND_MUTEX             0u
+#define ZX_INFO_LOCK_KIND_SPIN              1u
+
+// Contention statistics for the kernel locks acquired at one call site.
+// Only available when the kernel is built with lockstat.
+typedef struct zx_info_lock_stats {
+    // Kernel address of the code which acquired the lock.
+    uint64_t pc;
+    // One of ZX_INFO_LOCK_KIND_*.
+    uint32_t kind;
+    uint32_t reserved;
+    // Number of acquisitions, and how many of them found the lock held.
+    uint64_t acquisitions;
+    uint64_t contended;
+    // Total and longest time spent waiting to acquire the lock.
+    zx_duration_t wait_time;
+    zx_duration_t max_wait_time;
+    // Total and longest time the lock was held.
+    zx_duration_t hold_time;
+    zx_duration_t max_hold_time;
+} zx_info_lock_stats_t;
+
 #define ZX_INFO_CPU_STATS_FLAG_ONLINE       (1u<<0)
 
 // Object properties.
@@ -0,0 +1,143 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+#include <threads.h>
+
+#include <async/cpp/loop.h>
+#include <async/task.h>
+#include <fbl/algorithm.h>
+#include <fbl/atomic.h>
+#include <fbl/unique_ptr.h>
+#include <sync/completion.h>
+#include <zircon/syscalls.h>
+
+namespace {
+
+constexpr size_t kPostedTasks = 100000;
+constexpr size_t kChurnOperations = 100000;
+// Number of timers each churning thread keeps outstanding.
+constexpr size_t kChurnWindow = 1000;
+
+float SecondsSince(zx_time_t start) {
+    return static_cast<float>(zx_clock_get(ZX_CLOCK_MONOTONIC) - start) /
+           static_cast<float>(ZX_SEC(1));
+}
+
+struct CountedTask {
+    async_task_t task;
+    fbl::atomic<size_t>* remaining;
+    completion_t* done;
+};
+
+async_task_result_t CountedTaskHandler(async_t* async, async_task_t* task, zx_status_t status) {
+    auto counted = reinterpret_cast<CountedTask*>(task);
+    if (counted->remaining->fetch_sub(1u) == 1u) {
+        completion_signal(counted->done);
+    }
+    return ASYNC_TASK_FINISHED;
+}
+
+// Posts tasks which are already due to a loop running on |num_threads|
+// threads, and measures how long it takes for all of them to run.
+void RunPostBenchmark(size_t num_threads) {
+    async::Loop loop;
+    for (size_t i = 0; i < num_threads; i++) {
+        loop.StartThread();
+    }
+
+    fbl::unique_ptr<CountedTask[]> tasks(new CountedTask[kPostedTasks]);
+    fbl::atomic<size_t> remaining(kPostedTasks);
+    completion_t done;
+    for (size_t i = 0; i < kPostedTasks; i++) {
+        tasks[i].task = async_task_t{ASYNC_STATE_INIT, CountedTaskHandler, 0, 0u, 0u};
+        tasks[i].remaining = &remaining;
+        tasks[i].done = &done;
+    }
+
+    zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    for (size_t i = 0; i < kPostedTasks; i++) {
+        async_post_task(loop.async(), &tasks[i].task);
+    }
+    completion_wait(&done, ZX_TIME_INFINITE);
+    float seconds = SecondsSince(start);
+
+    printf("  %2zu loop threads: %10.0f tasks/sec\n", num_threads, kPostedTasks / seconds);
+    loop.Shutdown();
+}
+
+async_task_result_t UnexpectedTaskHandler(async_t* async, async_task_t* task,
+                                          zx_status_t status) {
+    printf("timer fired during churn benchmark\n");
+    return ASYNC_TASK_FINISHED;
+}
+
+struct ChurnArgs {
+    async_t* async;
+    unsigned seed;
+};
+
+// Arms timeouts and cancels them again before they expire, as a server
+// timing out requests which mostly complete in time would.
+int ChurnThread(void* arg) {
+    auto args = static_cast<ChurnArgs*>(arg);
+    fbl::unique_ptr<async_task_t[]> timers(new async_task_t[kChurnWindow]);
+    zx_time_t base = zx_deadline_after(ZX_SEC(3600));
+    unsigned seed = args->seed;
+    for (size_t i = 0; i < kChurnOperations; i++) {
+        async_task_t* timer = &timers[i % kChurnWindow];
+        if (i >= kChurnWindow) {
+            async_cancel_task(args->async, timer);
+        }
+        seed = seed * 1103515245u + 12345u;
+        *timer = async_task_t{ASYNC_STATE_INIT, UnexpectedTaskHandler,
+                             base + ZX_USEC(seed % 1000000u), 0u, 0u};
+        async_post_task(args->async, timer);
+    }
+    for (size_t i = 0; i < kChurnWindow; i++) {
+        async_cancel_task(args->async, &timers[i]);
+    }
+    return 0;
+}
+
+// Posts and cancels far-off timers from |num_threads| threads at once.
+void RunChurnBenchmark(size_t num_threads) {
+    async::Loop loop;
+    loop.StartThread();
+
+    fbl::unique_ptr<thrd_t[]> threads(new thrd_t[num_threads]);
+    fbl::unique_ptr<ChurnArgs[]> args(new ChurnArgs[num_threads]);
+    zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    for (size_t i = 0; i < num_threads; i++) {
+        args[i] = {loop.async(), static_cast<unsigned>(i + 1)};
+        thrd_create(&threads[i], ChurnThread, &args[i]);
+    }
+    for (size_t i = 0; i < num_threads; i++) {
+        thrd_join(threads[i], nullptr);
+    }
+    float seconds = SecondsSince(start);
+
+    printf("  %2zu client threads: %10.0f timers armed and canceled/sec\n", num_threads,
+           num_threads * kChurnOperations / seconds);
+    loop.Shutdown();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t max_threads = zx_system_get_num_cpus();
+
+    printf("Posting %zu due tasks\n", kPostedTasks);
+    for (size_t n = 1; n <= max_threads; n *= 2) {
+        RunPostBenchmark(n);
+    }
+
+    printf("Arming and canceling %zu timers per thread, %zu outstanding\n",
+           kChurnOperations, kChurnWindow);
+    for (size_t n = 1; n <= max_threads; n *= 2) {
+        RunChurnBenchmark(n);
+    }
+
+    return 0;
+}
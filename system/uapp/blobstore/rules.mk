@@ -26,6 +26,7 @@ MODULE_STATIC_LIBS := \
     system/ulib/trace-provider \
     system/ulib/trace \
     third_party/ulib/uboringssl \
+    third_party/ulib/lz4 \
     system/ulib/zx \
     system/ulib/zxcpp \
     system/ulib/fbl \
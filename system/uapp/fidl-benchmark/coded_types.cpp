@@ -0,0 +1,55 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Coding tables for coding.fidl2, which the fidl compiler does not
+// generate yet.
+
+#include <stddef.h>
+
+#include <fbl/algorithm.h>
+#include <fidl/internal.h>
+
+#include "coding.h"
+
+namespace {
+
+const fidl_type_t nonnullable_vmo_handle =
+    fidl_type_t(fidl::FidlCodedHandle(ZX_OBJ_TYPE_VMO, fidl::kNonnullable));
+const fidl_type_t nullable_event_handle =
+    fidl_type_t(fidl::FidlCodedHandle(ZX_OBJ_TYPE_EVENT, fidl::kNullable));
+const fidl_type_t nullable_handle =
+    fidl_type_t(fidl::FidlCodedHandle(ZX_OBJ_TYPE_NONE, fidl::kNullable));
+const fidl_type_t nonnullable_channel_handle =
+    fidl_type_t(fidl::FidlCodedHandle(ZX_OBJ_TYPE_CHANNEL, fidl::kNonnullable));
+const fidl_type_t array_of_four_nullable_handles = fidl_type_t(
+    fidl::FidlCodedArray(&nullable_handle, 4 * sizeof(zx_handle_t), sizeof(zx_handle_t)));
+
+const fidl::FidlField transfer_request_fields[] = {
+    fidl::FidlField(&nonnullable_vmo_handle, offsetof(BenchmarkTransferMsg, buffer)),
+    fidl::FidlField(&nullable_event_handle, offsetof(BenchmarkTransferMsg, signal)),
+    fidl::FidlField(&array_of_four_nullable_handles, offsetof(BenchmarkTransferMsg, extra)),
+};
+
+const fidl::FidlField transfer_response_fields[] = {
+    fidl::FidlField(&nonnullable_channel_handle, offsetof(BenchmarkTransferRsp, token)),
+};
+
+} // namespace
+
+const fidl_type_t BenchmarkEchoReqCoded =
+    fidl_type_t(fidl::FidlCodedStruct(nullptr, 0u, sizeof(BenchmarkEchoMsg)));
+const fidl_type_t BenchmarkEchoRspCoded =
+    fidl_type_t(fidl::FidlCodedStruct(nullptr, 0u, sizeof(BenchmarkEchoRsp)));
+
+const fidl_type_t BenchmarkWriteReqCoded =
+    fidl_type_t(fidl::FidlCodedStruct(nullptr, 0u, sizeof(BenchmarkWriteMsg)));
+const fidl_type_t BenchmarkWriteRspCoded =
+    fidl_type_t(fidl::FidlCodedStruct(nullptr, 0u, sizeof(BenchmarkWriteRsp)));
+
+const fidl_type_t BenchmarkTransferReqCoded = fidl_type_t(fidl::FidlCodedStruct(
+    transfer_request_fields, fbl::count_of(transfer_request_fields),
+    sizeof(BenchmarkTransferMsg)));
+const fidl_type_t BenchmarkTransferRspCoded = fidl_type_t(fidl::FidlCodedStruct(
+    transfer_response_fields, fbl::count_of(transfer_response_fields),
+    sizeof(BenchmarkTransferRsp)));
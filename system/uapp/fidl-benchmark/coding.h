@@ -0,0 +1,320 @@
+// header file
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <fidl/coding.h>
+#include <zircon/fidl.h>
+#include <zircon/syscalls/object.h>
+#include <zircon/types.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+
+// Forward declarations
+
+typedef struct BenchmarkEchoMsg BenchmarkEchoMsg;
+typedef struct BenchmarkEchoRsp BenchmarkEchoRsp;
+typedef struct BenchmarkWriteMsg BenchmarkWriteMsg;
+typedef struct BenchmarkWriteRsp BenchmarkWriteRsp;
+typedef struct BenchmarkTransferMsg BenchmarkTransferMsg;
+typedef struct BenchmarkTransferRsp BenchmarkTransferRsp;
+
+// Extern declarations
+
+extern const fidl_type_t BenchmarkEchoReqCoded;
+extern const fidl_type_t BenchmarkEchoRspCoded;
+extern const fidl_type_t BenchmarkWriteReqCoded;
+extern const fidl_type_t BenchmarkWriteRspCoded;
+extern const fidl_type_t BenchmarkTransferReqCoded;
+extern const fidl_type_t BenchmarkTransferRspCoded;
+
+// Declarations
+
+struct BenchmarkEchoMsg {
+    fidl_message_header_t hdr;
+    uint64_t value;
+};
+
+struct BenchmarkEchoRsp {
+    fidl_message_header_t hdr;
+    uint64_t value;
+};
+
+struct BenchmarkWriteMsg {
+    fidl_message_header_t hdr;
+    uint64_t offset;
+    uint8_t data[64];
+};
+
+struct BenchmarkWriteRsp {
+    fidl_message_header_t hdr;
+    int32_t result;
+    uint64_t actual;
+};
+
+struct BenchmarkTransferMsg {
+    fidl_message_header_t hdr;
+    zx_handle_t buffer;
+    zx_handle_t signal;
+    zx_handle_t extra[4];
+};
+
+struct BenchmarkTransferRsp {
+    fidl_message_header_t hdr;
+    zx_handle_t token;
+};
+
+
+// Coding functions
+
+static inline zx_status_t BenchmarkEchoMsg_encode(void* bytes, uint32_t num_bytes, zx_handle_t* handles, uint32_t max_handles, uint32_t* actual_handles_out, const char** error_msg_out) {
+    if (bytes == NULL || num_bytes != sizeof(BenchmarkEchoMsg)) {
+        if (error_msg_out != NULL) {
+            *error_msg_out = "message does not match the size of BenchmarkEchoMsg";
+        }
+        return ZX_ERR_INVALID_ARGS;
+    }
+    *actual_handles_out = 0u;
+    return ZX_OK;
+}
+
+static inline zx_status_t BenchmarkEchoMsg_decode(void* bytes, uint32_t num_bytes, const zx_handle_t* handles, uint32_t num_handles, const char** error_msg_out) {
+    if (bytes == NULL || num_bytes != sizeof(BenchmarkEchoMsg) || num_handles != 0u) {
+        if (error_msg_out != NULL) {
+            *error_msg_out = "message does not match the layout of BenchmarkEchoMsg";
+        }
+        return ZX_ERR_INVALID_ARGS;
+    }
+    return ZX_OK;
+}
+
+static inline zx_status_t BenchmarkEchoRsp_encode(void* bytes, uint32_t num_bytes, zx_handle_t* handles, uint32_t max_handles, uint32_t* actual_handles_out, const char** error_msg_out) {
+    if (bytes == NULL || num_bytes != sizeof(BenchmarkEchoRsp)) {
+        if (error_msg_out != NULL) {
+            *error_msg_out = "message does not match the size of BenchmarkEchoRsp";
+        }
+        return ZX_ERR_INVALID_ARGS;
+    }
+    *actual_handles_out = 0u;
+    return ZX_OK;
+}
+
+static inline zx_status_t BenchmarkEchoRsp_decode(void* bytes, uint32_t num_bytes, const zx_handle_t* handles, uint32_t num_handles, const char** error_msg_out) {
+    if (bytes == NULL || num_bytes != sizeof(BenchmarkEchoRsp) || num_handles != 0u) {
+        if (error_msg_out != NULL) {
+            *error_msg_out = "message does not match the layout of BenchmarkEchoRsp";
+        }
+        return ZX_ERR_INVALID_ARGS;
+    }
+    return ZX_OK;
+}
+
+static inline zx_status_t BenchmarkWriteMsg_encode(void* bytes, uint32_t num_bytes, zx_handle_t* handles, uint32_t max_handles, uint32_t* actual_handles_out, const char** error_msg_out) {
+    if (bytes == NULL || num_bytes != sizeof(BenchmarkWriteMsg)) {
+        if (error_msg_out != NULL) {
+            *error_msg_out = "message does not match the size of BenchmarkWriteMsg";
+        }
+        return ZX_ERR_INVALID_ARGS;
+    }
+    *actual_handles_out = 0u;
+    return ZX_OK;
+}
+
+static inline zx_status_t BenchmarkWriteMsg_decode(void* bytes, uint32_t num_bytes, const zx_handle_t* handles, uint32_t num_handles, const char** error_msg_out) {
+    if (bytes == NULL || num_bytes != sizeof(BenchmarkWriteMsg) || num_handles != 0u) {
+        if (error_msg_out != NULL) {
+            *error_msg_out = "message does not match the layout of BenchmarkWriteMsg";
+        }
+        return ZX_ERR_INVALID_ARGS;
+    }
+    return ZX_OK;
+}
+
+static inline zx_status_t BenchmarkWriteRsp_encode(void* bytes, uint32_t num_bytes, zx_handle_t* handles, uint32_t max_handles, uint32_t* actual_handles_out, const char** error_msg_out) {
+    if (bytes == NULL || num_bytes != sizeof(BenchmarkWriteRsp)) {
+        if (error_msg_out != NULL) {
+            *error_msg_out = "message does not match the size of BenchmarkWriteRsp";
+        }
+        return ZX_ERR_INVALID_ARGS;
+    }
+    *actual_handles_out = 0u;
+    return ZX_OK;
+}
+
+static inline zx_status_t BenchmarkWriteRsp_decode(void* bytes, uint32_t num_bytes, const zx_handle_t* handles, uint32_t num_handles, const char** error_msg_out) {
+    if (bytes == NULL || num_bytes != sizeof(BenchmarkWriteRsp) || num_handles != 0u) {
+        if (error_msg_out != NULL) {
+            *error_msg_out = "message does not match the layout of BenchmarkWriteRsp";
+        }
+        return ZX_ERR_INVALID_ARGS;
+    }
+    return ZX_OK;
+}
+
+static inline zx_status_t BenchmarkTransferMsg_encode(void* bytes, uint32_t num_bytes, zx_handle_t* handles, uint32_t max_handles, uint32_t* actual_handles_out, const char** error_msg_out) {
+    BenchmarkTransferMsg* msg = (BenchmarkTransferMsg*)bytes;
+    uint32_t handle_idx = 0u;
+    const char* error_msg;
+    if (msg == NULL || num_bytes != sizeof(*msg)) {
+        error_msg = "message does not match the size of BenchmarkTransferMsg";
+        goto fail;
+    }
+    if (handles == NULL && max_handles != 0u) {
+        error_msg = "Cannot provide non-zero handle count and null handle pointer";
+        goto fail;
+    }
+    if (handle_idx == max_handles) {
+        error_msg = "message encoded too many handles";
+        goto fail;
+    }
+    handles[handle_idx++] = msg->buffer;
+    msg->buffer = FIDL_HANDLE_PRESENT;
+    if (msg->signal != ZX_HANDLE_INVALID) {
+        if (handle_idx == max_handles) {
+            error_msg = "message encoded too many handles";
+            goto fail;
+        }
+        handles[handle_idx++] = msg->signal;
+        msg->signal = FIDL_HANDLE_PRESENT;
+    }
+    for (uint32_t i0 = 0u; i0 < 4u; ++i0) {
+        if (msg->extra[i0] != ZX_HANDLE_INVALID) {
+            if (handle_idx == max_handles) {
+                error_msg = "message encoded too many handles";
+                goto fail;
+            }
+            handles[handle_idx++] = msg->extra[i0];
+            msg->extra[i0] = FIDL_HANDLE_PRESENT;
+        }
+    }
+    *actual_handles_out = handle_idx;
+    return ZX_OK;
+fail:
+    if (error_msg_out != NULL) {
+        *error_msg_out = error_msg;
+    }
+    return ZX_ERR_INVALID_ARGS;
+}
+
+static inline zx_status_t BenchmarkTransferMsg_decode(void* bytes, uint32_t num_bytes, const zx_handle_t* handles, uint32_t num_handles, const char** error_msg_out) {
+    BenchmarkTransferMsg* msg = (BenchmarkTransferMsg*)bytes;
+    uint32_t handle_idx = 0u;
+    const char* error_msg;
+    if (msg == NULL || num_bytes != sizeof(*msg)) {
+        error_msg = "message does not match the size of BenchmarkTransferMsg";
+        goto fail;
+    }
+    if (handles == NULL && num_handles != 0u) {
+        error_msg = "Cannot provide non-zero handle count and null handle pointer";
+        goto fail;
+    }
+    if (msg->buffer != FIDL_HANDLE_PRESENT) {
+        error_msg = "message tried to decode a non-present handle";
+        goto fail;
+    }
+    if (handle_idx == num_handles) {
+        error_msg = "message decoded too many handles";
+        goto fail;
+    }
+    msg->buffer = handles[handle_idx++];
+    if (msg->signal == FIDL_HANDLE_PRESENT) {
+        if (handle_idx == num_handles) {
+            error_msg = "message decoded too many handles";
+            goto fail;
+        }
+        msg->signal = handles[handle_idx++];
+    } else if (msg->signal != FIDL_HANDLE_ABSENT) {
+        error_msg = "message tried to decode a non-present handle";
+        goto fail;
+    }
+    for (uint32_t i0 = 0u; i0 < 4u; ++i0) {
+        if (msg->extra[i0] == FIDL_HANDLE_PRESENT) {
+            if (handle_idx == num_handles) {
+                error_msg = "message decoded too many handles";
+                goto fail;
+            }
+            msg->extra[i0] = handles[handle_idx++];
+        } else if (msg->extra[i0] != FIDL_HANDLE_ABSENT) {
+            error_msg = "message tried to decode a non-present handle";
+            goto fail;
+        }
+    }
+    if (handle_idx != num_handles) {
+        error_msg = "message did not contain the specified number of handles";
+        goto fail;
+    }
+    return ZX_OK;
+fail:
+    if (error_msg_out != NULL) {
+        *error_msg_out = error_msg;
+    }
+    return ZX_ERR_INVALID_ARGS;
+}
+
+static inline zx_status_t BenchmarkTransferRsp_encode(void* bytes, uint32_t num_bytes, zx_handle_t* handles, uint32_t max_handles, uint32_t* actual_handles_out, const char** error_msg_out) {
+    BenchmarkTransferRsp* msg = (BenchmarkTransferRsp*)bytes;
+    uint32_t handle_idx = 0u;
+    const char* error_msg;
+    if (msg == NULL || num_bytes != sizeof(*msg)) {
+        error_msg = "message does not match the size of BenchmarkTransferRsp";
+        goto fail;
+    }
+    if (handles == NULL && max_handles != 0u) {
+        error_msg = "Cannot provide non-zero handle count and null handle pointer";
+        goto fail;
+    }
+    if (handle_idx == max_handles) {
+        error_msg = "message encoded too many handles";
+        goto fail;
+    }
+    handles[handle_idx++] = msg->token;
+    msg->token = FIDL_HANDLE_PRESENT;
+    *actual_handles_out = handle_idx;
+    return ZX_OK;
+fail:
+    if (error_msg_out != NULL) {
+        *error_msg_out = error_msg;
+    }
+    return ZX_ERR_INVALID_ARGS;
+}
+
+static inline zx_status_t BenchmarkTransferRsp_decode(void* bytes, uint32_t num_bytes, const zx_handle_t* handles, uint32_t num_handles, const char** error_msg_out) {
+    BenchmarkTransferRsp* msg = (BenchmarkTransferRsp*)bytes;
+    uint32_t handle_idx = 0u;
+    const char* error_msg;
+    if (msg == NULL || num_bytes != sizeof(*msg)) {
+        error_msg = "message does not match the size of BenchmarkTransferRsp";
+        goto fail;
+    }
+    if (handles == NULL && num_handles != 0u) {
+        error_msg = "Cannot provide non-zero handle count and null handle pointer";
+        goto fail;
+    }
+    if (msg->token != FIDL_HANDLE_PRESENT) {
+        error_msg = "message tried to decode a non-present handle";
+        goto fail;
+    }
+    if (handle_idx == num_handles) {
+        error_msg = "message decoded too many handles";
+        goto fail;
+    }
+    msg->token = handles[handle_idx++];
+    if (handle_idx != num_handles) {
+        error_msg = "message did not contain the specified number of handles";
+        goto fail;
+    }
+    return ZX_OK;
+fail:
+    if (error_msg_out != NULL) {
+        *error_msg_out = error_msg;
+    }
+    return ZX_ERR_INVALID_ARGS;
+}
+
+#if defined(__cplusplus)
+}
+#endif
@@ -0,0 +1,116 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <fbl/algorithm.h>
+#include <fidl/coding.h>
+#include <zircon/syscalls.h>
+
+#include "coding.h"
+
+namespace {
+
+constexpr unsigned kWarmUpIterations = 1000;
+constexpr unsigned kRunIterations = 1000000;
+
+// Measures how long it takes to run some number of iterations of a closure.
+// Returns a value in nanoseconds.
+template <typename T>
+float Measure(unsigned iterations, const T& closure) {
+    uint64_t start = zx_ticks_get();
+    for (unsigned i = 0; i < iterations; i++) {
+        closure();
+    }
+    uint64_t stop = zx_ticks_get();
+    return static_cast<float>(stop - start) * 1000000000.f /
+           static_cast<float>(zx_ticks_per_second());
+}
+
+// Runs a closure repeatedly and prints its timing.
+template <typename T>
+void Run(const char* test_name, const T& closure) {
+    Measure(kWarmUpIterations, closure);
+    float run_time = Measure(kRunIterations, closure);
+    printf("  %-40s %8.1f ns per round trip\n", test_name, run_time / kRunIterations);
+}
+
+// Keeps the compiler from folding away coding of a message whose contents
+// it can see.
+void Clobber(void* message) {
+    __asm__ volatile("" : : "r"(message) : "memory");
+}
+
+// Encodes and then decodes |message| in place, as a client sending a
+// request and a server receiving it would.
+template <typename Message>
+void RoundTrip(const char* name, Message* message, const fidl_type_t* type,
+               zx_status_t (*encode)(void*, uint32_t, zx_handle_t*, uint32_t, uint32_t*,
+                                     const char**),
+               zx_status_t (*decode)(void*, uint32_t, const zx_handle_t*, uint32_t,
+                                     const char**)) {
+    printf("%s (%zu bytes)\n", name, sizeof(Message));
+    zx_handle_t handles[ZX_CHANNEL_MAX_MSG_HANDLES];
+    Run("table-driven", [&] {
+        Clobber(message);
+        uint32_t actual_handles = 0u;
+        const char* error = nullptr;
+        if (fidl_encode(type, message, sizeof(*message), handles, fbl::count_of(handles),
+                        &actual_handles, &error) != ZX_OK ||
+            fidl_decode(type, message, sizeof(*message), handles, actual_handles,
+                        &error) != ZX_OK) {
+            printf("coding failed: %s\n", error);
+        }
+    });
+    Run("specialized", [&] {
+        Clobber(message);
+        uint32_t actual_handles = 0u;
+        const char* error = nullptr;
+        if (encode(message, sizeof(*message), handles, fbl::count_of(handles), &actual_handles,
+                   &error) != ZX_OK ||
+            decode(message, sizeof(*message), handles, actual_handles, &error) != ZX_OK) {
+            printf("coding failed: %s\n", error);
+        }
+    });
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    printf("Encoding and decoding the messages of coding.fidl2, %u times each\n\n",
+           kRunIterations);
+
+    BenchmarkEchoMsg echo = {};
+    echo.value = 42u;
+    RoundTrip("Benchmark.Echo request", &echo, &BenchmarkEchoReqCoded,
+              BenchmarkEchoMsg_encode, BenchmarkEchoMsg_decode);
+
+    BenchmarkWriteMsg write = {};
+    write.offset = 4096u;
+    memset(write.data, 0xa5, sizeof(write.data));
+    RoundTrip("Benchmark.Write request", &write, &BenchmarkWriteReqCoded,
+              BenchmarkWriteMsg_encode, BenchmarkWriteMsg_decode);
+
+    BenchmarkWriteRsp write_response = {};
+    write_response.actual = sizeof(write.data);
+    RoundTrip("Benchmark.Write response", &write_response, &BenchmarkWriteRspCoded,
+              BenchmarkWriteRsp_encode, BenchmarkWriteRsp_decode);
+
+    // Coding only moves handle values around, so these need not be real.
+    BenchmarkTransferMsg transfer = {};
+    transfer.buffer = 0x1001;
+    transfer.signal = 0x1002;
+    transfer.extra[0] = 0x1003;
+    transfer.extra[2] = 0x1004;
+    RoundTrip("Benchmark.Transfer request", &transfer, &BenchmarkTransferReqCoded,
+              BenchmarkTransferMsg_encode, BenchmarkTransferMsg_decode);
+
+    BenchmarkTransferRsp transfer_response = {};
+    transfer_response.token = 0x1005;
+    RoundTrip("Benchmark.Transfer response", &transfer_response, &BenchmarkTransferRspCoded,
+              BenchmarkTransferRsp_encode, BenchmarkTransferRsp_decode);
+
+    return 0;
+}
@@ -9,6 +9,7 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <fdio/limits.h>
 #include <fs-management/ramdisk.h>
 #include <zircon/syscalls.h>
 #include <zircon/device/ramdisk.h>
@@ -80,6 +81,26 @@ static zx_time_t iotime_posix(int is_read, int fd, size_t total, size_t bufsz) {
     return t1 - t0;
 }
 
+// Runs the transfer twice over the same range: first in FDIO_CHUNK_SIZE
+// calls, each a round trip carrying its bytes in the message, then in
+// |bufsz| calls, which remoteio moves through the connection's transfer
+// vmo.  Returns the time of the second run.
+static zx_time_t iotime_compare(int is_read, int fd, size_t total, size_t bufsz) {
+    zx_time_t res = iotime_posix(is_read, fd, total, FDIO_CHUNK_SIZE);
+    if (res == ZX_TIME_INFINITE) {
+        return res;
+    }
+    fprintf(stderr, "%s %zu bytes in %d-byte calls in %zu ns: ",
+            is_read ? "read" : "write", total, FDIO_CHUNK_SIZE, res);
+    bytes_per_second(total, res);
+
+    if (lseek(fd, 0, SEEK_SET) != 0) {
+        fprintf(stderr, "error: cannot seek to start: %d\n", errno);
+        return ZX_TIME_INFINITE;
+    }
+    return iotime_posix(is_read, fd, total, bufsz);
+}
+
 
 static int make_ramdisk(size_t blocks) {
     char ramdisk_path[PATH_MAX];
@@ -167,9 +188,10 @@ static zx_time_t iotime_fifo(char* dev, int is_read, int fd, size_t total, size_
 
 static int usage(void) {
     fprintf(stderr,
-            "usage: iotime <read|write> <posix|block|fifo> <device|--ramdisk> <bytes> <bufsize>\n\n"
+            "usage: iotime <read|write> <posix|compare|block|fifo> <device|--ramdisk> <bytes> <bufsize>\n\n"
             "        <bytes> and <bufsize> must be a multiple of 4k for block mode\n"
-            "        --ramdisk only supported for block mode\n");
+            "        compare times posix mode with both %d-byte and <bufsize> calls\n"
+            "        --ramdisk only supported for block mode\n", FDIO_CHUNK_SIZE);
     return -1;
 }
 
@@ -203,6 +225,8 @@ int main(int argc, char** argv) {
     zx_time_t res;
     if (!strcmp(argv[2], "posix")) {
         res = iotime_posix(is_read, fd, total, bufsz);
+    } else if (!strcmp(argv[2], "compare")) {
+        res = iotime_compare(is_read, fd, total, bufsz);
     } else if (!strcmp(argv[2], "block")) {
         res = iotime_block(is_read, fd, total, bufsz);
     } else if (!strcmp(argv[2], "fifo")) {
@@ -41,6 +41,9 @@ int do_minfs_mount(fbl::unique_ptr<minfs::Bcache> bc, bool readonly) {
     fs::Vfs vfs(loop.async());
     trace::TraceProvider trace_provider(loop.async());
     vfs.SetReadonly(readonly);
+    if (vfs.EnableDentryCache() != ZX_OK) {
+        return -1;
+    }
 
     if (MountAndServe(&vfs, fbl::move(bc), zx::channel(h)) != ZX_OK) {
         return -1;
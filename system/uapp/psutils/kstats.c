@@ -147,11 +147,58 @@ static zx_status_t memstats(zx_handle_t root_resource) {
     return ZX_OK;
 }
 
+#define MAX_LOCK_SITES 1024
+#define NUM_LOCK_SITES_SHOWN 20
+
+static int compare_lock_wait(const void* a, const void* b) {
+    const zx_info_lock_stats_t* x = a;
+    const zx_info_lock_stats_t* y = b;
+    if (x->wait_time == y->wait_time)
+        return 0;
+    return x->wait_time > y->wait_time ? -1 : 1;
+}
+
+static zx_status_t lockstats(zx_handle_t root_resource) {
+    static zx_info_lock_stats_t stats[MAX_LOCK_SITES];
+
+    size_t actual, avail;
+    zx_status_t err = zx_object_get_info(root_resource, ZX_INFO_LOCK_STATS, stats, sizeof(stats),
+                                         &actual, &avail);
+    if (err != ZX_OK) {
+        fprintf(stderr, "ZX_INFO_LOCK_STATS returns %d (%s)\n", err, zx_status_get_string(err));
+        if (err == ZX_ERR_NOT_SUPPORTED)
+            fprintf(stderr, "kernel was built without ENABLE_LOCKSTAT=true\n");
+        return err;
+    }
+
+    qsort(stats, actual, sizeof(stats[0]), compare_lock_wait);
+
+    printf("%18s %5s %10s %10s %10s %8s %10s %8s\n",
+           "pc", "kind", "acquired", "contended", "wait(us)", "max", "hold(us)", "max");
+    for (size_t i = 0; i < actual && i < NUM_LOCK_SITES_SHOWN; i++) {
+        printf("%#18" PRIx64 " %5s %10" PRIu64 " %10" PRIu64
+               " %10" PRIu64 " %8" PRIu64 " %10" PRIu64 " %8" PRIu64 "\n",
+               stats[i].pc,
+               stats[i].kind == ZX_INFO_LOCK_KIND_SPIN ? "spin" : "mutex",
+               stats[i].acquisitions,
+               stats[i].contended,
+               stats[i].wait_time / ZX_USEC(1),
+               stats[i].max_wait_time / ZX_USEC(1),
+               stats[i].hold_time / ZX_USEC(1),
+               stats[i].max_hold_time / ZX_USEC(1));
+    }
+    if (actual < avail) {
+        printf("(%zu of %zu lock sites read)\n", actual, avail);
+    }
+    return ZX_OK;
+}
+
 static void print_help(FILE* f) {
     fprintf(f, "Usage: kstats [options]\n");
     fprintf(f, "Options:\n");
     fprintf(f, " -c              Print system CPU stats\n");
     fprintf(f, " -m              Print system memory stats\n");
+    fprintf(f, " -l              Print the most contended kernel locks\n");
     fprintf(f, " -d <delay>      Delay in seconds (default 1 second)\n");
     fprintf(f, " -n <times>      Run this many times and then exit\n");
     fprintf(f, " -t              Print timestamp for each report\n");
@@ -174,17 +221,21 @@ static void print_help(FILE* f) {
     fprintf(f, "\tipi (rs  gen): inter-processor-interrupts\n");
     fprintf(f, "\t\trs:     reschedule events\n");
     fprintf(f, "\t\tgen:    generic interprocessor interrupts\n");
+    fprintf(f, "\nLock stats are collected by kernels built with ENABLE_LOCKSTAT=true\n");
+    fprintf(f, "while \"lockstat start\" or kernel.lockstat.enable=true is in effect,\n");
+    fprintf(f, "and are listed by total time spent waiting for each call site.\n");
 }
 
 int main(int argc, char** argv) {
     bool cpu_stats = false;
     bool mem_stats = false;
+    bool lock_stats = false;
     zx_time_t delay = ZX_SEC(1);
     int num_loops = -1;
     bool timestamp = false;
 
     int c;
-    while ((c = getopt(argc, argv, "cd:n:hmt")) > 0) {
+    while ((c = getopt(argc, argv, "cd:n:hlmt")) > 0) {
         switch (c) {
             case 'c':
                 cpu_stats = true;
@@ -208,6 +259,9 @@ int main(int argc, char** argv) {
             case 'h':
                 print_help(stdout);
                 return 0;
+            case 'l':
+                lock_stats = true;
+                break;
             case 'm':
                 mem_stats = true;
                 break;
@@ -221,7 +275,7 @@ int main(int argc, char** argv) {
         }
     }
 
-    if (!cpu_stats && !mem_stats) {
+    if (!cpu_stats && !mem_stats && !lock_stats) {
         fprintf(stderr, "No statistics selected\n");
         print_help(stderr);
         return 1;
@@ -258,6 +312,9 @@ int main(int argc, char** argv) {
         if (mem_stats) {
             ret |= memstats(root_resource);
         }
+        if (lock_stats) {
+            ret |= lockstats(root_resource);
+        }
 
         if (ret != ZX_OK)
             break;
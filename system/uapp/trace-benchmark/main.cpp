@@ -5,6 +5,7 @@
 #include <zircon/syscalls.h>
 
 #include <stdio.h>
+#include <string.h>
 
 #include <zircon/assert.h>
 
@@ -18,18 +19,19 @@
 namespace {
 
 // Trace buffer size.
-// Should be sized so it does not overflow during the test.
+// Should be sized so it does not overflow during the test in the oneshot mode.
 static constexpr size_t kBufferSizeBytes = 16 * 1024 * 1024;
 
 class BenchmarkHandler : public trace::TraceHandler {
 public:
-    BenchmarkHandler(async::Loop* loop)
-        : loop_(loop), buffer_(new uint8_t[kBufferSizeBytes], kBufferSizeBytes) {
+    BenchmarkHandler(async::Loop* loop, trace_buffering_mode_t buffering_mode)
+        : loop_(loop), buffering_mode_(buffering_mode),
+          buffer_(new uint8_t[kBufferSizeBytes], kBufferSizeBytes) {
     }
 
     void Start() {
-        zx_status_t status = trace_start_engine(loop_->async(), this,
-                                                buffer_.get(), buffer_.size());
+        zx_status_t status = trace_start_engine_with_mode(loop_->async(), this, buffering_mode_,
+                                                          buffer_.get(), buffer_.size());
         ZX_DEBUG_ASSERT(status == ZX_OK);
 
         puts("\nTrace started\n");
@@ -50,15 +52,36 @@ private:
         loop_->Quit();
     }
 
+    void ChunkFull(size_t offset, size_t size) override {
+        // Discard the records straight away so the benchmark measures only
+        // the cost of writing them.
+        trace_engine_release_chunk(offset);
+    }
+
     async::Loop* loop_;
+    trace_buffering_mode_t buffering_mode_;
     fbl::Array<uint8_t> buffer_;
 };
 
 } // namespace
 
 int main(int argc, char** argv) {
+    trace_buffering_mode_t buffering_mode = TRACE_BUFFERING_MODE_ONESHOT;
+    if (argc > 1) {
+        if (!strcmp(argv[1], "oneshot")) {
+            buffering_mode = TRACE_BUFFERING_MODE_ONESHOT;
+        } else if (!strcmp(argv[1], "circular")) {
+            buffering_mode = TRACE_BUFFERING_MODE_CIRCULAR;
+        } else if (!strcmp(argv[1], "streaming")) {
+            buffering_mode = TRACE_BUFFERING_MODE_STREAMING;
+        } else {
+            fprintf(stderr, "usage: %s [oneshot|circular|streaming]\n", argv[0]);
+            return 1;
+        }
+    }
+
     async::Loop loop;
-    BenchmarkHandler handler(&loop);
+    BenchmarkHandler handler(&loop, buffering_mode);
 
     RunTracingDisabledBenchmarks();
     handler.Start();
@@ -69,6 +69,7 @@ struct async_task {
 //
 // Returns |ZX_OK| if the task was successfully posted.
 // Returns |ZX_ERR_BAD_STATE| if the dispatcher shut down.
+// Returns |ZX_ERR_NO_MEMORY| if the dispatcher could not make room for the task.
 // Returns |ZX_ERR_NOT_SUPPORTED| if not supported by the dispatcher.
 //
 // See also |zx_deadline_after()|.
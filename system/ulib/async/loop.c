@@ -19,6 +19,9 @@
 // The port wait key associated with the dispatcher's control messages.
 #define KEY_CONTROL (0u)
 
+// The initial capacity of the pending task heap.
+#define TASK_HEAP_MIN_CAPACITY (16u)
+
 static zx_status_t async_loop_begin_wait(async_t* async, async_wait_t* wait);
 static zx_status_t async_loop_cancel_wait(async_t* async, async_wait_t* wait);
 static zx_status_t async_loop_post_task(async_t* async, async_task_t* task);
@@ -47,12 +50,20 @@ typedef struct async_loop {
     _Atomic async_loop_state_t state;
     atomic_uint active_threads; // number of active dispatch threads
 
-    mtx_t lock; // guards the lists and the dispatching tasks flag
-    bool dispatching_tasks; // true while the loop is busy dispatching tasks
+    mtx_t lock; // guards the wait and thread lists
     list_node_t wait_list; // most recently added first
-    list_node_t task_list; // pending tasks, earliest deadline first
-    list_node_t due_list; // due tasks, earliest deadline first
     list_node_t thread_list; // earliest created thread first
+
+    // Tasks have a lock of their own so that posting and dispatching them
+    // does not contend with threads handling waits.
+    mtx_t task_lock; // guards the task heap, the due list and the flag below
+    bool dispatching_tasks; // true while the loop is busy dispatching tasks
+    async_task_t** task_heap; // pending tasks, a binary min-heap on (deadline, seq)
+    size_t task_heap_count; // number of tasks in |task_heap|
+    size_t task_capacity; // number of slots allocated in |task_heap|
+    size_t task_count; // number of pending or due tasks
+    uint64_t task_seq; // post order of the next task, for breaking deadline ties
+    list_node_t due_list; // due tasks, earliest deadline first
 } async_loop_t;
 
 static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline);
@@ -64,6 +75,8 @@ static zx_status_t async_loop_dispatch_packet(async_loop_t* loop, async_receiver
 static void async_loop_wake_threads(async_loop_t* loop);
 static zx_status_t async_loop_wait_async(async_loop_t* loop, async_wait_t* wait);
 static void async_loop_insert_task_locked(async_loop_t* loop, async_task_t* task);
+static void async_loop_remove_task_locked(async_loop_t* loop, async_task_t* task);
+static async_task_t* async_loop_peek_task_locked(async_loop_t* loop);
 static void async_loop_restart_timer_locked(async_loop_t* loop);
 static void async_loop_invoke_prologue(async_loop_t* loop);
 static void async_loop_invoke_epilogue(async_loop_t* loop);
@@ -96,6 +109,22 @@ static inline async_task_t* node_to_task(list_node_t* node) {
     return FROM_NODE(async_task_t, node);
 }
 
+// While a task is in the task heap, the first word of its state holds its
+// index in the heap tagged with a low bit which a list node pointer never
+// has, and the second word holds its sequence number.  While it is in the
+// due list its state is a list node.  Otherwise its state is zero.
+static inline bool task_in_heap(async_task_t* task) {
+    return task->state.reserved[0] & 1u;
+}
+
+static inline size_t task_heap_index(async_task_t* task) {
+    return task->state.reserved[0] >> 1;
+}
+
+static inline uint64_t task_seq(async_task_t* task) {
+    return task->state.reserved[1];
+}
+
 zx_status_t async_loop_create(const async_loop_config_t* config, async_t** out_async) {
     ZX_DEBUG_ASSERT(out_async);
 
@@ -109,8 +138,8 @@ zx_status_t async_loop_create(const async_loop_config_t* config, async_t** out_a
     if (config)
         loop->config = *config;
     mtx_init(&loop->lock, mtx_plain);
+    mtx_init(&loop->task_lock, mtx_plain);
     list_initialize(&loop->wait_list);
-    list_initialize(&loop->task_list);
     list_initialize(&loop->due_list);
     list_initialize(&loop->thread_list);
 
@@ -144,6 +173,8 @@ void async_loop_destroy(async_t* async) {
     zx_handle_close(loop->port);
     zx_handle_close(loop->timer);
     mtx_destroy(&loop->lock);
+    mtx_destroy(&loop->task_lock);
+    free(loop->task_heap);
     free(loop);
 }
 
@@ -170,14 +201,17 @@ void async_loop_shutdown(async_t* async) {
     }
     while ((node = list_remove_head(&loop->due_list))) {
         async_task_t* task = node_to_task(node);
+        loop->task_count--;
         if (task->flags & ASYNC_FLAG_HANDLE_SHUTDOWN) {
             async_loop_invoke_prologue(loop);
             async_loop_invoke_task_handler(loop, task, ZX_ERR_CANCELED);
             async_loop_invoke_epilogue(loop);
         }
     }
-    while ((node = list_remove_head(&loop->task_list))) {
-        async_task_t* task = node_to_task(node);
+    async_task_t* task;
+    while ((task = async_loop_peek_task_locked(loop))) {
+        async_loop_remove_task_locked(loop, task);
+        loop->task_count--;
         if (task->flags & ASYNC_FLAG_HANDLE_SHUTDOWN) {
             async_loop_invoke_prologue(loop);
             async_loop_invoke_task_handler(loop, task, ZX_ERR_CANCELED);
@@ -289,7 +323,7 @@ static zx_status_t async_loop_dispatch_tasks(async_loop_t* loop) {
     // to cancel a later task which has also come due.  At most one thread
     // can dispatch tasks at any given moment (to preserve serial ordering).
     // Timer restarts are suppressed until we run out of tasks to dispatch.
-    mtx_lock(&loop->lock);
+    mtx_lock(&loop->task_lock);
     if (!loop->dispatching_tasks) {
         loop->dispatching_tasks = true;
 
@@ -299,20 +333,10 @@ static zx_status_t async_loop_dispatch_tasks(async_loop_t* loop) {
         list_node_t* node;
         if (list_is_empty(&loop->due_list)) {
             zx_time_t due_time = zx_clock_get(ZX_CLOCK_MONOTONIC);
-            list_node_t* tail = NULL;
-            list_for_every(&loop->task_list, node) {
-                if (node_to_task(node)->deadline > due_time)
-                    break;
-                tail = node;
-            }
-            if (tail) {
-                list_node_t* head = loop->task_list.next;
-                loop->task_list.next = tail->next;
-                tail->next->prev = &loop->task_list;
-                loop->due_list.next = head;
-                head->prev = &loop->due_list;
-                loop->due_list.prev = tail;
-                tail->next = &loop->due_list;
+            async_task_t* task;
+            while ((task = async_loop_peek_task_locked(loop)) && task->deadline <= due_time) {
+                async_loop_remove_task_locked(loop, task);
+                list_add_tail(&loop->due_list, task_to_node(task));
             }
         }
 
@@ -321,20 +345,24 @@ static zx_status_t async_loop_dispatch_tasks(async_loop_t* loop) {
         // item from the list.
         while ((node = list_remove_head(&loop->due_list))) {
             async_task_t* task = node_to_task(node);
-            mtx_unlock(&loop->lock);
+            mtx_unlock(&loop->task_lock);
 
             // Invoke the handler.  Note that it might destroy itself.
             async_loop_invoke_prologue(loop);
             async_task_result_t result = async_loop_invoke_task_handler(loop, task, ZX_OK);
 
-            mtx_lock(&loop->lock);
+            // The task still counts against |task_capacity|, so there is
+            // room to reinsert it.
+            mtx_lock(&loop->task_lock);
             if (result == ASYNC_TASK_REPEAT)
                 async_loop_insert_task_locked(loop, task);
-            mtx_unlock(&loop->lock);
+            else
+                loop->task_count--;
+            mtx_unlock(&loop->task_lock);
 
             async_loop_invoke_epilogue(loop);
 
-            mtx_lock(&loop->lock);
+            mtx_lock(&loop->task_lock);
             async_loop_state_t state = atomic_load_explicit(&loop->state, memory_order_acquire);
             if (state != ASYNC_LOOP_RUNNABLE)
                 break;
@@ -343,7 +371,7 @@ static zx_status_t async_loop_dispatch_tasks(async_loop_t* loop) {
         loop->dispatching_tasks = false;
         async_loop_restart_timer_locked(loop);
     }
-    mtx_unlock(&loop->lock);
+    mtx_unlock(&loop->task_lock);
     return ZX_OK;
 }
 
@@ -474,16 +502,27 @@ static zx_status_t async_loop_post_task(async_t* async, async_task_t* task) {
     if (atomic_load_explicit(&loop->state, memory_order_acquire) == ASYNC_LOOP_SHUTDOWN)
         return ZX_ERR_BAD_STATE;
 
-    mtx_lock(&loop->lock);
+    mtx_lock(&loop->task_lock);
+
+    if (loop->task_count == loop->task_capacity) {
+        size_t capacity = loop->task_capacity ? loop->task_capacity * 2u : TASK_HEAP_MIN_CAPACITY;
+        async_task_t** heap = realloc(loop->task_heap, capacity * sizeof(async_task_t*));
+        if (!heap) {
+            mtx_unlock(&loop->task_lock);
+            return ZX_ERR_NO_MEMORY;
+        }
+        loop->task_heap = heap;
+        loop->task_capacity = capacity;
+    }
+    loop->task_count++;
 
     async_loop_insert_task_locked(loop, task);
-    if (!loop->dispatching_tasks &&
-        task_to_node(task)->prev == &loop->task_list) {
+    if (!loop->dispatching_tasks && task_heap_index(task) == 0u) {
         // Task inserted at head.  Earliest deadline changed.
         async_loop_restart_timer_locked(loop);
     }
 
-    mtx_unlock(&loop->lock);
+    mtx_unlock(&loop->task_lock);
     return ZX_OK;
 }
 
@@ -496,25 +535,26 @@ static zx_status_t async_loop_cancel_task(async_t* async, async_task_t* task) {
     // destroyed in case the client is counting on the handler not being
     // invoked again past this point.  Also, the task we're removing here
     // might be present in the dispatcher's |due_list| if it is pending
-    // dispatch instead of in the loop's |task_list| as usual.  The same
-    // logic works in both cases.
-
-    mtx_lock(&loop->lock);
-    list_node_t* node = task_to_node(task);
-    if (!list_in_list(node)) {
-        mtx_unlock(&loop->lock);
+    // dispatch instead of in the loop's |task_heap| as usual.
+
+    mtx_lock(&loop->task_lock);
+    if (task_in_heap(task)) {
+        bool was_head = task_heap_index(task) == 0u;
+        async_loop_remove_task_locked(loop, task);
+        async_task_t* head = async_loop_peek_task_locked(loop);
+        if (!loop->dispatching_tasks && was_head &&
+            head && head->deadline > task->deadline) {
+            // The head task was canceled and following task has a later deadline.
+            async_loop_restart_timer_locked(loop);
+        }
+    } else if (list_in_list(task_to_node(task))) {
+        list_delete(task_to_node(task));
+    } else {
+        mtx_unlock(&loop->task_lock);
         return ZX_ERR_NOT_FOUND;
     }
-
-    if (!loop->dispatching_tasks &&
-        node->prev == &loop->task_list &&
-        node->next != &loop->task_list &&
-        node_to_task(node->next)->deadline > task->deadline) {
-        // The head task was canceled and following task has a later deadline.
-        async_loop_restart_timer_locked(loop);
-    }
-    list_delete(node);
-    mtx_unlock(&loop->lock);
+    loop->task_count--;
+    mtx_unlock(&loop->task_lock);
     return ZX_OK;
 }
 
@@ -542,26 +582,81 @@ static zx_status_t async_loop_wait_async(async_loop_t* loop, async_wait_t* wait)
                                 ZX_WAIT_ASYNC_ONCE);
 }
 
-static void async_loop_insert_task_locked(async_loop_t* loop, async_task_t* task) {
-    // TODO(ZX-976): We assume that tasks are inserted in quasi-monotonic order and
-    // that insertion into the task queue will typically take no more than a few steps.
-    // If this assumption proves false and the cost of insertion becomes a problem, we
-    // should consider using a more efficient representation for maintaining order.
-    list_node_t* node;
-    for (node = loop->task_list.prev; node != &loop->task_list; node = node->prev) {
-        if (task->deadline >= node_to_task(node)->deadline)
+// Tasks with equal deadlines run in the order they were posted, so the heap
+// orders them by sequence number after deadline.
+static inline bool task_before(async_task_t* a, async_task_t* b) {
+    if (a->deadline != b->deadline)
+        return a->deadline < b->deadline;
+    return task_seq(a) < task_seq(b);
+}
+
+static inline void task_heap_set(async_loop_t* loop, size_t index, async_task_t* task) {
+    loop->task_heap[index] = task;
+    task->state.reserved[0] = (index << 1) | 1u;
+}
+
+static void task_heap_sift_up(async_loop_t* loop, size_t index) {
+    async_task_t* task = loop->task_heap[index];
+    while (index > 0u) {
+        size_t parent = (index - 1u) / 2u;
+        if (!task_before(task, loop->task_heap[parent]))
             break;
+        task_heap_set(loop, index, loop->task_heap[parent]);
+        index = parent;
     }
-    list_add_after(node, task_to_node(task));
+    task_heap_set(loop, index, task);
+}
+
+static void task_heap_sift_down(async_loop_t* loop, size_t index) {
+    async_task_t* task = loop->task_heap[index];
+    size_t count = loop->task_heap_count;
+    for (;;) {
+        size_t child = index * 2u + 1u;
+        if (child >= count)
+            break;
+        if (child + 1u < count && task_before(loop->task_heap[child + 1u], loop->task_heap[child]))
+            child++;
+        if (!task_before(loop->task_heap[child], task))
+            break;
+        task_heap_set(loop, index, loop->task_heap[child]);
+        index = child;
+    }
+    task_heap_set(loop, index, task);
+}
+
+static void async_loop_insert_task_locked(async_loop_t* loop, async_task_t* task) {
+    ZX_DEBUG_ASSERT(loop->task_heap_count < loop->task_capacity);
+    task->state.reserved[1] = loop->task_seq++;
+    size_t index = loop->task_heap_count++;
+    loop->task_heap[index] = task;
+    task_heap_sift_up(loop, index);
+}
+
+static void async_loop_remove_task_locked(async_loop_t* loop, async_task_t* task) {
+    size_t index = task_heap_index(task);
+    ZX_DEBUG_ASSERT(index < loop->task_heap_count && loop->task_heap[index] == task);
+    size_t last = --loop->task_heap_count;
+    if (index != last) {
+        async_task_t* moved = loop->task_heap[last];
+        task_heap_set(loop, index, moved);
+        if (index > 0u && task_before(moved, loop->task_heap[(index - 1u) / 2u]))
+            task_heap_sift_up(loop, index);
+        else
+            task_heap_sift_down(loop, index);
+    }
+    task->state = (async_state_t)ASYNC_STATE_INIT;
+}
+
+static async_task_t* async_loop_peek_task_locked(async_loop_t* loop) {
+    return loop->task_heap_count ? loop->task_heap[0] : NULL;
 }
 
 static void async_loop_restart_timer_locked(async_loop_t* loop) {
     zx_time_t deadline;
     if (list_is_empty(&loop->due_list)) {
-        list_node_t* head = list_peek_head(&loop->task_list);
-        if (!head)
+        async_task_t* task = async_loop_peek_task_locked(loop);
+        if (!task)
             return;
-        async_task_t* task = node_to_task(head);
         deadline = task->deadline;
         if (deadline == ZX_TIME_INFINITE)
             return;
@@ -0,0 +1,260 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <bitmap/hierarchical-bitmap.h>
+
+#include <limits.h>
+#include <stddef.h>
+
+#include <zircon/types.h>
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/array.h>
+
+namespace {
+
+constexpr size_t kOnes = ~static_cast<size_t>(0);
+
+// Counts trailing zeros of a nonzero word.
+#if (SIZE_MAX == UINT_MAX)
+#define CTZ(x) __builtin_ctz(x)
+#elif (SIZE_MAX == ULONG_MAX)
+#define CTZ(x) __builtin_ctzl(x)
+#elif (SIZE_MAX == ULLONG_MAX)
+#define CTZ(x) __builtin_ctzll(x)
+#else
+#error "Unsupported size_t length"
+#endif
+size_t FirstSetBit(size_t value) {
+    ZX_DEBUG_ASSERT(value != 0);
+    return CTZ(value);
+}
+#undef CTZ
+
+// Returns the mask of bits in word |idx| which lie below |size|.
+size_t ValidMask(size_t idx, size_t size) {
+    size_t end = size - idx * bitmap::kBits;
+    return end >= bitmap::kBits ? kOnes : ~(kOnes << end);
+}
+
+} // namespace
+
+namespace bitmap {
+namespace internal {
+
+zx_status_t UniformSummary::Reset(size_t words) {
+    for (size_t i = 0; i < levels_; ++i) {
+        level_[i].reset();
+        bits_[i] = 0;
+    }
+    levels_ = 0;
+
+    size_t bits = words;
+    while (bits > 0) {
+        ZX_DEBUG_ASSERT(levels_ < kMaxLevels);
+        size_t len = LastIdx(bits) + 1;
+        fbl::AllocChecker ac;
+        size_t* arr = new (&ac) size_t[len];
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        // Everything starts out clear, except the padding past |bits|.
+        memset(arr, 0, len * sizeof(size_t));
+        arr[len - 1] = ~ValidMask(len - 1, bits);
+        level_[levels_].reset(arr, len);
+        bits_[levels_] = bits;
+        ++levels_;
+        if (len == 1) {
+            break;
+        }
+        bits = len;
+    }
+    return ZX_OK;
+}
+
+void UniformSummary::Shrink(size_t words) {
+    size_t bits = words;
+    size_t kept = 0;
+    while (kept < levels_ && bits > 0) {
+        size_t len = LastIdx(bits) + 1;
+        bits_[kept] = bits;
+        // Pad out the new last word, and tell the level above whether that
+        // has made it full.
+        level_[kept][len - 1] |= ~ValidMask(len - 1, bits);
+        ++kept;
+        if (len == 1) {
+            break;
+        }
+        size_t* parent = &level_[kept][(len - 1) / kBits];
+        size_t bit = static_cast<size_t>(1) << ((len - 1) % kBits);
+        *parent = level_[kept - 1][len - 1] == kOnes ? (*parent | bit) : (*parent & ~bit);
+        bits = len;
+    }
+    for (size_t i = kept; i < levels_; ++i) {
+        level_[i].reset();
+        bits_[i] = 0;
+    }
+    levels_ = kept;
+}
+
+void UniformSummary::Update(size_t idx, bool uniform) {
+    for (size_t i = 0; i < levels_; ++i) {
+        size_t* word = &level_[i][idx / kBits];
+        size_t bit = static_cast<size_t>(1) << (idx % kBits);
+        size_t old_value = *word;
+        *word = uniform ? (old_value | bit) : (old_value & ~bit);
+        bool was_full = old_value == kOnes;
+        bool is_full = *word == kOnes;
+        if (was_full == is_full) {
+            return;
+        }
+        uniform = is_full;
+        idx /= kBits;
+    }
+}
+
+size_t UniformSummary::FindClear(size_t level, size_t idx) const {
+    size_t bits = bits_[level];
+    if (idx >= bits) {
+        return bits;
+    }
+    size_t word_idx = idx / kBits;
+    size_t value = ~level_[level][word_idx] & (kOnes << (idx % kBits));
+    if (value == 0) {
+        // The rest of this word is full; ask the level above which word of
+        // this level is the next one with anything clear in it.
+        if (level + 1 == levels_) {
+            return bits;
+        }
+        word_idx = FindClear(level + 1, word_idx + 1);
+        if (word_idx >= bits_[level + 1]) {
+            return bits;
+        }
+        value = ~level_[level][word_idx];
+    }
+    // Padding bits are always set, so this never lands past |bits|.
+    return word_idx * kBits + FirstSetBit(value);
+}
+
+size_t UniformSummary::FindNonUniform(size_t idx) const {
+    if (levels_ == 0) {
+        return 0;
+    }
+    return FindClear(0, idx);
+}
+
+} // namespace internal
+
+size_t HierarchicalBitmapBase::Scan(size_t bitoff, size_t bitmax, bool is_set) const {
+    bitmax = fbl::min(bitmax, size_);
+    if (bitoff >= bitmax) {
+        return bitmax;
+    }
+    // Bits which differ from |is_set| are set in |value|.
+    size_t invert = is_set ? kOnes : 0;
+    size_t idx = bitoff / kBits;
+    size_t value = (data_[idx] ^ invert) & (kOnes << (bitoff % kBits));
+    if (value == 0) {
+        idx = summary_[is_set].FindNonUniform(idx + 1);
+        if (idx * kBits >= bitmax) {
+            return bitmax;
+        }
+        value = data_[idx] ^ invert;
+    }
+    return fbl::min(bitmax, idx * kBits + FirstSetBit(value));
+}
+
+zx_status_t HierarchicalBitmapBase::Find(bool is_set, size_t bitoff, size_t bitmax,
+                                         size_t run_len, size_t* out) const {
+    if (!out || bitmax <= bitoff) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    size_t start = bitoff;
+    while (bitoff - start < run_len && bitoff < bitmax) {
+        start = Scan(bitoff, bitmax, !is_set);
+        if (bitmax - start < run_len) {
+            *out = bitmax;
+            return ZX_ERR_NO_RESOURCES;
+        }
+        bitoff = Scan(start, start + run_len, is_set);
+    }
+    *out = start;
+    return ZX_OK;
+}
+
+bool HierarchicalBitmapBase::Get(size_t bitoff, size_t bitmax, size_t* first) const {
+    bitmax = fbl::min(bitmax, size_);
+    size_t result = Scan(bitoff, bitmax, true);
+    if (first) {
+        *first = result;
+    }
+    return result == bitmax;
+}
+
+zx_status_t HierarchicalBitmapBase::Set(size_t bitoff, size_t bitmax) {
+    zx_status_t status = RawBitmapBase::Set(bitoff, bitmax);
+    if (status == ZX_OK && bitoff != bitmax) {
+        UpdateSummary(bitoff / kBits, LastIdx(bitmax));
+    }
+    return status;
+}
+
+zx_status_t HierarchicalBitmapBase::Clear(size_t bitoff, size_t bitmax) {
+    zx_status_t status = RawBitmapBase::Clear(bitoff, bitmax);
+    if (status == ZX_OK && bitoff != bitmax) {
+        UpdateSummary(bitoff / kBits, LastIdx(bitmax));
+    }
+    return status;
+}
+
+zx_status_t HierarchicalBitmapBase::Shrink(size_t size) {
+    zx_status_t status = RawBitmapBase::Shrink(size);
+    if (status != ZX_OK) {
+        return status;
+    }
+    size_t words = size_ == 0 ? 0 : LastIdx(size_) + 1;
+    summary_[false].Shrink(words);
+    summary_[true].Shrink(words);
+    // The last word may have lost the bits which kept it from being uniform.
+    if (words > 0) {
+        UpdateSummary(words - 1, words - 1);
+    }
+    return ZX_OK;
+}
+
+void HierarchicalBitmapBase::ClearAll() {
+    RawBitmapBase::ClearAll();
+    RebuildSummary();
+}
+
+void HierarchicalBitmapBase::RebuildSummary() {
+    if (size_ == 0) {
+        return;
+    }
+    UpdateSummary(0, LastIdx(size_));
+}
+
+zx_status_t HierarchicalBitmapBase::ResetSummary() {
+    size_t words = size_ == 0 ? 0 : LastIdx(size_) + 1;
+    zx_status_t status;
+    if ((status = summary_[false].Reset(words)) != ZX_OK) {
+        return status;
+    }
+    if ((status = summary_[true].Reset(words)) != ZX_OK) {
+        return status;
+    }
+    RebuildSummary();
+    return ZX_OK;
+}
+
+void HierarchicalBitmapBase::UpdateSummary(size_t first_idx, size_t last_idx) {
+    for (size_t i = first_idx; i <= last_idx; ++i) {
+        size_t mask = ValidMask(i, size_);
+        size_t value = data_[i] & mask;
+        summary_[false].Update(i, value == 0);
+        summary_[true].Update(i, value == mask);
+    }
+}
+
+} // namespace bitmap
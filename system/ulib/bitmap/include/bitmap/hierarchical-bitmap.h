@@ -0,0 +1,200 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <bitmap/raw-bitmap.h>
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <zircon/assert.h>
+#include <zircon/types.h>
+#include <fbl/algorithm.h>
+#include <fbl/array.h>
+#include <fbl/macros.h>
+#include <fbl/type_support.h>
+
+namespace bitmap {
+namespace internal {
+
+// A tree of summary words over the words of a raw bitmap.
+//
+// Bit i of level 0 is set when word i of the raw bitmap is "uniform" (every
+// valid bit in it has the value being summarized).  Bit j of level n + 1 is
+// set when word j of level n is entirely set.  Padding bits past the end of
+// each level are kept set, so the top level is always a single word and a
+// search never has to look at more than one word per level.
+class UniformSummary {
+public:
+    UniformSummary() = default;
+    DISALLOW_COPY_AND_ASSIGN_ALLOW_MOVE(UniformSummary);
+    UniformSummary(UniformSummary&& rhs) = default;
+    UniformSummary& operator=(UniformSummary&& rhs) = default;
+
+    // Allocates summary levels for |words| raw bitmap words, all of which are
+    // initially marked non-uniform.
+    zx_status_t Reset(size_t words);
+
+    // Cuts the summary down to the first |words| raw bitmap words, treating
+    // everything past them as padding.  Does not allocate.  The uniformity of
+    // the new last word must be refreshed with Update afterwards.
+    void Shrink(size_t words);
+
+    // Records whether raw bitmap word |idx| is uniform, propagating the change
+    // up the tree only as far as it alters a summary word's fullness.
+    void Update(size_t idx, bool uniform);
+
+    // Returns the index of the first raw bitmap word at or after |idx| that
+    // is not uniform, or the number of summarized words if there is none.
+    size_t FindNonUniform(size_t idx) const;
+
+private:
+    // Returns the first clear bit at or after |idx| in |level|, or the number
+    // of bits in the level if there is none.
+    size_t FindClear(size_t level, size_t idx) const;
+
+    // Enough levels to summarize any bitmap addressable by size_t.
+    static constexpr size_t kMaxLevels = (sizeof(size_t) * CHAR_BIT + 5) / 6;
+
+    size_t levels_ = 0;
+    // Number of meaningful bits in each level.
+    size_t bits_[kMaxLevels] = {};
+    fbl::Array<size_t> level_[kMaxLevels];
+};
+
+} // namespace internal
+
+// Base class for HierarchicalBitmapGeneric, to reduce what needs to be
+// templated.
+//
+// A raw bitmap which additionally tracks, for each word, whether that word is
+// entirely set or entirely clear.  Scan (and therefore Find and Get) use these
+// summaries to skip over full or empty regions in O(log n) rather than
+// visiting every word between |bitoff| and the result, which keeps allocation
+// cheap on large, nearly-full bitmaps.  Set and Clear pay for this with a
+// summary update per modified word.
+class HierarchicalBitmapBase : public RawBitmapBase {
+public:
+    // Returns the lesser of bitmax and the index of the first bit that doesn't
+    // match *is_set* starting from *bitoff*.
+    size_t Scan(size_t bitoff, size_t bitmax, bool is_set) const;
+
+    // Find a run of *run_len* *is_set* bits, between bitoff and bitmax.
+    // Returns the start of the run in *out*, or bitmax if it is
+    // not found in the provided range.
+    // If the run is not found, "ZX_ERR_NO_RESOURCES" is returned.
+    zx_status_t Find(bool is_set, size_t bitoff, size_t bitmax, size_t run_len, size_t* out) const;
+
+    bool Get(size_t bitoff, size_t bitmax,
+             size_t* first_unset = nullptr) const override;
+    zx_status_t Set(size_t bitoff, size_t bitmax) override;
+    zx_status_t Clear(size_t bitoff, size_t bitmax) override;
+    void ClearAll() override;
+
+    // Shrinks the accessible portion of the bitmap, without re-allocating,
+    // and trims the summaries to match.
+    zx_status_t Shrink(size_t size);
+
+    // Recomputes the summaries from the underlying storage. Must be called
+    // after the storage has been modified without going through this class,
+    // for example after reading the bitmap in from disk.
+    void RebuildSummary();
+
+protected:
+    // Allocates summaries for the current size_ and computes them from data_.
+    zx_status_t ResetSummary();
+
+private:
+    // Refreshes the summaries of raw bitmap words [first_idx, last_idx].
+    void UpdateSummary(size_t first_idx, size_t last_idx);
+
+    // Indexed by the value the summary tracks: summary_[true] records words
+    // that are entirely set, summary_[false] words that are entirely clear.
+    internal::UniformSummary summary_[2];
+};
+
+// A raw bitmap backed by generic storage, with summaries for fast searching.
+// Storage has the same requirements as for RawBitmapGeneric; the summaries
+// themselves are always heap allocated.
+template <typename Storage>
+class HierarchicalBitmapGeneric final : public HierarchicalBitmapBase {
+public:
+    HierarchicalBitmapGeneric() = default;
+    virtual ~HierarchicalBitmapGeneric() = default;
+    HierarchicalBitmapGeneric(HierarchicalBitmapGeneric&& rhs) = default;
+    HierarchicalBitmapGeneric& operator=(HierarchicalBitmapGeneric&& rhs) = default;
+    DISALLOW_COPY_AND_ASSIGN_ALLOW_MOVE(HierarchicalBitmapGeneric);
+
+    // Increases the bitmap size
+    template <typename U = Storage>
+    typename fbl::enable_if<internal::has_grow<U>::value, zx_status_t>::type
+    Grow(size_t size) {
+        if (size < size_) {
+            return ZX_ERR_INVALID_ARGS;
+        } else if (size == size_) {
+            return ZX_OK;
+        }
+
+        size_t old_len = LastIdx(size_) + 1;
+        size_t new_len = LastIdx(size) + 1;
+        size_t new_bitsize = sizeof(size_t) * new_len;
+        ZX_ASSERT(new_bitsize >= new_len); // Overflow
+        zx_status_t status = bits_.Grow(new_bitsize);
+        if (status != ZX_OK) {
+            return status;
+        }
+
+        // Clear all the "newly grown" bytes
+        uintptr_t addr = reinterpret_cast<uintptr_t>(bits_.GetData()) + old_len * sizeof(size_t);
+        memset(reinterpret_cast<void*>(addr), 0, (new_len - old_len) * sizeof(size_t));
+
+        size_t old_size = size_;
+        data_ = static_cast<size_t*>(bits_.GetData());
+        size_ = size;
+
+        // Clear the partial bits not included in the new "size_t"s, and
+        // resize the summaries to match.
+        RawBitmapBase::Clear(old_size, fbl::min(old_len * kBits, size_));
+        return ResetSummary();
+    }
+
+    template <typename U = Storage>
+    typename fbl::enable_if<!internal::has_grow<U>::value, zx_status_t>::type
+    Grow(size_t size) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+
+    // Resets the bitmap; clearing and resizing it.
+    // Allocates memory, and can fail.
+    zx_status_t Reset(size_t size) {
+        size_ = size;
+        if (size_ == 0) {
+            data_ = nullptr;
+            return ResetSummary();
+        }
+        size_t last_idx = LastIdx(size);
+        zx_status_t status = bits_.Allocate(sizeof(size_t) * (last_idx + 1));
+        if (status != ZX_OK) {
+            return status;
+        }
+        data_ = static_cast<size_t*>(bits_.GetData());
+        RawBitmapBase::ClearAll();
+        return ResetSummary();
+    }
+
+    // This function allows access to underlying data, but is dangerous: It
+    // leaks the pointer to bits_. Reset and the bitmap destructor should not
+    // be called on the bitmap while the pointer returned from data() is alive.
+    // RebuildSummary must be called after modifying the data through it.
+    const Storage* StorageUnsafe() const { return &bits_; }
+
+private:
+    // The storage backing this bitmap.
+    Storage bits_;
+};
+
+} // namespace bitmap
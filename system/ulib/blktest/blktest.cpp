@@ -4,6 +4,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -912,6 +913,99 @@ bool blkdev_test_fifo_bad_client_bad_vmo(void) {
     END_TEST;
 }
 
+// Times sequential fifo transfers of |xfer| bytes covering the first |total| bytes of the device.
+// Returns the throughput in MB/s via |out|.
+static bool time_fifo_transfers(fifo_client_t* client, txnid_t txnid, vmoid_t vmoid,
+                                uint16_t opcode, uint64_t blk_size, size_t xfer, size_t total,
+                                uint64_t* out) {
+    block_fifo_request_t requests[MAX_TXN_MESSAGES];
+    size_t xfer_blks = xfer / blk_size;
+    zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    for (size_t off = 0; off < total;) {
+        size_t n = 0;
+        for (; n < fbl::count_of(requests) && off < total; ++n, off += xfer) {
+            requests[n].txnid      = txnid;
+            requests[n].vmoid      = vmoid;
+            requests[n].opcode     = opcode;
+            requests[n].length     = static_cast<uint32_t>(xfer_blks);
+            requests[n].vmo_offset = n * xfer_blks;
+            requests[n].dev_offset = off / blk_size;
+        }
+        ASSERT_EQ(block_fifo_txn(client, requests, n), ZX_OK, "");
+    }
+    zx_duration_t elapsed = fbl::max(zx_clock_get(ZX_CLOCK_MONOTONIC) - start,
+                                     static_cast<zx_duration_t>(1));
+    *out = (total * ZX_SEC(1)) / (elapsed * 1024 * 1024);
+    return true;
+}
+
+// Measures sequential write and read throughput over the block fifo for a range of transfer
+// sizes.  Like the other tests it overwrites the start of the device, up to 64 MB.  Running it
+// with BLKTEST_BLK_DEV naming a ramdisk and then a zxcrypt volume on the same ramdisk shows the
+// cost of encryption.
+bool blkdev_test_fifo_throughput(void) {
+    BEGIN_TEST;
+    uint64_t blk_size, blk_count;
+    int fd = get_testdev(&blk_size, &blk_count);
+    block_info_t info;
+    ASSERT_GE(ioctl_block_get_info(fd, &info), 0, "Could not get block info");
+    size_t max_xfer = info.max_transfer_size == 0 ? (1 << 20) : info.max_transfer_size;
+
+    zx_handle_t fifo;
+    ssize_t expected = sizeof(fifo);
+    ASSERT_EQ(ioctl_block_get_fifos(fd, &fifo), expected, "Failed to get FIFO");
+    txnid_t txnid;
+    expected = sizeof(txnid);
+    ASSERT_EQ(ioctl_block_alloc_txn(fd, &txnid), expected, "Failed to allocate txn");
+    fifo_client_t* client;
+    ASSERT_EQ(block_fifo_create_client(fifo, &client), ZX_OK, "");
+
+    // Use enough of the VMO for a full batch of the largest transfers.
+    const size_t kXferSizes[] = {4 * 1024, 64 * 1024, 256 * 1024, 1024 * 1024};
+    const size_t kMaxTotal = 64 * 1024 * 1024;
+    size_t vmo_size = fbl::round_up(fbl::min(max_xfer, kXferSizes[fbl::count_of(kXferSizes) - 1]),
+                                    blk_size) * MAX_TXN_MESSAGES;
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(vmo_size, 0, &vmo), ZX_OK, "Failed to create VMO");
+    ASSERT_EQ(zx_vmo_op_range(vmo, ZX_VMO_OP_COMMIT, 0, vmo_size, nullptr, 0), ZX_OK, "");
+    vmoid_t vmoid;
+    zx_handle_t xfer_vmo;
+    expected = sizeof(vmoid_t);
+    ASSERT_EQ(zx_handle_duplicate(vmo, ZX_RIGHT_SAME_RIGHTS, &xfer_vmo), ZX_OK, "");
+    ASSERT_EQ(ioctl_block_attach_vmo(fd, &xfer_vmo, &vmoid), expected, "Failed to attach vmo");
+
+    const char* blkdev_path = getenv(BLKTEST_BLK_DEV);
+    for (size_t xfer : kXferSizes) {
+        xfer = fbl::round_up(xfer, blk_size);
+        if (xfer > max_xfer) {
+            break;
+        }
+        size_t total = fbl::round_down(fbl::min(blk_count * blk_size, kMaxTotal), xfer);
+        if (total == 0) {
+            break;
+        }
+        uint64_t write_mbps, read_mbps;
+        ASSERT_TRUE(time_fifo_transfers(client, txnid, vmoid, BLOCKIO_WRITE, blk_size, xfer,
+                                        total, &write_mbps), "");
+        ASSERT_TRUE(time_fifo_transfers(client, txnid, vmoid, BLOCKIO_READ, blk_size, xfer,
+                                        total, &read_mbps), "");
+        printf("\n%s: %4zu KB transfers: write %5" PRIu64 " MB/s, read %5" PRIu64 " MB/s",
+               blkdev_path, xfer / 1024, write_mbps, read_mbps);
+    }
+    printf("\n");
+
+    block_fifo_request_t request;
+    request.txnid = txnid;
+    request.vmoid = vmoid;
+    request.opcode = BLOCKIO_CLOSE_VMO;
+    ASSERT_EQ(block_fifo_txn(client, &request, 1), ZX_OK, "");
+    ASSERT_EQ(zx_handle_close(vmo), ZX_OK, "");
+    block_fifo_release_client(client);
+    ASSERT_EQ(ioctl_block_fifo_close(fd), ZX_OK, "Failed to close fifo");
+    close(fd);
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(blkdev_tests)
 RUN_TEST(blkdev_test_simple)
 RUN_TEST(blkdev_test_bad_requests)
@@ -932,6 +1026,7 @@ RUN_TEST(blkdev_test_fifo_bad_client_txnid)
 RUN_TEST(blkdev_test_fifo_bad_client_unaligned_request)
 RUN_TEST(blkdev_test_fifo_bad_client_overflow)
 RUN_TEST(blkdev_test_fifo_bad_client_bad_vmo)
+RUN_TEST_PERFORMANCE(blkdev_test_fifo_throughput)
 END_TEST_CASE(blkdev_tests)
 
 } // namespace tests
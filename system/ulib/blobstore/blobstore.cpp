@@ -17,6 +17,7 @@
 #include <zircon/syscalls.h>
 #include <fdio/debug.h>
 #include <fbl/alloc_checker.h>
+#include <fbl/auto_call.h>
 #include <fbl/limits.h>
 #include <fbl/ref_ptr.h>
 #include <zx/event.h>
@@ -24,6 +25,7 @@
 #define ZXDEBUG 0
 
 #include <blobstore/blobstore.h>
+#include <blobstore/compression.h>
 
 using digest::Digest;
 using digest::MerkleTree;
@@ -106,6 +108,16 @@ zx_status_t CheckFvmConsistency(const blobstore_info_t* info, int block_fd) {
     return ZX_OK;
 }
 
+// Blob data is read and verified in whole blocks, each of which is exactly
+// one leaf node of the Merkle tree.
+static_assert(kBlobstoreBlockSize == MerkleTree::kNodeSize,
+              "Blobstore blocks must match Merkle tree nodes");
+
+// When a read misses, unverified blocks up to this many past the end of the
+// request are fetched in the same transaction, so that small sequential reads
+// do not each cost a round trip to the block device.
+constexpr uint64_t kReadAheadBlocks = 16;
+
 }  // namespace
 
 
@@ -118,10 +130,6 @@ zx_status_t VnodeBlob::Verify() const {
     ZX_DEBUG_ASSERT(blob_ != nullptr);
 
     const blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
-    // TODO(smklein): We could lazily verify more of the VMO if
-    // we could fault in pages on-demand.
-    //
-    // For now, we aggressively verify the entire VMO up front.
     Digest d;
     d = reinterpret_cast<const uint8_t*>(&digest_[0]);
     return MerkleTree::Verify(GetData(), inode->blob_size, GetMerkle(),
@@ -139,7 +147,9 @@ zx_status_t VnodeBlob::InitVmos() {
     zx_status_t status;
     const blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
 
-    uint64_t num_blocks = BlobDataBlocks(*inode) + MerkleTreeBlocks(*inode);
+    uint64_t data_blocks = BlobDataBlocks(*inode);
+    uint64_t merkle_blocks = MerkleTreeBlocks(*inode);
+    uint64_t num_blocks = data_blocks + merkle_blocks;
     if ((status = MappedVmo::Create(num_blocks * kBlobstoreBlockSize, "blob", &blob_)) != ZX_OK) {
         FS_TRACE_ERROR("Failed to initialize vmo; error: %d\n", status);
         BlobCloseHandles();
@@ -150,15 +160,215 @@ zx_status_t VnodeBlob::InitVmos() {
         BlobCloseHandles();
         return status;
     }
+    if ((status = verified_.Reset(data_blocks)) != ZX_OK) {
+        BlobCloseHandles();
+        return status;
+    }
+
+    if (BlobIsCompressed(*inode)) {
+        return InitCompressedVmos();
+    }
+
+    if (data_blocks == 0) {
+        // There is nothing to read, but the digest must still be that of
+        // the empty blob.
+        return Verify();
+    }
+
+    if (merkle_blocks > 0) {
+        ReadTxn txn(blobstore_.get());
+        txn.Enqueue(vmoid_, 0, inode->start_block + DataStartBlock(blobstore_->info_),
+                    merkle_blocks);
+        if ((status = txn.Flush()) != ZX_OK) {
+            return status;
+        }
+    }
+    return ZX_OK;
+}
+
+zx_status_t VnodeBlob::LoadAndVerify(size_t off, size_t len) {
+    TRACE_DURATION("blobstore", "Blobstore::LoadAndVerify", "off", off, "len", len);
+    ZX_DEBUG_ASSERT(blob_ != nullptr);
+
+    if (len == 0) {
+        return ZX_OK;
+    }
+    const blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
+    uint64_t data_blocks = BlobDataBlocks(*inode);
+    uint64_t first = off / kBlobstoreBlockSize;
+    uint64_t last = fbl::round_up(off + len, kBlobstoreBlockSize) / kBlobstoreBlockSize;
+    if (verified_.Get(first, last)) {
+        return ZX_OK;
+    }
+    zx_status_t status;
+    if (BlobIsCompressed(*inode)) {
+        // Compressed data can only be decompressed a whole LZ4 block at a
+        // time, so verify whole LZ4 blocks too.
+        first = fbl::round_down(first, kBlobstoreBlocksPerLZ4Block);
+        last = fbl::min(fbl::round_up(last, kBlobstoreBlocksPerLZ4Block), data_blocks);
+    }
+    uint64_t readahead_last = fbl::min(last + kReadAheadBlocks, data_blocks);
+
+    if (BlobIsCompressed(*inode)) {
+        if ((status = LoadCompressedBlocks(first, last, readahead_last)) != ZX_OK) {
+            return status;
+        }
+    } else {
+        // Read every missing block in the window with a single transaction.
+        uint64_t merkle_blocks = MerkleTreeBlocks(*inode);
+        uint64_t dev_start = inode->start_block + DataStartBlock(blobstore_->info_) +
+                             merkle_blocks;
+        ReadTxn txn(blobstore_.get());
+        uint64_t start = verified_.Scan(first, readahead_last, true);
+        while (start < readahead_last) {
+            uint64_t end = verified_.Scan(start, readahead_last, false);
+            txn.Enqueue(vmoid_, merkle_blocks + start, dev_start + start, end - start);
+            start = verified_.Scan(end, readahead_last, true);
+        }
+        if ((status = txn.Flush()) != ZX_OK) {
+            return status;
+        }
+    }
+
+    if ((status = VerifyBlocks(first, last)) != ZX_OK) {
+        FS_TRACE_ERROR("blobstore: Failed to verify blob data; error: %d\n", status);
+        return status;
+    }
+    // Read-ahead is opportunistic: blocks which fail to verify are simply
+    // left unmarked, and will be read again (and fail) if they are requested.
+    VerifyBlocks(last, readahead_last);
+    return ZX_OK;
+}
+
+zx_status_t VnodeBlob::VerifyBlocks(uint64_t first, uint64_t last) {
+    TRACE_DURATION("blobstore", "Blobstore::VerifyBlocks", "first", first, "last", last);
+
+    const blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
+    size_t merkle_size = MerkleTree::GetTreeLength(inode->blob_size);
+    Digest d;
+    d = reinterpret_cast<const uint8_t*>(&digest_[0]);
 
+    uint64_t start = verified_.Scan(first, last, true);
+    while (start < last) {
+        uint64_t end = verified_.Scan(start, last, false);
+        size_t data_off = start * kBlobstoreBlockSize;
+        size_t data_len = fbl::min(end * kBlobstoreBlockSize, inode->blob_size) - data_off;
+        zx_status_t status = MerkleTree::Verify(GetData(), inode->blob_size, GetMerkle(),
+                                                merkle_size, data_off, data_len, d);
+        if (status != ZX_OK) {
+            return status;
+        }
+        verified_.Set(start, end);
+        start = verified_.Scan(end, last, true);
+    }
+    return ZX_OK;
+}
+
+zx_status_t VnodeBlob::InitCompressedVmos() {
+    TRACE_DURATION("blobstore", "Blobstore::InitCompressedVmos");
+
+    const blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
+    uint64_t merkle_blocks = MerkleTreeBlocks(*inode);
+    if (inode->num_blocks <= merkle_blocks) {
+        FS_TRACE_ERROR("blobstore: Compressed blob has no data blocks\n");
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    uint64_t compressed_blocks = inode->num_blocks - merkle_blocks;
+    uint64_t index_blocks = fbl::round_up(CompressionIndexSize(inode->blob_size),
+                                          kBlobstoreBlockSize) / kBlobstoreBlockSize;
+    if (index_blocks > compressed_blocks) {
+        FS_TRACE_ERROR("blobstore: Compressed blob is too small for its block index\n");
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
+    zx_status_t status;
+    fbl::unique_ptr<MappedVmo> compressed;
+    if ((status = MappedVmo::Create(compressed_blocks * kBlobstoreBlockSize, "blob-compressed",
+                                    &compressed)) != ZX_OK) {
+        FS_TRACE_ERROR("Failed to initialize compressed vmo; error: %d\n", status);
+        return status;
+    }
+    vmoid_t compressed_vmoid;
+    if ((status = blobstore_->AttachVmo(compressed->GetVmo(), &compressed_vmoid)) != ZX_OK) {
+        FS_TRACE_ERROR("Failed to attach compressed VMO to block device; error: %d\n", status);
+        return status;
+    }
+    auto detach = fbl::MakeAutoCall([this, compressed_vmoid]() {
+        blobstore_->DetachVmo(compressed_vmoid);
+    });
+
+    // Only the Merkle tree and the block index are read up front. The LZ4
+    // blocks are read and decompressed by LoadAndVerify() as they are needed.
+    uint64_t dev_start = inode->start_block + DataStartBlock(blobstore_->info_);
     ReadTxn txn(blobstore_.get());
-    txn.Enqueue(vmoid_, 0, inode->start_block + DataStartBlock(blobstore_->info_),
-                BlobDataBlocks(*inode) + MerkleTreeBlocks(*inode));
+    if (merkle_blocks > 0) {
+        txn.Enqueue(vmoid_, 0, dev_start, merkle_blocks);
+    }
+    txn.Enqueue(compressed_vmoid, 0, dev_start + merkle_blocks, index_blocks);
     if ((status = txn.Flush()) != ZX_OK) {
         return status;
     }
+    if ((status = ReadCompressionIndex(compressed->GetData(),
+                                       compressed_blocks * kBlobstoreBlockSize,
+                                       inode->blob_size, &compressed_index_)) != ZX_OK) {
+        return status;
+    }
+    zx_vmo_op_range(compressed->GetVmo(), ZX_VMO_OP_DECOMMIT, 0,
+                    index_blocks * kBlobstoreBlockSize, nullptr, 0);
 
-    return Verify();
+    detach.cancel();
+    compressed_ = fbl::move(compressed);
+    compressed_vmoid_ = compressed_vmoid;
+    return ZX_OK;
+}
+
+zx_status_t VnodeBlob::LoadCompressedBlocks(uint64_t first, uint64_t last,
+                                            uint64_t readahead_last) {
+    TRACE_DURATION("blobstore", "Blobstore::LoadCompressedBlocks", "first", first,
+                   "last", last);
+    ZX_DEBUG_ASSERT(first % kBlobstoreBlocksPerLZ4Block == 0);
+
+    if (compressed_ == nullptr) {
+        return ZX_ERR_BAD_STATE;
+    }
+    const blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
+    uint64_t data_blocks = BlobDataBlocks(*inode);
+    size_t lz4_first = first / kBlobstoreBlocksPerLZ4Block;
+    size_t lz4_last = fbl::round_up(readahead_last, kBlobstoreBlocksPerLZ4Block) /
+                      kBlobstoreBlocksPerLZ4Block;
+
+    // The LZ4 blocks are contiguous on disk, so read them all in one go.
+    uint64_t start = compressed_index_[lz4_first] / kBlobstoreBlockSize;
+    uint64_t end = fbl::round_up(static_cast<uint64_t>(compressed_index_[lz4_last]),
+                                 kBlobstoreBlockSize) / kBlobstoreBlockSize;
+    uint64_t dev_start = inode->start_block + DataStartBlock(blobstore_->info_) +
+                         MerkleTreeBlocks(*inode);
+    ReadTxn txn(blobstore_.get());
+    txn.Enqueue(compressed_vmoid_, start, dev_start + start, end - start);
+    zx_status_t status;
+    if ((status = txn.Flush()) != ZX_OK) {
+        return status;
+    }
+    // The compressed data is only needed until it has been decompressed.
+    auto decommit = fbl::MakeAutoCall([this, start, end]() {
+        zx_vmo_op_range(compressed_->GetVmo(), ZX_VMO_OP_DECOMMIT, start * kBlobstoreBlockSize,
+                        (end - start) * kBlobstoreBlockSize, nullptr, 0);
+    });
+
+    for (size_t i = lz4_first; i < lz4_last; i++) {
+        uint64_t block = i * kBlobstoreBlocksPerLZ4Block;
+        if (verified_.Get(block, fbl::min(block + kBlobstoreBlocksPerLZ4Block, data_blocks))) {
+            continue;
+        }
+        status = DecompressBlock(compressed_->GetData(), compressed_index_, inode->blob_size, i,
+                                 GetData());
+        // As with uncompressed blobs, read-ahead blocks which can't be
+        // decompressed are left for VerifyBlocks() to reject.
+        if (status != ZX_OK && block < last) {
+            return status;
+        }
+    }
+    return ZX_OK;
 }
 
 uint64_t VnodeBlob::SizeData() const {
@@ -204,6 +414,9 @@ zx_status_t VnodeBlob::SpaceAllocate(uint64_t size_data) {
     blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
     memset(inode->merkle_root_hash, 0, Digest::kLength);
     inode->blob_size = size_data;
+    // Blobs written through the filesystem are streamed to disk as they
+    // arrive, so they are always stored uncompressed.
+    inode->flags = 0;
     inode->num_blocks = MerkleTreeBlocks(*inode) + BlobDataBlocks(*inode);
 
     // Open VMOs, so we can begin writing after allocate succeeds.
@@ -362,6 +575,14 @@ zx_status_t VnodeBlob::WriteInternal(const void* data, size_t len, size_t* actua
             return status;
         }
 
+        // Everything in the VMO came from the writer and has now been
+        // checked against the digest, so reads need not go back to disk.
+        if ((status = verified_.Reset(BlobDataBlocks(*inode))) != ZX_OK ||
+            (status = verified_.Set(0, BlobDataBlocks(*inode))) != ZX_OK) {
+            SetState(kBlobStateError);
+            return status;
+        }
+
         // No more data to write. Flush to disk.
         if ((status = WriteMetadata()) != ZX_OK) {
             SetState(kBlobStateError);
@@ -405,6 +626,9 @@ zx_status_t VnodeBlob::CopyVmo(zx_rights_t rights, zx_handle_t* out) {
     auto inode = blobstore_->GetNode(map_index_);
     // TODO(smklein): Only clone / verify the part of the vmo that
     // was requested.
+    if ((status = LoadAndVerify(0, inode->blob_size)) != ZX_OK) {
+        return status;
+    }
     const size_t data_start = MerkleTreeBlocks(*inode) * kBlobstoreBlockSize;
     zx_handle_t clone;
     if ((status = zx_vmo_clone(blob_->GetVmo(), ZX_VMO_CLONE_COPY_ON_WRITE,
@@ -431,8 +655,6 @@ zx_status_t VnodeBlob::ReadInternal(void* data, size_t len, size_t off, size_t*
         return status;
     }
 
-    Digest d;
-    d = reinterpret_cast<const uint8_t*>(&digest_[0]);
     auto inode = blobstore_->GetNode(map_index_);
     if (off >= inode->blob_size) {
         *actual = 0;
@@ -441,6 +663,9 @@ zx_status_t VnodeBlob::ReadInternal(void* data, size_t len, size_t off, size_t*
     if (len > (inode->blob_size - off)) {
         len = inode->blob_size - off;
     }
+    if ((status = LoadAndVerify(off, len)) != ZX_OK) {
+        return status;
+    }
 
     const size_t data_start = MerkleTreeBlocks(*inode) * kBlobstoreBlockSize;
     return zx_vmo_read(blob_->GetVmo(), data, data_start + off, len, actual);
@@ -724,6 +949,14 @@ zx_status_t Blobstore::AttachVmo(zx_handle_t vmo, vmoid_t* out) {
     return ZX_OK;
 }
 
+zx_status_t Blobstore::DetachVmo(vmoid_t vmoid) {
+    block_fifo_request_t request;
+    request.txnid = TxnId();
+    request.vmoid = vmoid;
+    request.opcode = BLOCKIO_CLOSE_VMO;
+    return Txn(&request, 1);
+}
+
 zx_status_t Blobstore::AddInodes() {
     TRACE_DURATION("blobstore", "Blobstore::AddInodes");
 
@@ -0,0 +1,187 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
+#include <fs/trace.h>
+#include <lz4/lz4.h>
+#include <lz4/lz4frame.h>
+#include <zircon/assert.h>
+
+#include <blobstore/format.h>
+#include <blobstore/compression.h>
+
+namespace blobstore {
+namespace {
+
+constexpr uint32_t kLZ4FrameMagic = 0x184D2204;
+// Bits of the frame descriptor's FLG byte.
+constexpr uint8_t kLZ4FlagDictID = 0x01;
+constexpr uint8_t kLZ4FlagContentSize = 0x08;
+constexpr uint8_t kLZ4FlagBlockChecksum = 0x10;
+// The high bit of a block's size word is set if the block is stored
+// uncompressed.
+constexpr uint32_t kLZ4BlockUncompressed = 0x80000000;
+
+uint32_t ReadLE32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+void WriteLE32(uint8_t* p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+    p[2] = static_cast<uint8_t>(v >> 16);
+    p[3] = static_cast<uint8_t>(v >> 24);
+}
+
+LZ4F_preferences_t Preferences(size_t len) {
+    LZ4F_preferences_t prefs;
+    memset(&prefs, 0, sizeof(prefs));
+    prefs.frameInfo.blockSizeID = LZ4F_max64KB;
+    prefs.frameInfo.blockMode = LZ4F_blockIndependent;
+    prefs.frameInfo.contentSize = len;
+    return prefs;
+}
+
+// Fills in the block index at the start of |out| by walking the LZ4 frame of
+// |out_len| bytes which follows it.
+zx_status_t WriteIndex(uint8_t* out, size_t out_len, size_t len) {
+    size_t count = CompressionBlocks(len);
+    size_t pos = CompressionIndexSize(len);
+    if (out_len - pos < 7 || ReadLE32(out + pos) != kLZ4FrameMagic) {
+        return ZX_ERR_INTERNAL;
+    }
+    uint8_t flags = out[pos + 4];
+    // Magic, FLG, BD, the optional content size and dictionary ID, and HC.
+    pos += 7 + ((flags & kLZ4FlagContentSize) ? 8 : 0) + ((flags & kLZ4FlagDictID) ? 4 : 0);
+    size_t trailer = (flags & kLZ4FlagBlockChecksum) ? sizeof(uint32_t) : 0;
+
+    WriteLE32(out, kBlobstoreLZ4IndexFrame);
+    WriteLE32(out + sizeof(uint32_t), static_cast<uint32_t>((count + 1) * sizeof(uint32_t)));
+    uint8_t* index = out + 2 * sizeof(uint32_t);
+    for (size_t i = 0; i <= count; i++) {
+        if (pos > out_len - sizeof(uint32_t)) {
+            return ZX_ERR_INTERNAL;
+        }
+        WriteLE32(index + i * sizeof(uint32_t), static_cast<uint32_t>(pos));
+        uint32_t size = ReadLE32(out + pos);
+        if ((size == 0) != (i == count)) {
+            // Either the end mark came early, or there are too many blocks.
+            return ZX_ERR_INTERNAL;
+        }
+        pos += sizeof(uint32_t) + (size & ~kLZ4BlockUncompressed) + trailer;
+    }
+    return ZX_OK;
+}
+
+} // namespace
+
+size_t CompressionBlocks(size_t len) {
+    return fbl::round_up(len, kBlobstoreLZ4BlockSize) / kBlobstoreLZ4BlockSize;
+}
+
+size_t CompressionIndexSize(size_t len) {
+    return (CompressionBlocks(len) + 3) * sizeof(uint32_t);
+}
+
+size_t CompressionBound(size_t len) {
+    LZ4F_preferences_t prefs = Preferences(len);
+    return CompressionIndexSize(len) + LZ4F_compressFrameBound(len, &prefs);
+}
+
+zx_status_t Compress(const void* data, size_t len, void* out, size_t out_max, size_t* out_len) {
+    LZ4F_preferences_t prefs = Preferences(len);
+    uint8_t* dst = static_cast<uint8_t*>(out);
+    size_t index_size = CompressionIndexSize(len);
+    if (out_max < index_size) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+    size_t r = LZ4F_compressFrame(dst + index_size, out_max - index_size, data, len, &prefs);
+    if (LZ4F_isError(r)) {
+        FS_TRACE_ERROR("blobstore: Could not compress blob: %s\n", LZ4F_getErrorName(r));
+        return ZX_ERR_INTERNAL;
+    }
+    zx_status_t status = WriteIndex(dst, index_size + r, len);
+    if (status != ZX_OK) {
+        FS_TRACE_ERROR("blobstore: Could not index compressed blob\n");
+        return status;
+    }
+    *out_len = index_size + r;
+    return ZX_OK;
+}
+
+zx_status_t ReadCompressionIndex(const void* compressed, size_t compressed_len, size_t len,
+                                 fbl::Array<uint32_t>* out) {
+    const uint8_t* src = static_cast<const uint8_t*>(compressed);
+    size_t count = CompressionBlocks(len);
+    size_t index_size = CompressionIndexSize(len);
+    if (compressed_len < index_size) {
+        FS_TRACE_ERROR("blobstore: Compressed blob is too small for its block index\n");
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    if (ReadLE32(src) != kBlobstoreLZ4IndexFrame ||
+        ReadLE32(src + sizeof(uint32_t)) != index_size - 2 * sizeof(uint32_t)) {
+        FS_TRACE_ERROR("blobstore: Bad compressed blob block index\n");
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint32_t[]> index(new (&ac) uint32_t[count + 1]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    // Each block, and the end mark, takes at least a size word.
+    size_t min = index_size;
+    for (size_t i = 0; i <= count; i++) {
+        index[i] = ReadLE32(src + (i + 2) * sizeof(uint32_t));
+        if (index[i] < min || index[i] > compressed_len - sizeof(uint32_t)) {
+            FS_TRACE_ERROR("blobstore: Compressed blob block %zu is out of range\n", i);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        min = index[i] + sizeof(uint32_t);
+    }
+    out->reset(index.release(), count + 1);
+    return ZX_OK;
+}
+
+zx_status_t DecompressBlock(const void* compressed, const fbl::Array<uint32_t>& index,
+                            size_t len, size_t i, void* out) {
+    ZX_DEBUG_ASSERT(i + 1 < index.size());
+    const uint8_t* src = static_cast<const uint8_t*>(compressed) + index[i];
+    uint8_t* dst = static_cast<uint8_t*>(out) + i * kBlobstoreLZ4BlockSize;
+    size_t dst_len = fbl::min(len - i * kBlobstoreLZ4BlockSize,
+                              static_cast<size_t>(kBlobstoreLZ4BlockSize));
+
+    uint32_t size = ReadLE32(src);
+    size_t src_len = size & ~kLZ4BlockUncompressed;
+    if (src_len > index[i + 1] - index[i] - sizeof(uint32_t)) {
+        FS_TRACE_ERROR("blobstore: Compressed blob block %zu overruns the next\n", i);
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    src += sizeof(uint32_t);
+    if (size & kLZ4BlockUncompressed) {
+        if (src_len != dst_len) {
+            FS_TRACE_ERROR("blobstore: Compressed blob block %zu has the wrong size\n", i);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        memcpy(dst, src, src_len);
+        return ZX_OK;
+    }
+    int r = LZ4_decompress_safe(reinterpret_cast<const char*>(src), reinterpret_cast<char*>(dst),
+                                static_cast<int>(src_len), static_cast<int>(dst_len));
+    if (r < 0) {
+        FS_TRACE_ERROR("blobstore: Could not decompress blob block %zu\n", i);
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    } else if (static_cast<size_t>(r) != dst_len) {
+        FS_TRACE_ERROR("blobstore: Compressed blob block %zu has the wrong size\n", i);
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    return ZX_OK;
+}
+
+} // namespace blobstore
@@ -23,6 +23,7 @@
 
 #define ZXDEBUG 0
 
+#include <blobstore/compression.h>
 #include <blobstore/format.h>
 #include <blobstore/fsck.h>
 #include <blobstore/host.h>
@@ -149,7 +150,7 @@ zx_status_t blobstore_create_sparse(fbl::RefPtr<Blobstore>* out, fbl::unique_fd
 
 std::mutex add_blob_mutex_;
 
-zx_status_t blobstore_add_blob(Blobstore* bs, int data_fd) {
+zx_status_t blobstore_add_blob(Blobstore* bs, int data_fd, bool compress) {
     // Mmap user-provided file, create the corresponding merkle tree
     struct stat s;
     if (fstat(data_fd, &s) < 0) {
@@ -176,6 +177,29 @@ zx_status_t blobstore_add_blob(Blobstore* bs, int data_fd) {
         return status;
     }
 
+    // Like the Merkle tree, compression happens outside the lock so that
+    // multiple blobs may be compressed concurrently.
+    fbl::unique_ptr<uint8_t[]> compressed;
+    size_t compressed_size = 0;
+    if (compress) {
+        size_t max = CompressionBound(s.st_size);
+        compressed.reset(new (&ac) uint8_t[max]);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        } else if ((status = Compress(blob_data, s.st_size, compressed.get(), max,
+                                      &compressed_size)) != ZX_OK) {
+            return status;
+        }
+        size_t data_blocks = fbl::round_up(static_cast<size_t>(s.st_size),
+                                           kBlobstoreBlockSize) / kBlobstoreBlockSize;
+        size_t compressed_blocks = fbl::round_up(compressed_size,
+                                                 kBlobstoreBlockSize) / kBlobstoreBlockSize;
+        if (compressed_blocks >= data_blocks) {
+            // Not worth it; store the blob as-is.
+            compressed.reset();
+        }
+    }
+
     std::lock_guard<std::mutex> lock(add_blob_mutex_);
     fbl::unique_ptr<InodeBlock> inode_block;
     if ((status = bs->NewBlob(digest, &inode_block)) < 0) {
@@ -187,13 +211,20 @@ zx_status_t blobstore_add_blob(Blobstore* bs, int data_fd) {
     }
 
     inode_block->SetSize(s.st_size);
+    const void* data = blob_data;
+    size_t data_len = s.st_size;
+    if (compressed != nullptr) {
+        inode_block->SetCompressedSize(compressed_size);
+        data = compressed.get();
+        data_len = compressed_size;
+    }
     blobstore_inode_t* inode = inode_block->GetInode();
 
     if ((status = bs->AllocateBlocks(inode->num_blocks,
                                      reinterpret_cast<size_t*>(&inode->start_block))) != ZX_OK) {
         fprintf(stderr, "error: No blocks available\n");
         return status;
-    } else if ((status = bs->WriteData(inode, merkle_tree.get(), blob_data)) != ZX_OK) {
+    } else if ((status = bs->WriteData(inode, merkle_tree.get(), data, data_len)) != ZX_OK) {
         return status;
     } else if ((status = bs->WriteBitmap(inode->num_blocks, inode->start_block)) != ZX_OK) {
         return status;
@@ -222,6 +253,13 @@ zx_status_t blobstore_fsck(fbl::unique_fd fd, off_t start, off_t end,
 void InodeBlock::SetSize(size_t size) {
     inode_->blob_size = size;
     inode_->num_blocks = MerkleTreeBlocks(*inode_) + BlobDataBlocks(*inode_);
+    inode_->flags = 0;
+}
+
+void InodeBlock::SetCompressedSize(size_t size) {
+    inode_->flags |= kBlobstoreInodeFlagLZ4Compressed;
+    inode_->num_blocks = MerkleTreeBlocks(*inode_) +
+                         fbl::round_up(size, kBlobstoreBlockSize) / kBlobstoreBlockSize;
 }
 
 Blobstore::Blobstore(fbl::unique_fd fd, off_t offset, const info_block_t& info_block,
@@ -384,8 +422,10 @@ zx_status_t Blobstore::WriteNode(fbl::unique_ptr<InodeBlock> ino_block) {
     return WriteBlock(cache_.bno, cache_.blk);
 }
 
-zx_status_t Blobstore::WriteData(blobstore_inode_t* inode, void* merkle_data, void* blob_data) {
-    for (size_t n = 0; n < MerkleTreeBlocks(*inode); n++) {
+zx_status_t Blobstore::WriteData(blobstore_inode_t* inode, const void* merkle_data,
+                                 const void* blob_data, size_t blob_len) {
+    const uint64_t merkle_blocks = MerkleTreeBlocks(*inode);
+    for (size_t n = 0; n < merkle_blocks; n++) {
         const void* data = fs::GetBlock<kBlobstoreBlockSize>(merkle_data, n);
         uint64_t bno = data_start_block_ + inode->start_block + n;
         zx_status_t status;
@@ -394,21 +434,21 @@ zx_status_t Blobstore::WriteData(blobstore_inode_t* inode, void* merkle_data, vo
         }
     }
 
-    for (size_t n = 0; n < BlobDataBlocks(*inode); n++) {
+    for (size_t n = 0; n < inode->num_blocks - merkle_blocks; n++) {
         const void* data = fs::GetBlock<kBlobstoreBlockSize>(blob_data, n);
 
         // If we try to write a block, will it be reaching beyond the end of the
         // mapped file?
         size_t off = n * kBlobstoreBlockSize;
         uint8_t last_data[kBlobstoreBlockSize];
-        if (inode->blob_size < off + kBlobstoreBlockSize) {
+        if (blob_len < off + kBlobstoreBlockSize) {
             // Read the partial block from a block-sized buffer which zero-pads the data.
             memset(last_data, 0, kBlobstoreBlockSize);
-            memcpy(last_data, data, inode->blob_size - off);
+            memcpy(last_data, data, blob_len - off);
             data = last_data;
         }
 
-        uint64_t bno = data_start_block_ + inode->start_block + MerkleTreeBlocks(*inode) + n;
+        uint64_t bno = data_start_block_ + inode->start_block + merkle_blocks + n;
         zx_status_t status;
         if ((status = WriteBlock(bno, data)) != ZX_OK) {
             return status;
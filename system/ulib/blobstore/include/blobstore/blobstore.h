@@ -12,8 +12,10 @@
 #endif
 
 #include <bitmap/raw-bitmap.h>
+#include <bitmap/storage.h>
 #include <digest/digest.h>
 #include <fbl/algorithm.h>
+#include <fbl/array.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/intrusive_wavl_tree.h>
 #include <fbl/macros.h>
@@ -163,16 +165,39 @@ private:
     zx_status_t Mmap(int flags, size_t len, size_t* off, zx_handle_t* out) final;
     void Sync(SyncCallback closure) final;
 
-    // Read both VMOs into memory, if we haven't already.
+    // Creates the blob VMO and reads the Merkle tree into it, if we haven't
+    // already. Blob data is read in, decompressed if need be, and verified
+    // lazily by LoadAndVerify().
     //
     // TODO(ZX-1481): When we have can register the Blob Store as a pager
     // service, and it can properly handle pages faults on a vnode's contents,
-    // then we can avoid reading the entire blob up-front. Until then, read
-    // the contents of a VMO into memory when it is opened.
+    // then mappings of the blob can be faulted in on demand as well. Until
+    // then, CopyVmo() loads the entire blob up-front.
     zx_status_t InitVmos();
 
-    // Verify the integrity of the in-memory Blob.
-    // InitVmos() must have already been called for this blob.
+    // Ensures the blob data in [off, off + len) has been read from disk and
+    // verified against the Merkle tree. InitVmos() must have already been
+    // called for this blob.
+    zx_status_t LoadAndVerify(size_t off, size_t len);
+
+    // Reads the compressed data holding blocks [first, readahead_last) of a
+    // compressed blob and decompresses any of them not yet verified into the
+    // blob VMO. Only failures to decompress blocks before |last| are
+    // reported; the rest are read-ahead. |first| must start an LZ4 block.
+    zx_status_t LoadCompressedBlocks(uint64_t first, uint64_t last, uint64_t readahead_last);
+
+    // Verifies any blocks of blob data in [first, last) which are not yet
+    // marked in |verified_|, assuming they have already been read into the
+    // blob VMO.
+    zx_status_t VerifyBlocks(uint64_t first, uint64_t last);
+
+    // Reads the Merkle tree and the block index of a compressed blob, and
+    // creates the VMO its compressed data is read into.
+    // Called by InitVmos() once the blob VMO has been created.
+    zx_status_t InitCompressedVmos();
+
+    // Verify the integrity of the entire in-memory Blob.
+    // The blob data must have already been read into the blob VMO.
     zx_status_t Verify() const;
 
     zx_status_t WriteShared(WriteTxn* txn, size_t start, size_t len, uint64_t start_block);
@@ -194,6 +219,14 @@ private:
     // 2) The Blob itself, aligned to the nearest kBlobstoreBlockSize
     fbl::unique_ptr<MappedVmo> blob_{};
     vmoid_t vmoid_{};
+    // One bit per block of blob data, set once that block is present in blob_
+    // and has been verified against the Merkle tree.
+    bitmap::RawBitmapGeneric<bitmap::DefaultStorage> verified_{};
+    // For compressed blobs, the on-disk data, which is only committed while
+    // it is being decompressed, and the offsets of its LZ4 blocks.
+    fbl::unique_ptr<MappedVmo> compressed_{};
+    vmoid_t compressed_vmoid_{};
+    fbl::Array<uint32_t> compressed_index_{};
 
     zx::event readable_event_{};
     uint64_t bytes_written_{};
@@ -253,6 +286,7 @@ public:
     zx_status_t Readdir(fs::vdircookie_t* cookie, void* dirents, size_t len, size_t* out_actual);
 
     zx_status_t AttachVmo(zx_handle_t vmo, vmoid_t* out);
+    zx_status_t DetachVmo(vmoid_t vmoid);
     zx_status_t Txn(block_fifo_request_t* requests, size_t count) {
         TRACE_DURATION("blobstore", "Blobstore::Txn", "count", count);
         return block_fifo_txn(fifo_client_, requests, count);
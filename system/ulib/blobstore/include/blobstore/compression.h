@@ -0,0 +1,51 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This file contains the LZ4 compression helpers used to store blobs
+// compressed on disk. They are shared between host and target.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <fbl/array.h>
+#include <zircon/types.h>
+
+namespace blobstore {
+
+// Returns the number of LZ4 blocks |len| bytes of data are compressed into.
+size_t CompressionBlocks(size_t len);
+
+// Returns the size of the block index which starts the compressed form of
+// |len| bytes of data.
+size_t CompressionIndexSize(size_t len);
+
+// Returns the largest size |len| bytes of data may occupy once compressed,
+// including the block index.
+size_t CompressionBound(size_t len);
+
+// Compresses |len| bytes of |data| into |out| as a block index followed by a
+// single LZ4 frame made of independent blocks (see kBlobstoreLZ4IndexFrame).
+// |out_max| must be at least CompressionBound(len).
+// On success, the size of the compressed data is returned in |out_len|.
+zx_status_t Compress(const void* data, size_t len, void* out, size_t out_max, size_t* out_len);
+
+// Checks the block index at the start of the |compressed_len| bytes of
+// compressed data for |len| bytes, and copies the offsets it holds into
+// |out|. Only the first CompressionIndexSize(len) bytes of |compressed| are
+// accessed.
+//
+// Every offset in |out| is known to lie within the compressed data, after
+// the index and after the offset before it.
+zx_status_t ReadCompressionIndex(const void* compressed, size_t compressed_len, size_t len,
+                                 fbl::Array<uint32_t>* out);
+
+// Decompresses LZ4 block |i| of the compressed form of |len| bytes into its
+// place in |out|, which holds the uncompressed data. Only the bytes of
+// |compressed| between |index[i]| and |index[i + 1]| are accessed.
+zx_status_t DecompressBlock(const void* compressed, const fbl::Array<uint32_t>& index,
+                            size_t len, size_t i, void* out);
+
+} // namespace blobstore
@@ -23,7 +23,7 @@ namespace blobstore {
 
 constexpr uint64_t kBlobstoreMagic0  = (0xac2153479e694d21ULL);
 constexpr uint64_t kBlobstoreMagic1  = (0x985000d4d4d3d314ULL);
-constexpr uint32_t kBlobstoreVersion = 0x00000004;
+constexpr uint32_t kBlobstoreVersion = 0x00000005;
 
 constexpr uint32_t kBlobstoreFlagClean      = 1;
 constexpr uint32_t kBlobstoreFlagDirty      = 2;
@@ -108,23 +108,47 @@ constexpr uint64_t kStartBlockFree     = 0;
 constexpr uint64_t kStartBlockReserved = 1;
 constexpr uint64_t kStartBlockMinimum  = 2; // Smallest 'data' block possible
 
+// Flags for blobstore_inode_t.
+//
+// The blob data is stored as a single LZ4 frame of independent blocks. The
+// Merkle tree, blob_size and merkle_root_hash all still describe the
+// uncompressed contents; only the on-disk data blocks are compressed.
+constexpr uint32_t kBlobstoreInodeFlagLZ4Compressed = 1;
+
+// The LZ4 frame of a compressed blob is preceded by an LZ4 skippable frame
+// indexing its blocks, so that any block can be read and decompressed on its
+// own. Every block but the last decompresses to kBlobstoreLZ4BlockSize bytes.
+// The skippable frame holds the offset of each block's size word from the
+// start of the compressed data (uint32_t, little-endian), in order, followed
+// by the offset of the frame's end mark.
+constexpr uint32_t kBlobstoreLZ4IndexFrame  = 0x184D2A5C; // LZ4 skippable frame magic
+constexpr uint32_t kBlobstoreLZ4BlockSize   = 65536;
+constexpr uint32_t kBlobstoreBlocksPerLZ4Block = kBlobstoreLZ4BlockSize / kBlobstoreBlockSize;
+
 using digest::Digest;
 typedef struct {
     uint8_t  merkle_root_hash[Digest::kLength];
     uint64_t start_block;
-    uint64_t num_blocks;
-    uint64_t blob_size;
-    uint64_t reserved;
+    uint64_t num_blocks;       // Merkle tree blocks plus on-disk data blocks
+    uint64_t blob_size;        // Size of the uncompressed blob
+    uint32_t flags;
+    uint32_t reserved;
 } blobstore_inode_t;
 
 static_assert(sizeof(blobstore_inode_t) == kBlobstoreInodeSize,
               "Blobstore Inode size is wrong");
 static_assert(kBlobstoreBlockSize % kBlobstoreInodeSize == 0,
               "Blobstore Inodes should fit cleanly within a blobstore block");
+static_assert(kBlobstoreLZ4BlockSize % kBlobstoreBlockSize == 0,
+              "LZ4 blocks should cover whole blobstore blocks");
 
-// Number of blocks reserved for the blob itself
+// Number of blocks reserved for the blob itself, once uncompressed
 constexpr uint64_t BlobDataBlocks(const blobstore_inode_t& blobNode) {
     return fbl::round_up(blobNode.blob_size, kBlobstoreBlockSize) / kBlobstoreBlockSize;
 }
 
+constexpr bool BlobIsCompressed(const blobstore_inode_t& blobNode) {
+    return (blobNode.flags & kBlobstoreInodeFlagLZ4Compressed) != 0;
+}
+
 } // namespace blobstore
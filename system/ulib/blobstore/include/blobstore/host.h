@@ -57,6 +57,10 @@ public:
 
     void SetSize(size_t size);
 
+    // Marks the blob as stored compressed, occupying |size| bytes on disk
+    // after its Merkle tree. SetSize must already have been called.
+    void SetCompressedSize(size_t size);
+
 private:
     size_t bno_;
     blobstore_inode_t* inode_;
@@ -80,7 +84,10 @@ public:
     // Allocate |nblocks| starting at |*blkno_out| in memory
     zx_status_t AllocateBlocks(size_t nblocks, size_t* blkno_out);
 
-    zx_status_t WriteData(blobstore_inode_t* inode, void* merkle_data, void* blob_data);
+    // Writes the Merkle tree and |blob_len| bytes of on-disk blob data (which
+    // is compressed if the inode says so) to the blocks allocated to |inode|.
+    zx_status_t WriteData(blobstore_inode_t* inode, const void* merkle_data, const void* blob_data,
+                          size_t blob_len);
     zx_status_t WriteBitmap(size_t nblocks, size_t start_block);
     zx_status_t WriteNode(fbl::unique_ptr<InodeBlock> ino_block);
     zx_status_t WriteInfo();
@@ -136,8 +143,11 @@ private:
 zx_status_t blobstore_create(fbl::RefPtr<Blobstore>* out, fbl::unique_fd blockfd);
 
 // blobstore_add_blob may be called by multiple threads to gain concurrent
-// merkle tree generation. No other methods are thread safe.
-zx_status_t blobstore_add_blob(Blobstore* bs, int data_fd);
+// merkle tree generation (and compression). No other methods are thread safe.
+//
+// If |compress| is set, the blob is stored LZ4-compressed whenever doing so
+// saves at least one block.
+zx_status_t blobstore_add_blob(Blobstore* bs, int data_fd, bool compress);
 zx_status_t blobstore_fsck(fbl::unique_fd fd, off_t start, off_t end,
                            const fbl::Vector<size_t>& extent_lengths);
 
@@ -12,6 +12,7 @@ MODULE_NAME := blobstore
 
 COMMON_SRCS := \
     $(LOCAL_DIR)/common.cpp \
+    $(LOCAL_DIR)/compression.cpp \
     $(LOCAL_DIR)/fsck.cpp \
 
 # app main
@@ -30,6 +31,7 @@ MODULE_STATIC_LIBS := \
     system/ulib/block-client \
     system/ulib/digest \
     third_party/ulib/uboringssl \
+    third_party/ulib/lz4 \
     system/ulib/trace \
     system/ulib/zx \
     system/ulib/zxcpp \
@@ -61,6 +63,7 @@ MODULE_COMPILEFLAGS := \
     -Wstrict-prototypes -Wwrite-strings \
     -Isystem/ulib/digest/include \
     -Ithird_party/ulib/uboringssl/include \
+    -Ithird_party/ulib/lz4/include \
     -Isystem/ulib/fbl/include \
     -Isystem/ulib/fs/include \
     -Isystem/ulib/fdio/include \
@@ -32,11 +32,10 @@ namespace blobstore {
 VnodeBlob::~VnodeBlob() {
     blobstore_->ReleaseBlob(this);
     if (blob_ != nullptr) {
-        block_fifo_request_t request;
-        request.txnid = blobstore_->TxnId();
-        request.vmoid = vmoid_;
-        request.opcode = BLOCKIO_CLOSE_VMO;
-        blobstore_->Txn(&request, 1);
+        blobstore_->DetachVmo(vmoid_);
+    }
+    if (compressed_ != nullptr) {
+        blobstore_->DetachVmo(compressed_vmoid_);
     }
 }
 
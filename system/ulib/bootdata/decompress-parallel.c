@@ -0,0 +1,104 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <bootdata/decompress.h>
+
+#include <threads.h>
+
+#include <zircon/boot/bootdata.h>
+#include <zircon/syscalls.h>
+
+// These need threads, so unlike the rest of decompress.h they are not
+// built into userboot.
+
+#define MAX_FILL_THREADS 32
+
+// A contiguous range of blocks to be decompressed by one thread.
+typedef struct {
+    bootdata_lazy_t* lz;
+    size_t first;
+    size_t last;
+    zx_status_t status;
+    const char* err;
+} fill_task_t;
+
+static int fill_thread(void* arg) {
+    fill_task_t* task = arg;
+    task->status = bootdata_lazy_fill(task->lz, task->first * BOOTDATA_LZ4_BLOCK_SIZE,
+                                      (task->last - task->first) * BOOTDATA_LZ4_BLOCK_SIZE,
+                                      &task->err);
+    return 0;
+}
+
+zx_status_t bootdata_lazy_fill_all(bootdata_lazy_t* lz, uint32_t num_threads,
+                                   const char** err) {
+    *err = "none";
+    size_t nblocks = lz->count;
+    if (num_threads == 0) {
+        num_threads = zx_system_get_num_cpus();
+    }
+    if (num_threads > MAX_FILL_THREADS) {
+        num_threads = MAX_FILL_THREADS;
+    }
+    if (num_threads > nblocks) {
+        num_threads = nblocks;
+    }
+    if (num_threads == 0) {
+        return ZX_OK;
+    }
+
+    fill_task_t tasks[MAX_FILL_THREADS];
+    thrd_t threads[MAX_FILL_THREADS];
+    size_t started = 0;
+    for (size_t i = 0; i < num_threads; i++) {
+        tasks[i].lz = lz;
+        tasks[i].first = (nblocks * i) / num_threads;
+        tasks[i].last = (nblocks * (i + 1)) / num_threads;
+    }
+    // The calling thread takes the first task.  If a thread can't be
+    // started, its task is run here instead.
+    for (size_t i = 1; i < num_threads; i++) {
+        if (thrd_create_with_name(&threads[started], fill_thread, &tasks[i],
+                                  "bootfs-lz4") == thrd_success) {
+            started++;
+        } else {
+            fill_thread(&tasks[i]);
+        }
+    }
+    fill_thread(&tasks[0]);
+    for (size_t i = 0; i < started; i++) {
+        thrd_join(threads[i], NULL);
+    }
+
+    for (size_t i = 0; i < num_threads; i++) {
+        if (tasks[i].status != ZX_OK) {
+            *err = tasks[i].err;
+            return tasks[i].status;
+        }
+    }
+    return ZX_OK;
+}
+
+zx_status_t decompress_bootdata_parallel(zx_handle_t vmar, zx_handle_t vmo,
+                                         size_t offset, size_t length,
+                                         uint32_t num_threads,
+                                         zx_handle_t* out, const char** err) {
+    bootdata_lazy_t lz;
+    zx_handle_t dst = ZX_HANDLE_INVALID;
+    zx_status_t status = bootdata_lazy_open(vmar, vmo, offset, length, &dst, NULL, &lz, err);
+    if (status == ZX_ERR_NOT_SUPPORTED) {
+        return decompress_bootdata(vmar, vmo, offset, length, out, err);
+    }
+    if (status != ZX_OK) {
+        return status;
+    }
+    status = bootdata_lazy_fill_all(&lz, num_threads, err);
+    bootdata_lazy_close(&lz);
+    if (status != ZX_OK) {
+        zx_handle_close(dst);
+        return status;
+    }
+    *out = dst;
+    return ZX_OK;
+}
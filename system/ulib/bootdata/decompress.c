@@ -5,6 +5,8 @@
 #include <bootdata/decompress.h>
 
 #include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <string.h>
 
 #include <zircon/boot/bootdata.h>
@@ -175,6 +177,273 @@ static zx_status_t decompress_bootfs_vmo(zx_handle_t vmar, const uint8_t* data,
     return ZX_OK;
 }
 
+static uint32_t read_le32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Finds the frame and block index of a compressed item.
+static zx_status_t lazy_init(bootdata_lazy_t* lz, const bootdata_t* hdr,
+                             size_t avail, const char** err) {
+    if (!(hdr->flags & BOOTDATA_BOOTFS_FLAG_COMPRESSED)) {
+        *err = "bootdata item is not compressed";
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    if (hdr->length > avail) {
+        *err = "bootdata item length exceeds vmo";
+        return ZX_ERR_INVALID_ARGS;
+    }
+    const uint8_t* data = (const uint8_t*)(hdr + 1);
+    size_t len = hdr->length;
+    if ((len < sizeof(uint32_t) + sizeof(lz4_frame_desc)) ||
+        (read_le32(data) != ZX_LZ4_MAGIC)) {
+        *err = "bad magic number for compressed bootfs";
+        return ZX_ERR_INVALID_ARGS;
+    }
+    zx_status_t status = check_lz4_frame((const lz4_frame_desc*)(data + sizeof(uint32_t)),
+                                         hdr->extra, err);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    // The index, if there is one, ends the item.
+    if (len < sizeof(bootdata_lz4_index_t)) {
+        *err = "no lz4 block index";
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    const uint8_t* trailer = data + len - sizeof(bootdata_lz4_index_t);
+    if (read_le32(trailer + offsetof(bootdata_lz4_index_t, magic)) != BOOTDATA_LZ4_INDEX_MAGIC) {
+        *err = "no lz4 block index";
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    size_t count = (hdr->extra + BOOTDATA_LZ4_BLOCK_SIZE - 1) / BOOTDATA_LZ4_BLOCK_SIZE;
+    if (read_le32(trailer + offsetof(bootdata_lz4_index_t, count)) != count) {
+        *err = "lz4 block index does not match bootdata outsize";
+        return ZX_ERR_INVALID_ARGS;
+    }
+    size_t frame_len = 2 * sizeof(uint32_t) + count * sizeof(uint32_t) +
+                       sizeof(bootdata_lz4_index_t);
+    if (frame_len > len) {
+        *err = "lz4 block index too large";
+        return ZX_ERR_INVALID_ARGS;
+    }
+    const uint8_t* frame = data + len - frame_len;
+    if ((read_le32(frame) != BOOTDATA_LZ4_INDEX_FRAME) ||
+        (read_le32(frame + sizeof(uint32_t)) != frame_len - 2 * sizeof(uint32_t))) {
+        *err = "bad lz4 block index frame";
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    lz->data = data;
+    lz->data_len = len - frame_len;
+    lz->index = frame + 2 * sizeof(uint32_t);
+    lz->count = count;
+    lz->outsize = hdr->extra;
+    return ZX_OK;
+}
+
+// Maps the destination VMO and the map of which blocks have been
+// decompressed, creating them if need be.
+static zx_status_t lazy_map(bootdata_lazy_t* lz, zx_handle_t* dst, zx_handle_t* map,
+                            const char** err) {
+    size_t dst_len = (lz->outsize + 4095) & ~4095;
+    bool created = false;
+    zx_status_t status;
+    if (*dst == ZX_HANDLE_INVALID) {
+        status = zx_vmo_create((uint64_t)dst_len, 0, dst);
+        if (status < 0) {
+            *err = "zx_vmo_create failed for decompressing bootfs";
+            return status;
+        }
+        zx_object_set_property(*dst, ZX_PROP_NAME, "bootfs", 6);
+        created = true;
+    } else {
+        uint64_t size;
+        status = zx_vmo_get_size(*dst, &size);
+        if ((status == ZX_OK) && (size < dst_len)) {
+            status = ZX_ERR_BUFFER_TOO_SMALL;
+        }
+        if (status < 0) {
+            *err = "bootfs vmo too small for lz4 decompression";
+            return status;
+        }
+    }
+
+    uintptr_t addr = 0;
+    status = zx_vmar_map(lz->vmar, 0, *dst, 0, dst_len,
+                         ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE, &addr);
+    if (status < 0) {
+        *err = "zx_vmar_map failed on bootfs vmo during decompression";
+        goto fail;
+    }
+    lz->dst = (uint8_t*)addr;
+    lz->dst_len = dst_len;
+
+    if (lz->count > 0) {
+        size_t filled_len = (lz->count + 4095) & ~4095;
+        zx_handle_t filled_vmo = (map != NULL) ? *map : ZX_HANDLE_INVALID;
+        bool created_map = false;
+        if (filled_vmo == ZX_HANDLE_INVALID) {
+            status = zx_vmo_create((uint64_t)filled_len, 0, &filled_vmo);
+            if (status < 0) {
+                *err = "zx_vmo_create failed for lz4 block map";
+                goto fail;
+            }
+            zx_object_set_property(filled_vmo, ZX_PROP_NAME, "bootfs-lz4-map", 14);
+            created_map = true;
+        } else {
+            uint64_t size;
+            status = zx_vmo_get_size(filled_vmo, &size);
+            if ((status == ZX_OK) && (size < filled_len)) {
+                status = ZX_ERR_BUFFER_TOO_SMALL;
+            }
+            if (status < 0) {
+                *err = "lz4 block map too small";
+                goto fail;
+            }
+        }
+        status = zx_vmar_map(lz->vmar, 0, filled_vmo, 0, filled_len,
+                             ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE, &addr);
+        if (created_map) {
+            if ((status == ZX_OK) && (map != NULL)) {
+                *map = filled_vmo;
+            } else {
+                zx_handle_close(filled_vmo);
+            }
+        }
+        if (status < 0) {
+            *err = "zx_vmar_map failed on lz4 block map";
+            goto fail;
+        }
+        lz->filled = (uint8_t*)addr;
+        lz->filled_len = filled_len;
+    }
+    return ZX_OK;
+
+fail:
+    if (created) {
+        zx_handle_close(*dst);
+        *dst = ZX_HANDLE_INVALID;
+    }
+    return status;
+}
+
+zx_status_t bootdata_lazy_open(zx_handle_t vmar, zx_handle_t vmo,
+                               size_t offset, size_t length,
+                               zx_handle_t* dst, zx_handle_t* map,
+                               bootdata_lazy_t* lz, const char** err) {
+    *err = "none";
+    memset(lz, 0, sizeof(*lz));
+
+    if (length < sizeof(bootdata_t)) {
+        *err = "bootdata item too small";
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    // The compressed item stays mapped for as long as blocks may be needed.
+    uintptr_t addr = 0;
+    size_t aligned_offset = offset & ~(PAGE_SIZE - 1);
+    size_t align_shift = offset - aligned_offset;
+    length += align_shift;
+    zx_status_t status = zx_vmar_map(vmar, 0, vmo, aligned_offset, length,
+                                     ZX_VM_FLAG_PERM_READ, &addr);
+    if (status < 0) {
+        *err = "zx_vmar_map failed on bootfs vmo";
+        return status;
+    }
+    lz->vmar = vmar;
+    lz->src_addr = addr;
+    lz->src_len = length;
+
+    const bootdata_t* hdr = (const bootdata_t*)(addr + align_shift);
+    status = lazy_init(lz, hdr, length - align_shift - sizeof(bootdata_t), err);
+    if (status == ZX_OK) {
+        status = lazy_map(lz, dst, map, err);
+    }
+    if (status != ZX_OK) {
+        bootdata_lazy_close(lz);
+    }
+    return status;
+}
+
+static zx_status_t lazy_fill_block(bootdata_lazy_t* lz, size_t i, const char** err) {
+    size_t off = i * BOOTDATA_LZ4_BLOCK_SIZE;
+    size_t len = lz->outsize - off;
+    if (len > BOOTDATA_LZ4_BLOCK_SIZE) {
+        len = BOOTDATA_LZ4_BLOCK_SIZE;
+    }
+
+    size_t pos = read_le32(lz->index + i * sizeof(uint32_t));
+    if ((pos > lz->data_len) || (lz->data_len - pos < sizeof(uint32_t))) {
+        *err = "lz4 block index out of range";
+        return ZX_ERR_INVALID_ARGS;
+    }
+    uint32_t blocksize = read_le32(lz->data + pos);
+    pos += sizeof(uint32_t);
+    // If the data is uncompressed, the high bit is 1.
+    size_t actual = blocksize & 0x7fffffff;
+    if (actual > lz->data_len - pos) {
+        *err = "lz4 block extends past end of bootdata";
+        return ZX_ERR_INVALID_ARGS;
+    }
+    if (blocksize >> 31) {
+        if (actual != len) {
+            *err = "bootdata size error; outsize does not match decompressed size";
+            return ZX_ERR_INVALID_ARGS;
+        }
+        memcpy(lz->dst + off, lz->data + pos, actual);
+    } else {
+        int dcmp = LZ4_decompress_safe((const char*)lz->data + pos, (char*)lz->dst + off,
+                                       actual, len);
+        if (dcmp < 0) {
+            *err = "lz4 decompression failed";
+            return ZX_ERR_BAD_STATE;
+        }
+        if ((size_t)dcmp != len) {
+            *err = "bootdata size error; outsize does not match decompressed size";
+            return ZX_ERR_INVALID_ARGS;
+        }
+    }
+    // Another thread, or process, may be filling the same block with the
+    // same data; whoever sees the flag set must also see the data.
+    __atomic_store_n(&lz->filled[i], 1, __ATOMIC_RELEASE);
+    return ZX_OK;
+}
+
+zx_status_t bootdata_lazy_fill(bootdata_lazy_t* lz, size_t off, size_t len,
+                               const char** err) {
+    *err = "none";
+    if ((len == 0) || (off >= lz->outsize)) {
+        // Past the end is the zero fill up to a page boundary.
+        return ZX_OK;
+    }
+    if (len > lz->outsize - off) {
+        len = lz->outsize - off;
+    }
+    size_t last = (off + len - 1) / BOOTDATA_LZ4_BLOCK_SIZE;
+    for (size_t i = off / BOOTDATA_LZ4_BLOCK_SIZE; i <= last; i++) {
+        if (!__atomic_load_n(&lz->filled[i], __ATOMIC_ACQUIRE)) {
+            zx_status_t status = lazy_fill_block(lz, i, err);
+            if (status != ZX_OK) {
+                return status;
+            }
+        }
+    }
+    return ZX_OK;
+}
+
+void bootdata_lazy_close(bootdata_lazy_t* lz) {
+    if (lz->filled) {
+        zx_vmar_unmap(lz->vmar, (uintptr_t)lz->filled, lz->filled_len);
+    }
+    if (lz->dst) {
+        zx_vmar_unmap(lz->vmar, (uintptr_t)lz->dst, lz->dst_len);
+    }
+    if (lz->src_addr) {
+        zx_vmar_unmap(lz->vmar, lz->src_addr, lz->src_len);
+    }
+    memset(lz, 0, sizeof(*lz));
+}
+
 zx_status_t decompress_bootdata(zx_handle_t vmar, zx_handle_t vmo,
                                 size_t offset, size_t length,
                                 zx_handle_t* out, const char** err) {
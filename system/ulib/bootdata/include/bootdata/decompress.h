@@ -7,8 +7,13 @@
 
 #pragma GCC visibility push(hidden)
 
+#include <stddef.h>
+#include <stdint.h>
+#include <zircon/compiler.h>
 #include <zircon/types.h>
 
+__BEGIN_CDECLS
+
 // Decompress bootdata at offset of total size length into a new VMO
 // On failure, errmsg is a human readable error description to provide
 // more precise debug information.
@@ -16,4 +21,65 @@ zx_status_t decompress_bootdata(zx_handle_t vmar, zx_handle_t vmo,
                                 size_t offset, size_t length,
                                 zx_handle_t* out, const char** errmsg);
 
+// Like decompress_bootdata, but the blocks of an item with a block index
+// are decompressed by up to num_threads threads (0 for one per cpu).
+// Not available in userboot.
+zx_status_t decompress_bootdata_parallel(zx_handle_t vmar, zx_handle_t vmo,
+                                         size_t offset, size_t length,
+                                         uint32_t num_threads,
+                                         zx_handle_t* out, const char** errmsg);
+
+// State for decompressing an item piecemeal, as its contents are needed.
+// The fields are private.
+typedef struct bootdata_lazy {
+    zx_handle_t vmar;
+    uintptr_t src_addr;
+    size_t src_len;
+    const uint8_t* data;
+    size_t data_len;
+    const uint8_t* index;
+    uint32_t count;
+    size_t outsize;
+    uint8_t* dst;
+    size_t dst_len;
+    uint8_t* filled;
+    size_t filled_len;
+} bootdata_lazy_t;
+
+// Prepares to decompress the item at offset of total size length on
+// demand.  If *dst is ZX_HANDLE_INVALID, a new VMO is created for the
+// decompressed contents and returned in *dst.  Otherwise *dst is a VMO
+// of at least the decompressed size, such as one partly filled by another
+// process, and whatever bootdata_lazy_fill is asked for is (re)written.
+// Likewise, if map is not NULL, *map is either ZX_HANDLE_INVALID, to
+// have the VMO recording which blocks have been decompressed returned
+// in it, or that VMO as returned to whoever filled *dst, so that the
+// blocks they decompressed are not decompressed again.
+// Returns ZX_ERR_NOT_SUPPORTED if the item is not compressed or has no
+// block index, in which case decompress_bootdata must be used instead.
+// On failure, *lz is left so that the other bootdata_lazy_* calls do
+// nothing.
+zx_status_t bootdata_lazy_open(zx_handle_t vmar, zx_handle_t vmo,
+                               size_t offset, size_t length,
+                               zx_handle_t* dst, zx_handle_t* map,
+                               bootdata_lazy_t* lz, const char** errmsg);
+
+// Decompresses the blocks holding the len bytes at off, unless they
+// have been already.  Calls may be made concurrently, from several
+// threads or processes sharing the map; two calls filling the same block
+// write the same data.
+zx_status_t bootdata_lazy_fill(bootdata_lazy_t* lz, size_t off, size_t len,
+                               const char** errmsg);
+
+// Decompresses every block not yet decompressed, on up to num_threads
+// threads (0 for one per cpu).  Not available in userboot.
+zx_status_t bootdata_lazy_fill_all(bootdata_lazy_t* lz, uint32_t num_threads,
+                                   const char** errmsg);
+
+// Unmaps everything bootdata_lazy_open mapped.  The VMO it returned in
+// *dst stays open.
+void bootdata_lazy_close(bootdata_lazy_t* lz);
+
+__END_CDECLS
+
 #pragma GCC visibility pop
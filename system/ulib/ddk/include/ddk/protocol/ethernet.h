@@ -26,10 +26,22 @@ __BEGIN_CDECLS;
 //
 // The FEATURE_DMA flag indicates that the device can copy the buffer data using DMA and will ensure
 // that physical addresses are provided in netbufs.
+//
+// The FEATURE_RX_CSUM flag indicates that the device verifies IP, TCP and UDP checksums of received
+// packets and reports the result with ETHMAC_RECV_CSUM_OK.
+//
+// The FEATURE_TX_CSUM flag indicates that the device fills in IP, TCP and UDP checksums of netbufs
+// queued with ETHMAC_NETBUF_TX_CSUM.
+//
+// The FEATURE_TSO flag indicates that the device splits TCP packets queued with
+// ETHMAC_NETBUF_TX_TSO into segments that fit its mtu.
 
 #define ETHMAC_FEATURE_WLAN     (1u)
 #define ETHMAC_FEATURE_SYNTH    (2u)
 #define ETHMAC_FEATURE_DMA      (4u)
+#define ETHMAC_FEATURE_RX_CSUM  (8u)
+#define ETHMAC_FEATURE_TX_CSUM  (0x10u)
+#define ETHMAC_FEATURE_TSO      (0x20u)
 
 typedef struct ethmac_info {
     uint32_t features;
@@ -45,7 +57,7 @@ typedef struct ethmac_netbuf {
     zx_paddr_t phys;  // Only used if ETHMAC_FEATURE_DMA is available
     uint16_t len;
     uint16_t reserved;
-    uint32_t flags;
+    uint32_t flags;   // ETHMAC_NETBUF_ flags
 
     // Shared between the generic ethernet and ethmac drivers
     list_node_t node;
@@ -57,6 +69,22 @@ typedef struct ethmac_netbuf {
     };
 } ethmac_netbuf_t;
 
+// Offloads requested for a netbuf. They are only set if the device advertises the matching
+// feature.
+#define ETHMAC_NETBUF_TX_CSUM (1u)
+#define ETHMAC_NETBUF_TX_TSO  (2u)
+
+// Flags for ifc->recv().
+//
+// RECV_CSUM_OK indicates that the device has verified the packet's checksums.
+//
+// RECV_MORE indicates that the device has more packets to deliver right away, typically because
+// they were received in the same interrupt. The generic ethernet driver holds completions back
+// until it sees a recv() without this flag, and then returns them to its clients together. A
+// driver that sets it must follow up with another recv() without delay.
+#define ETHMAC_RECV_CSUM_OK (1u)
+#define ETHMAC_RECV_MORE    (2u)
+
 typedef struct ethmac_ifc_virt {
     void (*status)(void* cookie, uint32_t status);
 
@@ -58,6 +58,13 @@ public:
     static zx_status_t Create(const void* data, size_t data_len, void* tree,
                               size_t tree_len, Digest* digest);
 
+    // Like |Create|, but spreads the hashing of each level of the tree across
+    // up to |num_threads| threads.  The tree and root digest written are
+    // identical to those written by |Create|.  Levels too small to be worth
+    // splitting are hashed on the calling thread.
+    static zx_status_t CreateParallel(const void* data, size_t data_len, void* tree,
+                                      size_t tree_len, Digest* digest, size_t num_threads);
+
     // Checks the integrity of a the region of data given by the offset and
     // length.  It checks integrity using the given Merkle tree and trusted root
     // digest. |tree_len| must be at least as much as returned by
@@ -182,6 +189,11 @@ size_t merkle_tree_get_tree_length(size_t data_len);
 zx_status_t merkle_tree_create(const void* data, size_t data_len, void* tree,
                                size_t tree_len, void* out, size_t out_len);
 
+// C wrapper function for |MerkleTree::CreateParallel|.
+zx_status_t merkle_tree_create_parallel(const void* data, size_t data_len, void* tree,
+                                        size_t tree_len, void* out, size_t out_len,
+                                        size_t num_threads);
+
 // C wrapper for |MerkleTree::CreateInit|.  On success, this function
 //  allocates memory for |out|.  The caller must free this memory by calling
 //  |merkle_tree_create_final|, even if an intervening call to
@@ -4,6 +4,7 @@
 
 #include <digest/merkle-tree.h>
 
+#include <pthread.h>
 #include <stdint.h>
 #include <string.h>
 
@@ -94,6 +95,99 @@ size_t NextAligned(size_t length) {
     return fbl::round_up(NextLength(length), MerkleTree::kNodeSize);
 }
 
+////////
+// Helper functions for hashing a whole level of the tree at once.
+
+// Each thread hashes at least this many nodes of a level, so that small levels
+// are not split into pieces cheaper to hash than a thread is to start.
+const size_t kMinNodesPerThread = 64;
+
+// Hashes nodes [first, last) of a level of the tree at height |level| whose
+// |length| bytes of data are at |in|, writing the digests to |out|.
+zx_status_t HashNodes(const uint8_t* in, size_t length, uint64_t level, size_t first,
+                      size_t last, uint8_t* out) {
+    zx_status_t rc;
+    Digest digest;
+    for (size_t i = first; i < last; ++i) {
+        size_t offset = i * MerkleTree::kNodeSize;
+        if ((rc = DigestInit(&digest, offset | level, length - offset)) != ZX_OK) {
+            return rc;
+        }
+        offset += DigestUpdate(&digest, in + offset, offset, length - offset);
+        DigestFinal(&digest, offset);
+        digest.CopyTo(out + (i * Digest::kLength), Digest::kLength);
+    }
+    return ZX_OK;
+}
+
+// A contiguous range of nodes to be hashed by one thread.
+struct HashTask {
+    const uint8_t* in;
+    size_t length;
+    uint64_t level;
+    size_t first;
+    size_t last;
+    uint8_t* out;
+    zx_status_t rc;
+};
+
+void* HashThread(void* arg) {
+    HashTask* task = static_cast<HashTask*>(arg);
+    task->rc = HashNodes(task->in, task->length, task->level, task->first, task->last,
+                         task->out);
+    return nullptr;
+}
+
+// Hashes every node of a level, as |HashNodes| does, dividing the nodes
+// between up to |num_threads| threads including the calling one.
+zx_status_t HashLevel(const uint8_t* in, size_t length, uint64_t level, uint8_t* out,
+                      size_t num_threads) {
+    size_t num_nodes = fbl::max(fbl::round_up(length, MerkleTree::kNodeSize) /
+                                MerkleTree::kNodeSize, static_cast<size_t>(1));
+    num_threads = fbl::min(num_threads, num_nodes / kMinNodesPerThread);
+    if (num_threads <= 1) {
+        return HashNodes(in, length, level, 0, num_nodes, out);
+    }
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<HashTask[]> tasks(new (&ac) HashTask[num_threads]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    fbl::unique_ptr<pthread_t[]> threads(new (&ac) pthread_t[num_threads]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    size_t started = 0;
+    for (size_t i = 0; i < num_threads; ++i) {
+        tasks[i].in = in;
+        tasks[i].length = length;
+        tasks[i].level = level;
+        tasks[i].first = (num_nodes * i) / num_threads;
+        tasks[i].last = (num_nodes * (i + 1)) / num_threads;
+        tasks[i].out = out;
+        tasks[i].rc = ZX_OK;
+    }
+    // The calling thread takes the first task.  If a thread can't be
+    // started, its task is run here instead.
+    for (size_t i = 1; i < num_threads; ++i) {
+        if (pthread_create(&threads[started], nullptr, HashThread, &tasks[i]) == 0) {
+            ++started;
+        } else {
+            HashThread(&tasks[i]);
+        }
+    }
+    HashThread(&tasks[0]);
+    for (size_t i = 0; i < started; ++i) {
+        pthread_join(threads[i], nullptr);
+    }
+    for (size_t i = 0; i < num_threads; ++i) {
+        if (tasks[i].rc != ZX_OK) {
+            return tasks[i].rc;
+        }
+    }
+    return ZX_OK;
+}
+
 } // namespace
 
 ////////
@@ -116,6 +210,45 @@ zx_status_t MerkleTree::Create(const void* data, size_t data_len, void* tree, si
     return ZX_OK;
 }
 
+zx_status_t MerkleTree::CreateParallel(const void* data, size_t data_len, void* tree,
+                                       size_t tree_len, Digest* digest, size_t num_threads) {
+    zx_status_t rc;
+    if (tree_len < GetTreeLength(data_len)) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+    // Must have data to read, a tree to fill if expecting more than one
+    // digest, and a root to write.
+    if ((!data && data_len != 0) || (!tree && data_len > kNodeSize) || !digest) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    // Hash one level at a time, from the data up.  Unlike |CreateUpdate|,
+    // each level is complete before the next is started, so the nodes within
+    // a level can be hashed in any order.
+    const uint8_t* in = static_cast<const uint8_t*>(data);
+    uint8_t* out = static_cast<uint8_t*>(tree);
+    uint64_t level = 0;
+    while (data_len > kNodeSize) {
+        if ((rc = HashLevel(in, data_len, level, out, num_threads)) != ZX_OK) {
+            return rc;
+        }
+        // Zero the rest of the last node, as |CreateUpdate| does.
+        size_t next_len = NextLength(data_len);
+        size_t next_aligned = NextAligned(data_len);
+        memset(out + next_len, 0, next_aligned - next_len);
+        // Ascend the tree.
+        in = out;
+        out += next_aligned;
+        data_len = next_aligned;
+        ++level;
+    }
+    uint8_t root[Digest::kLength];
+    if ((rc = HashNodes(in, data_len, level, 0, 1, root)) != ZX_OK) {
+        return rc;
+    }
+    *digest = root;
+    return ZX_OK;
+}
+
 MerkleTree::MerkleTree() : initialized_(false), next_(nullptr), level_(0), offset_(0), length_(0) {}
 
 MerkleTree::~MerkleTree() {}
@@ -263,8 +396,12 @@ zx_status_t MerkleTree::Verify(const void* data, size_t data_len, const void* tr
             return ZX_ERR_BUFFER_TOO_SMALL;
         }
         tree_len -= data_len;
+        // Round out to whole nodes before scaling down, so that a short range
+        // still covers the digest of every node it touched.
+        size_t finish = fbl::round_up(offset + length, kNodeSize);
+        offset -= offset % kNodeSize;
+        length = (finish - offset) / kDigestsPerNode;
         offset /= kDigestsPerNode;
-        length /= kDigestsPerNode;
         ++level;
     }
     return VerifyRoot(data, root_len, level, root);
@@ -405,6 +542,18 @@ zx_status_t merkle_tree_create(const void* data, size_t data_len, void* tree, si
     return digest.CopyTo(static_cast<uint8_t*>(out), out_len);
 }
 
+zx_status_t merkle_tree_create_parallel(const void* data, size_t data_len, void* tree,
+                                        size_t tree_len, void* out, size_t out_len,
+                                        size_t num_threads) {
+    zx_status_t rc;
+    Digest digest;
+    if ((rc = MerkleTree::CreateParallel(data, data_len, tree, tree_len, &digest,
+                                         num_threads)) != ZX_OK) {
+        return rc;
+    }
+    return digest.CopyTo(static_cast<uint8_t*>(out), out_len);
+}
+
 zx_status_t merkle_tree_verify(const void* data, size_t data_len, void* tree, size_t tree_len,
                                size_t offset, size_t length, const void* root, size_t root_len) {
     // Must have a complete root digest.
@@ -10,7 +10,7 @@
 namespace dispatcher {
 
 // static
-fbl::RefPtr<ExecutionDomain> ExecutionDomain::Create(uint32_t priority) {
+fbl::RefPtr<ExecutionDomain> ExecutionDomain::Create(uint32_t priority, DispatchHint hint) {
     zx::event evt;
     if (zx::event::create(0, &evt) != ZX_OK)
         return nullptr;
@@ -25,7 +25,7 @@ fbl::RefPtr<ExecutionDomain> ExecutionDomain::Create(uint32_t priority) {
     ZX_DEBUG_ASSERT(thread_pool != nullptr);
 
     fbl::AllocChecker ac;
-    auto new_domain = fbl::AdoptRef(new (&ac) ExecutionDomain(thread_pool, fbl::move(evt)));
+    auto new_domain = fbl::AdoptRef(new (&ac) ExecutionDomain(thread_pool, fbl::move(evt), hint));
     if (!ac.check())
         return nullptr;
 
@@ -37,10 +37,12 @@ fbl::RefPtr<ExecutionDomain> ExecutionDomain::Create(uint32_t priority) {
 }
 
 ExecutionDomain::ExecutionDomain(fbl::RefPtr<ThreadPool> thread_pool,
-                                 zx::event dispatch_idle_evt)
+                                 zx::event dispatch_idle_evt,
+                                 DispatchHint hint)
     : deactivated_(0),
       thread_pool_(fbl::move(thread_pool)),
-      dispatch_idle_evt_(fbl::move(dispatch_idle_evt)) {
+      dispatch_idle_evt_(fbl::move(dispatch_idle_evt)),
+      dispatch_hint_(hint) {
     ZX_DEBUG_ASSERT(thread_pool_ != nullptr);
     ZX_DEBUG_ASSERT(dispatch_idle_evt_.is_valid());
 }
@@ -51,6 +53,7 @@ ExecutionDomain::~ExecutionDomain() {
     ZX_DEBUG_ASSERT(deactivated());
     ZX_DEBUG_ASSERT(sources_.is_empty());
     ZX_DEBUG_ASSERT(!thread_pool_node_state_.InContainer());
+    ZX_DEBUG_ASSERT(!ready_node_state_.InContainer());
 }
 
 void ExecutionDomain::Deactivate(bool sync_dispatch) {
@@ -204,13 +207,11 @@ bool ExecutionDomain::RemovePendingWork(EventSource* event_source) {
     return true;
 }
 
-void ExecutionDomain::DispatchPendingWork() {
-    // While we have work waiting in the pending queue, dispatch it.
-    //
-    // TODO(johngro) : To prevent starvation issues, we should probably only
-    // perform a finite amount of work, and unwind out into the port wait
-    // operation to give other event source owners a chance if this ends up
-    // going on for too long.
+bool ExecutionDomain::DispatchPendingWork(uint32_t budget) {
+    // While we have work waiting in the pending queue, dispatch it.  Once we
+    // have used up our budget, give the thread back to the pool so that other
+    // domains get a chance to run.  We stay flagged as dispatching, so no one
+    // else will pick us up until our caller hands us back to the pool.
     while (true) {
         // Enter the sources lock and take a reference to the front of the
         // pending queue.  If the pending work queue is empty, or we have been
@@ -231,9 +232,12 @@ void ExecutionDomain::DispatchPendingWork() {
                     res = dispatch_idle_evt_.signal(0u, ZX_USER_SIGNAL_0);
                     ZX_DEBUG_ASSERT(res == ZX_OK);
                 }
-                return;
+                return false;
             }
 
+            if (budget == 0)
+                return true;
+
             source = pending_work_.begin().CopyPointer();
         }
 
@@ -243,8 +247,10 @@ void ExecutionDomain::DispatchPendingWork() {
         // the execution domain's sources lock.  If this is the case, just move
         // on to the next pending source.
         ZX_DEBUG_ASSERT(source != nullptr);
-        if (source->BeginDispatching())
+        if (source->BeginDispatching()) {
             source->Dispatch(this);
+            --budget;
+        }
     }
 }
 
@@ -20,6 +20,19 @@ bool ThreadPool::system_shutdown_ = false;
 
 static constexpr uint32_t MAX_THREAD_PRIORITY = 31;
 
+// The number of events a domain may dispatch before it has to go to the back
+// of the line and let other ready domains have a turn.
+static constexpr uint32_t DISPATCH_BUDGET = 16;
+
+// The maximum number of packets a busy thread will pull off of the port before
+// getting back to dispatching.
+static constexpr uint32_t MAX_PACKETS_PER_POLL = 16;
+
+// Keys for the user packets we queue to our own port.  Event sources use their
+// address as their key, so neither of these can collide with them.
+static constexpr uint64_t QUIT_PACKET_KEY = 0;
+static constexpr uint64_t WAKE_PACKET_KEY = 1;
+
 // static
 zx_status_t ThreadPool::Get(fbl::RefPtr<ThreadPool>* pool_out, uint32_t priority) {
     if ((pool_out == nullptr) || (priority > MAX_THREAD_PRIORITY))
@@ -105,7 +118,7 @@ zx_status_t ThreadPool::AddDomainToPool(fbl::RefPtr<ExecutionDomain> domain) {
     ++active_domain_count_;
 
     while ((active_thread_count_ < active_domain_count_) &&
-           (active_thread_count_ < zx_system_get_num_cpus())) {
+           (active_thread_count_ < ready_queue_count_)) {
         auto thread = Thread::Create(fbl::WrapRefPtr(this), active_thread_count_);
         if (thread == nullptr) {
             LOG("Failed to create new thread\n");
@@ -158,12 +171,99 @@ zx_status_t ThreadPool::CancelWaitOnPort(const zx::handle& handle, uint64_t key)
     return port_.cancel(handle.get(), key);
 }
 
+void ThreadPool::QueueReadyDomain(uint32_t thread_id, fbl::RefPtr<ExecutionDomain> domain) {
+    ZX_DEBUG_ASSERT(thread_id < ready_queue_count_);
+    ZX_DEBUG_ASSERT(domain != nullptr);
+
+    size_t queue = (domain->dispatch_hint() == ExecutionDomain::DispatchHint::LowLatency)
+                 ? LOW_LATENCY_QUEUE
+                 : NORMAL_QUEUE;
+    ReadyQueue& ready = ready_queues_[thread_id];
+
+    fbl::AutoLock lock(&ready.lock);
+    ready.domains[queue].push_back(fbl::move(domain));
+    ready.depth[queue].fetch_add(1);
+    ready_domain_count_.fetch_add(1);
+}
+
+fbl::RefPtr<ExecutionDomain> ThreadPool::DequeueReadyDomain(uint32_t thread_id, bool steal) {
+    ZX_DEBUG_ASSERT(thread_id < ready_queue_count_);
+
+    for (size_t queue = 0; queue < QUEUE_COUNT; ++queue) {
+        auto domain = PopReadyDomain(thread_id, queue);
+        if (domain != nullptr)
+            return domain;
+
+        if (!steal)
+            continue;
+
+        // Start with our neighbor so that thieves spread themselves out over
+        // the other threads instead of all going after the same one.
+        for (uint32_t i = 1; i < ready_queue_count_; ++i) {
+            domain = PopReadyDomain((thread_id + i) % ready_queue_count_, queue);
+            if (domain != nullptr)
+                return domain;
+        }
+    }
+
+    return nullptr;
+}
+
+fbl::RefPtr<ExecutionDomain> ThreadPool::PopReadyDomain(uint32_t queue_id, size_t queue) {
+    ReadyQueue& ready = ready_queues_[queue_id];
+    if (ready.depth[queue].load() == 0)
+        return nullptr;
+
+    fbl::AutoLock lock(&ready.lock);
+    auto domain = ready.domains[queue].pop_front();
+    if (domain != nullptr) {
+        ready.depth[queue].fetch_sub(1);
+        ready_domain_count_.fetch_sub(1);
+    }
+
+    return domain;
+}
+
+void ThreadPool::WakeIdleThread() {
+    // Idle threads advertise themselves before they take their last look at
+    // the ready queues, so either they will see the work which was queued, or
+    // we will see them.  One wake up in flight at a time is plenty; the thread
+    // which receives it will wake another if there is still work left over.
+    if ((ready_domain_count_.load() == 0) ||
+        (idle_thread_count_.load() == 0) ||
+        (wake_pending_.exchange(1) != 0))
+        return;
+
+    zx_port_packet pkt;
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.key = WAKE_PACKET_KEY;
+    pkt.type = ZX_PKT_TYPE_USER;
+
+    zx_status_t res = port_.queue(&pkt, sizeof(pkt));
+    if (res != ZX_OK) {
+        DEBUG_LOG("Failed to queue wake packet (res %d)\n", res);
+        wake_pending_.store(0);
+    }
+}
+
 void ThreadPool::PrintDebugPrefix() {
     printf("[ThreadPool %02u] ", priority_);
 }
 
 zx_status_t ThreadPool::Init() {
     ZX_DEBUG_ASSERT(!port_.is_valid());
+    ZX_DEBUG_ASSERT(ready_queues_ == nullptr);
+
+    // We never run more threads than there are CPUs, so that is how many
+    // ready queues we will need.
+    uint32_t queue_count = zx_system_get_num_cpus();
+    fbl::AllocChecker ac;
+    ready_queues_.reset(new (&ac) ReadyQueue[queue_count]);
+    if (!ac.check()) {
+        LOG("Failed to allocate %u ready queues!\n", queue_count);
+        return ZX_ERR_NO_MEMORY;
+    }
+    ready_queue_count_ = queue_count;
 
     zx_status_t res = zx::port::create(0, &port_);
     if (res != ZX_OK) {
@@ -206,6 +306,7 @@ void ThreadPool::InternalShutdown() {
     {
         zx_port_packet pkt;
         memset(&pkt, 0, sizeof(pkt));
+        pkt.key = QUIT_PACKET_KEY;
         pkt.type = ZX_PKT_TYPE_USER;
 
         fbl::AutoLock lock(&pool_lock_);
@@ -286,42 +387,71 @@ int ThreadPool::Thread::Main() {
         DEBUG_LOG("WARNING - Failed to set thread priority (res %d)\n", res);
     }
 
-    while (true) {
-        zx_port_packet_t pkt;
-
-        // TODO(johngro) : consider automatically shutting down if we have more
-        // threads than clients.
-
-        // Wait for there to be work to dispatch.  We should never encounter an
-        // error, but if we do, shut down.
-        res = pool_->port().wait(zx::time::infinite(), &pkt, 0);
-        ZX_DEBUG_ASSERT(res == ZX_OK);
-
-        // Is it time to exit?
-        if ((res != ZX_OK) || (pkt.type == ZX_PKT_TYPE_USER)) {
-            break;
+    // Busy threads check the port for newly arrived work in between dispatch
+    // operations, so that the domains it makes ready get sorted by dispatch
+    // hint along with everything else waiting on us, and so that other threads
+    // can steal them.  There is no need to look right after we have been woken
+    // up by the port; we were just there.
+    bool poll_port = false;
+    bool quit = false;
+
+    // TODO(johngro) : consider automatically shutting down if we have more
+    // threads than clients.
+    while (!quit) {
+        if (poll_port) {
+            for (uint32_t i = 0; (i < MAX_PACKETS_PER_POLL) && !quit; ++i) {
+                zx_port_packet_t pkt;
+                if (pool_->port().wait(zx::time(), &pkt, 0) != ZX_OK)
+                    break;
+                quit = !ProcessPacket(pkt);
+            }
+
+            if (quit)
+                break;
         }
 
-        if (pkt.type != ZX_PKT_TYPE_SIGNAL_ONE) {
-            LOG("Unexpected packet type (%u) in Thread pool!\n", pkt.type);
-            continue;
+        auto domain = pool_->DequeueReadyDomain(id_, true);
+        if (domain == nullptr) {
+            // Nothing to do.  Let the other threads know that we are available
+            // to steal their work, then take one last look before blocking.
+            pool_->idle_thread_count_.fetch_add(1);
+            domain = pool_->DequeueReadyDomain(id_, true);
+
+            if (domain == nullptr) {
+                // Wait for there to be work to dispatch.  We should never
+                // encounter an error, but if we do, shut down.
+                zx_port_packet_t pkt;
+                res = pool_->port().wait(zx::time::infinite(), &pkt, 0);
+                ZX_DEBUG_ASSERT(res == ZX_OK);
+                pool_->idle_thread_count_.fetch_sub(1);
+
+                quit = (res != ZX_OK) || !ProcessPacket(pkt);
+                poll_port = false;
+                continue;
+            }
+
+            pool_->idle_thread_count_.fetch_sub(1);
         }
 
-        // Reclaim our event source reference from the kernel.
-        static_assert(sizeof(pkt.key) >= sizeof(EventSource*),
-                      "Port packet keys are not large enough to hold a pointer!");
-        auto event_source =
-            fbl::internal::MakeRefPtrNoAdopt(reinterpret_cast<EventSource*>(pkt.key));
+        // If there is still work waiting, make sure that someone will come and
+        // take it if they have nothing better to do.  Then dispatch this
+        // domain's pending work, sending it to the back of our queue if it
+        // used up its budget.
+        pool_->WakeIdleThread();
+        if (domain->DispatchPendingWork(DISPATCH_BUDGET))
+            pool_->QueueReadyDomain(id_, fbl::move(domain));
+        poll_port = true;
+    }
 
-        // Schedule the dispatch of the pending events for this event source.
-        // If ScheduleDispatch returns a valid ExecutionDomain reference, then
-        // actually go ahead and perform the dispatch of pending work for this
-        // domain.
-        ZX_DEBUG_ASSERT(event_source != nullptr);
-        fbl::RefPtr<ExecutionDomain> domain = event_source->ScheduleDispatch(pkt);
+    // Finish off anything still waiting in our queue before we go.  Any
+    // domains left by now have been deactivated, so this will not take long.
+    while (true) {
+        auto domain = pool_->DequeueReadyDomain(id_, false);
+        if (domain == nullptr)
+            break;
 
-        if (domain != nullptr)
-            domain->DispatchPendingWork();
+        while (domain->DispatchPendingWork(DISPATCH_BUDGET))
+            ;
     }
 
     DEBUG_LOG("Client work thread shutting down\n");
@@ -330,4 +460,40 @@ int ThreadPool::Thread::Main() {
     return 0;
 }
 
+bool ThreadPool::Thread::ProcessPacket(const zx_port_packet_t& pkt) {
+    // Is it time to exit?  If not, this was a nudge to come and steal work
+    // from another thread.
+    if (pkt.type == ZX_PKT_TYPE_USER) {
+        if (pkt.key == QUIT_PACKET_KEY)
+            return false;
+
+        ZX_DEBUG_ASSERT(pkt.key == WAKE_PACKET_KEY);
+        pool_->wake_pending_.store(0);
+        return true;
+    }
+
+    if (pkt.type != ZX_PKT_TYPE_SIGNAL_ONE) {
+        LOG("Unexpected packet type (%u) in Thread pool!\n", pkt.type);
+        return true;
+    }
+
+    // Reclaim our event source reference from the kernel.
+    static_assert(sizeof(pkt.key) >= sizeof(EventSource*),
+                  "Port packet keys are not large enough to hold a pointer!");
+    auto event_source =
+        fbl::internal::MakeRefPtrNoAdopt(reinterpret_cast<EventSource*>(pkt.key));
+
+    // Schedule the dispatch of the pending events for this event source.  If
+    // ScheduleDispatch returns a valid ExecutionDomain reference, then it is
+    // our job to see that the domain's pending work gets dispatched.  Queue it
+    // up with the rest of our ready domains.
+    ZX_DEBUG_ASSERT(event_source != nullptr);
+    fbl::RefPtr<ExecutionDomain> domain = event_source->ScheduleDispatch(pkt);
+
+    if (domain != nullptr)
+        pool_->QueueReadyDomain(id_, fbl::move(domain));
+
+    return true;
+}
+
 }  // namespace dispatcher
@@ -44,6 +44,13 @@ class ThreadPool;
 // dispatch operations will be started, and the system will be completely
 // deactivated when the current in-flight dispatch operation unwinds.
 //
+// Domains with pending work are queued on the threads of their thread pool,
+// which steal from each other when idle.  A domain dispatches a limited number
+// of events before going to the back of the queue, so a busy domain cannot
+// hold a thread hostage.  Domains created with DispatchHint::LowLatency (for
+// example, those servicing audio streams) are run ahead of any Normal domains
+// waiting in the same pool.
+//
 class ExecutionDomain : public fbl::RefCounted<ExecutionDomain> {
 public:
     // Token and ScopedToken are small (empty) objects which are intended to be
@@ -95,8 +102,14 @@ public:
         ~ScopedToken() __TA_RELEASE() { }
     };
 
+    enum class DispatchHint {
+        Normal,
+        LowLatency,
+    };
+
     static constexpr uint32_t DEFAULT_PRIORITY = 16;
-    static fbl::RefPtr<ExecutionDomain> Create(uint32_t priority = DEFAULT_PRIORITY);
+    static fbl::RefPtr<ExecutionDomain> Create(uint32_t priority = DEFAULT_PRIORITY,
+                                               DispatchHint hint = DispatchHint::Normal);
 
     void Deactivate() __TA_EXCLUDES(domain_token_) { Deactivate(true); }
     void DeactivateFromWithinDomain() __TA_REQUIRES(domain_token_) { Deactivate(false); }
@@ -105,6 +118,8 @@ public:
         return (deactivated_.load() != 0);
     }
 
+    DispatchHint dispatch_hint() const { return dispatch_hint_; }
+
     const Token& token() __TA_RETURN_CAPABILITY(domain_token_) { return domain_token_; }
 
 private:
@@ -124,7 +139,16 @@ private:
         }
     };
 
-    ExecutionDomain(fbl::RefPtr<ThreadPool> thread_pool, zx::event dispatch_idle_evt);
+    struct ReadyListTraits {
+        static fbl::DoublyLinkedListNodeState<fbl::RefPtr<ExecutionDomain>>&
+            node_state(ExecutionDomain& domain) {
+            return domain.ready_node_state_;
+        }
+    };
+
+    ExecutionDomain(fbl::RefPtr<ThreadPool> thread_pool,
+                    zx::event dispatch_idle_evt,
+                    DispatchHint hint);
     virtual ~ExecutionDomain();
 
     void Deactivate(bool sync_dispatch);
@@ -148,8 +172,10 @@ private:
     bool RemovePendingWork(EventSource* source)
         __TA_REQUIRES(source->obj_lock_) __TA_EXCLUDES(sources_lock_);
 
-    // Process the pending work queue.
-    void DispatchPendingWork();
+    // Process up to |budget| items from the pending work queue.  Returns true
+    // if work remains, in which case the caller is still responsible for the
+    // domain and must call DispatchPendingWork again later.
+    bool DispatchPendingWork(uint32_t budget);
 
     fbl::Mutex sources_lock_;
     Token domain_token_;
@@ -158,6 +184,7 @@ private:
     bool dispatch_sync_in_progress_ __TA_GUARDED(sources_lock_) = false;
     fbl::RefPtr<ThreadPool> thread_pool_ __TA_GUARDED(sources_lock_);
     zx::event dispatch_idle_evt_;
+    const DispatchHint dispatch_hint_;
 
     // The list of all sources bound to us, as well as the sources which are
     // currently waiting to be dispatched.
@@ -170,6 +197,11 @@ private:
 
     // Node state for existing in our thread pool's execution domain list.
     fbl::DoublyLinkedListNodeState<fbl::RefPtr<ExecutionDomain>> thread_pool_node_state_;
+
+    // Node state for existing in a dispatch thread's ready queue.  Guarded by
+    // that queue's lock, and only ever in a queue while dispatch_in_progress_
+    // is set.
+    fbl::DoublyLinkedListNodeState<fbl::RefPtr<ExecutionDomain>> ready_node_state_;
 };
 
 // A helper macro which can ease so of the namespace pain of establishing the
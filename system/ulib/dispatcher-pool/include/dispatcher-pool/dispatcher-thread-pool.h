@@ -5,8 +5,10 @@
 #pragma once
 
 #include <zircon/compiler.h>
+#include <zircon/syscalls/port.h>
 #include <zircon/types.h>
 #include <zx/port.h>
+#include <fbl/atomic.h>
 #include <fbl/auto_lock.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/intrusive_single_list.h>
@@ -54,6 +56,11 @@ private:
         void PrintDebugPrefix() const;
         int Main();
 
+        // Handle a packet pulled from the pool's port, queueing any domain
+        // which became ready on this thread.  Returns false if the thread has
+        // been asked to exit.
+        bool ProcessPacket(const zx_port_packet_t& pkt);
+
         // TODO(johngro) : migrate away from C11 threads, use native zircon
         // primatives instead.
         //
@@ -64,6 +71,27 @@ private:
         const uint32_t id_;
     };
 
+    using ReadyList = fbl::DoublyLinkedList<fbl::RefPtr<ExecutionDomain>,
+                                            ExecutionDomain::ReadyListTraits>;
+
+    // Domains which have pending work and are waiting for a thread to dispatch
+    // it.  There is one ReadyQueue per pool thread, filled by that thread as it
+    // pulls packets off of the port.  A thread which runs out of work of its
+    // own steals from the other threads' queues before blocking on the port.
+    //
+    // Each queue keeps LowLatency domains apart from Normal ones so that they
+    // can be dispatched first.  The depth counters let threads skip over empty
+    // queues without taking their locks.
+    static constexpr size_t LOW_LATENCY_QUEUE = 0;
+    static constexpr size_t NORMAL_QUEUE = 1;
+    static constexpr size_t QUEUE_COUNT = 2;
+
+    struct ReadyQueue {
+        fbl::Mutex lock;
+        ReadyList domains[QUEUE_COUNT] __TA_GUARDED(lock);
+        fbl::atomic<uint32_t> depth[QUEUE_COUNT] = { {0}, {0} };
+    };
+
     explicit ThreadPool(uint32_t priority) : priority_(priority) { }
     ~ThreadPool() { }
 
@@ -74,6 +102,22 @@ private:
     zx_status_t Init();
     void InternalShutdown();
 
+    // Add a domain which has work ready to |thread_id|'s ready queue.  The
+    // domain must be in the middle of a dispatch operation, which guarantees
+    // that it is in at most one ready queue, and that it will only ever be
+    // dispatched by one thread at a time.
+    void QueueReadyDomain(uint32_t thread_id, fbl::RefPtr<ExecutionDomain> domain);
+
+    // Take the next domain to dispatch for |thread_id|.  LowLatency domains are
+    // taken before Normal ones, and the thread's own queue is preferred over
+    // stealing from others.
+    fbl::RefPtr<ExecutionDomain> DequeueReadyDomain(uint32_t thread_id, bool steal);
+    fbl::RefPtr<ExecutionDomain> PopReadyDomain(uint32_t queue_id, size_t queue);
+
+    // If there are domains waiting in the ready queues and a thread is
+    // blocked on the port, wake it up so that it can steal one.
+    void WakeIdleThread();
+
     static fbl::Mutex active_pools_lock_;
     static fbl::WAVLTree<uint32_t, fbl::RefPtr<ThreadPool>> active_pools_
         __TA_GUARDED(active_pools_lock_);
@@ -93,6 +137,13 @@ private:
 
     fbl::DoublyLinkedList<fbl::unique_ptr<Thread>> active_threads_
         __TA_GUARDED(pool_lock_);
+
+    // One ready queue for each thread we may start, allocated during Init.
+    fbl::unique_ptr<ReadyQueue[]> ready_queues_;
+    uint32_t ready_queue_count_ = 0;
+    fbl::atomic<uint32_t> ready_domain_count_ = { 0 };
+    fbl::atomic<uint32_t> idle_thread_count_ = { 0 };
+    fbl::atomic<uint32_t> wake_pending_ = { 0 };
 };
 
 }  // namespace dispatcher
@@ -0,0 +1,17 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/new.h>
+
+// fbl/new.h declares the placement allocation functions without defining
+// them. On Fuchsia zxcpp provides the definitions, but host C++ libraries
+// only define them inline in <new>, which fbl sources such as string.cpp
+// do not include. Provide out-of-line copies for host links.
+void* operator new(size_t size, void* ptr) {
+    return ptr;
+}
+
+void* operator new[](size_t size, void* ptr) {
+    return ptr;
+}
@@ -40,6 +40,7 @@ MODULE_TYPE := hostlib
 
 MODULE_SRCS += \
     $(LOCAL_DIR)/alloc_checker.cpp \
+    $(LOCAL_DIR)/new_host.cpp \
     $(LOCAL_DIR)/string_buffer.cpp \
     $(LOCAL_DIR)/string_piece.cpp \
     $(LOCAL_DIR)/string_printf.cpp \
@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,6 +16,8 @@
 
 // Eventually we want to use the repeating version of zx_object_wait_async,
 // but it is not ready for prime time yet.  This feature flag enables testing.
+// Running more than one dispatcher thread relies on the one-shot waits, which
+// guarantee that each handler is only ever called from one thread at a time.
 #define USE_WAIT_ONCE 1
 
 #define VERBOSE_DEBUG 0
@@ -43,14 +46,40 @@ struct fdio_dispatcher {
     list_node_t list;
     zx_handle_t port;
     fdio_dispatcher_cb_t default_cb;
-    thrd_t t;
+    bool started;
+    // number of threads running the dispatcher loop; the last one
+    // out destroys the dispatcher, unless fdio_dispatcher_destroy()
+    // is waiting for them to stop
+    atomic_int threads;
+    bool stopping;
+    cnd_t stopped;
 };
 
-static void fdio_dispatcher_destroy(fdio_dispatcher_t* md) {
+static void fdio_dispatcher_free(fdio_dispatcher_t* md) {
+    handler_t* handler;
+    while ((handler = list_remove_head_type(&md->list, handler_t, node)) != NULL) {
+        zx_handle_close(handler->h);
+        free(handler);
+    }
     zx_handle_close(md->port);
+    cnd_destroy(&md->stopped);
     free(md);
 }
 
+// Called by each thread leaving the dispatcher loop.
+static void fdio_dispatcher_release(fdio_dispatcher_t* md) {
+    mtx_lock(&md->lock);
+    bool last = atomic_fetch_sub(&md->threads, 1) == 1;
+    bool stopping = md->stopping;
+    if (last && stopping) {
+        cnd_signal(&md->stopped);
+    }
+    mtx_unlock(&md->lock);
+    if (last && !stopping) {
+        fdio_dispatcher_free(md);
+    }
+}
+
 static void destroy_handler(fdio_dispatcher_t* md, handler_t* handler, bool need_close_cb) {
     if (need_close_cb) {
         handler->cb(0, handler->func, handler->cookie);
@@ -108,6 +137,10 @@ static int fdio_dispatcher_thread(void* _md) {
             printf("dispatcher: port wait failed %d\n", r);
             break;
         }
+        if (packet.type == ZX_PKT_TYPE_USER && packet.key == 0) {
+            // queued by fdio_dispatcher_destroy()
+            break;
+        }
         handler_t* handler = (void*)(uintptr_t)packet.key;
 #if !USE_WAIT_ONCE
         if (handler->flags & FLAG_DISCONNECTED) {
@@ -146,8 +179,8 @@ static int fdio_dispatcher_thread(void* _md) {
         }
     }
 
-    xprintf("dispatcher: FATAL ERROR, EXITING\n");
-    fdio_dispatcher_destroy(md);
+    xprintf("dispatcher: exiting %p\n", md);
+    fdio_dispatcher_release(md);
     return ZX_OK;
 }
 
@@ -159,8 +192,10 @@ zx_status_t fdio_dispatcher_create(fdio_dispatcher_t** out, fdio_dispatcher_cb_t
     xprintf("fdio_dispatcher_create: %p\n", md);
     list_initialize(&md->list);
     mtx_init(&md->lock, mtx_plain);
+    cnd_init(&md->stopped);
     zx_status_t status;
     if ((status = zx_port_create(0, &md->port)) < 0) {
+        cnd_destroy(&md->stopped);
         free(md);
         return status;
     }
@@ -170,24 +205,64 @@ zx_status_t fdio_dispatcher_create(fdio_dispatcher_t** out, fdio_dispatcher_cb_t
 }
 
 zx_status_t fdio_dispatcher_start(fdio_dispatcher_t* md, const char* name) {
-    zx_status_t r;
+    return fdio_dispatcher_start_threads(md, name, 1);
+}
+
+zx_status_t fdio_dispatcher_start_threads(fdio_dispatcher_t* md, const char* name,
+                                          uint32_t count) {
+    if (count == 0) {
+        return ZX_ERR_INVALID_ARGS;
+    }
     mtx_lock(&md->lock);
-    if (md->t == NULL) {
-        if (thrd_create_with_name(&md->t, fdio_dispatcher_thread, md, name) != thrd_success) {
-            fdio_dispatcher_destroy(md);
-            r = ZX_ERR_NO_RESOURCES;
-        } else {
-            thrd_detach(md->t);
-            r = ZX_OK;
+    if (md->started) {
+        mtx_unlock(&md->lock);
+        return ZX_ERR_BAD_STATE;
+    }
+    // hold a reference while starting threads, so that one which exits
+    // straight away cannot destroy the dispatcher under us
+    atomic_store(&md->threads, 1);
+    uint32_t started = 0;
+    for (; started < count; started++) {
+        thrd_t t;
+        atomic_fetch_add(&md->threads, 1);
+        if (thrd_create_with_name(&t, fdio_dispatcher_thread, md, name) != thrd_success) {
+            atomic_fetch_sub(&md->threads, 1);
+            break;
         }
-    } else {
-        r = ZX_ERR_BAD_STATE;
+        thrd_detach(t);
     }
+    md->started = started > 0;
     mtx_unlock(&md->lock);
-    return r;
+
+    fdio_dispatcher_release(md);
+    return started > 0 ? ZX_OK : ZX_ERR_NO_RESOURCES;
+}
+
+void fdio_dispatcher_destroy(fdio_dispatcher_t* md) {
+    mtx_lock(&md->lock);
+    md->stopping = true;
+    // Each thread stops at the first of these it sees, after finishing
+    // whatever handler it is running.
+    int count = atomic_load(&md->threads);
+    for (int n = 0; n < count; n++) {
+        zx_port_packet_t packet = {
+            .key = 0,
+            .type = ZX_PKT_TYPE_USER,
+            .status = ZX_OK};
+        zx_status_t r = zx_port_queue(md->port, &packet, 0);
+        if (r != ZX_OK) {
+            printf("dispatcher: PORT QUEUE FAILED %d\n", r);
+        }
+    }
+    while (atomic_load(&md->threads) > 0) {
+        cnd_wait(&md->stopped, &md->lock);
+    }
+    mtx_unlock(&md->lock);
+    fdio_dispatcher_free(md);
 }
 
 void fdio_dispatcher_run(fdio_dispatcher_t* md) {
+    atomic_fetch_add(&md->threads, 1);
     fdio_dispatcher_thread(md);
 }
 
@@ -30,9 +30,22 @@ zx_status_t fdio_dispatcher_create(fdio_dispatcher_t** out, fdio_dispatcher_cb_t
 // create a thread for a dispatcher and start it running
 zx_status_t fdio_dispatcher_start(fdio_dispatcher_t* md, const char* name);
 
-// run the dispatcher loop on the current thread, never to return
+// create |count| threads for a dispatcher, all servicing the same channels.
+// Messages on different channels may be handled concurrently, but the
+// handler for any one channel is only called from one thread at a time.
+zx_status_t fdio_dispatcher_start_threads(fdio_dispatcher_t* md, const char* name,
+                                          uint32_t count);
+
+// run the dispatcher loop on the current thread, returning only if the
+// dispatcher is destroyed
 void fdio_dispatcher_run(fdio_dispatcher_t* md);
 
+// stop the dispatcher's threads, waiting for any handler they are running
+// to return, then close every channel still added to it (without calling
+// its handler) and free the dispatcher.  Must not be called from a handler,
+// nor while the dispatcher is being started.
+void fdio_dispatcher_destroy(fdio_dispatcher_t* md);
+
 // add a channel to the dispatcher, using the default callback
 zx_status_t fdio_dispatcher_add(fdio_dispatcher_t* md, zx_handle_t h,
                                 void* func, void* cookie);
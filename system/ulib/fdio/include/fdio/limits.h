@@ -16,6 +16,11 @@
 // at least this size.
 #define FDIO_CHUNK_SIZE 8192
 
+// Size of the per-connection transfer vmo used by remoteio for reads
+// and writes larger than FDIO_CHUNK_SIZE, and so the most a single
+// READ_VMO or WRITE_VMO may move.
+#define FDIO_XFER_VMO_SIZE (1024 * 1024)
+
 // Maximum size for an ioctl input.
 #define FDIO_IOCTL_MAX_INPUT 1024
 
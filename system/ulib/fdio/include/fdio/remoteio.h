@@ -58,7 +58,12 @@ __BEGIN_CDECLS
 #define ZXRIO_LINK        (0x0000001a | ZXRIO_ONE_HANDLE)
 #define ZXRIO_MMAP         0x0000001b
 #define ZXRIO_FCNTL        0x0000001c
-#define ZXRIO_NUM_OPS      29
+#define ZXRIO_XFER_VMO    (0x0000001d | ZXRIO_ONE_HANDLE)
+#define ZXRIO_READ_VMO     0x0000001e
+#define ZXRIO_READ_VMO_AT  0x0000001f
+#define ZXRIO_WRITE_VMO    0x00000020
+#define ZXRIO_WRITE_VMO_AT 0x00000021
+#define ZXRIO_NUM_OPS      34
 
 #define ZXRIO_OP(n)        ((n) & 0x3FF) // opcode
 #define ZXRIO_HC(n)        (((n) >> 8) & 3) // handle count
@@ -71,7 +76,8 @@ __BEGIN_CDECLS
     "read_at", "write_at", "truncate", "rename", \
     "connect", "bind", "listen", "getsockname", \
     "getpeername", "getsockopt", "setsockopt", "getaddrinfo", \
-    "setattr", "sync", "link", "mmap", "fcntl" }
+    "setattr", "sync", "link", "mmap", "fcntl", "xfer_vmo", \
+    "read_vmo", "read_vmo_at", "write_vmo", "write_vmo_at" }
 
 // dispatcher callback return code that there were no messages to read
 #define ERR_DISPATCHER_NO_WORK ZX_ERR_SHOULD_WAIT
@@ -238,6 +244,17 @@ static_assert(FDIO_CHUNK_SIZE >= PATH_MAX, "FDIO_CHUNK_SIZE must be large enough
 // LINK        0          0        <name1>0<name2>0  0           -               -
 // MMAP        maxreply   0        mmap_data_msg     0           mmap_data_msg   vmohandle
 // FCNTL       cmd        flags    0                 flags       -               -
+// XFER_VMO    0          0        -                 0           -               -
+// READ_VMO    maxread    0        -                 newoffset   -               -
+// READ_VMO_AT maxread    offset   -                 0           -               -
+// WRITE_VMO   len        0        -                 newoffset   -               -
+// WRITE_VMO_AT len       offset   -                 0           -               -
+//
+// XFER_VMO carries a vmo handle which the server keeps as the transfer
+// buffer of the connection, replacing any previous one.  The *_VMO
+// operations move their bytes through offset 0 of that vmo rather than
+// through data[], so that up to FDIO_XFER_VMO_SIZE bytes take a single
+// round trip.
 //
 // proposed:
 //
@@ -19,6 +19,12 @@ struct zxrio {
 
     // transaction id used for synchronous remoteio calls
     _Atomic zx_txid_t txid;
+
+    // vmo shared with the server for reads and writes larger than
+    // FDIO_CHUNK_SIZE, created on first use (see ZXRIO_XFER_VMO)
+    mtx_t xfer_lock;
+    zx_handle_t xfer_vmo;
+    int xfer_state;
 };
 
 // These are for the benefit of namespace.c
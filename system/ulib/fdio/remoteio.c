@@ -356,6 +356,111 @@ ssize_t zxrio_ioctl(fdio_t* io, uint32_t op, const void* in_buf,
     return r;
 }
 
+// states of zxrio_t.xfer_state
+#define XFER_VMO_UNKNOWN     0
+#define XFER_VMO_READY       1
+#define XFER_VMO_UNSUPPORTED 2
+
+// Creates the transfer vmo and hands it to the server, unless that has
+// already been done.  Any failure leaves the connection using data[]
+// chunks from then on, since most servers other than libfs do not know
+// ZXRIO_XFER_VMO.
+static zx_status_t zxrio_xfer_vmo_locked(zxrio_t* rio) {
+    if (rio->xfer_state == XFER_VMO_READY) {
+        return ZX_OK;
+    } else if (rio->xfer_state == XFER_VMO_UNSUPPORTED) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    rio->xfer_state = XFER_VMO_UNSUPPORTED;
+
+    zx_handle_t vmo;
+    zx_status_t r;
+    if ((r = zx_vmo_create(FDIO_XFER_VMO_SIZE, 0, &vmo)) != ZX_OK) {
+        return r;
+    }
+    zxrio_msg_t msg;
+    memset(&msg, 0, ZXRIO_HDR_SZ);
+    msg.op = ZXRIO_XFER_VMO;
+    msg.hcount = 1;
+    if ((r = zx_handle_duplicate(vmo, ZX_RIGHT_READ | ZX_RIGHT_WRITE | ZX_RIGHT_TRANSFER,
+                                 &msg.handle[0])) != ZX_OK) {
+        zx_handle_close(vmo);
+        return r;
+    }
+    if ((r = zxrio_txn(rio, &msg)) < 0) {
+        zx_handle_close(vmo);
+        return r;
+    }
+    discard_handles(msg.handle, msg.hcount);
+    rio->xfer_vmo = vmo;
+    rio->xfer_state = XFER_VMO_READY;
+    return ZX_OK;
+}
+
+// Decommits the first |len| bytes of the transfer vmo once a transfer is
+// done with them, so that idle connections do not each hold on to up to
+// FDIO_XFER_VMO_SIZE bytes of memory.
+static void zxrio_xfer_vmo_decommit_locked(zxrio_t* rio, size_t len) {
+    if (len > FDIO_XFER_VMO_SIZE) {
+        len = FDIO_XFER_VMO_SIZE;
+    }
+    zx_vmo_op_range(rio->xfer_vmo, ZX_VMO_OP_DECOMMIT, 0, len, NULL, 0);
+}
+
+// Writes through the transfer vmo, FDIO_XFER_VMO_SIZE bytes per round
+// trip.  Returns ZX_ERR_NOT_SUPPORTED, having written nothing, if the
+// connection cannot use a transfer vmo.
+static ssize_t write_vmo_common(uint32_t op, zxrio_t* rio, const uint8_t* data, size_t len,
+                                off_t offset) {
+    ssize_t count = 0;
+    zx_status_t r = 0;
+    zxrio_msg_t msg;
+    size_t xfer;
+
+    mtx_lock(&rio->xfer_lock);
+    if (zxrio_xfer_vmo_locked(rio) != ZX_OK) {
+        mtx_unlock(&rio->xfer_lock);
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    size_t total = len;
+    while (len > 0) {
+        xfer = (len > FDIO_XFER_VMO_SIZE) ? FDIO_XFER_VMO_SIZE : len;
+
+        size_t actual;
+        if ((r = zx_vmo_write(rio->xfer_vmo, data, 0, xfer, &actual)) != ZX_OK) {
+            break;
+        }
+
+        memset(&msg, 0, ZXRIO_HDR_SZ);
+        msg.op = op;
+        msg.arg = xfer;
+        if (op == ZXRIO_WRITE_VMO_AT)
+            msg.arg2.off = offset;
+
+        if ((r = zxrio_txn(rio, &msg)) < 0) {
+            break;
+        }
+        discard_handles(msg.handle, msg.hcount);
+
+        if ((size_t)r > xfer) {
+            r = ZX_ERR_IO;
+            break;
+        }
+        count += r;
+        data += r;
+        len -= r;
+        if (op == ZXRIO_WRITE_VMO_AT)
+            offset += r;
+        // stop at short write
+        if ((size_t)r < xfer) {
+            break;
+        }
+    }
+    zxrio_xfer_vmo_decommit_locked(rio, total);
+    mtx_unlock(&rio->xfer_lock);
+    return count ? count : r;
+}
+
 static ssize_t write_common(uint32_t op, fdio_t* io, const void* _data, size_t len, off_t offset) {
     zxrio_t* rio = (zxrio_t*)io;
     const uint8_t* data = _data;
@@ -364,6 +469,14 @@ static ssize_t write_common(uint32_t op, fdio_t* io, const void* _data, size_t l
     zxrio_msg_t msg;
     ssize_t xfer;
 
+    if (len > FDIO_CHUNK_SIZE) {
+        uint32_t vmo_op = (op == ZXRIO_WRITE_AT) ? ZXRIO_WRITE_VMO_AT : ZXRIO_WRITE_VMO;
+        ssize_t n = write_vmo_common(vmo_op, rio, data, len, offset);
+        if (n != ZX_ERR_NOT_SUPPORTED) {
+            return n;
+        }
+    }
+
     while (len > 0) {
         xfer = (len > FDIO_CHUNK_SIZE) ? FDIO_CHUNK_SIZE : len;
 
@@ -404,6 +517,60 @@ static ssize_t zxrio_write_at(fdio_t* io, const void* _data, size_t len, off_t o
     return write_common(ZXRIO_WRITE_AT, io, _data, len, offset);
 }
 
+// Reads through the transfer vmo, FDIO_XFER_VMO_SIZE bytes per round
+// trip.  Returns ZX_ERR_NOT_SUPPORTED, having read nothing, if the
+// connection cannot use a transfer vmo.
+static ssize_t read_vmo_common(uint32_t op, zxrio_t* rio, uint8_t* data, size_t len,
+                               off_t offset) {
+    ssize_t count = 0;
+    zx_status_t r = 0;
+    zxrio_msg_t msg;
+    size_t xfer;
+
+    mtx_lock(&rio->xfer_lock);
+    if (zxrio_xfer_vmo_locked(rio) != ZX_OK) {
+        mtx_unlock(&rio->xfer_lock);
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    size_t total = len;
+    while (len > 0) {
+        xfer = (len > FDIO_XFER_VMO_SIZE) ? FDIO_XFER_VMO_SIZE : len;
+
+        memset(&msg, 0, ZXRIO_HDR_SZ);
+        msg.op = op;
+        msg.arg = xfer;
+        if (op == ZXRIO_READ_VMO_AT)
+            msg.arg2.off = offset;
+
+        if ((r = zxrio_txn(rio, &msg)) < 0) {
+            break;
+        }
+        discard_handles(msg.handle, msg.hcount);
+
+        if ((size_t)r > xfer) {
+            r = ZX_ERR_IO;
+            break;
+        }
+        size_t actual = r;
+        if ((r = zx_vmo_read(rio->xfer_vmo, data, 0, actual, &actual)) != ZX_OK) {
+            break;
+        }
+        count += actual;
+        data += actual;
+        len -= actual;
+        if (op == ZXRIO_READ_VMO_AT)
+            offset += actual;
+
+        // stop at short read
+        if (actual < xfer) {
+            break;
+        }
+    }
+    zxrio_xfer_vmo_decommit_locked(rio, total);
+    mtx_unlock(&rio->xfer_lock);
+    return count ? count : r;
+}
+
 static ssize_t read_common(uint32_t op, fdio_t* io, void* _data, size_t len, off_t offset) {
     zxrio_t* rio = (zxrio_t*)io;
     uint8_t* data = _data;
@@ -412,6 +579,14 @@ static ssize_t read_common(uint32_t op, fdio_t* io, void* _data, size_t len, off
     zxrio_msg_t msg;
     ssize_t xfer;
 
+    if (len > FDIO_CHUNK_SIZE) {
+        uint32_t vmo_op = (op == ZXRIO_READ_AT) ? ZXRIO_READ_VMO_AT : ZXRIO_READ_VMO;
+        ssize_t n = read_vmo_common(vmo_op, rio, data, len, offset);
+        if (n != ZX_ERR_NOT_SUPPORTED) {
+            return n;
+        }
+    }
+
     while (len > 0) {
         xfer = (len > FDIO_CHUNK_SIZE) ? FDIO_CHUNK_SIZE : len;
 
@@ -491,6 +666,10 @@ zx_status_t zxrio_close(fdio_t* io) {
         rio->h2 = 0;
         zx_handle_close(h);
     }
+    if (rio->xfer_vmo != ZX_HANDLE_INVALID) {
+        zx_handle_close(rio->xfer_vmo);
+        rio->xfer_vmo = ZX_HANDLE_INVALID;
+    }
 
     return r;
 }
@@ -955,6 +1134,9 @@ static zx_status_t zxrio_unwrap(fdio_t* io, zx_handle_t* handles, uint32_t* type
     } else {
         r = 1;
     }
+    if (rio->xfer_vmo != ZX_HANDLE_INVALID) {
+        zx_handle_close(rio->xfer_vmo);
+    }
     free(io);
     return r;
 }
@@ -1018,5 +1200,6 @@ fdio_t* fdio_remote_create(zx_handle_t h, zx_handle_t e) {
     rio->h = h;
     rio->h2 = e;
     atomic_init(&rio->txid, 1);
+    mtx_init(&rio->xfer_lock, mtx_plain);
     return &rio->io;
 }
@@ -15,6 +15,9 @@
 #include <fdio/io.h>
 #include <fdio/remoteio.h>
 #include <fdio/vfs.h>
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
 #include <fs/trace.h>
 #include <fs/vnode.h>
 #include <zircon/assert.h>
@@ -24,6 +27,9 @@
 namespace fs {
 namespace {
 
+// Largest piece of a transfer vmo request handed to the vnode at once.
+constexpr size_t kXferChunkSize = 64 * 1024;
+
 void WriteDescribeError(zx::channel channel, zx_status_t status) {
     zxrio_describe_t msg;
     memset(&msg, 0, sizeof(msg));
@@ -168,6 +174,85 @@ zx_status_t Connection::Serve() {
     return status;
 }
 
+zx_status_t Connection::ReadToXferVmo(size_t len, size_t offset, size_t* out_actual) {
+    fbl::AllocChecker ac;
+    size_t chunk = fbl::min(len, kXferChunkSize);
+    fbl::unique_ptr<uint8_t[]> buf(new (&ac) uint8_t[chunk]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    size_t done = 0;
+    zx_status_t status = ZX_OK;
+    while (done < len) {
+        size_t xfer = fbl::min(len - done, chunk);
+        size_t actual;
+        if ((status = vnode_->Read(buf.get(), xfer, offset + done, &actual)) != ZX_OK) {
+            break;
+        }
+        ZX_DEBUG_ASSERT(actual <= xfer);
+        if ((status = xfer_vmo_.write(buf.get(), done, actual, &actual)) != ZX_OK) {
+            break;
+        }
+        done += actual;
+        if (actual < xfer) {
+            break;
+        }
+    }
+    // Report what was moved before any failure, as a short read.
+    if (done == 0 && status != ZX_OK) {
+        return status;
+    }
+    *out_actual = done;
+    return ZX_OK;
+}
+
+zx_status_t Connection::WriteFromXferVmo(size_t len, size_t offset, bool append,
+                                         size_t* out_actual, size_t* out_end) {
+    fbl::AllocChecker ac;
+    size_t chunk = fbl::min(len, kXferChunkSize);
+    fbl::unique_ptr<uint8_t[]> buf(new (&ac) uint8_t[chunk]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    size_t done = 0;
+    size_t end = offset;
+    zx_status_t status = ZX_OK;
+    while (done < len) {
+        size_t xfer = fbl::min(len - done, chunk);
+        size_t actual;
+        if ((status = xfer_vmo_.read(buf.get(), done, xfer, &actual)) != ZX_OK) {
+            break;
+        }
+        if (actual != xfer) {
+            status = ZX_ERR_IO;
+            break;
+        }
+        if (append) {
+            status = vnode_->Append(buf.get(), xfer, &end, &actual);
+        } else {
+            status = vnode_->Write(buf.get(), xfer, offset + done, &actual);
+            end = offset + done + actual;
+        }
+        if (status != ZX_OK) {
+            break;
+        }
+        ZX_DEBUG_ASSERT(actual <= xfer);
+        done += actual;
+        if (actual < xfer) {
+            break;
+        }
+    }
+    // Report what was moved before any failure, as a short write.
+    if (done == 0 && status != ZX_OK) {
+        return status;
+    }
+    *out_actual = done;
+    *out_end = end;
+    return ZX_OK;
+}
+
 zx_status_t Connection::CallHandler() {
     return zxrio_handler(channel_.get(), &Connection::HandleMessageThunk, this);
 }
@@ -307,6 +392,62 @@ zx_status_t Connection::HandleMessage(zxrio_msg_t* msg) {
         }
         return status;
     }
+    case ZXRIO_XFER_VMO: {
+        TRACE_DURATION("vfs", "ZXRIO_XFER_VMO");
+        zx::vmo vmo(msg->handle[0]); // take ownership
+        if (IsPathOnly(flags_)) {
+            return ZX_ERR_BAD_HANDLE;
+        }
+        xfer_vmo_ = fbl::move(vmo);
+        return ZX_OK;
+    }
+    case ZXRIO_READ_VMO:
+    case ZXRIO_READ_VMO_AT: {
+        TRACE_DURATION("vfs", "ZXRIO_READ_VMO", "len", arg);
+        if (!IsReadable(flags_)) {
+            return ZX_ERR_BAD_HANDLE;
+        } else if (!xfer_vmo_) {
+            return ZX_ERR_BAD_STATE;
+        } else if ((arg < 0) || (arg > FDIO_XFER_VMO_SIZE)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        bool at = ZXRIO_OP(msg->op) == ZXRIO_READ_VMO_AT;
+        size_t actual;
+        zx_status_t status = ReadToXferVmo(arg, at ? msg->arg2.off : offset_, &actual);
+        if (status != ZX_OK) {
+            return status;
+        }
+        if (!at) {
+            offset_ += actual;
+            msg->arg2.off = offset_;
+        }
+        return static_cast<zx_status_t>(actual);
+    }
+    case ZXRIO_WRITE_VMO:
+    case ZXRIO_WRITE_VMO_AT: {
+        TRACE_DURATION("vfs", "ZXRIO_WRITE_VMO", "len", arg);
+        if (!IsWritable(flags_)) {
+            return ZX_ERR_BAD_HANDLE;
+        } else if (!xfer_vmo_) {
+            return ZX_ERR_BAD_STATE;
+        } else if ((arg < 0) || (arg > FDIO_XFER_VMO_SIZE)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        bool at = ZXRIO_OP(msg->op) == ZXRIO_WRITE_VMO_AT;
+        bool append = !at && (flags_ & ZX_FS_FLAG_APPEND);
+        size_t actual;
+        size_t end;
+        zx_status_t status = WriteFromXferVmo(arg, at ? msg->arg2.off : offset_, append,
+                                              &actual, &end);
+        if (status != ZX_OK) {
+            return status;
+        }
+        if (!at) {
+            offset_ = end;
+            msg->arg2.off = offset_;
+        }
+        return static_cast<zx_status_t>(actual);
+    }
     case ZXRIO_SEEK: {
         TRACE_DURATION("vfs", "ZXRIO_SEEK");
         if (IsPathOnly(flags_)) {
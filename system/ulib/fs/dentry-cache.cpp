@@ -0,0 +1,120 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "dentry-cache.h"
+
+#include <stdint.h>
+
+#include <fbl/alloc_checker.h>
+#include <fs/vnode.h>
+
+namespace fs {
+namespace {
+
+constexpr uint64_t kFnvOffsetBasis = 14695981039346656037ull;
+constexpr uint64_t kFnvPrime = 1099511628211ull;
+
+uint64_t Fnv1a(uint64_t hash, const void* data, size_t len) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * kFnvPrime;
+    }
+    return hash;
+}
+
+} // namespace
+
+DentryCache::Dentry::Dentry(fbl::RefPtr<Vnode> parent, fbl::String name,
+                            fbl::RefPtr<Vnode> child)
+    : parent_(fbl::move(parent)), name_(fbl::move(name)), child_(fbl::move(child)) {}
+
+DentryCache::Dentry::~Dentry() = default;
+
+size_t DentryCache::Dentry::GetHash(const Key& key) {
+    uintptr_t parent = reinterpret_cast<uintptr_t>(key.parent);
+    uint64_t hash = Fnv1a(kFnvOffsetBasis, &parent, sizeof(parent));
+    return static_cast<size_t>(Fnv1a(hash, key.name.data(), key.name.length()));
+}
+
+DentryCache::DentryCache(size_t max_entries)
+    : max_entries_(max_entries) {}
+
+DentryCache::~DentryCache() {
+    Clear();
+}
+
+bool DentryCache::Lookup(Vnode* parent, fbl::StringPiece name, fbl::RefPtr<Vnode>* out) {
+    auto iter = hash_.find(Key{parent, name});
+    if (!iter.IsValid()) {
+        return false;
+    }
+    Dentry* dentry = &*iter;
+    lru_.push_front(lru_.erase(*dentry));
+    *out = dentry->child();
+    return true;
+}
+
+void DentryCache::Insert(fbl::RefPtr<Vnode> parent, fbl::StringPiece name,
+                         fbl::RefPtr<Vnode> child) {
+    if (max_entries_ == 0) {
+        return;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::String copy(name.data(), name.length(), &ac);
+    if (!ac.check()) {
+        return;
+    }
+    fbl::unique_ptr<Dentry> dentry(new (&ac) Dentry(fbl::move(parent), fbl::move(copy),
+                                                    fbl::move(child)));
+    if (!ac.check()) {
+        return;
+    }
+
+    auto iter = hash_.find(dentry->GetKey());
+    if (iter.IsValid()) {
+        Remove(&*iter);
+    } else if (hash_.size() >= max_entries_) {
+        Remove(&lru_.back());
+    }
+    hash_.insert(dentry.get());
+    lru_.push_front(fbl::move(dentry));
+}
+
+void DentryCache::Invalidate(Vnode* parent, fbl::StringPiece name, const Vnode* removed) {
+    // Keeps the forgotten entries, and so |removed|, alive until the sweep
+    // below is done comparing against it.
+    LruList forgotten;
+    auto iter = hash_.find(Key{parent, name});
+    if (iter.IsValid()) {
+        fbl::unique_ptr<Dentry> dentry = Remove(&*iter);
+        if (removed == nullptr) {
+            removed = dentry->child().get();
+        }
+        forgotten.push_front(fbl::move(dentry));
+    }
+    if (removed == nullptr) {
+        return;
+    }
+
+    for (auto it = lru_.begin(); it != lru_.end();) {
+        Dentry* next = &*it;
+        ++it;
+        if (next->parent() == removed || next->child().get() == removed) {
+            forgotten.push_front(Remove(next));
+        }
+    }
+}
+
+void DentryCache::Clear() {
+    hash_.clear();
+    lru_.clear();
+}
+
+fbl::unique_ptr<DentryCache::Dentry> DentryCache::Remove(Dentry* dentry) {
+    hash_.erase(*dentry);
+    return lru_.erase(*dentry);
+}
+
+} // namespace fs
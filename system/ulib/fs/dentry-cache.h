@@ -0,0 +1,95 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <fbl/intrusive_double_list.h>
+#include <fbl/intrusive_hash_table.h>
+#include <fbl/intrusive_single_list.h>
+#include <fbl/macros.h>
+#include <fbl/ref_ptr.h>
+#include <fbl/string.h>
+#include <fbl/string_piece.h>
+#include <fbl/unique_ptr.h>
+
+namespace fs {
+
+class Vnode;
+
+// Caches the results of Vnode::Lookup, keyed on the parent directory and the
+// name looked up.  A negative entry records that the name was not found.
+//
+// Entries hold references to both vnodes, so a cached parent can never be
+// destroyed and have its address reused while entries under it remain.
+// The least recently used entry is evicted once the cache is full.
+//
+// This class is not thread-safe; Vfs only touches it with vfs_lock_ held.
+class DentryCache {
+public:
+    explicit DentryCache(size_t max_entries);
+    ~DentryCache();
+
+    // Returns true if |name| in |parent| is cached, setting |out| to the
+    // vnode found, or to nullptr if the name is known not to exist.
+    bool Lookup(Vnode* parent, fbl::StringPiece name, fbl::RefPtr<Vnode>* out);
+
+    // Records the result of looking up |name| in |parent|, replacing any
+    // entry already present.  A null |child| records a negative entry.
+    void Insert(fbl::RefPtr<Vnode> parent, fbl::StringPiece name, fbl::RefPtr<Vnode> child);
+
+    // Forgets |name| in |parent|.  |removed| is the vnode which the name
+    // referred to before being unlinked or replaced, or nullptr if there was
+    // none or it is unknown, in which case the cached child is used.  Every
+    // entry naming that vnode or beneath it is forgotten too, so that the
+    // cache does not keep an unlinked vnode alive.
+    void Invalidate(Vnode* parent, fbl::StringPiece name, const Vnode* removed);
+
+    // Forgets everything.
+    void Clear();
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(DentryCache);
+
+    struct Key {
+        const Vnode* parent;
+        fbl::StringPiece name;
+
+        bool operator==(const Key& other) const {
+            return parent == other.parent && name == other.name;
+        }
+    };
+
+    class Dentry : public fbl::SinglyLinkedListable<Dentry*>,
+                   public fbl::DoublyLinkedListable<fbl::unique_ptr<Dentry>> {
+    public:
+        Dentry(fbl::RefPtr<Vnode> parent, fbl::String name, fbl::RefPtr<Vnode> child);
+        ~Dentry();
+
+        Key GetKey() const { return Key{parent_.get(), name_.ToStringPiece()}; }
+        static size_t GetHash(const Key& key);
+
+        const Vnode* parent() const { return parent_.get(); }
+        const fbl::RefPtr<Vnode>& child() const { return child_; }
+
+    private:
+        fbl::RefPtr<Vnode> parent_;
+        fbl::String name_;
+        fbl::RefPtr<Vnode> child_;
+    };
+
+    static constexpr size_t kNumBuckets = 256;
+    using HashTable = fbl::HashTable<Key, Dentry*, fbl::SinglyLinkedList<Dentry*>,
+                                     size_t, kNumBuckets>;
+    using LruList = fbl::DoublyLinkedList<fbl::unique_ptr<Dentry>>;
+
+    // Unlinks |dentry| from the cache and returns ownership of it.
+    fbl::unique_ptr<Dentry> Remove(Dentry* dentry);
+
+    const size_t max_entries_;
+    HashTable hash_;
+    // Most recently used entries at the front.
+    LruList lru_;
+};
+
+} // namespace fs
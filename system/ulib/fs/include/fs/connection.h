@@ -17,6 +17,7 @@
 #include <fs/vfs.h>
 #include <fs/vnode.h>
 #include <zx/event.h>
+#include <zx/vmo.h>
 
 namespace fs {
 
@@ -60,6 +61,12 @@ private:
     static zx_status_t HandleMessageThunk(zxrio_msg_t* msg, void* cookie);
     zx_status_t HandleMessage(zxrio_msg_t* msg);
 
+    // Move up to |len| bytes between the vnode at |offset| and the start
+    // of |xfer_vmo_|, returning how many were moved in |out_actual|.
+    zx_status_t ReadToXferVmo(size_t len, size_t offset, size_t* out_actual);
+    zx_status_t WriteFromXferVmo(size_t len, size_t offset, bool append,
+                                 size_t* out_actual, size_t* out_end);
+
     bool is_waiting() const { return wait_.object() != ZX_HANDLE_INVALID; }
 
     fs::Vfs* const vfs_;
@@ -85,6 +92,10 @@ private:
 
     // Current seek offset.
     size_t offset_{};
+
+    // Transfer buffer supplied by the client with ZXRIO_XFER_VMO, through
+    // which ZXRIO_{READ,WRITE}_VMO{,_AT} move their data.
+    zx::vmo xfer_vmo_;
 };
 
 } // namespace fs
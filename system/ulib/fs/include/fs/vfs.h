@@ -36,6 +36,7 @@
 namespace fs {
 
 class Connection;
+class DentryCache;
 class Vnode;
 
 inline constexpr bool IsWritable(uint32_t flags) {
@@ -127,6 +128,18 @@ public:
     // Sets whether this file system is read-only.
     void SetReadonly(bool value) __TA_EXCLUDES(vfs_lock_);
 
+    // Caches up to |max_entries| results of Vnode::Lookup, including names
+    // which were not found, so that walking the same paths again does not
+    // call into the filesystem.
+    //
+    // Only suitable for filesystems whose directories change solely through
+    // this Vfs (by Open with ZX_FS_FLAG_CREATE, Unlink, Rename and Link),
+    // since those are what keep the cache up to date.
+    zx_status_t EnableDentryCache(size_t max_entries = kDefaultDentryCacheSize)
+        __TA_EXCLUDES(vfs_lock_);
+
+    static constexpr size_t kDefaultDentryCacheSize = 1024;
+
 #ifdef __Fuchsia__
     void TokenDiscard(zx::event ios_token) __TA_EXCLUDES(vfs_lock_);
     zx_status_t VnodeToToken(fbl::RefPtr<Vnode> vn, zx::event* ios_token,
@@ -181,6 +194,21 @@ protected:
     bool ReadonlyLocked() const __TA_REQUIRES(vfs_lock_) { return readonly_; }
 
 private:
+    // Looks up |name| in |vn|, consulting the dentry cache if there is one.
+    zx_status_t LookupLocked(fbl::RefPtr<Vnode> vn, fbl::RefPtr<Vnode>* out,
+                             fbl::StringPiece name) __TA_REQUIRES(vfs_lock_);
+
+    // If the dentry cache is enabled, returns the vnode |name| in |vn| refers
+    // to before it is unlinked or replaced, for passing to InvalidateLocked.
+    fbl::RefPtr<Vnode> LookupForRemovalLocked(fbl::RefPtr<Vnode> vn, fbl::StringPiece name)
+        __TA_REQUIRES(vfs_lock_);
+
+    // Drops any cached lookup of |name| in |vn|, after it has been created,
+    // removed or replaced, along with every entry holding on to |removed|,
+    // the vnode the name used to refer to.
+    void InvalidateLocked(Vnode* vn, fbl::StringPiece name, const Vnode* removed)
+        __TA_REQUIRES(vfs_lock_);
+
     // Starting at vnode |vn|, walk the tree described by the path string,
     // until either there is only one path segment remaining in the string
     // or we encounter a vnode that represents a remote filesystem
@@ -196,6 +224,7 @@ private:
                            uint32_t flags, uint32_t mode) __TA_REQUIRES(vfs_lock_);
 
     bool readonly_{};
+    fbl::unique_ptr<DentryCache> dentry_cache_;
 
 #ifdef __Fuchsia__
     zx_status_t TokenToVnode(zx::event token, fbl::RefPtr<Vnode>* out) __TA_REQUIRES(vfs_lock_);
@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <fbl/alloc_checker.h>
 #include <fbl/auto_call.h>
 #include <fdio/remoteio.h>
 #include <fdio/watcher.h>
@@ -26,6 +27,8 @@
 #include <fs/vfs.h>
 #include <fs/vnode.h>
 
+#include "dentry-cache.h"
+
 // #define DEBUG_PRINTF
 #ifdef DEBUG_PRINTF
 #define xprintf(args...) fprintf(stderr, args)
@@ -59,17 +62,6 @@ zx_status_t vfs_name_trim(fbl::StringPiece name, fbl::StringPiece* name_out,
     return ZX_OK;
 }
 
-zx_status_t vfs_lookup(fbl::RefPtr<Vnode> vn, fbl::RefPtr<Vnode>* out,
-                       fbl::StringPiece name) {
-    if (name == "..") {
-        return ZX_ERR_INVALID_ARGS;
-    } else if (name == ".") {
-        *out = fbl::move(vn);
-        return ZX_OK;
-    }
-    return vn->Lookup(out, name);
-}
-
 // Validate open flags as much as they can be validated
 // independently of the target node.
 zx_status_t vfs_prevalidate_flags(uint32_t flags) {
@@ -125,6 +117,65 @@ zx_status_t Vfs::Open(fbl::RefPtr<Vnode> vndir, fbl::RefPtr<Vnode>* out,
     return OpenLocked(fbl::move(vndir), out, path, pathout, flags, mode);
 }
 
+zx_status_t Vfs::EnableDentryCache(size_t max_entries) {
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<DentryCache> cache(new (&ac) DentryCache(max_entries));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+#ifdef __Fuchsia__
+    fbl::AutoLock lock(&vfs_lock_);
+#endif
+    dentry_cache_ = fbl::move(cache);
+    return ZX_OK;
+}
+
+zx_status_t Vfs::LookupLocked(fbl::RefPtr<Vnode> vn, fbl::RefPtr<Vnode>* out,
+                              fbl::StringPiece name) {
+    if (name == "..") {
+        return ZX_ERR_INVALID_ARGS;
+    } else if (name == ".") {
+        *out = fbl::move(vn);
+        return ZX_OK;
+    }
+
+    if (dentry_cache_ == nullptr) {
+        return vn->Lookup(out, name);
+    }
+    fbl::RefPtr<Vnode> cached;
+    if (dentry_cache_->Lookup(vn.get(), name, &cached)) {
+        if (cached == nullptr) {
+            return ZX_ERR_NOT_FOUND;
+        }
+        *out = fbl::move(cached);
+        return ZX_OK;
+    }
+    // Directories cannot change while vfs_lock_ is held, so the result may
+    // be cached as it is.
+    zx_status_t r = vn->Lookup(&cached, name);
+    if (r == ZX_OK || r == ZX_ERR_NOT_FOUND) {
+        dentry_cache_->Insert(vn, name, cached);
+    }
+    if (r == ZX_OK) {
+        *out = fbl::move(cached);
+    }
+    return r;
+}
+
+fbl::RefPtr<Vnode> Vfs::LookupForRemovalLocked(fbl::RefPtr<Vnode> vn, fbl::StringPiece name) {
+    fbl::RefPtr<Vnode> out;
+    if (dentry_cache_ != nullptr) {
+        LookupLocked(fbl::move(vn), &out, name);
+    }
+    return out;
+}
+
+void Vfs::InvalidateLocked(Vnode* vn, fbl::StringPiece name, const Vnode* removed) {
+    if (dentry_cache_ != nullptr) {
+        dentry_cache_->Invalidate(vn, name, removed);
+    }
+}
+
 zx_status_t Vfs::OpenLocked(fbl::RefPtr<Vnode> vndir, fbl::RefPtr<Vnode>* out,
                             fbl::StringPiece path, fbl::StringPiece* pathout,
                             uint32_t flags, uint32_t mode) {
@@ -173,10 +224,11 @@ zx_status_t Vfs::OpenLocked(fbl::RefPtr<Vnode> vndir, fbl::RefPtr<Vnode>* out,
             }
             return r;
         }
+        InvalidateLocked(vndir.get(), path, nullptr);
         vndir->Notify(path, VFS_WATCH_EVT_ADDED);
     } else {
     try_open:
-        r = vfs_lookup(fbl::move(vndir), &vn, path);
+        r = LookupLocked(fbl::move(vndir), &vn, path);
         if (r < 0) {
             return r;
         }
@@ -226,14 +278,20 @@ zx_status_t Vfs::Unlink(fbl::RefPtr<Vnode> vndir, fbl::StringPiece path) {
     }
 
     {
+        // Released only once vfs_lock_ has been dropped.
+        fbl::RefPtr<Vnode> removed;
 #ifdef __Fuchsia__
         fbl::AutoLock lock(&vfs_lock_);
 #endif
         if (ReadonlyLocked()) {
             r = ZX_ERR_ACCESS_DENIED;
         } else {
+            removed = LookupForRemovalLocked(vndir, path);
             r = vndir->Unlink(path, must_be_dir);
         }
+        if (r == ZX_OK) {
+            InvalidateLocked(vndir.get(), path, removed.get());
+        }
     }
     if (r != ZX_OK) {
         return r;
@@ -329,6 +387,8 @@ zx_status_t Vfs::Rename(zx::event token, fbl::RefPtr<Vnode> oldparent,
 
     fbl::RefPtr<fs::Vnode> newparent;
     {
+        // Released only once vfs_lock_ has been dropped.
+        fbl::RefPtr<Vnode> replaced;
         fbl::AutoLock lock(&vfs_lock_);
         if (ReadonlyLocked()) {
             return ZX_ERR_ACCESS_DENIED;
@@ -337,8 +397,13 @@ zx_status_t Vfs::Rename(zx::event token, fbl::RefPtr<Vnode> oldparent,
             return r;
         }
 
+        replaced = LookupForRemovalLocked(newparent, newStr);
         r = oldparent->Rename(newparent, oldStr, newStr, old_must_be_dir,
                               new_must_be_dir);
+        if (r == ZX_OK) {
+            InvalidateLocked(oldparent.get(), oldStr, nullptr);
+            InvalidateLocked(newparent.get(), newStr, replaced.get());
+        }
     }
     if (r != ZX_OK) {
         return r;
@@ -387,13 +452,14 @@ zx_status_t Vfs::Link(zx::event token, fbl::RefPtr<Vnode> oldparent,
 
     // Look up the target vnode
     fbl::RefPtr<Vnode> target;
-    if ((r = oldparent->Lookup(&target, oldStr)) < 0) {
+    if ((r = LookupLocked(oldparent, &target, oldStr)) < 0) {
         return r;
     }
     r = newparent->Link(newStr, target);
     if (r != ZX_OK) {
         return r;
     }
+    InvalidateLocked(newparent.get(), newStr, nullptr);
     newparent->Notify(newStr, VFS_WATCH_EVT_ADDED);
     return ZX_OK;
 }
@@ -491,6 +557,13 @@ zx_status_t Vfs::Ioctl(fbl::RefPtr<Vnode> vn, uint32_t op, const void* in_buf, s
     }
     case IOCTL_VFS_UNMOUNT_FS: {
         Vfs::UninstallAll(ZX_TIME_INFINITE);
+        {
+            // Let go of the vnodes before the filesystem goes away.
+            fbl::AutoLock lock(&vfs_lock_);
+            if (dentry_cache_ != nullptr) {
+                dentry_cache_->Clear();
+            }
+        }
         *out_actual = 0;
         vn->Ioctl(op, in_buf, in_len, out_buf, out_len, out_actual);
         return ZX_OK;
@@ -552,7 +625,7 @@ zx_status_t Vfs::Walk(fbl::RefPtr<Vnode> vn, fbl::RefPtr<Vnode>* out,
             // traverse to the next segment
             size_t len = nextpath - path;
             nextpath++;
-            if ((r = vfs_lookup(fbl::move(vn), &vn, fbl::StringPiece(path, len))) < 0) {
+            if ((r = LookupLocked(fbl::move(vn), &vn, fbl::StringPiece(path, len))) < 0) {
                 return r;
             }
             path = nextpath;
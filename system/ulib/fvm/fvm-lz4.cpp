@@ -4,10 +4,80 @@
 
 #include "fvm/fvm-lz4.h"
 
+#include <pthread.h>
+
+#include <fbl/algorithm.h>
+#include <lz4/lz4.h>
+
 namespace fvm {
+namespace {
+
+// Frames of independent blocks are read and decompressed this many blocks per thread at a time.
+constexpr size_t kBlocksPerThread = 4;
+// Bounds the memory used for a batch on machines with many cpus.
+constexpr size_t kMaxThreads = 8;
+
+// Largest LZ4 frame header: magic, flags, block descriptor, content size and header checksum.
+constexpr size_t kLz4MaxHeaderSize = 15;
+constexpr uint8_t kLz4FlagContentSize = 0x08;
+constexpr uint32_t kLz4BlockUncompressed = 0x80000000;
+
+// A block of a batch, decompressed into its own LZ4_MAX_BLOCK_SIZE slot of the output.
+struct Block {
+    const uint8_t* src;
+    size_t src_size;
+    bool uncompressed;
+    uint8_t* dst;
+    int dst_size;
+};
+
+// A contiguous range of the blocks of a batch to be decompressed by one thread.
+struct DecompressTask {
+    Block* blocks;
+    size_t first;
+    size_t last;
+};
+
+void* DecompressThread(void* arg) {
+    DecompressTask* task = static_cast<DecompressTask*>(arg);
+    for (size_t i = task->first; i < task->last; i++) {
+        Block* block = &task->blocks[i];
+        if (block->uncompressed) {
+            memcpy(block->dst, block->src, block->src_size);
+            block->dst_size = static_cast<int>(block->src_size);
+        } else {
+            block->dst_size = LZ4_decompress_safe(reinterpret_cast<const char*>(block->src),
+                                                  reinterpret_cast<char*>(block->dst),
+                                                  static_cast<int>(block->src_size),
+                                                  LZ4_MAX_BLOCK_SIZE);
+        }
+    }
+    return nullptr;
+}
+
+size_t DefaultThreads() {
+#ifdef __Fuchsia__
+    size_t cpus = zx_system_get_num_cpus();
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t cpus = n > 0 ? static_cast<size_t>(n) : 1;
+#endif
+    return fbl::min(cpus, kMaxThreads);
+}
+
+} // namespace
+
 zx_status_t SparseReader::Create(fbl::unique_fd fd, fbl::unique_ptr<SparseReader>* out) {
+    return Create(fbl::move(fd), 0, out);
+}
+
+zx_status_t SparseReader::Create(fbl::unique_fd fd, size_t num_threads,
+                                 fbl::unique_ptr<SparseReader>* out) {
+    if (num_threads == 0) {
+        num_threads = DefaultThreads();
+    }
     fbl::AllocChecker ac;
-    fbl::unique_ptr<SparseReader> reader(new (&ac) SparseReader(fbl::move(fd)));
+    fbl::unique_ptr<SparseReader> reader(new (&ac) SparseReader(fbl::move(fd), num_threads));
     if (!ac.check()) {
         return ZX_ERR_NO_MEMORY;
     }
@@ -21,7 +91,8 @@ zx_status_t SparseReader::Create(fbl::unique_fd fd, fbl::unique_ptr<SparseReader
     return ZX_OK;
 }
 
-SparseReader::SparseReader(fbl::unique_fd fd) : compressed_(false), fd_(fbl::move(fd)) {}
+SparseReader::SparseReader(fbl::unique_fd fd, size_t num_threads)
+    : compressed_(false), parallel_(false), num_threads_(num_threads), fd_(fbl::move(fd)) {}
 
 zx_status_t SparseReader::ReadMetadata() {
     // Read sparse image
@@ -62,40 +133,59 @@ zx_status_t SparseReader::ReadMetadata() {
             return ZX_ERR_INTERNAL;
         }
 
-        size_t src_sz = 4;
-        size_t dst_sz = 0;
-        fbl::unique_ptr<uint8_t[]> inbufptr(new (&ac) uint8_t[src_sz]);
-        if (!ac.check()) {
-            return ZX_ERR_NO_MEMORY;
+        // Read the frame header: magic, flags and block descriptor, then the content size if
+        // there is one and the header checksum.
+        uint8_t header[kLz4MaxHeaderSize];
+        size_t header_size = 6;
+        size_t actual = 0;
+        zx_status_t status;
+        if ((status = ReadRaw(header, header_size, &actual)) != ZX_OK) {
+            return status;
+        } else if (actual < header_size) {
+            fprintf(stderr, "SparseReader: could not read from input\n");
+            return ZX_ERR_IO;
         }
-
-        uint8_t* inbuf = inbufptr.get();
-
-        // Read first 4 bytes to let LZ4 tell us how much it expects in the first pass.
-        ssize_t nr = read(fd_.get(), inbuf, src_sz);
-        if (nr < static_cast<ssize_t>(src_sz)) {
+        size_t rest = ((header[4] & kLz4FlagContentSize) ? 8 : 0) + 1;
+        if ((status = ReadRaw(header + header_size, rest, &actual)) != ZX_OK) {
+            return status;
+        } else if (actual < rest) {
             fprintf(stderr, "SparseReader: could not read from input\n");
             return ZX_ERR_IO;
         }
+        header_size += rest;
 
-        // Run decompress once to find out how much data we should read for the next decompress run
-        // Since we are not yet decompressing any actual data, the dst_buffer is null
-        to_read_ = LZ4F_decompress(dctx_, nullptr, &dst_sz, inbuf, &src_sz, NULL);
+        // Decoding the header tells us how much LZ4 expects in the next pass.
+        LZ4F_frameInfo_t info;
+        size_t src_sz = header_size;
+        to_read_ = LZ4F_getFrameInfo(dctx_, &info, header, &src_sz);
         if (LZ4F_isError(to_read_)) {
             fprintf(stderr, "SparseReader: could not decompress header: %s\n",
                     LZ4F_getErrorName(to_read_));
             return ZX_ERR_INTERNAL;
+        } else if (src_sz != header_size) {
+            fprintf(stderr, "SparseReader: unexpected frame header\n");
+            return ZX_ERR_IO_DATA_INTEGRITY;
         }
 
         if (to_read_ > LZ4_MAX_BLOCK_SIZE) {
             to_read_ = LZ4_MAX_BLOCK_SIZE;
         }
 
+        // Blocks which do not refer back to earlier ones can be decompressed in parallel. A
+        // content checksum is only verified by the decompression context, so frames with one
+        // are read serially.
+        parallel_ = info.blockMode == LZ4F_blockIndependent &&
+                    info.blockSizeID == LZ4F_max64KB &&
+                    info.contentChecksumFlag == LZ4F_noContentChecksum;
+        size_t buf_size = LZ4_MAX_BLOCK_SIZE;
+        if (parallel_) {
+            buf_size *= num_threads_ * kBlocksPerThread;
+        }
+
         // Initialize data buffers
-        zx_status_t status;
-        if ((status = InitializeBuffer(LZ4_MAX_BLOCK_SIZE, &out_buf_)) != ZX_OK) {
+        if ((status = InitializeBuffer(buf_size, &out_buf_)) != ZX_OK) {
             return status;
-        } else if ((status = InitializeBuffer(LZ4_MAX_BLOCK_SIZE, &in_buf_)) != ZX_OK) {
+        } else if ((status = InitializeBuffer(buf_size, &in_buf_)) != ZX_OK) {
             return status;
         }
     }
@@ -146,7 +236,7 @@ zx_status_t SparseReader::ReadData(uint8_t* data, size_t length, size_t* actual)
 #endif
     size_t total_size = 0;
     if (compressed_) {
-        if (to_read_ == 0) {
+        if (to_read_ == 0 && out_buf_.is_empty()) {
             // There is no more to read
             return ZX_ERR_OUT_OF_RANGE;
         }
@@ -156,49 +246,58 @@ zx_status_t SparseReader::ReadData(uint8_t* data, size_t length, size_t* actual)
 
         // If we still have data to read, start decompression (reading more from fd as needed)
         while (total_size < length && to_read_ > 0) {
-            // Make sure data to read does not exceed max, and both buffers are empty
+            // Make sure both buffers are empty
             ZX_ASSERT(out_buf_.is_empty());
             ZX_ASSERT(in_buf_.is_empty());
-            ZX_ASSERT(to_read_ <= in_buf_.max_size);
 
-            // Read specified amount from fd
             zx_status_t status;
-            if ((status = ReadRaw(in_buf_.data.get(), to_read_, &in_buf_.size)) != ZX_OK) {
-                return status;
-            }
+            if (parallel_) {
+                if ((status = DecompressBatch()) != ZX_OK) {
+                    return status;
+                }
+            } else {
+                // Make sure data to read does not exceed max
+                ZX_ASSERT(to_read_ <= in_buf_.max_size);
 
-            size_t src_sz = in_buf_.size;
-            size_t next = 0;
-
-            // Decompress all compressed data
-            while (in_buf_.offset < to_read_) {
-                size_t dst_sz = out_buf_.max_size - out_buf_.size;
-                next = LZ4F_decompress(dctx_, out_buf_.data.get() + out_buf_.size, &dst_sz,
-                                       in_buf_.data.get() + in_buf_.offset, &src_sz, NULL);
-                if (LZ4F_isError(next)) {
-                    fprintf(stderr, "could not decompress input: %s\n", LZ4F_getErrorName(next));
-                    return -1;
+                // Read specified amount from fd
+                if ((status = ReadRaw(in_buf_.data.get(), to_read_, &in_buf_.size)) != ZX_OK) {
+                    return status;
                 }
 
-                out_buf_.size += dst_sz;
-                in_buf_.offset += src_sz;
-                in_buf_.size -= src_sz;
-                src_sz = to_read_ - in_buf_.offset;
-            }
+                size_t src_sz = in_buf_.size;
+                size_t next = 0;
+
+                // Decompress all compressed data
+                while (in_buf_.offset < to_read_) {
+                    size_t dst_sz = out_buf_.max_size - out_buf_.size;
+                    next = LZ4F_decompress(dctx_, out_buf_.data.get() + out_buf_.size, &dst_sz,
+                                           in_buf_.data.get() + in_buf_.offset, &src_sz, NULL);
+                    if (LZ4F_isError(next)) {
+                        fprintf(stderr, "could not decompress input: %s\n",
+                                LZ4F_getErrorName(next));
+                        return -1;
+                    }
+
+                    out_buf_.size += dst_sz;
+                    in_buf_.offset += src_sz;
+                    in_buf_.size -= src_sz;
+                    src_sz = to_read_ - in_buf_.offset;
+                }
 
-            // Make sure we have read all data from in_buf_
-            ZX_ASSERT(in_buf_.size == 0);
-            in_buf_.offset = 0;
+                // Make sure we have read all data from in_buf_
+                ZX_ASSERT(in_buf_.size == 0);
+                in_buf_.offset = 0;
+
+                to_read_ = next;
+                if (to_read_ > LZ4_MAX_BLOCK_SIZE) {
+                    to_read_ = LZ4_MAX_BLOCK_SIZE;
+                }
+            }
 
             // Copy newly decompressed data from outbuf
             size_t cp = fbl::min(length - total_size, static_cast<size_t>(out_buf_.size));
             out_buf_.read(data + total_size, cp, &cp);
             total_size += cp;
-            to_read_ = next;
-
-            if (to_read_ > LZ4_MAX_BLOCK_SIZE) {
-                to_read_ = LZ4_MAX_BLOCK_SIZE;
-            }
         }
     } else {
         zx_status_t status = ReadRaw(data, length, &total_size);
@@ -215,6 +314,105 @@ zx_status_t SparseReader::ReadData(uint8_t* data, size_t length, size_t* actual)
     return ZX_OK;
 }
 
+zx_status_t SparseReader::DecompressBatch() {
+    size_t max_blocks = in_buf_.max_size / LZ4_MAX_BLOCK_SIZE;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<Block[]> blocks(new (&ac) Block[max_blocks]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    // Read whole blocks, each preceded by its size, until the batch is full or the end mark
+    // is reached.
+    size_t num_blocks = 0;
+    size_t in_size = 0;
+    while (num_blocks < max_blocks) {
+        uint8_t header[4];
+        size_t actual = 0;
+        zx_status_t status;
+        if ((status = ReadRaw(header, sizeof(header), &actual)) != ZX_OK) {
+            return status;
+        } else if (actual < sizeof(header)) {
+            fprintf(stderr, "SparseReader: compressed data is truncated\n");
+            return ZX_ERR_IO;
+        }
+
+        uint32_t size = header[0] | (header[1] << 8) | (header[2] << 16) |
+                        (static_cast<uint32_t>(header[3]) << 24);
+        if (size == 0) {
+            to_read_ = 0;
+            break;
+        }
+
+        Block* block = &blocks[num_blocks];
+        block->uncompressed = (size & kLz4BlockUncompressed) != 0;
+        block->src_size = size & ~kLz4BlockUncompressed;
+        if (block->src_size > LZ4_MAX_BLOCK_SIZE) {
+            fprintf(stderr, "SparseReader: invalid block size %zu\n", block->src_size);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        block->src = in_buf_.data.get() + in_size;
+        block->dst = out_buf_.data.get() + num_blocks * LZ4_MAX_BLOCK_SIZE;
+        if ((status = ReadRaw(in_buf_.data.get() + in_size, block->src_size, &actual)) != ZX_OK) {
+            return status;
+        } else if (actual < block->src_size) {
+            fprintf(stderr, "SparseReader: compressed data is truncated\n");
+            return ZX_ERR_IO;
+        }
+        in_size += block->src_size;
+        num_blocks++;
+    }
+
+    size_t num_threads = fbl::min(num_threads_, num_blocks);
+    if (num_threads > 0) {
+        fbl::unique_ptr<DecompressTask[]> tasks(new (&ac) DecompressTask[num_threads]);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        fbl::unique_ptr<pthread_t[]> threads(new (&ac) pthread_t[num_threads]);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        for (size_t i = 0; i < num_threads; i++) {
+            tasks[i].blocks = blocks.get();
+            tasks[i].first = (num_blocks * i) / num_threads;
+            tasks[i].last = (num_blocks * (i + 1)) / num_threads;
+        }
+        // The calling thread takes the first task. If a thread can't be started, its task is
+        // run here instead.
+        size_t started = 0;
+        for (size_t i = 1; i < num_threads; i++) {
+            if (pthread_create(&threads[started], nullptr, DecompressThread, &tasks[i]) == 0) {
+                started++;
+            } else {
+                DecompressThread(&tasks[i]);
+            }
+        }
+        DecompressThread(&tasks[0]);
+        for (size_t i = 0; i < started; i++) {
+            pthread_join(threads[i], nullptr);
+        }
+    }
+
+    // Every block but the last of the frame is normally full, in which case the slots are
+    // already contiguous.
+    size_t out_size = 0;
+    for (size_t i = 0; i < num_blocks; i++) {
+        if (blocks[i].dst_size < 0) {
+            fprintf(stderr, "SparseReader: could not decompress block\n");
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        uint8_t* dst = out_buf_.data.get() + out_size;
+        if (blocks[i].dst != dst) {
+            memmove(dst, blocks[i].dst, blocks[i].dst_size);
+        }
+        out_size += blocks[i].dst_size;
+    }
+    out_buf_.size = out_size;
+    out_buf_.offset = 0;
+    return ZX_OK;
+}
+
 zx_status_t SparseReader::ReadRaw(uint8_t* data, size_t length, size_t* actual) {
 #ifdef __Fuchsia__
     zx_time_t start = zx_ticks_get();
@@ -30,6 +30,11 @@ namespace fvm {
 class SparseReader {
 public:
     static zx_status_t Create(fbl::unique_fd fd, fbl::unique_ptr<SparseReader>* out);
+    // As above, but decompresses with up to |num_threads| threads. Frames of independent blocks
+    // are read and decompressed a batch of blocks at a time, with the blocks of a batch split
+    // between the threads. Passing 0 picks a thread count from the number of cpus.
+    static zx_status_t Create(fbl::unique_fd fd, size_t num_threads,
+                              fbl::unique_ptr<SparseReader>* out);
     ~SparseReader();
 
     fvm::sparse_image_t* Image();
@@ -76,7 +81,7 @@ private:
         }
 
         // Data buffer
-        fbl::unique_ptr<uint8_t> data;
+        fbl::unique_ptr<uint8_t[]> data;
         // Actual size of data contained within buffer
         size_t size;
         // Offset into buffer where valid data begins
@@ -85,9 +90,11 @@ private:
         size_t max_size;
     } buffer_t;
 
-    SparseReader(fbl::unique_fd fd);
+    SparseReader(fbl::unique_fd fd, size_t num_threads);
     // Read in header data, prepare buffers and decompression context if necessary
     zx_status_t ReadMetadata();
+    // Read the next batch of blocks and decompress them in parallel into |out_buf_|.
+    zx_status_t DecompressBatch();
     // Initialize buffer with a given |size|
     static zx_status_t InitializeBuffer(size_t size, buffer_t* out_buf);
     // Read |length| bytes of raw data from file directly into |data|. Return |actual| bytes read.
@@ -97,6 +104,11 @@ private:
 
     // True if sparse file is compressed
     bool compressed_;
+    // True if the compressed frame is made of independent blocks, which are decompressed in
+    // batches by DecompressBatch() rather than by |dctx_|
+    bool parallel_;
+    // Maximum number of threads decompressing a batch
+    size_t num_threads_;
 
     fbl::unique_fd fd_;
     fbl::unique_ptr<uint8_t[]> metadata_;
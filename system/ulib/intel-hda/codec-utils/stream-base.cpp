@@ -46,7 +46,9 @@ IntelHDAStreamBase::IntelHDAStreamBase(uint32_t id, bool is_input)
     : id_(id),
       is_input_(is_input) {
     snprintf(dev_name_, sizeof(dev_name_), "%s-stream-%03u", is_input_ ? "input" : "output", id_);
-    default_domain_ = dispatcher::ExecutionDomain::Create();
+    default_domain_ = dispatcher::ExecutionDomain::Create(
+            dispatcher::ExecutionDomain::DEFAULT_PRIORITY,
+            dispatcher::ExecutionDomain::DispatchHint::LowLatency);
 }
 
 IntelHDAStreamBase::~IntelHDAStreamBase() {
@@ -50,6 +50,17 @@ typedef struct loader_service loader_service_t;
 // any number of clients.
 zx_status_t loader_service_create_fs(const char* name, loader_service_t** out);
 
+// Same as create_fs, but libraries are looked for in |libpaths|, a
+// NULL-terminated list of directories searched in order, rather than
+// in /system/lib and /boot/lib.  |libpaths| must outlive the service.
+zx_status_t loader_service_create_fs_libpaths(const char* name,
+                                              const char* const* libpaths,
+                                              loader_service_t** out);
+
+// Closes every connection to |svc|, waiting for any request being served
+// to finish, and frees it.  Must not be called from one of its ops.
+void loader_service_release(loader_service_t* svc);
+
 // Returns a new dl_set_loader_service-compatible loader service channel.
 zx_status_t loader_service_connect(loader_service_t* svc, zx_handle_t* out);
 
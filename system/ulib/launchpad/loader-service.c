@@ -31,6 +31,7 @@
 #include <zircon/syscalls.h>
 #include <zircon/threads.h>
 #include <zircon/types.h>
+#include <zircon/listnode.h>
 
 static void __PRINTFLIKE(2, 3) log_printf(zx_handle_t log,
                                           const char* fmt, ...) {
@@ -60,13 +61,20 @@ struct loader_service {
     const loader_service_ops_t* ops;
     void* ctx;
 
+    // LDMSG_OP_CONFIG may arrive on any connection while others are
+    // loading on other dispatcher threads
+    mtx_t config_lock;
     char config_prefix[PREFIX_MAX];
     bool config_exclusive;
 };
 
-static const char* const libpaths[] = {
+// Upper bound on the threads serving a multiloader's connections.
+#define LOADER_SERVICE_MAX_THREADS 4
+
+static const char* const default_libpaths[] = {
     "/system/lib",
     "/boot/lib",
+    NULL,
 };
 
 zx_status_t loader_service_publish_data_sink_fs(const char* sink_name, zx_handle_t vmo) {
@@ -134,12 +142,14 @@ zx_status_t loader_service_publish_data_sink_fs(const char* sink_name, zx_handle
 }
 
 
-// When loading a library object, search in the hard-coded locations.
-static int open_from_libpath(const char* fn) {
+// When loading a library object, search the directories in |libpaths|,
+// a NULL-terminated list, in order.  Returns the path of the object
+// found through |path|.
+static int open_from_libpath(const char* const* libpaths, const char* fn,
+                             char path[PATH_MAX]) {
     int fd = -1;
-    for (size_t n = 0; fd < 0 && n < countof(libpaths); ++n) {
-        char path[PATH_MAX];
-        snprintf(path, sizeof(path), "%s/%s", libpaths[n], fn);
+    for (size_t n = 0; fd < 0 && libpaths[n] != NULL; ++n) {
+        snprintf(path, PATH_MAX, "%s/%s", libpaths[n], fn);
         fd = open(path, O_RDONLY);
     }
     return fd;
@@ -154,11 +164,132 @@ static zx_handle_t load_object_fd(int fd, const char* fn, zx_handle_t* out) {
     return status;
 }
 
+// Library VMOs retrieved by the filesystem loader are cached, since most
+// processes load the same few libraries.  Each entry is keyed on the path it
+// was read from, and is only used while that path still names a file with
+// the same inode, size and modification time, so that a library which is
+// replaced is read afresh.  One shadowed by a library in an earlier library
+// path is simply no longer looked up.  Clients are handed copy-on-write
+// clones, so they cannot affect one another.
+#define VMO_CACHE_MAX 128
+
+typedef struct cached_object {
+    list_node_t node;
+    zx_handle_t vmo;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    char path[];
+} cached_object_t;
+
+static mtx_t vmo_cache_lock = MTX_INIT;
+static list_node_t vmo_cache = LIST_INITIAL_VALUE(vmo_cache);
+static size_t vmo_cache_count;
+
+static zx_status_t clone_object(zx_handle_t vmo, const char* fn, zx_handle_t* out) {
+    uint64_t size;
+    zx_status_t status = zx_vmo_get_size(vmo, &size);
+    if (status != ZX_OK)
+        return status;
+    status = zx_vmo_clone(vmo, ZX_VMO_CLONE_COPY_ON_WRITE, 0, size, out);
+    if (status == ZX_OK)
+        zx_object_set_property(*out, ZX_PROP_NAME, fn, strlen(fn));
+    return status;
+}
+
+static bool cached_object_matches(const cached_object_t* obj, const char* path,
+                                  const struct stat* st) {
+    return strcmp(obj->path, path) == 0 &&
+           obj->ino == st->st_ino && obj->size == st->st_size &&
+           obj->mtime.tv_sec == st->st_mtim.tv_sec && obj->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+// Looks up the file at |path|, with attributes |st|, in the cache,
+// returning a duplicate of its VMO.
+static zx_status_t vmo_cache_lookup(const char* path, const struct stat* st,
+                                    zx_handle_t* vmo) {
+    zx_status_t status = ZX_ERR_NOT_FOUND;
+    mtx_lock(&vmo_cache_lock);
+    cached_object_t* obj;
+    list_for_every_entry(&vmo_cache, obj, cached_object_t, node) {
+        if (cached_object_matches(obj, path, st)) {
+            status = zx_handle_duplicate(obj->vmo, ZX_RIGHT_SAME_RIGHTS, vmo);
+            break;
+        }
+    }
+    mtx_unlock(&vmo_cache_lock);
+    return status;
+}
+
+// Takes ownership of |vmo|, replacing any existing entry for |path|.
+static void vmo_cache_insert(const char* path, zx_handle_t vmo, const struct stat* st) {
+    size_t len = strlen(path) + 1;
+    cached_object_t* new_obj = malloc(sizeof(*new_obj) + len);
+    if (new_obj == NULL) {
+        zx_handle_close(vmo);
+        return;
+    }
+    new_obj->vmo = vmo;
+    new_obj->ino = st->st_ino;
+    new_obj->size = st->st_size;
+    new_obj->mtime = st->st_mtim;
+    memcpy(new_obj->path, path, len);
+
+    cached_object_t* old = NULL;
+    mtx_lock(&vmo_cache_lock);
+    cached_object_t* obj;
+    list_for_every_entry(&vmo_cache, obj, cached_object_t, node) {
+        if (strcmp(obj->path, path) == 0) {
+            list_delete(&obj->node);
+            vmo_cache_count--;
+            old = obj;
+            break;
+        }
+    }
+    if (vmo_cache_count < VMO_CACHE_MAX) {
+        list_add_head(&vmo_cache, &new_obj->node);
+        vmo_cache_count++;
+        new_obj = NULL;
+    }
+    mtx_unlock(&vmo_cache_lock);
+
+    if (old != NULL) {
+        zx_handle_close(old->vmo);
+        free(old);
+    }
+    if (new_obj != NULL) {
+        zx_handle_close(new_obj->vmo);
+        free(new_obj);
+    }
+}
+
 static zx_status_t fs_load_object(void *ctx, const char* name, zx_handle_t* out) {
-    int fd = open_from_libpath(name);
-    if (fd >= 0)
-        return load_object_fd(fd, name, out);
-    return ZX_ERR_NOT_FOUND;
+    const char* const* libpaths = ctx;
+    char path[PATH_MAX];
+    int fd = open_from_libpath(libpaths, name, path);
+    if (fd < 0)
+        return ZX_ERR_NOT_FOUND;
+
+    zx_handle_t vmo;
+    struct stat st;
+    bool cacheable = fstat(fd, &st) == 0;
+    if (cacheable && vmo_cache_lookup(path, &st, &vmo) == ZX_OK) {
+        close(fd);
+        zx_status_t status = clone_object(vmo, name, out);
+        zx_handle_close(vmo);
+        return status;
+    }
+
+    zx_status_t status = load_object_fd(fd, name, &vmo);
+    if (status != ZX_OK)
+        return status;
+    if (!cacheable || clone_object(vmo, name, out) != ZX_OK) {
+        // not every filesystem's VMOs can be cloned; just don't cache those
+        *out = vmo;
+        return ZX_OK;
+    }
+    vmo_cache_insert(path, vmo, &st);
+    return ZX_OK;
 }
 
 static zx_status_t fs_load_abspath(void *ctx, const char* path, zx_handle_t* out) {
@@ -194,6 +325,7 @@ static zx_status_t default_load_fn(void* cookie, uint32_t load_op,
             status = ZX_ERR_INVALID_ARGS;
             break;
         }
+        mtx_lock(&svc->config_lock);
         strncpy(svc->config_prefix, fn, len + 1);
         svc->config_exclusive = false;
         if (svc->config_prefix[len - 1] == '!') {
@@ -202,17 +334,24 @@ static zx_status_t default_load_fn(void* cookie, uint32_t load_op,
         }
         svc->config_prefix[len] = '/';
         svc->config_prefix[len + 1] = '\0';
+        mtx_unlock(&svc->config_lock);
         status = ZX_OK;
         break;
     }
-    case LDMSG_OP_LOAD_OBJECT:
+    case LDMSG_OP_LOAD_OBJECT: {
+        char prefix[PREFIX_MAX];
+        mtx_lock(&svc->config_lock);
+        memcpy(prefix, svc->config_prefix, sizeof(prefix));
+        bool exclusive = svc->config_exclusive;
+        mtx_unlock(&svc->config_lock);
+
         // If a prefix is configured, try loading with that prefix first
-        if (svc->config_prefix[0] != '\0') {
+        if (prefix[0] != '\0') {
             size_t maxlen = PREFIX_MAX + strlen(fn) + 1;
             char pfn[maxlen];
-            snprintf(pfn, maxlen, "%s%s", svc->config_prefix, fn);
+            snprintf(pfn, maxlen, "%s%s", prefix, fn);
             if (((status = svc->ops->load_object(svc->ctx, pfn, out)) == ZX_OK) ||
-                svc->config_exclusive) {
+                exclusive) {
                 // if loading with prefix succeeds, or loading
                 // with prefix is configured to be exclusive of
                 // non-prefix loading, stop here
@@ -222,6 +361,7 @@ static zx_status_t default_load_fn(void* cookie, uint32_t load_op,
         }
         status = svc->ops->load_object(svc->ctx, fn, out);
         break;
+    }
     case LDMSG_OP_LOAD_SCRIPT_INTERPRETER:
     case LDMSG_OP_DEBUG_LOAD_CONFIG:
         // When loading a script interpreter or debug configuration file,
@@ -301,8 +441,9 @@ static zx_status_t handle_loader_rpc(zx_handle_t h,
     case LDMSG_OP_DEBUG_LOAD_CONFIG:
     case LDMSG_OP_DEBUG_PUBLISH_DATA_SINK:
     case LDMSG_OP_CLONE:
-        // TODO(ZX-491): Use a threadpool for loading, and guard against
-        // other starvation attacks.
+        // TODO(ZX-491): Guard against starvation attacks.  A multiloader
+        // spreads connections over a few threads, but a slow filesystem
+        // can still tie them all up.
         r = (*loader)(loader_arg, req.header.ordinal, request_handle, data, &handle);
         if (r == ZX_ERR_NOT_FOUND) {
             fprintf(stderr, "dlsvc: could not open '%s'\n", data);
@@ -382,6 +523,8 @@ zx_status_t loader_service_create(const char* name,
 
     svc->ops = ops;
     svc->ctx = ctx;
+    mtx_init(&svc->dispatcher_lock, mtx_plain);
+    mtx_init(&svc->config_lock, mtx_plain);
     strncpy(svc->name, name, sizeof(svc->name) - 1);
     *out = svc;
 
@@ -390,7 +533,29 @@ zx_status_t loader_service_create(const char* name,
 
 zx_status_t loader_service_create_fs(const char* name,
                                      loader_service_t** out) {
-    return loader_service_create(name, &fs_ops, NULL, out);
+    return loader_service_create_fs_libpaths(name, default_libpaths, out);
+}
+
+zx_status_t loader_service_create_fs_libpaths(const char* name,
+                                              const char* const* libpaths,
+                                              loader_service_t** out) {
+    if (libpaths == NULL) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    return loader_service_create(name, &fs_ops, (void*)libpaths, out);
+}
+
+void loader_service_release(loader_service_t* svc) {
+    if (svc == NULL) {
+        return;
+    }
+    if (svc->dispatcher != NULL) {
+        fdio_dispatcher_destroy(svc->dispatcher);
+    }
+    if (svc->dispatcher_log != ZX_HANDLE_INVALID) {
+        zx_handle_close(svc->dispatcher_log);
+    }
+    free(svc);
 }
 
 static zx_status_t multiloader_cb(zx_handle_t h, void* cb, void* cookie) {
@@ -416,7 +581,12 @@ zx_status_t loader_service_attach(loader_service_t* svc, zx_handle_t h) {
                                         multiloader_cb)) < 0) {
             goto done;
         }
-        if ((r = fdio_dispatcher_start(svc->dispatcher, svc->name)) < 0) {
+        uint32_t num_threads = zx_system_get_num_cpus();
+        if (num_threads > LOADER_SERVICE_MAX_THREADS) {
+            num_threads = LOADER_SERVICE_MAX_THREADS;
+        }
+        if ((r = fdio_dispatcher_start_threads(svc->dispatcher, svc->name,
+                                               num_threads)) < 0) {
             //TODO: destroy dispatcher once support exists
             svc->dispatcher = NULL;
             goto done;
@@ -457,7 +627,9 @@ zx_status_t loader_service_connect(loader_service_t* svc, zx_handle_t* out) {
 // In-process multiloader
 static loader_service_t local_loader_svc = {
     .name = "local-loader-svc",
+    .dispatcher_lock = MTX_INIT,
     .ops = &fs_ops,
+    .config_lock = MTX_INIT,
 };
 
 zx_status_t loader_service_get_default(zx_handle_t* out) {
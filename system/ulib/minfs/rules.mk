@@ -46,6 +46,7 @@ MODULE_HOST_SRCS := \
     $(COMMON_SRCS) \
     $(LOCAL_DIR)/host.cpp \
     system/ulib/bitmap/raw-bitmap.cpp \
+    system/ulib/fs/dentry-cache.cpp \
     system/ulib/fs/vfs.cpp \
     system/ulib/fs/vnode.cpp \
 
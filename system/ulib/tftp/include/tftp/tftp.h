@@ -238,6 +238,15 @@ void tftp_session_set_max_timeouts(tftp_session* session,
 void tftp_session_set_opcode_prefix_use(tftp_session* session,
                                         bool enable);
 
+// Specify whether the window may adapt to the loss seen on the link. When
+// both ends enable this, the sender starts with a small window and grows it
+// up to the negotiated window size while whole windows are acknowledged,
+// halving it when blocks are lost. Windows shorter than the negotiated size
+// are closed by resending their last block, which the receiver ACKs. This
+// option is not RFC-compatible; peers which do not know it ignore it.
+void tftp_session_set_adaptive_window(tftp_session* session,
+                                      bool enable);
+
 // When acting as a server, the options that will be overridden when a
 // value is requested by the client. Note that if the client does not
 // specify a setting, the default will be used regardless of server
@@ -40,6 +40,7 @@ typedef struct tftp_data_msg_t {
 #define BLOCKSIZE_OPTION 0x01  // RFC 2348
 #define TIMEOUT_OPTION 0x02    // RFC 2349
 #define WINDOWSIZE_OPTION 0x04 // RFC 7440
+#define ADAPTIVE_WINDOW_OPTION 0x08 // Not RFC-compatible, see tftp_session_set_adaptive_window
 
 #define DEFAULT_BLOCKSIZE 512
 #define DEFAULT_TIMEOUT 1
@@ -49,6 +50,9 @@ typedef struct tftp_data_msg_t {
 #define DEFAULT_MAX_TIMEOUTS 5
 #define DEFAULT_USE_OPCODE_PREFIX true
 
+// The first window sent when the window is adaptive, before any loss has been observed.
+#define ADAPTIVE_INITIAL_WINDOW 16
+
 typedef struct tftp_options_t {
     // A bitmask of the options that have been set
     uint8_t mask;
@@ -172,11 +176,25 @@ struct tftp_session_t {
     // no-no in IPv6). This modification is not RFC-compatible.
     bool use_opcode_prefix;
 
+    // Offer (as a client) or accept (as a server) an adaptive window. See
+    // tftp_session_set_adaptive_window().
+    bool adaptive_window_enabled;
+
     // "Negotiated" values
     size_t file_size;
     uint16_t window_size;
     uint16_t block_size;
     uint8_t timeout;
+    bool adaptive_window;
+
+    // When sending with an adaptive window, the number of blocks sent before waiting for
+    // an ACK. It grows while windows are acknowledged in full, and shrinks when blocks are
+    // lost, but is never larger than window_size.
+    uint16_t send_window;
+    uint16_t send_window_threshold;
+    // Set once a window shorter than window_size has been closed by resending its last
+    // block, which the receiver answers with an ACK.
+    bool window_end_sent;
 
     // Callbacks
     tftp_file_interface file_interface;
@@ -11,6 +11,8 @@
 #include <string.h>
 #include <unistd.h>
 
+#include "internal.h"
+
 // This test simulates a tftp file transfer by running two threads. Both the
 // file and transport interfaces are implemented in memory buffers.
 
@@ -21,6 +23,9 @@ struct test_params {
     uint32_t filesz;
     uint16_t winsz;
     uint16_t blksz;
+    bool adaptive;
+    // If set, every |drop_freq|th DATA message sent by either side is dropped.
+    uint32_t drop_freq;
 };
 
 static uint8_t *src_file;
@@ -147,6 +152,9 @@ static fake_socket_t server_out_socket = { .size = FAKE_SOCK_BUF_SZ };
 typedef struct {
     fake_socket_t* in_sock;
     fake_socket_t* out_sock;
+    uint32_t drop_freq;
+    uint32_t data_count;
+    uint32_t timeout_ms;
 } transport_info_t;
 
 void clear_sockets(void) {
@@ -157,7 +165,10 @@ void clear_sockets(void) {
 }
 
 // Initialize "sockets" for either client or server.
-void transport_init(transport_info_t* transport_info, bool is_server) {
+void transport_init(transport_info_t* transport_info, bool is_server, uint32_t drop_freq) {
+    transport_info->drop_freq = drop_freq;
+    transport_info->data_count = 0;
+    transport_info->timeout_ms = 0;
     if (is_server) {
         transport_info->in_sock = &client_out_socket;
         transport_info->out_sock = &server_out_socket;
@@ -188,6 +199,12 @@ void write_to_buf(fake_socket_t* sock, void* data, size_t size) {
 tftp_status transport_send(void* data, size_t len, void* transport_cookie) {
     transport_info_t* transport_info = transport_cookie;
     fake_socket_t* sock = transport_info->out_sock;
+    // The low byte of the opcode is the opcode proper, the high byte may hold the
+    // retransmission prefix.
+    if (transport_info->drop_freq && len > 1 && ((uint8_t*)data)[1] == OPCODE_DATA &&
+        ++transport_info->data_count % transport_info->drop_freq == 0) {
+        return TFTP_NO_ERROR;
+    }
     while ((sock->write_ndx + sizeof(len) + len - sock->read_ndx)
            > sock->size) {
         // Wait for the other thread to catch up
@@ -218,14 +235,26 @@ void read_from_buf(fake_socket_t* sock, void* data, size_t size,
     }
 }
 
+// Each millisecond of a timeout only lasts this many microseconds, so that
+// transfers which have to recover from dropped messages finish quickly.
+#define FAKE_USEC_PER_MS 50
+
 // Receive a message. Note that the buffer's read_ndx and write_ndx don't
-// wrap, which makes it easier to recognize underflow.
+// wrap, which makes it easier to recognize underflow. Blocking reads only time
+// out when messages are being dropped, and like netsvc a timeout of zero means
+// there is none.
 int transport_recv(void* data, size_t len, bool block, void* transport_cookie) {
     transport_info_t* transport_info = transport_cookie;
     if (block) {
+        uint32_t waited_usec = 0;
         while ((transport_info->in_sock->read_ndx + sizeof(size_t)) >=
                transport_info->in_sock->write_ndx) {
+            if (transport_info->drop_freq && transport_info->timeout_ms &&
+                waited_usec >= transport_info->timeout_ms * FAKE_USEC_PER_MS) {
+                return TFTP_ERR_TIMED_OUT;
+            }
             usleep(10);
+            waited_usec += 10;
         }
     } else if ((transport_info->in_sock->read_ndx + sizeof(size_t)) >=
                transport_info->in_sock->write_ndx) {
@@ -243,6 +272,8 @@ int transport_recv(void* data, size_t len, bool block, void* transport_cookie) {
 }
 
 int transport_timeout_set(uint32_t timeout_ms, void* transport_cookie) {
+    transport_info_t* transport_info = transport_cookie;
+    transport_info->timeout_ms = timeout_ms;
     return 0;
 }
 
@@ -273,7 +304,7 @@ bool run_client_test(struct test_params* tp) {
 
     // Configure transport interface
     transport_info_t transport_info;
-    transport_init(&transport_info, false);
+    transport_init(&transport_info, false, tp->drop_freq);
 
     tftp_transport_interface transport_callbacks = { transport_send,
                                                      transport_recv,
@@ -294,6 +325,7 @@ bool run_client_test(struct test_params* tp) {
 
     // Set our preferred transport options
     tftp_set_options(session, &tp->blksz, NULL, &tp->winsz);
+    tftp_session_set_adaptive_window(session, tp->adaptive);
 
     tftp_request_opts opts = { .inbuf = msg_in_buf,
                                .inbuf_sz = buf_sz,
@@ -349,13 +381,14 @@ bool run_server_test(struct test_params* tp) {
 
     // Configure transport interface
     transport_info_t transport_info;
-    transport_init(&transport_info, true);
+    transport_init(&transport_info, true, tp->drop_freq);
     tftp_transport_interface transport_callbacks = { transport_send,
                                                      transport_recv,
                                                      transport_timeout_set };
     status = tftp_session_set_transport_interface(session,
                                                   &transport_callbacks);
     ASSERT_EQ(status, TFTP_NO_ERROR, "could not set transport interface");
+    tftp_session_set_adaptive_window(session, tp->adaptive);
 
     // Allocate intermediate buffers
     size_t buf_sz = tp->blksz > PATH_MAX ?
@@ -444,6 +477,42 @@ bool test_tftp_receive_file_lg_window(void) {
     return run_one_test(&tp);
 }
 
+bool test_tftp_send_file_lossy(void) {
+    struct test_params tp = {.direction = DIR_SEND, .filesz = 1000000, .winsz = 64,
+                             .blksz = 1000, .drop_freq = 97};
+    return run_one_test(&tp);
+}
+
+bool test_tftp_receive_file_lossy(void) {
+    struct test_params tp = {.direction = DIR_RECEIVE, .filesz = 1000000, .winsz = 64,
+                             .blksz = 1000, .drop_freq = 97};
+    return run_one_test(&tp);
+}
+
+bool test_tftp_send_file_adaptive_window(void) {
+    struct test_params tp = {.direction = DIR_SEND, .filesz = 1000000, .winsz = 1024,
+                             .blksz = 1024, .adaptive = true};
+    return run_one_test(&tp);
+}
+
+bool test_tftp_receive_file_adaptive_window(void) {
+    struct test_params tp = {.direction = DIR_RECEIVE, .filesz = 1000000, .winsz = 1024,
+                             .blksz = 1024, .adaptive = true};
+    return run_one_test(&tp);
+}
+
+bool test_tftp_send_file_adaptive_window_lossy(void) {
+    struct test_params tp = {.direction = DIR_SEND, .filesz = 1000000, .winsz = 1024,
+                             .blksz = 1024, .adaptive = true, .drop_freq = 97};
+    return run_one_test(&tp);
+}
+
+bool test_tftp_receive_file_adaptive_window_lossy(void) {
+    struct test_params tp = {.direction = DIR_RECEIVE, .filesz = 1000000, .winsz = 1024,
+                             .blksz = 1024, .adaptive = true, .drop_freq = 97};
+    return run_one_test(&tp);
+}
+
 BEGIN_TEST_CASE(tftp_transfer_file)
 RUN_TEST(test_tftp_send_file)
 RUN_TEST(test_tftp_send_file_wrapping_block_count)
@@ -451,5 +520,11 @@ RUN_TEST(test_tftp_send_file_lg_window)
 RUN_TEST(test_tftp_receive_file)
 RUN_TEST(test_tftp_receive_file_wrapping_block_count)
 RUN_TEST(test_tftp_receive_file_lg_window)
+RUN_TEST(test_tftp_send_file_lossy)
+RUN_TEST(test_tftp_receive_file_lossy)
+RUN_TEST(test_tftp_send_file_adaptive_window)
+RUN_TEST(test_tftp_receive_file_adaptive_window)
+RUN_TEST(test_tftp_send_file_adaptive_window_lossy)
+RUN_TEST(test_tftp_receive_file_adaptive_window_lossy)
 END_TEST_CASE(tftp_transfer_file)
 
@@ -59,6 +59,12 @@ static const char* kWindowSize = "WINDOWSIZE";
 static const size_t kWindowSizeLen = 10; // strlen(kWindowSize);
 static const size_t kMaxWindowSizeOpt = 18; // kWindowSizeLen + strlen("!") + 1 + strlen(65535) + 1;
 
+// ADAPTIVEWINDOW
+// Not RFC-compatible, value is always 1
+static const char* kAdaptiveWindow = "ADAPTIVEWINDOW";
+static const size_t kAdaptiveWindowLen = 14; // strlen(kAdaptiveWindow)
+static const size_t kMaxAdaptiveWindowOpt = 17; // kAdaptiveWindowLen + 1 + strlen(1) + 1
+
 // Since RRQ and WRQ come before option negotation, they are limited to max TFTP
 // blocksize of 512 (RFC 1350 and 2347).
 static const size_t kMaxRequestSize = 512;
@@ -179,17 +185,65 @@ static void set_error(tftp_session* session, uint16_t err_code, void* resp_buf,
     session->state = ERROR;
 }
 
+// The number of blocks to send before waiting for an ACK.
+static uint16_t send_window(tftp_session* session) {
+    return session->adaptive_window ? session->send_window : session->window_size;
+}
+
+static void reset_send_window(tftp_session* session) {
+    session->send_window = MIN(session->window_size, ADAPTIVE_INITIAL_WINDOW);
+    session->send_window_threshold = session->window_size;
+    session->window_end_sent = false;
+}
+
+// Called when an ACK tells us how much of the last window arrived. Like TCP
+// congestion control, the window doubles until it reaches the threshold, then
+// grows more slowly; on loss both the window and the threshold are halved.
+static void adapt_send_window(tftp_session* session, bool lost) {
+    uint16_t window = session->send_window;
+    if (lost) {
+        window = window > 1 ? window / 2 : 1;
+        session->send_window_threshold = window;
+    } else if (window < session->send_window_threshold) {
+        window = (window > session->send_window_threshold / 2) ?
+                 session->send_window_threshold : window * 2;
+    } else {
+        uint16_t step = window / 8 ? window / 8 : 1;
+        window = (window > session->window_size - step) ? session->window_size : window + step;
+    }
+    xprintf(" -> Send window %d -> %d (threshold %d)\n", session->send_window, window,
+            session->send_window_threshold);
+    session->send_window = window;
+}
+
+// When an adaptive window is shorter than the negotiated one, the receiver will
+// not ACK on its own once the window has been sent. We close the window by
+// sending its last block again, which the receiver ACKs right away.
+static bool window_end_pending(tftp_session* session) {
+    return session->adaptive_window &&
+           session->window_index > 0 &&
+           session->window_index >= session->send_window &&
+           session->window_index < session->window_size &&
+           !session->window_end_sent;
+}
+
 tftp_status tx_data(tftp_session* session, tftp_data_msg* resp, size_t* outlen, void* cookie) {
-    session->offset = (session->block_number + session->window_index) * session->block_size;
+    bool window_end = window_end_pending(session);
+    uint64_t block = session->block_number + session->window_index + (window_end ? 0 : 1);
+    session->offset = (block - 1) * session->block_size;
     *outlen = 0;
     if (session->offset <= session->file_size) {
-        session->window_index++;
+        if (window_end) {
+            session->window_end_sent = true;
+        } else {
+            session->window_index++;
+        }
         OPCODE(session, resp, OPCODE_DATA);
-        resp->block = htons(session->block_number + session->window_index);
+        resp->block = htons(block);
         size_t len = MIN(session->file_size - session->offset, session->block_size);
-        xprintf(" -> Copying block #%" PRIu64 " (size:%zu/%d) from %zu/%zu [%d/%d]\n",
-                session->block_number + session->window_index, len, session->block_size,
-                session->offset, session->file_size, session->window_index, session->window_size);
+        xprintf(" -> Copying block #%" PRIu64 " (size:%zu/%d) from %zu/%zu [%d/%d]%s\n",
+                block, len, session->block_size, session->offset, session->file_size,
+                session->window_index, send_window(session), window_end ? " (window end)" : "");
         void* buf = resp->data;
         size_t len_remaining = len;
         size_t off = session->offset;
@@ -207,11 +261,11 @@ tftp_status tx_data(tftp_session* session, tftp_data_msg* resp, size_t* outlen,
         }
         *outlen = sizeof(*resp) + len;
 
-        if (session->window_index < session->window_size) {
-            xprintf(" -> TRANSMIT_MORE(%d < %d)\n", session->window_index, session->window_size);
+        if (session->window_index < send_window(session)) {
+            xprintf(" -> TRANSMIT_MORE(%d < %d)\n", session->window_index, send_window(session));
         } else {
             xprintf(" -> TRANSMIT_WAIT_ON_ACK(%d >= %d)\n", session->window_index,
-                    session->window_size);
+                    send_window(session));
         }
     } else {
         xprintf(" -> TRANSMIT_WAIT_ON_ACK(completed)\n");
@@ -265,7 +319,7 @@ tftp_status tftp_session_set_transport_interface(tftp_session* session,
 bool tftp_session_has_pending(tftp_session* session) {
     return session->direction == SEND_FILE &&
            session->window_index > 0 &&
-           session->window_index < session->window_size &&
+           (session->window_index < send_window(session) || window_end_pending(session)) &&
            ((session->block_number + session->window_index) * session->block_size) <=
             session->file_size;
 }
@@ -310,6 +364,7 @@ tftp_status tftp_generate_request(tftp_session* session,
     session->block_size = DEFAULT_BLOCKSIZE;
     session->timeout = DEFAULT_TIMEOUT;
     session->window_size = DEFAULT_WINDOWSIZE;
+    session->adaptive_window = false;
 
     tftp_msg* ack = outgoing;
     OPCODE(session, ack, (direction == SEND_FILE) ? OPCODE_WRQ : OPCODE_RRQ);
@@ -396,6 +451,14 @@ tftp_status tftp_generate_request(tftp_session* session,
         sent_opts->mask |= WINDOWSIZE_OPTION;
     }
 
+    if (session->adaptive_window_enabled) {
+        if (left < kMaxAdaptiveWindowOpt) {
+            return TFTP_ERR_BUFFER_TOO_SMALL;
+        }
+        append_option(&body, &left, kAdaptiveWindow, false, "1");
+        sent_opts->mask |= ADAPTIVE_WINDOW_OPTION;
+    }
+
     *outlen = *outlen - left;
     // Nothing has been negotiated yet so use default
     *timeout_ms = 1000 * session->timeout;
@@ -461,6 +524,7 @@ tftp_status tftp_handle_request(tftp_session* session,
     session->block_size = DEFAULT_BLOCKSIZE;
     session->timeout = DEFAULT_TIMEOUT;
     session->window_size = DEFAULT_WINDOWSIZE;
+    session->adaptive_window = false;
 
     // TODO(tkilbourn): refactor option handling code to share with
     // tftp_handle_oack
@@ -538,6 +602,9 @@ tftp_status tftp_handle_request(tftp_session* session,
             } else {
                 session->window_size = override_opts->window_size;
             }
+        } else if (!strncasecmp(option, kAdaptiveWindow, kAdaptiveWindowLen)) {
+            requested_options.mask |= ADAPTIVE_WINDOW_OPTION;
+            session->adaptive_window = session->adaptive_window_enabled;
         } else {
             // Options which the server does not support should be omitted from the
             // OACK; they should not cause an ERROR packet to be generated.
@@ -631,9 +698,13 @@ tftp_status tftp_handle_request(tftp_session* session,
     if (requested_options.mask & WINDOWSIZE_OPTION) {
         append_option(&body, &left, kWindowSize, false, "%d", session->window_size);
     }
+    if (session->adaptive_window) {
+        append_option(&body, &left, kAdaptiveWindow, false, "1");
+    }
     *resp_len = *resp_len - left;
     session->state = REQ_RECEIVED;
     session->direction = direction;
+    reset_send_window(session);
 
     xprintf("%s Request Parsed\n", (direction == SEND_FILE) ? "Read" : "Write");
     xprintf("    Mode       : %s\n", session->mode == MODE_NETASCII ? "netascii" :
@@ -648,7 +719,8 @@ tftp_status tftp_handle_request(tftp_session* session,
     xprintf("Using options\n");
     xprintf("    Block Size : %d\n", session->block_size);
     xprintf("    Timeout    : %d\n", session->timeout);
-    xprintf("    Window Size: %d\n", session->window_size);
+    xprintf("    Window Size: %d%s\n", session->window_size,
+            session->adaptive_window ? " (adaptive)" : "");
 
     return TFTP_NO_ERROR;
 }
@@ -745,6 +817,12 @@ tftp_status tftp_handle_data(tftp_session* session,
         if (session->use_opcode_prefix) {
             session->opcode_prefix++;
         }
+    } else if (block_delta == 0 && session->adaptive_window) {
+        // The sender repeats the last block of a window that is shorter than the
+        // negotiated one (or resends it after losing our ACK); either way it is
+        // waiting to hear from us.
+        xprintf("End of window at %" PRIu64 "\n", session->block_number);
+        session->window_index = session->window_size;
     }
 
     if (session->window_index == session->window_size ||
@@ -798,9 +876,17 @@ tftp_status tftp_handle_ack(tftp_session* session,
             session->opcode_prefix++;
         }
     }
+    if (session->adaptive_window && session->state == SENDING_DATA) {
+        if (block_offset < (int32_t)session->window_index) {
+            adapt_send_window(session, true);
+        } else if (session->window_index >= session->send_window) {
+            adapt_send_window(session, false);
+        }
+    }
     session->state = SENDING_DATA;
     session->block_number += block_offset;
     session->window_index = 0;
+    session->window_end_sent = false;
 
     if (session->block_number * session->block_size > session->file_size) {
         *resp_len = 0;
@@ -909,6 +995,14 @@ tftp_status tftp_handle_oack(tftp_session* session,
                 return TFTP_ERR_INTERNAL;
             }
             session->window_size = val;
+        } else if (!strncasecmp(option, kAdaptiveWindow, kAdaptiveWindowLen)) {
+            if (!(session->client_sent_opts.mask & ADAPTIVE_WINDOW_OPTION)) {
+                xprintf("adaptive window not requested\n");
+                set_error(session, TFTP_ERR_CODE_BAD_OPTIONS, resp, resp_len,
+                          "no adaptive window");
+                return TFTP_ERR_INTERNAL;
+            }
+            session->adaptive_window = true;
         } else {
             // Options which the server does not support should be omitted from the
             // OACK; they should not cause an ERROR packet to be generated.
@@ -923,11 +1017,13 @@ tftp_status tftp_handle_oack(tftp_session* session,
     xprintf("    File Size  : %zu\n", session->file_size);
     xprintf("    Block Size : %d\n", session->block_size);
     xprintf("    Timeout    : %d\n", session->timeout);
-    xprintf("    Window Size: %d\n", session->window_size);
+    xprintf("    Window Size: %d%s\n", session->window_size,
+            session->adaptive_window ? " (adaptive)" : "");
 
     session->offset = 0;
     session->block_number = 0;
     session->window_index = 0;
+    reset_send_window(session);
 
     if (session->direction == SEND_FILE) {
         tftp_data_msg* resp_data = (void*)resp;
@@ -1018,6 +1114,11 @@ void tftp_session_set_opcode_prefix_use(tftp_session* session,
     session->use_opcode_prefix = enable;
 }
 
+void tftp_session_set_adaptive_window(tftp_session* session,
+                                      bool enable) {
+    session->adaptive_window_enabled = enable;
+}
+
 tftp_status tftp_timeout(tftp_session* session,
                          void* msg_buf,
                          size_t* msg_len,
@@ -1040,7 +1141,11 @@ tftp_status tftp_timeout(tftp_session* session,
     *msg_len = buf_sz;
     if (session->direction == SEND_FILE) {
         // Reset back to the last-acknowledged block
+        if (session->adaptive_window && session->state == SENDING_DATA) {
+            adapt_send_window(session, true);
+        }
         session->window_index = 0;
+        session->window_end_sent = false;
         return tftp_prepare_data(session, msg_buf, msg_len, timeout_ms, file_cookie);
     } else {
         // ACK up to the last block read
@@ -95,7 +95,7 @@ struct StringEntry : public fbl::SinglyLinkedListable<StringEntry*> {
 // duplicate registration of strings across threads.
 struct ContextCache {
     ContextCache() = default;
-    ~ContextCache() { string_table.clear(); }
+    ~ContextCache();
 
     // The generation number of the context which last modified this state.
     uint32_t generation{0u};
@@ -113,6 +113,12 @@ struct ContextCache {
 
     // Storage for the string entries.
     StringEntry string_entries[kMaxStringEntries];
+
+    // The chunk this thread is writing records into in the circular and
+    // streaming modes, or null if none.
+    uint8_t* chunk_ptr{nullptr};
+    uint8_t* chunk_end{nullptr};
+    uint32_t chunk_index{0u};
 };
 thread_local fbl::unique_ptr<ContextCache> tls_cache{};
 
@@ -130,9 +136,25 @@ ContextCache* GetCurrentContextCache(uint32_t generation) {
     cache->generation = generation;
     cache->thread_ref = trace_make_unknown_thread_ref();
     cache->string_table.clear();
+    cache->chunk_ptr = nullptr;
+    cache->chunk_end = nullptr;
     return cache;
 }
 
+ContextCache::~ContextCache() {
+    // Give up our chunk so that it can be recycled or drained even though
+    // this thread is going away.
+    if (chunk_ptr) {
+        trace_context_t* context = trace_acquire_context();
+        if (context) {
+            if (context->generation() == generation)
+                context->RetireChunk(chunk_index);
+            trace_release_context(context);
+        }
+    }
+    string_table.clear();
+}
+
 StringEntry* CacheStringEntry(uint32_t generation,
                               const char* string_literal) {
     ContextCache* cache = GetCurrentContextCache(generation);
@@ -223,8 +245,9 @@ size_t SizeOfEncodedArgs(const trace_arg_t* args, size_t num_args) {
 // Provides support for writing sequences of 64-bit words into a trace buffer.
 class Payload {
 public:
-    explicit Payload(trace_context_t* context, size_t num_bytes)
-        : ptr_(context->AllocRecord(num_bytes)) {}
+    explicit Payload(trace_context_t* context, size_t num_bytes, bool durable = false)
+        : ptr_(durable ? context->AllocDurableRecord(num_bytes)
+                       : context->AllocRecord(num_bytes)) {}
 
     explicit operator bool() const {
         return ptr_ != nullptr;
@@ -377,6 +400,64 @@ Payload WriteEventRecordBase(
     return payload;
 }
 
+// Returns false if the record could not be written, in which case the index
+// must not be used.
+bool WriteStringRecord(trace_context_t* context, trace_string_index_t index,
+                       const char* string, size_t length) {
+    ZX_DEBUG_ASSERT(index != TRACE_ENCODED_STRING_REF_EMPTY);
+    ZX_DEBUG_ASSERT(index <= TRACE_ENCODED_STRING_REF_MAX_INDEX);
+
+    if (length > TRACE_ENCODED_STRING_REF_MAX_LENGTH)
+        length = TRACE_ENCODED_STRING_REF_MAX_LENGTH;
+
+    const size_t record_size = sizeof(RecordHeader) +
+                               Pad(length);
+    Payload payload(context, record_size, true);
+    if (!payload)
+        return false;
+    payload
+        .WriteUint64(MakeRecordHeader(RecordType::kString, record_size) |
+                     StringRecordFields::StringIndex::Make(index) |
+                     StringRecordFields::StringLength::Make(length))
+        .WriteBytes(string, length);
+    return true;
+}
+
+// Returns false if the record could not be written, in which case the index
+// must not be used.
+bool WriteThreadRecord(trace_context_t* context, trace_thread_index_t index,
+                       zx_koid_t process_koid, zx_koid_t thread_koid) {
+    ZX_DEBUG_ASSERT(index != TRACE_ENCODED_THREAD_REF_INLINE);
+    ZX_DEBUG_ASSERT(index <= TRACE_ENCODED_THREAD_REF_MAX_INDEX);
+
+    const size_t record_size = sizeof(RecordHeader) +
+                               WordsToBytes(2);
+    Payload payload(context, record_size, true);
+    if (!payload)
+        return false;
+    payload
+        .WriteUint64(MakeRecordHeader(RecordType::kThread, record_size) |
+                     ThreadRecordFields::ThreadIndex::Make(index))
+        .WriteUint64(process_koid)
+        .WriteUint64(thread_koid);
+    return true;
+}
+
+// Fills |num_bytes| at |ptr| with padding records.
+void WritePadding(uint8_t* ptr, size_t num_bytes) {
+    ZX_DEBUG_ASSERT((num_bytes & 7) == 0);
+    while (num_bytes) {
+        size_t record_size = fbl::min(num_bytes,
+                                      static_cast<size_t>(RecordFields::kMaxRecordSizeBytes));
+        *reinterpret_cast<uint64_t*>(ptr) =
+            MakeRecordHeader(RecordType::kMetadata, record_size) |
+            MetadataRecordFields::MetadataType::Make(
+                ToUnderlyingType(MetadataType::kPadding));
+        ptr += record_size;
+        num_bytes -= record_size;
+    }
+}
+
 bool CheckCategory(trace_context_t* context, const char* category) {
     return context->handler()->ops->is_category_enabled(context->handler(), category);
 }
@@ -412,11 +493,11 @@ bool RegisterString(trace_context_t* context,
 
         if (out_ref_optional) {
             if (unlikely(!(entry->flags & StringEntry::kAllocIndexAttempted))) {
-                if (context->AllocStringIndex(&entry->index)) {
+                if (context->AllocStringIndex(&entry->index) &&
+                    WriteStringRecord(context, entry->index,
+                                      string_literal, strlen(string_literal))) {
                     entry->flags |= StringEntry::kAllocIndexAttempted |
                                     StringEntry::kAllocIndexSucceeded;
-                    trace_context_write_string_record(context, entry->index,
-                                                      string_literal, strlen(string_literal));
                 } else {
                     entry->flags |= StringEntry::kAllocIndexAttempted;
                 }
@@ -459,8 +540,8 @@ void trace_context_register_string_copy(
     // TODO(ZX-1035): Cache the registered strings on the trace context structure,
     // guarded by a mutex.
     trace_string_index_t index;
-    if (likely(context->AllocStringIndex(&index))) {
-        trace_context_write_string_record(context, index, string, length);
+    if (likely(context->AllocStringIndex(&index) &&
+               trace::WriteStringRecord(context, index, string, length))) {
         *out_ref = trace_make_indexed_string_ref(index);
     } else {
         *out_ref = trace_make_inline_string_ref(string, length);
@@ -502,9 +583,9 @@ void trace_context_register_current_thread(
 
     if (likely(cache)) {
         trace_thread_index_t index;
-        if (likely(context->AllocThreadIndex(&index))) {
+        if (likely(context->AllocThreadIndex(&index) &&
+                   trace::WriteThreadRecord(context, index, process_koid, thread_koid))) {
             cache->thread_ref = trace_make_indexed_thread_ref(index);
-            trace_context_write_thread_record(context, index, process_koid, thread_koid);
         } else {
             cache->thread_ref = trace_make_inline_thread_ref(
                 process_koid, thread_koid);
@@ -528,8 +609,8 @@ void trace_context_register_thread(
     // TODO(ZX-1035): Since we can't use the thread-local cache here, cache
     // this registered thread on the trace context structure, guarded by a mutex.
     trace_thread_index_t index;
-    if (likely(context->AllocThreadIndex(&index))) {
-        trace_context_write_thread_record(context, index, process_koid, thread_koid);
+    if (likely(context->AllocThreadIndex(&index) &&
+               trace::WriteThreadRecord(context, index, process_koid, thread_koid))) {
         *out_ref = trace_make_indexed_thread_ref(index);
     } else {
         *out_ref = trace_make_inline_thread_ref(process_koid, thread_koid);
@@ -545,7 +626,7 @@ void trace_context_write_kernel_object_record(
                                trace::WordsToBytes(1) +
                                trace::SizeOfEncodedStringRef(name_ref) +
                                trace::SizeOfEncodedArgs(args, num_args);
-    trace::Payload payload(context, record_size);
+    trace::Payload payload(context, record_size, true);
     if (payload) {
         payload
             .WriteUint64(trace::MakeRecordHeader(trace::RecordType::kKernelObject, record_size) |
@@ -862,7 +943,7 @@ void trace_context_write_initialization_record(
     uint64_t ticks_per_second) {
     const size_t record_size = sizeof(trace::RecordHeader) +
                                trace::WordsToBytes(1);
-    trace::Payload payload(context, record_size);
+    trace::Payload payload(context, record_size, true);
     if (payload) {
         payload
             .WriteUint64(trace::MakeRecordHeader(trace::RecordType::kInitialization, record_size))
@@ -873,22 +954,7 @@ void trace_context_write_initialization_record(
 void trace_context_write_string_record(
     trace_context_t* context,
     trace_string_index_t index, const char* string, size_t length) {
-    ZX_DEBUG_ASSERT(index != TRACE_ENCODED_STRING_REF_EMPTY);
-    ZX_DEBUG_ASSERT(index <= TRACE_ENCODED_STRING_REF_MAX_INDEX);
-
-    if (length > TRACE_ENCODED_STRING_REF_MAX_LENGTH)
-        length = TRACE_ENCODED_STRING_REF_MAX_LENGTH;
-
-    const size_t record_size = sizeof(trace::RecordHeader) +
-                               trace::Pad(length);
-    trace::Payload payload(context, record_size);
-    if (payload) {
-        payload
-            .WriteUint64(trace::MakeRecordHeader(trace::RecordType::kString, record_size) |
-                         trace::StringRecordFields::StringIndex::Make(index) |
-                         trace::StringRecordFields::StringLength::Make(length))
-            .WriteBytes(string, length);
-    }
+    trace::WriteStringRecord(context, index, string, length);
 }
 
 void trace_context_write_thread_record(
@@ -896,19 +962,7 @@ void trace_context_write_thread_record(
     trace_thread_index_t index,
     zx_koid_t process_koid,
     zx_koid_t thread_koid) {
-    ZX_DEBUG_ASSERT(index != TRACE_ENCODED_THREAD_REF_INLINE);
-    ZX_DEBUG_ASSERT(index <= TRACE_ENCODED_THREAD_REF_MAX_INDEX);
-
-    const size_t record_size = sizeof(trace::RecordHeader) +
-                               trace::WordsToBytes(2);
-    trace::Payload payload(context, record_size);
-    if (payload) {
-        payload
-            .WriteUint64(trace::MakeRecordHeader(trace::RecordType::kThread, record_size) |
-                         trace::ThreadRecordFields::ThreadIndex::Make(index))
-            .WriteUint64(process_koid)
-            .WriteUint64(thread_koid);
-    }
+    trace::WriteThreadRecord(context, index, process_koid, thread_koid);
 }
 
 void* trace_context_alloc_record(trace_context_t* context, size_t num_bytes) {
@@ -917,15 +971,53 @@ void* trace_context_alloc_record(trace_context_t* context, size_t num_bytes) {
 
 /* struct trace_context */
 
+size_t trace_context::NumChunks(trace_buffering_mode_t buffering_mode,
+                                size_t buffer_num_bytes) {
+    switch (buffering_mode) {
+    case TRACE_BUFFERING_MODE_CIRCULAR:
+        // Set aside an eighth of the buffer for durable records.
+        return (buffer_num_bytes - buffer_num_bytes / 8u) / TRACE_ENGINE_CHUNK_SIZE;
+    case TRACE_BUFFERING_MODE_STREAMING:
+        return buffer_num_bytes / TRACE_ENGINE_CHUNK_SIZE;
+    default:
+        return 0u;
+    }
+}
+
+bool trace_context::IsValidBuffer(trace_buffering_mode_t buffering_mode,
+                                  size_t buffer_num_bytes) {
+    switch (buffering_mode) {
+    case TRACE_BUFFERING_MODE_ONESHOT:
+        return true;
+    case TRACE_BUFFERING_MODE_CIRCULAR:
+    case TRACE_BUFFERING_MODE_STREAMING: {
+        // Need somewhere to go when one chunk fills up.
+        size_t num_chunks = NumChunks(buffering_mode, buffer_num_bytes);
+        return num_chunks >= 2u && num_chunks <= UINT32_MAX;
+    }
+    default:
+        return false;
+    }
+}
+
 trace_context::trace_context(void* buffer, size_t buffer_num_bytes,
+                             trace_buffering_mode_t buffering_mode,
                              trace_handler_t* handler)
     : generation_(trace::g_next_generation.fetch_add(1u, fbl::memory_order_relaxed) + 1u),
+      buffering_mode_(buffering_mode),
       buffer_start_(static_cast<uint8_t*>(buffer)),
-      buffer_end_(buffer_start_ + buffer_num_bytes),
+      buffer_end_(buffering_mode == TRACE_BUFFERING_MODE_ONESHOT
+                      ? buffer_start_ + buffer_num_bytes
+                      : buffer_start_ + (buffer_num_bytes & ~size_t(7u))),
       buffer_current_(reinterpret_cast<uintptr_t>(buffer_start_)),
       buffer_full_mark_(0u),
+      chunks_start_(buffer_end_ -
+                    NumChunks(buffering_mode, buffer_num_bytes) * TRACE_ENGINE_CHUNK_SIZE),
+      num_chunks_(static_cast<uint32_t>(NumChunks(buffering_mode, buffer_num_bytes))),
+      chunks_(num_chunks_ ? new Chunk[num_chunks_] : nullptr),
       handler_(handler) {
     ZX_DEBUG_ASSERT(generation_ != 0u);
+    ZX_DEBUG_ASSERT(IsValidBuffer(buffering_mode, buffer_num_bytes));
 }
 
 trace_context::~trace_context() = default;
@@ -935,6 +1027,9 @@ uint64_t* trace_context::AllocRecord(size_t num_bytes) {
     if (unlikely(num_bytes > TRACE_ENCODED_RECORD_MAX_LENGTH))
         return nullptr;
 
+    if (buffering_mode_ != TRACE_BUFFERING_MODE_ONESHOT)
+        return AllocChunkRecord(num_bytes);
+
     uint8_t* ptr = reinterpret_cast<uint8_t*>(
         buffer_current_.fetch_add(num_bytes,
                                   fbl::memory_order_relaxed));
@@ -962,6 +1057,164 @@ uint64_t* trace_context::AllocRecord(size_t num_bytes) {
     return nullptr;
 }
 
+uint64_t* trace_context::AllocDurableRecord(size_t num_bytes) {
+    // In the oneshot mode everything is durable, and in the streaming mode
+    // every chunk is kept by the consumer so the thread's own chunk will do.
+    if (buffering_mode_ != TRACE_BUFFERING_MODE_CIRCULAR)
+        return AllocRecord(num_bytes);
+
+    ZX_DEBUG_ASSERT((num_bytes & 7) == 0);
+    if (unlikely(num_bytes > TRACE_ENCODED_RECORD_MAX_LENGTH))
+        return nullptr;
+
+    uint8_t* ptr = reinterpret_cast<uint8_t*>(
+        buffer_current_.fetch_add(num_bytes,
+                                  fbl::memory_order_relaxed));
+    if (likely(ptr + num_bytes <= chunks_start_))
+        return reinterpret_cast<uint64_t*>(ptr);
+
+    // The durable region is full.  Callers fall back to inline references
+    // so no events are lost, they just take more space.
+    buffer_current_.store(reinterpret_cast<uintptr_t>(chunks_start_),
+                          fbl::memory_order_relaxed);
+    return nullptr;
+}
+
+uint64_t* trace_context::AllocChunkRecord(size_t num_bytes) {
+    trace::ContextCache* cache = trace::GetCurrentContextCache(generation_);
+    if (unlikely(!cache)) {
+        // This thread has already seen a newer context, so it has nowhere
+        // to keep a chunk for this one.
+        MarkRecordsDropped();
+        return nullptr;
+    }
+
+    // Fast path: the record fits in this thread's chunk.
+    if (unlikely(static_cast<size_t>(cache->chunk_end - cache->chunk_ptr) < num_bytes)) {
+        if (cache->chunk_ptr) {
+            RetireChunk(cache->chunk_index);
+            cache->chunk_ptr = nullptr;
+            cache->chunk_end = nullptr;
+        }
+        uint32_t index;
+        if (unlikely(!ClaimChunk(&index))) {
+            MarkRecordsDropped();
+            return nullptr;
+        }
+        cache->chunk_index = index;
+        cache->chunk_ptr = chunk_start(index);
+        cache->chunk_end = cache->chunk_ptr + TRACE_ENGINE_CHUNK_SIZE;
+    }
+
+    uint8_t* ptr = cache->chunk_ptr;
+    cache->chunk_ptr += num_bytes;
+    // Only this thread writes the fill level while it owns the chunk; the
+    // context reference fences publish it to whoever retires the chunk.
+    chunks_[cache->chunk_index].fill.store(
+        static_cast<uint32_t>(cache->chunk_ptr - chunk_start(cache->chunk_index)),
+        fbl::memory_order_relaxed);
+    return reinterpret_cast<uint64_t*>(ptr);
+}
+
+bool trace_context::ClaimChunk(uint32_t* out_index) {
+    uint32_t start = next_chunk_.fetch_add(1u, fbl::memory_order_relaxed);
+    for (uint32_t i = 0; i < num_chunks_; i++) {
+        uint32_t index = (start + i) % num_chunks_;
+        uint32_t expected = kChunkFree;
+        if (chunks_[index].state.compare_exchange_strong(&expected, kChunkOwned,
+                                                         fbl::memory_order_acquire,
+                                                         fbl::memory_order_relaxed)) {
+            chunks_[index].fill.store(0u, fbl::memory_order_relaxed);
+            *out_index = index;
+            return true;
+        }
+    }
+    // Every chunk is either owned by another thread or waiting to be drained.
+    return false;
+}
+
+void trace_context::RetireChunk(uint32_t index) {
+    ZX_DEBUG_ASSERT(index < num_chunks_);
+    Chunk& chunk = chunks_[index];
+    ZX_DEBUG_ASSERT(chunk.state.load(fbl::memory_order_relaxed) == kChunkOwned);
+
+    if (buffering_mode_ == TRACE_BUFFERING_MODE_STREAMING) {
+        uint32_t fill = chunk.fill.load(fbl::memory_order_relaxed);
+        if (fill) {
+            chunk.state.store(kChunkDraining, fbl::memory_order_release);
+            handler_->ops->chunk_full(handler_, chunk_start(index) - buffer_start_, fill);
+            return;
+        }
+    }
+
+    // In the circular mode the records stay put until the chunk is claimed
+    // again; |Finish()| pads out whatever is left unwritten.
+    chunk.state.store(kChunkFree, fbl::memory_order_release);
+}
+
+void trace_context::FlushCurrentThreadChunk() {
+    if (buffering_mode_ == TRACE_BUFFERING_MODE_ONESHOT)
+        return;
+
+    trace::ContextCache* cache = trace::GetCurrentContextCache(generation_);
+    if (cache && cache->chunk_ptr) {
+        RetireChunk(cache->chunk_index);
+        cache->chunk_ptr = nullptr;
+        cache->chunk_end = nullptr;
+    }
+}
+
+void trace_context::ReleaseChunk(size_t offset) {
+    if (buffering_mode_ != TRACE_BUFFERING_MODE_STREAMING)
+        return;
+
+    size_t chunks_offset = chunks_start_ - buffer_start_;
+    if (offset < chunks_offset || (offset - chunks_offset) % TRACE_ENGINE_CHUNK_SIZE)
+        return;
+    size_t index = (offset - chunks_offset) / TRACE_ENGINE_CHUNK_SIZE;
+    if (index >= num_chunks_)
+        return;
+
+    uint32_t expected = kChunkDraining;
+    chunks_[index].state.compare_exchange_strong(&expected, kChunkFree,
+                                                 fbl::memory_order_release,
+                                                 fbl::memory_order_relaxed);
+}
+
+void trace_context::MarkRecordsDropped() {
+    uint32_t expected = 0u;
+    if (records_dropped_.compare_exchange_strong(&expected, 1u,
+                                                 fbl::memory_order_relaxed,
+                                                 fbl::memory_order_relaxed)) {
+        handler_->ops->buffer_overflow(handler_);
+    }
+}
+
+void trace_context::Finish() {
+    switch (buffering_mode_) {
+    case TRACE_BUFFERING_MODE_CIRCULAR: {
+        uint8_t* durable_end = fbl::min(
+            reinterpret_cast<uint8_t*>(buffer_current_.load(fbl::memory_order_relaxed)),
+            chunks_start_);
+        trace::WritePadding(durable_end, chunks_start_ - durable_end);
+        for (uint32_t i = 0; i < num_chunks_; i++) {
+            uint32_t fill = chunks_[i].fill.load(fbl::memory_order_relaxed);
+            trace::WritePadding(chunk_start(i) + fill, TRACE_ENGINE_CHUNK_SIZE - fill);
+        }
+        break;
+    }
+    case TRACE_BUFFERING_MODE_STREAMING:
+        // Threads which are still holding chunks will never fill them now.
+        for (uint32_t i = 0; i < num_chunks_; i++) {
+            if (chunks_[i].state.load(fbl::memory_order_relaxed) == kChunkOwned)
+                RetireChunk(i);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
 bool trace_context::AllocThreadIndex(trace_thread_index_t* out_index) {
     trace_thread_index_t index = next_thread_index_.fetch_add(1u, fbl::memory_order_relaxed);
     if (unlikely(index > TRACE_ENCODED_THREAD_REF_MAX_INDEX)) {
@@ -7,6 +7,7 @@
 #include <zircon/assert.h>
 
 #include <fbl/atomic.h>
+#include <fbl/unique_ptr.h>
 
 #include <trace-engine/context.h>
 #include <trace-engine/handler.h>
@@ -16,34 +17,109 @@
 // context references.
 // Implements the opaque type declared in <trace-engine/context.h>.
 struct trace_context {
-    trace_context(void* buffer, size_t buffer_num_bytes, trace_handler_t* handler);
+    trace_context(void* buffer, size_t buffer_num_bytes,
+                  trace_buffering_mode_t buffering_mode,
+                  trace_handler_t* handler);
 
     ~trace_context();
 
+    // Returns true if a buffer of |buffer_num_bytes| can be used with
+    // |buffering_mode|.
+    static bool IsValidBuffer(trace_buffering_mode_t buffering_mode,
+                              size_t buffer_num_bytes);
+
     uint32_t generation() const { return generation_; }
 
     trace_handler_t* handler() const { return handler_; }
 
+    trace_buffering_mode_t buffering_mode() const { return buffering_mode_; }
+
     bool is_buffer_full() const {
-        return buffer_full_mark_.load(fbl::memory_order_relaxed) != 0u;
+        return buffer_full_mark_.load(fbl::memory_order_relaxed) != 0u ||
+               records_dropped_.load(fbl::memory_order_relaxed) != 0u;
     }
 
     size_t bytes_allocated() const {
+        switch (buffering_mode_) {
+        case TRACE_BUFFERING_MODE_CIRCULAR:
+            // |Finish()| pads out every chunk.
+            return buffer_end_ - buffer_start_;
+        case TRACE_BUFFERING_MODE_STREAMING:
+            // Everything was handed to the handler.
+            return 0u;
+        default:
+            break;
+        }
         uintptr_t tail = buffer_full_mark_.load(fbl::memory_order_relaxed);
         if (!tail)
             tail = buffer_current_.load(fbl::memory_order_relaxed);
         return reinterpret_cast<uint8_t*>(tail) - buffer_start_;
     }
 
+    // Allocates space for a record.
+    // In the circular and streaming modes the space comes from the calling
+    // thread's current chunk, so only claiming a new chunk touches state
+    // shared with other threads.
     uint64_t* AllocRecord(size_t num_bytes);
+
+    // Allocates space for a record which other records may refer to, such as
+    // a string or thread record.  In the circular mode these are kept apart
+    // from the chunks so they are not overwritten.
+    uint64_t* AllocDurableRecord(size_t num_bytes);
+
     bool AllocThreadIndex(trace_thread_index_t* out_index);
     bool AllocStringIndex(trace_string_index_t* out_index);
 
+    // Gives up the chunk owned by the calling thread, if any.
+    // In the streaming mode this hands the chunk to the handler.
+    void FlushCurrentThreadChunk();
+
+    // Gives up the chunk at |index| which was claimed by a thread which no
+    // longer writes into it.
+    void RetireChunk(uint32_t index);
+
+    // Returns a chunk handed to the handler in the streaming mode.
+    void ReleaseChunk(size_t offset);
+
+    // Leaves the buffer in a readable state once all references to the
+    // context have been released.  In the circular mode, pads out unused
+    // space so the buffer holds only whole records.  In the streaming mode,
+    // hands the remaining partially filled chunks to the handler.
+    void Finish();
+
 private:
+    // Chunk states.
+    static constexpr uint32_t kChunkFree = 0u;
+    static constexpr uint32_t kChunkOwned = 1u;
+    static constexpr uint32_t kChunkDraining = 2u;
+
+    // Bookkeeping for one chunk.
+    struct Chunk {
+        // One of the chunk states above.
+        fbl::atomic<uint32_t> state{kChunkFree};
+
+        // Number of bytes allocated from the chunk by its owner.
+        fbl::atomic<uint32_t> fill{0u};
+    };
+
+    static size_t NumChunks(trace_buffering_mode_t buffering_mode,
+                            size_t buffer_num_bytes);
+
+    uint8_t* chunk_start(uint32_t index) const {
+        return chunks_start_ + index * TRACE_ENGINE_CHUNK_SIZE;
+    }
+
+    uint64_t* AllocChunkRecord(size_t num_bytes);
+    bool ClaimChunk(uint32_t* out_index);
+    void MarkRecordsDropped();
+
     // The generation counter associated with this context to distinguish
     // it from previously created contexts.
     uint32_t const generation_;
 
+    // How records are laid out in the buffer.
+    trace_buffering_mode_t const buffering_mode_;
+
     // Buffer start and end pointers.
     uint8_t* const buffer_start_;
     uint8_t* const buffer_end_;
@@ -51,12 +127,29 @@ private:
     // Current allocation pointer.
     // Starts at |buffer_start| and grows from there.
     // May exceed |buffer_end| when the buffer is full.
+    // In the circular mode, this allocates from the durable region which
+    // ends at |chunks_start_|, and is otherwise unused in the chunked modes.
     fbl::atomic<uintptr_t> buffer_current_;
 
     // Pointer beyond the last successful allocation, or null if not full.
     // Only ever set to non-null once in the lifetime of the trace context.
+    // Only used in the oneshot mode.
     fbl::atomic<uintptr_t> buffer_full_mark_;
 
+    // Set to non-zero the first time a record is dropped in the circular or
+    // streaming modes because no chunk was available.
+    fbl::atomic<uint32_t> records_dropped_{0u};
+
+    // Chunks of |TRACE_ENGINE_CHUNK_SIZE| bytes, which run up to |buffer_end_|.
+    // Empty in the oneshot mode.
+    uint8_t* const chunks_start_;
+    uint32_t const num_chunks_;
+    fbl::unique_ptr<Chunk[]> chunks_;
+
+    // Where to start looking for a free chunk.  Advancing this round-robin
+    // means the chunk which was claimed longest ago is recycled first.
+    fbl::atomic<uint32_t> next_chunk_{0u};
+
     // Handler associated with the trace session.
     trace_handler_t* const handler_;
 
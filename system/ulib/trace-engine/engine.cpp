@@ -132,10 +132,23 @@ zx_status_t trace_start_engine(async_t* async,
                                trace_handler_t* handler,
                                void* buffer,
                                size_t buffer_num_bytes) {
+    return trace_start_engine_with_mode(async, handler, TRACE_BUFFERING_MODE_ONESHOT,
+                                        buffer, buffer_num_bytes);
+}
+
+// thread-safe
+zx_status_t trace_start_engine_with_mode(async_t* async,
+                                         trace_handler_t* handler,
+                                         trace_buffering_mode_t buffering_mode,
+                                         void* buffer,
+                                         size_t buffer_num_bytes) {
     ZX_DEBUG_ASSERT(async);
     ZX_DEBUG_ASSERT(handler);
     ZX_DEBUG_ASSERT(buffer);
 
+    if (!trace_context::IsValidBuffer(buffering_mode, buffer_num_bytes))
+        return ZX_ERR_INVALID_ARGS;
+
     fbl::AutoLock lock(&g_engine_mutex);
 
     // We must have fully stopped a prior tracing session before starting a new one.
@@ -166,7 +179,7 @@ zx_status_t trace_start_engine(async_t* async,
     g_async = async;
     g_handler = handler;
     g_disposition = ZX_OK;
-    g_context = new trace_context(buffer, buffer_num_bytes, handler);
+    g_context = new trace_context(buffer, buffer_num_bytes, buffering_mode, handler);
     g_event = fbl::move(event);
 
     // Write the trace initialization record first before allowing clients to
@@ -176,6 +189,12 @@ zx_status_t trace_start_engine(async_t* async,
     // After this point clients can acquire references to the trace context.
     g_context_refs.store(1u, fbl::memory_order_release);
 
+    // When streaming, hand the initialization record to the handler right
+    // away rather than leaving it in this thread's chunk.  This comes after
+    // the reference count is set so the handler can release the chunk from
+    // within the callback.
+    g_context->FlushCurrentThreadChunk();
+
     // Notify observers that the state changed.
     if (g_observers.is_empty()) {
         g_event.signal(0u, SIGNAL_ALL_OBSERVERS_STARTED);
@@ -270,6 +289,10 @@ void handle_all_observers_started() {
 
 void handle_context_released(async_t* async) {
     // All ready to clean up.
+    // Nobody else can touch the buffer now, so it can be tidied up before
+    // taking the lock.  This may call back into the handler.
+    g_context->Finish();
+
     // Grab the mutex while modifying shared state.
     zx_status_t disposition;
     trace_handler_t* handler;
@@ -415,6 +438,15 @@ void trace_release_context(trace_context_t* context) {
     }
 }
 
+// thread-safe, lock-free
+void trace_engine_release_chunk(size_t offset) {
+    trace_context_t* context = trace_acquire_context();
+    if (!context)
+        return;
+    context->ReleaseChunk(offset);
+    trace_release_context(context);
+}
+
 zx_status_t trace_register_observer(zx_handle_t event) {
     fbl::AutoLock lock(&g_engine_mutex);
 
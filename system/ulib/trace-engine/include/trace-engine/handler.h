@@ -33,6 +33,28 @@ __BEGIN_CDECLS
 // defined in the |ops| structure.
 typedef struct trace_handler_ops trace_handler_ops_t;
 
+// Describes how the trace engine uses its buffer.
+typedef enum {
+    // Records are appended until the buffer is full, after which further
+    // records are dropped.  The buffer holds one contiguous run of records.
+    TRACE_BUFFERING_MODE_ONESHOT = 0,
+
+    // Records are written into fixed-size chunks which are recycled once
+    // every chunk has been used, overwriting the oldest records.  String,
+    // thread, and kernel object records are kept in a separate region at
+    // the start of the buffer so later chunks can still refer to them.
+    TRACE_BUFFERING_MODE_CIRCULAR = 1,
+
+    // Records are written into fixed-size chunks which are passed to
+    // |trace_handler_ops.chunk_full()| as they fill up.  A chunk is not
+    // reused until the handler calls |trace_engine_release_chunk()|.
+    TRACE_BUFFERING_MODE_STREAMING = 2,
+} trace_buffering_mode_t;
+
+// The size of each chunk in the circular and streaming buffering modes.
+// Large enough to hold a record of |TRACE_ENCODED_RECORD_MAX_LENGTH| bytes.
+#define TRACE_ENGINE_CHUNK_SIZE ((size_t)32768u)
+
 typedef struct trace_handler {
     const trace_handler_ops_t* ops;
 } trace_handler_t;
@@ -63,6 +85,10 @@ struct trace_handler_ops {
     // |disposition| is |ZX_OK| if tracing stopped normally, otherwise indicates
     // that tracing was aborted due to an error.
     // |buffer_bytes_written| is number of bytes which were written to the trace buffer.
+    // In |TRACE_BUFFERING_MODE_CIRCULAR| this is the size of the whole buffer,
+    // which has been padded so that it holds a sequence of whole records.
+    // In |TRACE_BUFFERING_MODE_STREAMING| this is zero since all records have
+    // already been handed to |chunk_full()|.
     //
     // Called on an asynchronous dispatch thread.
     void (*trace_stopped)(trace_handler_t* handler, async_t* async,
@@ -73,9 +99,25 @@ struct trace_handler_ops {
     //
     // Called by instrumentation on any thread.  Must be thread-safe.
     void (*buffer_overflow)(trace_handler_t* handler);
+
+    // Called by the trace engine in |TRACE_BUFFERING_MODE_STREAMING| when
+    // a chunk of the trace buffer is ready to be drained.
+    //
+    // |offset| is the offset of the chunk from the start of the trace buffer.
+    // |size| is the number of bytes of records in the chunk, which is always
+    // a sequence of whole records.
+    //
+    // The handler must call |trace_engine_release_chunk()| with the same
+    // |offset| once it has consumed the chunk.  Until then, the chunk will
+    // not be reused.  Chunks which are handed off while the trace is stopping
+    // need not be released.
+    //
+    // Called by instrumentation on any thread, and on the asynchronous
+    // dispatch thread just before |trace_stopped()|.  Must be thread-safe.
+    void (*chunk_full)(trace_handler_t* handler, size_t offset, size_t size);
 };
 
-// Asynchronously starts the trace engine.
+// Asynchronously starts the trace engine in |TRACE_BUFFERING_MODE_ONESHOT|.
 //
 // |async| is the asynchronous dispatcher which the trace engine will use for dispatch.
 // |handler| is the trace handler which will handle lifecycle events.
@@ -109,6 +151,18 @@ zx_status_t trace_start_engine(async_t* async,
                                void* buffer,
                                size_t buffer_num_bytes);
 
+// Like |trace_start_engine()|, but |buffering_mode| describes how the trace
+// buffer is filled.
+//
+// Returns |ZX_ERR_INVALID_ARGS| if |buffering_mode| is not recognized, or the
+// buffer is too small to hold at least two chunks in the circular and
+// streaming modes.
+zx_status_t trace_start_engine_with_mode(async_t* async,
+                                         trace_handler_t* handler,
+                                         trace_buffering_mode_t buffering_mode,
+                                         void* buffer,
+                                         size_t buffer_num_bytes);
+
 // Asynchronously stops the trace engine.
 //
 // The trace handler's |trace_stopped()| method will be invoked asynchronously
@@ -123,4 +177,15 @@ zx_status_t trace_start_engine(async_t* async,
 // This function is thread-safe.
 zx_status_t trace_stop_engine(zx_status_t disposition);
 
+// Returns a chunk which was passed to |trace_handler_ops.chunk_full()| to the
+// trace engine so that it can be filled again.
+//
+// |offset| is the offset of the chunk as reported to |chunk_full()|.
+//
+// Does nothing if the trace engine is stopped or the chunk was handed off
+// while the trace was stopping.
+//
+// This function is thread-safe and lock-free.
+void trace_engine_release_chunk(size_t offset);
+
 __END_CDECLS
@@ -339,6 +339,9 @@ enum class MetadataType {
     kProviderInfo = 1,
     kProviderSection = 2,
     kProviderEvent = 3,
+    // Fills unused space at the end of a buffer chunk.  Carries no data and
+    // is skipped by readers.
+    kPadding = 4,
 };
 
 // Enumerates all provider events.
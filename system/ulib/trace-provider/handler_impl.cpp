@@ -12,15 +12,21 @@
 
 #include <trace-provider/provider.h>
 #include <zx/vmar.h>
+#include <fbl/auto_lock.h>
 #include <fbl/type_support.h>
 
 namespace trace {
 namespace internal {
 
-TraceHandlerImpl::TraceHandlerImpl(void* buffer, size_t buffer_num_bytes,
+TraceHandlerImpl::TraceHandlerImpl(async_t* async,
+                                   trace_provider_drain_func_t* drain, void* drain_ctx,
+                                   void* buffer, size_t buffer_num_bytes,
                                    zx::eventpair fence,
                                    fbl::Vector<fbl::String> enabled_categories)
-    : buffer_(buffer),
+    : async_(async),
+      drain_(drain),
+      drain_ctx_(drain_ctx),
+      buffer_(buffer),
       buffer_num_bytes_(buffer_num_bytes),
       fence_(fbl::move(fence)),
       enabled_categories_(fbl::move(enabled_categories)) {
@@ -29,6 +35,8 @@ TraceHandlerImpl::TraceHandlerImpl(void* buffer, size_t buffer_num_bytes,
         auto entry = fbl::make_unique<StringSetEntry>(cat.c_str());
         enabled_category_set_.insert_or_find(fbl::move(entry));
     }
+
+    drain_task_.set_handler(fbl::BindMember(this, &TraceHandlerImpl::DrainTask));
 }
 
 TraceHandlerImpl::~TraceHandlerImpl() {
@@ -38,6 +46,9 @@ TraceHandlerImpl::~TraceHandlerImpl() {
 }
 
 zx_status_t TraceHandlerImpl::StartEngine(async_t* async,
+                                          trace_buffering_mode_t buffering_mode,
+                                          trace_provider_drain_func_t* drain,
+                                          void* drain_ctx,
                                           zx::vmo buffer, zx::eventpair fence,
                                           fbl::Vector<fbl::String> enabled_categories) {
     ZX_DEBUG_ASSERT(buffer);
@@ -55,11 +66,12 @@ zx_status_t TraceHandlerImpl::StartEngine(async_t* async,
     if (status != ZX_OK)
         return status;
 
-    auto handler = new TraceHandlerImpl(reinterpret_cast<void*>(buffer_ptr),
+    auto handler = new TraceHandlerImpl(async, drain, drain_ctx,
+                                        reinterpret_cast<void*>(buffer_ptr),
                                         buffer_num_bytes, fbl::move(fence),
                                         fbl::move(enabled_categories));
-    status = trace_start_engine(async, handler,
-                                handler->buffer_, handler->buffer_num_bytes_);
+    status = trace_start_engine_with_mode(async, handler, buffering_mode,
+                                          handler->buffer_, handler->buffer_num_bytes_);
     if (status != ZX_OK) {
         delete handler;
         return status;
@@ -96,6 +108,15 @@ void TraceHandlerImpl::TraceStopped(async_t* async, zx_status_t disposition,
                                     size_t buffer_bytes_written) {
     // TODO: Report the disposition and bytes written back to the tracing system
     // so it has a better idea of what happened.
+
+    // The engine hands over its last chunks just before stopping; drain them
+    // now since this object is going away.
+    DrainPendingChunks();
+    {
+        fbl::AutoLock lock(&pending_mutex_);
+        if (drain_posted_)
+            drain_task_.Cancel(async_);
+    }
     delete this;
 }
 
@@ -105,5 +126,40 @@ void TraceHandlerImpl::BufferOverflow() {
                     status == ZX_ERR_PEER_CLOSED);
 }
 
+void TraceHandlerImpl::ChunkFull(size_t offset, size_t size) {
+    ZX_DEBUG_ASSERT(drain_);
+
+    fbl::AutoLock lock(&pending_mutex_);
+    pending_chunks_.push_back(PendingChunk{offset, size});
+    if (!drain_posted_) {
+        zx_status_t status = drain_task_.Post(async_);
+        // If the dispatcher is shutting down then the engine is stopping
+        // too and |TraceStopped()| will pick up the chunk.
+        drain_posted_ = status == ZX_OK;
+    }
+}
+
+async_task_result_t TraceHandlerImpl::DrainTask(async_t* async, zx_status_t status) {
+    {
+        fbl::AutoLock lock(&pending_mutex_);
+        drain_posted_ = false;
+    }
+    if (status == ZX_OK)
+        DrainPendingChunks();
+    return ASYNC_TASK_FINISHED;
+}
+
+void TraceHandlerImpl::DrainPendingChunks() {
+    fbl::Vector<PendingChunk> chunks;
+    {
+        fbl::AutoLock lock(&pending_mutex_);
+        chunks.swap(pending_chunks_);
+    }
+    for (const auto& chunk : chunks) {
+        drain_(drain_ctx_, static_cast<uint8_t*>(buffer_) + chunk.offset, chunk.size);
+        trace_engine_release_chunk(chunk.offset);
+    }
+}
+
 } // namespace internal
 } // namespace trace
@@ -6,10 +6,13 @@
 
 #include <trace/handler.h>
 
+#include <async/cpp/task.h>
+#include <trace-provider/provider.h>
 #include <zx/eventpair.h>
 #include <zx/vmo.h>
 #include <fbl/intrusive_hash_table.h>
 #include <fbl/macros.h>
+#include <fbl/mutex.h>
 #include <fbl/string.h>
 #include <fbl/unique_ptr.h>
 #include <fbl/vector.h>
@@ -20,13 +23,17 @@ namespace internal {
 
 class TraceHandlerImpl final : public trace::TraceHandler {
 public:
-    static zx_status_t StartEngine(async_t* async, zx::vmo buffer,
-                                   zx::eventpair fence,
+    static zx_status_t StartEngine(async_t* async,
+                                   trace_buffering_mode_t buffering_mode,
+                                   trace_provider_drain_func_t* drain, void* drain_ctx,
+                                   zx::vmo buffer, zx::eventpair fence,
                                    fbl::Vector<fbl::String> enabled_categories);
     static zx_status_t StopEngine();
 
 private:
-    TraceHandlerImpl(void* buffer, size_t buffer_num_bytes,
+    TraceHandlerImpl(async_t* async,
+                     trace_provider_drain_func_t* drain, void* drain_ctx,
+                     void* buffer, size_t buffer_num_bytes,
                      zx::eventpair fence,
                      fbl::Vector<fbl::String> enabled_categories);
     ~TraceHandlerImpl() override;
@@ -37,6 +44,27 @@ private:
     void TraceStopped(async_t* async,
                       zx_status_t disposition, size_t buffer_bytes_written) override;
     void BufferOverflow() override;
+    void ChunkFull(size_t offset, size_t size) override;
+
+    // A chunk of the trace buffer waiting to be drained.
+    struct PendingChunk {
+        size_t offset;
+        size_t size;
+    };
+
+    async_task_result_t DrainTask(async_t* async, zx_status_t status);
+    void DrainPendingChunks();
+
+    async_t* const async_;
+    trace_provider_drain_func_t* const drain_;
+    void* const drain_ctx_;
+
+    // Chunks handed over by the trace engine in the streaming mode, which
+    // are drained on |async_| so that instrumentation does not wait on them.
+    fbl::Mutex pending_mutex_;
+    fbl::Vector<PendingChunk> pending_chunks_; // guarded by |pending_mutex_|
+    bool drain_posted_ = false; // guarded by |pending_mutex_|
+    async::Task drain_task_;
 
     void* buffer_;
     size_t buffer_num_bytes_;
@@ -12,6 +12,7 @@
 #include <zircon/types.h>
 
 #include <async/dispatcher.h>
+#include <trace-engine/handler.h>
 
 __BEGIN_CDECLS
 
@@ -45,6 +46,27 @@ typedef struct trace_provider trace_provider_t;
 // probably need to pass some extra parameters to the trace provider then.
 trace_provider_t* trace_provider_create(async_t* async);
 
+// Receives records drained from the trace buffer in
+// |TRACE_BUFFERING_MODE_STREAMING|.
+//
+// |data| holds |size| bytes of whole records.  It is only valid for the
+// duration of the call.
+//
+// Called on the trace provider's asynchronous dispatcher, in the order in
+// which the chunks filled up.
+typedef void(trace_provider_drain_func_t)(void* ctx, const void* data, size_t size);
+
+// Like |trace_provider_create()| but fills the trace buffer using
+// |buffering_mode|.
+//
+// |drain| and |drain_ctx| receive the records in |TRACE_BUFFERING_MODE_STREAMING|
+// and must be null otherwise.
+//
+// Returns the trace provider, or null if creation failed.
+trace_provider_t* trace_provider_create_with_buffering_mode(
+    async_t* async, trace_buffering_mode_t buffering_mode,
+    trace_provider_drain_func_t* drain, void* drain_ctx);
+
 // Destroys the trace provider.
 void trace_provider_destroy(trace_provider_t* provider);
 
@@ -60,6 +82,13 @@ public:
     TraceProvider(async_t* async)
         : provider_(trace_provider_create(async)) {}
 
+    // Creates a trace provider which fills the trace buffer using |buffering_mode|.
+    TraceProvider(async_t* async, trace_buffering_mode_t buffering_mode,
+                  trace_provider_drain_func_t* drain = nullptr,
+                  void* drain_ctx = nullptr)
+        : provider_(trace_provider_create_with_buffering_mode(
+              async, buffering_mode, drain, drain_ctx)) {}
+
     // Destroys a trace provider.
     ~TraceProvider() {
         if (provider_)
@@ -60,8 +60,12 @@ struct register_trace_provider : message {
 namespace trace {
 namespace internal {
 
-TraceProviderImpl::TraceProviderImpl(async_t* async, zx::channel channel)
-    : async_(async), connection_(this, fbl::move(channel)) {
+TraceProviderImpl::TraceProviderImpl(async_t* async, zx::channel channel,
+                                     trace_buffering_mode_t buffering_mode,
+                                     trace_provider_drain_func_t* drain, void* drain_ctx)
+    : async_(async), buffering_mode_(buffering_mode),
+      drain_(drain), drain_ctx_(drain_ctx),
+      connection_(this, fbl::move(channel)) {
 }
 
 TraceProviderImpl::~TraceProviderImpl() = default;
@@ -72,7 +76,8 @@ void TraceProviderImpl::Start(zx::vmo buffer, zx::eventpair fence,
         return;
 
     zx_status_t status = TraceHandlerImpl::StartEngine(
-        async_, fbl::move(buffer), fbl::move(fence),
+        async_, buffering_mode_, drain_, drain_ctx_,
+        fbl::move(buffer), fbl::move(fence),
         fbl::move(enabled_categories));
     if (status == ZX_OK)
         running_ = true;
@@ -231,7 +236,15 @@ void TraceProviderImpl::Connection::Close() {
 } // namespace trace
 
 trace_provider_t* trace_provider_create(async_t* async) {
+    return trace_provider_create_with_buffering_mode(
+        async, TRACE_BUFFERING_MODE_ONESHOT, nullptr, nullptr);
+}
+
+trace_provider_t* trace_provider_create_with_buffering_mode(
+    async_t* async, trace_buffering_mode_t buffering_mode,
+    trace_provider_drain_func_t* drain, void* drain_ctx) {
     ZX_DEBUG_ASSERT(async);
+    ZX_DEBUG_ASSERT((buffering_mode == TRACE_BUFFERING_MODE_STREAMING) == (drain != nullptr));
 
     // Connect to the trace registry.
     zx::channel registry_client;
@@ -277,7 +290,8 @@ trace_provider_t* trace_provider_create(async_t* async) {
         return nullptr;
     }
 
-    return new trace::internal::TraceProviderImpl(async, fbl::move(provider_service));
+    return new trace::internal::TraceProviderImpl(async, fbl::move(provider_service),
+                                                  buffering_mode, drain, drain_ctx);
 }
 
 void trace_provider_destroy(trace_provider_t* provider) {
@@ -21,7 +21,9 @@ namespace internal {
 
 class TraceProviderImpl final : public trace_provider_t {
 public:
-    TraceProviderImpl(async_t* async, zx::channel channel);
+    TraceProviderImpl(async_t* async, zx::channel channel,
+                      trace_buffering_mode_t buffering_mode,
+                      trace_provider_drain_func_t* drain, void* drain_ctx);
     ~TraceProviderImpl();
 
 private:
@@ -48,6 +50,9 @@ private:
     void Stop();
 
     async_t* const async_;
+    trace_buffering_mode_t const buffering_mode_;
+    trace_provider_drain_func_t* const drain_;
+    void* const drain_ctx_;
     Connection connection_;
     bool running_ = false;
 
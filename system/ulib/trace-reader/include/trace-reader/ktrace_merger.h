@@ -0,0 +1,67 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <fbl/function.h>
+#include <fbl/macros.h>
+#include <fbl/string.h>
+#include <fbl/vector.h>
+
+namespace trace {
+
+// Merges kernel trace records into timestamp order.
+//
+// zx_ktrace_read() returns one stream of records per cpu, each introduced
+// by a TAG_STREAM record, plus a stream of name records.  In streaming mode
+// successive reads return further pieces of the same streams.  The merger
+// collects the pieces and hands out the records of all the streams as one.
+class KtraceMerger {
+public:
+    // Called once for each record, with its KTRACE_LEN(tag) bytes.
+    using RecordConsumer = fbl::Function<void(const void* record, size_t size)>;
+
+    // Callback invoked when decoding errors are detected in the trace.
+    using ErrorHandler = fbl::Function<void(fbl::String)>;
+
+    KtraceMerger(RecordConsumer record_consumer, ErrorHandler error_handler);
+
+    // Adds data returned by zx_ktrace_read().  Returns false if the data is
+    // malformed or its TAG_VERSION is not KTRACE_VERSION, in which case none
+    // of it is added.
+    bool AddData(const void* data, size_t size);
+
+    // Hands all the records added so far to the record consumer and forgets
+    // them.  Records which are not part of a cpu stream, such as the metadata
+    // and name records, come first in the order they were added; the records
+    // of the cpu streams follow, merged by timestamp.
+    void Flush();
+
+    // Total number of records the kernel reported dropping.
+    uint64_t dropped_records() const { return dropped_records_; }
+
+private:
+    struct Stream {
+        uint32_t id;
+        fbl::Vector<uint8_t> data;
+    };
+
+    Stream* GetStream(uint32_t id);
+    void ReportError(fbl::String error);
+
+    RecordConsumer record_consumer_;
+    ErrorHandler error_handler_;
+
+    // records outside the cpu streams
+    fbl::Vector<uint8_t> prefix_;
+    fbl::Vector<Stream> streams_;
+    uint64_t dropped_records_ = 0u;
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(KtraceMerger);
+};
+
+} // namespace trace
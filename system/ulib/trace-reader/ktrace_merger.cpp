@@ -0,0 +1,169 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <trace-reader/ktrace_merger.h>
+
+#include <string.h>
+
+#include <fbl/string_printf.h>
+#include <zircon/ktrace.h>
+
+namespace trace {
+namespace {
+
+uint32_t ReadTag(const uint8_t* record) {
+    uint32_t tag;
+    memcpy(&tag, record, sizeof(tag));
+    return tag;
+}
+
+// Name records have no timestamp; they are delivered as soon as they are
+// reached in their stream.
+uint64_t ReadTimestamp(const uint8_t* record) {
+    uint32_t tag = ReadTag(record);
+    uint32_t event = KTRACE_EVENT(tag);
+    if ((event >= 0x020 && event < 0x030) || KTRACE_LEN(tag) < KTRACE_HDRSIZE) {
+        return 0u;
+    }
+    uint64_t ts;
+    memcpy(&ts, record + offsetof(ktrace_header_t, ts), sizeof(ts));
+    return ts;
+}
+
+// Checks that |data| holds a whole number of records.
+bool IsWellFormed(const uint8_t* data, size_t size) {
+    size_t pos = 0;
+    while (pos < size) {
+        if (size - pos < sizeof(uint32_t))
+            return false;
+        size_t len = KTRACE_LEN(ReadTag(data + pos));
+        if (len == 0 || len > size - pos)
+            return false;
+        pos += len;
+    }
+    return true;
+}
+
+void Append(fbl::Vector<uint8_t>* vector, const uint8_t* data, size_t size) {
+    vector->reserve(vector->size() + size);
+    for (size_t i = 0; i < size; i++)
+        vector->push_back(data[i]);
+}
+
+} // namespace
+
+KtraceMerger::KtraceMerger(RecordConsumer record_consumer,
+                           ErrorHandler error_handler)
+    : record_consumer_(fbl::move(record_consumer)),
+      error_handler_(fbl::move(error_handler)) {}
+
+bool KtraceMerger::AddData(const void* data, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+
+    // Validate everything before adding anything.
+    size_t pos = 0;
+    while (pos < size) {
+        if (size - pos < sizeof(uint32_t)) {
+            ReportError("Truncated record");
+            return false;
+        }
+        uint32_t tag = ReadTag(bytes + pos);
+        size_t len = KTRACE_LEN(tag);
+        if (len == 0 || len > size - pos) {
+            ReportError(fbl::StringPrintf("Invalid record with tag 0x%x", tag));
+            return false;
+        }
+        if (tag == TAG_STREAM) {
+            ktrace_rec_32b_t rec;
+            memcpy(&rec, bytes + pos, sizeof(rec));
+            if (rec.b > size - pos - len || !IsWellFormed(bytes + pos + len, rec.b)) {
+                ReportError(fbl::StringPrintf("Invalid stream for cpu %u", rec.a));
+                return false;
+            }
+            len += rec.b;
+        } else if (tag == TAG_VERSION) {
+            ktrace_rec_32b_t rec;
+            memcpy(&rec, bytes + pos, sizeof(rec));
+            if (rec.a != KTRACE_VERSION) {
+                ReportError(fbl::StringPrintf("Unsupported ktrace version 0x%x", rec.a));
+                return false;
+            }
+        }
+        pos += len;
+    }
+
+    pos = 0;
+    while (pos < size) {
+        uint32_t tag = ReadTag(bytes + pos);
+        size_t len = KTRACE_LEN(tag);
+        if (tag != TAG_STREAM) {
+            Append(&prefix_, bytes + pos, len);
+            pos += len;
+            continue;
+        }
+        ktrace_rec_32b_t rec;
+        memcpy(&rec, bytes + pos, sizeof(rec));
+        pos += len;
+        dropped_records_ += rec.c;
+        if (rec.a == KTRACE_STREAM_NAMES) {
+            Append(&prefix_, bytes + pos, rec.b);
+        } else {
+            Append(&GetStream(rec.a)->data, bytes + pos, rec.b);
+        }
+        pos += rec.b;
+    }
+    return true;
+}
+
+void KtraceMerger::Flush() {
+    for (size_t pos = 0; pos < prefix_.size();) {
+        size_t len = KTRACE_LEN(ReadTag(&prefix_[pos]));
+        record_consumer_(&prefix_[pos], len);
+        pos += len;
+    }
+    prefix_.reset();
+
+    // Each stream is in timestamp order already, so repeatedly take the
+    // earliest of the records at the front of the streams.
+    fbl::Vector<size_t> cursors;
+    cursors.reserve(streams_.size());
+    for (size_t i = 0; i < streams_.size(); i++)
+        cursors.push_back(0u);
+    while (true) {
+        size_t best = streams_.size();
+        uint64_t best_ts = 0u;
+        for (size_t i = 0; i < streams_.size(); i++) {
+            if (cursors[i] == streams_[i].data.size())
+                continue;
+            uint64_t ts = ReadTimestamp(&streams_[i].data[cursors[i]]);
+            if (best == streams_.size() || ts < best_ts) {
+                best = i;
+                best_ts = ts;
+            }
+        }
+        if (best == streams_.size())
+            break;
+        const uint8_t* record = &streams_[best].data[cursors[best]];
+        size_t len = KTRACE_LEN(ReadTag(record));
+        record_consumer_(record, len);
+        cursors[best] += len;
+    }
+    streams_.reset();
+}
+
+KtraceMerger::Stream* KtraceMerger::GetStream(uint32_t id) {
+    for (auto& stream : streams_) {
+        if (stream.id == id)
+            return &stream;
+    }
+    streams_.push_back(Stream{id, fbl::Vector<uint8_t>()});
+    return &streams_[streams_.size() - 1];
+}
+
+void KtraceMerger::ReportError(fbl::String error) {
+    if (error_handler_)
+        error_handler_(fbl::move(error));
+}
+
+} // namespace trace
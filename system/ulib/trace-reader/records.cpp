@@ -199,6 +199,8 @@ void MetadataContent::Destroy() {
     case MetadataType::kProviderEvent:
         provider_event_.~ProviderEvent();
         break;
+    case MetadataType::kPadding:
+        break;
     }
 }
 
@@ -214,6 +216,8 @@ void MetadataContent::MoveFrom(MetadataContent&& other) {
     case MetadataType::kProviderEvent:
         new (&provider_event_) ProviderEvent(fbl::move(other.provider_event_));
         break;
+    case MetadataType::kPadding:
+        break;
     }
 }
 
@@ -240,6 +244,8 @@ fbl::String MetadataContent::ToString() const {
         return fbl::StringPrintf("ProviderEvent(id: %" PRId32 ", %s)",
                                  provider_event_.id, name.c_str());
     }
+    case MetadataType::kPadding:
+        break;
     }
     ZX_ASSERT(false);
 }
@@ -10,7 +10,8 @@ const trace_handler_ops_t TraceHandler::kOps =
     {.is_category_enabled = &TraceHandler::CallIsCategoryEnabled,
      .trace_started = &TraceHandler::CallTraceStarted,
      .trace_stopped = &TraceHandler::CallTraceStopped,
-     .buffer_overflow = &TraceHandler::CallBufferOverflow};
+     .buffer_overflow = &TraceHandler::CallBufferOverflow,
+     .chunk_full = &TraceHandler::CallChunkFull};
 
 TraceHandler::TraceHandler()
     : trace_handler{.ops = &kOps} {}
@@ -35,4 +36,8 @@ void TraceHandler::CallBufferOverflow(trace_handler_t* handler) {
     static_cast<TraceHandler*>(handler)->BufferOverflow();
 }
 
+void TraceHandler::CallChunkFull(trace_handler_t* handler, size_t offset, size_t size) {
+    static_cast<TraceHandler*>(handler)->ChunkFull(offset, size);
+}
+
 } // namespace trace
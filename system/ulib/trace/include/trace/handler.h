@@ -56,12 +56,24 @@ public:
     // the buffer was full.
     virtual void BufferOverflow() {}
 
+    // Called by the trace engine in |TRACE_BUFFERING_MODE_STREAMING| when a
+    // chunk of the trace buffer is ready to be drained.
+    //
+    // |offset| is the offset of the chunk from the start of the trace buffer.
+    // |size| is the number of bytes of records in the chunk.
+    //
+    // Call |trace_engine_release_chunk()| once the chunk has been consumed.
+    //
+    // Called by instrumentation on any thread.  Must be thread-safe.
+    virtual void ChunkFull(size_t offset, size_t size) {}
+
 private:
     static bool CallIsCategoryEnabled(trace_handler_t* handler, const char* category);
     static void CallTraceStarted(trace_handler_t* handler);
     static void CallTraceStopped(trace_handler_t* handler, async_t* async,
                                  zx_status_t disposition, size_t buffer_bytes_written);
     static void CallBufferOverflow(trace_handler_t* handler);
+    static void CallChunkFull(trace_handler_t* handler, size_t offset, size_t size);
 
     static const trace_handler_ops_t kOps;
 };
@@ -18,6 +18,7 @@
 #define VIRTIO_BLK_F_FLUSH      (1u << 9)
 #define VIRTIO_BLK_F_TOPOLOGY   (1u << 10)
 #define VIRTIO_BLK_F_CONFIG_WCE (1u << 11)
+#define VIRTIO_BLK_F_MQ         (1u << 12)
 
 #define VIRTIO_BLK_T_IN         0
 #define VIRTIO_BLK_T_OUT        1
@@ -36,12 +37,24 @@ typedef struct virtio_blk_geometry {
     uint8_t sectors;
 } __PACKED virtio_blk_geometry_t;
 
+typedef struct virtio_blk_topology {
+    uint8_t physical_block_exp;
+    uint8_t alignment_offset;
+    uint16_t min_io_size;
+    uint32_t opt_io_size;
+} __PACKED virtio_blk_topology_t;
+
 typedef struct virtio_blk_config {
     uint64_t capacity;
     uint32_t size_max;
     uint32_t seg_max;
     virtio_blk_geometry_t geometry;
     uint32_t blk_size;
+    // The fields below are only present if the matching feature is offered.
+    virtio_blk_topology_t topology;
+    uint8_t writeback;
+    uint8_t unused0;
+    uint16_t num_queues;
 } __PACKED virtio_blk_config_t;
 
 typedef struct virtio_blk_req {
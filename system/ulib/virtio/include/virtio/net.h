@@ -43,6 +43,14 @@
 #define VIRTIO_NET_S_LINK_UP        1u
 #define VIRTIO_NET_S_ANNOUNCE       2u
 
+#define VIRTIO_NET_OK               0u
+#define VIRTIO_NET_ERR              1u
+
+#define VIRTIO_NET_CTRL_MQ                  4u
+#define VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET     0u
+#define VIRTIO_NET_CTRL_MQ_VQ_PAIRS_MIN     1u
+#define VIRTIO_NET_CTRL_MQ_VQ_PAIRS_MAX     0x8000u
+
 // clang-format on
 
 __BEGIN_CDECLS
@@ -62,4 +70,13 @@ typedef struct virtio_net_hdr {
     uint16_t csum_offset;
 } __PACKED virtio_net_hdr_t;
 
+typedef struct virtio_net_ctrl_hdr {
+    uint8_t class_;
+    uint8_t cmd;
+} __PACKED virtio_net_ctrl_hdr_t;
+
+typedef struct virtio_net_ctrl_mq {
+    uint16_t virtqueue_pairs;
+} __PACKED virtio_net_ctrl_mq_t;
+
 __END_CDECLS
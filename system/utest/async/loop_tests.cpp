@@ -615,6 +615,177 @@ bool task_shutdown_test() {
     END_TEST;
 }
 
+// Tasks which log the order in which they ran.  |seq| is the order in which
+// the task was last posted, which breaks ties between equal deadlines.
+class OrderedTask : public TestTask {
+public:
+    OrderedTask(zx_time_t deadline, uint32_t id, uint32_t* log, size_t* log_count)
+        : TestTask(deadline), id(id), log_(log), log_count_(log_count) {}
+
+    const uint32_t id;
+    uint32_t seq = 0u;
+
+protected:
+    uint32_t* log_;
+    size_t* log_count_;
+
+    async_task_result_t Handle(async_t* async, zx_status_t status) override {
+        TestTask::Handle(async, status);
+        log_[(*log_count_)++] = id;
+        return ASYNC_TASK_FINISHED;
+    }
+};
+
+class CancelingTask : public TestTask {
+public:
+    CancelingTask(zx_time_t deadline, async::Task* target)
+        : TestTask(deadline), target_(target) {}
+
+    zx_status_t cancel_status = ZX_ERR_INTERNAL;
+
+protected:
+    async::Task* target_;
+
+    async_task_result_t Handle(async_t* async, zx_status_t status) override {
+        TestTask::Handle(async, status);
+        cancel_status = target_->Cancel(async);
+        return ASYNC_TASK_FINISHED;
+    }
+};
+
+// Checks that the |log_count| tasks in |log| ran by deadline, and in the
+// order they were posted for equal deadlines.
+bool check_task_order(OrderedTask* const* tasks, const uint32_t* log, size_t log_count) {
+    BEGIN_HELPER;
+    for (size_t i = 1; i < log_count; i++) {
+        const OrderedTask* prev = tasks[log[i - 1]];
+        const OrderedTask* next = tasks[log[i]];
+        EXPECT_TRUE(prev->op.deadline() < next->op.deadline() ||
+                        (prev->op.deadline() == next->op.deadline() && prev->seq < next->seq),
+                    "tasks ran out of order");
+    }
+    END_HELPER;
+}
+
+bool task_order_test() {
+    const size_t num_tasks = 300;
+
+    BEGIN_TEST;
+
+    async::Loop loop;
+
+    // All deadlines are in the past and many are equal; they are posted
+    // out of order.
+    uint32_t log[num_tasks];
+    size_t log_count = 0u;
+    OrderedTask* tasks[num_tasks];
+    zx_time_t start_time = now();
+    uint32_t seq = 0u;
+    for (uint32_t i = 0; i < num_tasks; i++) {
+        zx_time_t deadline = start_time - ZX_MSEC((i * 7919u) % 50u);
+        tasks[i] = new OrderedTask(deadline, i, log, &log_count);
+        tasks[i]->seq = seq++;
+        EXPECT_EQ(ZX_OK, tasks[i]->op.Post(loop.async()), "post");
+    }
+    // Runs after every other task: its deadline is the latest and it was
+    // posted last.
+    QuitTask quit(start_time);
+    EXPECT_EQ(ZX_OK, quit.op.Post(loop.async()), "post quit");
+
+    EXPECT_EQ(ZX_ERR_CANCELED, loop.Run(), "run loop");
+    EXPECT_EQ(1u, quit.run_count, "run count quit");
+    EXPECT_EQ(num_tasks, log_count, "tasks run");
+    EXPECT_TRUE(check_task_order(tasks, log, log_count));
+    for (size_t i = 0; i < num_tasks; i++) {
+        EXPECT_EQ(1u, tasks[i]->run_count, "run count");
+        EXPECT_EQ(ZX_OK, tasks[i]->last_status, "status");
+        delete tasks[i];
+    }
+
+    END_TEST;
+}
+
+bool task_cancel_order_test() {
+    const size_t num_tasks = 300;
+
+    BEGIN_TEST;
+
+    async::Loop loop;
+
+    uint32_t log[num_tasks];
+    size_t log_count = 0u;
+    OrderedTask* tasks[num_tasks];
+    zx_time_t start_time = now();
+    uint32_t seq = 0u;
+    size_t earliest = 0u;
+    for (uint32_t i = 0; i < num_tasks; i++) {
+        zx_time_t deadline = start_time - ZX_MSEC((i * 7919u) % 50u);
+        tasks[i] = new OrderedTask(deadline, i, log, &log_count);
+        tasks[i]->seq = seq++;
+        EXPECT_EQ(ZX_OK, tasks[i]->op.Post(loop.async()), "post");
+        if (deadline < tasks[earliest]->op.deadline()) {
+            earliest = i;
+        }
+    }
+
+    // Cancel every third task, the first one to be due and the last one
+    // posted.  Canceling twice fails.
+    auto canceled = [earliest](size_t i) {
+        return i % 3u == 0u || i == earliest || i == num_tasks - 1u;
+    };
+    for (size_t i = 0; i < num_tasks; i++) {
+        if (canceled(i)) {
+            EXPECT_EQ(ZX_OK, tasks[i]->op.Cancel(loop.async()), "cancel");
+            EXPECT_EQ(ZX_ERR_NOT_FOUND, tasks[i]->op.Cancel(loop.async()), "cancel again");
+        }
+    }
+
+    // Post half of the canceled tasks again; they now come after the tasks
+    // with the same deadline which were not canceled.
+    auto reposted = [](size_t i) { return i % 6u == 0u; };
+    for (size_t i = 0; i < num_tasks; i++) {
+        if (reposted(i)) {
+            tasks[i]->seq = seq++;
+            EXPECT_EQ(ZX_OK, tasks[i]->op.Post(loop.async()), "post again");
+        }
+    }
+
+    // A task canceled while it is due, by a task due just before it.
+    TestTask victim(start_time);
+    CancelingTask canceler(start_time, &victim.op);
+    EXPECT_EQ(ZX_OK, canceler.op.Post(loop.async()), "post canceler");
+    EXPECT_EQ(ZX_OK, victim.op.Post(loop.async()), "post victim");
+
+    QuitTask quit(start_time);
+    EXPECT_EQ(ZX_OK, quit.op.Post(loop.async()), "post quit");
+
+    EXPECT_EQ(ZX_ERR_CANCELED, loop.Run(), "run loop");
+    EXPECT_EQ(1u, quit.run_count, "run count quit");
+    EXPECT_EQ(1u, canceler.run_count, "run count canceler");
+    EXPECT_EQ(ZX_OK, canceler.cancel_status, "cancel victim");
+    EXPECT_EQ(0u, victim.run_count, "run count victim");
+    EXPECT_TRUE(check_task_order(tasks, log, log_count));
+
+    size_t expected_count = 0u;
+    for (size_t i = 0; i < num_tasks; i++) {
+        uint32_t expected_runs = canceled(i) && !reposted(i) ? 0u : 1u;
+        EXPECT_EQ(expected_runs, tasks[i]->run_count, "run count");
+        expected_count += expected_runs;
+        // Tasks which ran can no longer be canceled.
+        if (expected_runs) {
+            EXPECT_EQ(ZX_ERR_NOT_FOUND, tasks[i]->op.Cancel(loop.async()), "cancel after run");
+        }
+    }
+    EXPECT_EQ(expected_count, log_count, "tasks run");
+
+    loop.Shutdown();
+    for (size_t i = 0; i < num_tasks; i++) {
+        delete tasks[i];
+    }
+
+    END_TEST;
+}
+
 bool receiver_test() {
     const zx_packet_user_t data1{.u64 = {11, 12, 13, 14}};
     const zx_packet_user_t data2{.u64 = {21, 22, 23, 24}};
@@ -954,6 +1125,8 @@ RUN_TEST(wait_shutdown_test)
 RUN_TEST(wait_method_test)
 RUN_TEST(task_test)
 RUN_TEST(task_shutdown_test)
+RUN_TEST(task_order_test)
+RUN_TEST(task_cancel_order_test)
 RUN_TEST(receiver_test)
 RUN_TEST(receiver_shutdown_test)
 RUN_TEST(threads_have_default_dispatcher)
@@ -0,0 +1,216 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <bitmap/hierarchical-bitmap.h>
+#include <bitmap/raw-bitmap.h>
+#include <bitmap/storage.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <zircon/syscalls.h>
+#include <fbl/algorithm.h>
+#include <unittest/unittest.h>
+
+namespace bitmap {
+namespace tests {
+
+using Raw = RawBitmapGeneric<DefaultStorage>;
+using Hierarchical = HierarchicalBitmapGeneric<DefaultStorage>;
+
+// Sets up |raw| and |hier| identically: |size| bits, all set except for
+// roughly one in |free_ratio| bits chosen at random.
+static bool FillNearlyFull(Raw* raw, Hierarchical* hier, size_t size, size_t free_ratio,
+                           unsigned int* seed) {
+    BEGIN_HELPER;
+    ASSERT_EQ(raw->Reset(size), ZX_OK);
+    ASSERT_EQ(hier->Reset(size), ZX_OK);
+    ASSERT_EQ(raw->Set(0, size), ZX_OK);
+    ASSERT_EQ(hier->Set(0, size), ZX_OK);
+    for (size_t i = 0; i < size / free_ratio; i++) {
+        size_t bit = rand_r(seed) % size;
+        ASSERT_EQ(raw->ClearOne(bit), ZX_OK);
+        ASSERT_EQ(hier->ClearOne(bit), ZX_OK);
+    }
+    END_HELPER;
+}
+
+static bool MatchesRawBitmap(void) {
+    BEGIN_TEST;
+
+    // Deliberately not a multiple of the word size, and large enough to need
+    // more than one level of summary.
+    constexpr size_t kSize = (1 << 18) + 37;
+    unsigned int seed = static_cast<unsigned int>(zx_ticks_get());
+    unittest_printf("seed: %u\n", seed);
+
+    Raw raw;
+    Hierarchical hier;
+    ASSERT_TRUE(FillNearlyFull(&raw, &hier, kSize, 64, &seed));
+
+    for (size_t i = 0; i < 2000; i++) {
+        size_t bitoff = rand_r(&seed) % kSize;
+        size_t bitmax = bitoff + rand_r(&seed) % (kSize - bitoff) + 1;
+        switch (rand_r(&seed) % 4) {
+        case 0:
+            EXPECT_EQ(raw.Set(bitoff, bitmax), hier.Set(bitoff, bitmax));
+            break;
+        case 1:
+            // Keep cleared ranges short so the map stays mostly full.
+            bitmax = fbl::min(bitmax, bitoff + rand_r(&seed) % 512);
+            EXPECT_EQ(raw.Clear(bitoff, bitmax), hier.Clear(bitoff, bitmax));
+            break;
+        default:
+            break;
+        }
+
+        bool is_set = rand_r(&seed) % 2;
+        EXPECT_EQ(raw.Scan(bitoff, bitmax, is_set), hier.Scan(bitoff, bitmax, is_set));
+
+        size_t run_len = 1 + rand_r(&seed) % 128;
+        size_t raw_out, hier_out;
+        EXPECT_EQ(raw.Find(is_set, bitoff, bitmax, run_len, &raw_out),
+                  hier.Find(is_set, bitoff, bitmax, run_len, &hier_out));
+        EXPECT_EQ(raw_out, hier_out);
+    }
+
+    END_TEST;
+}
+
+static bool RebuildSummary(void) {
+    BEGIN_TEST;
+
+    constexpr size_t kSize = 1 << 16;
+    Hierarchical bitmap;
+    ASSERT_EQ(bitmap.Reset(kSize), ZX_OK);
+
+    // Fill the storage behind the bitmap's back, leaving one bit clear.
+    void* data = const_cast<void*>(bitmap.StorageUnsafe()->GetData());
+    memset(data, 0xff, kSize / 8);
+    static_cast<size_t*>(data)[kSize / kBits / 2] &= ~static_cast<size_t>(1);
+    bitmap.RebuildSummary();
+
+    size_t out;
+    EXPECT_EQ(bitmap.Find(false, 0, kSize, 1, &out), ZX_OK);
+    EXPECT_EQ(out, kSize / 2);
+    EXPECT_EQ(bitmap.Find(false, 0, kSize, 2, &out), ZX_ERR_NO_RESOURCES);
+    EXPECT_EQ(bitmap.Scan(0, kSize, true), kSize / 2);
+
+    END_TEST;
+}
+
+// Shrinking must leave the summaries describing only the bits that remain,
+// however the bits past the new end were set.
+static bool ShrinkThenFind(void) {
+    BEGIN_TEST;
+
+    constexpr size_t kSize = (1 << 18) + 37;
+    const size_t kNewSizes[] = {kSize - 1, (1 << 12) + 5, kBits * kBits, kBits + 1, kBits, 3};
+    unsigned int seed = static_cast<unsigned int>(zx_ticks_get());
+    unittest_printf("seed: %u\n", seed);
+
+    for (size_t new_size : kNewSizes) {
+        Raw raw;
+        Hierarchical hier;
+        ASSERT_TRUE(FillNearlyFull(&raw, &hier, kSize, 64, &seed));
+
+        // Leave only the bits past the new end clear.
+        ASSERT_EQ(raw.Set(0, new_size), ZX_OK);
+        ASSERT_EQ(hier.Set(0, new_size), ZX_OK);
+        ASSERT_EQ(raw.Shrink(new_size), ZX_OK);
+        ASSERT_EQ(hier.Shrink(new_size), ZX_OK);
+        EXPECT_EQ(hier.size(), new_size);
+
+        size_t out;
+        EXPECT_EQ(hier.Find(false, 0, new_size, 1, &out), ZX_ERR_NO_RESOURCES);
+        EXPECT_EQ(out, new_size);
+        EXPECT_EQ(hier.Scan(0, kSize, true), new_size);
+        EXPECT_TRUE(hier.Get(0, kSize));
+
+        // A bit cleared just before the new end is still found.
+        size_t bit = new_size - 1 - rand_r(&seed) % fbl::min(new_size, static_cast<size_t>(100));
+        ASSERT_EQ(raw.ClearOne(bit), ZX_OK);
+        ASSERT_EQ(hier.ClearOne(bit), ZX_OK);
+        EXPECT_EQ(hier.Find(false, 0, new_size, 1, &out), ZX_OK);
+        EXPECT_EQ(out, bit);
+        EXPECT_EQ(hier.Find(false, 0, new_size, 2, &out), ZX_ERR_NO_RESOURCES);
+
+        // And the two still agree after further changes.
+        ASSERT_EQ(raw.Clear(0, new_size), ZX_OK);
+        ASSERT_EQ(hier.Clear(0, new_size), ZX_OK);
+        for (size_t i = 0; i < 200; i++) {
+            size_t bitoff = rand_r(&seed) % new_size;
+            size_t bitmax = bitoff + rand_r(&seed) % (new_size - bitoff) + 1;
+            if (rand_r(&seed) % 2) {
+                EXPECT_EQ(raw.Set(bitoff, bitmax), hier.Set(bitoff, bitmax));
+            } else {
+                EXPECT_EQ(raw.Clear(bitoff, bitmax), hier.Clear(bitoff, bitmax));
+            }
+            bool is_set = rand_r(&seed) % 2;
+            EXPECT_EQ(raw.Scan(0, kSize, is_set), hier.Scan(0, kSize, is_set));
+            size_t raw_out, hier_out;
+            EXPECT_EQ(raw.Find(is_set, 0, new_size, 1, &raw_out),
+                      hier.Find(is_set, 0, new_size, 1, &hier_out));
+            EXPECT_EQ(raw_out, hier_out);
+        }
+    }
+
+    END_TEST;
+}
+
+// Simulates an allocator walking a nearly-full 1M-bit map: each iteration
+// finds the next free bit after the previous allocation, wrapping at the end.
+template <typename BitmapType>
+static uint64_t TimeAllocations(BitmapType* bitmap, size_t count) {
+    size_t hint = 0;
+    uint64_t start = zx_ticks_get();
+    for (size_t i = 0; i < count; i++) {
+        size_t out;
+        if (bitmap->Find(false, hint, bitmap->size(), 1, &out) != ZX_OK &&
+            bitmap->Find(false, 0, bitmap->size(), 1, &out) != ZX_OK) {
+            break;
+        }
+        bitmap->SetOne(out);
+        hint = out;
+    }
+    return zx_ticks_get() - start;
+}
+
+static bool FindNearlyFullBenchmark(void) {
+    BEGIN_TEST;
+
+    constexpr size_t kSize = 1 << 20;
+    constexpr size_t kAllocations = 1000;
+    constexpr size_t kFreeRatios[] = {64, 1024, 16384};
+    unsigned int seed = 0;
+    uint64_t ticks_per_usec = zx_ticks_per_second() / 1000000;
+
+    for (size_t free_ratio : kFreeRatios) {
+        Raw raw;
+        Hierarchical hier;
+        ASSERT_TRUE(FillNearlyFull(&raw, &hier, kSize, free_ratio, &seed));
+
+        uint64_t raw_ticks = TimeAllocations(&raw, kAllocations);
+        uint64_t hier_ticks = TimeAllocations(&hier, kAllocations);
+        printf("\n1/%-5zu free: raw %8lu usec, hierarchical %8lu usec",
+               free_ratio, raw_ticks / ticks_per_usec, hier_ticks / ticks_per_usec);
+
+        // Both should have made identical choices.
+        EXPECT_EQ(raw.Scan(0, kSize, true), hier.Scan(0, kSize, true));
+    }
+    printf("\n");
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(hierarchical_bitmap_tests)
+RUN_TEST(MatchesRawBitmap)
+RUN_TEST(RebuildSummary)
+RUN_TEST(ShrinkThenFind)
+RUN_TEST_PERFORMANCE(FindNearlyFullBenchmark)
+END_TEST_CASE(hierarchical_bitmap_tests);
+
+} // namespace tests
+} // namespace bitmap
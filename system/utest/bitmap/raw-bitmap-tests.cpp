@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <bitmap/hierarchical-bitmap.h>
 #include <bitmap/raw-bitmap.h>
 #include <bitmap/storage.h>
 
@@ -458,9 +459,14 @@ static bool GrowFailure(void) {
 BEGIN_TEST_CASE(raw_bitmap_tests)
 ALL_TESTS(RawBitmapGeneric<DefaultStorage>)
 ALL_TESTS(RawBitmapGeneric<VmoStorage>)
+ALL_TESTS(HierarchicalBitmapGeneric<DefaultStorage>)
+ALL_TESTS(HierarchicalBitmapGeneric<VmoStorage>)
 RUN_TEST(GrowAcrossPage<RawBitmapGeneric<VmoStorage>>)
+RUN_TEST(GrowAcrossPage<HierarchicalBitmapGeneric<VmoStorage>>)
 RUN_TEST(GrowShrink<RawBitmapGeneric<VmoStorage>>)
+RUN_TEST(GrowShrink<HierarchicalBitmapGeneric<VmoStorage>>)
 RUN_TEST(GrowFailure<RawBitmapGeneric<DefaultStorage>>)
+RUN_TEST(GrowFailure<HierarchicalBitmapGeneric<DefaultStorage>>)
 END_TEST_CASE(raw_bitmap_tests);
 
 } // namespace tests
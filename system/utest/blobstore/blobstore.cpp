@@ -19,6 +19,8 @@
 #include <unistd.h>
 #include <utime.h>
 
+#include <blobstore/common.h>
+#include <blobstore/compression.h>
 #include <blobstore/format.h>
 #include <digest/digest.h>
 #include <digest/merkle-tree.h>
@@ -349,7 +351,8 @@ typedef struct blob_info {
 
 // Creates, writes, reads (to verify) and operates on a blob.
 // Returns the result of the post-processing 'func' (true == success).
-static bool GenerateBlob(size_t size_data, fbl::unique_ptr<blob_info_t>* out) {
+static bool GenerateBlob(size_t size_data, fbl::unique_ptr<blob_info_t>* out,
+                         bool compressible = false) {
     // Generate a Blob of random data
     fbl::AllocChecker ac;
     fbl::unique_ptr<blob_info_t> info(new (&ac) blob_info_t);
@@ -358,8 +361,14 @@ static bool GenerateBlob(size_t size_data, fbl::unique_ptr<blob_info_t>* out) {
     EXPECT_EQ(ac.check(), true);
     static unsigned int seed = static_cast<unsigned int>(zx_ticks_get());
 
+    // Compressible data repeats every other run of random bytes.
+    constexpr size_t kRun = 32;
     for (size_t i = 0; i < size_data; i++) {
-        info->data[i] = (char)rand_r(&seed);
+        if (compressible && (i / kRun) % 2 == 1) {
+            info->data[i] = info->data[i - kRun];
+        } else {
+            info->data[i] = (char)rand_r(&seed);
+        }
     }
     info->size_data = size_data;
 
@@ -476,6 +485,204 @@ static bool TestMmap(void) {
     END_TEST;
 }
 
+// Reads a freshly opened blob in scattered, unaligned pieces, back to front,
+// so that blocks are loaded and verified out of order.
+template <fs_test_type_t TestType>
+static bool TestPartialReads(void) {
+    BEGIN_TEST;
+    test_info_t test_info;
+    ASSERT_EQ(StartBlobstoreTest<TestType>(&test_info), 0, "Mounting Blobstore");
+
+    fbl::unique_ptr<blob_info_t> info;
+    ASSERT_TRUE(GenerateBlob(1 << 20, &info));
+    int fd;
+    ASSERT_TRUE(MakeBlob(info->path, info->merkle.get(), info->size_merkle,
+                         info->data.get(), info->size_data, &fd));
+    ASSERT_EQ(close(fd), 0);
+    fd = open(info->path, O_RDONLY);
+    ASSERT_GT(fd, 0, "Failed to-reopen blob");
+
+    constexpr size_t kChunk = 3 * blobstore::kBlobstoreBlockSize + 17;
+    char buf[kChunk];
+    size_t off = info->size_data;
+    while (off > 0) {
+        size_t len = fbl::min(kChunk, off);
+        off -= len;
+        ASSERT_EQ(pread(fd, buf, len, off), static_cast<ssize_t>(len));
+        ASSERT_EQ(memcmp(buf, &info->data[off], len), 0, "Read data, but it was bad");
+        // Skip ahead to a spot which may or may not already be loaded.
+        size_t skip = (off * 7) % info->size_data;
+        len = fbl::min(kChunk, info->size_data - skip);
+        ASSERT_EQ(pread(fd, buf, len, skip), static_cast<ssize_t>(len));
+        ASSERT_EQ(memcmp(buf, &info->data[skip], len), 0, "Read data, but it was bad");
+    }
+
+    ASSERT_EQ(close(fd), 0);
+    ASSERT_EQ(unlink(info->path), 0);
+    ASSERT_EQ(EndBlobstoreTest<TestType>(&test_info), 0, "unmounting blobstore");
+    END_TEST;
+}
+
+// Writes |info| straight onto the unmounted blobstore at |ramdisk_path|,
+// compressed and laid out as the host tool lays out blobs added with
+// --compress. The blob's contents are taken from |data|, which may differ
+// from |info->data| to simulate corruption.
+static bool WriteCompressedBlob(const char* ramdisk_path, const blob_info_t* info,
+                                const char* data) {
+    BEGIN_HELPER;
+    constexpr size_t kBlockSize = blobstore::kBlobstoreBlockSize;
+    fbl::unique_fd fd(open(ramdisk_path, O_RDWR));
+    ASSERT_TRUE(fd, "Could not open ramdisk");
+
+    char block[kBlockSize];
+    ASSERT_EQ(pread(fd.get(), block, kBlockSize, 0), static_cast<ssize_t>(kBlockSize));
+    blobstore::blobstore_info_t sb;
+    memcpy(&sb, block, sizeof(sb));
+
+    fbl::AllocChecker ac;
+    size_t max = blobstore::CompressionBound(info->size_data);
+    fbl::unique_ptr<char[]> compressed(new (&ac) char[max]);
+    ASSERT_TRUE(ac.check());
+    size_t compressed_len;
+    ASSERT_EQ(blobstore::Compress(data, info->size_data, compressed.get(), max,
+                                  &compressed_len), ZX_OK);
+
+    blobstore::blobstore_inode_t inode;
+    memset(&inode, 0, sizeof(inode));
+    Digest digest;
+    const char* name = info->path + strlen(MOUNT_PATH "/");
+    ASSERT_EQ(digest.Parse(name, strlen(name)), ZX_OK);
+    ASSERT_EQ(digest.CopyTo(inode.merkle_root_hash, sizeof(inode.merkle_root_hash)), ZX_OK);
+    inode.blob_size = info->size_data;
+    inode.flags = blobstore::kBlobstoreInodeFlagLZ4Compressed;
+    size_t merkle_blocks = blobstore::MerkleTreeBlocks(inode);
+    inode.num_blocks = merkle_blocks + fbl::round_up(compressed_len, kBlockSize) / kBlockSize;
+
+    // Take the first free run of blocks; this only looks at the first block
+    // of the block map, which is plenty for a test ramdisk.
+    off_t map_off = blobstore::BlockMapStartBlock(sb) * kBlockSize;
+    ASSERT_EQ(pread(fd.get(), block, kBlockSize, map_off), static_cast<ssize_t>(kBlockSize));
+    auto allocated = [&block](size_t b) { return (block[b / 8] >> (b % 8)) & 1; };
+    inode.start_block = blobstore::kStartBlockMinimum;
+    while (allocated(inode.start_block)) {
+        inode.start_block++;
+    }
+    ASSERT_LE(inode.start_block + inode.num_blocks, blobstore::kBlobstoreBlockBits);
+    ASSERT_LE(inode.start_block + inode.num_blocks, blobstore::DataBlocks(sb));
+    for (size_t b = inode.start_block; b < inode.start_block + inode.num_blocks; b++) {
+        ASSERT_FALSE(allocated(b));
+        block[b / 8] = static_cast<char>(block[b / 8] | (1 << (b % 8)));
+    }
+    ASSERT_EQ(pwrite(fd.get(), block, kBlockSize, map_off), static_cast<ssize_t>(kBlockSize));
+
+    // The Merkle tree, then the compressed data, each padded to a block.
+    size_t len = inode.num_blocks * kBlockSize;
+    fbl::unique_ptr<char[]> blocks(new (&ac) char[len]);
+    ASSERT_TRUE(ac.check());
+    memset(blocks.get(), 0, len);
+    memcpy(blocks.get(), info->merkle.get(), info->size_merkle);
+    memcpy(blocks.get() + merkle_blocks * kBlockSize, compressed.get(), compressed_len);
+    off_t data_off = (blobstore::DataStartBlock(sb) + inode.start_block) * kBlockSize;
+    ASSERT_EQ(pwrite(fd.get(), blocks.get(), len, data_off), static_cast<ssize_t>(len));
+
+    off_t node_off = blobstore::NodeMapStartBlock(sb) * kBlockSize;
+    ASSERT_EQ(pread(fd.get(), block, kBlockSize, node_off), static_cast<ssize_t>(kBlockSize));
+    blobstore::blobstore_inode_t* nodes = reinterpret_cast<blobstore::blobstore_inode_t*>(block);
+    size_t node = 0;
+    while (nodes[node].start_block != blobstore::kStartBlockFree) {
+        node++;
+        ASSERT_LT(node, blobstore::kBlobstoreInodesPerBlock);
+    }
+    nodes[node] = inode;
+    ASSERT_EQ(pwrite(fd.get(), block, kBlockSize, node_off), static_cast<ssize_t>(kBlockSize));
+
+    ASSERT_EQ(pread(fd.get(), block, kBlockSize, 0), static_cast<ssize_t>(kBlockSize));
+    sb.alloc_block_count += inode.num_blocks;
+    sb.alloc_inode_count++;
+    memcpy(block, &sb, sizeof(sb));
+    ASSERT_EQ(pwrite(fd.get(), block, kBlockSize, 0), static_cast<ssize_t>(kBlockSize));
+    END_HELPER;
+}
+
+// Stores blobs compressed, as the host tool does, and checks that they read
+// back intact, one LZ4 block at a time, through a mounted blobstore.
+template <fs_test_type_t TestType>
+static bool TestCompressedBlob(void) {
+    BEGIN_TEST;
+    // Blobs are written straight into the data blocks set up by mkfs, which
+    // an FVM partition only has a slice of.
+    ASSERT_EQ(TestType, FS_TEST_NORMAL);
+    test_info_t test_info;
+    ASSERT_EQ(StartBlobstoreTest<TestType>(&test_info), 0, "Mounting Blobstore");
+    ASSERT_EQ(umount(MOUNT_PATH), ZX_OK, "Could not unmount blobstore");
+
+    constexpr size_t kLZ4BlockSize = blobstore::kBlobstoreLZ4BlockSize;
+    constexpr size_t kBlobs = 2;
+    fbl::unique_ptr<blob_info_t> info[kBlobs];
+    ASSERT_TRUE(GenerateBlob((1 << 20) + 4321, &info[0], true));
+    // LZ4 stores incompressible blocks as they are.
+    ASSERT_TRUE(GenerateBlob(3 * kLZ4BlockSize + 17, &info[1]));
+    for (size_t i = 0; i < kBlobs; i++) {
+        ASSERT_TRUE(WriteCompressedBlob(test_info.ramdisk_path, info[i].get(),
+                                        info[i]->data.get()));
+    }
+
+    // This one is stored with a byte of one LZ4 block changed, so that the
+    // block decompresses but no longer matches the Merkle tree.
+    constexpr size_t kCorruptBlock = 9;
+    fbl::unique_ptr<blob_info_t> corrupt;
+    ASSERT_TRUE(GenerateBlob(1 << 20, &corrupt, true));
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<char[]> corrupt_data(new (&ac) char[corrupt->size_data]);
+    ASSERT_TRUE(ac.check());
+    memcpy(corrupt_data.get(), corrupt->data.get(), corrupt->size_data);
+    corrupt_data[kCorruptBlock * kLZ4BlockSize + 5] ^= 1;
+    ASSERT_TRUE(WriteCompressedBlob(test_info.ramdisk_path, corrupt.get(), corrupt_data.get()));
+
+    ASSERT_EQ(MountBlobstore(test_info.ramdisk_path), 0, "Could not re-mount blobstore");
+
+    constexpr size_t kChunk = 17;
+    char buf[blobstore::kBlobstoreBlockSize];
+    for (size_t i = 0; i < kBlobs; i++) {
+        int fd = open(info[i]->path, O_RDONLY);
+        ASSERT_GT(fd, 0, "Failed to open compressed blob");
+
+        // Read across the ends of LZ4 blocks, back to front, before reading
+        // the whole blob.
+        size_t off = fbl::round_up(info[i]->size_data, kLZ4BlockSize);
+        while (off > 0) {
+            off -= kLZ4BlockSize;
+            size_t start = off > kChunk / 2 ? off - kChunk / 2 : 0;
+            size_t len = fbl::min(kChunk, info[i]->size_data - start);
+            ASSERT_EQ(pread(fd, buf, len, start), static_cast<ssize_t>(len));
+            ASSERT_EQ(memcmp(buf, &info[i]->data[start], len), 0, "Read data, but it was bad");
+        }
+        ASSERT_TRUE(VerifyContents(fd, info[i]->data.get(), info[i]->size_data));
+
+        void* addr = mmap(NULL, info[i]->size_data, PROT_READ, MAP_SHARED, fd, 0);
+        ASSERT_NE(addr, MAP_FAILED, "Could not mmap blob");
+        ASSERT_EQ(memcmp(addr, info[i]->data.get(), info[i]->size_data), 0, "Mmap data invalid");
+        ASSERT_EQ(munmap(addr, info[i]->size_data), 0, "Could not unmap blob");
+        ASSERT_EQ(close(fd), 0);
+    }
+
+    // Blocks away from the corrupt one can still be read.
+    int fd = open(corrupt->path, O_RDONLY);
+    ASSERT_GT(fd, 0, "Failed to open compressed blob");
+    ASSERT_EQ(pread(fd, buf, sizeof(buf), 0), static_cast<ssize_t>(sizeof(buf)));
+    ASSERT_EQ(memcmp(buf, corrupt->data.get(), sizeof(buf)), 0, "Read data, but it was bad");
+    ASSERT_LT(pread(fd, buf, sizeof(buf), kCorruptBlock * kLZ4BlockSize), 0,
+              "Expected reading to fail");
+    ASSERT_EQ(close(fd), 0);
+
+    for (size_t i = 0; i < kBlobs; i++) {
+        ASSERT_EQ(unlink(info[i]->path), 0);
+    }
+    ASSERT_EQ(unlink(corrupt->path), 0);
+    ASSERT_EQ(EndBlobstoreTest<TestType>(&test_info), 0, "unmounting blobstore");
+    END_TEST;
+}
+
 template <fs_test_type_t TestType>
 static bool TestReaddir(void) {
     BEGIN_TEST;
@@ -1598,6 +1805,8 @@ static bool CorruptAtMount(void) {
 BEGIN_TEST_CASE(blobstore_tests)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, TestBasic)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, TestMmap)
+RUN_TEST_FOR_ALL_TYPES(MEDIUM, TestPartialReads)
+RUN_TEST_MEDIUM(TestCompressedBlob<FS_TEST_NORMAL>)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, TestReaddir)
 RUN_TEST_MEDIUM(TestQueryInfo<FS_TEST_FVM>)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, UseAfterUnlink)
@@ -22,6 +22,7 @@ MODULE_STATIC_LIBS := \
     system/ulib/fbl \
     system/ulib/blobstore \
     third_party/ulib/uboringssl \
+    third_party/ulib/lz4 \
 
 MODULE_LIBS := \
     system/ulib/fdio \
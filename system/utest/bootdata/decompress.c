@@ -0,0 +1,508 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bootdata/decompress.h>
+#include <lz4/lz4.h>
+#include <zircon/boot/bootdata.h>
+#include <zircon/compiler.h>
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+#include <unittest/unittest.h>
+
+#define BLOCK_SIZE BOOTDATA_LZ4_BLOCK_SIZE
+
+// Four full blocks and a short one.
+#define DATA_SIZE (4 * BLOCK_SIZE + 1000)
+#define DATA_BLOCKS 5
+#define DATA_VMO_SIZE ((DATA_SIZE + 4095) & ~4095)
+
+// This block is random, so it is stored uncompressed.
+#define RAW_BLOCK 2
+
+// The item follows the container header.
+#define ITEM_OFFSET sizeof(bootdata_t)
+#define PAYLOAD_OFFSET (ITEM_OFFSET + sizeof(bootdata_t))
+
+// A container holding one compressed bootfs item with a block index, laid
+// out the way mkbootfs writes it.
+typedef struct {
+    uint8_t* buf;
+    size_t len;
+    // Of the item, including its header.
+    size_t item_len;
+    // Offsets in buf of the index frame and of its trailer.
+    size_t frame;
+    size_t trailer;
+} test_item_t;
+
+static uint8_t data[DATA_SIZE];
+
+static void put_le32(uint8_t* p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static void make_data(void) {
+    uint32_t x = 0x12345678;
+    for (size_t i = 0; i < DATA_SIZE; i++) {
+        if (i / BLOCK_SIZE == RAW_BLOCK) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            data[i] = x;
+        } else {
+            // Compressible, and never zero.
+            data[i] = "bootfs"[i % 6] + (i / 4096) % 16;
+        }
+    }
+}
+
+static bool is_zero(const uint8_t* p, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool build_item(test_item_t* item) {
+    BEGIN_HELPER;
+
+    make_data();
+    size_t max = PAYLOAD_OFFSET + 4 + 11 +
+                 DATA_BLOCKS * (4 + LZ4_compressBound(BLOCK_SIZE)) + 4 +
+                 8 + DATA_BLOCKS * 4 + sizeof(bootdata_lz4_index_t) + 8;
+    item->buf = calloc(1, max);
+    ASSERT_TRUE(item->buf != NULL, "");
+    uint8_t* payload = item->buf + PAYLOAD_OFFSET;
+
+    // The frame header: independent blocks of at most 64k and the content
+    // size, which the header checksum (not checked) covers.
+    size_t pos = 0;
+    put_le32(payload, 0x184D2204);
+    pos += 4;
+    payload[pos++] = 0x68;
+    payload[pos++] = 0x40;
+    put_le32(payload + pos, DATA_SIZE);
+    put_le32(payload + pos + 4, 0);
+    pos += 8;
+    payload[pos++] = 0;
+
+    uint32_t offsets[DATA_BLOCKS];
+    for (size_t i = 0; i < DATA_BLOCKS; i++) {
+        const uint8_t* src = data + i * BLOCK_SIZE;
+        int len = (i == DATA_BLOCKS - 1) ? DATA_SIZE - i * BLOCK_SIZE : BLOCK_SIZE;
+        offsets[i] = pos;
+        int n = LZ4_compress_default((const char*)src, (char*)payload + pos + 4,
+                                     len, LZ4_compressBound(len));
+        ASSERT_GT(n, 0, "compress block");
+        if (n >= len) {
+            // The high bit of the size marks an uncompressed block.
+            memcpy(payload + pos + 4, src, len);
+            put_le32(payload + pos, 0x80000000 | len);
+            n = len;
+        } else {
+            ASSERT_NE(i, (size_t)RAW_BLOCK, "random block compressed");
+            put_le32(payload + pos, n);
+        }
+        pos += 4 + n;
+    }
+    put_le32(payload + pos, 0);
+    pos += 4;
+
+    item->frame = PAYLOAD_OFFSET + pos;
+    put_le32(payload + pos, BOOTDATA_LZ4_INDEX_FRAME);
+    put_le32(payload + pos + 4, DATA_BLOCKS * 4 + sizeof(bootdata_lz4_index_t));
+    pos += 8;
+    for (size_t i = 0; i < DATA_BLOCKS; i++) {
+        put_le32(payload + pos, offsets[i]);
+        pos += 4;
+    }
+    item->trailer = PAYLOAD_OFFSET + pos;
+    put_le32(payload + pos, DATA_BLOCKS);
+    put_le32(payload + pos + 4, BOOTDATA_LZ4_INDEX_MAGIC);
+    pos += sizeof(bootdata_lz4_index_t);
+
+    bootdata_t* hdr = (bootdata_t*)(item->buf + ITEM_OFFSET);
+    hdr->type = BOOTDATA_BOOTFS_BOOT;
+    hdr->length = pos;
+    hdr->extra = DATA_SIZE;
+    hdr->flags = BOOTDATA_FLAG_V2 | BOOTDATA_BOOTFS_FLAG_COMPRESSED;
+    hdr->magic = BOOTITEM_MAGIC;
+    hdr->crc32 = BOOTITEM_NO_CRC32;
+    item->item_len = sizeof(bootdata_t) + pos;
+
+    bootdata_t* container = (bootdata_t*)item->buf;
+    container->type = BOOTDATA_CONTAINER;
+    container->length = BOOTDATA_ALIGN(item->item_len);
+    container->extra = BOOTDATA_MAGIC;
+    container->flags = BOOTDATA_FLAG_V2;
+    container->magic = BOOTITEM_MAGIC;
+    container->crc32 = BOOTITEM_NO_CRC32;
+    item->len = ITEM_OFFSET + BOOTDATA_ALIGN(item->item_len);
+
+    END_HELPER;
+}
+
+static bool item_vmo(const test_item_t* item, zx_handle_t* vmo) {
+    BEGIN_HELPER;
+    ASSERT_EQ(zx_vmo_create(item->len, 0, vmo), ZX_OK, "");
+    size_t actual;
+    ASSERT_EQ(zx_vmo_write(*vmo, item->buf, 0, item->len, &actual), ZX_OK, "");
+    ASSERT_EQ(actual, item->len, "");
+    END_HELPER;
+}
+
+// Checks that each block of |dst| is either decompressed, if its bit is
+// set in |filled|, or untouched.
+static bool check_blocks(zx_handle_t dst, uint32_t filled) {
+    BEGIN_HELPER;
+
+    uint64_t size;
+    ASSERT_EQ(zx_vmo_get_size(dst, &size), ZX_OK, "");
+    ASSERT_EQ(size, (uint64_t)DATA_VMO_SIZE, "decompressed vmo size");
+    uint8_t* buf = malloc(DATA_VMO_SIZE);
+    ASSERT_TRUE(buf != NULL, "");
+    size_t actual;
+    zx_status_t status = zx_vmo_read(dst, buf, 0, DATA_VMO_SIZE, &actual);
+
+    bool ok = (status == ZX_OK) && (actual == DATA_VMO_SIZE);
+    for (size_t i = 0; ok && (i < DATA_BLOCKS); i++) {
+        size_t off = i * BLOCK_SIZE;
+        size_t len = (i == DATA_BLOCKS - 1) ? DATA_SIZE - off : BLOCK_SIZE;
+        if (filled & (1u << i)) {
+            EXPECT_EQ(memcmp(buf + off, data + off, len), 0, "block not decompressed");
+        } else {
+            EXPECT_TRUE(is_zero(buf + off, len), "block decompressed");
+        }
+    }
+    if (ok) {
+        EXPECT_TRUE(is_zero(buf + DATA_SIZE, DATA_VMO_SIZE - DATA_SIZE), "tail not zero");
+    }
+    free(buf);
+    ASSERT_TRUE(ok, "read decompressed vmo");
+
+    END_HELPER;
+}
+
+static bool lazy_fill_partial_test(void) {
+    BEGIN_TEST;
+
+    test_item_t item;
+    ASSERT_TRUE(build_item(&item), "");
+    zx_handle_t vmo;
+    ASSERT_TRUE(item_vmo(&item, &vmo), "");
+
+    bootdata_lazy_t lz;
+    zx_handle_t dst = ZX_HANDLE_INVALID;
+    const char* err;
+    ASSERT_EQ(bootdata_lazy_open(zx_vmar_root_self(), vmo, ITEM_OFFSET, item.item_len,
+                                 &dst, NULL, &lz, &err), ZX_OK, err);
+    EXPECT_TRUE(check_blocks(dst, 0), "nothing filled on open");
+
+    // Within one block.
+    EXPECT_EQ(bootdata_lazy_fill(&lz, BLOCK_SIZE + 10, 20, &err), ZX_OK, err);
+    EXPECT_TRUE(check_blocks(dst, 1u << 1), "");
+
+    // Across a block boundary, including the uncompressed block.
+    EXPECT_EQ(bootdata_lazy_fill(&lz, 3 * BLOCK_SIZE - 5, 10, &err), ZX_OK, err);
+    EXPECT_TRUE(check_blocks(dst, (1u << 1) | (1u << 2) | (1u << 3)), "");
+
+    // Empty, and past the end.
+    EXPECT_EQ(bootdata_lazy_fill(&lz, 0, 0, &err), ZX_OK, err);
+    EXPECT_EQ(bootdata_lazy_fill(&lz, DATA_SIZE, 10, &err), ZX_OK, err);
+    EXPECT_EQ(bootdata_lazy_fill(&lz, DATA_VMO_SIZE + 100, 10, &err), ZX_OK, err);
+    EXPECT_TRUE(check_blocks(dst, (1u << 1) | (1u << 2) | (1u << 3)), "");
+
+    // Running off the end is cut short.
+    EXPECT_EQ(bootdata_lazy_fill(&lz, DATA_SIZE - 10, BLOCK_SIZE, &err), ZX_OK, err);
+    EXPECT_TRUE(check_blocks(dst, 0x1eu), "");
+
+    // The rest, and then again, which is a no-op.
+    EXPECT_EQ(bootdata_lazy_fill_all(&lz, 2, &err), ZX_OK, err);
+    EXPECT_TRUE(check_blocks(dst, 0x1fu), "");
+    EXPECT_EQ(bootdata_lazy_fill(&lz, 0, DATA_SIZE, &err), ZX_OK, err);
+    EXPECT_EQ(bootdata_lazy_fill_all(&lz, 0, &err), ZX_OK, err);
+    EXPECT_TRUE(check_blocks(dst, 0x1fu), "");
+
+    bootdata_lazy_close(&lz);
+    EXPECT_EQ(zx_handle_close(dst), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK, "");
+    free(item.buf);
+
+    END_TEST;
+}
+
+// A second bootdata_lazy_open given the destination and map VMOs of the
+// first, as devmgr is given userboot's, skips the blocks already filled.
+static bool shared_map_test(void) {
+    BEGIN_TEST;
+
+    test_item_t item;
+    ASSERT_TRUE(build_item(&item), "");
+    zx_handle_t vmo;
+    ASSERT_TRUE(item_vmo(&item, &vmo), "");
+
+    bootdata_lazy_t lz;
+    zx_handle_t dst = ZX_HANDLE_INVALID;
+    zx_handle_t map = ZX_HANDLE_INVALID;
+    const char* err;
+    ASSERT_EQ(bootdata_lazy_open(zx_vmar_root_self(), vmo, ITEM_OFFSET, item.item_len,
+                                 &dst, &map, &lz, &err), ZX_OK, err);
+    ASSERT_NE(map, ZX_HANDLE_INVALID, "no map returned");
+    EXPECT_EQ(bootdata_lazy_fill(&lz, BLOCK_SIZE, 1, &err), ZX_OK, err);
+    EXPECT_EQ(bootdata_lazy_fill(&lz, 3 * BLOCK_SIZE, 1, &err), ZX_OK, err);
+    bootdata_lazy_close(&lz);
+
+    // Scribble on a filled block, which the second fill must leave alone.
+    const uint8_t scribble = 0;
+    size_t actual;
+    ASSERT_EQ(zx_vmo_write(dst, &scribble, BLOCK_SIZE, 1, &actual), ZX_OK, "");
+
+    zx_handle_t shared_map = map;
+    ASSERT_EQ(bootdata_lazy_open(zx_vmar_root_self(), vmo, ITEM_OFFSET, item.item_len,
+                                 &dst, &shared_map, &lz, &err), ZX_OK, err);
+    EXPECT_EQ(shared_map, map, "map replaced");
+    EXPECT_EQ(bootdata_lazy_fill_all(&lz, 2, &err), ZX_OK, err);
+    bootdata_lazy_close(&lz);
+
+    uint8_t c = 0xff;
+    EXPECT_EQ(zx_vmo_read(dst, &c, BLOCK_SIZE, 1, &actual), ZX_OK, "");
+    EXPECT_EQ(c, scribble, "filled block decompressed again");
+    ASSERT_EQ(zx_vmo_write(dst, &data[BLOCK_SIZE], BLOCK_SIZE, 1, &actual), ZX_OK, "");
+    EXPECT_TRUE(check_blocks(dst, 0x1fu), "");
+
+    // A map too small for the item is refused.
+    zx_handle_t small_map;
+    ASSERT_EQ(zx_vmo_create(0, 0, &small_map), ZX_OK, "");
+    EXPECT_EQ(bootdata_lazy_open(zx_vmar_root_self(), vmo, ITEM_OFFSET, item.item_len,
+                                 &dst, &small_map, &lz, &err), ZX_ERR_BUFFER_TOO_SMALL,
+              "small map accepted");
+
+    EXPECT_EQ(zx_handle_close(small_map), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(map), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(dst), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK, "");
+    free(item.buf);
+
+    END_TEST;
+}
+
+static bool parallel_matches_serial_test(void) {
+    BEGIN_TEST;
+
+    test_item_t item;
+    ASSERT_TRUE(build_item(&item), "");
+    zx_handle_t vmo;
+    ASSERT_TRUE(item_vmo(&item, &vmo), "");
+
+    const char* err;
+    zx_handle_t serial;
+    ASSERT_EQ(decompress_bootdata(zx_vmar_root_self(), vmo, ITEM_OFFSET, item.item_len,
+                                  &serial, &err), ZX_OK, err);
+    EXPECT_TRUE(check_blocks(serial, 0x1fu), "");
+    uint8_t* expected = malloc(DATA_VMO_SIZE);
+    uint8_t* actual = malloc(DATA_VMO_SIZE);
+    ASSERT_TRUE((expected != NULL) && (actual != NULL), "");
+    size_t n;
+    ASSERT_EQ(zx_vmo_read(serial, expected, 0, DATA_VMO_SIZE, &n), ZX_OK, "");
+
+    static const uint32_t thread_counts[] = { 0, 1, 3, DATA_BLOCKS, DATA_BLOCKS + 3 };
+    for (size_t i = 0; i < countof(thread_counts); i++) {
+        zx_handle_t parallel;
+        ASSERT_EQ(decompress_bootdata_parallel(zx_vmar_root_self(), vmo, ITEM_OFFSET,
+                                               item.item_len, thread_counts[i],
+                                               &parallel, &err), ZX_OK, err);
+        uint64_t size = 0;
+        EXPECT_EQ(zx_vmo_get_size(parallel, &size), ZX_OK, "");
+        EXPECT_EQ(size, (uint64_t)DATA_VMO_SIZE, "");
+        memset(actual, 0xff, DATA_VMO_SIZE);
+        EXPECT_EQ(zx_vmo_read(parallel, actual, 0, DATA_VMO_SIZE, &n), ZX_OK, "");
+        EXPECT_EQ(memcmp(expected, actual, DATA_VMO_SIZE), 0, "parallel differs from serial");
+        EXPECT_EQ(zx_handle_close(parallel), ZX_OK, "");
+    }
+
+    free(expected);
+    free(actual);
+    EXPECT_EQ(zx_handle_close(serial), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK, "");
+    free(item.buf);
+
+    END_TEST;
+}
+
+// Checks that the item in |item| is refused, both by bootdata_lazy_open and
+// by decompress_bootdata_parallel, and that neither returns a VMO.
+static bool check_rejected(const test_item_t* item, size_t item_len, zx_status_t expected) {
+    BEGIN_HELPER;
+
+    zx_handle_t vmo;
+    ASSERT_TRUE(item_vmo(item, &vmo), "");
+
+    bootdata_lazy_t lz;
+    zx_handle_t dst = ZX_HANDLE_INVALID;
+    const char* err;
+    EXPECT_EQ(bootdata_lazy_open(zx_vmar_root_self(), vmo, ITEM_OFFSET, item_len,
+                                 &dst, NULL, &lz, &err), expected, err);
+    EXPECT_EQ(dst, ZX_HANDLE_INVALID, "");
+    bootdata_lazy_close(&lz);
+
+    zx_handle_t out = ZX_HANDLE_INVALID;
+    EXPECT_EQ(decompress_bootdata_parallel(zx_vmar_root_self(), vmo, ITEM_OFFSET, item_len,
+                                           0, &out, &err), expected, err);
+    EXPECT_EQ(out, ZX_HANDLE_INVALID, "");
+
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK, "");
+
+    END_HELPER;
+}
+
+static bool truncated_index_test(void) {
+    BEGIN_TEST;
+
+    test_item_t item;
+    ASSERT_TRUE(build_item(&item), "");
+
+    // The item runs past the end of what is mapped.
+    EXPECT_TRUE(check_rejected(&item, item.item_len - 4, ZX_ERR_INVALID_ARGS), "short item");
+
+    // The last block offset is missing, so the index frame is shorter than
+    // the trailer says.
+    bootdata_t* hdr = (bootdata_t*)(item.buf + ITEM_OFFSET);
+    memmove(item.buf + item.trailer - 4, item.buf + item.trailer,
+            sizeof(bootdata_lz4_index_t));
+    put_le32(item.buf + item.frame + 4, (DATA_BLOCKS - 1) * 4 + sizeof(bootdata_lz4_index_t));
+    hdr->length -= 4;
+    EXPECT_TRUE(check_rejected(&item, item.item_len - 4, ZX_ERR_INVALID_ARGS),
+                "missing offset");
+    free(item.buf);
+
+    // The index frame does not start with the skippable frame magic.
+    ASSERT_TRUE(build_item(&item), "");
+    put_le32(item.buf + item.frame, BOOTDATA_LZ4_INDEX_FRAME + 1);
+    EXPECT_TRUE(check_rejected(&item, item.item_len, ZX_ERR_INVALID_ARGS), "frame magic");
+    free(item.buf);
+
+    // The index frame's size does not match its count.
+    ASSERT_TRUE(build_item(&item), "");
+    put_le32(item.buf + item.frame + 4, DATA_BLOCKS * 4);
+    EXPECT_TRUE(check_rejected(&item, item.item_len, ZX_ERR_INVALID_ARGS), "frame size");
+    free(item.buf);
+
+    END_TEST;
+}
+
+static bool wrong_count_test(void) {
+    BEGIN_TEST;
+
+    static const uint32_t counts[] = { 0, DATA_BLOCKS - 1, DATA_BLOCKS + 1, UINT32_MAX };
+    for (size_t i = 0; i < countof(counts); i++) {
+        test_item_t item;
+        ASSERT_TRUE(build_item(&item), "");
+        put_le32(item.buf + item.trailer, counts[i]);
+        EXPECT_TRUE(check_rejected(&item, item.item_len, ZX_ERR_INVALID_ARGS), "");
+        free(item.buf);
+    }
+
+    END_TEST;
+}
+
+static bool bad_trailer_magic_test(void) {
+    BEGIN_TEST;
+
+    test_item_t item;
+    ASSERT_TRUE(build_item(&item), "");
+    put_le32(item.buf + item.trailer + 4, BOOTDATA_LZ4_INDEX_MAGIC ^ 1);
+    zx_handle_t vmo;
+    ASSERT_TRUE(item_vmo(&item, &vmo), "");
+
+    // Without its magic, the index is not recognized at all...
+    bootdata_lazy_t lz;
+    zx_handle_t dst = ZX_HANDLE_INVALID;
+    const char* err;
+    EXPECT_EQ(bootdata_lazy_open(zx_vmar_root_self(), vmo, ITEM_OFFSET, item.item_len,
+                                 &dst, NULL, &lz, &err), ZX_ERR_NOT_SUPPORTED, err);
+    EXPECT_EQ(dst, ZX_HANDLE_INVALID, "");
+    bootdata_lazy_close(&lz);
+
+    // ...so the frame is decompressed by walking it.
+    zx_handle_t out = ZX_HANDLE_INVALID;
+    ASSERT_EQ(decompress_bootdata_parallel(zx_vmar_root_self(), vmo, ITEM_OFFSET,
+                                           item.item_len, 0, &out, &err), ZX_OK, err);
+    EXPECT_TRUE(check_blocks(out, 0x1fu), "");
+
+    EXPECT_EQ(zx_handle_close(out), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK, "");
+    free(item.buf);
+
+    END_TEST;
+}
+
+static bool out_of_range_offset_test(void) {
+    BEGIN_TEST;
+
+    // Offsets of the index frame, of a size word which would run into it,
+    // and of nothing at all.
+    test_item_t item;
+    ASSERT_TRUE(build_item(&item), "");
+    const uint32_t frame = item.frame - PAYLOAD_OFFSET;
+    free(item.buf);
+    const uint32_t offsets[] = { frame, frame - 2, frame + 8, UINT32_MAX };
+
+    for (size_t i = 0; i < countof(offsets); i++) {
+        ASSERT_TRUE(build_item(&item), "");
+        put_le32(item.buf + item.frame + 8 + 4 * 3, offsets[i]);
+        zx_handle_t vmo;
+        ASSERT_TRUE(item_vmo(&item, &vmo), "");
+
+        // The index is only checked block by block, as the blocks are needed.
+        bootdata_lazy_t lz;
+        zx_handle_t dst = ZX_HANDLE_INVALID;
+        const char* err;
+        ASSERT_EQ(bootdata_lazy_open(zx_vmar_root_self(), vmo, ITEM_OFFSET, item.item_len,
+                                     &dst, NULL, &lz, &err), ZX_OK, err);
+        EXPECT_EQ(bootdata_lazy_fill(&lz, 0, 3 * BLOCK_SIZE, &err), ZX_OK, err);
+        EXPECT_EQ(bootdata_lazy_fill(&lz, 4 * BLOCK_SIZE, 1, &err), ZX_OK, err);
+        EXPECT_EQ(bootdata_lazy_fill(&lz, 3 * BLOCK_SIZE + 1, 1, &err),
+                  ZX_ERR_INVALID_ARGS, "bad offset accepted");
+        EXPECT_EQ(bootdata_lazy_fill_all(&lz, 2, &err), ZX_ERR_INVALID_ARGS,
+                  "bad offset accepted");
+        EXPECT_TRUE(check_blocks(dst, 0x17u), "");
+        bootdata_lazy_close(&lz);
+        EXPECT_EQ(zx_handle_close(dst), ZX_OK, "");
+
+        zx_handle_t out = ZX_HANDLE_INVALID;
+        EXPECT_EQ(decompress_bootdata_parallel(zx_vmar_root_self(), vmo, ITEM_OFFSET,
+                                               item.item_len, 0, &out, &err),
+                  ZX_ERR_INVALID_ARGS, "bad offset accepted");
+        EXPECT_EQ(out, ZX_HANDLE_INVALID, "");
+
+        EXPECT_EQ(zx_handle_close(vmo), ZX_OK, "");
+        free(item.buf);
+    }
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(bootdata_decompress_tests)
+RUN_TEST(lazy_fill_partial_test)
+RUN_TEST(shared_map_test)
+RUN_TEST(parallel_matches_serial_test)
+RUN_TEST(truncated_index_test)
+RUN_TEST(wrong_count_test)
+RUN_TEST(bad_trailer_magic_test)
+RUN_TEST(out_of_range_offset_test)
+END_TEST_CASE(bootdata_decompress_tests)
+
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
@@ -0,0 +1,244 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <ddk/binding.h>
+#include <unittest/unittest.h>
+#include <zircon/listnode.h>
+
+#include "devcoordinator.h"
+
+// PROTO_1_ALIAS shares PROTO_1's bucket in the driver index.
+#define PROTO_1 0x10
+#define PROTO_1_ALIAS (PROTO_1 + DRIVER_INDEX_BUCKETS)
+#define PROTO_2 0x11
+#define PROTO_3 0x20
+#define PROTO_UNUSED 0x99
+
+static const zx_bind_inst_t proto1_binding[] = {
+    BI_ABORT_IF(NE, BIND_PROTOCOL, PROTO_1),
+    BI_MATCH(),
+};
+static const zx_bind_inst_t proto1_pci_binding[] = {
+    BI_ABORT_IF(NE, BIND_PROTOCOL, PROTO_1),
+    BI_ABORT_IF(NE, BIND_PCI_VID, 0x8086),
+    BI_MATCH(),
+};
+static const zx_bind_inst_t proto1_alias_binding[] = {
+    BI_ABORT_IF(NE, BIND_PROTOCOL, PROTO_1_ALIAS),
+    BI_MATCH(),
+};
+static const zx_bind_inst_t proto1_match_binding[] = {
+    BI_MATCH_IF(EQ, BIND_PROTOCOL, PROTO_1),
+};
+static const zx_bind_inst_t proto2_match_binding[] = {
+    BI_MATCH_IF(EQ, BIND_PROTOCOL, PROTO_2),
+};
+static const zx_bind_inst_t proto2_no_autobind_binding[] = {
+    BI_ABORT_IF_AUTOBIND,
+    BI_ABORT_IF(NE, BIND_PROTOCOL, PROTO_2),
+    BI_MATCH(),
+};
+static const zx_bind_inst_t proto3_binding[] = {
+    BI_ABORT_IF(NE, BIND_PROTOCOL, PROTO_3),
+    BI_MATCH(),
+};
+static const zx_bind_inst_t goto_binding[] = {
+    BI_GOTO_IF(EQ, BIND_PROTOCOL, PROTO_3, 1),
+    BI_ABORT(),
+    BI_LABEL(1),
+    BI_MATCH(),
+};
+static const zx_bind_inst_t range_binding[] = {
+    BI_ABORT_IF(LT, BIND_PROTOCOL, PROTO_2),
+    BI_MATCH_IF(EQ, BIND_PCI_DID, 0x1234),
+};
+static const zx_bind_inst_t any_binding[] = {
+    BI_MATCH(),
+};
+
+typedef struct {
+    const char* name;
+    const zx_bind_inst_t* binding;
+    uint32_t binding_size;
+    // added ahead of the drivers before it, as for "!" versions
+    bool first;
+} test_driver_t;
+
+#define TEST_DRIVER(name, binding, first) { name, binding, sizeof(binding), first }
+
+static const test_driver_t test_drivers[] = {
+    TEST_DRIVER("proto1", proto1_binding, false),
+    TEST_DRIVER("proto1-pci", proto1_pci_binding, false),
+    TEST_DRIVER("proto2-match", proto2_match_binding, false),
+    TEST_DRIVER("any", any_binding, false),
+    TEST_DRIVER("goto", goto_binding, false),
+    TEST_DRIVER("proto1-alias", proto1_alias_binding, false),
+    TEST_DRIVER("proto2-no-autobind", proto2_no_autobind_binding, false),
+    TEST_DRIVER("proto3-first", proto3_binding, true),
+    TEST_DRIVER("range", range_binding, false),
+    TEST_DRIVER("proto1-late", proto1_binding, false),
+    TEST_DRIVER("proto1-match-first", proto1_match_binding, true),
+    TEST_DRIVER("any-late", any_binding, false),
+};
+
+#define NUM_DRIVERS (sizeof(test_drivers) / sizeof(test_drivers[0]))
+
+typedef struct {
+    uint32_t protocol_id;
+    zx_device_prop_t props[2];
+    uint32_t prop_count;
+} test_device_t;
+
+static const test_device_t test_devices[] = {
+    { PROTO_1, {}, 0 },
+    { PROTO_1, { { BIND_PCI_VID, 0, 0x8086 } }, 1 },
+    { PROTO_1, { { BIND_PCI_VID, 0, 0x10de }, { BIND_PCI_DID, 0, 0x1234 } }, 2 },
+    { PROTO_1_ALIAS, {}, 0 },
+    { PROTO_2, {}, 0 },
+    { PROTO_2, { { BIND_PCI_DID, 0, 0x1234 } }, 1 },
+    { PROTO_3, {}, 0 },
+    // properties override the protocol the device was created with
+    { PROTO_2, { { BIND_PROTOCOL, 0, PROTO_1 } }, 1 },
+    { PROTO_UNUSED, {}, 0 },
+};
+
+#define NUM_DEVICES (sizeof(test_devices) / sizeof(test_devices[0]))
+
+// Every driver, in priority order, and the same drivers indexed.
+static driver_t drivers[NUM_DRIVERS];
+static list_node_t all_drivers = LIST_INITIAL_VALUE(all_drivers);
+static driver_index_t driver_index;
+
+static void add_drivers(void) {
+    if (!list_is_empty(&all_drivers)) {
+        return;
+    }
+    for (size_t n = 0; n < NUM_DRIVERS; n++) {
+        driver_t* drv = &drivers[n];
+        memset(drv, 0, sizeof(*drv));
+        drv->name = test_drivers[n].name;
+        drv->binding = test_drivers[n].binding;
+        drv->binding_size = test_drivers[n].binding_size;
+        dc_analyze_binding(drv);
+        if (test_drivers[n].first) {
+            list_add_head(&all_drivers, &drv->node);
+        } else {
+            list_add_tail(&all_drivers, &drv->node);
+        }
+        dc_driver_index_add(&driver_index, drv, test_drivers[n].first);
+    }
+}
+
+// Runs |drv|'s whole bind program, as every driver was before bind keys.
+static bool run_bind_program(driver_t* drv, const test_device_t* dev, bool autobind) {
+    uint32_t count = drv->bind_key_count;
+    drv->bind_key_count = 0;
+    bool r = dc_is_bindable(drv, dev->protocol_id, (zx_device_prop_t*)dev->props,
+                            dev->prop_count, autobind);
+    drv->bind_key_count = count;
+    return r;
+}
+
+static bool has_bind_key(const driver_t* drv, uint32_t id, uint32_t value) {
+    uint32_t actual;
+    return dc_binding_requires(drv, id, &actual) && actual == value;
+}
+
+static bool analyze_binding_test(void) {
+    BEGIN_TEST;
+    add_drivers();
+
+    EXPECT_EQ(drivers[0].bind_key_count, 1u, "proto1");
+    EXPECT_TRUE(has_bind_key(&drivers[0], BIND_PROTOCOL, PROTO_1), "proto1");
+    EXPECT_EQ(drivers[1].bind_key_count, 2u, "proto1-pci");
+    EXPECT_TRUE(has_bind_key(&drivers[1], BIND_PROTOCOL, PROTO_1), "proto1-pci");
+    EXPECT_TRUE(has_bind_key(&drivers[1], BIND_PCI_VID, 0x8086), "proto1-pci");
+    EXPECT_EQ(drivers[2].bind_key_count, 1u, "proto2-match");
+    EXPECT_TRUE(has_bind_key(&drivers[2], BIND_PROTOCOL, PROTO_2), "proto2-match");
+    EXPECT_EQ(drivers[3].bind_key_count, 0u, "any");
+    EXPECT_EQ(drivers[4].bind_key_count, 0u, "goto");
+    EXPECT_EQ(drivers[6].bind_key_count, 2u, "proto2-no-autobind");
+    EXPECT_TRUE(has_bind_key(&drivers[6], BIND_AUTOBIND, 0), "proto2-no-autobind");
+    EXPECT_TRUE(has_bind_key(&drivers[6], BIND_PROTOCOL, PROTO_2), "proto2-no-autobind");
+    EXPECT_EQ(drivers[8].bind_key_count, 1u, "range");
+    EXPECT_TRUE(has_bind_key(&drivers[8], BIND_PCI_DID, 0x1234), "range");
+
+    END_TEST;
+}
+
+// The index must offer every driver that binds to a device, in the order a
+// walk of all drivers would, and binding with bind keys must agree with
+// running the whole program.
+static bool bind_order_test(void) {
+    BEGIN_TEST;
+    add_drivers();
+
+    for (size_t n = 0; n < NUM_DEVICES; n++) {
+        const test_device_t* dev = &test_devices[n];
+        for (int autobind = 0; autobind < 2; autobind++) {
+            unittest_printf("device %zu autobind %d\n", n, autobind);
+
+            driver_t* expected[NUM_DRIVERS];
+            size_t expected_count = 0;
+            driver_t* drv;
+            list_for_every_entry(&all_drivers, drv, driver_t, node) {
+                if (run_bind_program(drv, dev, autobind)) {
+                    expected[expected_count++] = drv;
+                }
+            }
+
+            driver_t* actual[NUM_DRIVERS];
+            size_t actual_count = 0;
+            driver_t* last = NULL;
+            driver_candidates_t it;
+            dc_driver_candidates_begin(&it, &driver_index,
+                                       dc_device_protocol(dev->protocol_id, dev->props,
+                                                          dev->prop_count));
+            while ((drv = dc_driver_candidates_next(&it)) != NULL) {
+                if (last != NULL) {
+                    ASSERT_LT(last->seq, drv->seq, "candidates out of order");
+                }
+                last = drv;
+                if (dc_is_bindable(drv, dev->protocol_id, (zx_device_prop_t*)dev->props,
+                                   dev->prop_count, autobind)) {
+                    ASSERT_LT(actual_count, NUM_DRIVERS, "too many candidates");
+                    actual[actual_count++] = drv;
+                }
+            }
+
+            ASSERT_EQ(actual_count, expected_count, "wrong number of drivers bind");
+            for (size_t i = 0; i < actual_count; i++) {
+                EXPECT_EQ(actual[i], expected[i], "wrong driver binds");
+            }
+        }
+    }
+
+    END_TEST;
+}
+
+static bool empty_index_test(void) {
+    BEGIN_TEST;
+
+    driver_index_t empty;
+    memset(&empty, 0, sizeof(empty));
+    driver_candidates_t it;
+    dc_driver_candidates_begin(&it, &empty, PROTO_1);
+    EXPECT_NULL(dc_driver_candidates_next(&it), "");
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(devmgr_binding_tests)
+RUN_TEST(analyze_binding_test)
+RUN_TEST(bind_order_test)
+RUN_TEST(empty_index_test)
+END_TEST_CASE(devmgr_binding_tests)
+
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
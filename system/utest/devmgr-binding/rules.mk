@@ -0,0 +1,28 @@
+# Copyright 2018 The Fuchsia Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+MODULE := $(LOCAL_DIR)
+
+MODULE_TYPE := usertest
+
+MODULE_SRCS += \
+    $(LOCAL_DIR)/binding.c \
+    system/core/devmgr/devmgr-binding.c
+
+MODULE_NAME := devmgr-binding-test
+
+MODULE_COMPILEFLAGS += -Isystem/core/devmgr
+
+MODULE_HEADER_DEPS := \
+    system/ulib/ddk \
+    system/ulib/port
+
+MODULE_LIBS := \
+    system/ulib/unittest \
+    system/ulib/fdio \
+    system/ulib/c
+
+include make/module.mk
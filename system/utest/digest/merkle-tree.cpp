@@ -4,11 +4,16 @@
 
 #include <digest/merkle-tree.h>
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <digest/digest.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
 #include <zircon/assert.h>
 #include <zircon/status.h>
+#include <zircon/syscalls.h>
 #include <unittest/unittest.h>
 
 namespace {
@@ -300,6 +305,56 @@ bool CreateAll(void) {
     END_TEST;
 }
 
+// Used by CreateParallelAll below.  Checks that both the root digest and the
+// tree match those written by |Create|.
+bool CreateParallel(size_t data_len, const char* digest, size_t num_threads) {
+    zx_status_t rc;
+    size_t tree_len = MerkleTree::GetTreeLength(data_len);
+    uint8_t tree[sizeof(gTree)];
+    Digest serial;
+    ASSERT_OK(MerkleTree::Create(gData, data_len, tree, tree_len, &serial));
+    memset(gTree, 0xff, sizeof(gTree));
+    Digest actual;
+    ASSERT_OK(MerkleTree::CreateParallel(gData, data_len, gTree, tree_len, &actual,
+                                         num_threads));
+    Digest expected;
+    ASSERT_OK(expected.Parse(digest, strlen(digest)));
+    ASSERT_TRUE(actual == expected, "Incorrect root digest");
+    ASSERT_TRUE(actual == serial, "Root digest differs from Create");
+    ASSERT_EQ(memcmp(gTree, tree, tree_len), 0, "Tree differs from Create");
+    return true;
+}
+
+bool CreateParallelAll(void) {
+    BEGIN_TEST;
+    const size_t kThreads[] = {0, 1, 2, 7};
+    for (size_t i = 0; i < kNumCases; ++i) {
+        for (size_t num_threads : kThreads) {
+            if (!CreateParallel(kCases[i].data_len, kCases[i].digest, num_threads)) {
+                unittest_printf_critical(
+                    "CreateParallelAll failed with data length of %zu, %zu threads\n",
+                    kCases[i].data_len, num_threads);
+            }
+        }
+    }
+    END_TEST;
+}
+
+bool CreateParallelMissingArgs(void) {
+    BEGIN_TEST_WITH_RC;
+    Digest digest;
+    size_t tree_len = MerkleTree::GetTreeLength(kLarge);
+    ASSERT_ERR(ZX_ERR_INVALID_ARGS,
+               MerkleTree::CreateParallel(nullptr, kLarge, gTree, tree_len, &digest, 2));
+    ASSERT_ERR(ZX_ERR_INVALID_ARGS,
+               MerkleTree::CreateParallel(gData, kLarge, nullptr, tree_len, &digest, 2));
+    ASSERT_ERR(ZX_ERR_INVALID_ARGS,
+               MerkleTree::CreateParallel(gData, kLarge, gTree, tree_len, nullptr, 2));
+    ASSERT_ERR(ZX_ERR_BUFFER_TOO_SMALL,
+               MerkleTree::CreateParallel(gData, kLarge, gTree, tree_len - 1, &digest, 2));
+    END_TEST;
+}
+
 // Used by CreateFinalCAll below.
 bool CreateFinalC(size_t data_len, const char* digest) {
     zx_status_t rc;
@@ -692,6 +747,42 @@ bool CreateAndVerifyHugePRNGData(void) {
     END_TEST;
 }
 
+// Compares the throughput of |Create| and |CreateParallel| on a large buffer of
+// pseudorandom data, and checks that they agree.
+bool CreateParallelBenchmark(void) {
+    BEGIN_TEST_WITH_RC;
+    const size_t kDataLen = 64 << 20;
+    size_t tree_len = MerkleTree::GetTreeLength(kDataLen);
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> data(new (&ac) uint8_t[kDataLen]);
+    ASSERT_TRUE(ac.check());
+    fbl::unique_ptr<uint8_t[]> tree(new (&ac) uint8_t[tree_len]);
+    ASSERT_TRUE(ac.check());
+    for (size_t i = 0; i < kDataLen; ++i) {
+        data[i] = static_cast<uint8_t>(rand());
+    }
+
+    Digest serial;
+    zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    ASSERT_OK(MerkleTree::Create(data.get(), kDataLen, tree.get(), tree_len, &serial));
+    zx_time_t elapsed = zx_clock_get(ZX_CLOCK_MONOTONIC) - start;
+    printf("\n%3u thread(s): %4lu MB/s", 1, (kDataLen * ZX_SEC(1)) / (elapsed << 20));
+
+    size_t num_cpus = zx_system_get_num_cpus();
+    for (size_t num_threads = 2; num_threads <= num_cpus; num_threads <<= 1) {
+        Digest parallel;
+        start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+        ASSERT_OK(MerkleTree::CreateParallel(data.get(), kDataLen, tree.get(), tree_len,
+                                             &parallel, num_threads));
+        elapsed = zx_clock_get(ZX_CLOCK_MONOTONIC) - start;
+        printf("\n%3zu thread(s): %4lu MB/s", num_threads,
+               (kDataLen * ZX_SEC(1)) / (elapsed << 20));
+        ASSERT_TRUE(parallel == serial, "Root digest differs from Create");
+    }
+    printf("\n");
+    END_TEST;
+}
+
 } // namespace
 
 BEGIN_TEST_CASE(MerkleTreeTests)
@@ -722,6 +813,8 @@ RUN_TEST(CreateByteByByte)
 RUN_TEST(CreateMissingData)
 RUN_TEST(CreateMissingTree)
 RUN_TEST(CreateTreeTooSmall)
+RUN_TEST(CreateParallelAll)
+RUN_TEST(CreateParallelMissingArgs)
 RUN_TEST(VerifyAll)
 RUN_TEST(VerifyCAll)
 RUN_TEST(VerifyNodeByNode)
@@ -740,4 +833,5 @@ RUN_TEST(VerifyBadTree)
 RUN_TEST(VerifyGoodPartOfBadLeaves)
 RUN_TEST(VerifyBadLeaves)
 RUN_TEST(CreateAndVerifyHugePRNGData)
+RUN_TEST_PERFORMANCE(CreateParallelBenchmark)
 END_TEST_CASE(MerkleTreeTests)
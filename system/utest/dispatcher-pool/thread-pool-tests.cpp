@@ -0,0 +1,210 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <zircon/syscalls.h>
+#include <zx/event.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/atomic.h>
+#include <fbl/auto_call.h>
+#include <fbl/ref_ptr.h>
+#include <fbl/unique_ptr.h>
+
+#include <dispatcher-pool/dispatcher-execution-domain.h>
+#include <dispatcher-pool/dispatcher-thread-pool.h>
+#include <dispatcher-pool/dispatcher-wakeup-event.h>
+
+#include <unittest/unittest.h>
+
+namespace {
+
+using dispatcher::ExecutionDomain;
+using dispatcher::ThreadPool;
+using dispatcher::WakeupEvent;
+
+// The priority of the pool every test runs its domains in.  Each test shuts
+// the pool down when it is done, so the next test starts out with a fresh one.
+constexpr uint32_t kPriority = 24;
+constexpr uint32_t kDomainCount = 64;
+constexpr uint32_t kEventsPerDomain = 4;
+
+struct TestState;
+struct DomainRecord;
+
+// A WakeupEvent which signals itself again from its own handler until it has
+// run |target| times, or forever if |target| is 0.  Every run of the handler
+// is one unit of work; since signals which arrive during a dispatch are
+// coalesced, each unit of work must be dispatched exactly once.
+struct Work {
+    zx_status_t Run(WakeupEvent* event);
+
+    DomainRecord* record = nullptr;
+    fbl::RefPtr<WakeupEvent> event;
+    uint32_t target = 0;
+    fbl::atomic<uint32_t> runs{0};
+};
+
+struct DomainRecord {
+    TestState* test = nullptr;
+    fbl::RefPtr<ExecutionDomain> domain;
+    Work work[kEventsPerDomain];
+    // Handlers of one domain must never run at the same time.
+    fbl::atomic<uint32_t> in_dispatch{0};
+};
+
+struct TestState {
+    fbl::unique_ptr<DomainRecord[]> records;
+    fbl::atomic<uint32_t> overlaps{0};
+    fbl::atomic<uint32_t> remaining{0};
+    zx::event done;
+};
+
+zx_status_t Work::Run(WakeupEvent* event) {
+    TestState* test = record->test;
+    if (record->in_dispatch.fetch_add(1) != 0)
+        test->overlaps.fetch_add(1);
+
+    uint32_t run = runs.fetch_add(1) + 1;
+
+    // Linger a little so that dispatches on other threads get a chance to
+    // overlap with this one if serialization is broken.
+    for (volatile uint32_t i = 0; i < 1000; ++i)
+        ;
+
+    record->in_dispatch.fetch_sub(1);
+
+    if ((target == 0) || (run < target))
+        return event->Signal();
+
+    if (test->remaining.fetch_sub(1) == 1)
+        test->done.signal(0u, ZX_USER_SIGNAL_0);
+    return ZX_OK;
+}
+
+// Creates kDomainCount domains in the test pool, every other one of them
+// LowLatency, each with kEventsPerDomain events which run |target| times.
+bool create_domains(TestState* test, uint32_t target) {
+    BEGIN_HELPER;
+
+    fbl::AllocChecker ac;
+    test->records.reset(new (&ac) DomainRecord[kDomainCount]);
+    ASSERT_TRUE(ac.check());
+    ASSERT_EQ(ZX_OK, zx::event::create(0u, &test->done));
+    test->remaining.store(target ? kDomainCount * kEventsPerDomain : 0u);
+
+    for (uint32_t i = 0; i < kDomainCount; ++i) {
+        DomainRecord& record = test->records[i];
+        record.test = test;
+        record.domain = ExecutionDomain::Create(kPriority,
+                                                (i & 1) ? ExecutionDomain::DispatchHint::LowLatency
+                                                        : ExecutionDomain::DispatchHint::Normal);
+        ASSERT_TRUE(record.domain != nullptr);
+
+        for (Work& work : record.work) {
+            work.record = &record;
+            work.target = target;
+            work.event = WakeupEvent::Create();
+            ASSERT_TRUE(work.event != nullptr);
+            Work* w = &work;
+            ASSERT_EQ(ZX_OK, work.event->Activate(
+                record.domain, [w](WakeupEvent* event) -> zx_status_t { return w->Run(event); }));
+        }
+    }
+
+    END_HELPER;
+}
+
+bool signal_domains(TestState* test) {
+    BEGIN_HELPER;
+    for (uint32_t i = 0; i < kDomainCount; ++i) {
+        for (Work& work : test->records[i].work)
+            ASSERT_EQ(ZX_OK, work.event->Signal());
+    }
+    END_HELPER;
+}
+
+// Returns the total number of units of work done so far.
+uint64_t total_runs(const TestState& test) {
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < kDomainCount; ++i) {
+        for (const Work& work : test.records[i].work)
+            total += work.runs.load();
+    }
+    return total;
+}
+
+// Shuts down the test pool, deactivating all of its domains and joining its
+// threads.
+void ShutdownPool() {
+    fbl::RefPtr<ThreadPool> pool;
+    if (ThreadPool::Get(&pool, kPriority) == ZX_OK)
+        pool->Shutdown();
+}
+
+// Many domains generating far more work than there are threads, so that the
+// ready queues fill up, domains use up their budgets and idle threads steal.
+// Every unit of work must be dispatched exactly once.
+bool steal_drains_all_work_test() {
+    BEGIN_TEST;
+
+    constexpr uint32_t kTarget = 200;
+    TestState test;
+    auto cleanup = fbl::MakeAutoCall(ShutdownPool);
+    ASSERT_TRUE(create_domains(&test, kTarget));
+    ASSERT_TRUE(signal_domains(&test));
+
+    zx_signals_t pending = 0;
+    EXPECT_EQ(ZX_OK, test.done.wait_one(ZX_USER_SIGNAL_0, zx::deadline_after(zx::sec(30)),
+                                        &pending), "all work done");
+
+    // Give anything which would run twice a chance to do so.
+    zx_nanosleep(zx_deadline_after(ZX_MSEC(20)));
+
+    for (uint32_t i = 0; i < kDomainCount; ++i) {
+        for (const Work& work : test.records[i].work)
+            EXPECT_EQ(kTarget, work.runs.load(), "runs");
+    }
+    EXPECT_EQ(0u, test.overlaps.load(), "concurrent dispatch within a domain");
+
+    cleanup.call();
+    for (uint32_t i = 0; i < kDomainCount; ++i)
+        EXPECT_TRUE(test.records[i].domain->deactivated());
+
+    END_TEST;
+}
+
+// Shut the pool down while its threads are busy stealing from one another.
+// Threads exit while others may be taking domains from their queues; nothing
+// may be dispatched concurrently, dispatched after the pool is shut down, or
+// left behind in a ready queue (which the domains assert when they destruct).
+bool thread_exit_mid_steal_test() {
+    BEGIN_TEST;
+
+    for (uint32_t pass = 0; pass < 10; ++pass) {
+        TestState test;
+        auto cleanup = fbl::MakeAutoCall(ShutdownPool);
+        ASSERT_TRUE(create_domains(&test, 0u));
+        ASSERT_TRUE(signal_domains(&test));
+
+        zx_nanosleep(zx_deadline_after(ZX_MSEC(5 + pass)));
+        cleanup.call();
+
+        for (uint32_t i = 0; i < kDomainCount; ++i)
+            EXPECT_TRUE(test.records[i].domain->deactivated());
+
+        uint64_t runs = total_runs(test);
+        EXPECT_GT(runs, 0u, "work was dispatched");
+        zx_nanosleep(zx_deadline_after(ZX_MSEC(10)));
+        EXPECT_EQ(runs, total_runs(test), "work dispatched after shutdown");
+        EXPECT_EQ(0u, test.overlaps.load(), "concurrent dispatch within a domain");
+    }
+
+    END_TEST;
+}
+
+}  // namespace
+
+BEGIN_TEST_CASE(dispatcher_thread_pool_tests)
+RUN_TEST(steal_drains_all_work_test)
+RUN_TEST(thread_exit_mid_steal_test)
+END_TEST_CASE(dispatcher_thread_pool_tests)
@@ -10,9 +10,12 @@
 #include <zircon/dlfcn.h>
 #include <zircon/processargs.h>
 #include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
 
+#include <limits.h>
 #include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -161,6 +164,144 @@ bool clone_test(void) {
     END_TEST;
 }
 
+static zx_status_t load_object_rpc(zx_handle_t svc, const char* name, zx_handle_t* out) {
+    ldmsg_req_t req;
+    memset(&req.header, 0, sizeof(req.header));
+    req.header.ordinal = LDMSG_OP_LOAD_OBJECT;
+    size_t req_len;
+    zx_status_t status = ldmsg_req_encode(&req, &req_len, name, strlen(name));
+    if (status != ZX_OK)
+        return status;
+
+    ldmsg_rsp_t rsp;
+    memset(&rsp, 0, sizeof(rsp));
+    *out = ZX_HANDLE_INVALID;
+    zx_channel_call_args_t call = {
+        .wr_bytes = &req,
+        .wr_num_bytes = req_len,
+        .rd_bytes = &rsp,
+        .rd_num_bytes = sizeof(rsp),
+        .rd_handles = out,
+        .rd_num_handles = 1,
+    };
+    uint32_t reply_size, handle_count;
+    zx_status_t read_status = ZX_OK;
+    status = zx_channel_call(svc, 0, ZX_TIME_INFINITE, &call, &reply_size,
+                             &handle_count, &read_status);
+    if (status != ZX_OK)
+        return status == ZX_ERR_CALL_FAILED ? read_status : status;
+    return rsp.rv;
+}
+
+static zx_koid_t get_koid(zx_handle_t h) {
+    zx_info_handle_basic_t info;
+    zx_status_t status = zx_object_get_info(h, ZX_INFO_HANDLE_BASIC, &info, sizeof(info),
+                                            NULL, NULL);
+    return status == ZX_OK ? info.koid : ZX_KOID_INVALID;
+}
+
+bool fs_loader_cache_test(void) {
+    BEGIN_TEST;
+
+    loader_service_t* svc;
+    ASSERT_EQ(loader_service_create_fs("dlfcn-test-loader", &svc), ZX_OK, "");
+    zx_handle_t h;
+    ASSERT_EQ(loader_service_connect(svc, &h), ZX_OK, "");
+
+    // The second load is served from the cache, but each client must still
+    // get a VMO of its own with the library's contents.
+    zx_handle_t vmos[2];
+    for (size_t i = 0; i < countof(vmos); i++) {
+        ASSERT_EQ(load_object_rpc(h, TEST_SONAME, &vmos[i]), ZX_OK, "load_object");
+        ASSERT_NE(vmos[i], ZX_HANDLE_INVALID, "");
+    }
+    EXPECT_NE(get_koid(vmos[0]), get_koid(vmos[1]), "clients share a vmo");
+
+    char magic[2][4];
+    size_t actual;
+    for (size_t i = 0; i < countof(vmos); i++) {
+        EXPECT_EQ(zx_vmo_read(vmos[i], magic[i], 0, sizeof(magic[i]), &actual), ZX_OK, "");
+        EXPECT_EQ(memcmp(magic[i], "\x7f" "ELF", 4), 0, "not an ELF file");
+    }
+
+    // Writes by one client, if its rights allow them, are not seen by the next.
+    zx_vmo_write(vmos[0], "junk", 0, 4, &actual);
+    zx_handle_t vmo;
+    ASSERT_EQ(load_object_rpc(h, TEST_SONAME, &vmo), ZX_OK, "load_object");
+    EXPECT_EQ(zx_vmo_read(vmo, magic[0], 0, sizeof(magic[0]), &actual), ZX_OK, "");
+    EXPECT_EQ(memcmp(magic[0], "\x7f" "ELF", 4), 0, "cached vmo was modified");
+
+    zx_handle_close(vmo);
+    zx_handle_close(vmos[0]);
+    zx_handle_close(vmos[1]);
+    zx_handle_close(h);
+    loader_service_release(svc);
+
+    END_TEST;
+}
+
+static bool write_file(const char* path, const char* contents) {
+    BEGIN_HELPER;
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0, "open");
+    ssize_t len = strlen(contents);
+    EXPECT_EQ(write(fd, contents, len), len, "write");
+    ASSERT_EQ(close(fd), 0, "close");
+    END_HELPER;
+}
+
+static bool expect_load(zx_handle_t svc, const char* name, const char* contents) {
+    BEGIN_HELPER;
+    zx_handle_t vmo;
+    ASSERT_EQ(load_object_rpc(svc, name, &vmo), ZX_OK, "load_object");
+    char buf[64];
+    size_t len = strlen(contents);
+    size_t actual;
+    EXPECT_EQ(zx_vmo_read(vmo, buf, 0, len, &actual), ZX_OK, "");
+    EXPECT_EQ(actual, len, "");
+    EXPECT_EQ(memcmp(buf, contents, len), 0, "stale library contents");
+    zx_handle_close(vmo);
+    END_HELPER;
+}
+
+// A library which is replaced must not be served from the cache.
+bool fs_loader_replace_test(void) {
+    BEGIN_TEST;
+
+    char dir[] = "/tmp/dlfcn-test-XXXXXX";
+    ASSERT_NONNULL(mkdtemp(dir), "mkdtemp");
+    char path[PATH_MAX];
+    char new_path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/libreplaced.so", dir);
+    snprintf(new_path, sizeof(new_path), "%s/libreplaced.so.new", dir);
+
+    const char* libpaths[] = { dir, NULL };
+    loader_service_t* svc;
+    ASSERT_EQ(loader_service_create_fs_libpaths("dlfcn-test-loader", libpaths, &svc), ZX_OK, "");
+    zx_handle_t h;
+    ASSERT_EQ(loader_service_connect(svc, &h), ZX_OK, "");
+
+    ASSERT_TRUE(write_file(path, "first version"), "");
+    EXPECT_TRUE(expect_load(h, "libreplaced.so", "first version"), "");
+    EXPECT_TRUE(expect_load(h, "libreplaced.so", "first version"), "");
+
+    // Renaming a new file over it changes its inode.
+    ASSERT_TRUE(write_file(new_path, "second, longer version"), "");
+    ASSERT_EQ(rename(new_path, path), 0, "rename");
+    EXPECT_TRUE(expect_load(h, "libreplaced.so", "second, longer version"), "");
+
+    // Rewriting it in place changes its size and modification time.
+    ASSERT_TRUE(write_file(path, "third"), "");
+    EXPECT_TRUE(expect_load(h, "libreplaced.so", "third"), "");
+
+    zx_handle_close(h);
+    loader_service_release(svc);
+    EXPECT_EQ(unlink(path), 0, "");
+    EXPECT_EQ(rmdir(dir), 0, "");
+
+    END_TEST;
+}
+
 int main(int argc, char** argv);
 static bool dladdr_main_test(void) {
     BEGIN_TEST;
@@ -181,6 +322,8 @@ BEGIN_TEST_CASE(dlfcn_tests)
 RUN_TEST(dlopen_vmo_test);
 RUN_TEST(loader_service_test);
 RUN_TEST(clone_test);
+RUN_TEST(fs_loader_cache_test);
+RUN_TEST(fs_loader_replace_test);
 RUN_TEST(dladdr_main_test);
 END_TEST_CASE(dlfcn_tests)
 
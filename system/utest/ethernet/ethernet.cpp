@@ -305,6 +305,17 @@ public:
         return rc < 0 ? static_cast<zx_status_t>(rc) : ZX_OK;
     }
 
+    zx_status_t AddQueue(zx::fifo* tx, zx::fifo* rx) {
+        eth_fifos_t fifos;
+        ssize_t rc = ioctl_ethernet_add_queue(fd_, &fifos);
+        if (rc < 0) {
+            return static_cast<zx_status_t>(rc);
+        }
+        tx->reset(fifos.tx_fifo);
+        rx->reset(fifos.rx_fifo);
+        return ZX_OK;
+    }
+
     zx::fifo* tx_fifo() { return &tx_; }
     zx::fifo* rx_fifo() { return &rx_; }
     uint32_t tx_depth() { return tx_depth_; }
@@ -869,6 +880,52 @@ static bool EthernetDataTest_Recv() {
     END_TEST;
 }
 
+static bool EthernetDataTest_SendOnAddedQueue() {
+    BEGIN_TEST;
+    zx::socket sock;
+    EthernetClient client;
+    EthernetOpenInfo info(__func__);
+    info.online = false;
+    ASSERT_TRUE(OpenFirstClientHelper(&sock, &client, info));
+
+    // Queues can only be added before the client starts
+    zx::fifo tx, rx;
+    ASSERT_EQ(ZX_OK, client.AddQueue(&tx, &rx));
+    sock.signal_peer(0, ETHERTAP_SIGNAL_ONLINE);
+    ASSERT_EQ(ZX_OK, client.Start());
+    zx::fifo tx2, rx2;
+    EXPECT_EQ(ZX_ERR_BAD_STATE, client.AddQueue(&tx2, &rx2));
+
+    auto entry = client.GetTxBuffer();
+    ASSERT_TRUE(entry != nullptr);
+    uint8_t* buf = static_cast<uint8_t*>(entry->cookie);
+    for (int i = 0; i < 32; i++) {
+        buf[i] = static_cast<uint8_t>(i & 0xff);
+    }
+    entry->length = 32;
+
+    // A packet written to the added tx fifo is transmitted and completes on that fifo
+    uint32_t actual = 0;
+    ASSERT_EQ(ZX_OK, tx.write(entry, sizeof(eth_fifo_entry_t), &actual));
+    EXPECT_EQ(1u, actual);
+
+    ExpectPacketRead(&sock, 32, buf, "");
+
+    zx_signals_t obs;
+    EXPECT_EQ(ZX_OK, tx.wait_one(ZX_FIFO_READABLE, FAIL_TIMEOUT, &obs));
+    ASSERT_TRUE(obs & ZX_FIFO_READABLE);
+
+    eth_fifo_entry_t return_entry;
+    ASSERT_EQ(ZX_OK, tx.read(&return_entry, sizeof(eth_fifo_entry_t), &actual));
+    EXPECT_EQ(1u, actual);
+    EXPECT_TRUE(return_entry.flags & ETH_FIFO_TX_OK);
+    EXPECT_EQ(entry->cookie, return_entry.cookie);
+    client.ReturnTxBuffer(&return_entry);
+
+    ASSERT_TRUE(EthernetCleanupHelper(&sock, &client));
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(EthernetSetupTests)
 RUN_TEST_MEDIUM(EthernetStartTest)
 RUN_TEST_MEDIUM(EthernetLinkStatusTest)
@@ -888,6 +945,7 @@ END_TEST_CASE(EthernetConfigTests)
 BEGIN_TEST_CASE(EthernetDataTests)
 RUN_TEST_MEDIUM(EthernetDataTest_Send)
 RUN_TEST_MEDIUM(EthernetDataTest_Recv)
+RUN_TEST_MEDIUM(EthernetDataTest_SendOnAddedQueue)
 END_TEST_CASE(EthernetDataTests)
 
 int main(int argc, char* argv[]) {
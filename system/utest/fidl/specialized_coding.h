@@ -0,0 +1,410 @@
+// header file
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <fidl/coding.h>
+#include <zircon/fidl.h>
+#include <zircon/syscalls/object.h>
+#include <zircon/types.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+
+// Forward declarations
+
+typedef struct SpecializedPlainMsg SpecializedPlainMsg;
+typedef struct SpecializedPlainRsp SpecializedPlainRsp;
+typedef struct SpecializedHandlesMsg SpecializedHandlesMsg;
+typedef struct SpecializedHandlesRsp SpecializedHandlesRsp;
+typedef struct SpecializedNestedMsg SpecializedNestedMsg;
+typedef struct SpecializedNestedRsp SpecializedNestedRsp;
+typedef struct Endpoints Endpoints;
+
+// Extern declarations
+
+extern const fidl_type_t SpecializedPlainReqCoded;
+extern const fidl_type_t SpecializedPlainRspCoded;
+extern const fidl_type_t SpecializedHandlesReqCoded;
+extern const fidl_type_t SpecializedHandlesRspCoded;
+extern const fidl_type_t SpecializedNestedReqCoded;
+extern const fidl_type_t SpecializedNestedRspCoded;
+
+// Declarations
+
+struct Endpoints {
+    zx_handle_t client;
+    zx_handle_t server;
+};
+
+struct SpecializedPlainMsg {
+    fidl_message_header_t hdr;
+    uint64_t value;
+    uint8_t tag[16];
+};
+
+struct SpecializedPlainRsp {
+    fidl_message_header_t hdr;
+    int32_t result;
+};
+
+struct SpecializedHandlesMsg {
+    fidl_message_header_t hdr;
+    zx_handle_t required;
+    zx_handle_t optional;
+    zx_handle_t extra[3];
+};
+
+struct SpecializedHandlesRsp {
+    fidl_message_header_t hdr;
+    zx_handle_t reply;
+};
+
+struct SpecializedNestedMsg {
+    fidl_message_header_t hdr;
+    uint32_t id;
+    Endpoints ends;
+    zx_handle_t grid[2][2];
+};
+
+struct SpecializedNestedRsp {
+    fidl_message_header_t hdr;
+    uint32_t id;
+};
+
+
+// Coding functions
+
+static inline zx_status_t SpecializedPlainMsg_encode(void* bytes, uint32_t num_bytes, zx_handle_t* handles, uint32_t max_handles, uint32_t* actual_handles_out, const char** error_msg_out) {
+    if (bytes == NULL || num_bytes != sizeof(SpecializedPlainMsg)) {
+        if (error_msg_out != NULL) {
+            *error_msg_out = "message does not match the size of SpecializedPlainMsg";
+        }
+        return ZX_ERR_INVALID_ARGS;
+    }
+    *actual_handles_out = 0u;
+    return ZX_OK;
+}
+
+static inline zx_status_t SpecializedPlainMsg_decode(void* bytes, uint32_t num_bytes, const zx_handle_t* handles, uint32_t num_handles, const char** error_msg_out) {
+    if (bytes == NULL || num_bytes != sizeof(SpecializedPlainMsg) || num_handles != 0u) {
+        if (error_msg_out != NULL) {
+            *error_msg_out = "message does not match the layout of SpecializedPlainMsg";
+        }
+        return ZX_ERR_INVALID_ARGS;
+    }
+    return ZX_OK;
+}
+
+static inline zx_status_t SpecializedPlainRsp_encode(void* bytes, uint32_t num_bytes, zx_handle_t* handles, uint32_t max_handles, uint32_t* actual_handles_out, const char** error_msg_out) {
+    if (bytes == NULL || num_bytes != sizeof(SpecializedPlainRsp)) {
+        if (error_msg_out != NULL) {
+            *error_msg_out = "message does not match the size of SpecializedPlainRsp";
+        }
+        return ZX_ERR_INVALID_ARGS;
+    }
+    *actual_handles_out = 0u;
+    return ZX_OK;
+}
+
+static inline zx_status_t SpecializedPlainRsp_decode(void* bytes, uint32_t num_bytes, const zx_handle_t* handles, uint32_t num_handles, const char** error_msg_out) {
+    if (bytes == NULL || num_bytes != sizeof(SpecializedPlainRsp) || num_handles != 0u) {
+        if (error_msg_out != NULL) {
+            *error_msg_out = "message does not match the layout of SpecializedPlainRsp";
+        }
+        return ZX_ERR_INVALID_ARGS;
+    }
+    return ZX_OK;
+}
+
+static inline zx_status_t SpecializedHandlesMsg_encode(void* bytes, uint32_t num_bytes, zx_handle_t* handles, uint32_t max_handles, uint32_t* actual_handles_out, const char** error_msg_out) {
+    SpecializedHandlesMsg* msg = (SpecializedHandlesMsg*)bytes;
+    uint32_t handle_idx = 0u;
+    const char* error_msg;
+    if (msg == NULL || num_bytes != sizeof(*msg)) {
+        error_msg = "message does not match the size of SpecializedHandlesMsg";
+        goto fail;
+    }
+    if (handles == NULL && max_handles != 0u) {
+        error_msg = "Cannot provide non-zero handle count and null handle pointer";
+        goto fail;
+    }
+    if (handle_idx == max_handles) {
+        error_msg = "message encoded too many handles";
+        goto fail;
+    }
+    handles[handle_idx++] = msg->required;
+    msg->required = FIDL_HANDLE_PRESENT;
+    if (msg->optional != ZX_HANDLE_INVALID) {
+        if (handle_idx == max_handles) {
+            error_msg = "message encoded too many handles";
+            goto fail;
+        }
+        handles[handle_idx++] = msg->optional;
+        msg->optional = FIDL_HANDLE_PRESENT;
+    }
+    for (uint32_t i0 = 0u; i0 < 3u; ++i0) {
+        if (msg->extra[i0] != ZX_HANDLE_INVALID) {
+            if (handle_idx == max_handles) {
+                error_msg = "message encoded too many handles";
+                goto fail;
+            }
+            handles[handle_idx++] = msg->extra[i0];
+            msg->extra[i0] = FIDL_HANDLE_PRESENT;
+        }
+    }
+    *actual_handles_out = handle_idx;
+    return ZX_OK;
+fail:
+    if (error_msg_out != NULL) {
+        *error_msg_out = error_msg;
+    }
+    return ZX_ERR_INVALID_ARGS;
+}
+
+static inline zx_status_t SpecializedHandlesMsg_decode(void* bytes, uint32_t num_bytes, const zx_handle_t* handles, uint32_t num_handles, const char** error_msg_out) {
+    SpecializedHandlesMsg* msg = (SpecializedHandlesMsg*)bytes;
+    uint32_t handle_idx = 0u;
+    const char* error_msg;
+    if (msg == NULL || num_bytes != sizeof(*msg)) {
+        error_msg = "message does not match the size of SpecializedHandlesMsg";
+        goto fail;
+    }
+    if (handles == NULL && num_handles != 0u) {
+        error_msg = "Cannot provide non-zero handle count and null handle pointer";
+        goto fail;
+    }
+    if (msg->required != FIDL_HANDLE_PRESENT) {
+        error_msg = "message tried to decode a non-present handle";
+        goto fail;
+    }
+    if (handle_idx == num_handles) {
+        error_msg = "message decoded too many handles";
+        goto fail;
+    }
+    msg->required = handles[handle_idx++];
+    if (msg->optional == FIDL_HANDLE_PRESENT) {
+        if (handle_idx == num_handles) {
+            error_msg = "message decoded too many handles";
+            goto fail;
+        }
+        msg->optional = handles[handle_idx++];
+    } else if (msg->optional != FIDL_HANDLE_ABSENT) {
+        error_msg = "message tried to decode a non-present handle";
+        goto fail;
+    }
+    for (uint32_t i0 = 0u; i0 < 3u; ++i0) {
+        if (msg->extra[i0] == FIDL_HANDLE_PRESENT) {
+            if (handle_idx == num_handles) {
+                error_msg = "message decoded too many handles";
+                goto fail;
+            }
+            msg->extra[i0] = handles[handle_idx++];
+        } else if (msg->extra[i0] != FIDL_HANDLE_ABSENT) {
+            error_msg = "message tried to decode a non-present handle";
+            goto fail;
+        }
+    }
+    if (handle_idx != num_handles) {
+        error_msg = "message did not contain the specified number of handles";
+        goto fail;
+    }
+    return ZX_OK;
+fail:
+    if (error_msg_out != NULL) {
+        *error_msg_out = error_msg;
+    }
+    return ZX_ERR_INVALID_ARGS;
+}
+
+static inline zx_status_t SpecializedHandlesRsp_encode(void* bytes, uint32_t num_bytes, zx_handle_t* handles, uint32_t max_handles, uint32_t* actual_handles_out, const char** error_msg_out) {
+    SpecializedHandlesRsp* msg = (SpecializedHandlesRsp*)bytes;
+    uint32_t handle_idx = 0u;
+    const char* error_msg;
+    if (msg == NULL || num_bytes != sizeof(*msg)) {
+        error_msg = "message does not match the size of SpecializedHandlesRsp";
+        goto fail;
+    }
+    if (handles == NULL && max_handles != 0u) {
+        error_msg = "Cannot provide non-zero handle count and null handle pointer";
+        goto fail;
+    }
+    if (handle_idx == max_handles) {
+        error_msg = "message encoded too many handles";
+        goto fail;
+    }
+    handles[handle_idx++] = msg->reply;
+    msg->reply = FIDL_HANDLE_PRESENT;
+    *actual_handles_out = handle_idx;
+    return ZX_OK;
+fail:
+    if (error_msg_out != NULL) {
+        *error_msg_out = error_msg;
+    }
+    return ZX_ERR_INVALID_ARGS;
+}
+
+static inline zx_status_t SpecializedHandlesRsp_decode(void* bytes, uint32_t num_bytes, const zx_handle_t* handles, uint32_t num_handles, const char** error_msg_out) {
+    SpecializedHandlesRsp* msg = (SpecializedHandlesRsp*)bytes;
+    uint32_t handle_idx = 0u;
+    const char* error_msg;
+    if (msg == NULL || num_bytes != sizeof(*msg)) {
+        error_msg = "message does not match the size of SpecializedHandlesRsp";
+        goto fail;
+    }
+    if (handles == NULL && num_handles != 0u) {
+        error_msg = "Cannot provide non-zero handle count and null handle pointer";
+        goto fail;
+    }
+    if (msg->reply != FIDL_HANDLE_PRESENT) {
+        error_msg = "message tried to decode a non-present handle";
+        goto fail;
+    }
+    if (handle_idx == num_handles) {
+        error_msg = "message decoded too many handles";
+        goto fail;
+    }
+    msg->reply = handles[handle_idx++];
+    if (handle_idx != num_handles) {
+        error_msg = "message did not contain the specified number of handles";
+        goto fail;
+    }
+    return ZX_OK;
+fail:
+    if (error_msg_out != NULL) {
+        *error_msg_out = error_msg;
+    }
+    return ZX_ERR_INVALID_ARGS;
+}
+
+static inline zx_status_t SpecializedNestedMsg_encode(void* bytes, uint32_t num_bytes, zx_handle_t* handles, uint32_t max_handles, uint32_t* actual_handles_out, const char** error_msg_out) {
+    SpecializedNestedMsg* msg = (SpecializedNestedMsg*)bytes;
+    uint32_t handle_idx = 0u;
+    const char* error_msg;
+    if (msg == NULL || num_bytes != sizeof(*msg)) {
+        error_msg = "message does not match the size of SpecializedNestedMsg";
+        goto fail;
+    }
+    if (handles == NULL && max_handles != 0u) {
+        error_msg = "Cannot provide non-zero handle count and null handle pointer";
+        goto fail;
+    }
+    if (handle_idx == max_handles) {
+        error_msg = "message encoded too many handles";
+        goto fail;
+    }
+    handles[handle_idx++] = msg->ends.client;
+    msg->ends.client = FIDL_HANDLE_PRESENT;
+    if (msg->ends.server != ZX_HANDLE_INVALID) {
+        if (handle_idx == max_handles) {
+            error_msg = "message encoded too many handles";
+            goto fail;
+        }
+        handles[handle_idx++] = msg->ends.server;
+        msg->ends.server = FIDL_HANDLE_PRESENT;
+    }
+    for (uint32_t i0 = 0u; i0 < 2u; ++i0) {
+        for (uint32_t i1 = 0u; i1 < 2u; ++i1) {
+            if (msg->grid[i0][i1] != ZX_HANDLE_INVALID) {
+                if (handle_idx == max_handles) {
+                    error_msg = "message encoded too many handles";
+                    goto fail;
+                }
+                handles[handle_idx++] = msg->grid[i0][i1];
+                msg->grid[i0][i1] = FIDL_HANDLE_PRESENT;
+            }
+        }
+    }
+    *actual_handles_out = handle_idx;
+    return ZX_OK;
+fail:
+    if (error_msg_out != NULL) {
+        *error_msg_out = error_msg;
+    }
+    return ZX_ERR_INVALID_ARGS;
+}
+
+static inline zx_status_t SpecializedNestedMsg_decode(void* bytes, uint32_t num_bytes, const zx_handle_t* handles, uint32_t num_handles, const char** error_msg_out) {
+    SpecializedNestedMsg* msg = (SpecializedNestedMsg*)bytes;
+    uint32_t handle_idx = 0u;
+    const char* error_msg;
+    if (msg == NULL || num_bytes != sizeof(*msg)) {
+        error_msg = "message does not match the size of SpecializedNestedMsg";
+        goto fail;
+    }
+    if (handles == NULL && num_handles != 0u) {
+        error_msg = "Cannot provide non-zero handle count and null handle pointer";
+        goto fail;
+    }
+    if (msg->ends.client != FIDL_HANDLE_PRESENT) {
+        error_msg = "message tried to decode a non-present handle";
+        goto fail;
+    }
+    if (handle_idx == num_handles) {
+        error_msg = "message decoded too many handles";
+        goto fail;
+    }
+    msg->ends.client = handles[handle_idx++];
+    if (msg->ends.server == FIDL_HANDLE_PRESENT) {
+        if (handle_idx == num_handles) {
+            error_msg = "message decoded too many handles";
+            goto fail;
+        }
+        msg->ends.server = handles[handle_idx++];
+    } else if (msg->ends.server != FIDL_HANDLE_ABSENT) {
+        error_msg = "message tried to decode a non-present handle";
+        goto fail;
+    }
+    for (uint32_t i0 = 0u; i0 < 2u; ++i0) {
+        for (uint32_t i1 = 0u; i1 < 2u; ++i1) {
+            if (msg->grid[i0][i1] == FIDL_HANDLE_PRESENT) {
+                if (handle_idx == num_handles) {
+                    error_msg = "message decoded too many handles";
+                    goto fail;
+                }
+                msg->grid[i0][i1] = handles[handle_idx++];
+            } else if (msg->grid[i0][i1] != FIDL_HANDLE_ABSENT) {
+                error_msg = "message tried to decode a non-present handle";
+                goto fail;
+            }
+        }
+    }
+    if (handle_idx != num_handles) {
+        error_msg = "message did not contain the specified number of handles";
+        goto fail;
+    }
+    return ZX_OK;
+fail:
+    if (error_msg_out != NULL) {
+        *error_msg_out = error_msg;
+    }
+    return ZX_ERR_INVALID_ARGS;
+}
+
+static inline zx_status_t SpecializedNestedRsp_encode(void* bytes, uint32_t num_bytes, zx_handle_t* handles, uint32_t max_handles, uint32_t* actual_handles_out, const char** error_msg_out) {
+    if (bytes == NULL || num_bytes != sizeof(SpecializedNestedRsp)) {
+        if (error_msg_out != NULL) {
+            *error_msg_out = "message does not match the size of SpecializedNestedRsp";
+        }
+        return ZX_ERR_INVALID_ARGS;
+    }
+    *actual_handles_out = 0u;
+    return ZX_OK;
+}
+
+static inline zx_status_t SpecializedNestedRsp_decode(void* bytes, uint32_t num_bytes, const zx_handle_t* handles, uint32_t num_handles, const char** error_msg_out) {
+    if (bytes == NULL || num_bytes != sizeof(SpecializedNestedRsp) || num_handles != 0u) {
+        if (error_msg_out != NULL) {
+            *error_msg_out = "message does not match the layout of SpecializedNestedRsp";
+        }
+        return ZX_ERR_INVALID_ARGS;
+    }
+    return ZX_OK;
+}
+
+#if defined(__cplusplus)
+}
+#endif
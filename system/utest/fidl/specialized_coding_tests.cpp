@@ -0,0 +1,465 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Checks the coders the fidl compiler emits given --specialize-coding
+// against fidl_encode and fidl_decode.
+//
+// specialized_coding.h is checked in. After changing specialized_coding.fidl2,
+// or the C backend of the compiler, regenerate it with
+//
+//     fidl2 c-structs --specialize-coding specialized_coding.h specialized_coding.fidl2
+//
+// and update the coding tables below to match.
+
+#include <stddef.h>
+#include <string.h>
+
+#include <fbl/algorithm.h>
+#include <fidl/coding.h>
+#include <fidl/internal.h>
+#include <zircon/syscalls.h>
+
+#include <unittest/unittest.h>
+
+#include "specialized_coding.h"
+
+namespace {
+
+const fidl_type_t nonnullable_event_handle =
+    fidl_type_t(fidl::FidlCodedHandle(ZX_OBJ_TYPE_EVENT, fidl::kNonnullable));
+const fidl_type_t nullable_event_handle =
+    fidl_type_t(fidl::FidlCodedHandle(ZX_OBJ_TYPE_EVENT, fidl::kNullable));
+const fidl_type_t nullable_handle =
+    fidl_type_t(fidl::FidlCodedHandle(ZX_OBJ_TYPE_NONE, fidl::kNullable));
+const fidl_type_t array_of_three_nullable_handles = fidl_type_t(
+    fidl::FidlCodedArray(&nullable_handle, 3 * sizeof(zx_handle_t), sizeof(zx_handle_t)));
+const fidl_type_t array_of_two_nullable_event_handles = fidl_type_t(
+    fidl::FidlCodedArray(&nullable_event_handle, 2 * sizeof(zx_handle_t), sizeof(zx_handle_t)));
+const fidl_type_t array_of_two_arrays_of_two_nullable_event_handles =
+    fidl_type_t(fidl::FidlCodedArray(&array_of_two_nullable_event_handles,
+                                     2 * 2 * sizeof(zx_handle_t), 2 * sizeof(zx_handle_t)));
+
+const fidl::FidlField endpoints_fields[] = {
+    fidl::FidlField(&nonnullable_event_handle, offsetof(Endpoints, client)),
+    fidl::FidlField(&nullable_event_handle, offsetof(Endpoints, server)),
+};
+const fidl_type_t endpoints = fidl_type_t(fidl::FidlCodedStruct(
+    endpoints_fields, fbl::count_of(endpoints_fields), sizeof(Endpoints)));
+
+const fidl::FidlField handles_request_fields[] = {
+    fidl::FidlField(&nonnullable_event_handle, offsetof(SpecializedHandlesMsg, required)),
+    fidl::FidlField(&nullable_event_handle, offsetof(SpecializedHandlesMsg, optional)),
+    fidl::FidlField(&array_of_three_nullable_handles, offsetof(SpecializedHandlesMsg, extra)),
+};
+
+const fidl::FidlField handles_response_fields[] = {
+    fidl::FidlField(&nonnullable_event_handle, offsetof(SpecializedHandlesRsp, reply)),
+};
+
+const fidl::FidlField nested_request_fields[] = {
+    fidl::FidlField(&endpoints, offsetof(SpecializedNestedMsg, ends)),
+    fidl::FidlField(&array_of_two_arrays_of_two_nullable_event_handles,
+                    offsetof(SpecializedNestedMsg, grid)),
+};
+
+} // namespace
+
+const fidl_type_t SpecializedPlainReqCoded =
+    fidl_type_t(fidl::FidlCodedStruct(nullptr, 0u, sizeof(SpecializedPlainMsg)));
+const fidl_type_t SpecializedPlainRspCoded =
+    fidl_type_t(fidl::FidlCodedStruct(nullptr, 0u, sizeof(SpecializedPlainRsp)));
+
+const fidl_type_t SpecializedHandlesReqCoded = fidl_type_t(fidl::FidlCodedStruct(
+    handles_request_fields, fbl::count_of(handles_request_fields),
+    sizeof(SpecializedHandlesMsg)));
+const fidl_type_t SpecializedHandlesRspCoded = fidl_type_t(fidl::FidlCodedStruct(
+    handles_response_fields, fbl::count_of(handles_response_fields),
+    sizeof(SpecializedHandlesRsp)));
+
+const fidl_type_t SpecializedNestedReqCoded = fidl_type_t(fidl::FidlCodedStruct(
+    nested_request_fields, fbl::count_of(nested_request_fields),
+    sizeof(SpecializedNestedMsg)));
+const fidl_type_t SpecializedNestedRspCoded =
+    fidl_type_t(fidl::FidlCodedStruct(nullptr, 0u, sizeof(SpecializedNestedRsp)));
+
+namespace fidl {
+namespace {
+
+constexpr uint32_t kMaxHandles = 8u;
+
+using EncodeFunction = zx_status_t (*)(void* bytes, uint32_t num_bytes, zx_handle_t* handles,
+                                       uint32_t max_handles, uint32_t* actual_handles_out,
+                                       const char** error_msg_out);
+using DecodeFunction = zx_status_t (*)(void* bytes, uint32_t num_bytes,
+                                       const zx_handle_t* handles, uint32_t num_handles,
+                                       const char** error_msg_out);
+
+// The handles a test hands to the coders. On success or failure alike,
+// every one of them must stay open and reachable by the caller, either
+// through the message or through the handle table.
+struct Events {
+    zx_handle_t handles[kMaxHandles];
+    uint32_t count = 0u;
+
+    zx_handle_t Create() {
+        zx_handle_t handle = ZX_HANDLE_INVALID;
+        if (count < kMaxHandles && zx_event_create(0u, &handle) == ZX_OK) {
+            handles[count++] = handle;
+        }
+        return handle;
+    }
+};
+
+bool Contains(const void* bytes, size_t num_bytes, zx_handle_t handle) {
+    const zx_handle_t* words = static_cast<const zx_handle_t*>(bytes);
+    for (size_t i = 0; i < num_bytes / sizeof(zx_handle_t); ++i) {
+        if (words[i] == handle) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Checks that each of |events| can still be found in |message| or in the
+// first |num_handles| of |handles|, then closes it. A handle a coder lost,
+// closed or duplicated fails the check.
+template <typename Message>
+bool close_events(Events* events, const Message& message, const zx_handle_t* handles,
+                  uint32_t num_handles) {
+    BEGIN_HELPER;
+    for (uint32_t i = 0; i < events->count; ++i) {
+        zx_handle_t handle = events->handles[i];
+        EXPECT_TRUE(Contains(&message, sizeof(message), handle) ||
+                    Contains(handles, num_handles * sizeof(zx_handle_t), handle),
+                    "a handle was lost");
+        EXPECT_EQ(zx_handle_close(handle), ZX_OK, "a handle was closed");
+    }
+    events->count = 0u;
+    END_HELPER;
+}
+
+// Encodes and then decodes |message| in place, once with the coding table
+// |type| and once with |encode| and |decode|, and checks that both produce
+// the same bytes and handles at each step, and give back |message|.
+template <typename Message>
+bool check_round_trip(const fidl_type_t* type, EncodeFunction encode, DecodeFunction decode,
+                      const Message& message) {
+    BEGIN_HELPER;
+
+    Message table = message;
+    Message specialized = message;
+    zx_handle_t table_handles[kMaxHandles];
+    zx_handle_t specialized_handles[kMaxHandles];
+    uint32_t table_actual = 0u;
+    uint32_t specialized_actual = 0u;
+    const char* error = nullptr;
+
+    ASSERT_EQ(fidl_encode(type, &table, sizeof(table), table_handles, kMaxHandles,
+                          &table_actual, &error),
+              ZX_OK, error);
+    ASSERT_EQ(encode(&specialized, sizeof(specialized), specialized_handles, kMaxHandles,
+                     &specialized_actual, &error),
+              ZX_OK, error);
+    ASSERT_EQ(specialized_actual, table_actual);
+    EXPECT_BYTES_EQ(reinterpret_cast<const uint8_t*>(&table),
+                    reinterpret_cast<const uint8_t*>(&specialized), sizeof(table),
+                    "encoded messages differ");
+    EXPECT_BYTES_EQ(reinterpret_cast<const uint8_t*>(table_handles),
+                    reinterpret_cast<const uint8_t*>(specialized_handles),
+                    table_actual * sizeof(zx_handle_t), "encoded handles differ");
+
+    ASSERT_EQ(fidl_decode(type, &table, sizeof(table), table_handles, table_actual, &error),
+              ZX_OK, error);
+    ASSERT_EQ(decode(&specialized, sizeof(specialized), specialized_handles,
+                     specialized_actual, &error),
+              ZX_OK, error);
+    EXPECT_BYTES_EQ(reinterpret_cast<const uint8_t*>(&table),
+                    reinterpret_cast<const uint8_t*>(&specialized), sizeof(table),
+                    "decoded messages differ");
+    EXPECT_BYTES_EQ(reinterpret_cast<const uint8_t*>(&message),
+                    reinterpret_cast<const uint8_t*>(&specialized), sizeof(message),
+                    "round trip changed the message");
+
+    END_HELPER;
+}
+
+// Builds a SpecializedHandlesMsg whose nullable handles are present
+// according to the bits of |presence|.
+SpecializedHandlesMsg MakeHandlesMessage(Events* events, uint32_t presence) {
+    SpecializedHandlesMsg message = {};
+    message.required = events->Create();
+    message.optional = (presence & 1u) ? events->Create() : ZX_HANDLE_INVALID;
+    for (uint32_t i = 0; i < fbl::count_of(message.extra); ++i) {
+        message.extra[i] = (presence & (2u << i)) ? events->Create() : ZX_HANDLE_INVALID;
+    }
+    return message;
+}
+
+// Builds a SpecializedNestedMsg whose nullable handles are present
+// according to the bits of |presence|.
+SpecializedNestedMsg MakeNestedMessage(Events* events, uint32_t presence) {
+    SpecializedNestedMsg message = {};
+    message.id = 0u;
+    message.ends.client = events->Create();
+    message.ends.server = (presence & 1u) ? events->Create() : ZX_HANDLE_INVALID;
+    for (uint32_t i = 0; i < 2u; ++i) {
+        for (uint32_t j = 0; j < 2u; ++j) {
+            message.grid[i][j] =
+                (presence & (2u << (2u * i + j))) ? events->Create() : ZX_HANDLE_INVALID;
+        }
+    }
+    return message;
+}
+
+bool specialized_fixed_size_messages() {
+    BEGIN_TEST;
+
+    SpecializedPlainMsg request = {};
+    request.hdr.ordinal = 0u;
+    request.value = 0x0123456789abcdefull;
+    for (uint32_t i = 0; i < fbl::count_of(request.tag); ++i) {
+        request.tag[i] = static_cast<uint8_t>(i * 7u);
+    }
+    EXPECT_TRUE(check_round_trip(&SpecializedPlainReqCoded, SpecializedPlainMsg_encode,
+                                 SpecializedPlainMsg_decode, request));
+
+    SpecializedPlainRsp response = {};
+    response.result = -17;
+    EXPECT_TRUE(check_round_trip(&SpecializedPlainRspCoded, SpecializedPlainRsp_encode,
+                                 SpecializedPlainRsp_decode, response));
+
+    SpecializedNestedRsp nested_response = {};
+    nested_response.id = 42u;
+    EXPECT_TRUE(check_round_trip(&SpecializedNestedRspCoded, SpecializedNestedRsp_encode,
+                                 SpecializedNestedRsp_decode, nested_response));
+
+    END_TEST;
+}
+
+bool specialized_inline_handles() {
+    BEGIN_TEST;
+
+    for (uint32_t presence = 0u; presence < 16u; ++presence) {
+        Events events;
+        SpecializedHandlesMsg message = MakeHandlesMessage(&events, presence);
+        EXPECT_TRUE(check_round_trip(&SpecializedHandlesReqCoded, SpecializedHandlesMsg_encode,
+                                     SpecializedHandlesMsg_decode, message));
+        EXPECT_TRUE(close_events(&events, message, nullptr, 0u));
+    }
+
+    Events events;
+    SpecializedHandlesRsp response = {};
+    response.reply = events.Create();
+    EXPECT_TRUE(check_round_trip(&SpecializedHandlesRspCoded, SpecializedHandlesRsp_encode,
+                                 SpecializedHandlesRsp_decode, response));
+    EXPECT_TRUE(close_events(&events, response, nullptr, 0u));
+
+    END_TEST;
+}
+
+bool specialized_embedded_struct_and_nested_arrays() {
+    BEGIN_TEST;
+
+    for (uint32_t presence = 0u; presence < 32u; ++presence) {
+        Events events;
+        SpecializedNestedMsg message = MakeNestedMessage(&events, presence);
+        EXPECT_TRUE(check_round_trip(&SpecializedNestedReqCoded, SpecializedNestedMsg_encode,
+                                     SpecializedNestedMsg_decode, message));
+        EXPECT_TRUE(close_events(&events, message, nullptr, 0u));
+    }
+
+    END_TEST;
+}
+
+bool specialized_encode_too_many_handles_error() {
+    BEGIN_TEST;
+
+    // Every handle present, so five are needed.
+    for (uint32_t max_handles = 0u; max_handles < 5u; ++max_handles) {
+        Events events;
+        SpecializedHandlesMsg message = MakeHandlesMessage(&events, 0xf);
+        SpecializedHandlesMsg table = message;
+        zx_handle_t handles[kMaxHandles] = {};
+        uint32_t actual = 0u;
+        const char* error = nullptr;
+
+        EXPECT_EQ(fidl_encode(&SpecializedHandlesReqCoded, &table, sizeof(table), handles,
+                              max_handles, &actual, &error),
+                  ZX_ERR_INVALID_ARGS);
+        error = nullptr;
+        EXPECT_EQ(SpecializedHandlesMsg_encode(&message, sizeof(message), handles, max_handles,
+                                               &actual, &error),
+                  ZX_ERR_INVALID_ARGS);
+        EXPECT_NONNULL(error);
+        EXPECT_TRUE(close_events(&events, message, handles, max_handles));
+    }
+
+    // A null handle table.
+    {
+        Events events;
+        SpecializedNestedMsg message = MakeNestedMessage(&events, 0u);
+        uint32_t actual = 0u;
+        const char* error = nullptr;
+        EXPECT_EQ(SpecializedNestedMsg_encode(&message, sizeof(message), nullptr, 1u, &actual,
+                                              &error),
+                  ZX_ERR_INVALID_ARGS);
+        EXPECT_NONNULL(error);
+        EXPECT_TRUE(close_events(&events, message, nullptr, 0u));
+    }
+
+    END_TEST;
+}
+
+bool specialized_decode_wrong_handle_count_error() {
+    BEGIN_TEST;
+
+    for (uint32_t presence = 0u; presence < 32u; presence += 5u) {
+        Events events;
+        SpecializedNestedMsg encoded = MakeNestedMessage(&events, presence);
+        zx_handle_t handles[kMaxHandles];
+        uint32_t actual = 0u;
+        const char* error = nullptr;
+        ASSERT_EQ(SpecializedNestedMsg_encode(&encoded, sizeof(encoded), handles, kMaxHandles,
+                                              &actual, &error),
+                  ZX_OK, error);
+        // One handle too many refers to one that does not belong to the
+        // message; it must be left alone.
+        handles[actual] = events.Create();
+
+        for (uint32_t num_handles = 0u; num_handles <= actual + 1u; ++num_handles) {
+            if (num_handles == actual) {
+                continue;
+            }
+            SpecializedNestedMsg table = encoded;
+            SpecializedNestedMsg message = encoded;
+            EXPECT_EQ(fidl_decode(&SpecializedNestedReqCoded, &table, sizeof(table), handles,
+                                  num_handles, &error),
+                      ZX_ERR_INVALID_ARGS);
+            error = nullptr;
+            EXPECT_EQ(SpecializedNestedMsg_decode(&message, sizeof(message), handles,
+                                                  num_handles, &error),
+                      ZX_ERR_INVALID_ARGS);
+            EXPECT_NONNULL(error);
+        }
+
+        EXPECT_TRUE(close_events(&events, encoded, handles, actual + 1u));
+    }
+
+    END_TEST;
+}
+
+bool specialized_decode_invalid_marker_error() {
+    BEGIN_TEST;
+
+    constexpr zx_handle_t kBadMarker = static_cast<zx_handle_t>(23);
+    const uint32_t kBadMarkers[] = {FIDL_HANDLE_ABSENT, kBadMarker};
+
+    for (uint32_t slot = 0u; slot < 5u; ++slot) {
+        for (zx_handle_t marker : kBadMarkers) {
+            Events events;
+            SpecializedHandlesMsg encoded = MakeHandlesMessage(&events, 0xf);
+            zx_handle_t handles[kMaxHandles];
+            uint32_t actual = 0u;
+            const char* error = nullptr;
+            ASSERT_EQ(SpecializedHandlesMsg_encode(&encoded, sizeof(encoded), handles,
+                                                   kMaxHandles, &actual, &error),
+                      ZX_OK, error);
+
+            // An absent marker is only invalid for the non-nullable handle.
+            if (marker == FIDL_HANDLE_ABSENT && slot != 0u) {
+                EXPECT_TRUE(close_events(&events, encoded, handles, actual));
+                continue;
+            }
+            SpecializedHandlesMsg message = encoded;
+            zx_handle_t* slots[] = {&message.required, &message.optional, &message.extra[0],
+                                    &message.extra[1], &message.extra[2]};
+            *slots[slot] = marker;
+            SpecializedHandlesMsg table = message;
+
+            EXPECT_EQ(fidl_decode(&SpecializedHandlesReqCoded, &table, sizeof(table), handles,
+                                  actual, &error),
+                      ZX_ERR_INVALID_ARGS);
+            error = nullptr;
+            EXPECT_EQ(SpecializedHandlesMsg_decode(&message, sizeof(message), handles, actual,
+                                                   &error),
+                      ZX_ERR_INVALID_ARGS);
+            EXPECT_NONNULL(error);
+            EXPECT_TRUE(close_events(&events, encoded, handles, actual));
+        }
+    }
+
+    END_TEST;
+}
+
+bool specialized_size_mismatch_error() {
+    BEGIN_TEST;
+
+    // Messages are padded to FIDL_ALIGNMENT, so the sizes tried are one
+    // short and one alignment unit long.
+    struct {
+        SpecializedPlainMsg message;
+        uint8_t extra[FIDL_ALIGNMENT];
+    } plain = {};
+    const uint32_t plain_sizes[] = {0u, sizeof(plain.message) - 1u,
+                                    sizeof(plain.message) + FIDL_ALIGNMENT};
+    for (uint32_t size : plain_sizes) {
+        uint32_t actual = 0u;
+        const char* error = nullptr;
+        EXPECT_EQ(SpecializedPlainMsg_encode(&plain, size, nullptr, 0u, &actual, &error),
+                  ZX_ERR_INVALID_ARGS);
+        EXPECT_NONNULL(error);
+        error = nullptr;
+        EXPECT_EQ(SpecializedPlainMsg_decode(&plain, size, nullptr, 0u, &error),
+                  ZX_ERR_INVALID_ARGS);
+        EXPECT_NONNULL(error);
+        EXPECT_NE(fidl_decode(&SpecializedPlainReqCoded, &plain, size, nullptr, 0u, &error),
+                  ZX_OK);
+    }
+
+    struct {
+        SpecializedHandlesMsg message;
+        uint8_t extra[FIDL_ALIGNMENT];
+    } handles_message = {};
+    const uint32_t handles_sizes[] = {0u, sizeof(handles_message.message) - 1u,
+                                      sizeof(handles_message.message) + FIDL_ALIGNMENT};
+    for (uint32_t size : handles_sizes) {
+        Events events;
+        handles_message.message = MakeHandlesMessage(&events, 0x5);
+        zx_handle_t handles[kMaxHandles] = {};
+        uint32_t actual = 0u;
+        const char* error = nullptr;
+        EXPECT_EQ(SpecializedHandlesMsg_encode(&handles_message, size, handles, kMaxHandles,
+                                               &actual, &error),
+                  ZX_ERR_INVALID_ARGS);
+        EXPECT_NONNULL(error);
+        EXPECT_TRUE(close_events(&events, handles_message.message, handles, kMaxHandles));
+
+        handles_message.message = MakeHandlesMessage(&events, 0x5);
+        SpecializedHandlesMsg encoded = handles_message.message;
+        ASSERT_EQ(SpecializedHandlesMsg_encode(&encoded, sizeof(encoded), handles, kMaxHandles,
+                                               &actual, &error),
+                  ZX_OK, error);
+        handles_message.message = encoded;
+        error = nullptr;
+        EXPECT_EQ(SpecializedHandlesMsg_decode(&handles_message, size, handles, actual, &error),
+                  ZX_ERR_INVALID_ARGS);
+        EXPECT_NONNULL(error);
+        EXPECT_TRUE(close_events(&events, encoded, handles, actual));
+    }
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(specialized_coding)
+RUN_TEST(specialized_fixed_size_messages)
+RUN_TEST(specialized_inline_handles)
+RUN_TEST(specialized_embedded_struct_and_nested_arrays)
+RUN_TEST(specialized_encode_too_many_handles_error)
+RUN_TEST(specialized_decode_wrong_handle_count_error)
+RUN_TEST(specialized_decode_invalid_marker_error)
+RUN_TEST(specialized_size_mismatch_error)
+END_TEST_CASE(specialized_coding)
+
+} // namespace
+} // namespace fidl
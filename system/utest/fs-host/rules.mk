@@ -20,6 +20,7 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/test-sparse.cpp \
     $(LOCAL_DIR)/test-truncate.cpp \
     system/ulib/bitmap/raw-bitmap.cpp \
+    system/ulib/fs/dentry-cache.cpp \
     system/ulib/fs/vfs.cpp \
     system/ulib/fs/vnode.cpp \
 
@@ -0,0 +1,185 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fs/vfs.h>
+#include <fs/vnode.h>
+
+#include <sys/stat.h>
+
+#include <fbl/ref_ptr.h>
+#include <unittest/unittest.h>
+
+namespace {
+
+class TestFile : public fs::Vnode {
+public:
+    TestFile() = default;
+};
+
+// A directory holding at most one entry, "file", which counts how often the
+// Vfs asks it to look a name up.
+class CountingDir : public fs::Vnode {
+public:
+    CountingDir() = default;
+
+    zx_status_t Lookup(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece name) final {
+        lookups_++;
+        if (file_ == nullptr || name != "file") {
+            return ZX_ERR_NOT_FOUND;
+        }
+        *out = file_;
+        return ZX_OK;
+    }
+
+    zx_status_t Create(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece name,
+                       uint32_t mode) final {
+        if (name != "file") {
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        if (file_ != nullptr) {
+            return ZX_ERR_ALREADY_EXISTS;
+        }
+        file_ = fbl::AdoptRef(new TestFile());
+        *out = file_;
+        return ZX_OK;
+    }
+
+    zx_status_t Unlink(fbl::StringPiece name, bool must_be_dir) final {
+        if (file_ == nullptr || name != "file") {
+            return ZX_ERR_NOT_FOUND;
+        }
+        file_.reset();
+        return ZX_OK;
+    }
+
+    void set_file(fbl::RefPtr<fs::Vnode> file) { file_ = fbl::move(file); }
+    size_t lookups() const { return lookups_; }
+
+private:
+    fbl::RefPtr<fs::Vnode> file_;
+    size_t lookups_ = 0;
+};
+
+// A directory which records when it is destroyed.
+class TrackedDir : public CountingDir {
+public:
+    explicit TrackedDir(bool* destroyed)
+        : destroyed_(destroyed) {}
+    ~TrackedDir() { *destroyed_ = true; }
+
+private:
+    bool* destroyed_;
+};
+
+zx_status_t OpenPath(fs::Vfs* vfs, fbl::RefPtr<CountingDir> dir, const char* path,
+                     uint32_t flags, fbl::RefPtr<fs::Vnode>* out) {
+    fbl::StringPiece pathout;
+    return vfs->Open(fbl::move(dir), out, fbl::StringPiece(path), &pathout,
+                     flags | ZX_FS_FLAG_VNODE_REF_ONLY, S_IFREG);
+}
+
+bool TestCachesLookup() {
+    BEGIN_TEST;
+
+    fs::Vfs vfs;
+    ASSERT_EQ(ZX_OK, vfs.EnableDentryCache());
+    auto dir = fbl::AdoptRef(new CountingDir());
+    fbl::RefPtr<fs::Vnode> file;
+    ASSERT_EQ(ZX_OK, OpenPath(&vfs, dir, "file", ZX_FS_FLAG_CREATE, &file));
+
+    fbl::RefPtr<fs::Vnode> out;
+    EXPECT_EQ(ZX_OK, OpenPath(&vfs, dir, "file", 0, &out));
+    EXPECT_EQ(file.get(), out.get());
+    EXPECT_EQ(1u, dir->lookups());
+    out.reset();
+    EXPECT_EQ(ZX_OK, OpenPath(&vfs, dir, "file", 0, &out));
+    EXPECT_EQ(file.get(), out.get());
+    EXPECT_EQ(1u, dir->lookups());
+
+    END_TEST;
+}
+
+bool TestCachesNegativeLookup() {
+    BEGIN_TEST;
+
+    fs::Vfs vfs;
+    ASSERT_EQ(ZX_OK, vfs.EnableDentryCache());
+    auto dir = fbl::AdoptRef(new CountingDir());
+
+    fbl::RefPtr<fs::Vnode> out;
+    EXPECT_EQ(ZX_ERR_NOT_FOUND, OpenPath(&vfs, dir, "missing", 0, &out));
+    EXPECT_EQ(ZX_ERR_NOT_FOUND, OpenPath(&vfs, dir, "missing", 0, &out));
+    EXPECT_EQ(1u, dir->lookups());
+
+    END_TEST;
+}
+
+bool TestInvalidatesOnUnlinkAndCreate() {
+    BEGIN_TEST;
+
+    fs::Vfs vfs;
+    ASSERT_EQ(ZX_OK, vfs.EnableDentryCache());
+    auto dir = fbl::AdoptRef(new CountingDir());
+    fbl::RefPtr<fs::Vnode> out;
+
+    // Cache "file" as missing, then create it behind the cached entry.
+    EXPECT_EQ(ZX_ERR_NOT_FOUND, OpenPath(&vfs, dir, "file", 0, &out));
+    EXPECT_EQ(ZX_OK, OpenPath(&vfs, dir, "file", ZX_FS_FLAG_CREATE, &out));
+    fbl::RefPtr<fs::Vnode> created = fbl::move(out);
+    EXPECT_EQ(ZX_OK, OpenPath(&vfs, dir, "file", 0, &out));
+    EXPECT_EQ(created.get(), out.get());
+    out.reset();
+    created.reset();
+
+    EXPECT_EQ(ZX_OK, vfs.Unlink(dir, fbl::StringPiece("file")));
+    EXPECT_EQ(ZX_ERR_NOT_FOUND, OpenPath(&vfs, dir, "file", 0, &out));
+    EXPECT_EQ(3u, dir->lookups());
+
+    END_TEST;
+}
+
+bool TestUnlinkReleasesEvictedDirectory() {
+    BEGIN_TEST;
+
+    fs::Vfs vfs;
+    ASSERT_EQ(ZX_OK, vfs.EnableDentryCache(1));
+    auto dir = fbl::AdoptRef(new CountingDir());
+    bool destroyed = false;
+    dir->set_file(fbl::AdoptRef(new TrackedDir(&destroyed)));
+
+    // Caching "missing" beneath "file" evicts the entry for "file" itself,
+    // leaving only an entry which refers to it as a parent.
+    fbl::RefPtr<fs::Vnode> out;
+    EXPECT_EQ(ZX_ERR_NOT_FOUND, OpenPath(&vfs, dir, "file/missing", 0, &out));
+    EXPECT_FALSE(destroyed);
+
+    EXPECT_EQ(ZX_OK, vfs.Unlink(dir, fbl::StringPiece("file")));
+    EXPECT_TRUE(destroyed);
+
+    END_TEST;
+}
+
+bool TestUncachedByDefault() {
+    BEGIN_TEST;
+
+    fs::Vfs vfs;
+    auto dir = fbl::AdoptRef(new CountingDir());
+
+    fbl::RefPtr<fs::Vnode> out;
+    EXPECT_EQ(ZX_ERR_NOT_FOUND, OpenPath(&vfs, dir, "missing", 0, &out));
+    EXPECT_EQ(ZX_ERR_NOT_FOUND, OpenPath(&vfs, dir, "missing", 0, &out));
+    EXPECT_EQ(2u, dir->lookups());
+
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(dentry_cache_tests)
+RUN_TEST(TestCachesLookup)
+RUN_TEST(TestCachesNegativeLookup)
+RUN_TEST(TestInvalidatesOnUnlinkAndCreate)
+RUN_TEST(TestUnlinkReleasesEvictedDirectory)
+RUN_TEST(TestUncachedByDefault)
+END_TEST_CASE(dentry_cache_tests)
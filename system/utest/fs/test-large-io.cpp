@@ -0,0 +1,120 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <zircon/syscalls.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
+#include <fdio/limits.h>
+#include <unittest/unittest.h>
+
+#include "filesystems.h"
+
+// Large enough to need several transfer vmo round trips, and not a
+// multiple of either FDIO_CHUNK_SIZE or FDIO_XFER_VMO_SIZE.
+constexpr size_t kLargeSize = FDIO_XFER_VMO_SIZE * 2 + 12345;
+
+static void fill_random(uint8_t* buf, size_t len) {
+    unsigned int seed = static_cast<unsigned int>(zx_ticks_get());
+    unittest_printf("Large I/O test using seed: %u\n", seed);
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = static_cast<uint8_t>(rand_r(&seed));
+    }
+}
+
+bool test_large_read_write(void) {
+    BEGIN_TEST;
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> wbuf(new (&ac) uint8_t[kLargeSize]);
+    ASSERT_TRUE(ac.check());
+    fbl::unique_ptr<uint8_t[]> rbuf(new (&ac) uint8_t[kLargeSize]);
+    ASSERT_TRUE(ac.check());
+    fill_random(wbuf.get(), kLargeSize);
+
+    int fd = open("::large", O_RDWR | O_CREAT, 0644);
+    ASSERT_GT(fd, 0);
+    ASSERT_EQ(write(fd, wbuf.get(), kLargeSize), static_cast<ssize_t>(kLargeSize));
+    ASSERT_EQ(lseek(fd, 0, SEEK_CUR), static_cast<off_t>(kLargeSize));
+    ASSERT_EQ(lseek(fd, 0, SEEK_SET), 0);
+    ASSERT_EQ(read(fd, rbuf.get(), kLargeSize), static_cast<ssize_t>(kLargeSize));
+    ASSERT_EQ(memcmp(rbuf.get(), wbuf.get(), kLargeSize), 0);
+
+    // Reading past the end is short, and leaves the offset at the end.
+    constexpr size_t kTail = 4321;
+    ASSERT_EQ(lseek(fd, kLargeSize - kTail, SEEK_SET), static_cast<off_t>(kLargeSize - kTail));
+    ASSERT_EQ(read(fd, rbuf.get(), kLargeSize), static_cast<ssize_t>(kTail));
+    ASSERT_EQ(memcmp(rbuf.get(), &wbuf[kLargeSize - kTail], kTail), 0);
+    ASSERT_EQ(lseek(fd, 0, SEEK_CUR), static_cast<off_t>(kLargeSize));
+
+    ASSERT_EQ(close(fd), 0);
+    ASSERT_EQ(unlink("::large"), 0);
+    END_TEST;
+}
+
+bool test_large_pread_pwrite(void) {
+    BEGIN_TEST;
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> wbuf(new (&ac) uint8_t[kLargeSize]);
+    ASSERT_TRUE(ac.check());
+    fbl::unique_ptr<uint8_t[]> rbuf(new (&ac) uint8_t[kLargeSize]);
+    ASSERT_TRUE(ac.check());
+    fill_random(wbuf.get(), kLargeSize);
+
+    int fd = open("::large", O_RDWR | O_CREAT, 0644);
+    ASSERT_GT(fd, 0);
+    constexpr off_t kOffset = 777;
+    ASSERT_EQ(pwrite(fd, wbuf.get(), kLargeSize, kOffset), static_cast<ssize_t>(kLargeSize));
+    ASSERT_EQ(pread(fd, rbuf.get(), kLargeSize, kOffset), static_cast<ssize_t>(kLargeSize));
+    ASSERT_EQ(memcmp(rbuf.get(), wbuf.get(), kLargeSize), 0);
+
+    // Positional I/O does not move the seek offset.
+    ASSERT_EQ(lseek(fd, 0, SEEK_CUR), 0);
+    struct stat st;
+    ASSERT_EQ(fstat(fd, &st), 0);
+    ASSERT_EQ(st.st_size, static_cast<off_t>(kLargeSize + kOffset));
+
+    ASSERT_EQ(close(fd), 0);
+    ASSERT_EQ(unlink("::large"), 0);
+    END_TEST;
+}
+
+bool test_large_append(void) {
+    BEGIN_TEST;
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> wbuf(new (&ac) uint8_t[kLargeSize]);
+    ASSERT_TRUE(ac.check());
+    fbl::unique_ptr<uint8_t[]> rbuf(new (&ac) uint8_t[kLargeSize]);
+    ASSERT_TRUE(ac.check());
+    fill_random(wbuf.get(), kLargeSize);
+
+    int fd = open("::large", O_RDWR | O_CREAT | O_APPEND, 0644);
+    ASSERT_GT(fd, 0);
+    constexpr size_t kFirst = 100;
+    ASSERT_EQ(write(fd, wbuf.get(), kFirst), static_cast<ssize_t>(kFirst));
+    ASSERT_EQ(lseek(fd, 0, SEEK_SET), 0);
+    ASSERT_EQ(write(fd, &wbuf[kFirst], kLargeSize - kFirst),
+              static_cast<ssize_t>(kLargeSize - kFirst));
+    ASSERT_EQ(lseek(fd, 0, SEEK_CUR), static_cast<off_t>(kLargeSize));
+    ASSERT_EQ(pread(fd, rbuf.get(), kLargeSize, 0), static_cast<ssize_t>(kLargeSize));
+    ASSERT_EQ(memcmp(rbuf.get(), wbuf.get(), kLargeSize), 0);
+
+    ASSERT_EQ(close(fd), 0);
+    ASSERT_EQ(unlink("::large"), 0);
+    END_TEST;
+}
+
+RUN_FOR_ALL_FILESYSTEMS(large_io_tests,
+    RUN_TEST_MEDIUM(test_large_read_write)
+    RUN_TEST_MEDIUM(test_large_pread_pwrite)
+    RUN_TEST_MEDIUM(test_large_append)
+)
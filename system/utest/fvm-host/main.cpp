@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <fbl/algorithm.h>
 #include <fbl/string.h>
 #include <fbl/unique_fd.h>
 #include <fvm/container.h>
@@ -21,6 +22,8 @@ static char system_path[PATH_MAX];
 static char blobfs_path[PATH_MAX];
 static char sparse_path[PATH_MAX];
 static char sparse_lz4_path[PATH_MAX];
+static char sparse_lz4_serial_path[PATH_MAX];
+static char sparse_out_path[PATH_MAX];
 static char fvm_path[PATH_MAX];
 
 constexpr uint32_t kData      = 1;
@@ -29,6 +32,8 @@ constexpr uint32_t kBlobfs    = 4;
 constexpr uint32_t kSparse    = 8;
 constexpr uint32_t kSparseLz4 = 16;
 constexpr uint32_t kFvm       = 32;
+constexpr uint32_t kSparseLz4Serial = 64;
+constexpr uint32_t kSparseOut = 128;
 
 // gFileFlags indicates which of the above files has been successfully created.
 // Keeping track of these across each individual test allows us to unlink only files that actually
@@ -118,13 +123,16 @@ bool AddPartitions(Container* container) {
 }
 
 
-bool CreateSparse(compress_type_t compress) {
+bool CreateSparse(compress_type_t compress, unsigned threads = 0) {
     BEGIN_HELPER;
     char* path = compress ? sparse_lz4_path : sparse_path;
     printf("Creating sparse container: %s\n", path);
     fbl::unique_ptr<SparseContainer> sparseContainer;
     ASSERT_EQ(SparseContainer::Create(path, SLICE_SIZE, compress, &sparseContainer), ZX_OK,
               "Failed to initialize sparse container");
+    if (threads) {
+        sparseContainer->SetCompressionThreads(threads);
+    }
     gFileFlags |= compress ? kSparseLz4 : kSparse;
     ASSERT_TRUE(AddPartitions(sparseContainer.get()));
     ASSERT_EQ(sparseContainer->Commit(), ZX_OK, "Failed to write to sparse file");
@@ -141,6 +149,24 @@ bool StatFile(const char* path, off_t* length) {
     END_HELPER;
 }
 
+bool CompareFiles(const char* path_a, const char* path_b) {
+    BEGIN_HELPER;
+    fbl::unique_fd fd_a(open(path_a, O_RDONLY));
+    ASSERT_TRUE(fd_a, "Unable to open file");
+    fbl::unique_fd fd_b(open(path_b, O_RDONLY));
+    ASSERT_TRUE(fd_b, "Unable to open file");
+    uint8_t buf_a[8192];
+    uint8_t buf_b[8192];
+    ssize_t r;
+    while ((r = read(fd_a.get(), buf_a, sizeof(buf_a))) > 0) {
+        ASSERT_EQ(read(fd_b.get(), buf_b, r), r, "Files differ in length");
+        ASSERT_EQ(memcmp(buf_a, buf_b, r), 0, "Files differ");
+    }
+    ASSERT_EQ(r, 0, "Unable to read file");
+    ASSERT_EQ(read(fd_b.get(), buf_b, sizeof(buf_b)), 0, "Files differ in length");
+    END_HELPER;
+}
+
 bool ReportContainer(const char* path, off_t offset) {
     fbl::unique_ptr<Container> container;
     off_t length;
@@ -220,6 +246,55 @@ bool GenerateData(size_t len, fbl::unique_ptr<uint8_t[]>* out) {
     END_HELPER;
 }
 
+bool WriteSparseFile(const char* path, uint32_t type, uint32_t flags, const void* data,
+                     size_t len) {
+    BEGIN_HELPER;
+    fvm::sparse_image_t image;
+    memset(&image, 0, sizeof(image));
+    image.magic = fvm::kSparseFormatMagic;
+    image.version = fvm::kSparseFormatVersion;
+    image.header_length = sizeof(image);
+    image.slice_size = SLICE_SIZE;
+    image.partition_count = 0;
+    image.flags = flags;
+
+    fbl::unique_fd fd(open(path, O_WRONLY | O_CREAT | O_EXCL, 0644));
+    ASSERT_TRUE(fd, "Unable to create file");
+    gFileFlags |= type;
+    ASSERT_EQ(write(fd.get(), &image, sizeof(image)), static_cast<ssize_t>(sizeof(image)));
+    ASSERT_EQ(write(fd.get(), data, len), static_cast<ssize_t>(len));
+    END_HELPER;
+}
+
+// Writes a sparse file and its LZ4 counterpart whose data is |len| bytes of partly compressible
+// data, compressed into a single frame exactly as SparseContainer frames it. A |len| which is not
+// a multiple of the block size leaves the last block of the frame short.
+bool CreateSparseFrame(size_t len) {
+    BEGIN_HELPER;
+    fbl::unique_ptr<uint8_t[]> data;
+    ASSERT_TRUE(GenerateData(len, &data));
+    // Zero every other block so that the frame holds both compressed and stored blocks.
+    for (size_t off = 0; off < len; off += 2 * LZ4_MAX_BLOCK_SIZE) {
+        memset(&data[off], 0, fbl::min(len - off, static_cast<size_t>(LZ4_MAX_BLOCK_SIZE)));
+    }
+
+    LZ4F_preferences_t prefs;
+    memset(&prefs, 0, sizeof(prefs));
+    prefs.frameInfo.blockSizeID = LZ4F_max64KB;
+    prefs.frameInfo.blockMode = LZ4F_blockIndependent;
+    size_t max = LZ4F_compressFrameBound(len, &prefs);
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> frame(new (&ac) uint8_t[max]);
+    ASSERT_TRUE(ac.check());
+    size_t frame_len = LZ4F_compressFrame(frame.get(), max, data.get(), len, &prefs);
+    ASSERT_FALSE(LZ4F_isError(frame_len), "Failed to compress data");
+
+    ASSERT_TRUE(WriteSparseFile(sparse_path, kSparse, 0, data.get(), len));
+    ASSERT_TRUE(WriteSparseFile(sparse_lz4_path, kSparseLz4, fvm::kSparseFlagLz4, frame.get(),
+                                frame_len));
+    END_HELPER;
+}
+
 bool AddDirectoryMinfs(char* path) {
     BEGIN_HELPER;
     ASSERT_EQ(emu_mkdir(path, 0755), 0);
@@ -271,7 +346,7 @@ bool PopulateSystem(size_t ndirs, size_t nfiles, size_t max_size) {
     return PopulateMinfs(system_path, ndirs, nfiles, max_size);
 }
 
-bool AddFileBlobstore(blobstore::Blobstore* bs, size_t size) {
+bool AddFileBlobstore(blobstore::Blobstore* bs, size_t size, bool compress) {
     BEGIN_HELPER;
     char new_file[PATH_MAX];
     GenerateFilename(test_dir, 10, new_file);;
@@ -280,7 +355,8 @@ bool AddFileBlobstore(blobstore::Blobstore* bs, size_t size) {
     fbl::unique_ptr<uint8_t[]> data;
     ASSERT_TRUE(GenerateData(size, &data));
     ASSERT_EQ(write(datafd.get(), data.get(), size), size, "Failed to write data to file");
-    ASSERT_EQ(blobstore::blobstore_add_blob(bs, datafd.get()), ZX_OK, "Failed to add blob");
+    ASSERT_EQ(blobstore::blobstore_add_blob(bs, datafd.get(), compress), ZX_OK,
+              "Failed to add blob");
     ASSERT_EQ(unlink(new_file), 0);
     END_HELPER;
 }
@@ -295,7 +371,7 @@ bool PopulateBlobstore(size_t nfiles, size_t max_size) {
               "Failed to create blobstore");
     for (unsigned i = 0; i < nfiles; i++) {
         size_t size = 1 + (rand() % max_size);
-        ASSERT_TRUE(AddFileBlobstore(bs.get(), size));
+        ASSERT_TRUE(AddFileBlobstore(bs.get(), size, i % 2 == 0));
     }
     END_HELPER;
 }
@@ -339,6 +415,14 @@ bool DestroyAll() {
         ASSERT_TRUE(Destroy(sparse_lz4_path, kSparseLz4));
     }
 
+    if (gFileFlags & kSparseLz4Serial) {
+        ASSERT_TRUE(Destroy(sparse_lz4_serial_path, kSparseLz4Serial));
+    }
+
+    if (gFileFlags & kSparseOut) {
+        ASSERT_TRUE(Destroy(sparse_out_path, kSparseOut));
+    }
+
     if (gFileFlags & kFvm) {
         ASSERT_TRUE(Destroy(fvm_path, kFvm));
     }
@@ -347,6 +431,26 @@ bool DestroyAll() {
     END_HELPER;
 }
 
+// Decompresses the LZ4 sparse file with |threads| decompression threads and checks that the
+// result matches the uncompressed sparse file.
+bool CheckSparseReader(size_t threads) {
+    BEGIN_HELPER;
+    printf("Decompressing sparse file with %zu threads\n", threads);
+    fbl::unique_fd infd(open(sparse_lz4_path, O_RDONLY));
+    ASSERT_TRUE(infd, "Unable to open file");
+    fbl::unique_ptr<fvm::SparseReader> reader;
+    ASSERT_EQ(fvm::SparseReader::Create(fbl::move(infd), threads, &reader), ZX_OK,
+              "Failed to initialize sparse reader");
+    fbl::unique_fd outfd(open(sparse_out_path, O_WRONLY | O_CREAT | O_EXCL, 0644));
+    ASSERT_TRUE(outfd, "Unable to create file");
+    gFileFlags |= kSparseOut;
+    ASSERT_EQ(reader->WriteDecompressed(fbl::move(outfd)), ZX_OK, "Failed to decompress");
+    reader.reset();
+    ASSERT_TRUE(CompareFiles(sparse_path, sparse_out_path));
+    ASSERT_TRUE(Destroy(sparse_out_path, kSparseOut));
+    END_HELPER;
+}
+
 bool CreatePartitions() {
     BEGIN_HELPER;
     ASSERT_TRUE(CreateData());
@@ -409,6 +513,51 @@ bool TestPartitions() {
     END_TEST;
 }
 
+// Compression is split between threads, but the sparse file must not depend on how many.
+template <size_t NumDirs, size_t NumFiles, size_t MaxSize>
+bool TestCompressionThreads() {
+    BEGIN_TEST;
+    ASSERT_TRUE(CreatePartitions());
+    ASSERT_TRUE(PopulatePartitions(NumDirs, NumFiles, MaxSize));
+    ASSERT_TRUE(CreateSparse(LZ4, 1));
+    ASSERT_EQ(rename(sparse_lz4_path, sparse_lz4_serial_path), 0);
+    gFileFlags = (gFileFlags & ~kSparseLz4) | kSparseLz4Serial;
+    ASSERT_TRUE(CreateSparse(LZ4, 3));
+    ASSERT_TRUE(CompareFiles(sparse_lz4_serial_path, sparse_lz4_path));
+    ASSERT_TRUE(ReportSparse(LZ4));
+    ASSERT_TRUE(DestroyAll());
+    END_TEST;
+}
+
+constexpr size_t kReaderThreads[] = {1, 2, 3, 8};
+
+// The reader decompresses batches of blocks on several threads; the output must not depend on how
+// many, nor on where the batches fall relative to the end of the frame.
+template <size_t NumDirs, size_t NumFiles, size_t MaxSize>
+bool TestDecompressionThreads() {
+    BEGIN_TEST;
+    ASSERT_TRUE(CreatePartitions());
+    ASSERT_TRUE(PopulatePartitions(NumDirs, NumFiles, MaxSize));
+    ASSERT_TRUE(CreateSparse(NONE));
+    ASSERT_TRUE(CreateSparse(LZ4));
+    for (size_t threads : kReaderThreads) {
+        ASSERT_TRUE(CheckSparseReader(threads));
+    }
+    ASSERT_TRUE(DestroyAll());
+    END_TEST;
+}
+
+template <size_t Length>
+bool TestDecompressionShortBlock() {
+    BEGIN_TEST;
+    ASSERT_TRUE(CreateSparseFrame(Length));
+    for (size_t threads : kReaderThreads) {
+        ASSERT_TRUE(CheckSparseReader(threads));
+    }
+    ASSERT_TRUE(DestroyAll());
+    END_TEST;
+}
+
 bool Setup() {
     BEGIN_HELPER;
     srand(time(0));
@@ -420,6 +569,8 @@ bool Setup() {
     sprintf(blobfs_path, "%sblobfs.bin", test_dir);
     sprintf(sparse_path, "%ssparse.bin", test_dir);
     sprintf(sparse_lz4_path, "%ssparse.bin.lz4", test_dir);
+    sprintf(sparse_lz4_serial_path, "%ssparse-serial.bin.lz4", test_dir);
+    sprintf(sparse_out_path, "%ssparse-out.bin", test_dir);
     sprintf(fvm_path, "%sfvm.bin", test_dir);
     END_HELPER;
 }
@@ -460,6 +611,10 @@ RUN_TEST_MEDIUM((TestPartitions<SPARSE_LZ4, 10, 100, (1 << 20)>))
 RUN_TEST_MEDIUM((TestPartitions<FVM, 10, 100, (1 << 20)>))
 RUN_TEST_MEDIUM((TestPartitions<FVM_NEW, 10, 100, (1 << 20)>))
 RUN_TEST_MEDIUM((TestPartitions<FVM_OFFSET, 10, 100, (1 << 20)>))
+RUN_TEST_MEDIUM((TestCompressionThreads<10, 100, (1 << 20)>))
+RUN_TEST_MEDIUM((TestDecompressionThreads<10, 100, (1 << 20)>))
+RUN_TEST_MEDIUM(TestDecompressionShortBlock<21 * LZ4_MAX_BLOCK_SIZE + 1000>)
+RUN_TEST_MEDIUM(TestDecompressionShortBlock<LZ4_MAX_BLOCK_SIZE - 1>)
 END_TEST_CASE(fvm_host_tests)
 
 int main(int argc, char** argv) {
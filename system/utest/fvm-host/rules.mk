@@ -40,7 +40,6 @@ MODULE_COMPILEFLAGS := \
 
 MODULE_HOST_LIBS := \
     third_party/ulib/uboringssl.hostlib \
-    third_party/ulib/lz4.hostlib \
     system/ulib/fvm.hostlib \
     system/ulib/unittest.hostlib \
     system/ulib/pretty.hostlib \
@@ -48,6 +47,9 @@ MODULE_HOST_LIBS := \
     system/ulib/fbl.hostlib \
     system/ulib/digest.hostlib \
     system/uapp/blobstore.hostlib \
+    third_party/ulib/lz4.hostlib \
+
+MODULE_HOST_SYSLIBS := -lpthread
 
 MODULE_DEFINES += DISABLE_THREAD_ANNOTATIONS
 
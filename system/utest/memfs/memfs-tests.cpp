@@ -5,11 +5,14 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <threads.h>
 #include <unistd.h>
 
 #include <async/cpp/loop.h>
+#include <fbl/atomic.h>
 #include <fdio/util.h>
 #include <memfs/memfs.h>
 #include <unittest/unittest.h>
@@ -130,10 +133,117 @@ bool test_memfs_close_during_access() {
     END_TEST;
 }
 
+constexpr int kConcurrentFiles = 8;
+constexpr int kConcurrentOpens = 500;
+
+struct ConcurrentOpenArgs {
+    int dirfd;
+    int seed;
+    fbl::atomic<bool>* stop;
+    fbl::atomic<int>* failures;
+};
+
+// Repeatedly opens files under "a/b", checking that each one opens as the
+// file it names, and that a missing name is reported as such.
+int ConcurrentOpenWorker(void* arg) {
+    auto args = static_cast<ConcurrentOpenArgs*>(arg);
+    for (int i = 0; i < kConcurrentOpens; i++) {
+        int n = (args->seed + i) % kConcurrentFiles;
+        char path[32];
+        snprintf(path, sizeof(path), "a/b/file-%d", n);
+        int fd = openat(args->dirfd, path, O_RDONLY);
+        char c;
+        if (fd < 0 || read(fd, &c, 1) != 1 || c != 'a' + n) {
+            args->failures->fetch_add(1);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (openat(args->dirfd, "a/b/missing", O_RDONLY) >= 0 || errno != ENOENT) {
+            args->failures->fetch_add(1);
+        }
+    }
+    return 0;
+}
+
+// Creates and removes a file next to the ones being opened.
+int ConcurrentChurnWorker(void* arg) {
+    auto args = static_cast<ConcurrentOpenArgs*>(arg);
+    while (!args->stop->load()) {
+        int fd = openat(args->dirfd, "a/b/churn", O_CREAT | O_RDWR);
+        if (fd < 0) {
+            args->failures->fetch_add(1);
+            break;
+        }
+        close(fd);
+        if (unlinkat(args->dirfd, "a/b/churn", 0) != 0) {
+            args->failures->fetch_add(1);
+            break;
+        }
+    }
+    return 0;
+}
+
+bool test_memfs_concurrent_open() {
+    BEGIN_TEST;
+
+    // Serve the filesystem from several threads, so that opens run side by
+    // side in the Vfs.
+    async::Loop loop;
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(loop.StartThread(), ZX_OK);
+    }
+
+    memfs_filesystem_t* vfs;
+    zx_handle_t root;
+    ASSERT_EQ(memfs_create_filesystem(loop.async(), &vfs, &root), ZX_OK);
+    uint32_t type = PA_FDIO_REMOTE;
+    int dirfd;
+    ASSERT_EQ(fdio_create_fd(&root, &type, 1, &dirfd), ZX_OK);
+
+    ASSERT_EQ(mkdirat(dirfd, "a", 0755), 0);
+    ASSERT_EQ(mkdirat(dirfd, "a/b", 0755), 0);
+    for (int n = 0; n < kConcurrentFiles; n++) {
+        char path[32];
+        snprintf(path, sizeof(path), "a/b/file-%d", n);
+        int fd = openat(dirfd, path, O_CREAT | O_RDWR);
+        ASSERT_GE(fd, 0);
+        char c = static_cast<char>('a' + n);
+        ASSERT_EQ(write(fd, &c, 1), 1);
+        ASSERT_EQ(close(fd), 0);
+    }
+
+    fbl::atomic<bool> stop(false);
+    fbl::atomic<int> failures(0);
+    constexpr int kThreads = 4;
+    ConcurrentOpenArgs args[kThreads + 1];
+    thrd_t threads[kThreads + 1];
+    for (int i = 0; i <= kThreads; i++) {
+        args[i] = {dirfd, i * 3, &stop, &failures};
+        ASSERT_EQ(thrd_create(&threads[i],
+                              i < kThreads ? ConcurrentOpenWorker : ConcurrentChurnWorker,
+                              &args[i]),
+                  thrd_success);
+    }
+    for (int i = 0; i < kThreads; i++) {
+        ASSERT_EQ(thrd_join(threads[i], nullptr), thrd_success);
+    }
+    stop.store(true);
+    ASSERT_EQ(thrd_join(threads[kThreads], nullptr), thrd_success);
+    EXPECT_EQ(failures.load(), 0);
+
+    ASSERT_EQ(close(dirfd), 0);
+    loop.Shutdown();
+    ASSERT_EQ(memfs_free_filesystem(vfs, 0), ZX_OK);
+
+    END_TEST;
+}
+
 } // namespace
 
 BEGIN_TEST_CASE(memfs_tests)
 RUN_TEST(test_memfs_null)
 RUN_TEST(test_memfs_basic)
 RUN_TEST(test_memfs_close_during_access)
+RUN_TEST(test_memfs_concurrent_open)
 END_TEST_CASE(memfs_tests)
@@ -768,6 +768,81 @@ bool ramdisk_test_fifo_unclean_shutdown(void) {
     END_TEST;
 }
 
+// Closes the fifo while the block server still has requests in flight, which
+// the server must wait out before it is freed.
+bool ramdisk_test_fifo_close_with_requests_outstanding(void) {
+    BEGIN_TEST;
+    // Set up the ramdisk
+    const size_t kBlockSize = PAGE_SIZE;
+    const uint64_t kBlockCount = 1 << 12;
+    int fd = get_ramdisk(kBlockSize, kBlockCount);
+
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(kBlockCount * kBlockSize, 0, &vmo), ZX_OK, "Failed to create VMO");
+    // Leave a sync among the writes, so that the server may be waiting on
+    // the device when the fifo closes.
+    constexpr size_t kRequests = MAX_TXN_MESSAGES;
+    constexpr size_t kSyncRequest = kRequests / 2;
+    const uint64_t kLength = kBlockCount / kRequests;
+    for (size_t round = 0; round < 16; round++) {
+        // The server for the previous round may still be on its way out.
+        zx_handle_t fifo;
+        ssize_t r;
+        while ((r = ioctl_block_get_fifos(fd, &fifo)) == ZX_ERR_ALREADY_BOUND) {
+            usleep(1000);
+        }
+        ASSERT_EQ(r, static_cast<ssize_t>(sizeof(fifo)), "Failed to get FIFO");
+        txnid_t txnid;
+        ASSERT_EQ(ioctl_block_alloc_txn(fd, &txnid), static_cast<ssize_t>(sizeof(txnid_t)),
+                  "Failed to allocate txn");
+        zx_handle_t xfer_vmo;
+        ASSERT_EQ(zx_handle_duplicate(vmo, ZX_RIGHT_SAME_RIGHTS, &xfer_vmo), ZX_OK);
+        vmoid_t vmoid;
+        ASSERT_EQ(ioctl_block_attach_vmo(fd, &xfer_vmo, &vmoid),
+                  static_cast<ssize_t>(sizeof(vmoid_t)), "Failed to attach vmo");
+
+        // Hand the server a full txn of large writes, then hang up without
+        // waiting for the response.
+        block_fifo_request_t requests[kRequests];
+        for (size_t i = 0; i < kRequests; i++) {
+            requests[i].txnid      = txnid;
+            requests[i].vmoid      = vmoid;
+            requests[i].opcode     = (i == kSyncRequest) ? BLOCKIO_SYNC : BLOCKIO_WRITE;
+            requests[i].length     = static_cast<uint32_t>(kLength);
+            requests[i].vmo_offset = i * kLength;
+            requests[i].dev_offset = i * kLength;
+        }
+        uint32_t actual;
+        ASSERT_EQ(zx_fifo_write(fifo, requests, sizeof(requests), &actual), ZX_OK);
+        ASSERT_EQ(actual, kRequests);
+        ASSERT_EQ(zx_handle_close(fifo), ZX_OK);
+    }
+
+    // The block server should still be functioning.
+    zx_handle_t fifo;
+    ssize_t r;
+    while ((r = ioctl_block_get_fifos(fd, &fifo)) == ZX_ERR_ALREADY_BOUND) {
+        usleep(1000);
+    }
+    ASSERT_EQ(r, static_cast<ssize_t>(sizeof(fifo)), "Failed to get FIFO");
+    fifo_client_t* client;
+    ASSERT_EQ(block_fifo_create_client(fifo, &client), ZX_OK);
+    txnid_t txnid;
+    ASSERT_EQ(ioctl_block_alloc_txn(fd, &txnid), static_cast<ssize_t>(sizeof(txnid_t)),
+              "Failed to allocate txn");
+    test_vmo_object_t obj;
+    ASSERT_TRUE(create_vmo_helper(fd, &obj, kBlockSize));
+    ASSERT_TRUE(write_striped_vmo_helper(client, &obj, 0, 1, txnid, kBlockSize));
+    ASSERT_TRUE(read_striped_vmo_helper(client, &obj, 0, 1, txnid, kBlockSize));
+    ASSERT_TRUE(close_vmo_helper(client, &obj, txnid));
+
+    ASSERT_EQ(zx_handle_close(vmo), ZX_OK);
+    block_fifo_release_client(client);
+    ASSERT_GE(ioctl_ramdisk_unlink(fd), 0, "Could not unlink ramdisk device");
+    ASSERT_EQ(close(fd), 0);
+    END_TEST;
+}
+
 bool ramdisk_test_fifo_large_ops_count(void) {
     BEGIN_TEST;
     // Set up the ramdisk
@@ -951,6 +1026,97 @@ bool ramdisk_test_fifo_intermediate_op_failure(void) {
     END_TEST;
 }
 
+bool ramdisk_test_fifo_adjacent_requests(void) {
+    BEGIN_TEST;
+    // Set up the ramdisk
+    const size_t kBlockSize = PAGE_SIZE;
+    int fd = get_ramdisk(kBlockSize, 1 << 10);
+
+    // Create a connection to the ramdisk
+    zx_handle_t fifo;
+    ssize_t expected = sizeof(fifo);
+    ASSERT_EQ(ioctl_block_get_fifos(fd, &fifo), expected, "Failed to get FIFO");
+    fifo_client_t* client;
+    ASSERT_EQ(block_fifo_create_client(fifo, &client), ZX_OK);
+    txnid_t txnid;
+    expected = sizeof(txnid_t);
+    ASSERT_EQ(ioctl_block_alloc_txn(fd, &txnid), expected, "Failed to allocate txn");
+
+    // Create a vmo with one block per message
+    constexpr size_t kBlocks = MAX_TXN_MESSAGES;
+    constexpr size_t kBufferSize = kBlocks * kBlockSize;
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(kBufferSize, 0, &vmo), ZX_OK, "Failed to create VMO");
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> buf(new (&ac) uint8_t[kBufferSize]);
+    ASSERT_TRUE(ac.check());
+    fill_random(buf.get(), kBufferSize);
+    size_t actual;
+    ASSERT_EQ(zx_vmo_write(vmo, buf.get(), 0, kBufferSize, &actual), ZX_OK);
+    vmoid_t vmoid;
+    zx_handle_t xfer_vmo;
+    ASSERT_EQ(zx_handle_duplicate(vmo, ZX_RIGHT_SAME_RIGHTS, &xfer_vmo), ZX_OK);
+    expected = sizeof(vmoid_t);
+    ASSERT_EQ(ioctl_block_attach_vmo(fd, &xfer_vmo, &vmoid), expected,
+              "Failed to attach vmo");
+
+    // Write the first half of the vmo as single-block requests which are
+    // adjacent on disk and in the vmo, and the second half back to front.
+    block_fifo_request_t requests[kBlocks];
+    for (size_t i = 0; i < kBlocks; i++) {
+        size_t b = (i < kBlocks / 2) ? i : (kBlocks - 1) - (i - kBlocks / 2);
+        requests[i].txnid      = txnid;
+        requests[i].vmoid      = vmoid;
+        requests[i].opcode     = BLOCKIO_WRITE;
+        requests[i].length     = 1;
+        requests[i].vmo_offset = b;
+        requests[i].dev_offset = b;
+    }
+    ASSERT_EQ(block_fifo_txn(client, &requests[0], kBlocks), ZX_OK);
+
+    // A sync should complete once everything before it has.
+    block_fifo_request_t sync;
+    sync.txnid = txnid;
+    sync.vmoid = vmoid;
+    sync.opcode = BLOCKIO_SYNC;
+    ASSERT_EQ(block_fifo_txn(client, &sync, 1), ZX_OK);
+
+    // Read the whole range back in one request.
+    fbl::unique_ptr<uint8_t[]> out(new (&ac) uint8_t[kBufferSize]());
+    ASSERT_TRUE(ac.check());
+    ASSERT_EQ(zx_vmo_write(vmo, out.get(), 0, kBufferSize, &actual), ZX_OK);
+    requests[0].opcode     = BLOCKIO_READ;
+    requests[0].length     = kBlocks;
+    requests[0].vmo_offset = 0;
+    requests[0].dev_offset = 0;
+    ASSERT_EQ(block_fifo_txn(client, &requests[0], 1), ZX_OK);
+    ASSERT_EQ(zx_vmo_read(vmo, out.get(), 0, kBufferSize, &actual), ZX_OK);
+    ASSERT_EQ(memcmp(buf.get(), out.get(), kBufferSize), 0, "Read data not equal to written data");
+
+    // Adjacent requests which run off the end of the device must not take
+    // the valid requests before them down with them.
+    const uint64_t kDevBlocks = 1 << 10;
+    for (size_t i = 0; i < 2; i++) {
+        requests[i].txnid      = txnid;
+        requests[i].vmoid      = vmoid;
+        requests[i].opcode     = BLOCKIO_READ;
+        requests[i].length     = 1;
+        requests[i].vmo_offset = i;
+        requests[i].dev_offset = kDevBlocks - 1 + i;
+    }
+    ASSERT_EQ(block_fifo_txn(client, &requests[0], 2), ZX_ERR_OUT_OF_RANGE);
+    ASSERT_EQ(block_fifo_txn(client, &requests[0], 1), ZX_OK);
+
+    requests[0].opcode = BLOCKIO_CLOSE_VMO;
+    ASSERT_EQ(block_fifo_txn(client, &requests[0], 1), ZX_OK);
+    ASSERT_EQ(zx_handle_close(vmo), ZX_OK);
+    ASSERT_EQ(ioctl_block_free_txn(fd, &txnid), ZX_OK, "Failed to free txn");
+    block_fifo_release_client(client);
+    ASSERT_GE(ioctl_ramdisk_unlink(fd), 0, "Could not unlink ramdisk device");
+    ASSERT_EQ(close(fd), 0);
+    END_TEST;
+}
+
 bool ramdisk_test_fifo_bad_client_vmoid(void) {
     // Try to flex the server's error handling by sending 'malicious' client requests.
     BEGIN_TEST;
@@ -1201,9 +1367,11 @@ RUN_TEST_SMALL(ramdisk_test_fifo_multiple_vmo)
 RUN_TEST_SMALL(ramdisk_test_fifo_multiple_vmo_multithreaded)
 // TODO(smklein): Test ops across different vmos
 RUN_TEST_SMALL(ramdisk_test_fifo_unclean_shutdown)
+RUN_TEST_SMALL(ramdisk_test_fifo_close_with_requests_outstanding)
 RUN_TEST_SMALL(ramdisk_test_fifo_large_ops_count)
 RUN_TEST_SMALL(ramdisk_test_fifo_too_many_ops)
 RUN_TEST_SMALL(ramdisk_test_fifo_intermediate_op_failure)
+RUN_TEST_SMALL(ramdisk_test_fifo_adjacent_requests)
 RUN_TEST_SMALL(ramdisk_test_fifo_bad_client_vmoid)
 RUN_TEST_SMALL(ramdisk_test_fifo_bad_client_txnid)
 RUN_TEST_SMALL(ramdisk_test_fifo_bad_client_unaligned_request)
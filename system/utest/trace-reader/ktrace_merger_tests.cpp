@@ -0,0 +1,188 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <trace-reader/ktrace_merger.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/vector.h>
+#include <unittest/unittest.h>
+#include <zircon/ktrace.h>
+
+namespace {
+
+struct Event {
+    uint32_t tag;
+    uint64_t ts;
+};
+
+class TraceBuilder {
+public:
+    void Record(uint32_t tag, uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+        ktrace_rec_32b_t rec = {tag, 0u, 0u, a, b, c, d};
+        Append(&rec, sizeof(rec));
+    }
+
+    void Tiny(uint32_t tag, uint64_t ts) {
+        ktrace_header_t hdr = {(tag & 0xFFFFFFF0) | 2, 0u, ts};
+        Append(&hdr, sizeof(hdr));
+    }
+
+    void Name(uint32_t id, const char* name) {
+        uint8_t rec[KTRACE_NAMESIZE + 12] = {};
+        uint32_t tag = KTRACE_TAG(KTRACE_EVENT(TAG_THREAD_NAME), KTRACE_GRP_META, sizeof(rec));
+        memcpy(rec, &tag, sizeof(tag));
+        memcpy(rec + sizeof(tag), &id, sizeof(id));
+        strncpy(reinterpret_cast<char*>(rec) + KTRACE_NAMESIZE, name, 7);
+        Append(rec, sizeof(rec));
+    }
+
+    void Append(const TraceBuilder& other) {
+        Append(other.data(), other.size());
+    }
+
+    const uint8_t* data() const { return data_.get(); }
+    size_t size() const { return data_.size(); }
+
+private:
+    void Append(const void* data, size_t size) {
+        for (size_t i = 0; i < size; i++)
+            data_.push_back(static_cast<const uint8_t*>(data)[i]);
+    }
+
+    fbl::Vector<uint8_t> data_;
+};
+
+trace::KtraceMerger::RecordConsumer MakeRecordConsumer(fbl::Vector<Event>* out_events) {
+    return [out_events](const void* record, size_t size) {
+        ktrace_header_t hdr = {};
+        memcpy(&hdr, record, size < sizeof(hdr) ? size : sizeof(hdr));
+        out_events->push_back(Event{hdr.tag, hdr.ts});
+    };
+}
+
+trace::KtraceMerger::ErrorHandler MakeErrorHandler(fbl::String* out_error) {
+    return [out_error](fbl::String error) {
+        *out_error = fbl::move(error);
+    };
+}
+
+bool merges_cpu_streams_test() {
+    BEGIN_TEST;
+
+    TraceBuilder cpu0;
+    cpu0.Tiny(TAG_IRQ_ENTER, 10);
+    cpu0.Tiny(TAG_IRQ_EXIT, 40);
+    TraceBuilder cpu1;
+    cpu1.Tiny(TAG_SYSCALL_ENTER, 20);
+    cpu1.Tiny(TAG_SYSCALL_EXIT, 30);
+    cpu1.Tiny(TAG_IRQ_ENTER, 50);
+    TraceBuilder names;
+    names.Name(1u, "thread");
+
+    TraceBuilder trace;
+    trace.Record(TAG_VERSION, KTRACE_VERSION, 0u, 0u, 0u);
+    trace.Record(TAG_STREAM, 0u, static_cast<uint32_t>(cpu0.size()), 0u, 0u);
+    trace.Append(cpu0);
+    trace.Record(TAG_STREAM, KTRACE_STREAM_NAMES, static_cast<uint32_t>(names.size()), 0u, 0u);
+    trace.Append(names);
+    trace.Record(TAG_STREAM, 1u, static_cast<uint32_t>(cpu1.size()), 2u, 0u);
+    trace.Append(cpu1);
+
+    fbl::Vector<Event> events;
+    fbl::String error;
+    trace::KtraceMerger merger(MakeRecordConsumer(&events), MakeErrorHandler(&error));
+    EXPECT_TRUE(merger.AddData(trace.data(), trace.size()));
+    merger.Flush();
+    EXPECT_TRUE(error.empty());
+    EXPECT_EQ(2u, merger.dropped_records());
+
+    ASSERT_EQ(7u, events.size());
+    EXPECT_EQ(TAG_VERSION, events[0].tag);
+    EXPECT_EQ(KTRACE_EVENT(TAG_THREAD_NAME), KTRACE_EVENT(events[1].tag));
+    const uint64_t expected_ts[] = {10, 20, 30, 40, 50};
+    for (size_t i = 0; i < fbl::count_of(expected_ts); i++) {
+        EXPECT_EQ(expected_ts[i], events[i + 2].ts);
+    }
+
+    END_TEST;
+}
+
+bool joins_streamed_pieces_test() {
+    BEGIN_TEST;
+
+    fbl::Vector<Event> events;
+    fbl::String error;
+    trace::KtraceMerger merger(MakeRecordConsumer(&events), MakeErrorHandler(&error));
+
+    for (uint64_t ts = 1; ts <= 4; ts++) {
+        TraceBuilder piece;
+        piece.Tiny(TAG_IRQ_ENTER, ts);
+        TraceBuilder read;
+        read.Record(TAG_STREAM, static_cast<uint32_t>(ts % 2), static_cast<uint32_t>(piece.size()),
+                    0u, 0u);
+        read.Append(piece);
+        EXPECT_TRUE(merger.AddData(read.data(), read.size()));
+    }
+    merger.Flush();
+    EXPECT_TRUE(error.empty());
+
+    ASSERT_EQ(4u, events.size());
+    for (size_t i = 0; i < events.size(); i++) {
+        EXPECT_EQ(i + 1, events[i].ts);
+    }
+
+    END_TEST;
+}
+
+bool rejects_truncated_stream_test() {
+    BEGIN_TEST;
+
+    TraceBuilder cpu0;
+    cpu0.Tiny(TAG_IRQ_ENTER, 10);
+    TraceBuilder trace;
+    trace.Record(TAG_STREAM, 0u, static_cast<uint32_t>(cpu0.size() + 8), 0u, 0u);
+    trace.Append(cpu0);
+
+    fbl::Vector<Event> events;
+    fbl::String error;
+    trace::KtraceMerger merger(MakeRecordConsumer(&events), MakeErrorHandler(&error));
+    EXPECT_FALSE(merger.AddData(trace.data(), trace.size()));
+    EXPECT_FALSE(error.empty());
+    merger.Flush();
+    EXPECT_EQ(0u, events.size());
+
+    END_TEST;
+}
+
+bool rejects_other_version_test() {
+    BEGIN_TEST;
+
+    // Version 0x00020000 traces were one stream in timestamp order, with no
+    // TAG_STREAM framing.
+    TraceBuilder trace;
+    trace.Record(TAG_VERSION, 0x00020000, 0u, 0u, 0u);
+    trace.Tiny(TAG_IRQ_ENTER, 10);
+
+    fbl::Vector<Event> events;
+    fbl::String error;
+    trace::KtraceMerger merger(MakeRecordConsumer(&events), MakeErrorHandler(&error));
+    EXPECT_FALSE(merger.AddData(trace.data(), trace.size()));
+    EXPECT_FALSE(error.empty());
+    merger.Flush();
+    EXPECT_EQ(0u, events.size());
+
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(ktrace_merger_tests)
+RUN_TEST(merges_cpu_streams_test)
+RUN_TEST(joins_streamed_pieces_test)
+RUN_TEST(rejects_truncated_stream_test)
+RUN_TEST(rejects_other_version_test)
+END_TEST_CASE(ktrace_merger_tests)
@@ -6,12 +6,16 @@
 
 #include <threads.h>
 
+#include <async/cpp/loop.h>
+#include <fbl/array.h>
 #include <fbl/function.h>
 #include <fbl/string.h>
 #include <fbl/string_printf.h>
 #include <fbl/vector.h>
 #include <zx/event.h>
 #include <trace-engine/instrumentation.h>
+#include <trace/event.h>
+#include <trace/handler.h>
 
 namespace {
 int RunClosure(void* arg) {
@@ -387,6 +391,117 @@ bool test_event_with_inline_everything() {
     END_TRACE_TEST;
 }
 
+// Number of events which comfortably overruns the fixture's buffer.
+constexpr uint64_t kManyEvents = 100000u;
+
+void WriteNumberedEvents(uint64_t first, uint64_t count) {
+    for (uint64_t n = first; n < first + count; n++) {
+        TRACE_INSTANT("+enabled", "name", TRACE_SCOPE_THREAD, "n", n);
+    }
+}
+
+// Marks the number carried by each event in |records| in |seen|.
+bool CollectNumberedEvents(const fbl::Vector<trace::Record>& records,
+                           fbl::Array<bool>* seen, size_t* out_count) {
+    BEGIN_HELPER;
+
+    size_t count = 0u;
+    for (const auto& record : records) {
+        if (record.type() != trace::RecordType::kEvent)
+            continue;
+        const auto& args = record.GetEvent().arguments;
+        ASSERT_EQ(1u, args.size());
+        uint64_t n = args[0].value().GetUint64();
+        ASSERT_LT(n, seen->size());
+        EXPECT_FALSE((*seen)[n], "duplicate event");
+        (*seen)[n] = true;
+        count++;
+    }
+    *out_count = count;
+
+    END_HELPER;
+}
+
+bool test_buffering_mode_buffer_too_small() {
+    BEGIN_TRACE_TEST;
+
+    async::Loop loop;
+    trace::TraceHandler handler;
+    fbl::Array<uint8_t> buffer(new uint8_t[TRACE_ENGINE_CHUNK_SIZE],
+                               TRACE_ENGINE_CHUNK_SIZE);
+
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS,
+              trace_start_engine_with_mode(loop.async(), &handler,
+                                           TRACE_BUFFERING_MODE_CIRCULAR,
+                                           buffer.get(), buffer.size()));
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS,
+              trace_start_engine_with_mode(loop.async(), &handler,
+                                           TRACE_BUFFERING_MODE_STREAMING,
+                                           buffer.get(), buffer.size()));
+    EXPECT_EQ(TRACE_STOPPED, trace_state());
+
+    END_TRACE_TEST;
+}
+
+bool test_circular_mode_keeps_newest_records() {
+    BEGIN_TRACE_TEST;
+
+    fixture_start_tracing_with_buffering_mode(TRACE_BUFFERING_MODE_CIRCULAR);
+    WriteNumberedEvents(0u, kManyEvents);
+
+    fbl::Vector<trace::Record> records;
+    ASSERT_TRUE(fixture_read_records(&records));
+    EXPECT_EQ(ZX_OK, fixture_get_disposition());
+
+    fbl::Array<bool> seen(new bool[kManyEvents](), kManyEvents);
+    size_t count;
+    ASSERT_TRUE(CollectNumberedEvents(records, &seen, &count));
+
+    // The oldest events were overwritten, and the newest ones survived.
+    EXPECT_GT(count, 0u);
+    EXPECT_LT(count, kManyEvents);
+    EXPECT_FALSE(seen[0]);
+    EXPECT_TRUE(seen[kManyEvents - 1]);
+
+    END_TRACE_TEST;
+}
+
+bool test_streaming_mode_delivers_all_records() {
+    BEGIN_TRACE_TEST;
+
+    constexpr size_t kNumThreads = 4u;
+    constexpr uint64_t kEventsPerThread = kManyEvents / kNumThreads;
+
+    fixture_start_tracing_with_buffering_mode(TRACE_BUFFERING_MODE_STREAMING);
+
+    // Write from several threads at once so chunks fill up concurrently.
+    fbl::Closure closures[kNumThreads];
+    thrd_t threads[kNumThreads];
+    for (size_t i = 0; i < kNumThreads; i++) {
+        closures[i] = [i] { WriteNumberedEvents(i * kEventsPerThread, kEventsPerThread); };
+        ASSERT_EQ(thrd_success, thrd_create(&threads[i], RunClosure,
+                                            new fbl::Closure(fbl::move(closures[i]))));
+    }
+    for (size_t i = 0; i < kNumThreads; i++) {
+        ASSERT_EQ(thrd_success, thrd_join(threads[i], nullptr));
+    }
+
+    fbl::Vector<trace::Record> records;
+    ASSERT_TRUE(fixture_read_records(&records));
+    EXPECT_EQ(ZX_OK, fixture_get_disposition());
+
+    ASSERT_GE(records.size(), 1u);
+    EXPECT_EQ(trace::RecordType::kInitialization, records[0].type(),
+              "expected initialization record first");
+
+    fbl::Array<bool> seen(new bool[kManyEvents](), kManyEvents);
+    size_t count;
+    ASSERT_TRUE(CollectNumberedEvents(records, &seen, &count));
+    EXPECT_EQ(kNumThreads * kEventsPerThread, count);
+
+    END_TRACE_TEST;
+}
+
 // NOTE: The functions for writing trace records are exercised by other trace tests.
 
 } // namespace
@@ -406,4 +521,7 @@ RUN_TEST(test_register_string_literal_multiple_threads)
 RUN_TEST(test_register_string_literal_table_overflow)
 RUN_TEST(test_maximum_record_length)
 RUN_TEST(test_event_with_inline_everything)
+RUN_TEST(test_buffering_mode_buffer_too_small)
+RUN_TEST(test_circular_mode_keeps_newest_records)
+RUN_TEST(test_streaming_mode_delivers_all_records)
 END_TEST_CASE(engine_tests)
@@ -15,6 +15,8 @@
 #include <zx/event.h>
 #include <fbl/algorithm.h>
 #include <fbl/array.h>
+#include <fbl/auto_lock.h>
+#include <fbl/mutex.h>
 #include <fbl/string.h>
 #include <fbl/string_buffer.h>
 #include <fbl/vector.h>
@@ -38,16 +40,17 @@ public:
         StopTracing(false);
     }
 
-    void StartTracing() {
+    void StartTracing(trace_buffering_mode_t buffering_mode) {
         if (trace_running_)
             return;
 
         trace_running_ = true;
+        buffering_mode_ = buffering_mode;
         loop_.StartThread("trace test");
 
         // Asynchronously start the engine.
-        zx_status_t status = trace_start_engine(loop_.async(), this,
-                                                buffer_.get(), buffer_.size());
+        zx_status_t status = trace_start_engine_with_mode(loop_.async(), this, buffering_mode,
+                                                          buffer_.get(), buffer_.size());
         ZX_DEBUG_ASSERT(status == ZX_OK);
     }
 
@@ -85,9 +88,15 @@ public:
         trace::TraceReader reader(
             [out_records](trace::Record record) { out_records->push_back(fbl::move(record)); },
             [out_errors](fbl::String error) { out_errors->push_back(fbl::move(error)); });
-        trace::Chunk chunk(reinterpret_cast<uint64_t*>(buffer_.get()),
-                           buffer_bytes_written_ / 8u);
-        if (buffer_bytes_written_ & 7u) {
+        // In the streaming mode the records were copied out as they came.
+        const uint8_t* data = buffer_.get();
+        size_t size = buffer_bytes_written_;
+        if (buffering_mode_ == TRACE_BUFFERING_MODE_STREAMING) {
+            data = streamed_.get();
+            size = streamed_.size();
+        }
+        trace::Chunk chunk(reinterpret_cast<const uint64_t*>(data), size / 8u);
+        if (size & 7u) {
             out_errors->push_back(fbl::String("Buffer contains extraneous bytes"));
         }
         if (!reader.ReadRecords(chunk)) {
@@ -114,9 +123,21 @@ private:
         trace_stopped_.signal(0u, ZX_EVENT_SIGNALED);
     }
 
+    void ChunkFull(size_t offset, size_t size) override {
+        {
+            fbl::AutoLock lock(&streamed_mutex_);
+            for (size_t i = 0; i < size; i++)
+                streamed_.push_back(buffer_[offset + i]);
+        }
+        trace_engine_release_chunk(offset);
+    }
+
     async::Loop loop_;
     fbl::Array<uint8_t> buffer_;
     bool trace_running_ = false;
+    trace_buffering_mode_t buffering_mode_ = TRACE_BUFFERING_MODE_ONESHOT;
+    fbl::Mutex streamed_mutex_;
+    fbl::Vector<uint8_t> streamed_;
     zx_status_t disposition_ = ZX_ERR_INTERNAL;
     size_t buffer_bytes_written_ = 0u;
     zx::event trace_stopped_;
@@ -140,7 +161,12 @@ void fixture_tear_down(void) {
 
 void fixture_start_tracing() {
     ZX_DEBUG_ASSERT(g_fixture);
-    g_fixture->StartTracing();
+    g_fixture->StartTracing(TRACE_BUFFERING_MODE_ONESHOT);
+}
+
+void fixture_start_tracing_with_buffering_mode(trace_buffering_mode_t buffering_mode) {
+    ZX_DEBUG_ASSERT(g_fixture);
+    g_fixture->StartTracing(buffering_mode);
 }
 
 void fixture_stop_tracing() {
@@ -158,6 +184,22 @@ zx_status_t fixture_get_disposition(void) {
     return g_fixture->disposition();
 }
 
+bool fixture_read_records(fbl::Vector<trace::Record>* out_records) {
+    ZX_DEBUG_ASSERT(g_fixture);
+    BEGIN_HELPER;
+
+    g_fixture->StopTracing(false);
+
+    fbl::Vector<fbl::String> errors;
+    EXPECT_TRUE(g_fixture->ReadRecords(out_records, &errors), "read error");
+
+    for (const auto& error : errors)
+        printf("error: %s\n", error.c_str());
+    ASSERT_EQ(0u, errors.size(), "errors encountered");
+
+    END_HELPER;
+}
+
 bool fixture_compare_records(const char* expected) {
     ZX_DEBUG_ASSERT(g_fixture);
     BEGIN_HELPER;
@@ -10,13 +10,20 @@
 #pragma once
 
 #include <zircon/compiler.h>
+#include <trace-engine/handler.h>
 #include <unittest/unittest.h>
 
+#ifdef __cplusplus
+#include <fbl/vector.h>
+#include <trace-reader/records.h>
+#endif
+
 __BEGIN_CDECLS
 
 void fixture_set_up(void);
 void fixture_tear_down(void);
 void fixture_start_tracing(void);
+void fixture_start_tracing_with_buffering_mode(trace_buffering_mode_t buffering_mode);
 void fixture_stop_tracing(void);
 void fixture_stop_tracing_hard(void);
 zx_status_t fixture_get_disposition(void);
@@ -49,3 +56,8 @@ inline void fixture_scope_cleanup(bool* scope) {
 #endif // NTRACE
 
 __END_CDECLS
+
+#ifdef __cplusplus
+// Stops tracing and returns all records written since it started.
+bool fixture_read_records(fbl::Vector<trace::Record>* out_records);
+#endif // __cplusplus
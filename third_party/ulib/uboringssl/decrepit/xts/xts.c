@@ -52,10 +52,37 @@
 
 #include <openssl/aes.h>
 #include <openssl/cipher.h>
+#include <openssl/cpu.h>
 
+#include "../crypto/fipsmodule/aes/internal.h"
 #include "../crypto/fipsmodule/modes/internal.h"
 
 
+// Processes a whole XTS data unit, including any ciphertext stealing.
+typedef void (*xts_stream_f)(const uint8_t *in, uint8_t *out, size_t len,
+                             const AES_KEY *key1, const AES_KEY *key2,
+                             const uint8_t iv[16]);
+
+#if !defined(OPENSSL_NO_ASM) && defined(OPENSSL_X86_64)
+#define AESNI_XTS
+
+int aesni_set_encrypt_key(const uint8_t *key, int bits, AES_KEY *out);
+int aesni_set_decrypt_key(const uint8_t *key, int bits, AES_KEY *out);
+void aesni_encrypt(const uint8_t *in, uint8_t *out, const AES_KEY *key);
+void aesni_decrypt(const uint8_t *in, uint8_t *out, const AES_KEY *key);
+void aesni_xts_encrypt(const uint8_t *in, uint8_t *out, size_t len,
+                       const AES_KEY *key1, const AES_KEY *key2,
+                       const uint8_t iv[16]);
+void aesni_xts_decrypt(const uint8_t *in, uint8_t *out, size_t len,
+                       const AES_KEY *key1, const AES_KEY *key2,
+                       const uint8_t iv[16]);
+
+static int aesni_xts_capable(void) {
+  return (OPENSSL_ia32cap_P[1] & (1 << (57 - 32))) != 0;
+}
+#endif  // !NO_ASM && X86_64
+
+
 typedef struct xts128_context {
   void *key1, *key2;
   block128_f block1, block2;
@@ -173,6 +200,7 @@ typedef struct {
     AES_KEY ks;
   } ks1, ks2;  // AES key schedules to use
   XTS128_CONTEXT xts;
+  xts_stream_f stream;  // If set, used instead of |xts|.
 } EVP_AES_XTS_CTX;
 
 static int aes_xts_init_key(EVP_CIPHER_CTX *ctx, const uint8_t *key,
@@ -183,7 +211,40 @@ static int aes_xts_init_key(EVP_CIPHER_CTX *ctx, const uint8_t *key,
   }
 
   if (key) {
+    xctx->stream = NULL;
     // key_len is two AES keys
+#if defined(AESNI_XTS)
+    if (aesni_xts_capable()) {
+      if (enc) {
+        aesni_set_encrypt_key(key, ctx->key_len * 4, &xctx->ks1.ks);
+        xctx->xts.block1 = (block128_f) aesni_encrypt;
+        xctx->stream = aesni_xts_encrypt;
+      } else {
+        aesni_set_decrypt_key(key, ctx->key_len * 4, &xctx->ks1.ks);
+        xctx->xts.block1 = (block128_f) aesni_decrypt;
+        xctx->stream = aesni_xts_decrypt;
+      }
+      aesni_set_encrypt_key(key + ctx->key_len / 2,
+                            ctx->key_len * 4, &xctx->ks2.ks);
+      xctx->xts.block2 = (block128_f) aesni_encrypt;
+      xctx->xts.key1 = &xctx->ks1;
+      goto set_iv;
+    }
+#endif
+    if (hwaes_capable()) {
+      if (enc) {
+        aes_hw_set_encrypt_key(key, ctx->key_len * 4, &xctx->ks1.ks);
+        xctx->xts.block1 = (block128_f) aes_hw_encrypt;
+      } else {
+        aes_hw_set_decrypt_key(key, ctx->key_len * 4, &xctx->ks1.ks);
+        xctx->xts.block1 = (block128_f) aes_hw_decrypt;
+      }
+      aes_hw_set_encrypt_key(key + ctx->key_len / 2,
+                             ctx->key_len * 4, &xctx->ks2.ks);
+      xctx->xts.block2 = (block128_f) aes_hw_encrypt;
+      xctx->xts.key1 = &xctx->ks1;
+      goto set_iv;
+    }
     if (enc) {
       AES_set_encrypt_key(key, ctx->key_len * 4, &xctx->ks1.ks);
       xctx->xts.block1 = (block128_f) AES_encrypt;
@@ -198,6 +259,7 @@ static int aes_xts_init_key(EVP_CIPHER_CTX *ctx, const uint8_t *key,
     xctx->xts.key1 = &xctx->ks1;
   }
 
+set_iv:
   if (iv) {
     xctx->xts.key2 = &xctx->ks2;
     OPENSSL_memcpy(ctx->iv, iv, 16);
@@ -213,11 +275,14 @@ static int aes_xts_cipher(EVP_CIPHER_CTX *ctx, uint8_t *out,
       !xctx->xts.key2 ||
       !out ||
       !in ||
-      len < AES_BLOCK_SIZE ||
-      !CRYPTO_xts128_encrypt(&xctx->xts, ctx->iv, in, out, len, ctx->encrypt)) {
+      len < AES_BLOCK_SIZE) {
     return 0;
   }
-  return 1;
+  if (xctx->stream) {
+    (*xctx->stream)(in, out, len, xctx->xts.key1, xctx->xts.key2, ctx->iv);
+    return 1;
+  }
+  return CRYPTO_xts128_encrypt(&xctx->xts, ctx->iv, in, out, len, ctx->encrypt);
 }
 
 static int aes_xts_ctrl(EVP_CIPHER_CTX *c, int type, int arg, void *ptr) {